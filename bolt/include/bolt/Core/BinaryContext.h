@@ -718,6 +718,12 @@ public:
   MarkerSymType getMarkerType(const SymbolRef &Symbol) const;
   bool isMarker(const SymbolRef &Symbol) const;
 
+  /// Return true if \p Inst calls one of the functions that Fil-C's
+  /// pizlonated code calls when a safety check fails. None of them return, and
+  /// the compiler puts nothing after the call, so the block that follows is not
+  /// a real fall-through. The blocks that make these calls are always cold.
+  bool isFilCFailureCall(const MCInst &Inst) const;
+
   /// Iterate over all BinaryData.
   iterator_range<binary_data_const_iterator> getBinaryData() const {
     return make_range(BinaryDataMap.begin(), BinaryDataMap.end());
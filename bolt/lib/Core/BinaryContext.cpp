@@ -17,6 +17,7 @@
 #include "bolt/Utils/NameResolver.h"
 #include "bolt/Utils/Utils.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/DebugInfo/DWARF/DWARFCompileUnit.h"
 #include "llvm/DebugInfo/DWARF/DWARFFormValue.h"
@@ -60,6 +61,12 @@ PrintDebugInfo("print-debug-info",
   cl::ZeroOrMore,
   cl::cat(BoltCategory));
 
+static cl::opt<bool> FilCFailureCalls(
+    "filc-failure-calls",
+    cl::desc("treat calls to Fil-C safety check failure functions as cold "
+             "calls that never return"),
+    cl::init(true), cl::Hidden, cl::cat(BoltCategory));
+
 cl::opt<bool> PrintRelocations(
     "print-relocations",
     cl::desc("print relocations when printing functions/objects"), cl::Hidden,
@@ -1780,6 +1787,31 @@ bool BinaryContext::isMarker(const SymbolRef &Symbol) const {
   return getMarkerType(Symbol) != MarkerSymType::NONE;
 }
 
+bool BinaryContext::isFilCFailureCall(const MCInst &Inst) const {
+  if (!opts::FilCFailureCalls || !MIB->isCall(Inst))
+    return false;
+
+  const MCSymbol *CalleeSymbol = MIB->getTargetSymbol(Inst);
+  if (!CalleeSymbol)
+    return false;
+
+  // The thunks are local to each object file, so there may be many of them,
+  // each with its own uniquified name. The runtime's functions get called
+  // through the PLT.
+  StringRef CalleeName = NameResolver::restore(CalleeSymbol->getName());
+  CalleeName.consume_back("@PLT");
+  return StringSwitch<bool>(CalleeName)
+      .Cases("filc_access_check_fail_thunk",
+             "filc_alignment_contradiction_thunk",
+             "filc_optimized_access_check_fail",
+             "filc_optimized_alignment_contradiction", true)
+      .Cases("filc_check_function_call_fail", "filc_cc_args_check_failure",
+             "filc_cc_rets_check_failure", true)
+      .Cases("filc_stack_overflow_failure", "filc_stack_overflow_failure_impl",
+             true)
+      .Default(false);
+}
+
 static void printDebugInfo(raw_ostream &OS, const MCInst &Instruction,
                            const BinaryFunction *Function,
                            DWARFContext *DwCtx) {
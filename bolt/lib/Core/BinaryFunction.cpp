@@ -2067,7 +2067,7 @@ bool BinaryFunction::buildCFG(MCPlusBuilder::AllocatorIdTy AllocatorId) {
 
   // TODO: handle properly calls to no-return functions,
   // e.g. exit(3), etc. Otherwise we'll see a false fall-through
-  // blocks.
+  // blocks. For now we only know about Fil-C's check failure calls.
 
   for (std::pair<uint32_t, uint32_t> &Branch : TakenBranches) {
     LLVM_DEBUG(dbgs() << "registering branch [0x"
@@ -2111,7 +2111,8 @@ bool BinaryFunction::buildCFG(MCPlusBuilder::AllocatorIdTy AllocatorId) {
       //
       // Conditional tail call is a special case since we don't add a taken
       // branch successor for it.
-      IsPrevFT = !MIB->isTerminator(*LastInstr) ||
+      IsPrevFT = (!MIB->isTerminator(*LastInstr) &&
+                  !BC.isFilCFailureCall(*LastInstr)) ||
                  MIB->getConditionalTailCall(*LastInstr);
     } else if (BB->succ_size() == 1) {
       IsPrevFT = MIB->isConditionalBranch(*LastInstr);
@@ -3881,6 +3882,11 @@ void BinaryFunction::deleteConservativeEdges() {
     if (!Last || !BC.MIB->isCall(*Last))
       continue;
 
+    if (BC.isFilCFailureCall(*Last)) {
+      BB->removeAllSuccessors();
+      continue;
+    }
+
     const MCSymbol *CalleeSymbol = BC.MIB->getTargetSymbol(*Last);
     if (!CalleeSymbol)
       continue;
@@ -130,10 +130,19 @@ struct SplitProfile2 final : public SplitStrategy {
 
   void fragment(const BlockIt Start, const BlockIt End) override {
     for (BinaryBasicBlock *const BB : llvm::make_range(Start, End)) {
-      if (BB->getExecutionCount() == 0)
+      if (BB->getExecutionCount() == 0 || endsInFilCFailureCall(*BB))
         BB->setFragmentNum(FragmentNum::cold());
     }
   }
+
+private:
+  // Fil-C's check failure blocks only ever run once, right before the program
+  // dies, so they're cold even if sampling skid gave them a count.
+  static bool endsInFilCFailureCall(const BinaryBasicBlock &BB) {
+    const MCInst *Last = BB.getLastNonPseudoInstr();
+    return Last &&
+           BB.getFunction()->getBinaryContext().isFilCFailureCall(*Last);
+  }
 };
 
 struct SplitRandom2 final : public SplitStrategy {
@@ -1432,11 +1432,12 @@ public:
     return getTriple().isX86() || getTriple().isAArch64();
   }
 
-  /// Identify whether this target supports IFuncs.
+  /// Identify whether this target supports IFuncs. Fil-C lowers ifuncs to
+  /// ordinary dispatch functions in the pizlonator, so they don't need any
+  /// support from libc or the dynamic linker, and musl is fine.
   bool supportsIFunc() const {
     return getTriple().isOSBinFormatELF() &&
-           ((getTriple().isOSLinux() && !getTriple().isMusl()) ||
-            getTriple().isOSFreeBSD());
+           (getTriple().isOSLinux() || getTriple().isOSFreeBSD());
   }
 
   // Validate the contents of the __builtin_cpu_supports(const char*)
@@ -56,6 +56,11 @@
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/TargetParser/SubtargetFeature.h"
 #include "llvm/TargetParser/Triple.h"
+#include "llvm/Transforms/Coroutines/CoroCleanup.h"
+#include "llvm/Transforms/Coroutines/CoroConditionalWrapper.h"
+#include "llvm/Transforms/Coroutines/CoroEarly.h"
+#include "llvm/Transforms/Coroutines/CoroElide.h"
+#include "llvm/Transforms/Coroutines/CoroSplit.h"
 #include "llvm/Transforms/IPO/LowerTypeTests.h"
 #include "llvm/Transforms/IPO/ThinLTOBitcodeWriter.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
@@ -143,6 +148,11 @@ static cl::opt<bool> FilCInlineADCE(
   cl::init(true));
 static cl::opt<bool> FilCInlineDSE(
   "filc-inline-dse", cl::desc("Run DSE during Fil-C inlining pipeline"), cl::Hidden, cl::init(true));
+static cl::opt<bool> FilCLowerCoroutines(
+  "filc-lower-coroutines",
+  cl::desc("Split C++20 coroutines before pizlonation, eliding their frames during the Fil-C "
+           "inlining pipeline"),
+  cl::Hidden, cl::init(true));
 
 namespace {
 
@@ -977,6 +987,14 @@ void EmitAssemblyHelper::RunOptimizationPipeline(
 
     PB.registerPipelineStartEPCallback(
         [](ModulePassManager &MPM, OptimizationLevel Level) {
+          // The pizlonator doesn't know about the llvm.coro intrinsics, so coroutines have to be
+          // split before it runs. Doing it during our inlining pipeline also lets CoroElide turn
+          // frames that don't escape into allocas, which the pizlonator can then put on the stack
+          // instead of the heap.
+          bool LowerCoroutinesWhileInlining =
+              Level != OptimizationLevel::O0 && FilCOptimize && FilCInline && FilCLowerCoroutines;
+          if (LowerCoroutinesWhileInlining)
+            MPM.addPass(CoroEarlyPass());
           if (Level != OptimizationLevel::O0 && FilCOptimize) {
             FunctionPassManager EarlyFPM;
             EarlyFPM.addPass(LowerExpectIntrinsicPass());
@@ -1026,10 +1044,14 @@ void EmitAssemblyHelper::RunOptimizationPipeline(
                 InlinerFPM.addPass(DSEPass());
               if (FilCInlineInstCombineLate)
                 InlinerFPM.addPass(InstCombinePass());
+              if (LowerCoroutinesWhileInlining)
+                InlinerFPM.addPass(CoroElidePass());
               MainCGPipeline.addPass(
                 createCGSCCToFunctionPassAdaptor(
                   std::move(InlinerFPM),
                   /*EagerlyInvalidateAnalyses=*/true, /*NoRerun=*/true));
+              if (LowerCoroutinesWhileInlining)
+                MainCGPipeline.addPass(CoroSplitPass(/*OptimizeFrame=*/true));
               MainCGPipeline.addPass(PostOrderFunctionAttrsPass());
               MainCGPipeline.addPass(
                 createCGSCCToFunctionPassAdaptor(
@@ -1040,6 +1062,17 @@ void EmitAssemblyHelper::RunOptimizationPipeline(
               MPM.addPass(std::move(MIWP));
             }
           }
+          if (LowerCoroutinesWhileInlining)
+            MPM.addPass(CoroCleanupPass());
+          else if (FilCLowerCoroutines) {
+            ModulePassManager CoroPM;
+            CoroPM.addPass(CoroEarlyPass());
+            CGSCCPassManager CoroCGPM;
+            CoroCGPM.addPass(CoroSplitPass(Level != OptimizationLevel::O0));
+            CoroPM.addPass(createModuleToPostOrderCGSCCPassAdaptor(std::move(CoroCGPM)));
+            CoroPM.addPass(CoroCleanupPass());
+            MPM.addPass(CoroConditionalWrapper(std::move(CoroPM)));
+          }
           MPM.addPass(FilPizlonatorPass());
         });
 
@@ -3361,4 +3361,14 @@ void Generic_ELF::addClangTargetOptions(const ArgList &DriverArgs,
   if (!DriverArgs.hasFlag(options::OPT_fuse_init_array,
                           options::OPT_fno_use_init_array, true))
     CC1Args.push_back("-fno-use-init-array");
+
+  // Let the pizlonator inline the runtime's fast paths, if libpas built them.
+  SmallString<128> P(getDriver().InstalledDir);
+  llvm::sys::path::append(P, "..", "..", "pizfix", "lib");
+  llvm::sys::path::append(P, "filc_runtime_inlines.bc");
+  if (getVFS().exists(P)) {
+    CC1Args.push_back("-mllvm");
+    CC1Args.push_back(
+        DriverArgs.MakeArgString(Twine("-filc-runtime-inlines=") + P));
+  }
 }
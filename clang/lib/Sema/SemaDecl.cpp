@@ -16372,6 +16372,26 @@ void Sema::AddKnownFunctionAttributes(FunctionDecl *FD) {
       FD->addAttr(NoThrowAttr::CreateImplicit(Context, FD->getLocation()));
   }
 
+  // In Fil-C, the unwinder refuses to go past the frame of a function that
+  // was compiled without exceptions, and the C libraries whose headers we
+  // see as system headers (usermusl and friends) are compiled as C. So, an
+  // exception can never come out of an extern "C" function declared in a
+  // system header, and telling codegen that lets the pizlonator skip the
+  // exception check after calls to it. If such a function is actually
+  // written in C++ and throws, then its caller's origin cannot catch and
+  // the unwinder terminates, just like it would for a noexcept violation.
+  // The unwinder's own entrypoints are the exception, since they're how
+  // exceptions get thrown in the first place.
+  if (getLangOpts().CXXExceptions && getLangOpts().SystemExternCNoUnwind &&
+      FD->isExternC() && !FD->hasAttr<NoThrowAttr>() &&
+      Context.getSourceManager().isInSystemHeader(FD->getLocation())) {
+    const auto *FPT = FD->getType()->getAs<FunctionProtoType>();
+    StringRef FDName = FD->getIdentifier() ? FD->getName() : StringRef();
+    if ((!FPT || FPT->getExceptionSpecType() == EST_None) &&
+        !FDName.starts_with("__cxa_") && !FDName.starts_with("_Unwind_"))
+      FD->addAttr(NoThrowAttr::CreateImplicit(Context, FD->getLocation()));
+  }
+
   IdentifierInfo *Name = FD->getIdentifier();
   if (!Name)
     return;
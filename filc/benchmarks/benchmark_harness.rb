@@ -0,0 +1,209 @@
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# The parts of the benchmark runners that don't depend on what's being run. Each run gets timed, and
+# when $usePerf is set it's wrapped in perf stat to get hardware counters. Fil-C runs get
+# FUGC_VERBOSE=1 so that we can count GC cycles and how long they took.
+
+require 'json'
+require 'tempfile'
+
+PERF_EVENTS = [ "instructions", "branch-misses", "L1-dcache-load-misses", "LLC-load-misses" ]
+
+def mysys(*cmd)
+    unless system(*cmd)
+        raise "Command failed: #{cmd.join(' ')}"
+    end
+end
+
+def checkPerf
+    return unless $usePerf
+    unless system("perf stat -x, -e instructions -- true > /dev/null 2>&1")
+        $stderr.puts "perf stat doesn't work here, so not collecting hardware counters."
+        $usePerf = false
+    end
+end
+
+def median(values)
+    sorted = values.sort
+    if sorted.size.odd?
+        sorted[sorted.size / 2]
+    else
+        (sorted[sorted.size / 2 - 1] + sorted[sorted.size / 2]) / 2.0
+    end
+end
+
+def parsePerf(path)
+    result = {}
+    IO.readlines(path).each {
+        | line |
+        fields = line.strip.split(',')
+        next if fields.size < 3
+        event = fields[2].sub(/:u$/, '')
+        next unless PERF_EVENTS.include? event
+        result[event] = fields[0] =~ /^[0-9]+$/ ? fields[0].to_i : nil
+    }
+    result
+end
+
+# Runs cmd once. If stdinPath is given, the command reads it as its stdin. The command's stdout is
+# thrown away unless wantStdout is set, in which case it is returned as "stdout".
+def runOnce(cmd, isFilc, stdinPath = nil, wantStdout = false)
+    env = {}
+    env["FUGC_VERBOSE"] = "1" if isFilc
+    perfFile = nil
+    if $usePerf
+        perfFile = Tempfile.new("perf")
+        perfFile.close
+        cmd = [ "perf", "stat", "-x,", "-o", perfFile.path, "-e", PERF_EVENTS.join(','),
+                "--" ] + cmd
+    end
+    stdoutFile = Tempfile.new("stdout")
+    stderrFile = Tempfile.new("stderr")
+    options = { :out => wantStdout ? stdoutFile.path : File::NULL, :err => stderrFile.path }
+    options[:in] = stdinPath if stdinPath
+    before = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    pid = Process.spawn(env, *cmd, options)
+    Process.wait(pid)
+    after = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    status = $?
+    stdout = IO.read(stdoutFile.path)
+    stderr = IO.read(stderrFile.path)
+    stdoutFile.unlink
+    stderrFile.unlink
+    unless status.success?
+        $stderr.puts stdout
+        $stderr.puts stderr
+        raise "#{cmd.join(' ')} failed: #{status}"
+    end
+    result = { "time" => after - before }
+    result["stdout"] = stdout if wantStdout
+    if perfFile
+        result["counters"] = parsePerf(perfFile.path)
+        perfFile.unlink
+    end
+    if isFilc
+        cycles = 0
+        gcTime = 0.0
+        stderr.each_line {
+            | line |
+            if line =~ /fugc: [0-9]+ kb -> [0-9]+ kb in ([0-9.]+) ms/
+                cycles += 1
+                gcTime += $1.to_f
+            end
+        }
+        result["fugc_cycles"] = cycles
+        result["fugc_time"] = gcTime / 1000.0
+    end
+    result
+end
+
+def summarize(runs)
+    result = { "runs" => runs, "time" => median(runs.map { | run | run["time"] }) }
+    if $usePerf
+        counters = {}
+        PERF_EVENTS.each {
+            | event |
+            values = runs.map { | run | run["counters"][event] }.compact
+            counters[event] = values.empty? ? nil : median(values)
+        }
+        result["counters"] = counters
+    end
+    if runs[0].has_key? "fugc_cycles"
+        result["fugc_cycles"] = median(runs.map { | run | run["fugc_cycles"] })
+        result["fugc_time"] = median(runs.map { | run | run["fugc_time"] })
+    end
+    result
+end
+
+# Runs both commands $runs times, interleaved so that both see the same machine conditions. Returns
+# the summaries and the slowdown ratio of filc over legacy.
+#
+# Benchmarks that run for a fixed amount of time (like openssl speed) pass a score block, which gets
+# the command's stdout and returns a throughput. Then the ratio is legacy throughput over filc
+# throughput, so it still reads as a slowdown.
+def compare(filcCmd, legacyCmd, stdinPath = nil, &score)
+    filcRuns = []
+    legacyRuns = []
+    $runs.times {
+        [ [ filcCmd, true, filcRuns ], [ legacyCmd, false, legacyRuns ] ].each {
+            | cmd, isFilc, runs |
+            run = runOnce(cmd, isFilc, stdinPath, !!score)
+            run["score"] = score.call(run.delete("stdout")) if score
+            runs << run
+        }
+    }
+    filc = summarize(filcRuns)
+    legacy = summarize(legacyRuns)
+    if score
+        filc["score"] = median(filcRuns.map { | run | run["score"] })
+        legacy["score"] = median(legacyRuns.map { | run | run["score"] })
+        ratio = legacy["score"] / filc["score"]
+    else
+        ratio = filc["time"] / legacy["time"]
+    end
+    { "filc" => filc, "legacy" => legacy, "ratio" => ratio }
+end
+
+def formatCount(value)
+    value ? value.to_s : "-"
+end
+
+def printResults(results)
+    puts "%-24s %10s %10s %8s %8s %10s" % [ "benchmark", "filc (s)", "legacy (s)", "ratio",
+                                             "gcs", "gc (s)" ]
+    results.each_pair {
+        | name, result |
+        puts "%-24s %10.3f %10.3f %8.2f %8s %10.3f" % [ name, result["filc"]["time"],
+                                                       result["legacy"]["time"], result["ratio"],
+                                                       result["filc"]["fugc_cycles"].to_s,
+                                                       result["filc"]["fugc_time"] ]
+        if $usePerf
+            PERF_EVENTS.each {
+                | event |
+                filcCount = result["filc"]["counters"][event]
+                legacyCount = result["legacy"]["counters"][event]
+                if filcCount and legacyCount and legacyCount > 0
+                    ratio = "%.2f" % (filcCount.to_f / legacyCount)
+                else
+                    ratio = "-"
+                end
+                puts "    %-28s %16s %16s %8s" % [ event, formatCount(filcCount),
+                                                   formatCount(legacyCount), ratio ]
+            }
+        end
+    }
+
+    allRatios = results.values.map { | result | result["ratio"] }
+    unless allRatios.empty?
+        geomean = Math.exp(allRatios.map { | ratio | Math.log(ratio) }.sum / allRatios.size)
+        puts "geomean ratio: %.2f" % geomean
+    end
+end
+
+def writeResults(path, results)
+    File.open(path, "w") {
+        | outp |
+        outp.puts JSON.pretty_generate({ "runs_per_benchmark" => $runs, "results" => results })
+    }
+end
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* GC stress test in the style of the binary trees benchmark: every thread keeps one long-lived tree
+   and keeps building and checking short-lived trees, so most of what gets allocated dies young, but
+   marking always has a big old tree to trace. This is Fil-C only.
+
+   Usage: gc_binary_trees [num_threads] */
+
+#include "gc_stress.h"
+
+#define LONG_LIVED_DEPTH 18
+#define SHORT_LIVED_DEPTH 12
+#define NUM_SHORT_LIVED_TREES 400
+
+struct node {
+    struct node* left;
+    struct node* right;
+};
+
+static struct node* make_tree(gc_stress_recorder* recorder, unsigned depth)
+{
+    struct node* result = malloc(sizeof(struct node));
+    if (depth) {
+        result->left = make_tree(recorder, depth - 1);
+        result->right = make_tree(recorder, depth - 1);
+    } else {
+        result->left = NULL;
+        result->right = NULL;
+    }
+    gc_stress_tick(recorder);
+    return result;
+}
+
+static unsigned long long check_tree(struct node* node)
+{
+    if (!node->left)
+        return 1;
+    return 1 + check_tree(node->left) + check_tree(node->right);
+}
+
+static void* thread_main(void* arg)
+{
+    gc_stress_recorder* recorder = malloc(sizeof(gc_stress_recorder));
+    unsigned long long* num_nodes = arg;
+    unsigned index;
+    gc_stress_recorder_start(recorder);
+    struct node* long_lived = make_tree(recorder, LONG_LIVED_DEPTH);
+    *num_nodes = check_tree(long_lived);
+    for (index = 0; index < NUM_SHORT_LIVED_TREES; ++index)
+        *num_nodes += check_tree(make_tree(recorder, SHORT_LIVED_DEPTH));
+    if (check_tree(long_lived) != (1u << (LONG_LIVED_DEPTH + 1)) - 1) {
+        fprintf(stderr, "long-lived tree got corrupted\n");
+        abort();
+    }
+    gc_stress_recorder_finish(recorder);
+    return long_lived;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned num_threads = argc > 1 ? (unsigned)atoi(argv[1]) : 4;
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
+    unsigned long long* num_nodes = malloc(sizeof(unsigned long long) * num_threads);
+    struct node** trees = malloc(sizeof(struct node*) * num_threads);
+    unsigned long long total = 0;
+    unsigned index;
+    gc_stress_begin();
+    for (index = 0; index < num_threads; ++index)
+        pthread_create(threads + index, NULL, thread_main, num_nodes + index);
+    for (index = 0; index < num_threads; ++index) {
+        pthread_join(threads[index], (void**)(trees + index));
+        total += num_nodes[index];
+    }
+    gc_stress_report("gc_binary_trees", total);
+    return trees[0] ? 0 : 1;
+}
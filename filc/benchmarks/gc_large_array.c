@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* GC stress test with one huge array of ptrs that the mutator keeps overwriting with fresh small
+   objects. Every cycle has to trace the whole array (and its aux), while the mutator keeps storing
+   into it, so this shows how marking a single big object interacts with the store barrier and with
+   the mutator's pauses. This is Fil-C only.
+
+   Usage: gc_large_array [num_slots] [num_operations] */
+
+#include "gc_stress.h"
+
+struct payload {
+    unsigned long value;
+    struct payload* next;
+};
+
+int main(int argc, char** argv)
+{
+    size_t num_slots = argc > 1 ? strtoull(argv[1], NULL, 10) : 8 * 1024 * 1024;
+    unsigned long long num_operations = argc > 2 ? strtoull(argv[2], NULL, 10) : 50000000;
+    struct payload** slots = calloc(num_slots, sizeof(struct payload*));
+    unsigned long random_state = 42;
+    unsigned long long index;
+    gc_stress_recorder recorder;
+    gc_stress_begin();
+    gc_stress_recorder_start(&recorder);
+    for (index = 0; index < num_operations; ++index) {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        size_t slot = random_state % num_slots;
+        struct payload* payload = malloc(sizeof(struct payload));
+        payload->value = index;
+        /* Chain to the old one once in a while, so that not everything dies right away. */
+        payload->next = (index & 7) ? NULL : slots[slot];
+        if (payload->next)
+            payload->next->next = NULL;
+        slots[slot] = payload;
+        gc_stress_tick(&recorder);
+    }
+    gc_stress_recorder_finish(&recorder);
+    gc_stress_report("gc_large_array", num_operations);
+    for (index = 0; index < num_slots; ++index) {
+        if (slots[index] && slots[index]->value >= num_operations) {
+            fprintf(stderr, "slot %llu got corrupted\n", index);
+            return 1;
+        }
+    }
+    return 0;
+}
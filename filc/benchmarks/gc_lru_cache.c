@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* GC stress test that models an LRU cache: a hash table of entries on a doubly linked list, with
+   values of assorted sizes. Lookups of keys that aren't in the cache insert them, evicting the
+   least recently used entry. So, the live heap stays the same size, but the cache keeps churning
+   through objects and keeps storing ptrs into old objects, which keeps the store barrier busy. This
+   is Fil-C only.
+
+   Usage: gc_lru_cache [num_operations] */
+
+#include "gc_stress.h"
+
+#define CAPACITY 200000
+#define NUM_BUCKETS 262144
+#define KEY_RANGE (CAPACITY * 4)
+#define MIN_VALUE_SIZE 16
+#define MAX_VALUE_SIZE 1024
+
+struct entry {
+    unsigned long key;
+    struct entry* hash_next;
+    struct entry* prev;
+    struct entry* next;
+    size_t value_size;
+    char* value;
+};
+
+static struct entry* buckets[NUM_BUCKETS];
+static struct entry head; /* head.next is the most recently used entry. */
+static size_t num_entries;
+
+static unsigned long next_random(unsigned long* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void unlink_entry(struct entry* entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+}
+
+static void link_at_front(struct entry* entry)
+{
+    entry->prev = &head;
+    entry->next = head.next;
+    head.next->prev = entry;
+    head.next = entry;
+}
+
+static void evict(void)
+{
+    struct entry* victim = head.prev;
+    struct entry** link;
+    unlink_entry(victim);
+    for (link = buckets + victim->key % NUM_BUCKETS; *link != victim; link = &(*link)->hash_next);
+    *link = victim->hash_next;
+    free(victim->value);
+    free(victim);
+    num_entries--;
+}
+
+static struct entry* lookup(unsigned long key, unsigned long* random_state)
+{
+    struct entry* entry;
+    for (entry = buckets[key % NUM_BUCKETS]; entry; entry = entry->hash_next) {
+        if (entry->key == key) {
+            unlink_entry(entry);
+            link_at_front(entry);
+            return entry;
+        }
+    }
+    if (num_entries == CAPACITY)
+        evict();
+    entry = malloc(sizeof(struct entry));
+    entry->key = key;
+    entry->value_size = MIN_VALUE_SIZE
+        + next_random(random_state) % (MAX_VALUE_SIZE - MIN_VALUE_SIZE);
+    entry->value = malloc(entry->value_size);
+    memset(entry->value, (int)key, entry->value_size);
+    entry->hash_next = buckets[key % NUM_BUCKETS];
+    buckets[key % NUM_BUCKETS] = entry;
+    link_at_front(entry);
+    num_entries++;
+    return entry;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long num_operations = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000000;
+    unsigned long random_state = 42;
+    unsigned long long checksum = 0;
+    unsigned long long index;
+    gc_stress_recorder recorder;
+    head.prev = &head;
+    head.next = &head;
+    gc_stress_begin();
+    gc_stress_recorder_start(&recorder);
+    for (index = 0; index < num_operations; ++index) {
+        /* Squaring skews the keys towards the small ones, so that there are hits as well as
+           misses. */
+        unsigned long random = next_random(&random_state) % KEY_RANGE;
+        unsigned long key = random * random / KEY_RANGE;
+        struct entry* entry = lookup(key, &random_state);
+        checksum += (unsigned char)entry->value[entry->value_size - 1];
+        gc_stress_tick(&recorder);
+    }
+    gc_stress_recorder_finish(&recorder);
+    gc_stress_report("gc_lru_cache", num_operations);
+    printf("checksum: %llu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* GC stress test for soft handshakes with lots of threads. Every thread allocates small short-lived
+   lists, and every now and then sleeps for a bit, so at any time some threads are running Fil-C
+   code (and have to respond to handshakes themselves) while others are exited in a syscall (and
+   have their handshakes done for them). With many more threads than cores, this is where handshake
+   latency gets bad. This is Fil-C only.
+
+   Usage: gc_many_threads [num_threads] [operations_per_thread] */
+
+#include "gc_stress.h"
+
+#define LIST_LENGTH 16
+#define OPERATIONS_PER_SLEEP 1000
+#define SLEEP_NANOSECONDS 100000
+
+struct cell {
+    struct cell* next;
+    unsigned long value;
+};
+
+static unsigned long long operations_per_thread;
+
+static void* thread_main(void* arg)
+{
+    gc_stress_recorder* recorder = malloc(sizeof(gc_stress_recorder));
+    unsigned long long index;
+    unsigned long sum = 0;
+    gc_stress_recorder_start(recorder);
+    for (index = 0; index < operations_per_thread; ++index) {
+        struct cell* list = NULL;
+        struct cell* cell;
+        unsigned length;
+        for (length = 0; length < LIST_LENGTH; ++length) {
+            cell = malloc(sizeof(struct cell));
+            cell->next = list;
+            cell->value = length;
+            list = cell;
+        }
+        for (cell = list; cell; cell = cell->next)
+            sum += cell->value;
+        if (!((index + 1) % OPERATIONS_PER_SLEEP)) {
+            struct timespec duration = { 0, SLEEP_NANOSECONDS };
+            nanosleep(&duration, NULL);
+            /* Don't count the sleep as a pause. */
+            recorder->last_tick = gc_stress_now();
+            continue;
+        }
+        gc_stress_tick(recorder);
+    }
+    gc_stress_recorder_finish(recorder);
+    if (sum != operations_per_thread * (LIST_LENGTH * (LIST_LENGTH - 1) / 2)) {
+        fprintf(stderr, "bad sum\n");
+        abort();
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned num_threads = argc > 1 ? (unsigned)atoi(argv[1]) : 64;
+    operations_per_thread = argc > 2 ? strtoull(argv[2], NULL, 10) : 200000;
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
+    unsigned index;
+    gc_stress_begin();
+    for (index = 0; index < num_threads; ++index)
+        pthread_create(threads + index, NULL, thread_main, NULL);
+    for (index = 0; index < num_threads; ++index)
+        pthread_join(threads[index], NULL);
+    gc_stress_report("gc_many_threads", operations_per_thread * num_threads);
+    return 0;
+}
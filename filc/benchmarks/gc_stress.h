@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Shared measurement code for the GC stress benchmarks (gc_*.c). These only build with Fil-C, since
+   they read FUGC's statistics with zgc_get_stats().
+
+   Mutator pauses are measured the way a hiccup meter would: every mutator thread calls
+   gc_stress_tick() after each unit of work, and the time between ticks goes into a histogram. The
+   median is how long a unit of work takes. The tail is where the pauses show up, since a thread
+   that is busy responding to a soft handshake, helping with marking, or stopped for the GC doesn't
+   tick. We also report the handshake latencies that FUGC itself saw, which are rounded up to a
+   power of two microseconds.
+
+   Heap overhead is the peak RSS of the process divided by the bytes that survived a full collection
+   at the end of the run, while the benchmark's data structures were still alive. */
+
+#ifndef GC_STRESS_H
+#define GC_STRESS_H
+
+#include <math.h>
+#include <pthread.h>
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Gaps are bucketed by their power of two microseconds, GC_STRESS_SUB_BUCKETS buckets within each,
+   up to 2^GC_STRESS_NUM_POWERS microseconds (about 17 minutes). */
+#define GC_STRESS_SUB_BUCKETS 16
+#define GC_STRESS_NUM_POWERS 30
+#define GC_STRESS_NUM_BUCKETS (GC_STRESS_SUB_BUCKETS * (GC_STRESS_NUM_POWERS + 1))
+
+typedef struct {
+    double last_tick;
+    unsigned long long num_ticks;
+    double max_gap;
+    unsigned long long buckets[GC_STRESS_NUM_BUCKETS];
+} gc_stress_recorder;
+
+static pthread_mutex_t gc_stress_lock = PTHREAD_MUTEX_INITIALIZER;
+static gc_stress_recorder gc_stress_total;
+static double gc_stress_start_time;
+
+static double gc_stress_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned gc_stress_bucket_for_gap(double microseconds)
+{
+    if (microseconds < 1)
+        return 0;
+    int exponent;
+    double fraction = frexp(microseconds, &exponent); /* microseconds = fraction * 2^exponent */
+    unsigned power = (unsigned)(exponent - 1);
+    if (power >= GC_STRESS_NUM_POWERS)
+        return GC_STRESS_NUM_BUCKETS - 1;
+    unsigned sub_bucket = (unsigned)((fraction * 2 - 1) * GC_STRESS_SUB_BUCKETS);
+    return GC_STRESS_SUB_BUCKETS * (power + 1) + sub_bucket;
+}
+
+/* Returns the upper bound of the bucket in microseconds. */
+static double gc_stress_gap_for_bucket(unsigned bucket)
+{
+    if (bucket < GC_STRESS_SUB_BUCKETS)
+        return 1;
+    unsigned power = bucket / GC_STRESS_SUB_BUCKETS - 1;
+    unsigned sub_bucket = bucket % GC_STRESS_SUB_BUCKETS;
+    return ldexp(1 + (double)(sub_bucket + 1) / GC_STRESS_SUB_BUCKETS, (int)power);
+}
+
+static void gc_stress_recorder_start(gc_stress_recorder* recorder)
+{
+    memset(recorder, 0, sizeof(gc_stress_recorder));
+    recorder->last_tick = gc_stress_now();
+}
+
+static inline void gc_stress_tick(gc_stress_recorder* recorder)
+{
+    double now = gc_stress_now();
+    double gap = (now - recorder->last_tick) * 1e6;
+    recorder->last_tick = now;
+    recorder->num_ticks++;
+    if (gap > recorder->max_gap)
+        recorder->max_gap = gap;
+    recorder->buckets[gc_stress_bucket_for_gap(gap)]++;
+}
+
+/* Each thread calls this once it's done ticking. */
+static void gc_stress_recorder_finish(gc_stress_recorder* recorder)
+{
+    unsigned index;
+    pthread_mutex_lock(&gc_stress_lock);
+    gc_stress_total.num_ticks += recorder->num_ticks;
+    if (recorder->max_gap > gc_stress_total.max_gap)
+        gc_stress_total.max_gap = recorder->max_gap;
+    for (index = 0; index < GC_STRESS_NUM_BUCKETS; ++index)
+        gc_stress_total.buckets[index] += recorder->buckets[index];
+    pthread_mutex_unlock(&gc_stress_lock);
+}
+
+static double gc_stress_percentile(double percentile)
+{
+    unsigned long long target = (unsigned long long)ceil(gc_stress_total.num_ticks * percentile);
+    unsigned long long count = 0;
+    unsigned index;
+    for (index = 0; index < GC_STRESS_NUM_BUCKETS; ++index) {
+        count += gc_stress_total.buckets[index];
+        if (count >= target && count)
+            return gc_stress_gap_for_bucket(index);
+    }
+    return gc_stress_total.max_gap;
+}
+
+static double gc_stress_handshake_percentile(const zgc_stats* stats, double percentile)
+{
+    unsigned long long target = (unsigned long long)ceil(stats->num_handshakes * percentile);
+    unsigned long long count = 0;
+    unsigned index;
+    for (index = 0; index < ZGC_STATS_NUM_HANDSHAKE_BUCKETS; ++index) {
+        count += stats->handshake_histogram[index];
+        if (count >= target && count)
+            return ldexp(1, (int)index);
+    }
+    return stats->max_handshake_time * 1000;
+}
+
+static void gc_stress_begin(void)
+{
+    gc_stress_start_time = gc_stress_now();
+}
+
+/* Call this at the end of the run, while the benchmark's data is still reachable. ops is how many
+   units of work all of the threads did, for the throughput. */
+static void gc_stress_report(const char* name, unsigned long long ops)
+{
+    double seconds = gc_stress_now() - gc_stress_start_time;
+    zgc_stats stats;
+    struct rusage usage;
+
+    zgc_request_and_wait();
+    zgc_get_stats(&stats);
+    getrusage(RUSAGE_SELF, &usage);
+    double peak_rss = (double)usage.ru_maxrss * 1024;
+
+    printf("benchmark: %s\n", name);
+    printf("time: %.3f sec\n", seconds);
+    printf("throughput: %.0f ops/sec\n", ops / seconds);
+    printf("pause p50: %.1f us\n", gc_stress_percentile(0.5));
+    printf("pause p99: %.1f us\n", gc_stress_percentile(0.99));
+    printf("pause p999: %.1f us\n", gc_stress_percentile(0.999));
+    printf("pause max: %.1f us\n", gc_stress_total.max_gap);
+    printf("handshakes: %llu\n", stats.num_handshakes);
+    printf("handshake p50: %.1f us\n", gc_stress_handshake_percentile(&stats, 0.5));
+    printf("handshake p99: %.1f us\n", gc_stress_handshake_percentile(&stats, 0.99));
+    printf("handshake p999: %.1f us\n", gc_stress_handshake_percentile(&stats, 0.999));
+    printf("handshake max: %.1f us\n", stats.max_handshake_time * 1000);
+    printf("gc cycles: %llu\n", stats.num_completed_cycles);
+    printf("gc time: %.3f sec\n", stats.total_cycle_time / 1000);
+    printf("live bytes: %llu\n", stats.last_survived_bytes);
+    printf("peak rss: %.0f\n", peak_rss);
+    if (stats.last_survived_bytes)
+        printf("heap overhead: %.2f\n", peak_rss / stats.last_survived_bytes);
+}
+
+#endif /* GC_STRESS_H */
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measures the throughput of simple pointer-free loops over byte and int arrays, which is where Fil-C
+   most wants the loop vectorizer to kick in.
+
+   The inner loops process the data in blocks of BLOCK_SIZE elements. Loops that provably run shorter
+   than their strip-mined pollcheck period get a fast path with no checks at all, so this is the shape
+   that Fil-C can vectorize. Build this with both Fil-C and a legacy C compiler to compare. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DATA_SIZE (1u << 20)
+#define BLOCK_SIZE 256
+#define NUM_ITERATIONS 2000
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned count_byte_in_block(const unsigned char* data, unsigned size, unsigned char value)
+{
+    unsigned result = 0;
+    unsigned index;
+    for (index = 0; index < size; ++index)
+        result += data[index] == value;
+    return result;
+}
+
+static long find_byte(const unsigned char* data, unsigned size, unsigned char value)
+{
+    unsigned offset;
+    for (offset = 0; offset < size; offset += BLOCK_SIZE) {
+        unsigned block_size = size - offset < BLOCK_SIZE ? size - offset : BLOCK_SIZE;
+        if (count_byte_in_block(data + offset, block_size, value)) {
+            unsigned index;
+            for (index = 0; index < block_size; ++index) {
+                if (data[offset + index] == value)
+                    return offset + index;
+            }
+        }
+    }
+    return -1;
+}
+
+static unsigned checksum_block(const unsigned* data, unsigned size)
+{
+    unsigned result = 0;
+    unsigned index;
+    for (index = 0; index < size; ++index)
+        result += data[index] ^ index;
+    return result;
+}
+
+static unsigned checksum(const unsigned* data, unsigned size)
+{
+    unsigned result = 0;
+    unsigned offset;
+    for (offset = 0; offset < size; offset += BLOCK_SIZE) {
+        unsigned block_size = size - offset < BLOCK_SIZE ? size - offset : BLOCK_SIZE;
+        result = result * 31 + checksum_block(data + offset, block_size);
+    }
+    return result;
+}
+
+static void report(const char* name, double bytes, double seconds)
+{
+    printf("%s: %.3f sec, %.1f MB/sec\n", name, seconds, bytes / seconds / 1e6);
+}
+
+int main(void)
+{
+    unsigned char* bytes = malloc(DATA_SIZE);
+    unsigned* ints = malloc(DATA_SIZE);
+    unsigned num_ints = DATA_SIZE / sizeof(unsigned);
+    unsigned index;
+    unsigned iteration;
+    long found = 0;
+    unsigned sum = 0;
+    double before;
+
+    memset(bytes, 'a', DATA_SIZE);
+    bytes[DATA_SIZE - 1] = 'b';
+    for (index = 0; index < num_ints; ++index)
+        ints[index] = index * 2654435761u;
+
+    before = now();
+    for (iteration = 0; iteration < NUM_ITERATIONS; ++iteration)
+        found += find_byte(bytes, DATA_SIZE, 'b');
+    report("memchr", (double)DATA_SIZE * NUM_ITERATIONS, now() - before);
+
+    before = now();
+    for (iteration = 0; iteration < NUM_ITERATIONS; ++iteration)
+        sum += checksum(ints, num_ints);
+    report("checksum", (double)DATA_SIZE * NUM_ITERATIONS, now() - before);
+
+    if (found != (long)(DATA_SIZE - 1) * NUM_ITERATIONS) {
+        printf("Bad result from memchr: %ld\n", found);
+        return 1;
+    }
+    printf("checksum = %u\n", sum);
+    return 0;
+}
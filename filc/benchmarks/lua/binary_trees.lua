@@ -0,0 +1,28 @@
+-- Allocates and walks lots of short-lived and long-lived trees, which mostly stresses the GC.
+
+local function bottomUpTree(depth)
+    if depth > 0 then
+        depth = depth - 1
+        return { bottomUpTree(depth), bottomUpTree(depth) }
+    end
+    return {}
+end
+
+local function itemCheck(tree)
+    if tree[1] then
+        return 1 + itemCheck(tree[1]) + itemCheck(tree[2])
+    end
+    return 1
+end
+
+local maxDepth = 14
+local longLived = bottomUpTree(maxDepth)
+local total = 0
+for depth = 4, maxDepth, 2 do
+    local iterations = 2 ^ (maxDepth - depth + 4)
+    for _ = 1, iterations do
+        total = total + itemCheck(bottomUpTree(depth))
+    end
+end
+total = total + itemCheck(longLived)
+assert(total == 3156655, total)
@@ -0,0 +1,17 @@
+-- Builds, splits, and pattern-matches strings, which is mostly the string library and interning.
+
+local words = {}
+for i = 1, 2000 do
+    words[i] = string.format("word%d_%s", i, string.rep(string.char(97 + i % 26), i % 7 + 1))
+end
+
+local total = 0
+for _ = 1, 40 do
+    local text = table.concat(words, " ")
+    for word in text:gmatch("%a+%d+_(%a+)") do
+        total = total + #word
+    end
+    local upper = text:upper():gsub("WORD", "w")
+    total = total + #upper
+end
+assert(total > 0)
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measures memmove throughput with and without aux. In Fil-C, copying a buffer that holds ptrs also
+   has to copy the aux entries that describe those ptrs, and barrier them if the GC is marking. This
+   benchmark copies int arrays (no aux), dense ptr arrays, sparse ptr arrays (mostly NULL), and does
+   an overlapping move within a ptr array, so we can see how much the aux path costs relative to the
+   payload copy. Build this with both Fil-C and a legacy C compiler to compare. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_ELEMENTS (1u << 16)
+#define NUM_ITERATIONS 5000
+#define SPARSE_PERIOD 16
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, double bytes, double seconds)
+{
+    printf("%s: %.3f sec, %.1f MB/sec\n", name, seconds, bytes / seconds / 1e6);
+}
+
+static void bench_copy(const char* name, void* dst, const void* src, size_t size)
+{
+    unsigned iteration;
+    double before = now();
+    for (iteration = 0; iteration < NUM_ITERATIONS; ++iteration)
+        memmove(dst, src, size);
+    report(name, (double)size * NUM_ITERATIONS, now() - before);
+}
+
+static void bench_overlapping(const char* name, char** array, size_t num_elements)
+{
+    size_t size = (num_elements - 1) * sizeof(char*);
+    unsigned iteration;
+    double before = now();
+    for (iteration = 0; iteration < NUM_ITERATIONS; ++iteration) {
+        if (iteration & 1)
+            memmove(array, array + 1, size);
+        else
+            memmove(array + 1, array, size);
+    }
+    report(name, (double)size * NUM_ITERATIONS, now() - before);
+}
+
+int main(void)
+{
+    size_t ints_size = NUM_ELEMENTS * sizeof(unsigned long);
+    size_t ptrs_size = NUM_ELEMENTS * sizeof(char*);
+    unsigned long* src_ints = malloc(ints_size);
+    unsigned long* dst_ints = malloc(ints_size);
+    char** src_dense = malloc(ptrs_size);
+    char** src_sparse = malloc(ptrs_size);
+    char** dst_ptrs = malloc(ptrs_size);
+    char* target = malloc(NUM_ELEMENTS);
+    unsigned index;
+
+    for (index = 0; index < NUM_ELEMENTS; ++index) {
+        src_ints[index] = index * 2654435761u;
+        dst_ints[index] = 0;
+        src_dense[index] = target + index;
+        src_sparse[index] = index % SPARSE_PERIOD ? NULL : target + index;
+        dst_ptrs[index] = target;
+    }
+
+    bench_copy("ints", dst_ints, src_ints, ints_size);
+    bench_copy("dense ptrs", dst_ptrs, src_dense, ptrs_size);
+    bench_copy("sparse ptrs", dst_ptrs, src_sparse, ptrs_size);
+    memcpy(dst_ptrs, src_dense, ptrs_size);
+
+    for (index = 0; index < NUM_ELEMENTS; ++index) {
+        if (dst_ints[index] != src_ints[index]) {
+            printf("Bad int at %u\n", index);
+            return 1;
+        }
+        if (dst_ptrs[index] != target + index) {
+            printf("Bad ptr at %u\n", index);
+            return 1;
+        }
+    }
+
+    bench_overlapping("overlapping ptrs", dst_ptrs, NUM_ELEMENTS);
+    return 0;
+}
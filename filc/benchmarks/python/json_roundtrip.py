@@ -0,0 +1,23 @@
+# Serializes and parses a nested document, like pyperformance's json_dumps and json_loads. This
+# exercises the C accelerator in the json module, string building, and dict and list allocation.
+
+import json
+
+DOCUMENT = {
+    "id": 12345,
+    "name": "benchmark document",
+    "tags": ["fil-c", "memory safety", "garbage collection", "été"],
+    "values": [i * 0.5 for i in range(100)],
+    "children": [
+        {"index": i, "title": "child %d" % i, "flags": [True, False, None], "ratio": i / 7.0}
+        for i in range(50)
+    ],
+}
+
+total = 0
+for _ in range(2000):
+    text = json.dumps(DOCUMENT, sort_keys=True)
+    decoded = json.loads(text)
+    total += len(text) + len(decoded["children"])
+assert decoded == DOCUMENT
+assert total > 0
@@ -0,0 +1,27 @@
+# Runs a few regular expressions over generated text, like pyperformance's regex benchmarks. This
+# is mostly the sre engine and string slicing.
+
+import random
+import re
+
+rng = random.Random(42)
+WORDS = ["alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta"]
+lines = []
+for i in range(20000):
+    words = " ".join(rng.choice(WORDS) for _ in range(8))
+    lines.append("%05d %s user%d@example.com http://host%d.example.org/path?q=%d"
+                 % (i, words, i % 97, i % 13, i))
+text = "\n".join(lines)
+
+PATTERNS = [
+    re.compile(r"[\w.+-]+@[\w.-]+\.\w+"),
+    re.compile(r"\w+://[^/\s?#]+[^\s?#]+(?:\?[^\s#]*)?"),
+    re.compile(r"\b(gamma|theta) (alpha|beta)\b"),
+    re.compile(r"^\d{5}", re.MULTILINE),
+]
+
+total = 0
+for _ in range(5):
+    for pattern in PATTERNS:
+        total += len(pattern.findall(text))
+assert total > 0
@@ -18,7 +18,14 @@
 **                                       the main loop 100x more often)
 */
 
+#ifdef __PIZLONATOR_WAS_HERE__
 #include <stdfil.h>
+#else
+/* Lets run_benchmarks.rb build this with a legacy compiler. */
+#include <stdio.h>
+#define zgc_alloc malloc
+#define zprintf printf
+#endif
 #include <stdlib.h>
 
 #ifdef bench100
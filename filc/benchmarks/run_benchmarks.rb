@@ -0,0 +1,103 @@
+#!/usr/bin/env ruby
+#
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# Builds the benchmarks with Fil-C and with a legacy compiler, runs each one several times, and
+# reports how much slower the Fil-C build is. If perf is available, the runs are wrapped in perf
+# stat to also get hardware counters. Fil-C runs also report how many FUGC cycles happened and how
+# long they took, by way of FUGC_VERBOSE=1.
+#
+# Usage: ./run_benchmarks.rb [--runs N] [--json FILE] [--no-build] [--no-perf]
+#                            [--pcre-input FILE] [benchmark...]
+#
+# The legacy compiler defaults to clang and clang++; set LEGACY_CC and LEGACY_CXX to change that.
+
+require 'optparse'
+require_relative 'benchmark_harness'
+
+$scriptDir = File.dirname(File.absolute_path(__FILE__))
+$binDir = File.join($scriptDir, "..", "..", "pizfix", "benchmarks")
+
+$runs = 5
+$jsonPath = nil
+$build = true
+$usePerf = true
+$pcreInput = nil
+
+OptionParser.new {
+    | opts |
+    opts.banner = "Usage: run_benchmarks.rb [options] [benchmark...]"
+    opts.on("--runs N", Integer, "How many times to run each benchmark (default 5)") {
+        | value |
+        $runs = value
+    }
+    opts.on("--json FILE", "Write the results to FILE as JSON") {
+        | value |
+        $jsonPath = value
+    }
+    opts.on("--no-build", "Don't rebuild the benchmarks first") {
+        $build = false
+    }
+    opts.on("--no-perf", "Don't collect hardware counters") {
+        $usePerf = false
+    }
+    opts.on("--pcre-input FILE", "Input for pcre_benchmark, which is skipped without one") {
+        | value |
+        $pcreInput = File.absolute_path(value)
+    }
+}.parse!
+
+$benchmarks = [
+    { "name" => "richards", "args" => [] },
+    { "name" => "deltablue", "args" => [] },
+    { "name" => "stepanov_container", "args" => [] },
+    { "name" => "loop_benchmark", "args" => [] },
+    { "name" => "memmove_benchmark", "args" => [] },
+]
+if $pcreInput
+    $benchmarks << { "name" => "pcre_benchmark", "args" => [ $pcreInput ] }
+end
+unless ARGV.empty?
+    $benchmarks = $benchmarks.select { | benchmark | ARGV.include? benchmark["name"] }
+end
+
+checkPerf
+
+if $build
+    Dir.chdir($scriptDir) {
+        mysys("mkdir", "-p", $binDir)
+        mysys("make", "-j", "all", "legacy")
+    }
+end
+
+$results = {}
+$benchmarks.each {
+    | benchmark |
+    name = benchmark["name"]
+    $results[name] = compare([ File.join($binDir, name) ] + benchmark["args"],
+                             [ File.join($binDir, "legacy", name) ] + benchmark["args"])
+}
+
+printResults($results)
+writeResults($jsonPath, $results) if $jsonPath
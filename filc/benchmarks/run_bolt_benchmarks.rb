@@ -0,0 +1,191 @@
+#!/usr/bin/env ruby
+#
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# Builds the benchmarks with Fil-C, linked with --emit-relocs, profiles each one with perf record,
+# rewrites it with llvm-bolt using that profile, and then runs the original and the bolted binary
+# interleaved, several times, and reports how much BOLT sped each one up.
+#
+# Usage: ./run_bolt_benchmarks.rb [--runs N] [--json FILE] [--no-build] [--no-lbr]
+#                                 [--bolt-dir DIR] [--pcre-input FILE] [benchmark...]
+#
+# llvm-bolt and perf2bolt come from build/bin unless --bolt-dir says otherwise. configure_llvm.sh
+# doesn't build them, so reconfigure with -DLLVM_ENABLE_PROJECTS="clang;bolt" and then run
+# "ninja llvm-bolt perf2bolt" in build.
+#
+# The same flow works for any Fil-C program:
+#
+#     clang -O3 -g -Wl,--emit-relocs -o prog prog.c
+#     perf record -e cycles:u -j any,u -o perf.data -- ./prog
+#     perf2bolt -p perf.data -o prog.fdata ./prog
+#     llvm-bolt ./prog -o prog.bolt -data=prog.fdata -reorder-blocks=ext-tsp \
+#         -reorder-functions=hfsort+ -split-functions -split-all-cold -dyno-stats
+#
+# Without LBR (most VMs don't have it), leave out "-j any,u" and pass -nl to perf2bolt. The profile
+# is a lot less precise then, so expect less of a gain. This only rewrites the program; the runtime
+# lives in libpizlo.so and would have to be linked with --emit-relocs and bolted on its own.
+#
+# Things about pizlonated code that BOLT has to get right:
+#
+# - Failed checks call filc_access_check_fail_thunk and friends, which never return. BOLT knows
+#   those names, so it doesn't invent a fall-through out of the failure block, and the profile2
+#   split strategy always puts failure blocks in the cold fragment, even if sampling skid gave them
+#   a count. Pass -filc-failure-calls=0 to llvm-bolt to turn that off.
+# - Splitting is safe around the filc_frame origin stores. Origins are constant data that point to
+#   names, lines and EH tables, never to code, and Fil-C stack traces and exceptions are found from
+#   the filc_frame chain rather than from return addresses. Pizlonated code has no DWARF landing
+#   pads, since Fil-C lowers invokes itself, so -split-eh makes no difference to it.
+# - The stack check is "cmp %rsp, ...; jae filc_stack_overflow_failure@PLT", which BOLT sees as a
+#   conditional tail call and keeps as one.
+# - Global and function getters are ordinary functions, and get reordered like any other.
+
+require 'optparse'
+require_relative 'benchmark_harness'
+
+$scriptDir = File.dirname(File.absolute_path(__FILE__))
+$binDir = File.join($scriptDir, "..", "..", "pizfix", "benchmarks", "bolt")
+$boltDir = File.join($scriptDir, "..", "..", "build", "bin")
+
+$runs = 5
+$jsonPath = nil
+$build = true
+$useLBR = true
+$usePerf = false
+$pcreInput = nil
+
+BOLT_FLAGS = [ "-reorder-blocks=ext-tsp", "-reorder-functions=hfsort+", "-split-functions",
+               "-split-all-cold", "-dyno-stats" ]
+
+OptionParser.new {
+    | opts |
+    opts.banner = "Usage: run_bolt_benchmarks.rb [options] [benchmark...]"
+    opts.on("--runs N", Integer, "How many times to run each binary (default 5)") {
+        | value |
+        $runs = value
+    }
+    opts.on("--json FILE", "Write the results to FILE as JSON") {
+        | value |
+        $jsonPath = value
+    }
+    opts.on("--no-build", "Don't rebuild the benchmarks first") {
+        $build = false
+    }
+    opts.on("--no-lbr", "Profile without LBR even if the machine has it") {
+        $useLBR = false
+    }
+    opts.on("--bolt-dir DIR", "Where to find llvm-bolt and perf2bolt (default build/bin)") {
+        | value |
+        $boltDir = File.absolute_path(value)
+    }
+    opts.on("--pcre-input FILE", "Input for pcre_benchmark, which is skipped without one") {
+        | value |
+        $pcreInput = File.absolute_path(value)
+    }
+}.parse!
+
+$benchmarks = [
+    { "name" => "richards", "args" => [] },
+    { "name" => "deltablue", "args" => [] },
+    { "name" => "stepanov_container", "args" => [] },
+    { "name" => "loop_benchmark", "args" => [] },
+    { "name" => "memmove_benchmark", "args" => [] },
+]
+if $pcreInput
+    $benchmarks << { "name" => "pcre_benchmark", "args" => [ $pcreInput ] }
+end
+unless ARGV.empty?
+    $benchmarks = $benchmarks.select { | benchmark | ARGV.include? benchmark["name"] }
+end
+
+$llvmBolt = File.join($boltDir, "llvm-bolt")
+$perf2bolt = File.join($boltDir, "perf2bolt")
+[ $llvmBolt, $perf2bolt ].each {
+    | tool |
+    raise "Could not find #{tool}." unless File.executable? tool
+}
+unless system("perf record -o /dev/null -e cycles:u -- true > /dev/null 2>&1")
+    raise "perf record doesn't work here."
+end
+if $useLBR and not system("perf record -o /dev/null -e cycles:u -j any,u -- true > /dev/null 2>&1")
+    $stderr.puts "This machine has no LBR, so profiling without it."
+    $useLBR = false
+end
+
+if $build
+    Dir.chdir($scriptDir) {
+        mysys("make", "-j", "bolt")
+    }
+end
+
+def bolt(binary, args)
+    perfData = binary + ".perf.data"
+    fdata = binary + ".fdata"
+    bolted = binary + ".bolt"
+    cmd = [ "perf", "record", "-q", "-e", "cycles:u", "-o", perfData ]
+    cmd += [ "-j", "any,u" ] if $useLBR
+    mysys(*(cmd + [ "--", binary ] + args), :out => File::NULL)
+    cmd = [ $perf2bolt, "-p", perfData, "-o", fdata ]
+    cmd << "-nl" unless $useLBR
+    mysys(*(cmd + [ binary ]), :out => File::NULL)
+    mysys($llvmBolt, binary, "-o", bolted, "-data=#{fdata}", *BOLT_FLAGS, :out => File::NULL)
+    bolted
+end
+
+$results = {}
+$benchmarks.each {
+    | benchmark |
+    name = benchmark["name"]
+    binary = File.join($binDir, name)
+    bolted = bolt(binary, benchmark["args"])
+    baseRuns = []
+    boltedRuns = []
+    $runs.times {
+        baseRuns << runOnce([ binary ] + benchmark["args"], true)
+        boltedRuns << runOnce([ bolted ] + benchmark["args"], true)
+    }
+    base = summarize(baseRuns)
+    boltedSummary = summarize(boltedRuns)
+    $results[name] = { "base" => base, "bolted" => boltedSummary,
+                       "speedup" => base["time"] / boltedSummary["time"] }
+}
+
+puts "%-24s %10s %10s %8s" % [ "benchmark", "base (s)", "bolted (s)", "speedup" ]
+$results.each_pair {
+    | name, result |
+    puts "%-24s %10.3f %10.3f %8.2f" % [ name, result["base"]["time"], result["bolted"]["time"],
+                                        result["speedup"] ]
+}
+speedups = $results.values.map { | result | result["speedup"] }
+unless speedups.empty?
+    puts "geomean speedup: %.2f" % Math.exp(speedups.map { | value | Math.log(value) }.sum /
+                                            speedups.size)
+end
+
+if $jsonPath
+    File.open($jsonPath, "w") {
+        | outp |
+        outp.puts JSON.pretty_generate({ "runs_per_benchmark" => $runs, "lbr" => $useLBR,
+                                         "bolt_flags" => BOLT_FLAGS, "results" => $results })
+    }
+end
@@ -0,0 +1,120 @@
+#!/usr/bin/env ruby
+#
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# Runs the GC stress benchmarks (gc_*.c) several times and reports the median of each of their
+# metrics: throughput, mutator pause percentiles, FUGC's handshake latency percentiles, and peak
+# RSS relative to live bytes. There are no legacy builds of these to compare against; instead, run
+# this before and after a GC change, or with different FUGC_* environment variables, and compare
+# the JSON output.
+#
+# Usage: ./run_gc_benchmarks.rb [--runs N] [--json FILE] [--no-build] [benchmark...]
+
+require 'optparse'
+require_relative 'benchmark_harness'
+
+$scriptDir = File.dirname(File.absolute_path(__FILE__))
+$binDir = File.join($scriptDir, "..", "..", "pizfix", "benchmarks")
+
+$runs = 5
+$jsonPath = nil
+$build = true
+$usePerf = false
+
+OptionParser.new {
+    | opts |
+    opts.banner = "Usage: run_gc_benchmarks.rb [options] [benchmark...]"
+    opts.on("--runs N", Integer, "How many times to run each benchmark (default 5)") {
+        | value |
+        $runs = value
+    }
+    opts.on("--json FILE", "Write the results to FILE as JSON") {
+        | value |
+        $jsonPath = value
+    }
+    opts.on("--no-build", "Don't rebuild the benchmarks first") {
+        $build = false
+    }
+}.parse!
+
+$benchmarks = [ "gc_binary_trees", "gc_lru_cache", "gc_large_array", "gc_many_threads" ]
+unless ARGV.empty?
+    $benchmarks = $benchmarks.select { | benchmark | ARGV.include? benchmark }
+end
+
+# The metrics that gc_stress_report() prints, in the order we print them.
+METRICS = [ "throughput", "pause p50", "pause p99", "pause p999", "pause max", "handshakes",
+            "handshake p50", "handshake p99", "handshake p999", "handshake max", "gc cycles",
+            "gc time", "live bytes", "peak rss", "heap overhead" ]
+
+def parseMetrics(stdout)
+    result = {}
+    stdout.each_line {
+        | line |
+        next unless line =~ /^([a-z0-9 ]+): ([0-9.]+)/
+        result[$1] = $2.to_f if METRICS.include? $1
+    }
+    result
+end
+
+if $build
+    Dir.chdir($scriptDir) {
+        mysys("mkdir", "-p", $binDir)
+        mysys("make", "-j", "gc")
+    }
+end
+
+$results = {}
+$benchmarks.each {
+    | name |
+    runs = []
+    $runs.times {
+        runs << parseMetrics(runOnce([ File.join($binDir, name) ], true, nil, true)["stdout"])
+    }
+    summary = {}
+    METRICS.each {
+        | metric |
+        values = runs.map { | run | run[metric] }.compact
+        summary[metric] = median(values) unless values.empty?
+    }
+    $results[name] = { "runs" => runs, "median" => summary }
+}
+
+puts "%-16s %12s %9s %9s %9s %9s %9s %8s" % [ "benchmark", "ops/sec", "p50 (us)", "p99 (us)",
+                                              "p999 (us)", "hs p99", "hs max", "overhead" ]
+$results.each_pair {
+    | name, result |
+    summary = result["median"]
+    puts "%-16s %12.0f %9.1f %9.1f %9.1f %9.1f %9.1f %8.2f" % [
+        name, summary["throughput"] || 0, summary["pause p50"] || 0, summary["pause p99"] || 0,
+        summary["pause p999"] || 0, summary["handshake p99"] || 0, summary["handshake max"] || 0,
+        summary["heap overhead"] || 0 ]
+}
+
+if $jsonPath
+    File.open($jsonPath, "w") {
+        | outp |
+        outp.puts JSON.pretty_generate({ "runs_per_benchmark" => $runs, "results" => $results })
+    }
+end
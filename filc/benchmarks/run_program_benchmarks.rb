@@ -0,0 +1,244 @@
+#!/usr/bin/env ruby
+#
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# Benchmarks the programs that we port to Fil-C, comparing the pizfix builds against legacy builds
+# of the same programs: compression throughput for zlib, xz and bzip2, sqlite's speedtest1, openssl
+# speed, and a few Lua and Python workloads in the style of pyperformance.
+#
+# Usage: ./run_program_benchmarks.rb [--runs N] [--json FILE] [--no-perf] [benchmark...]
+#
+# The Fil-C programs come from ../../pizfix, so run the build_*.sh scripts first. The legacy
+# programs come from $LEGACY_PREFIX/bin (default /usr/bin); LEGACY_LUA and LEGACY_PYTHON override
+# the interpreters. minigzip and speedtest1 aren't installed by anything, so this builds both
+# flavors of them from zlib-1.3 and pizlonated-sqlite, using LEGACY_CC (default clang) for the
+# legacy ones.
+# Benchmarks whose programs are missing are skipped.
+#
+# The compression benchmarks use a generated text corpus. The generator is seeded, so the corpus is
+# the same on every machine and every run, and results can be compared release over release.
+
+require 'fileutils'
+require 'optparse'
+require_relative 'benchmark_harness'
+
+$scriptDir = File.dirname(File.absolute_path(__FILE__))
+$repoDir = File.absolute_path(File.join($scriptDir, "..", ".."))
+$pizfixDir = File.join($repoDir, "pizfix")
+$binDir = File.join($pizfixDir, "benchmarks")
+$corpusDir = File.join($binDir, "corpus")
+$legacyPrefix = ENV["LEGACY_PREFIX"] || "/usr"
+$legacyCC = ENV["LEGACY_CC"] || "clang"
+
+$runs = 5
+$jsonPath = nil
+$usePerf = true
+
+CORPUS_SIZE = 8 * 1024 * 1024
+
+OptionParser.new {
+    | opts |
+    opts.banner = "Usage: run_program_benchmarks.rb [options] [benchmark...]"
+    opts.on("--runs N", Integer, "How many times to run each benchmark (default 5)") {
+        | value |
+        $runs = value
+    }
+    opts.on("--json FILE", "Write the results to FILE as JSON") {
+        | value |
+        $jsonPath = value
+    }
+    opts.on("--no-perf", "Don't collect hardware counters") {
+        $usePerf = false
+    }
+}.parse!
+
+def filcBin(name)
+    File.join($pizfixDir, "bin", name)
+end
+
+def legacyBin(name)
+    File.join($legacyPrefix, "bin", name)
+end
+
+# Text that looks a bit like logs: a skewed choice of words from a made-up vocabulary, plus numbers.
+# That gives the compressors something between random bytes and a repeated string to work on.
+def makeCorpus(path)
+    random = Random.new(20241130)
+    vocabulary = (0...4096).map {
+        (0...(2 + random.rand(9))).map { ("a".ord + random.rand(26)).chr }.join
+    }
+    File.open(path, "w") {
+        | outp |
+        size = 0
+        lineNumber = 0
+        while size < CORPUS_SIZE
+            words = (0...(4 + random.rand(12))).map {
+                vocabulary[(random.rand ** 3 * vocabulary.size).to_i]
+            }
+            line = "%08d %s %d\n" % [ lineNumber, words.join(" "), random.rand(100000) ]
+            outp.write(line)
+            size += line.size
+            lineNumber += 1
+        end
+    }
+end
+
+# Builds a single-file program against the libraries in a prefix. Returns the path to the binary, or
+# nil if the source or compiler isn't there or the build fails.
+def buildTool(name, source, cc, outDir, flags)
+    return nil unless File.exist? source
+    FileUtils.mkdir_p(outDir)
+    output = File.join(outDir, name)
+    unless system(cc, "-O3", "-g", "-o", output, source, *flags)
+        $stderr.puts "Could not build #{output}."
+        return nil
+    end
+    output
+end
+
+def openSSLThroughput(stdout)
+    # With -mr, each algorithm prints a +F line whose last fields are bytes per second for each
+    # block size. We sum them up so that every block size counts.
+    total = 0.0
+    stdout.each_line {
+        | line |
+        next unless line.start_with? "+F:"
+        line.strip.split(':')[3..-1].each { | field | total += field.to_f }
+    }
+    raise "No throughput in openssl speed output" if total == 0
+    total
+end
+
+checkPerf
+
+FileUtils.mkdir_p($corpusDir)
+$corpus = File.join($corpusDir, "corpus.txt")
+makeCorpus($corpus) unless File.exist? $corpus
+
+filcCC = File.join($repoDir, "build", "bin", "clang")
+filcFlags = [ "-I#{$pizfixDir}/include", "-L#{$pizfixDir}/lib" ]
+zlibTest = File.join($repoDir, "zlib-1.3", "test", "minigzip.c")
+speedtest = File.join($repoDir, "pizlonated-sqlite", "test", "speedtest1.c")
+$tools = {
+    "filc" => {
+        "minigzip" => buildTool("minigzip", zlibTest, filcCC, $binDir, filcFlags + [ "-lz" ]),
+        "speedtest1" => buildTool("speedtest1", speedtest, filcCC, $binDir,
+                                  filcFlags + [ "-lsqlite3" ]),
+    },
+    "legacy" => {
+        "minigzip" => buildTool("minigzip", zlibTest, $legacyCC, File.join($binDir, "legacy"),
+                                [ "-lz" ]),
+        "speedtest1" => buildTool("speedtest1", speedtest, $legacyCC,
+                                  File.join($binDir, "legacy"), [ "-lsqlite3" ]),
+    },
+}
+
+# Each benchmark has the Fil-C and legacy commands, and optionally a file to use as stdin. The
+# decompression benchmarks also say how to make their compressed input.
+$benchmarks = []
+
+[ [ "zlib", $tools["filc"]["minigzip"], $tools["legacy"]["minigzip"], [ "-9" ], [ "-d" ], "gz" ],
+  [ "xz", filcBin("xz"), legacyBin("xz"), [ "-c", "-6" ], [ "-dc" ], "xz" ],
+  [ "bzip2", filcBin("bzip2"), legacyBin("bzip2"), [ "-c", "-9" ], [ "-dc" ], "bz2" ] ].each {
+    | name, filc, legacy, compressArgs, decompressArgs, extension |
+    $benchmarks << {
+        "name" => "#{name}-compress",
+        "filc" => [ filc ] + compressArgs,
+        "legacy" => [ legacy ] + compressArgs,
+        "stdin" => $corpus,
+    }
+    $benchmarks << {
+        "name" => "#{name}-decompress",
+        "filc" => [ filc ] + decompressArgs,
+        "legacy" => [ legacy ] + decompressArgs,
+        "stdin" => "#{$corpus}.#{extension}",
+        "makeStdin" => [ legacy ] + compressArgs,
+    }
+}
+
+$benchmarks << {
+    "name" => "sqlite-speedtest1",
+    "filc" => [ $tools["filc"]["speedtest1"], "--size", "25", "--memdb" ],
+    "legacy" => [ $tools["legacy"]["speedtest1"], "--size", "25", "--memdb" ],
+}
+
+[ "sha256", "aes-128-cbc", "chacha20-poly1305" ].each {
+    | algorithm |
+    args = [ "speed", "-mr", "-seconds", "2", "-evp", algorithm ]
+    $benchmarks << {
+        "name" => "openssl-speed-#{algorithm}",
+        "filc" => [ filcBin("openssl") ] + args,
+        "legacy" => [ legacyBin("openssl") ] + args,
+        "score" => method(:openSSLThroughput),
+    }
+}
+
+legacyLua = ENV["LEGACY_LUA"] || legacyBin("lua")
+Dir.glob(File.join($scriptDir, "lua", "*.lua")).sort.each {
+    | script |
+    $benchmarks << {
+        "name" => "lua-#{File.basename(script, ".lua")}",
+        "filc" => [ filcBin("lua"), script ],
+        "legacy" => [ legacyLua, script ],
+    }
+}
+
+legacyPython = ENV["LEGACY_PYTHON"] || legacyBin("python3")
+Dir.glob(File.join($scriptDir, "python", "*.py")).sort.each {
+    | script |
+    $benchmarks << {
+        "name" => "python-#{File.basename(script, ".py")}",
+        "filc" => [ filcBin("python3"), script ],
+        "legacy" => [ legacyPython, script ],
+    }
+}
+
+unless ARGV.empty?
+    $benchmarks = $benchmarks.select { | benchmark | ARGV.include? benchmark["name"] }
+end
+
+$results = {}
+$benchmarks.each {
+    | benchmark |
+    name = benchmark["name"]
+    missing = [ benchmark["filc"][0], benchmark["legacy"][0] ].reject {
+        | path |
+        path and File.executable? path
+    }
+    unless missing.empty?
+        names = missing.map { | path | path || "a tool that could not be built" }
+        $stderr.puts "Skipping #{name}, since #{names.join(" and ")} is missing."
+        next
+    end
+    if benchmark["makeStdin"] and not File.exist? benchmark["stdin"]
+        unless system(*benchmark["makeStdin"], :in => $corpus, :out => benchmark["stdin"])
+            raise "Could not make #{benchmark["stdin"]}"
+        end
+    end
+    $results[name] = compare(benchmark["filc"], benchmark["legacy"], benchmark["stdin"],
+                             &benchmark["score"])
+}
+
+printResults($results)
+writeResults($jsonPath, $results) if $jsonPath
@@ -0,0 +1,120 @@
+#!/usr/bin/env ruby
+#
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# Runs syscall_benchmark built with Fil-C and with a legacy compiler, interleaved, several times,
+# and reports the median cost of each call in both builds. The difference is what Fil-C's syscall
+# wrappers (argument checks, exit and enter, errno translation) cost per call. Use --json to save a
+# baseline, and compare against it after changing the syscall paths.
+#
+# Usage: ./run_syscall_benchmarks.rb [--runs N] [--scale X] [--json FILE] [--no-build] [call...]
+#
+# The legacy compiler defaults to clang; set LEGACY_CC to change that.
+
+require 'optparse'
+require_relative 'benchmark_harness'
+
+$scriptDir = File.dirname(File.absolute_path(__FILE__))
+$binDir = File.join($scriptDir, "..", "..", "pizfix", "benchmarks")
+
+$runs = 5
+$scale = 1.0
+$jsonPath = nil
+$build = true
+$usePerf = false
+
+OptionParser.new {
+    | opts |
+    opts.banner = "Usage: run_syscall_benchmarks.rb [options] [call...]"
+    opts.on("--runs N", Integer, "How many times to run each build (default 5)") {
+        | value |
+        $runs = value
+    }
+    opts.on("--scale X", Float, "Multiply the number of iterations by X (default 1)") {
+        | value |
+        $scale = value
+    }
+    opts.on("--json FILE", "Write the results to FILE as JSON") {
+        | value |
+        $jsonPath = value
+    }
+    opts.on("--no-build", "Don't rebuild the benchmark first") {
+        $build = false
+    }
+}.parse!
+
+def parseCalls(stdout)
+    result = {}
+    stdout.each_line {
+        | line |
+        next unless line =~ /^([a-zA-Z_ +]+): ([0-9.]+) ns\/call/
+        result[$1] = $2.to_f
+    }
+    result
+end
+
+if $build
+    Dir.chdir($scriptDir) {
+        mysys("mkdir", "-p", $binDir)
+        mysys("make", "-j", "syscalls")
+    }
+end
+
+filcCmd = [ File.join($binDir, "syscall_benchmark"), $scale.to_s ]
+legacyCmd = [ File.join($binDir, "legacy", "syscall_benchmark"), $scale.to_s ]
+
+filcRuns = []
+legacyRuns = []
+$runs.times {
+    filcRuns << parseCalls(runOnce(filcCmd, true, nil, true)["stdout"])
+    legacyRuns << parseCalls(runOnce(legacyCmd, false, nil, true)["stdout"])
+}
+
+calls = filcRuns[0].keys
+calls = calls.select { | call | ARGV.include? call } unless ARGV.empty?
+
+$results = {}
+calls.each {
+    | call |
+    filc = median(filcRuns.map { | run | run[call] }.compact)
+    legacy = median(legacyRuns.map { | run | run[call] }.compact)
+    $results[call] = { "filc_ns" => filc, "legacy_ns" => legacy, "overhead_ns" => filc - legacy,
+                       "ratio" => legacy > 0 ? filc / legacy : nil }
+}
+
+puts "%-20s %12s %12s %12s %8s" % [ "call", "filc (ns)", "legacy (ns)", "overhead", "ratio" ]
+$results.each_pair {
+    | call, result |
+    puts "%-20s %12.1f %12.1f %12.1f %8s" % [
+        call, result["filc_ns"], result["legacy_ns"], result["overhead_ns"],
+        result["ratio"] ? "%.2f" % result["ratio"] : "-" ]
+}
+
+if $jsonPath
+    File.open($jsonPath, "w") {
+        | outp |
+        outp.puts JSON.pretty_generate({ "runs" => $runs, "scale" => $scale, "results" => $results,
+                                         "filc_runs" => filcRuns, "legacy_runs" => legacyRuns })
+    }
+end
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measures the per-call cost of system calls. In Fil-C, every syscall goes through a wrapper that
+   checks its arguments, exits and re-enters (which are CASes on the thread state), and translates
+   errno, so that's what the difference from a legacy build shows. The calls are picked to be cheap
+   in the kernel, so that the wrapper is a big part of what we measure:
+
+   - getpid and clock_gettime, which are about as cheap as calls get (clock_gettime is a vDSO call
+     in legacy builds).
+   - write and read of one byte on a pipe.
+   - epoll_wait with a zero timeout on an eventfd that is always readable.
+   - futex wake with no waiters and futex wait on a value that doesn't match.
+   - sendmsg and recvmsg of one byte on a datagram socket pair.
+   - ioctl(FIONREAD) on a pipe.
+
+   Prints one "name: N ns/call" line per call. Build this with both Fil-C and a legacy C compiler,
+   or use run_syscall_benchmarks.rb, which does both and compares them. The optional argument scales
+   the number of iterations. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __PIZLONATOR_WAS_HERE__
+#include <pizlonated_syscalls.h>
+#else
+#include <linux/futex.h>
+#endif
+
+#define BASE_ITERATIONS 1000000
+
+static unsigned long num_iterations;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void check(int result, const char* what)
+{
+    if (result < 0) {
+        fprintf(stderr, "%s failed: %s\n", what, strerror(errno));
+        exit(1);
+    }
+}
+
+static void report(const char* name, double seconds, unsigned calls_per_iteration)
+{
+    printf("%s: %.1f ns/call\n",
+           name, seconds * 1e9 / ((double)num_iterations * calls_per_iteration));
+}
+
+static void bench_getpid(void)
+{
+    unsigned long iteration;
+    pid_t pid = getpid();
+    double before = now();
+    for (iteration = num_iterations; iteration--;) {
+        if (getpid() != pid)
+            abort();
+    }
+    report("getpid", now() - before, 1);
+}
+
+static void bench_clock_gettime(void)
+{
+    unsigned long iteration;
+    struct timespec ts;
+    double before = now();
+    for (iteration = num_iterations; iteration--;)
+        check(clock_gettime(CLOCK_MONOTONIC, &ts), "clock_gettime");
+    report("clock_gettime", now() - before, 1);
+}
+
+static void bench_pipe(void)
+{
+    int fds[2];
+    check(pipe(fds), "pipe");
+    unsigned long iteration;
+    char byte = 42;
+    double before = now();
+    for (iteration = num_iterations; iteration--;) {
+        if (write(fds[1], &byte, 1) != 1)
+            check(-1, "write");
+        if (read(fds[0], &byte, 1) != 1)
+            check(-1, "read");
+    }
+    report("pipe write+read", now() - before, 2);
+
+    int available;
+    before = now();
+    for (iteration = num_iterations; iteration--;)
+        check(ioctl(fds[0], FIONREAD, &available), "ioctl");
+    report("ioctl FIONREAD", now() - before, 1);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void bench_epoll_wait(void)
+{
+    int efd = eventfd(1, EFD_NONBLOCK);
+    check(efd, "eventfd");
+    int epfd = epoll_create1(0);
+    check(epfd, "epoll_create1");
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = efd;
+    check(epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &event), "epoll_ctl");
+    unsigned long iteration;
+    struct epoll_event events[4];
+    double before = now();
+    for (iteration = num_iterations; iteration--;) {
+        if (epoll_wait(epfd, events, 4, 0) != 1)
+            check(-1, "epoll_wait");
+    }
+    report("epoll_wait", now() - before, 1);
+    close(epfd);
+    close(efd);
+}
+
+static int futex_word;
+
+static void futex_wake_no_waiters(void)
+{
+#ifdef __PIZLONATOR_WAS_HERE__
+    zsys_futex_wake(&futex_word, 1, 1);
+#else
+    syscall(SYS_futex, &futex_word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+static void futex_wait_mismatch(void)
+{
+#ifdef __PIZLONATOR_WAS_HERE__
+    zsys_futex_wait(&futex_word, 1, 1);
+#else
+    syscall(SYS_futex, &futex_word, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+static void bench_futex(void)
+{
+    unsigned long iteration;
+    double before = now();
+    for (iteration = num_iterations; iteration--;)
+        futex_wake_no_waiters();
+    report("futex wake", now() - before, 1);
+
+    /* The word is 0, so waiting for 1 returns EAGAIN right away. */
+    before = now();
+    for (iteration = num_iterations; iteration--;)
+        futex_wait_mismatch();
+    report("futex wait", now() - before, 1);
+}
+
+static void bench_msg(void)
+{
+    int fds[2];
+    check(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), "socketpair");
+    char byte = 42;
+    struct iovec iov;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    unsigned long iteration;
+    double before = now();
+    for (iteration = num_iterations; iteration--;) {
+        iov.iov_base = &byte;
+        iov.iov_len = 1;
+        if (sendmsg(fds[1], &msg, 0) != 1)
+            check(-1, "sendmsg");
+        iov.iov_base = &byte;
+        iov.iov_len = 1;
+        if (recvmsg(fds[0], &msg, 0) != 1)
+            check(-1, "recvmsg");
+    }
+    report("sendmsg+recvmsg", now() - before, 2);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main(int argc, char** argv)
+{
+    double scale = argc >= 2 ? atof(argv[1]) : 1.;
+    num_iterations = (unsigned long)(BASE_ITERATIONS * scale);
+    if (!num_iterations)
+        num_iterations = 1;
+
+    bench_getpid();
+    bench_clock_gettime();
+    bench_pipe();
+    bench_epoll_wait();
+    bench_futex();
+    bench_msg();
+    return 0;
+}
@@ -104,11 +104,17 @@ int zsys_chown(const char* pathname, unsigned owner, unsigned group);
 int zsys_lchown(const char* pathname, unsigned owner, unsigned group);
 long zsys_sendmsg(int sockfd, const void* msg, int flags);
 long zsys_recvmsg(int sockfd, void* msg, int flags);
+int zsys_sendmmsg(int sockfd, void* msgvec, unsigned vlen, int flags);
+int zsys_recvmmsg(int sockfd, void* msgvec, unsigned vlen, int flags, void* timeout);
 int zsys_rename(const char* oldname, const char* newname);
 int zsys_unlink(const char* path);
 int zsys_link(const char* oldname, const char* newname);
 void* zsys_mmap(void* address, __SIZE_TYPE__ length, int prot, int flags, int fd, long offset);
 int zsys_munmap(void* address, __SIZE_TYPE__ length);
+/* Only MREMAP_MAYMOVE is supported, since there's no way to ask for a new address. The memory
+   after a mapping belongs to the GC heap, so growing fails with ENOMEM unless the mapping may
+   move. Moving doesn't copy, but pointers stored in the mapping don't move with it. */
+void* zsys_mremap(void* old_address, __SIZE_TYPE__ old_size, __SIZE_TYPE__ new_size, int flags);
 int zsys_ftruncate(int fd, long length);
 char* zsys_getcwd(char* buf, __SIZE_TYPE__ size);
 void* zsys_dlopen(const char* filename, int flags); /* FIXME: we should add dlclose support eventually,
@@ -116,6 +122,10 @@ void* zsys_dlopen(const char* filename, int flags); /* FIXME: we should add dlcl
                                                        globals are GC-allocated. Which is fine, we could
                                                        do that. */
 void* zsys_dlsym(void* handle, const char* symbol);
+/* Resolves count symbols at once, storing each one's address (or NULL) in results. Returns the
+   number of symbols that could not be resolved; dlerror() describes the last of them. */
+__SIZE_TYPE__ zsys_dlsym_many(void* handle, const char*const* symbols, void** results,
+                              __SIZE_TYPE__ count);
 int zsys_poll(void* pollfds, unsigned long nfds, int timeout);
 int zsys_faccessat(int dirfd, const char* pathname, int mode, int flags);
 int zsys_sigwait(const void* sigmask, int* sig);
@@ -158,6 +168,7 @@ int zsys_unlinkat(int dirfd, const char* path, int flags);
 int zsys_acct(const char* file);
 int zsys_setgroups(__SIZE_TYPE__ size, const unsigned* list);
 int zsys_madvise(void* addr, __SIZE_TYPE__ len, int behav);
+int zsys_msync(void* addr, __SIZE_TYPE__ len, int flags);
 int zsys_mincore(void* addr, __SIZE_TYPE__ len, char* vec);
 int zsys_getpriority(int which, int who);
 int zsys_setpriority(int which, int who, int prio);
@@ -203,6 +214,12 @@ int zsys_fexecve(int fd, char*const* argv, char*const* envp);
 int zsys_isatty(int fd);
 int zsys_uname(void* buf);
 int zsys_sendfile(int out_fd, int in_fd, long* offset, __SIZE_TYPE__ count);
+long zsys_splice(int fd_in, long* off_in, int fd_out, long* off_out, __SIZE_TYPE__ len,
+                 unsigned flags);
+long zsys_tee(int fd_in, int fd_out, __SIZE_TYPE__ len, unsigned flags);
+long zsys_vmsplice(int fd, const void* iov, __SIZE_TYPE__ nr_segs, unsigned flags);
+long zsys_copy_file_range(int fd_in, long* off_in, int fd_out, long* off_out, __SIZE_TYPE__ len,
+                          unsigned flags);
 void zsys_futex_wake(volatile int* addr, int cnt, int priv);
 void zsys_futex_wait(volatile int* addr, int val, int priv);
 /* These futex calls return the errno as a negative value. They do not set errno. */
@@ -217,6 +234,51 @@ int zsys_epoll_create1(int flags);
 int zsys_epoll_ctl(int epfd, int op, int fd, void* event);
 int zsys_epoll_wait(int epfd, void* events, int maxevents, int timeout);
 int zsys_epoll_pwait(int epfd, void* events, int maxevents, int timeout, const void* sigmask);
+
+/* io_uring, done safely. The ring is a runtime-owned, garbage-collected object, and the SQ and CQ
+   are never mapped into your memory. Instead you describe each SQE with a zsys_io_uring_sqe, which
+   zsys_io_uring_prep checks (the buffer has to be accessible for the whole length, and can't be
+   mmapped memory) and then copies into the ring. The buffer is kept alive until you reap the CQE,
+   even if you free it in the meantime. The user_data that you pass in comes back in the CQE as the
+   same ptr.
+
+   Supported opcodes are IORING_OP_NOP, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED,
+   IORING_OP_WRITE_FIXED and IORING_OP_FSYNC. op_flags is the rw_flags or fsync_flags, depending on
+   the opcode. Supported sqe_flags are IOSQE_IO_DRAIN, IOSQE_IO_LINK, IOSQE_IO_HARDLINK and
+   IOSQE_ASYNC. Supported setup flags are IORING_SETUP_CLAMP and IORING_SETUP_SQPOLL.
+
+   zsys_io_uring_prep fails with EBUSY if the SQ is full or if as many SQEs are in flight as the CQ
+   can hold. zsys_io_uring_submit submits everything prepped so far, and waits for wait_nr
+   completions. zsys_io_uring_reap never blocks, and returns how many CQEs it copied out.
+
+   zsys_io_uring_register_buffers can only be called once per ring. The buffers stay alive for as
+   long as the ring does.
+
+   The ring's fd belongs to the runtime. zsys_close, zsys_dup, zsys_dup2, zsys_fcntl's F_DUPFD and
+   F_DUPFD_CLOEXEC, zsys_mmap, zsys_sendmsg and zsys_sendmmsg fail with EBADF if you hand them
+   that fd. */
+struct zsys_io_uring_sqe {
+    unsigned char opcode;
+    unsigned char sqe_flags;
+    unsigned short ioprio;
+    int fd;
+    unsigned long long off;
+    void* addr;
+    unsigned len;
+    unsigned op_flags;
+    int buf_index;
+    void* user_data;
+};
+struct zsys_io_uring_cqe {
+    void* user_data;
+    int res;
+    unsigned flags;
+};
+void* zsys_io_uring_setup(unsigned entries, unsigned flags);
+int zsys_io_uring_register_buffers(void* ring, const void* iov, unsigned nr_iovecs);
+int zsys_io_uring_prep(void* ring, const struct zsys_io_uring_sqe* sqe);
+int zsys_io_uring_submit(void* ring, unsigned wait_nr);
+int zsys_io_uring_reap(void* ring, struct zsys_io_uring_cqe* cqes, unsigned max_cqes);
 int zsys_sysinfo(void* info);
 int zsys_sched_getaffinity(int tid, __SIZE_TYPE__ size, void* set);
 int zsys_sched_setaffinity(int tid, __SIZE_TYPE__ size, const void* set);
@@ -227,4 +289,50 @@ int zsys_sigsuspend(const void* mask);
 int zsys_prctl(int option, ...);
 int zsys_eventfd(unsigned initval, int flags);
 
+/* Lets you take signals as events instead of as asynchronous interruptions. Block the signals in
+   mask with zsys_sigprocmask first, then read struct signalfd_siginfo records from the returned fd.
+   Signals taken this way never go through the runtime's deferred signal handling. */
+int zsys_signalfd(int fd, const void* mask, int flags);
+
+/* posix_spawn without fork. The child is created with the system's posix_spawn, which shares our
+   address space only until it execs, so unlike zsys_fork this never has to stop the world, suspend
+   the GC, or take any thread locks. The actions run in order in the child before the exec, like
+   posix_spawn_file_actions. The attr may be NULL, and otherwise works like posix_spawnattr: the
+   sigmask and sigdefault sets are only looked at if the matching flag is set. Without
+   ZSYS_SPAWN_SETSIGMASK, the child inherits the calling thread's signal mask. ZSYS_SPAWN_USEPATH
+   makes this behave like posix_spawnp, except that it searches search_path (so pass your own PATH)
+   rather than the runtime's PATH, or the default search path if search_path is NULL.
+
+   Returns 0 or an error number, like posix_spawn. The pid is stored only on success, and pid may be
+   NULL. */
+#define ZSYS_SPAWN_CLOSE 0
+#define ZSYS_SPAWN_DUP2 1
+#define ZSYS_SPAWN_OPEN 2
+#define ZSYS_SPAWN_CHDIR 3
+#define ZSYS_SPAWN_FCHDIR 4
+struct zsys_spawn_action {
+    int kind;
+    int fd;
+    int newfd; /* Only for ZSYS_SPAWN_DUP2. */
+    int oflag; /* Only for ZSYS_SPAWN_OPEN. */
+    unsigned mode; /* Only for ZSYS_SPAWN_OPEN. */
+    const char* path; /* Only for ZSYS_SPAWN_OPEN and ZSYS_SPAWN_CHDIR. */
+};
+#define ZSYS_SPAWN_SETPGROUP 1
+#define ZSYS_SPAWN_SETSID 2
+#define ZSYS_SPAWN_RESETIDS 4
+#define ZSYS_SPAWN_SETSIGMASK 8
+#define ZSYS_SPAWN_SETSIGDEF 16
+#define ZSYS_SPAWN_USEPATH 32
+struct zsys_spawn_attr {
+    int flags;
+    int pgroup; /* Only for ZSYS_SPAWN_SETPGROUP. */
+    const void* sigmask; /* Only for ZSYS_SPAWN_SETSIGMASK. */
+    const void* sigdefault; /* Only for ZSYS_SPAWN_SETSIGDEF. */
+    const char* search_path; /* Only for ZSYS_SPAWN_USEPATH. */
+};
+int zsys_posix_spawn(int* pid, const char* path, const struct zsys_spawn_action* actions,
+                     unsigned num_actions, const struct zsys_spawn_attr* attr, char*const* argv,
+                     char*const* envp);
+
 #endif /* PIZLONATED_COMMON_SYSCALLS_H */
@@ -117,6 +117,10 @@ void* zgc_aligned_realloc(void* old_ptr, __SIZE_TYPE__ alignment, __SIZE_TYPE__
    libc's free just forwards to this. There is no difference between calling `free` and `zgc_free`. */
 void zgc_free(void* ptr);
 
+/* Like zgc_free, but the caller also says how big it thinks the object is (like C++ sized delete
+   does). It's a safety error if that's bigger than the object. */
+void zgc_free_sized(void* ptr, __SIZE_TYPE__ size);
+
 /* Accessors for the bounds.
  
    The lower and upper bounds have the same capability as the incoming ptr. So, if you know that a
@@ -308,6 +312,64 @@ zexact_ptrtable* zexact_ptrtable_new(void);
 __SIZE_TYPE__ zexact_ptrtable_encode(zexact_ptrtable* table, void* ptr);
 void* zexact_ptrtable_decode(zexact_ptrtable* table, __SIZE_TYPE__ encoded_ptr);
 
+/* Weak references. zweak_new(ptr) returns a weak reference to whatever ptr points at, and
+   zweak_get() returns exactly that ptr for as long as the object is strongly reachable. Once the GC
+   finds that nothing but weak references point at the object, it clears them, and from then on
+   zweak_get() returns NULL. The GC might clear the weak references at the end of any cycle in which
+   the object was only weakly reachable, even if zweak_get() resurrected it during that cycle.
+
+   Passing NULL or a non-ptr integer to zweak_new() gives you a weak reference that always returns
+   exactly that value. Weak references to global variables never get cleared.
+
+   This is handy for caches and interning tables that shouldn't keep their contents alive by
+   themselves. Note that if the value you're caching points back at the key, then the value keeps
+   the key alive, since there are no ephemerons. */
+struct zweak;
+typedef struct zweak zweak;
+
+zweak* zweak_new(void* ptr);
+void* zweak_get(zweak* weak);
+
+/* Arenas, for when a bunch of allocations all die at the same time, like at the end of a request.
+   zarena_alloc() is like zgc_alloc(), except that the arena keeps the object alive for at least as
+   long as the arena is alive and not destroyed. zarena_destroy() then frees all of the arena's
+   objects at once, as if by zgc_free(), so nobody can access them afterwards and the GC doesn't
+   have to find out that they're dead.
+
+   You can zgc_free() objects in an arena before destroying it. It's a safety error to allocate in
+   or destroy an arena that was already destroyed. Arenas themselves are garbage collected, so you
+   don't have to destroy an arena if you don't care about freeing its objects eagerly. */
+struct zarena;
+typedef struct zarena zarena;
+
+zarena* zarena_new(void);
+void* zarena_alloc(zarena* arena, __SIZE_TYPE__ size);
+void zarena_destroy(zarena* arena);
+
+/* Fibers, for when you want lots of cheap stacks. A fiber belongs to the thread that created it and
+   only ever runs on that thread, taking turns with the thread's other fibers. zfiber_switch()
+   suspends the running fiber and resumes the given one, which costs about as much as a function
+   call: it doesn't involve the kernel or synchronize with the GC.
+
+   zfiber_create() returns a fiber that will call main(arg) the first time it's switched to, or
+   NULL with errno set if it can't allocate the stack. Passing zero for stack_size gives you the
+   default (128KB); small sizes get rounded up to 64KB. When main returns, the fiber is done, and
+   its thread switches to whichever fiber last switched to it, or to the thread's root fiber if that
+   one is done too. The root fiber is the one that was running the thread before it ever switched
+   fibers, and zfiber_self() returns it if the thread hasn't switched yet.
+
+   It's a safety error to switch to a fiber that belongs to another thread or that's done, and to
+   exit a thread while running on any fiber but its root fiber. Fibers that aren't done are GC roots
+   for as long as their thread is alive, just like the thread's own stack, so a fiber that you stop
+   switching to before it's done stays allocated until its thread exits. */
+struct zfiber;
+typedef struct zfiber zfiber;
+
+zfiber* zfiber_create(void (*main)(void* arg), void* arg, __SIZE_TYPE__ stack_size);
+void zfiber_switch(zfiber* fiber);
+zfiber* zfiber_self(void);
+filc_bool zfiber_is_done(zfiber* fiber);
+
 /* This function is just for testing zptrtable and it only returns accurate data if
    zis_runtime_testing_enabled(). */
 __SIZE_TYPE__ ztesting_get_num_ptrtables(void);
@@ -321,8 +383,15 @@ void zprint_ptr(const void* ptr);
 
 /* Low-level functions that should be provided by libc, which lives above this. These are exposed for
    the purpose of Fil-C's own snprintf implementation, which lives below libc. They are also safe to
-   call instead of what libc offers. */
+   call instead of what libc offers.
+
+   The string and memory scans check the bounds once and then run the host libc's vectorized
+   routines over the checked range. Like in libc, zmemchr and zstrnlen only trap for a count past
+   the upper bound if they would have had to read that far. */
 __SIZE_TYPE__ zstrlen(const char* str);
+__SIZE_TYPE__ zstrnlen(const char* str, __SIZE_TYPE__ maxlen);
+void* zmemchr(const void* ptr, int chr, __SIZE_TYPE__ count);
+char* zstrchr(const char* str, int chr);
 int zisdigit(int chr);
 
 /* This is almost like sprintf, but because Fil-C knows the upper bounds of buf, this actually ends
@@ -518,10 +587,138 @@ void zvalidate_ptr(void* ptr);
    stop all threads to do the GC. */
 void zgc_request_and_wait(void);
 
+/* Request a garbage collection cycle without waiting for it. If a GC cycle is already happening, then
+   that's the one you get. This is useful for starting a cycle early, like when a server is about to
+   go idle. */
+void zgc_collect_async(void);
+
+/* Tell the GC that the calling thread has nothing better to do for up to budget_ns nanoseconds, like
+   between requests in a server.
+
+   If the heap is far enough along toward the point where it would trigger a GC anyway (controlled by
+   FUGC_IDLE_TRIGGER_PERCENT, which defaults to 50), then this starts a cycle early. Then, if a cycle
+   is running, the calling thread helps the GC mark, destruct, and sweep until either the cycle is
+   done or the budget runs out.
+
+   Returns true if there is no GC cycle running when this returns, and false if the budget ran out
+   first. Either way, this never blocks for much longer than budget_ns. */
+filc_bool zgc_hint_idle(unsigned long long budget_ns);
+
 /* Tells if the GC is running in STW (stop the world) mode. The default is false. You can enable STW
    mode by setting the FUGC_STW=1 environment variable. */
 filc_bool zgc_is_stw(void);
 
+#define ZGC_STATS_NUM_HANDSHAKE_BUCKETS 24
+
+struct zgc_stats;
+typedef struct zgc_stats zgc_stats;
+
+/* GC statistics, as returned by zgc_get_stats(). Times are in milliseconds. The last_ fields describe
+   the most recently completed cycle, while the total_ fields accumulate over all cycles. */
+struct zgc_stats {
+    unsigned long long num_completed_cycles;
+    unsigned long long num_young_cycles; /* Only nonzero with FUGC_GENERATIONAL=1. */
+    unsigned long long live_bytes;
+    unsigned long long trigger_threshold; /* Live bytes at which the next cycle starts. */
+
+    /* Per-phase durations. Marking includes the soft handshakes used to start and end it. */
+    double last_cycle_time;
+    double last_mark_time;
+    double last_destruct_time;
+    double last_sweep_time;
+    double total_cycle_time;
+    double total_mark_time;
+    double total_destruct_time;
+    double total_sweep_time;
+
+    /* Survived bytes are the bytes that the cycle marked. Floated bytes were allocated while the
+       cycle was running, so they survived without having to be marked. */
+    unsigned long long last_survived_bytes;
+    unsigned long long last_swept_bytes;
+    unsigned long long last_floated_bytes;
+    unsigned long long total_swept_bytes;
+
+    /* How full the small-object pages that survived the last sweep are. The GC never moves objects,
+       so when live bytes are well below capacity, the heap is fragmented. Deferred pages were so
+       sparse that the GC is leaving them alone for a cycle in the hope that they become empty and
+       can be returned to the OS. */
+    unsigned long long last_num_small_pages;
+    unsigned long long last_small_page_live_bytes;
+    unsigned long long last_small_page_capacity_bytes;
+    unsigned long long last_num_deferred_small_pages;
+
+    /* The most objects that any one marker had on its mark stack. */
+    unsigned long long last_mark_stack_high_water;
+    unsigned long long max_mark_stack_high_water;
+
+    /* Latency of the soft handshakes that the GC does with all threads. Bucket i counts handshakes
+       that took less than 2^i microseconds but at least 2^(i-1) microseconds. The last bucket also
+       counts everything slower than that. */
+    unsigned long long num_handshakes;
+    double total_handshake_time;
+    double max_handshake_time;
+    unsigned long long handshake_histogram[ZGC_STATS_NUM_HANDSHAKE_BUCKETS];
+};
+
+/* Fills in a snapshot of the GC's statistics. This is cheap enough to call periodically (it takes a
+   lock that the GC only holds briefly), so it's suitable for exporting GC metrics. */
+void zgc_get_stats(zgc_stats* stats);
+
+/* Writes a snapshot of the object graph to the given fd, for finding out what is keeping memory
+   alive. This asks for a GC cycle that records every object it marks and what that object points
+   at, and returns once that cycle is done marking. Other threads keep running the whole time. Turn
+   on the heap profiler (FILC_HEAP_PROFILE) to also get the allocation sites of sampled objects.
+   The format is described in filc_heap_snapshot.h in libpas.
+
+   Returns false and sets errno if writing to the fd failed. */
+filc_bool zgc_write_heap_snapshot(int fd);
+
+#define ZGC_HEAP_COMPOSITION_NUM_BUCKETS 32
+
+struct zgc_heap_composition_bucket;
+struct zgc_heap_composition_report;
+typedef struct zgc_heap_composition_bucket zgc_heap_composition_bucket;
+typedef struct zgc_heap_composition_report zgc_heap_composition_report;
+
+/* The live objects of one size range, as reported by zgc_heap_composition(). All sizes are in
+   bytes. */
+struct zgc_heap_composition_bucket {
+    unsigned long long num_objects;
+    unsigned long long payload_bytes;   /* What the program asked for, rounded up to words. */
+    unsigned long long header_bytes;    /* The object header in front of each payload. */
+    unsigned long long alignment_bytes; /* The alignment header and padding in front of objects that
+                                           are aligned by more than 16 bytes. */
+    unsigned long long slack_bytes;     /* What the allocation's size class adds at the end. */
+    unsigned long long aux_bytes;       /* Aux arrays, which hold the capabilities of stored ptrs.
+                                           Objects that never had a ptr stored into them have
+                                           none. */
+
+    /* Special objects (functions, threads, ptr tables, and so on), whole allocation included. */
+    unsigned long long num_special_objects;
+    unsigned long long special_bytes;
+
+    /* Objects that were freed but that something still pointed at, so that they take up memory
+       until the next sweep. Big freed objects have already given their pages back to the OS. */
+    unsigned long long num_freed_objects;
+    unsigned long long freed_bytes;
+};
+
+/* Bucket i is for allocations that are less than 2^i bytes but at least 2^(i-1). The last bucket
+   also counts everything bigger. */
+struct zgc_heap_composition_report {
+    unsigned long long cycle; /* The GC cycle that this was recorded in. */
+    unsigned long long num_atomic_boxes;
+    unsigned long long atomic_box_bytes;
+    zgc_heap_composition_bucket buckets[ZGC_HEAP_COMPOSITION_NUM_BUCKETS];
+};
+
+/* Breaks down the live heap by what the memory is used for, to find out how much of it is Fil-C's
+   own overhead. This asks for a GC cycle that tallies every object it marks, and returns once that
+   cycle is done marking. Other threads keep running the whole time. Objects allocated while the
+   cycle runs aren't counted, and neither are globals or stack objects. Setting FUGC_VERBOSE=2 also
+   logs this for every full cycle. */
+void zgc_heap_composition(zgc_heap_composition_report* report);
+
 /* Request a synchronous scavenge. This decommits all memory that can be decommitted.
    
    If we you want to free all memory that can possibly be freed and you're happy to wait, then you should
@@ -538,6 +735,23 @@ void zscavenge_synchronously(void);
 void zscavenger_suspend(void);
 void zscavenger_resume(void);
 
+/* Commits at least `bytes` of memory for the heap to grow into, including the GC's mark bits for
+   that memory. This is meant to be called at startup by latency-sensitive programs, so that their
+   first requests don't pay for the heap growing.
+
+   The scavenger leaves reserved memory alone for as long as the heap could still grow into it. Once
+   the heap's live bytes plus what is left of the reserve exceed everything that was ever reserved,
+   the extra is spare, and the scavenger gives back whatever spare memory exceeds the slack
+   (FILC_HEAP_RESERVE_SLACK, which defaults to 16MB). Under high memory pressure, the scavenger
+   gives back the whole reserve.
+
+   Returns false if the memory couldn't be had. Calling this more than once adds to the reserve. */
+filc_bool zheap_reserve(__SIZE_TYPE__ bytes);
+
+/* Like zheap_reserve, but also faults the memory in, so that the heap growing into it doesn't take
+   any page faults. This takes time proportional to `bytes`. */
+filc_bool zheap_prefault(__SIZE_TYPE__ bytes);
+
 void zdump_stack(void);
 
 struct zstack_frame_description;
@@ -595,9 +809,116 @@ void zstack_scan(filc_bool (*callback)(
    On Linux, this is guaranteed to be the same as gettid(), just much faster to query. */
 unsigned zthread_self_id(void);
 
+/* A mutex and a condition variable, each of which is just an int that starts out zero. These are
+   much cheaper than going through zsys_futex_wait and zsys_futex_wake yourself. zmutex_lock spins
+   for a while without leaving Fil-C, and only parks the thread on a futex after that. Parked
+   threads don't hold up the GC.
+
+   These are not recursive and do not check ownership. Unlocking a mutex that nobody holds is a bug
+   but not a memory safety issue. */
+void zmutex_lock(int* mutex);
+filc_bool zmutex_trylock(int* mutex);
+void zmutex_unlock(int* mutex);
+
+/* Atomically unlocks the mutex and waits for a signal or broadcast on the condvar, then locks the
+   mutex again. Like pthread_cond_wait, this may wake up spuriously. */
+void zcondvar_wait(int* condvar, int* mutex);
+void zcondvar_signal(int* condvar);
+void zcondvar_broadcast(int* condvar);
+
 /* X86 xgetbv intrinsic. Reads XCR0. May trap if the CPU doesn't support the xsave feature. */
 unsigned long zxgetbv(void);
 
+struct zdirent;
+typedef struct zdirent zdirent;
+
+struct zdirent {
+    unsigned long long ino;
+    unsigned char type; /* DT_REG, DT_DIR, and so on, or DT_UNKNOWN. */
+    const char* name;
+};
+
+/* Reads up to count entries of the directory open at fd, with a single getdents call. This is a
+   lot faster than readdir for walking big directory trees, since readdir has to check every field
+   of every record as it goes, while this hands back entries that are ready to use. The names of a
+   batch all point into one string buffer, which stays alive for as long as any of them does.
+
+   Entries that didn't fit are left for the next call. Returns how many entries were read, 0 at the
+   end of the directory, or -1 with errno set. Don't mix this with readdir on the same fd. */
+long zreaddir_batch(int fd, zdirent* entries, __SIZE_TYPE__ count);
+
+/* Crypto kernels for ports of libraries like OpenSSL, which would otherwise have to use their
+   portable C code, since Fil-C can't run their assembly. Each of these has the same semantics as
+   the OpenSSL assembly routine that it's named after, so a port only needs to swap the call. All of
+   the buffers are bounds checked in full before the kernel starts.
+
+   zcrypto_features() tells which of these the CPU can do in hardware. The AES functions panic
+   without ZCRYPTO_AES and zcrypto_ghash panics without ZCRYPTO_PCLMUL, so callers should check
+   and fall back to portable code. Everything else works on any CPU, though SHA-256 is faster with
+   ZCRYPTO_SHA. */
+#define ZCRYPTO_AES    1u
+#define ZCRYPTO_PCLMUL 2u
+#define ZCRYPTO_SHA    4u
+
+unsigned zcrypto_features(void);
+
+/* Like sha256_block_data_order and sha512_block_data_order: updates the 8 word state with
+   num_blocks blocks of 64 or 128 bytes. */
+void zcrypto_sha256_blocks(unsigned* state, const void* data, __SIZE_TYPE__ num_blocks);
+void zcrypto_sha512_blocks(unsigned long long* state, const void* data, __SIZE_TYPE__ num_blocks);
+
+struct zcrypto_aes_key;
+typedef struct zcrypto_aes_key zcrypto_aes_key;
+
+struct zcrypto_aes_key {
+    unsigned char round_keys[240];
+    unsigned rounds;
+};
+
+/* Expands a 128, 192, or 256 bit key. Returns false for any other number of bits. This works
+   without ZCRYPTO_AES. */
+filc_bool zcrypto_aes_set_encrypt_key(const unsigned char* user_key, unsigned bits,
+                                      zcrypto_aes_key* key);
+void zcrypto_aes_encrypt_block(const unsigned char* in, unsigned char* out,
+                               const zcrypto_aes_key* key);
+
+/* Like aesni_ctr32_encrypt_blocks: the counter is the big endian last 32 bits of ivec, which wrap
+   without carrying. Doesn't update ivec. */
+void zcrypto_aes_ctr32_encrypt_blocks(const void* in, void* out, __SIZE_TYPE__ num_blocks,
+                                      const zcrypto_aes_key* key, const unsigned char* ivec);
+
+/* Like gcm_ghash_clmul, except that it takes the hash key H (the encryption of the zero block)
+   instead of a precomputed table. len must be a multiple of 16. */
+void zcrypto_ghash(unsigned char* xi, const unsigned char* h, const void* in, __SIZE_TYPE__ len);
+
+/* Like ChaCha20_ctr32: key is 8 words, and counter is the block counter followed by the three
+   nonce words. Doesn't update counter. */
+void zcrypto_chacha20_ctr32(void* out, const void* in, __SIZE_TYPE__ len, const unsigned* key,
+                            const unsigned* counter);
+
+struct zcrypto_poly1305;
+typedef struct zcrypto_poly1305 zcrypto_poly1305;
+
+struct zcrypto_poly1305 {
+    unsigned long long opaque[6];
+};
+
+/* Like poly1305_init, poly1305_blocks, and poly1305_emit. key is the first 16 bytes of the one
+   time key, and nonce is the other 16. len must be a multiple of 16, and padbit is 0 only for a
+   final block that the caller padded. */
+void zcrypto_poly1305_init(zcrypto_poly1305* state, const unsigned char* key);
+void zcrypto_poly1305_blocks(zcrypto_poly1305* state, const void* in, __SIZE_TYPE__ len,
+                             unsigned padbit);
+void zcrypto_poly1305_emit(const zcrypto_poly1305* state, unsigned char* mac,
+                           const unsigned char* nonce);
+
+/* Checksums with the same arguments and results as zlib's crc32() and adler32() and xz's
+   lzma_crc64(). The buffer is bounds checked once, and then the checksum runs natively, using
+   PCLMULQDQ for CRC-32 and SSSE3 for Adler-32 when the CPU has them. */
+unsigned zcrc32(unsigned crc, const void* buf, __SIZE_TYPE__ len);
+unsigned zadler32(unsigned adler, const void* buf, __SIZE_TYPE__ len);
+unsigned long long zcrc64(unsigned long long crc, const void* buf, __SIZE_TYPE__ len);
+
 #ifdef __cplusplus
 }
 #endif
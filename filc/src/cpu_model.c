@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include <cpuid.h>
+#include <stdbool.h>
+#include <stdfil.h>
+
+/* This is the Fil-C version of compiler-rt's x86 cpu_model.c. The compiler emits references to
+   __cpu_model, __cpu_features2, and __cpu_indicator_init for __builtin_cpu_supports,
+   __builtin_cpu_is, and the resolvers of target_clones and cpu_dispatch functions. The feature
+   bits have to match compiler-rt's ProcessorFeatures enum, since that's what the compiler
+   assumes.
+
+   Unlike compiler-rt, we only detect the vendor and the features. We leave the CPU type and
+   subtype as zero, so __builtin_cpu_is only works for vendor names. */
+
+enum processor_vendor {
+    VENDOR_INTEL = 1,
+    VENDOR_AMD,
+    VENDOR_OTHER
+};
+
+enum processor_feature {
+    FEATURE_CMOV = 0,
+    FEATURE_MMX,
+    FEATURE_POPCNT,
+    FEATURE_SSE,
+    FEATURE_SSE2,
+    FEATURE_SSE3,
+    FEATURE_SSSE3,
+    FEATURE_SSE4_1,
+    FEATURE_SSE4_2,
+    FEATURE_AVX,
+    FEATURE_AVX2,
+    FEATURE_SSE4_A,
+    FEATURE_FMA4,
+    FEATURE_XOP,
+    FEATURE_FMA,
+    FEATURE_AVX512F,
+    FEATURE_BMI,
+    FEATURE_BMI2,
+    FEATURE_AES,
+    FEATURE_PCLMUL,
+    FEATURE_AVX512VL,
+    FEATURE_AVX512BW,
+    FEATURE_AVX512DQ,
+    FEATURE_AVX512CD,
+    FEATURE_AVX512ER,
+    FEATURE_AVX512PF,
+    FEATURE_AVX512VBMI,
+    FEATURE_AVX512IFMA,
+    FEATURE_AVX5124VNNIW,
+    FEATURE_AVX5124FMAPS,
+    FEATURE_AVX512VPOPCNTDQ,
+    FEATURE_AVX512VBMI2,
+    FEATURE_GFNI,
+    FEATURE_VPCLMULQDQ,
+    FEATURE_AVX512VNNI,
+    FEATURE_AVX512BITALG,
+    FEATURE_AVX512BF16,
+    FEATURE_AVX512VP2INTERSECT,
+    CPU_FEATURE_MAX
+};
+
+#define SIG_INTEL 0x756e6547 /* Genu */
+#define SIG_AMD 0x68747541 /* Auth */
+
+struct __processor_model {
+    unsigned __cpu_vendor;
+    unsigned __cpu_type;
+    unsigned __cpu_subtype;
+    unsigned __cpu_features[1];
+} __cpu_model = { 0, 0, 0, { 0 } };
+
+unsigned __cpu_features2 = 0;
+
+static void set_feature(unsigned* features, enum processor_feature feature)
+{
+    features[feature / 32] |= 1u << (feature % 32);
+}
+
+static void get_available_features(unsigned ecx, unsigned edx, unsigned max_leaf,
+                                   unsigned* features)
+{
+    unsigned eax = 0;
+    unsigned ebx = 0;
+
+    if ((edx >> 15) & 1)
+        set_feature(features, FEATURE_CMOV);
+    if ((edx >> 23) & 1)
+        set_feature(features, FEATURE_MMX);
+    if ((edx >> 25) & 1)
+        set_feature(features, FEATURE_SSE);
+    if ((edx >> 26) & 1)
+        set_feature(features, FEATURE_SSE2);
+
+    if ((ecx >> 0) & 1)
+        set_feature(features, FEATURE_SSE3);
+    if ((ecx >> 1) & 1)
+        set_feature(features, FEATURE_PCLMUL);
+    if ((ecx >> 9) & 1)
+        set_feature(features, FEATURE_SSSE3);
+    if ((ecx >> 12) & 1)
+        set_feature(features, FEATURE_FMA);
+    if ((ecx >> 19) & 1)
+        set_feature(features, FEATURE_SSE4_1);
+    if ((ecx >> 20) & 1)
+        set_feature(features, FEATURE_SSE4_2);
+    if ((ecx >> 23) & 1)
+        set_feature(features, FEATURE_POPCNT);
+    if ((ecx >> 25) & 1)
+        set_feature(features, FEATURE_AES);
+
+    /* AVX needs OSXSAVE and AVX from cpuid, and XCR0 has to say that the OS saves the AVX state.
+       Checking OSXSAVE first matters, since zxgetbv traps without it. */
+    unsigned avx_bits = (1u << 27) | (1u << 28);
+    bool has_avx = false;
+    bool has_avx512_save = false;
+    if ((ecx & avx_bits) == avx_bits) {
+        unsigned long xcr0 = zxgetbv();
+        has_avx = (xcr0 & 0x6) == 0x6;
+        has_avx512_save = has_avx && (xcr0 & 0xe0) == 0xe0;
+    }
+
+    if (has_avx)
+        set_feature(features, FEATURE_AVX);
+
+    bool has_leaf7 = max_leaf >= 0x7;
+    if (has_leaf7)
+        __cpuid_count(0x7, 0x0, eax, ebx, ecx, edx);
+    else {
+        ebx = 0;
+        ecx = 0;
+        edx = 0;
+    }
+
+    if ((ebx >> 3) & 1)
+        set_feature(features, FEATURE_BMI);
+    if (((ebx >> 5) & 1) && has_avx)
+        set_feature(features, FEATURE_AVX2);
+    if ((ebx >> 8) & 1)
+        set_feature(features, FEATURE_BMI2);
+    if (has_avx512_save) {
+        if ((ebx >> 16) & 1)
+            set_feature(features, FEATURE_AVX512F);
+        if ((ebx >> 17) & 1)
+            set_feature(features, FEATURE_AVX512DQ);
+        if ((ebx >> 21) & 1)
+            set_feature(features, FEATURE_AVX512IFMA);
+        if ((ebx >> 26) & 1)
+            set_feature(features, FEATURE_AVX512PF);
+        if ((ebx >> 27) & 1)
+            set_feature(features, FEATURE_AVX512ER);
+        if ((ebx >> 28) & 1)
+            set_feature(features, FEATURE_AVX512CD);
+        if ((ebx >> 30) & 1)
+            set_feature(features, FEATURE_AVX512BW);
+        if ((ebx >> 31) & 1)
+            set_feature(features, FEATURE_AVX512VL);
+        if ((ecx >> 1) & 1)
+            set_feature(features, FEATURE_AVX512VBMI);
+        if ((ecx >> 6) & 1)
+            set_feature(features, FEATURE_AVX512VBMI2);
+        if ((ecx >> 11) & 1)
+            set_feature(features, FEATURE_AVX512VNNI);
+        if ((ecx >> 12) & 1)
+            set_feature(features, FEATURE_AVX512BITALG);
+        if ((ecx >> 14) & 1)
+            set_feature(features, FEATURE_AVX512VPOPCNTDQ);
+        if ((edx >> 2) & 1)
+            set_feature(features, FEATURE_AVX5124VNNIW);
+        if ((edx >> 3) & 1)
+            set_feature(features, FEATURE_AVX5124FMAPS);
+        if ((edx >> 8) & 1)
+            set_feature(features, FEATURE_AVX512VP2INTERSECT);
+    }
+    if ((ecx >> 8) & 1)
+        set_feature(features, FEATURE_GFNI);
+    if (((ecx >> 10) & 1) && has_avx)
+        set_feature(features, FEATURE_VPCLMULQDQ);
+
+    /* EAX from subleaf 0 is the maximum subleaf. */
+    if (has_leaf7 && eax >= 1) {
+        __cpuid_count(0x7, 0x1, eax, ebx, ecx, edx);
+        if (((eax >> 5) & 1) && has_avx512_save)
+            set_feature(features, FEATURE_AVX512BF16);
+    }
+
+    unsigned max_ext_level;
+    __cpuid(0x80000000, max_ext_level, ebx, ecx, edx);
+    if (max_ext_level >= 0x80000001) {
+        __cpuid(0x80000001, eax, ebx, ecx, edx);
+        if ((ecx >> 6) & 1)
+            set_feature(features, FEATURE_SSE4_A);
+        if ((ecx >> 11) & 1)
+            set_feature(features, FEATURE_XOP);
+        if ((ecx >> 16) & 1)
+            set_feature(features, FEATURE_FMA4);
+    }
+}
+
+/* Runs as a constructor, but resolvers also call it, since they might run before constructors
+   do. Racing calls compute the same answer, so running it more than once is harmless. */
+__attribute__((constructor(101))) int __cpu_indicator_init(void)
+{
+    unsigned eax, ebx, ecx, edx;
+    unsigned max_leaf;
+    unsigned vendor;
+    unsigned features[(CPU_FEATURE_MAX + 31) / 32] = { 0 };
+
+    if (__cpu_model.__cpu_vendor)
+        return 0;
+
+    __cpuid(0, max_leaf, vendor, ecx, edx);
+    if (max_leaf < 1) {
+        __cpu_model.__cpu_vendor = VENDOR_OTHER;
+        return -1;
+    }
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    get_available_features(ecx, edx, max_leaf, features);
+
+    _Static_assert(sizeof(features) / sizeof(features[0]) == 2, "expected two feature words");
+    __cpu_model.__cpu_features[0] = features[0];
+    __cpu_features2 = features[1];
+
+    if (vendor == SIG_INTEL)
+        __cpu_model.__cpu_vendor = VENDOR_INTEL;
+    else if (vendor == SIG_AMD)
+        __cpu_model.__cpu_vendor = VENDOR_AMD;
+    else
+        __cpu_model.__cpu_vendor = VENDOR_OTHER;
+
+    return 0;
+}
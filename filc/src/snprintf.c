@@ -194,6 +194,9 @@ typedef long ssize_t;
 #ifndef MAX
 #define MAX(p,q) (((p) >= (q)) ? (p) : (q))
 #endif
+#ifndef MIN
+#define MIN(p,q) (((p) <= (q)) ? (p) : (q))
+#endif
 
 struct pr_chunk {
 	int type; /* chunk type */
@@ -227,6 +230,9 @@ static void fmtint(char *buffer, size_t *currlen, size_t maxlen,
 static void fmtfp(char *buffer, size_t *currlen, size_t maxlen,
 		   LDOUBLE fvalue, int min, int max, int flags);
 static void dopr_outch(char *buffer, size_t *currlen, size_t maxlen, char c);
+static void dopr_outpad(char *buffer, size_t *currlen, size_t maxlen, char c, int count);
+static void dopr_outstr(char *buffer, size_t *currlen, size_t maxlen,
+			const char *str, int count);
 static struct pr_chunk *new_chunk(void);
 static int add_cnk_list_entry(struct pr_chunk_x **list,
 				int max_num, struct pr_chunk *chunk);
@@ -815,7 +821,6 @@ static void fmtstr(char *buffer, size_t *currlen, size_t maxlen,
 		    char *value, int flags, int min, int max)
 {
 	int padlen, strln;     /* amount to pad */
-	int cnt = 0;
 
 #ifdef DEBUG_SNPRINTF
 	printf("fmtstr min=%d max=%d s=[%s]\n", min, max, value);
@@ -831,18 +836,9 @@ static void fmtstr(char *buffer, size_t *currlen, size_t maxlen,
 	if (flags & DP_F_MINUS)
 		padlen = -padlen; /* Left Justify */
 
-	while (padlen > 0) {
-		dopr_outch (buffer, currlen, maxlen, ' ');
-		--padlen;
-	}
-	while (*value && (cnt < max)) {
-		dopr_outch (buffer, currlen, maxlen, *value++);
-		++cnt;
-	}
-	while (padlen < 0) {
-		dopr_outch (buffer, currlen, maxlen, ' ');
-		++padlen;
-	}
+	dopr_outpad (buffer, currlen, maxlen, ' ', padlen);
+	dopr_outstr (buffer, currlen, maxlen, value, strln);
+	dopr_outpad (buffer, currlen, maxlen, ' ', -padlen);
 }
 
 /* Have to handle DP_F_NUM (ie 0x and 0 alternates) */
@@ -903,32 +899,21 @@ static void fmtint(char *buffer, size_t *currlen, size_t maxlen,
 #endif
 
 	/* Spaces */
-	while (spadlen > 0) {
-		dopr_outch (buffer, currlen, maxlen, ' ');
-		--spadlen;
-	}
+	dopr_outpad (buffer, currlen, maxlen, ' ', spadlen);
 
 	/* Sign */
 	if (signvalue)
 		dopr_outch (buffer, currlen, maxlen, signvalue);
 
 	/* Zeros */
-	if (zpadlen > 0) {
-		while (zpadlen > 0) {
-			dopr_outch (buffer, currlen, maxlen, '0');
-			--zpadlen;
-		}
-	}
+	dopr_outpad (buffer, currlen, maxlen, '0', zpadlen);
 
 	/* Digits */
 	while (place > 0)
 		dopr_outch (buffer, currlen, maxlen, convert[--place]);
 
 	/* Left Justified spaces */
-	while (spadlen < 0) {
-		dopr_outch (buffer, currlen, maxlen, ' ');
-		++spadlen;
-	}
+	dopr_outpad (buffer, currlen, maxlen, ' ', -spadlen);
 }
 
 static LDOUBLE abs_val(LDOUBLE value)
@@ -1111,15 +1096,10 @@ static void fmtfp (char *buffer, size_t *currlen, size_t maxlen,
 			--padlen;
 			signvalue = 0;
 		}
-		while (padlen > 0) {
-			dopr_outch (buffer, currlen, maxlen, '0');
-			--padlen;
-		}
-	}
-	while (padlen > 0) {
-		dopr_outch (buffer, currlen, maxlen, ' ');
-		--padlen;
+		dopr_outpad (buffer, currlen, maxlen, '0', padlen);
+		padlen = 0;
 	}
+	dopr_outpad (buffer, currlen, maxlen, ' ', padlen);
 	if (signvalue)
 		dopr_outch (buffer, currlen, maxlen, signvalue);
 
@@ -1137,19 +1117,13 @@ static void fmtfp (char *buffer, size_t *currlen, size_t maxlen,
 	if (max > 0) {
 		dopr_outch (buffer, currlen, maxlen, '.');
 
-		while (zpadlen > 0) {
-			dopr_outch (buffer, currlen, maxlen, '0');
-			--zpadlen;
-		}
+		dopr_outpad (buffer, currlen, maxlen, '0', zpadlen);
 
 		while (fplace > 0)
 			dopr_outch (buffer, currlen, maxlen, fconvert[--fplace]);
 	}
 
-	while (padlen < 0) {
-		dopr_outch (buffer, currlen, maxlen, ' ');
-		++padlen;
-	}
+	dopr_outpad (buffer, currlen, maxlen, ' ', -padlen);
 }
 
 static void dopr_outch(char *buffer, size_t *currlen, size_t maxlen, char c)
@@ -1160,6 +1134,27 @@ static void dopr_outch(char *buffer, size_t *currlen, size_t maxlen, char c)
 	(*currlen)++;
 }
 
+/* Runs of padding and string bytes go out with one memset or memcpy, so that they get one bounds
+   check for the whole run rather than one per byte. Does nothing if count is not positive. */
+static void dopr_outpad(char *buffer, size_t *currlen, size_t maxlen, char c, int count)
+{
+	if (count <= 0)
+		return;
+	if (*currlen < maxlen)
+		__builtin_memset(buffer + *currlen, c, MIN((size_t)count, maxlen - *currlen));
+	*currlen += count;
+}
+
+static void dopr_outstr(char *buffer, size_t *currlen, size_t maxlen,
+			const char *str, int count)
+{
+	if (count <= 0)
+		return;
+	if (*currlen < maxlen)
+		__builtin_memcpy(buffer + *currlen, str, MIN((size_t)count, maxlen - *currlen));
+	*currlen += count;
+}
+
 static struct pr_chunk *new_chunk(void) {
 	static const int verbose = 0;
 	
@@ -1286,16 +1281,24 @@ char* zvasprintf(const char* format, __builtin_va_list args)
 	__builtin_va_list args2;
 	char* result;
 	
+	char stack_buffer[256];
+	
+	/* Most strings are short, so format into the stack first. Then we only have to format again
+	   if the result didn't fit. */
 	__builtin_va_copy(args2, args);
-	snprintf_result = zvsnprintf(NULL, 0, format, args2);
+	snprintf_result = zvsnprintf(stack_buffer, sizeof(stack_buffer), format, args2);
 	__builtin_va_end(args2);
 	if (snprintf_result < 0)
 		return NULL;
 	
 	result = zgc_alloc(snprintf_result + 1);
 	if (!result)
-		NULL;
+		return NULL;
 	
+	if ((size_t)snprintf_result < sizeof(stack_buffer)) {
+		__builtin_memcpy(result, stack_buffer, snprintf_result + 1);
+		return result;
+	}
 	zvsnprintf(result, snprintf_result + 1, format, args);
 	return result;
 }
@@ -0,0 +1,15 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include "utils.h"
+
+int main()
+{
+    zarena* arena = opaque(zarena_new());
+    int* object = opaque(zarena_alloc(arena, sizeof(int)));
+    *object = 42;
+    printf("value = %d\n", *object);
+    zarena_destroy(arena);
+    printf("value = %d\n", *object);
+    printf("Should not get here.\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+#define NUM_OBJECTS 10000
+
+static __attribute__((noinline)) void fill_arena(zarena* arena, zweak** weaks)
+{
+    unsigned i;
+    for (i = NUM_OBJECTS; i--;) {
+        int* object = zarena_alloc(arena, sizeof(int) * (1 + i % 7));
+        ZASSERT(zlength(object) == sizeof(int) * (1 + i % 7));
+        ZASSERT(!*object);
+        *object = i;
+        weaks[i] = zweak_new(object);
+    }
+}
+
+int main()
+{
+    zarena* arena = opaque(zarena_new());
+    zweak** weaks = opaque(malloc(sizeof(zweak*) * NUM_OBJECTS));
+    fill_arena(arena, weaks);
+
+    char* big = zarena_alloc(arena, 1000000);
+    memset(big, 42, 1000000);
+    int* freed_early = zarena_alloc(arena, sizeof(int));
+    free(freed_early);
+
+    zgc_request_and_wait();
+    zgc_request_and_wait();
+
+    unsigned i;
+    for (i = NUM_OBJECTS; i--;) {
+        int* object = zweak_get(weaks[i]);
+        ZASSERT(object);
+        ZASSERT(*object == i);
+    }
+    ZASSERT(big[999999] == 42);
+
+    zarena_destroy(arena);
+
+    for (i = NUM_OBJECTS; i--;) {
+        int* object = zweak_get(weaks[i]);
+        ZASSERT(!object || !zlength(object));
+    }
+    ZASSERT(!zlength(big));
+
+    printf("Success!\n");
+    return 0;
+}
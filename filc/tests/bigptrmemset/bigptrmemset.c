@@ -0,0 +1,36 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+#define NUM_PTRS 1000000
+#define REPEAT 10
+
+static int value = 42;
+
+/* Big enough that the memset gets to throw away whole aux pages rather than zeroing them. The
+   start and end are not page aligned, so the edges still get zeroed one entry at a time. */
+int main()
+{
+    unsigned i;
+    unsigned j;
+    int** array = opaque(malloc(sizeof(int*) * NUM_PTRS));
+    for (j = REPEAT; j--;) {
+        for (i = NUM_PTRS; i--;)
+            array[i] = &value;
+        memset(opaque(array + 3), 0, sizeof(int*) * (NUM_PTRS - 7));
+        for (i = NUM_PTRS; i--;) {
+            if (i >= 3 && i < NUM_PTRS - 4)
+                ZASSERT(!array[i]);
+            else
+                ZASSERT(*array[i] == 42);
+        }
+        for (i = NUM_PTRS; i--;)
+            array[i] = &value;
+        for (i = NUM_PTRS; i--;)
+            ZASSERT(*array[i] == 42);
+    }
+    printf("Success!\n");
+    return 0;
+}
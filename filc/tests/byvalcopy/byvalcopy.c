@@ -0,0 +1,68 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+struct big {
+    char* name;
+    double values[4];
+    int* counter;
+};
+
+static struct big global_big;
+
+static __attribute__((noinline)) void scribble(struct big b, int expected_counter)
+{
+    ZASSERT(!strcmp(b.name, "hello"));
+    ZASSERT(b.values[3] == 4.0);
+    ZASSERT(*b.counter == expected_counter);
+    (*b.counter)++;
+    b.name = "scribbled";
+    b.values[3] = 42.0;
+    b.counter = NULL;
+}
+
+static __attribute__((noinline)) void scribble_and_check_global(struct big b)
+{
+    b.values[0] = 666.0;
+    b.name = NULL;
+    ZASSERT(global_big.values[0] == 1.0);
+    ZASSERT(!strcmp(global_big.name, "hello"));
+    global_big.values[1] = 777.0;
+    ZASSERT(b.values[1] == 2.0);
+}
+
+int main()
+{
+    int counter = 0;
+    struct big b;
+    b.name = opaque("hello");
+    b.values[0] = 1.0;
+    b.values[1] = 2.0;
+    b.values[2] = 3.0;
+    b.values[3] = 4.0;
+    b.counter = &counter;
+
+    scribble(b, 0);
+    scribble(b, 1);
+    ZASSERT(counter == 2);
+    ZASSERT(!strcmp(b.name, "hello"));
+    ZASSERT(b.values[3] == 4.0);
+    ZASSERT(b.counter == &counter);
+
+    global_big = b;
+    scribble_and_check_global(global_big);
+    ZASSERT(global_big.values[0] == 1.0);
+    ZASSERT(global_big.values[1] == 777.0);
+    ZASSERT(global_big.name == b.name);
+
+    struct big* heap_big = opaque(zgc_alloc(sizeof(struct big)));
+    *heap_big = b;
+    scribble(*heap_big, 2);
+    ZASSERT(counter == 3);
+    ZASSERT(heap_big->values[3] == 4.0);
+    ZASSERT(heap_big->counter == &counter);
+
+    printf("Success!\n");
+    return 0;
+}
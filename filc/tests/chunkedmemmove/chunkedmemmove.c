@@ -0,0 +1,61 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+
+#define SIZE 100000
+#define SHIFT 12345
+#define REPEAT 100
+
+static volatile int done;
+
+static void* thread_main(void* arg)
+{
+    while (!done)
+        zgc_request_and_wait();
+    return NULL;
+}
+
+static unsigned char expected_byte(unsigned index)
+{
+    return (unsigned char)(index * 31 + 7);
+}
+
+static void fill(unsigned char* buffer)
+{
+    unsigned i;
+    for (i = SIZE; i--;)
+        buffer[i] = expected_byte(i);
+}
+
+/* These copies are big enough to be done in strips with pollchecks in between, and overlapping, so
+   the strips have to go in the right direction. */
+int main()
+{
+    pthread_t t;
+    unsigned i;
+    unsigned j;
+    unsigned char* buffer = opaque(malloc(SIZE + SHIFT));
+    pthread_create(&t, NULL, thread_main, NULL);
+    for (j = REPEAT; j--;) {
+        fill(buffer);
+        memmove(opaque(buffer + SHIFT), buffer, SIZE);
+        for (i = SIZE; i--;)
+            ZASSERT(buffer[i + SHIFT] == expected_byte(i));
+
+        fill(buffer + SHIFT);
+        memmove(opaque(buffer), buffer + SHIFT, SIZE);
+        for (i = SIZE; i--;)
+            ZASSERT(buffer[i] == expected_byte(i));
+
+        memset(opaque(buffer), 42, SIZE + SHIFT);
+        for (i = SIZE + SHIFT; i--;)
+            ZASSERT(buffer[i] == 42);
+    }
+    done = 1;
+    pthread_join(t, NULL);
+    printf("Success!\n");
+    return 0;
+}
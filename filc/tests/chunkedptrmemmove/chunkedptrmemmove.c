@@ -0,0 +1,67 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+
+#define NUM_PTRS 10000
+#define SHIFT 1234
+#define REPEAT 100
+
+static volatile int done;
+static unsigned* values[NUM_PTRS];
+
+static void* thread_main(void* arg)
+{
+    while (!done)
+        zgc_request_and_wait();
+    return NULL;
+}
+
+static void fill(unsigned** array)
+{
+    unsigned i;
+    for (i = NUM_PTRS; i--;)
+        array[i] = values[i];
+}
+
+static void check(unsigned** array)
+{
+    unsigned i;
+    for (i = NUM_PTRS; i--;)
+        ZASSERT(*array[i] == i);
+}
+
+/* These are big, overlapping, in-phase moves of ptr arrays, so they copy the payload and the aux
+   together in strips, with pollchecks in between. */
+int main()
+{
+    pthread_t t;
+    unsigned i;
+    unsigned j;
+    for (i = NUM_PTRS; i--;) {
+        values[i] = malloc(sizeof(unsigned));
+        *values[i] = i;
+    }
+    unsigned** array = opaque(malloc(sizeof(unsigned*) * (NUM_PTRS + SHIFT)));
+    pthread_create(&t, NULL, thread_main, NULL);
+    for (j = REPEAT; j--;) {
+        fill(array);
+        memmove(opaque(array + SHIFT), array, sizeof(unsigned*) * NUM_PTRS);
+        check(array + SHIFT);
+
+        fill(array + SHIFT);
+        memmove(opaque(array), array + SHIFT, sizeof(unsigned*) * NUM_PTRS);
+        check(array);
+
+        unsigned** other = opaque(malloc(sizeof(unsigned*) * NUM_PTRS));
+        memcpy(other, array, sizeof(unsigned*) * NUM_PTRS);
+        check(other);
+        free(other);
+    }
+    done = 1;
+    pthread_join(t, NULL);
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include "utils.h"
+
+enum { OP_PUSH, OP_ADD, OP_MULBY, OP_DEC, OP_JNZ, OP_HALT };
+
+static long run(const int* code)
+{
+    static void* dispatch[] = { &&push, &&add, &&mulby, &&dec, &&jnz, &&halt };
+    static const int offsets[] = { &&push - &&push, &&add - &&push, &&mulby - &&push,
+                                   &&dec - &&push, &&jnz - &&push, &&halt - &&push };
+    long stack[16];
+    unsigned sp = 0;
+    const int* pc = code;
+
+#define NEXT() goto *dispatch[*pc++]
+    NEXT();
+push:
+    stack[sp++] = *pc++;
+    NEXT();
+add:
+    sp--;
+    stack[sp - 1] += stack[sp];
+    NEXT();
+mulby:
+    /* Multiplies the value under the top of the stack. */
+    stack[sp - 2] *= *pc++;
+    /* Dispatch through the label differences for a change. */
+    goto *(&&push + offsets[*pc++]);
+dec:
+    stack[sp - 1]--;
+    NEXT();
+jnz:
+    if (stack[sp - 1]) {
+        pc = code + *pc;
+        NEXT();
+    }
+    pc++;
+    NEXT();
+halt:
+    return stack[sp - 2];
+}
+
+int main()
+{
+    int power[] = { OP_PUSH, 1, OP_PUSH, 5, OP_MULBY, 3, OP_DEC, OP_JNZ, 4, OP_HALT };
+    ZASSERT(run(opaque(power)) == 243);
+
+    int sum[] = { OP_PUSH, 2, OP_PUSH, 3, OP_ADD, OP_PUSH, 0, OP_HALT };
+    ZASSERT(run(opaque(sum)) == 5);
+
+    printf("Success!\n");
+    return 0;
+}
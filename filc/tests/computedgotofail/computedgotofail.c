@@ -0,0 +1,23 @@
+#include <stdio.h>
+#include "utils.h"
+
+static int run(void* target)
+{
+    static void* labels[] = { &&one, &&two };
+    if (!target)
+        target = labels[0];
+    goto *target;
+one:
+    return 1;
+two:
+    return 2;
+}
+
+int main()
+{
+    printf("run = %d\n", run(opaque(NULL)));
+    /* Label values are opaque, so a made up one doesn't get us anywhere. */
+    printf("run = %d\n", run(opaque((void*)666)));
+    printf("Should not get here.\n");
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+static const unsigned table[8] = { 1, 1, 2, 3, 5, 8, 13, 21 };
+
+struct entry {
+    const char* name;
+    int value;
+};
+
+static const struct entry entries[] = {
+    { "one", 1 },
+    { "two", 2 },
+    { "three", 3 }
+};
+
+const char message[] = "hello";
+
+int main()
+{
+    ZASSERT(table[0] == 1);
+    ZASSERT(table[4] == 5);
+    opaque(NULL);
+    ZASSERT(table[7] == 21);
+
+    ZASSERT(!strcmp(entries[0].name, "one"));
+    ZASSERT(entries[1].value == 2);
+    opaque(NULL);
+    ZASSERT(!strcmp(entries[2].name, "three"));
+    ZASSERT(entries[2].value == 3);
+
+    ZASSERT(message[0] == 'h');
+    ZASSERT(message[4] == 'o');
+    ZASSERT(!message[5]);
+
+    unsigned index;
+    unsigned sum = 0;
+    for (index = 0; index < 8; ++index)
+        sum += table[index];
+    ZASSERT(sum == 54);
+
+    printf("Success!\n");
+    return 0;
+}
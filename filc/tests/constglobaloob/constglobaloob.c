@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+static const int table[4] = { 1, 2, 3, 4 };
+
+int main()
+{
+    printf("table[0] = %d\n", table[0]);
+    printf("table[4] = %d\n", ((const int*)table)[4]);
+    return 0;
+}
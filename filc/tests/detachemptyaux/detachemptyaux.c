@@ -0,0 +1,68 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+#define NUM_MESSAGES 1000
+#define REPEAT 10
+
+struct message {
+    int kind;
+    union {
+        char* name;
+        unsigned long value;
+    } u;
+};
+
+static struct message** messages;
+
+static void check_messages(unsigned j)
+{
+    unsigned i;
+    for (i = NUM_MESSAGES; i--;) {
+        ZASSERT(messages[i]->kind == (int)j);
+        ZASSERT(!strcmp(messages[i]->u.name, "hello"));
+    }
+}
+
+int main()
+{
+    unsigned i;
+    unsigned j;
+    messages = opaque(malloc(sizeof(struct message*) * NUM_MESSAGES));
+    for (i = NUM_MESSAGES; i--;)
+        messages[i] = malloc(sizeof(struct message));
+    for (j = REPEAT; j--;) {
+        /* Give every message an aux, and then leave it empty, so that the GC might detach it. */
+        for (i = NUM_MESSAGES; i--;) {
+            messages[i]->u.name = opaque("hello");
+            messages[i]->u.value = i;
+        }
+        zgc_request_and_wait();
+        for (i = NUM_MESSAGES; i--;)
+            ZASSERT(messages[i]->u.value == i);
+
+        /* Storing a ptr again has to work whether or not the aux was detached. */
+        for (i = NUM_MESSAGES; i--;) {
+            char* name = malloc(16);
+            strcpy(name, "hello");
+            messages[i]->kind = j;
+            messages[i]->u.name = name;
+        }
+        zgc_request_and_wait();
+        check_messages(j);
+
+        /* Copying between messages and reallocating them has to carry the ptrs over. */
+        for (i = NUM_MESSAGES; i-- > 1;) {
+            struct message* message = malloc(sizeof(struct message));
+            message->u.value = 42;
+            memcpy(message, messages[i], sizeof(struct message));
+            messages[i] = opaque(realloc(message, sizeof(struct message) * 2));
+        }
+        zgc_request_and_wait();
+        check_messages(j);
+    }
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+/* These get called both directly, which passes args and return values in registers, and through
+   function pointers, which goes through the CC buffers. */
+
+__attribute__((__noinline__)) static char* pick(char* a, char* b, int which)
+{
+    return which ? b : a;
+}
+
+__attribute__((__noinline__)) static double mix(char c, short s, int i, long l, float f, double d,
+                                                unsigned char uc, unsigned short us)
+{
+    return c + s + i + l + f + d + uc + us;
+}
+
+typedef double (*mix_type)(char, short, int, long, float, double, unsigned char, unsigned short);
+
+__attribute__((__noinline__)) static void fill(char* buf, size_t size, char c)
+{
+    memset(buf, c, size);
+    buf[size - 1] = 0;
+}
+
+__attribute__((__noinline__)) static unsigned fib(unsigned n)
+{
+    if (n < 2)
+        return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+__attribute__((__noinline__)) static int* many(int* a, int* b, int* c, int* d, int* e, int* f,
+                                              int* g, int* h, int index)
+{
+    int* array[] = { a, b, c, d, e, f, g, h };
+    return array[index];
+}
+
+int main()
+{
+    char* a = strdup("a");
+    char* b = strdup("b");
+    ZASSERT(pick(a, b, 0) == a);
+    ZASSERT(pick(a, b, 1) == b);
+    char* (*pick_ptr)(char*, char*, int) = (char* (*)(char*, char*, int))opaque(pick);
+    ZASSERT(pick_ptr(a, b, 0) == a);
+    ZASSERT(pick_ptr(a, b, 1) == b);
+    ZASSERT(!strcmp(pick(a, b, 1), "b"));
+
+    ZASSERT(mix(1, 2, 3, 4, 5.5f, 6.25, 7, 8) == 36.75);
+    mix_type mix_ptr = (mix_type)opaque(mix);
+    ZASSERT(mix_ptr(-1, -2, -3, -4, -5.5f, -6.25, 250, 65000) == 65228.25);
+
+    char* buf = malloc(16);
+    fill(buf, 16, 'x');
+    ZASSERT(strlen(buf) == 15);
+    void (*fill_ptr)(char*, size_t, char) = (void (*)(char*, size_t, char))opaque(fill);
+    fill_ptr(buf, 8, 'y');
+    ZASSERT(!strcmp(buf, "yyyyyyy"));
+
+    ZASSERT(fib(20) == 6765);
+    unsigned (*fib_ptr)(unsigned) = (unsigned (*)(unsigned))opaque(fib);
+    ZASSERT(fib_ptr(20) == 6765);
+
+    int ints[8];
+    unsigned i;
+    for (i = 8; i--;) {
+        ints[i] = (int)i * 3;
+        int* result = many(ints, ints + 1, ints + 2, ints + 3, ints + 4, ints + 5, ints + 6,
+                           ints + 7, (int)i);
+        ZASSERT(result == ints + i);
+        ZASSERT(*result == (int)i * 3);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
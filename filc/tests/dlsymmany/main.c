@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <dlfcn.h>
+#include <stdfil.h>
+#include <pizlonated_syscalls.h>
+
+void* opaque(void*);
+
+int main()
+{
+    void* lib = dlopen("filc/test-output/dlsymmany/libtest.so", RTLD_LAZY | RTLD_LOCAL);
+    ZASSERT(lib);
+
+    const char* symbols[3] = { "foo", "nonexistent", "bar" };
+    void* results[3];
+    ZASSERT(zsys_dlsym_many(lib, symbols, results, 3) == 1);
+    ZASSERT(results[0]);
+    ZASSERT(!results[1]);
+    ZASSERT(results[2]);
+    ZASSERT(dlerror());
+
+    int* (*foo)(void) = results[0];
+    ZASSERT(foo == dlsym(lib, "foo"));
+    int* x_ptr = foo();
+    ZASSERT(*x_ptr == 42);
+
+    int* bar_ptr = results[2];
+    ZASSERT(bar_ptr == dlsym(lib, "bar"));
+    ZASSERT(*bar_ptr == 666);
+    *bar_ptr = 200;
+    ZASSERT(*(int*)opaque(bar_ptr) == 200);
+
+    ZASSERT(zsys_dlsym_many(lib, symbols, results, 1) == 0);
+    ZASSERT(results[0] == foo);
+    ZASSERT(!dlsym(lib, "nonexistent"));
+
+    dlclose(lib);
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include "utils.h"
+
+static void say_hello(void* arg)
+{
+    printf("hello from %s\n", (const char*)arg);
+}
+
+int main()
+{
+    zfiber* fiber = opaque(zfiber_create(say_hello, "fiber", 0));
+    zfiber_switch(fiber);
+    ZASSERT(zfiber_is_done(fiber));
+    zfiber_switch(fiber);
+    printf("Should not get here.\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "utils.h"
+
+#define NUM_FIBERS 1000
+#define NUM_ROUNDS 10
+
+struct generator {
+    zfiber* caller;
+    zfiber* fiber;
+    unsigned value;
+};
+
+static void generate(void* arg)
+{
+    struct generator* generator = arg;
+    unsigned i;
+    for (i = 0; i < NUM_ROUNDS; ++i) {
+        /* This object is only reachable from this fiber's frame while it's suspended. */
+        unsigned* box = opaque(malloc(sizeof(unsigned)));
+        *box = i;
+        generator->value = i;
+        zfiber_switch(generator->caller);
+        ZASSERT(*box == i);
+    }
+}
+
+static void nested(void* arg)
+{
+    zfiber** result = arg;
+    *result = zfiber_self();
+}
+
+int main()
+{
+    zfiber* root = zfiber_self();
+    ZASSERT(root);
+    ZASSERT(zfiber_self() == root);
+    ZASSERT(!zfiber_is_done(root));
+
+    struct generator* generators = opaque(malloc(sizeof(struct generator) * NUM_FIBERS));
+    unsigned i;
+    for (i = NUM_FIBERS; i--;) {
+        generators[i].caller = root;
+        generators[i].fiber = zfiber_create(generate, generators + i, 0);
+        ZASSERT(generators[i].fiber);
+        ZASSERT(!zfiber_is_done(generators[i].fiber));
+    }
+
+    unsigned round;
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        for (i = NUM_FIBERS; i--;) {
+            zfiber_switch(generators[i].fiber);
+            ZASSERT(zfiber_self() == root);
+            ZASSERT(generators[i].value == round);
+        }
+        zgc_request_and_wait();
+    }
+
+    for (i = NUM_FIBERS; i--;) {
+        ZASSERT(!zfiber_is_done(generators[i].fiber));
+        zfiber_switch(generators[i].fiber);
+        ZASSERT(zfiber_is_done(generators[i].fiber));
+    }
+
+    zfiber* nested_self = NULL;
+    zfiber* fiber = zfiber_create(nested, &nested_self, 100000);
+    zfiber_switch(fiber);
+    ZASSERT(nested_self == fiber);
+    ZASSERT(zfiber_is_done(fiber));
+
+    zgc_request_and_wait();
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "utils.h"
+
+#define SIZE ((size_t)64 * 1024 * 1024)
+
+static long resident_bytes(void)
+{
+    FILE* file = fopen("/proc/self/statm", "r");
+    ZASSERT(file);
+    long size;
+    long resident;
+    ZASSERT(fscanf(file, "%ld %ld", &size, &resident) == 2);
+    fclose(file);
+    return resident * getpagesize();
+}
+
+int main()
+{
+    char** buf = opaque(malloc(SIZE));
+    size_t index;
+    for (index = 0; index < SIZE / sizeof(char*); index += 512)
+        buf[index] = "hello";
+    long before = resident_bytes();
+    free(buf);
+    long after = resident_bytes();
+    ZASSERT(before - after >= (long)SIZE);
+
+    buf = opaque(malloc(SIZE));
+    for (index = 0; index < SIZE / sizeof(char*); index += 512)
+        ZASSERT(!buf[index]);
+    free(buf);
+
+    printf("Success!\n");
+    return 0;
+}
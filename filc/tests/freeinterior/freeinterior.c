@@ -0,0 +1,9 @@
+#include <stdlib.h>
+#include "utils.h"
+
+int main()
+{
+    char* ptr = opaque(malloc(64));
+    free(ptr + 1);
+    return 0;
+}
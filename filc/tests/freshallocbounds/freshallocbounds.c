@@ -0,0 +1,39 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+struct node {
+    struct node* left;
+    struct node* right;
+    int value;
+    char tag;
+};
+
+int main()
+{
+    struct node* node = zgc_alloc(sizeof(struct node));
+    node->left = NULL;
+    node->right = node;
+    node->value = 42;
+    node->tag = 'x';
+    node = opaque(node);
+    ZASSERT(!node->left);
+    ZASSERT(node->right == node);
+    ZASSERT(node->value == 42);
+    ZASSERT(node->tag == 'x');
+
+    struct node local;
+    local.left = node;
+    local.right = NULL;
+    local.value = 666;
+    local.tag = 'y';
+    struct node* other = opaque(&local);
+    ZASSERT(other->left == node);
+    ZASSERT(!other->right);
+    ZASSERT(other->value == 666);
+    ZASSERT(other->tag == 'y');
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include "utils.h"
+
+int main()
+{
+    long* words = zgc_alloc(3 * sizeof(long));
+    words[0] = 1;
+    words[1] = 2;
+    words[2] = 3;
+    words[3] = 4;
+    printf("words = %ld\n", ((long*)opaque(words))[3]);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdfil.h>
+
+struct node;
+typedef struct node node;
+
+struct node {
+    node* next;
+    char* string;
+};
+
+static node* root;
+
+int main()
+{
+    zgc_stats before;
+    zgc_stats after;
+    unsigned index;
+
+    for (index = 100000; index--;) {
+        node* new_node = (node*)malloc(sizeof(node));
+        new_node->next = root;
+        new_node->string = malloc(32);
+        root = new_node;
+    }
+
+    zgc_get_stats(&before);
+    zgc_collect_async();
+    while (!zgc_hint_idle(1000000))
+        ;
+    zgc_get_stats(&after);
+    ZASSERT(after.num_completed_cycles > before.num_completed_cycles);
+
+    /* A zero budget must not block. */
+    zgc_hint_idle(0);
+
+    for (index = 0; root; ++index)
+        root = root->next;
+    ZASSERT(index == 100000);
+
+    printf("Success!\n");
+    return 0;
+}
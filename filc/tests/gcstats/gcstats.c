@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdfil.h>
+
+int main()
+{
+    zgc_stats before;
+    zgc_stats after;
+    unsigned index;
+    unsigned long long num_handshakes;
+
+    zgc_get_stats(&before);
+    for (index = 1000; index--;)
+        malloc(100);
+    zgc_request_and_wait();
+    zgc_get_stats(&after);
+
+    ZASSERT(after.num_completed_cycles > before.num_completed_cycles);
+    ZASSERT(after.num_handshakes > before.num_handshakes);
+    ZASSERT(after.total_cycle_time >= before.total_cycle_time);
+    ZASSERT(after.last_cycle_time >= after.last_mark_time);
+    ZASSERT(after.total_swept_bytes >= before.total_swept_bytes);
+    ZASSERT(after.trigger_threshold);
+    ZASSERT(after.max_mark_stack_high_water >= after.last_mark_stack_high_water);
+    ZASSERT(after.last_num_small_pages);
+    ZASSERT(after.last_small_page_live_bytes <= after.last_small_page_capacity_bytes);
+    ZASSERT(after.last_num_deferred_small_pages <= after.last_num_small_pages);
+
+    num_handshakes = 0;
+    for (index = 0; index < ZGC_STATS_NUM_HANDSHAKE_BUCKETS; ++index)
+        num_handshakes += after.handshake_histogram[index];
+    ZASSERT(num_handshakes == after.num_handshakes);
+
+    printf("Success!\n");
+    return 0;
+}
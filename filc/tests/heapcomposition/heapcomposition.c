@@ -0,0 +1,64 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+#define NUM_NODES 1000
+#define NUM_BUFFERS 100
+#define BUFFER_SIZE 1000
+
+struct node {
+    struct node* next;
+    char* name;
+};
+
+int main()
+{
+    unsigned i;
+    struct node* head = NULL;
+    for (i = NUM_NODES; i--;) {
+        struct node* node = malloc(sizeof(struct node));
+        node->next = head;
+        node->name = malloc(16);
+        strcpy(node->name, "hello");
+        head = opaque(node);
+    }
+    char** buffers = opaque(malloc(sizeof(char*) * NUM_BUFFERS));
+    for (i = NUM_BUFFERS; i--;)
+        buffers[i] = malloc(BUFFER_SIZE);
+    /* Something still points at this, so it stays around until the sweep. */
+    char** freed = opaque(malloc(sizeof(char*)));
+    *freed = malloc(BUFFER_SIZE);
+    free(*freed);
+
+    zgc_heap_composition_report report;
+    zgc_heap_composition(&report);
+
+    unsigned long long num_objects = 0;
+    unsigned long long payload_bytes = 0;
+    unsigned long long header_bytes = 0;
+    unsigned long long aux_bytes = 0;
+    unsigned long long num_freed_objects = 0;
+    for (i = 0; i < ZGC_HEAP_COMPOSITION_NUM_BUCKETS; ++i) {
+        num_objects += report.buckets[i].num_objects;
+        payload_bytes += report.buckets[i].payload_bytes;
+        header_bytes += report.buckets[i].header_bytes;
+        aux_bytes += report.buckets[i].aux_bytes;
+        num_freed_objects += report.buckets[i].num_freed_objects;
+    }
+    ZASSERT(report.cycle);
+    /* Each node, its name, the buffer array, the buffers and what points at the freed object. */
+    ZASSERT(num_objects >= NUM_NODES * 2 + NUM_BUFFERS + 2);
+    ZASSERT(payload_bytes >= NUM_NODES * (sizeof(struct node) + 16) + NUM_BUFFERS * BUFFER_SIZE);
+    ZASSERT(header_bytes == num_objects * 16);
+    /* The nodes and the buffer array hold ptrs, so they have auxes. */
+    ZASSERT(aux_bytes >= NUM_NODES * sizeof(struct node) + NUM_BUFFERS * sizeof(char*));
+    ZASSERT(num_freed_objects >= 1);
+
+    for (i = 0; head; head = head->next, ++i)
+        ZASSERT(!strcmp(head->name, "hello"));
+    ZASSERT(i == NUM_NODES);
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdfil.h>
+
+#define NUM_SMALL 100000
+#define NUM_LARGE 16
+#define LARGE_SIZE (1024 * 1024)
+
+int main()
+{
+    char** small;
+    char** large;
+    unsigned index;
+
+    ZASSERT(zheap_reserve(8 * 1024 * 1024));
+    ZASSERT(zheap_prefault(64 * 1024 * 1024));
+    ZASSERT(zheap_prefault(0));
+    ZASSERT(!zheap_prefault((__SIZE_TYPE__)-1));
+
+    /* Memory from the reserve has to look just like fresh memory. */
+    small = malloc(sizeof(char*) * NUM_SMALL);
+    for (index = NUM_SMALL; index--;) {
+        small[index] = zgc_alloc(48);
+        for (unsigned byte = 0; byte < 48; ++byte)
+            ZASSERT(!small[index][byte]);
+        memset(small[index], (char)index, 48);
+    }
+    large = malloc(sizeof(char*) * NUM_LARGE);
+    for (index = NUM_LARGE; index--;) {
+        large[index] = zgc_alloc(LARGE_SIZE);
+        ZASSERT(!large[index][0]);
+        ZASSERT(!large[index][LARGE_SIZE - 1]);
+        memset(large[index], (char)index, LARGE_SIZE);
+    }
+
+    zgc_request_and_wait();
+    zscavenge_synchronously();
+
+    for (index = NUM_SMALL; index--;)
+        ZASSERT(small[index][47] == (char)index);
+    for (index = NUM_LARGE; index--;)
+        ZASSERT(large[index][LARGE_SIZE - 1] == (char)index);
+
+    printf("Success!\n");
+    return 0;
+}
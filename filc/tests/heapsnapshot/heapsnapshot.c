@@ -0,0 +1,86 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+
+#define NUM_NODES 1000
+
+struct node {
+    struct node* next;
+    char* name;
+};
+
+static volatile int done;
+
+static void* thread_main(void* arg)
+{
+    while (!done) {
+        char* garbage = opaque(malloc(64));
+        garbage[0] = 1;
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t t;
+    unsigned i;
+    struct node* head = NULL;
+    for (i = NUM_NODES; i--;) {
+        struct node* node = malloc(sizeof(struct node));
+        node->next = head;
+        node->name = malloc(16);
+        strcpy(node->name, "hello");
+        head = opaque(node);
+    }
+    pthread_create(&t, NULL, thread_main, NULL);
+
+    FILE* file = tmpfile();
+    ZASSERT(file);
+    ZASSERT(zgc_write_heap_snapshot(fileno(file)));
+    done = 1;
+    pthread_join(t, NULL);
+
+    rewind(file);
+    char line[256];
+    ZASSERT(fgets(line, sizeof(line), file));
+    ZASSERT(!strcmp(line, "filc heap snapshot 1\n"));
+    size_t num_objects = 0;
+    size_t num_leaves = 0;
+    int saw_end = 0;
+    int c;
+    int at_line_start = 1;
+    while ((c = fgetc(file)) != EOF) {
+        if (at_line_start) {
+            if (c == 'o')
+                num_objects++;
+            else if (c == 'l')
+                num_leaves++;
+            else if (c == 'e') {
+                size_t expected_objects;
+                size_t expected_leaves;
+                size_t expected_edges;
+                ZASSERT(fscanf(file, "nd %zu %zu %zu", &expected_objects, &expected_leaves,
+                               &expected_edges) == 3);
+                ZASSERT(expected_objects == num_objects);
+                ZASSERT(expected_leaves == num_leaves);
+                /* Each node points at its name and all but the last point at the next node. */
+                ZASSERT(expected_edges >= NUM_NODES * 2 - 1);
+                saw_end = 1;
+            }
+        }
+        at_line_start = c == '\n';
+    }
+    ZASSERT(saw_end);
+    /* Every node gets scanned and points at its name, which is a leaf. */
+    ZASSERT(num_objects >= NUM_NODES);
+    ZASSERT(num_leaves >= NUM_NODES);
+
+    for (i = 0; head; head = head->next, ++i)
+        ZASSERT(!strcmp(head->name, "hello"));
+    ZASSERT(i == NUM_NODES);
+    printf("Success!\n");
+    return 0;
+}
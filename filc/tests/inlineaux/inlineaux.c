@@ -0,0 +1,61 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+
+#define NUM_ITERATIONS 100000
+
+struct node {
+    struct node* next;
+    char* name;
+};
+
+static volatile int done;
+
+static void* thread_main(void* arg)
+{
+    while (!done)
+        zgc_request_and_wait();
+    return NULL;
+}
+
+static void fill(struct node* nodes, unsigned count, unsigned index)
+{
+    unsigned i;
+    for (i = count; i--;) {
+        nodes[i].next = i ? nodes + i - 1 : NULL;
+        nodes[i].name = malloc(16);
+        snprintf(nodes[i].name, 16, "node%u", index + i);
+    }
+}
+
+/* The nodes escape into opaque(), so they get heap allocated. Their type has ptrs, so their aux gets
+   allocated along with them. */
+static void test(unsigned index)
+{
+    struct node nodes[4];
+    char buf[16];
+    unsigned i;
+    fill(opaque(nodes), 4, index);
+    for (i = 4; i--;) {
+        snprintf(buf, sizeof(buf), "node%u", index + i);
+        ZASSERT(!strcmp(nodes[i].name, buf));
+        ZASSERT(nodes[i].next == (i ? nodes + i - 1 : NULL));
+    }
+    ZASSERT(zhasvalidcap(nodes[3].next));
+}
+
+int main()
+{
+    pthread_t t;
+    unsigned index;
+    pthread_create(&t, NULL, thread_main, NULL);
+    for (index = 0; index < NUM_ITERATIONS; ++index)
+        test(index);
+    done = 1;
+    pthread_join(t, NULL);
+    printf("Success!\n");
+    return 0;
+}
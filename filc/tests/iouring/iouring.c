@@ -0,0 +1,110 @@
+#include <pizlonated_syscalls.h>
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "utils.h"
+
+#define IORING_OP_NOP 0
+#define IORING_OP_READ 22
+#define IORING_OP_WRITE 23
+
+static void submit_one(void* ring, int opcode, int fd, void* buf, unsigned len, void* user_data)
+{
+    struct zsys_io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = buf;
+    sqe.len = len;
+    sqe.user_data = user_data;
+    ZASSERT(!zsys_io_uring_prep(ring, &sqe));
+}
+
+static struct zsys_io_uring_cqe wait_one(void* ring)
+{
+    struct zsys_io_uring_cqe cqe;
+    ZASSERT(zsys_io_uring_submit(ring, 1) >= 0);
+    ZASSERT(zsys_io_uring_reap(ring, &cqe, 1) == 1);
+    return cqe;
+}
+
+static int find_ring_fd(void)
+{
+    int fd;
+    for (fd = 0; fd < 1024; ++fd) {
+        char path[64];
+        char target[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+        ssize_t length = readlink(path, target, sizeof(target) - 1);
+        if (length < 0)
+            continue;
+        target[length] = 0;
+        if (!strcmp(target, "anon_inode:[io_uring]"))
+            return fd;
+    }
+    return -1;
+}
+
+int main()
+{
+    void* ring = zsys_io_uring_setup(8, 0);
+    if (!ring) {
+        /* Not every kernel (or sandbox) lets us have io_uring. */
+        ZASSERT(errno == ENOSYS || errno == EPERM);
+        printf("Success!\n");
+        return 0;
+    }
+
+    int fds[2];
+    ZASSERT(!pipe(fds));
+
+    int* tag = malloc(sizeof(int));
+    *tag = 666;
+    submit_one(ring, IORING_OP_NOP, -1, NULL, 0, tag);
+    struct zsys_io_uring_cqe cqe = wait_one(ring);
+    ZASSERT(cqe.user_data == tag);
+    ZASSERT(*(int*)cqe.user_data == 666);
+    ZASSERT(!cqe.res);
+
+    char* message = strdup("hello");
+    submit_one(ring, IORING_OP_WRITE, fds[1], message, 5, message);
+    /* The ring keeps the buffer alive even though we free it before the I/O happens. */
+    free(message);
+    cqe = wait_one(ring);
+    ZASSERT(cqe.res == 5);
+
+    char* buf = opaque(malloc(16));
+    memset(buf, 0, 16);
+    submit_one(ring, IORING_OP_READ, fds[0], buf, 16, buf);
+    cqe = wait_one(ring);
+    ZASSERT(cqe.user_data == buf);
+    ZASSERT(cqe.res == 5);
+    ZASSERT(!strcmp(buf, "hello"));
+
+    ZASSERT(!zsys_io_uring_reap(ring, &cqe, 1));
+
+    /* The ring's fd belongs to the runtime, so we can't close it, dup it, or map the rings. */
+    int ring_fd = find_ring_fd();
+    if (ring_fd >= 0) {
+        ZASSERT(zsys_close(ring_fd) == -1);
+        ZASSERT(errno == EBADF);
+        ZASSERT(zsys_dup(ring_fd) == -1);
+        ZASSERT(errno == EBADF);
+        ZASSERT(zsys_dup2(ring_fd, fds[0]) == -1);
+        ZASSERT(errno == EBADF);
+        ZASSERT(zsys_dup2(fds[0], ring_fd) == -1);
+        ZASSERT(errno == EBADF);
+        ZASSERT(zsys_mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0)
+                == MAP_FAILED);
+        ZASSERT(errno == EBADF);
+        submit_one(ring, IORING_OP_NOP, -1, NULL, 0, NULL);
+        ZASSERT(!wait_one(ring).res);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define NUM_OBJECTS 8
+#define NUM_ROUNDS 10
+
+static size_t sizes[] = { 300000, 1000000, 2500000 };
+
+int main()
+{
+    unsigned round;
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        size_t size = sizes[round % (sizeof(sizes) / sizeof(sizes[0]))];
+        char* objects[NUM_OBJECTS];
+        unsigned index;
+        for (index = 0; index < NUM_OBJECTS; ++index) {
+            size_t offset;
+            objects[index] = opaque(malloc(size));
+            for (offset = 0; offset < size; ++offset)
+                ZASSERT(!objects[index][offset]);
+            memset(objects[index], 0xff, size);
+        }
+        for (index = 0; index < NUM_OBJECTS; ++index)
+            objects[index] = opaque(NULL);
+        zgc_request_and_wait();
+    }
+
+    printf("Success!\n");
+    return 0;
+}
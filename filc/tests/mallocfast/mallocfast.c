@@ -0,0 +1,51 @@
+#include <stdfil.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+int main()
+{
+    char* ptr = opaque(malloc(100));
+    ZASSERT(ptr);
+    ZASSERT(zlength(ptr) >= 100);
+    ZASSERT(!((uintptr_t)ptr % 16));
+    strcpy(ptr, "hello, malloc");
+
+    ptr = opaque(realloc(ptr, 10000));
+    ZASSERT(zlength(ptr) >= 10000);
+    ZASSERT(!strcmp(ptr, "hello, malloc"));
+    ptr[9999] = 42;
+    free(ptr);
+
+    int* ints = opaque(calloc(1000, sizeof(int)));
+    ZASSERT(zlength(ints) >= 1000 * sizeof(int));
+    unsigned index;
+    for (index = 1000; index--;)
+        ZASSERT(!ints[index]);
+    free(ints);
+
+    volatile size_t huge = SIZE_MAX / 2;
+    errno = 0;
+    ZASSERT(!calloc(huge, 3));
+    ZASSERT(errno == ENOMEM);
+
+    ptr = opaque(realloc(NULL, 10));
+    ZASSERT(zlength(ptr) >= 10);
+    free(ptr);
+    free(NULL);
+
+    void** ptrs = opaque(malloc(sizeof(void*) * 10));
+    for (index = 10; index--;)
+        ptrs[index] = malloc(index);
+    for (index = 10; index--;)
+        ZASSERT(zhasvalidcap(ptrs[index]));
+    for (index = 10; index--;)
+        free(ptrs[index]);
+    free(ptrs);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+static __attribute__((noinline)) char* dup(const char* src, size_t size)
+{
+    char* result = malloc(size);
+    memcpy(result, src, size);
+    return result;
+}
+
+static __attribute__((noinline)) char* fill(int value, size_t size)
+{
+    char* result = malloc(size);
+    memset(result, value, size);
+    return result;
+}
+
+static void dirty(size_t size)
+{
+    unsigned index;
+    for (index = 1000; index--;)
+        free(opaque(fill(0xff, (size + 15) & ~(size_t)15)));
+    zgc_request_and_wait();
+}
+
+static void check_padding(char* ptr, size_t size)
+{
+    size_t index;
+    for (index = size; index < zlength(ptr); ++index)
+        ZASSERT(!ptr[index]);
+}
+
+int main()
+{
+    char src[100];
+    size_t index;
+    for (index = sizeof(src); index--;)
+        src[index] = (char)(index + 1);
+
+    size_t size;
+    for (size = 1; size <= sizeof(src); ++size) {
+        dirty(size);
+        char* copy = opaque(dup(src, size));
+        ZASSERT(zlength(copy) >= size);
+        ZASSERT(!memcmp(copy, src, size));
+        check_padding(copy, size);
+        char* filled = opaque(fill(42, size));
+        for (index = size; index--;)
+            ZASSERT(filled[index] == 42);
+        check_padding(filled, size);
+        free(copy);
+        free(filled);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdfil.h>
+#include <cpuid.h>
+#include <immintrin.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+static volatile int lane_values[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+static bool has_avx(void)
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    if (!(ecx & bit_AVX) || !(ecx & bit_OSXSAVE))
+        return false;
+    return (zxgetbv() & 6) == 6;
+}
+
+/* Builds the mask from memory, so that the compiler can't see which lanes are enabled. */
+__attribute__((target("avx"))) static __m256i make_mask(unsigned num_lanes)
+{
+    int lanes[8];
+    unsigned index;
+    for (index = 0; index < 8; ++index)
+        lanes[index] = index < num_lanes ? lane_values[index] : 0;
+    return _mm256_loadu_si256((__m256i*)lanes);
+}
+
+__attribute__((target("avx"))) static void test(void)
+{
+    float* buf = opaque(malloc(sizeof(float) * 5));
+    float result[8];
+    unsigned index;
+    for (index = 0; index < 5; ++index)
+        buf[index] = index + 1;
+
+    /* The disabled lanes run past the end of buf, which is fine, since they don't get touched. */
+    _mm256_storeu_ps(result, _mm256_maskload_ps(buf + 2, make_mask(3)));
+    ZASSERT(result[0] == 3);
+    ZASSERT(result[1] == 4);
+    ZASSERT(result[2] == 5);
+    for (index = 3; index < 8; ++index)
+        ZASSERT(result[index] == 0);
+
+    _mm256_maskstore_ps(buf + 1, make_mask(4), _mm256_set1_ps(42));
+    ZASSERT(buf[0] == 1);
+    for (index = 1; index < 5; ++index)
+        ZASSERT(buf[index] == 42);
+
+    /* A mask with no lanes doesn't access anything, so it doesn't even need to be in bounds. */
+    _mm256_maskstore_ps(buf + 5, make_mask(0), _mm256_set1_ps(666));
+    _mm256_storeu_ps(result, _mm256_maskload_ps(buf + 100, make_mask(0)));
+    for (index = 0; index < 8; ++index)
+        ZASSERT(result[index] == 0);
+}
+
+int main()
+{
+    if (has_avx())
+        test();
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdfil.h>
+#include <immintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+static volatile int lane_values[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+__attribute__((target("avx"))) static __m256i make_mask(unsigned num_lanes)
+{
+    int lanes[8];
+    unsigned index;
+    for (index = 0; index < 8; ++index)
+        lanes[index] = index < num_lanes ? lane_values[index] : 0;
+    return _mm256_loadu_si256((__m256i*)lanes);
+}
+
+/* Lane 3 is enabled and runs past the end of buf. */
+__attribute__((target("avx"))) static void test(void)
+{
+    float* buf = opaque(malloc(sizeof(float) * 5));
+    float result[8];
+    _mm256_storeu_ps(result, _mm256_maskload_ps(buf + 2, make_mask(4)));
+    printf("result[0] = %f\n", result[0]);
+}
+
+int main()
+{
+    test();
+    return 0;
+}
@@ -0,0 +1,51 @@
+#define _GNU_SOURCE
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+#define SIZE 100000
+
+int main()
+{
+    char* a = opaque(malloc(SIZE));
+    char* b = opaque(malloc(SIZE));
+    memset(a, 'x', SIZE);
+    memset(b, 'x', SIZE);
+
+    ZASSERT(!memcmp(a, b, SIZE));
+    ZASSERT(!bcmp(a, b, SIZE));
+    ZASSERT(!memcmp(a, b, 0));
+    b[SIZE - 1] = 'y';
+    ZASSERT(memcmp(a, b, SIZE) < 0);
+    ZASSERT(memcmp(b, a, SIZE) > 0);
+    ZASSERT(!memcmp(a, b, SIZE - 1));
+    ZASSERT(bcmp(a, b, SIZE));
+
+    ZASSERT(memchr(b, 'y', SIZE) == b + SIZE - 1);
+    ZASSERT(!memchr(b, 'y', SIZE - 1));
+    ZASSERT(!memchr(a, 'y', SIZE));
+    a[10] = 'y';
+    a[20001] = 'y';
+    ZASSERT(memchr(a, 'y', SIZE) == a + 10);
+    ZASSERT(memrchr(a, 'y', SIZE) == a + 20001);
+    ZASSERT(memrchr(a, 'y', 20001) == a + 10);
+    ZASSERT(!memrchr(a, 'y', 10));
+    char* found = memrchr(a, 'y', SIZE);
+    ZASSERT(zgetlower(found) == a);
+    ZASSERT(zgetupper(found) == a + SIZE);
+
+    memcpy(a + 9999, "needle", 6);
+    ZASSERT(memmem(a, SIZE, "needle", 6) == a + 9999);
+    ZASSERT(!memmem(a, 10004, "needle", 6));
+    ZASSERT(memmem(a, 10005, "needle", 6) == a + 9999);
+    ZASSERT(!memmem(a, SIZE, "needles", 7));
+    ZASSERT(memmem(a, SIZE, "", 0) == a);
+    found = memmem(a, SIZE, "dle", 3);
+    ZASSERT(found == a + 10002);
+    ZASSERT(zgetlower(found) == a);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "utils.h"
+
+struct message {
+    char* name;
+    unsigned long value;
+};
+
+int main()
+{
+    struct message* shared = mmap(NULL, 16384, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1,
+                                  0);
+    ZASSERT(shared != MAP_FAILED);
+    struct message* private = mmap(NULL, 16384, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1,
+                                   0);
+    ZASSERT(private != MAP_FAILED);
+
+    struct message* local = opaque(malloc(sizeof(struct message) * 2));
+    local[0].name = opaque(strdup("hello"));
+    local[0].value = 42;
+    local[1].name = NULL;
+    local[1].value = 666;
+
+    /* Copying into shared memory only copies the bytes, so the ptr loses its capability. */
+    memcpy(shared, local, sizeof(struct message) * 2);
+    ZASSERT(shared[0].name == local[0].name);
+    ZASSERT(!zhasvalidcap(shared[0].name));
+    ZASSERT(shared[0].value == 42);
+    ZASSERT(!shared[1].name);
+    ZASSERT(shared[1].value == 666);
+
+    /* Private mappings work like any other memory. */
+    memcpy(private, local, sizeof(struct message) * 2);
+    ZASSERT(zhasvalidcap(private[0].name));
+    ZASSERT(!strcmp(private[0].name, "hello"));
+
+    /* Atomic ints go straight to shared memory. */
+    ZASSERT(__atomic_add_fetch(&shared[1].value, 1, __ATOMIC_SEQ_CST) == 667);
+
+    /* Storing a ptr directly works, after which the mapping is like a private one. */
+    shared[2].name = local[0].name;
+    ZASSERT(zhasvalidcap(shared[2].name));
+    ZASSERT(!strcmp(shared[2].name, "hello"));
+    memcpy(shared + 3, local, sizeof(struct message));
+    ZASSERT(zhasvalidcap(shared[3].name));
+
+    ZASSERT(!munmap(shared, 16384));
+    ZASSERT(!munmap(private, 16384));
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+#include <pizlonated_syscalls.h>
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "utils.h"
+
+#define NUM_MSGS 64
+#define MSG_SIZE 32
+
+int main()
+{
+    int fds[2];
+    ZASSERT(!socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+
+    struct mmsghdr* msgs = opaque(malloc(sizeof(struct mmsghdr) * NUM_MSGS));
+    struct iovec* iovs = opaque(malloc(sizeof(struct iovec) * NUM_MSGS));
+    char* bufs = opaque(malloc(NUM_MSGS * MSG_SIZE));
+    unsigned index;
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * NUM_MSGS);
+    for (index = NUM_MSGS; index--;) {
+        snprintf(bufs + index * MSG_SIZE, MSG_SIZE, "datagram %u", index);
+        iovs[index].iov_base = bufs + index * MSG_SIZE;
+        iovs[index].iov_len = strlen(bufs + index * MSG_SIZE) + 1;
+        msgs[index].msg_hdr.msg_iov = iovs + index;
+        msgs[index].msg_hdr.msg_iovlen = 1;
+    }
+    ZASSERT(zsys_sendmmsg(fds[0], msgs, NUM_MSGS, 0) == NUM_MSGS);
+    for (index = NUM_MSGS; index--;)
+        ZASSERT(msgs[index].msg_len == iovs[index].iov_len);
+
+    memset(bufs, 0, NUM_MSGS * MSG_SIZE);
+    memset(msgs, 0, sizeof(struct mmsghdr) * NUM_MSGS);
+    for (index = NUM_MSGS; index--;) {
+        iovs[index].iov_base = bufs + index * MSG_SIZE;
+        iovs[index].iov_len = MSG_SIZE;
+        msgs[index].msg_hdr.msg_iov = iovs + index;
+        msgs[index].msg_hdr.msg_iovlen = 1;
+    }
+    ZASSERT(zsys_recvmmsg(fds[1], msgs, NUM_MSGS, 0, NULL) == NUM_MSGS);
+    for (index = NUM_MSGS; index--;) {
+        char expected[MSG_SIZE];
+        snprintf(expected, MSG_SIZE, "datagram %u", index);
+        ZASSERT(msgs[index].msg_len == strlen(expected) + 1);
+        ZASSERT(!strcmp(bufs + index * MSG_SIZE, expected));
+    }
+
+    printf("Success!\n");
+    return 0;
+}
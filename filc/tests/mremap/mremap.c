@@ -0,0 +1,45 @@
+#include <pizlonated_syscalls.h>
+#include <stdfil.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "utils.h"
+
+int main()
+{
+    size_t page_size = getpagesize();
+    char* ptr = mmap(0, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    ZASSERT(ptr != MAP_FAILED);
+    strcpy(ptr, "hello, mremap");
+
+    ZASSERT(zsys_mremap(ptr, page_size, page_size * 4, 0) == MAP_FAILED);
+    ZASSERT(errno == ENOMEM);
+    ZASSERT(zsys_mremap(ptr, page_size, page_size * 4, MREMAP_FIXED) == MAP_FAILED);
+    ZASSERT(errno == EINVAL);
+
+    char* grown = opaque(zsys_mremap(ptr, page_size, page_size * 4, MREMAP_MAYMOVE));
+    ZASSERT(grown != MAP_FAILED);
+    ZASSERT(zlength(grown) == page_size * 4);
+    ZASSERT(!strcmp(grown, "hello, mremap"));
+    memset(grown + page_size, 42, page_size * 3);
+    ZASSERT(grown[page_size * 4 - 1] == 42);
+
+    ZASSERT(zsys_mremap(grown, page_size * 4, page_size, 0) == grown);
+    ZASSERT(!strcmp(grown, "hello, mremap"));
+    ZASSERT(!grown[page_size]);
+
+    ZASSERT(!munmap(grown, page_size * 4));
+
+    /* Shared mappings can't grow, since the new pages would have to be shared, too. */
+    char* shared = mmap(0, page_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    ZASSERT(shared != MAP_FAILED);
+    ZASSERT(zsys_mremap(shared, page_size, page_size * 4, MREMAP_MAYMOVE) == MAP_FAILED);
+    ZASSERT(errno == ENOMEM);
+    ZASSERT(zsys_mremap(shared, page_size, page_size, MREMAP_MAYMOVE) == shared);
+    ZASSERT(!munmap(shared, page_size));
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <pizlonated_syscalls.h>
+#include <pthread.h>
+#include <stdfil.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "utils.h"
+
+/* Grows mappings with mremap while other threads mmap, fill, and check their own mappings. If
+   mremap ever left a hole where the old mapping was, then the mmaps (or the heap growth and thread
+   stacks behind them) could land in it, and mremap would map over them. */
+
+#define NTHREADS 8
+#define REPEAT 2000
+
+static size_t page_size;
+
+static void check_filled(char* ptr, size_t size, char value)
+{
+    size_t index;
+    for (index = 0; index < size; index += page_size)
+        ZASSERT(ptr[index] == value);
+    ZASSERT(ptr[size - 1] == value);
+}
+
+static void* nop_thread_main(void* arg)
+{
+    return arg;
+}
+
+static void* mmap_thread_main(void* arg)
+{
+    char value = (char)(uintptr_t)arg;
+    unsigned i;
+    for (i = REPEAT; i--;) {
+        size_t size = page_size * (1 + i % 64);
+        if (!(i % 100))
+            size = 1024 * 1024 * 16;
+        char* ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        ZASSERT(ptr != MAP_FAILED);
+        memset(ptr, value, size);
+        if (!(i % 50)) {
+            pthread_t thread;
+            ZASSERT(!pthread_create(&thread, NULL, nop_thread_main, NULL));
+            ZASSERT(!pthread_join(thread, NULL));
+        }
+        check_filled(ptr, size, value);
+        ZASSERT(!munmap(ptr, size));
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[NTHREADS];
+    unsigned i;
+
+    page_size = getpagesize();
+
+    for (i = NTHREADS; i--;)
+        ZASSERT(!pthread_create(threads + i, NULL, mmap_thread_main, (void*)(uintptr_t)(i + 1)));
+
+    for (i = REPEAT; i--;) {
+        size_t size = page_size * (1 + i % 16);
+        char* ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        ZASSERT(ptr != MAP_FAILED);
+        memset(ptr, 'x', size);
+        char* grown = opaque(zsys_mremap(ptr, size, size * 4, MREMAP_MAYMOVE));
+        ZASSERT(grown != MAP_FAILED);
+        ZASSERT(zlength(grown) == size * 4);
+        check_filled(grown, size, 'x');
+        check_filled(grown + size, size * 3, 0);
+        ZASSERT(!munmap(grown, size * 4));
+    }
+
+    for (i = NTHREADS; i--;)
+        ZASSERT(!pthread_join(threads[i], NULL));
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <pizlonated_syscalls.h>
+#include <stdfil.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "utils.h"
+
+#define PATH "filc/test-output/msync/msync.dat"
+#define SIZE 65536
+
+int main()
+{
+    unlink(PATH);
+    int fd = open(PATH, O_CREAT | O_RDWR, 0644);
+    ZASSERT(fd > 2);
+    ZASSERT(!ftruncate(fd, SIZE));
+
+    char* memory = mmap(NULL, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ZASSERT(memory != MAP_FAILED);
+    ZASSERT(!zsys_madvise(memory, SIZE, MADV_SEQUENTIAL));
+    ZASSERT(!zsys_madvise(memory, SIZE, MADV_WILLNEED));
+
+    strcpy(memory + SIZE / 2, "hello, msync");
+    ZASSERT(zsys_msync(memory, SIZE, MS_SYNC | MS_ASYNC));
+    ZASSERT(errno == EINVAL);
+    ZASSERT(zsys_msync(memory + 1, SIZE - 1, MS_SYNC));
+    ZASSERT(errno == EINVAL);
+    ZASSERT(!zsys_msync(memory, SIZE, MS_SYNC));
+
+    char buf[100];
+    ZASSERT(pread(fd, buf, sizeof(buf), SIZE / 2) == sizeof(buf));
+    ZASSERT(!strcmp(buf, "hello, msync"));
+
+    ZASSERT(!munmap(memory, SIZE));
+    close(fd);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+struct thing {
+    int x;
+    int y;
+    struct thing* next;
+};
+
+static struct thing global_thing;
+
+__attribute__((optnone, noinline)) static int sum_list(struct thing* head)
+{
+    int result = 0;
+    struct thing* current = head;
+    while (current) {
+        result += current->x;
+        result += current->y;
+        current = current->next;
+        if (current)
+            result += current->x;
+    }
+    return result;
+}
+
+__attribute__((optnone, noinline)) static int reassign(struct thing* a, struct thing* b)
+{
+    struct thing* p = a;
+    int result = p->x;
+    p = b;
+    result += p->x;
+    p->y = 100;
+    result += a->y + b->y;
+    p = a;
+    result += p->y;
+    return result;
+}
+
+__attribute__((optnone, noinline)) static int escaped(struct thing* a, struct thing* b)
+{
+    struct thing* p = a;
+    struct thing** pp = opaque(&p);
+    int result = p->x;
+    *pp = b;
+    result += p->x;
+    return result;
+}
+
+__attribute__((optnone, noinline)) static int globals(void)
+{
+    struct thing* p = &global_thing;
+    p->x = 5;
+    p->y = 6;
+    return global_thing.x + p->y;
+}
+
+int main()
+{
+    struct thing* a = opaque(malloc(sizeof(struct thing)));
+    struct thing* b = opaque(malloc(sizeof(struct thing)));
+    a->x = 1;
+    a->y = 2;
+    a->next = b;
+    b->x = 3;
+    b->y = 4;
+    b->next = NULL;
+
+    ZASSERT(sum_list(a) == 1 + 2 + 3 + 3 + 4);
+    ZASSERT(reassign(a, b) == 1 + 3 + 2 + 100 + 2);
+    ZASSERT(b->y == 100);
+    ZASSERT(escaped(a, b) == 1 + 3);
+    ZASSERT(globals() == 11);
+    ZASSERT(global_thing.x == 5);
+
+    printf("Success!\n");
+    return 0;
+}
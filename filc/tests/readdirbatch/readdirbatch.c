@@ -0,0 +1,63 @@
+#include <stdfil.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "utils.h"
+
+#define DIR_PATH "filc/test-output/readdirbatch/dir"
+#define NUM_FILES 100
+
+int main()
+{
+    char path[256];
+    unsigned index;
+    mkdir(DIR_PATH, 0755);
+    for (index = 0; index < NUM_FILES; ++index) {
+        snprintf(path, sizeof(path), DIR_PATH "/file%u", index);
+        int fd = open(path, O_CREAT | O_WRONLY, 0644);
+        ZASSERT(fd > 2);
+        close(fd);
+    }
+
+    int fd = open(DIR_PATH, O_RDONLY | O_DIRECTORY);
+    ZASSERT(fd > 2);
+    bool* seen = opaque(calloc(NUM_FILES, sizeof(bool)));
+    zdirent* entries = opaque(malloc(sizeof(zdirent) * 7));
+    unsigned num_files = 0;
+    unsigned num_dots = 0;
+    for (;;) {
+        long result = zreaddir_batch(fd, entries, 7);
+        ZASSERT(result >= 0);
+        ZASSERT(result <= 7);
+        if (!result)
+            break;
+        long entry_index;
+        for (entry_index = 0; entry_index < result; ++entry_index) {
+            const char* name = entries[entry_index].name;
+            if (!strcmp(name, ".") || !strcmp(name, "..")) {
+                ZASSERT(entries[entry_index].type == DT_DIR
+                        || entries[entry_index].type == DT_UNKNOWN);
+                num_dots++;
+                continue;
+            }
+            ZASSERT(!strncmp(name, "file", 4));
+            unsigned file_index = atoi(name + 4);
+            ZASSERT(file_index < NUM_FILES);
+            ZASSERT(!seen[file_index]);
+            ZASSERT(zlength(name) > strlen(name));
+            seen[file_index] = true;
+            num_files++;
+        }
+    }
+    ZASSERT(num_dots == 2);
+    ZASSERT(num_files == NUM_FILES);
+    close(fd);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include <stdfil.h>
+#include <stdint.h>
+#include "utils.h"
+
+static const char hello[] = "hello";
+
+int main()
+{
+    const char* str = opaque(hello);
+    ZASSERT(zgetupper(str) == str + sizeof(hello));
+    ZASSERT(str[4] == 'o');
+    char* far = opaque((char*)str + ((uintptr_t)1 << 63));
+    zprintf("Got this far.\n");
+    far[0] = 'j';
+    zprintf("Should not get this far.\n");
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "utils.h"
+
+#define NUM_THREADS 10
+#define NUM_OBJECTS 1000
+#define NUM_ROUNDS 3
+
+struct node {
+    struct node* next;
+    unsigned index;
+    char payload[1];
+};
+
+static struct node* allocate_nodes(unsigned seed)
+{
+    struct node* head = NULL;
+    unsigned i;
+    for (i = 0; i < NUM_OBJECTS; ++i) {
+        size_t size = sizeof(struct node) + (i * 7 + seed) % 600;
+        struct node* node = opaque(malloc(size));
+        node->next = head;
+        node->index = i;
+        memset(node->payload, (char)i, size - __builtin_offsetof(struct node, payload));
+        head = node;
+    }
+    return head;
+}
+
+static void check_nodes(struct node* head)
+{
+    unsigned i = NUM_OBJECTS;
+    for (; head; head = head->next) {
+        ZASSERT(head->index == --i);
+        ZASSERT(head->payload[0] == (char)head->index);
+    }
+    ZASSERT(!i);
+}
+
+/* Each thread warms up its allocators and then blocks for longer than the reclaim period, so the
+   collector empties its caches while it's exited. Then it has to be able to allocate again. */
+static void* thread_main(void* arg)
+{
+    unsigned round;
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        struct node* head = allocate_nodes((unsigned)(uintptr_t)arg + round);
+        usleep(600000);
+        check_nodes(head);
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[NUM_THREADS];
+    unsigned i;
+    for (i = NUM_THREADS; i--;)
+        pthread_create(threads + i, NULL, thread_main, (void*)(uintptr_t)i);
+    for (i = 20; i--;) {
+        check_nodes(allocate_nodes(i));
+        usleep(100000);
+    }
+    for (i = NUM_THREADS; i--;)
+        pthread_join(threads[i], NULL);
+    printf("Success!\n");
+    return 0;
+}
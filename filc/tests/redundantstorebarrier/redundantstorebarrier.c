@@ -0,0 +1,71 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+
+#define NUM_NODES 1000
+#define REPEAT 1000
+
+struct node {
+    struct node* left;
+    struct node* right;
+    char* name;
+};
+
+static struct node** nodes;
+static volatile int done;
+
+static void* thread_main(void* arg)
+{
+    while (!done)
+        zgc_request_and_wait();
+    return NULL;
+}
+
+/* Most of these store a ptr that we already stored since the last pollcheck, so only the first store
+   of each ptr needs a barrier. */
+static void link_node(struct node* node, struct node* other, char* name)
+{
+    node->left = other;
+    node->right = other;
+    node->name = name;
+    nodes[0]->left = other;
+    nodes[0]->name = name;
+}
+
+int main()
+{
+    pthread_t t;
+    unsigned i;
+    unsigned j;
+    nodes = opaque(malloc(sizeof(struct node*) * NUM_NODES));
+    for (i = NUM_NODES; i--;) {
+        nodes[i] = malloc(sizeof(struct node));
+        nodes[i]->left = NULL;
+        nodes[i]->right = NULL;
+        nodes[i]->name = NULL;
+    }
+    pthread_create(&t, NULL, thread_main, NULL);
+    for (j = REPEAT; j--;) {
+        for (i = NUM_NODES; i--;) {
+            struct node* other = malloc(sizeof(struct node));
+            other->left = NULL;
+            other->right = NULL;
+            other->name = NULL;
+            char* name = malloc(16);
+            strcpy(name, "hello");
+            link_node(opaque(nodes[i]), other, opaque(name));
+        }
+        for (i = NUM_NODES; i--;) {
+            ZASSERT(nodes[i]->left == nodes[i]->right);
+            ZASSERT(!nodes[i]->left->left);
+            ZASSERT(!strcmp(nodes[i]->name, "hello"));
+        }
+    }
+    done = 1;
+    pthread_join(t, NULL);
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <pizlonated_syscalls.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include "utils.h"
+
+static volatile int num_handled;
+
+static void handler(int signo)
+{
+    ZASSERT(signo == SIGUSR2);
+    num_handled++;
+}
+
+int main()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    ZASSERT(!zsys_sigprocmask(SIG_BLOCK, &set, NULL));
+
+    int fd = zsys_signalfd(-1, &set, 0);
+    ZASSERT(fd >= 0);
+
+    signal(SIGUSR2, handler);
+
+    unsigned i;
+    for (i = 0; i < 3; ++i) {
+        struct signalfd_siginfo info;
+        ZASSERT(!raise(SIGUSR1));
+        ZASSERT(!raise(SIGUSR2));
+        memset(&info, 0, sizeof(info));
+        ZASSERT(read(fd, &info, sizeof(info)) == sizeof(info));
+        ZASSERT(info.ssi_signo == SIGUSR1);
+    }
+    ZASSERT(num_handled == 3);
+
+    ZASSERT(!close(fd));
+    printf("Success!\n");
+    return 0;
+}
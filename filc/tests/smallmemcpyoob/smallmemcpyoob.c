@@ -0,0 +1,19 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+struct pair {
+    long a;
+    long b;
+};
+
+int main()
+{
+    struct pair src = { 1, 2 };
+    long* dst = opaque(malloc(sizeof(long)));
+    memcpy(dst, &src, sizeof(struct pair));
+    printf("dst = %ld\n", *dst);
+    return 0;
+}
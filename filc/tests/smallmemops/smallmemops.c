@@ -0,0 +1,61 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+struct ints {
+    int a;
+    long b;
+    char c[13];
+};
+
+struct ptrs {
+    int a;
+    char* name;
+    struct ptrs* next;
+};
+
+int main()
+{
+    struct ints* x = opaque(malloc(sizeof(struct ints)));
+    struct ints* y = opaque(malloc(sizeof(struct ints)));
+    x->a = 1;
+    x->b = 2;
+    strcpy(x->c, "hello");
+    *y = *x;
+    ZASSERT(y->a == 1);
+    ZASSERT(y->b == 2);
+    ZASSERT(!strcmp(y->c, "hello"));
+    memset(y, 0, sizeof(struct ints));
+    ZASSERT(!y->a);
+    ZASSERT(!y->b);
+    ZASSERT(!y->c[0]);
+
+    struct ptrs* p = opaque(malloc(sizeof(struct ptrs)));
+    struct ptrs* q = opaque(malloc(sizeof(struct ptrs)));
+    p->a = 42;
+    p->name = "hello";
+    p->next = p;
+    *q = *p;
+    ZASSERT(q->a == 42);
+    ZASSERT(!strcmp(q->name, "hello"));
+    ZASSERT(q->next == p);
+    ZASSERT(q->next->next == p);
+
+    /* Now copy ints over ptrs, so that the destination's aux has to get cleared. */
+    memcpy(q, x, sizeof(struct ptrs) < sizeof(struct ints) ? sizeof(struct ptrs)
+                                                          : sizeof(struct ints));
+    ZASSERT(zgetlower(q->name) == NULL);
+    memset(p, 0, sizeof(struct ptrs));
+    ZASSERT(!p->name);
+    ZASSERT(!p->next);
+
+    char buf[32];
+    memset(buf, 'x', sizeof(buf));
+    memmove(buf + 1, buf, 16);
+    ZASSERT(buf[0] == 'x' && buf[16] == 'x' && buf[31] == 'x');
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+#define NUM_SLOTS (4 * 1024 * 1024)
+#define REPEAT 10
+
+static char* make_name(unsigned index)
+{
+    char* result = malloc(32);
+    snprintf(result, 32, "name%u", index);
+    return result;
+}
+
+int main()
+{
+    unsigned j;
+    /* A big buffer that's mostly numbers, with a few ptrs in it. Only a few pages of its aux ever
+       get touched. */
+    char** slots = opaque(malloc(sizeof(char*) * NUM_SLOTS));
+    memset(slots, 0, sizeof(char*) * NUM_SLOTS);
+    for (j = 0; j < REPEAT; ++j) {
+        unsigned index = (j * 1234567u) % NUM_SLOTS;
+        slots[0] = make_name(0);
+        slots[NUM_SLOTS - 1] = make_name(NUM_SLOTS - 1);
+        slots[index] = make_name(index);
+        zgc_request_and_wait();
+        char buf[32];
+        snprintf(buf, sizeof(buf), "name%u", index);
+        ZASSERT(!strcmp(slots[index], buf));
+        ZASSERT(!strcmp(slots[0], "name0"));
+        snprintf(buf, sizeof(buf), "name%u", NUM_SLOTS - 1);
+        ZASSERT(!strcmp(slots[NUM_SLOTS - 1], buf));
+    }
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include "utils.h"
+
+/* The spin loop doesn't call anything and has no trip count bound, so the compiler may space out its
+   pollchecks, but it must not remove them. Otherwise the GC would never be able to handshake with
+   the spinning thread. */
+
+static volatile bool done = false;
+static volatile unsigned long counter = 0;
+
+static void* thread_main(void* arg)
+{
+    ZASSERT(!arg);
+    while (!done)
+        counter++;
+    return NULL;
+}
+
+/* This loop is small enough that it needs no pollcheck. */
+static unsigned sum(unsigned* array)
+{
+    unsigned result = 0;
+    for (unsigned i = 0; i < 100; ++i)
+        result += array[i];
+    return result;
+}
+
+int main()
+{
+    unsigned* array = opaque(zgc_alloc(sizeof(unsigned) * 100));
+    for (unsigned i = 0; i < 100; ++i)
+        array[i] = i;
+    ZASSERT(sum(array) == 4950);
+
+    pthread_t t;
+    ZASSERT(!pthread_create(&t, NULL, thread_main, NULL));
+    for (unsigned i = 0; i < 10; ++i)
+        zgc_request_and_wait();
+    done = true;
+    ZASSERT(!pthread_join(t, NULL));
+    ZASSERT(sum(array) == 4950);
+    printf("Success!\n");
+    return 0;
+}
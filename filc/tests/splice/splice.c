@@ -0,0 +1,66 @@
+#include <pizlonated_syscalls.h>
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "utils.h"
+
+static const char message[] = "hello, splice";
+
+static void read_exactly(int fd, char* buf, size_t size)
+{
+    while (size) {
+        long result = read(fd, buf, size);
+        ZASSERT(result > 0);
+        buf += result;
+        size -= result;
+    }
+}
+
+int main()
+{
+    int a[2];
+    int b[2];
+    int c[2];
+    ZASSERT(!pipe(a));
+    ZASSERT(!pipe(b));
+    ZASSERT(!pipe(c));
+
+    char* buf = opaque(strdup(message));
+    struct iovec* iov = opaque(malloc(sizeof(struct iovec)));
+    iov->iov_base = buf;
+    iov->iov_len = sizeof(message);
+    ZASSERT(zsys_vmsplice(a[1], iov, 1, 0) == sizeof(message));
+    /* The pipe must not see writes that happen after the vmsplice, since that memory could be
+       reused for some other object. */
+    memset(buf, 0, sizeof(message));
+
+    ZASSERT(zsys_tee(a[0], b[1], sizeof(message), 0) == sizeof(message));
+    ZASSERT(zsys_splice(a[0], NULL, c[1], NULL, sizeof(message), 0) == sizeof(message));
+
+    char* result = opaque(malloc(sizeof(message)));
+    read_exactly(b[0], result, sizeof(message));
+    ZASSERT(!strcmp(result, message));
+    memset(result, 0, sizeof(message));
+    read_exactly(c[0], result, sizeof(message));
+    ZASSERT(!strcmp(result, message));
+
+    FILE* in = tmpfile();
+    FILE* out = tmpfile();
+    ZASSERT(in);
+    ZASSERT(out);
+    ZASSERT(write(fileno(in), message, sizeof(message)) == sizeof(message));
+    long* off_in = opaque(malloc(sizeof(long)));
+    *off_in = 0;
+    ZASSERT(zsys_copy_file_range(fileno(in), off_in, fileno(out), NULL, sizeof(message), 0)
+            == sizeof(message));
+    ZASSERT(*off_in == sizeof(message));
+    memset(result, 0, sizeof(message));
+    ZASSERT(pread(fileno(out), result, sizeof(message), 0) == sizeof(message));
+    ZASSERT(!strcmp(result, message));
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NUM_ITERATIONS 100000
+
+struct pair {
+    char* first;
+    char* second;
+    unsigned index;
+};
+
+static volatile int done;
+
+static void* thread_main(void* arg)
+{
+    while (!done)
+        zgc_request_and_wait();
+    return NULL;
+}
+
+static inline void init_pair(struct pair* pair, unsigned index)
+{
+    pair->first = malloc(16);
+    pair->second = malloc(16);
+    snprintf(pair->first, 16, "first%u", index);
+    snprintf(pair->second, 16, "second%u", index);
+    pair->index = index;
+}
+
+static inline void swap_pair(struct pair* pair)
+{
+    char* tmp = pair->first;
+    pair->first = pair->second;
+    pair->second = tmp;
+}
+
+static inline int check_pair(struct pair* pair, unsigned index)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "first%u", index);
+    return pair->index == index && !strcmp(pair->second, buf);
+}
+
+/* The pair and the array never escape, so they can live in the native frame. The GC still has to
+   see the heap objects that they point to, even though this allocates a lot while they're live. */
+static void test(unsigned index)
+{
+    struct pair pair;
+    char* strings[4];
+    unsigned i;
+    init_pair(&pair, index);
+    for (i = 4; i--;)
+        strings[i] = pair.first;
+    swap_pair(&pair);
+    for (i = 4; i--;) {
+        char* tmp = malloc(16);
+        strcpy(tmp, strings[i]);
+        strings[i] = tmp;
+    }
+    ZASSERT(check_pair(&pair, index));
+    for (i = 4; i--;)
+        ZASSERT(!strcmp(strings[i], pair.second));
+}
+
+int main()
+{
+    pthread_t t;
+    unsigned i;
+    pthread_create(&t, NULL, thread_main, NULL);
+    for (i = NUM_ITERATIONS; i--;)
+        test(i);
+    done = 1;
+    pthread_join(t, NULL);
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Calls to extern "C" functions from system headers are nothrow, so they get no exception check
+// after them. Make sure that exceptions still get through the C++ code around them.
+
+class Exception {
+public:
+    Exception(size_t length)
+        : m_length(length)
+    {
+    }
+
+    size_t length() const { return m_length; }
+
+private:
+    size_t m_length;
+};
+
+static void __attribute__((noinline)) check_length(const char* string)
+{
+    size_t length = strlen(string);
+    if (length > 5)
+        throw Exception(length);
+}
+
+extern "C" void __attribute__((noinline)) not_from_a_system_header(const char* string)
+{
+    if (!strcmp(string, "throw"))
+        throw Exception(0);
+}
+
+int main()
+{
+    char* buffer = static_cast<char*>(zgc_alloc(100));
+    strcpy(buffer, "hello");
+    check_length(buffer);
+    bool caught = false;
+    try {
+        strcat(buffer, " world");
+        check_length(buffer);
+    } catch (const Exception& exception) {
+        ZASSERT(exception.length() == 11);
+        caught = true;
+    }
+    ZASSERT(caught);
+
+    caught = false;
+    try {
+        memset(buffer, 0, 100);
+        strcpy(buffer, "throw");
+        not_from_a_system_header(buffer);
+    } catch (const Exception& exception) {
+        ZASSERT(!exception.length());
+        caught = true;
+    }
+    ZASSERT(caught);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+static __attribute__((target_clones("avx2", "default"))) int sum(int* array, unsigned count)
+{
+    int result = 0;
+    unsigned index;
+    for (index = count; index--;)
+        result += array[index];
+    return result;
+}
+
+static __attribute__((target_clones("avx2", "sse4.2", "default"))) const char* best_isa(void)
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE4_2__)
+    return "sse4.2";
+#else
+    return "default";
+#endif
+}
+
+static int resolver_calls;
+
+static int add_one_slow(int x)
+{
+    return x + 1;
+}
+
+static int add_one_fast(int x)
+{
+    return 1 + x;
+}
+
+static int (*resolve_add_one(void))(int)
+{
+    resolver_calls++;
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2") ? add_one_fast : add_one_slow;
+}
+
+int add_one(int x) __attribute__((ifunc("resolve_add_one")));
+
+int main()
+{
+    unsigned count = 1000;
+    int* array = opaque(malloc(sizeof(int) * count));
+    unsigned index;
+    for (index = count; index--;)
+        array[index] = index;
+    ZASSERT(sum(array, count) == 499500);
+    ZASSERT(sum(array, 10) == 45);
+
+    __builtin_cpu_init();
+    const char* isa = best_isa();
+    ZASSERT(isa == best_isa());
+    if (__builtin_cpu_supports("avx2"))
+        ZASSERT(!strcmp(isa, "avx2"));
+    else if (__builtin_cpu_supports("sse4.2"))
+        ZASSERT(!strcmp(isa, "sse4.2"));
+    else
+        ZASSERT(!strcmp(isa, "default"));
+
+    /* We're on x86_64, so SSE2 is always there. */
+    ZASSERT(__builtin_cpu_supports("sse2"));
+
+    int (*add_one_ptr)(int) = (int (*)(int))opaque((void*)add_one);
+    ZASSERT(add_one(41) == 42);
+    ZASSERT(add_one_ptr(665) == 666);
+    ZASSERT(add_one(-1) == 0);
+    ZASSERT(resolver_calls == 1);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <pthread.h>
+#include <stdfil.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include "utils.h"
+
+#define REPEAT 1000
+
+static __thread int tls_counter;
+static int main_nice;
+
+static void* thread_main(void* arg)
+{
+    unsigned index = (unsigned)(unsigned long)arg;
+
+    /* Every thread must see fresh thread locals, even if it runs on a reused native thread. */
+    ZASSERT(!tls_counter);
+    tls_counter++;
+
+    /* Every thread must see the nice value of its creator, even if some earlier thread changed the
+       nice value of the native thread it ran on. */
+    errno = 0;
+    ZASSERT(getpriority(PRIO_PROCESS, 0) == main_nice);
+    ZASSERT(!errno);
+    if (!(index % 100))
+        ZASSERT(!setpriority(PRIO_PROCESS, 0, main_nice + 1));
+
+    if (index % 2)
+        pthread_exit(opaque(arg));
+    return opaque(arg);
+}
+
+int main()
+{
+    unsigned index;
+    errno = 0;
+    main_nice = getpriority(PRIO_PROCESS, 0);
+    ZASSERT(!errno);
+    for (index = 0; index < REPEAT; ++index) {
+        pthread_t t;
+        void* result;
+        ZASSERT(!pthread_create(&t, NULL, thread_main, (void*)(unsigned long)index));
+        ZASSERT(!pthread_join(t, &result));
+        ZASSERT(result == (void*)(unsigned long)index);
+    }
+    printf("Success!\n");
+    return 0;
+}
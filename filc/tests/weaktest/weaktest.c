@@ -0,0 +1,50 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "utils.h"
+
+#define NUM_WEAKS 100
+
+static int global;
+
+static __attribute__((noinline)) zweak* make_dead_weak(unsigned i)
+{
+    int* object = malloc(sizeof(int));
+    *object = i;
+    zweak* result = zweak_new(object);
+    ZASSERT(zweak_get(result) == object);
+    return result;
+}
+
+int main()
+{
+    zweak* dead[NUM_WEAKS];
+    zweak* live[NUM_WEAKS];
+    int* objects[NUM_WEAKS];
+    unsigned i;
+
+    for (i = NUM_WEAKS; i--;) {
+        dead[i] = make_dead_weak(i);
+        objects[i] = opaque(malloc(sizeof(int)));
+        *objects[i] = i;
+        live[i] = zweak_new(objects[i]);
+    }
+    zweak* null_weak = zweak_new(NULL);
+    zweak* int_weak = zweak_new((void*)666);
+    zweak* global_weak = zweak_new(&global);
+
+    zgc_request_and_wait();
+    zgc_request_and_wait();
+
+    for (i = NUM_WEAKS; i--;) {
+        ZASSERT(!zweak_get(dead[i]));
+        ZASSERT(zweak_get(live[i]) == objects[i]);
+        ZASSERT(*(int*)zweak_get(live[i]) == i);
+    }
+    ZASSERT(!zweak_get(null_weak));
+    ZASSERT(zweak_get(int_weak) == (void*)666);
+    ZASSERT(zweak_get(global_weak) == &global);
+
+    printf("Success!\n");
+    return 0;
+}
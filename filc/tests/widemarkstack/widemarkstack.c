@@ -0,0 +1,32 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "utils.h"
+
+#define NUM_OBJECTS 300000
+#define REPEAT 10
+
+/* One object pointing at lots of objects makes the mark stack span many chunks, which then get
+   split up between markers and donated around. */
+int main()
+{
+    unsigned i;
+    unsigned j;
+    int** objects = opaque(malloc(sizeof(int*) * NUM_OBJECTS));
+    for (i = NUM_OBJECTS; i--;) {
+        objects[i] = malloc(sizeof(int));
+        *objects[i] = i;
+    }
+    for (j = REPEAT; j--;) {
+        zgc_request_and_wait();
+        for (i = NUM_OBJECTS; i--;) {
+            ZASSERT(*objects[i] == i);
+            if (!(i % 3)) {
+                objects[i] = malloc(sizeof(int));
+                *objects[i] = i;
+            }
+        }
+    }
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "utils.h"
+
+static int sum(int* array, unsigned n)
+{
+    int result = 0;
+    for (unsigned i = 0; i < n; ++i)
+        result += array[i];
+    return result;
+}
+
+/* The limit is bigger than the array, but we stop before going out of bounds, so the widened check
+   must fail without killing us. */
+static int sum_until_zero(int* array, unsigned n)
+{
+    int result = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        if (!array[i])
+            break;
+        result += array[i];
+    }
+    return result;
+}
+
+static void fill(int* array, int start, int n)
+{
+    for (int i = start; i < n; ++i)
+        array[i + 1] = i;
+}
+
+int main()
+{
+    int* array = opaque(malloc(sizeof(int) * 10));
+    fill(array, -1, 9);
+    ZASSERT(array[0] == -1);
+    ZASSERT(array[9] == 8);
+    ZASSERT(sum(array, 10) == 35);
+    ZASSERT(sum(array, 0) == 0);
+    ZASSERT(sum(opaque(array + 5), 5) == 30);
+    array[0] = 1;
+    array[1] = 2;
+    array[5] = 0;
+    ZASSERT(sum_until_zero(array, 1000000) == 9);
+    ZASSERT(sum_until_zero(array, 0xffffffffu) == 9);
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "utils.h"
+
+/* The range of the loop is fine when we enter it, but the object gets freed partway through. */
+static int sum(int* array, unsigned n)
+{
+    int result = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        result += array[i];
+        if (i == 5) {
+            printf("freeing\n");
+            free(opaque(array));
+        }
+    }
+    return result;
+}
+
+int main()
+{
+    int* array = opaque(calloc(10, sizeof(int)));
+    printf("sum = %d\n", sum(array, 10));
+    return 0;
+}
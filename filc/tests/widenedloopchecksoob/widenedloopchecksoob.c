@@ -0,0 +1,20 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "utils.h"
+
+static void fill(int* array, unsigned n)
+{
+    for (unsigned i = 0; i < n; ++i)
+        array[i] = 42;
+}
+
+int main()
+{
+    int* array = opaque(malloc(sizeof(int) * 10));
+    fill(array, 10);
+    printf("filled\n");
+    fill(array, 11);
+    printf("filled too much\n");
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define SIZE 100000
+
+static unsigned crc32_bitwise(unsigned crc, const unsigned char* buf, size_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        unsigned bit;
+        crc ^= *buf++;
+        for (bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+    }
+    return ~crc;
+}
+
+static unsigned adler32_simple(unsigned adler, const unsigned char* buf, size_t len)
+{
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = adler >> 16;
+    while (len--) {
+        s1 = (s1 + *buf++) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return s1 | (s2 << 16);
+}
+
+int main()
+{
+    ZASSERT(zcrc32(0, "123456789", 9) == 0xcbf43926);
+    ZASSERT(zadler32(1, "Wikipedia", 9) == 0x11e60398);
+    ZASSERT(zcrc64(0, "123456789", 9) == 0x995dc9bbdf1939faull);
+    ZASSERT(zcrc32(1234, NULL, 0) == 1234);
+
+    unsigned char* buf = opaque(malloc(SIZE));
+    size_t index;
+    for (index = 0; index < SIZE; ++index)
+        buf[index] = (unsigned char)(index * 2654435761u >> 13);
+
+    size_t offset;
+    for (offset = 0; offset < 8; ++offset) {
+        size_t len;
+        for (len = 0; len < 1000; len += 37) {
+            ZASSERT(zcrc32(42, buf + offset, len) == crc32_bitwise(42, buf + offset, len));
+            ZASSERT(zadler32(1, buf + offset, len) == adler32_simple(1, buf + offset, len));
+        }
+    }
+
+    /* Checksumming in pieces has to give the same answer as all at once. */
+    ZASSERT(zcrc32(zcrc32(0, buf, 12345), buf + 12345, SIZE - 12345) == zcrc32(0, buf, SIZE));
+    ZASSERT(zadler32(zadler32(1, buf, 777), buf + 777, SIZE - 777) == zadler32(1, buf, SIZE));
+    ZASSERT(zcrc64(zcrc64(0, buf, 5), buf + 5, SIZE - 5) == zcrc64(0, buf, SIZE));
+    ZASSERT(zcrc32(0, buf, SIZE) == crc32_bitwise(0, buf, SIZE));
+    ZASSERT(zadler32(1, buf, SIZE) == adler32_simple(1, buf, SIZE));
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+static void unhex(const char* string, unsigned char* bytes)
+{
+    size_t index;
+    for (index = 0; string[index * 2]; ++index)
+        sscanf(string + index * 2, "%2hhx", bytes + index);
+}
+
+static void check_bytes(const unsigned char* bytes, const char* expected)
+{
+    unsigned char expected_bytes[64];
+    unhex(expected, expected_bytes);
+    ZASSERT(!memcmp(bytes, expected_bytes, strlen(expected) / 2));
+}
+
+static void test_sha(void)
+{
+    unsigned char block[128];
+    unsigned state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memset(block, 0, sizeof(block));
+    memcpy(block, "abc", 3);
+    block[3] = 0x80;
+    block[63] = 24;
+    zcrypto_sha256_blocks(state, block, 1);
+    ZASSERT(state[0] == 0xba7816bf);
+    ZASSERT(state[7] == 0xf20015ad);
+
+    unsigned long long state512[8] = {
+        0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull,
+        0xa54ff53a5f1d36f1ull, 0x510e527fade682d1ull, 0x9b05688c2b3e6c1full,
+        0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull
+    };
+    block[63] = 0;
+    block[127] = 24;
+    zcrypto_sha512_blocks(state512, block, 1);
+    ZASSERT(state512[0] == 0xddaf35a193617abaull);
+    ZASSERT(state512[7] == 0x2a9ac94fa54ca49full);
+}
+
+static void test_aes_gcm(void)
+{
+    unsigned char zero[16];
+    unsigned char h[16];
+    unsigned char ivec[16];
+    unsigned char ciphertext[16];
+    unsigned char xi[16];
+    unsigned char lengths[16];
+    unsigned char tag_mask[16];
+    zcrypto_aes_key key;
+    unsigned index;
+
+    if (!(zcrypto_features() & ZCRYPTO_AES) || !(zcrypto_features() & ZCRYPTO_PCLMUL))
+        return;
+
+    memset(zero, 0, sizeof(zero));
+    ZASSERT(!zcrypto_aes_set_encrypt_key(zero, 100, &key));
+    ZASSERT(zcrypto_aes_set_encrypt_key(zero, 128, &key));
+    ZASSERT(key.rounds == 10);
+
+    /* This is test case 2 from the GCM spec. */
+    zcrypto_aes_encrypt_block(zero, h, &key);
+    check_bytes(h, "66e94bd4ef8a2c3b884cfa59ca342b2e");
+    memset(ivec, 0, sizeof(ivec));
+    ivec[15] = 2;
+    zcrypto_aes_ctr32_encrypt_blocks(zero, ciphertext, 1, &key, ivec);
+    check_bytes(ciphertext, "0388dace60b6a392f328c2b971b2fe78");
+    memset(xi, 0, sizeof(xi));
+    zcrypto_ghash(xi, h, ciphertext, 16);
+    memset(lengths, 0, sizeof(lengths));
+    lengths[15] = 128;
+    zcrypto_ghash(xi, h, lengths, 16);
+    ivec[15] = 1;
+    zcrypto_aes_encrypt_block(ivec, tag_mask, &key);
+    for (index = 0; index < 16; ++index)
+        xi[index] ^= tag_mask[index];
+    check_bytes(xi, "ab6e47d42cec13bdf53a67b21257bddf");
+}
+
+static void test_chacha20_poly1305(void)
+{
+    /* These are the test vectors from RFC 8439, sections 2.4.2 and 2.5.2. */
+    const char* plaintext = "Ladies and Gentlemen of the class of '99: If I could offer you only "
+        "one tip for the future, sunscreen would be it.";
+    unsigned key[8];
+    unsigned counter[4] = { 1, 0, 0x4a000000, 0 };
+    unsigned char ciphertext[128];
+    unsigned index;
+    for (index = 0; index < 8; ++index)
+        key[index] = (4 * index) | ((4 * index + 1) << 8) | ((4 * index + 2) << 16)
+            | ((4 * index + 3) << 24);
+    zcrypto_chacha20_ctr32(ciphertext, plaintext, strlen(plaintext), key, counter);
+    check_bytes(ciphertext, "6e2e359a2568f98041ba0728dd0d6981");
+    check_bytes(ciphertext + 96, "5af90bbf74a35be6b40b8eedf2785e42874d");
+
+    const char* message = "Cryptographic Forum Research Group";
+    unsigned char one_time_key[32];
+    unsigned char last_block[16];
+    unsigned char mac[16];
+    zcrypto_poly1305 state;
+    size_t length = strlen(message);
+    unhex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b", one_time_key);
+    zcrypto_poly1305_init(&state, one_time_key);
+    zcrypto_poly1305_blocks(&state, message, length / 16 * 16, 1);
+    memset(last_block, 0, sizeof(last_block));
+    memcpy(last_block, message + length / 16 * 16, length % 16);
+    last_block[length % 16] = 1;
+    zcrypto_poly1305_blocks(&state, last_block, 16, 0);
+    zcrypto_poly1305_emit(&state, mac, one_time_key + 16);
+    check_bytes(mac, "a8061dc1305136c6c22b8baf0c0127a9");
+}
+
+int main()
+{
+    test_sha();
+    test_aes_gcm();
+    test_chacha20_poly1305();
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include <stdfil.h>
+#include <stdio.h>
+#include "utils.h"
+
+int main()
+{
+    char* ptr = zgc_alloc(64);
+    zgc_free_sized(ptr, 64);
+    ZASSERT(!zhasvalidcap(ptr));
+    ptr = zgc_alloc(100);
+    zgc_free_sized(ptr, 10);
+    ZASSERT(!zhasvalidcap(ptr));
+    zgc_free_sized(NULL, 1000);
+    ptr = zgc_alloc(1000000);
+    zgc_free_sized(opaque(ptr), 1000000);
+    ZASSERT(!zhasvalidcap(ptr));
+    printf("Success!\n");
+    return 0;
+}
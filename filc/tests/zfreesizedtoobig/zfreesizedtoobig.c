@@ -0,0 +1,7 @@
+#include <stdfil.h>
+
+int main()
+{
+    zgc_free_sized(zgc_alloc(64), 65);
+    return 0;
+}
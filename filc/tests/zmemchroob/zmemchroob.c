@@ -0,0 +1,14 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+int main()
+{
+    char* buf = opaque(malloc(100));
+    memset(buf, 'x', 100);
+    ZASSERT(zmemchr(buf, 'x', 101) == buf);
+    zmemchr(buf, 'y', 101);
+    zprintf("Should not get here.\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdfil.h>
+#include <stdbool.h>
+
+#define NTHREADS 10
+#define REPEAT 10000
+
+static int lock;
+static int cond;
+static bool is_available;
+static unsigned count;
+
+static void* thread_main(void* arg)
+{
+    unsigned i;
+    ZASSERT(!arg);
+    for (i = REPEAT; i--;) {
+        zmutex_lock(&lock);
+        while (!is_available)
+            zcondvar_wait(&cond, &lock);
+        is_available = false;
+        zmutex_unlock(&lock);
+        count++;
+        zmutex_lock(&lock);
+        is_available = true;
+        zcondvar_signal(&cond);
+        zmutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[NTHREADS];
+    unsigned i;
+
+    ZASSERT(zmutex_trylock(&lock));
+    ZASSERT(!zmutex_trylock(&lock));
+    zmutex_unlock(&lock);
+
+    is_available = true;
+    count = 0;
+
+    for (i = NTHREADS; i--;)
+        ZASSERT(!pthread_create(threads + i, NULL, thread_main, NULL));
+
+    for (i = NTHREADS; i--;)
+        ZASSERT(!pthread_join(threads[i], NULL));
+    
+    printf("count = %u\n", count);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define NUM_GROWS 300
+
+struct node {
+    struct node* next;
+    unsigned value;
+};
+
+int main()
+{
+    struct node** nodes = NULL;
+    size_t index;
+    size_t check_index;
+
+    /* Grow one ptr at a time, which mostly stays within the allocation's size class. */
+    for (index = 0; index < NUM_GROWS; ++index) {
+        nodes = realloc(nodes, sizeof(struct node*) * (index + 1));
+        nodes[index] = malloc(sizeof(struct node));
+        nodes[index]->next = index ? nodes[index - 1] : NULL;
+        nodes[index]->value = index;
+        if (!(index % 50))
+            zgc_request_and_wait();
+        for (check_index = 0; check_index <= index; ++check_index) {
+            ZASSERT(nodes[check_index]->value == check_index);
+            ZASSERT(nodes[check_index]->next == (check_index ? nodes[check_index - 1] : NULL));
+        }
+    }
+
+    /* Grow an object that has no aux yet, and then store ptrs into the part that we grew into. */
+    char* buf = malloc(16);
+    strcpy(buf, "hello");
+    char** ptrs = realloc(buf, 48);
+    ZASSERT(!strcmp((char*)ptrs, "hello"));
+    for (index = 16; index < 48; ++index)
+        ZASSERT(!((char*)ptrs)[index]);
+    ptrs[5] = strdup("world");
+    zgc_request_and_wait();
+    ZASSERT(!strcmp(ptrs[5], "world"));
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <pizlonated_syscalls.h>
+#include <stdfil.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+static void mywait(int pid)
+{
+    for (;;) {
+        int status;
+        int result = waitpid(pid, &status, 0);
+        if (result == pid) {
+            ZASSERT(WIFEXITED(status));
+            ZASSERT(!WEXITSTATUS(status));
+            break;
+        }
+        ZASSERT(result == -1);
+        ZASSERT(errno == EINTR);
+    }
+}
+
+int main()
+{
+    char* argv[] = { "/bin/sh", "-c", "echo $PWD", NULL };
+    int pipefds[2];
+    ZASSERT(!pipe(pipefds));
+
+    struct zsys_spawn_action actions[3];
+    memset(actions, 0, sizeof(actions));
+    actions[0].kind = ZSYS_SPAWN_CHDIR;
+    actions[0].path = "/";
+    actions[1].kind = ZSYS_SPAWN_DUP2;
+    actions[1].fd = pipefds[1];
+    actions[1].newfd = 1;
+    actions[2].kind = ZSYS_SPAWN_CLOSE;
+    actions[2].fd = pipefds[0];
+
+    int pid = 0;
+    ZASSERT(!zsys_posix_spawn(&pid, "/bin/sh", actions, 3, NULL, argv, environ));
+    ZASSERT(pid > 0);
+    mywait(pid);
+    close(pipefds[1]);
+
+    char buf[100];
+    memset(buf, 0, sizeof(buf));
+    size_t bytes_read = 0;
+    for (;;) {
+        ssize_t result = read(pipefds[0], buf + bytes_read, sizeof(buf) - 1 - bytes_read);
+        if (!result)
+            break;
+        if (result == -1) {
+            ZASSERT(errno == EINTR);
+            continue;
+        }
+        bytes_read += result;
+    }
+    ZASSERT(!strcmp(buf, "/\n"));
+
+    pid = 666;
+    char* argv2[] = { "/this/file/had/better/not/exist", NULL };
+    ZASSERT(zsys_posix_spawn(&pid, argv2[0], NULL, 0, NULL, argv2, environ) == ENOENT);
+    ZASSERT(pid == 666);
+
+    sigset_t sigmask;
+    sigset_t sigdefault;
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, SIGUSR1);
+    sigemptyset(&sigdefault);
+    sigaddset(&sigdefault, SIGPIPE);
+    struct zsys_spawn_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.flags = ZSYS_SPAWN_USEPATH | ZSYS_SPAWN_SETSIGMASK | ZSYS_SPAWN_SETSIGDEF;
+    attr.sigmask = &sigmask;
+    attr.sigdefault = &sigdefault;
+    char* argv3[] = { "sh", "-c", "exit 0", NULL };
+    ZASSERT(!zsys_posix_spawn(&pid, "sh", NULL, 0, &attr, argv3, environ));
+    mywait(pid);
+    attr.search_path = "/this/dir/had/better/not/exist::/bin";
+    ZASSERT(!zsys_posix_spawn(&pid, "sh", NULL, 0, &attr, argv3, environ));
+    mywait(pid);
+    pid = 666;
+    attr.search_path = "/this/dir/had/better/not/exist";
+    ZASSERT(zsys_posix_spawn(&pid, "sh", NULL, 0, &attr, argv3, environ) == ENOENT);
+    ZASSERT(pid == 666);
+    attr.search_path = NULL;
+
+    actions[0].kind = 666;
+    ZASSERT(zsys_posix_spawn(&pid, "/bin/sh", actions, 1, NULL, argv, environ) == EINVAL);
+    attr.flags = 666;
+    ZASSERT(zsys_posix_spawn(&pid, "/bin/sh", NULL, 0, &attr, argv, environ) == EINVAL);
+    ZASSERT(pid == 666);
+
+    printf("Success!\n");
+    return 0;
+}
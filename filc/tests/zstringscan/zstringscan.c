@@ -0,0 +1,37 @@
+#include <stdfil.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils.h"
+
+int main()
+{
+    char* buf = opaque(malloc(100));
+    memset(buf, 'x', 100);
+    buf[50] = 0;
+    buf[70] = 'y';
+
+    ZASSERT(zstrlen(buf) == 50);
+    ZASSERT(zstrlen(buf + 50) == 0);
+    ZASSERT(zstrnlen(buf, 10) == 10);
+    ZASSERT(zstrnlen(buf, 1000) == 50);
+    ZASSERT(zstrnlen(buf + 51, 49) == 49);
+    ZASSERT(!zstrnlen(buf + 100, 0));
+
+    ZASSERT(zmemchr(buf, 'y', 100) == buf + 70);
+    ZASSERT(zmemchr(buf, 'y', 1000) == buf + 70);
+    ZASSERT(zmemchr(buf, 0, 100) == buf + 50);
+    ZASSERT(!zmemchr(buf, 'y', 70));
+    ZASSERT(!zmemchr(buf, 'z', 100));
+    ZASSERT(!zmemchr(buf + 100, 'y', 0));
+    char* found = zmemchr(buf, 'y', 100);
+    ZASSERT(zgetlower(found) == buf);
+    ZASSERT(zgetupper(found) == buf + 100);
+
+    ZASSERT(zstrchr(buf, 'x') == buf);
+    ZASSERT(zstrchr(buf, 0) == buf + 50);
+    ZASSERT(!zstrchr(buf, 'y'));
+
+    printf("Success!\n");
+    return 0;
+}
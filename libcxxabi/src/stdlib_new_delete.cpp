@@ -10,6 +10,7 @@
 #include <__memory/aligned_alloc.h>
 #include <cstdlib>
 #include <new>
+#include <stdfil.h>
 
 // Perform a few sanity checks on libc++ and libc++abi macros to ensure that
 // the code below can be an exact copy of the code in libcxx/src/new.cpp.
@@ -25,6 +26,15 @@
 #  error libc++ and libc++abi seem to disagree on whether exceptions are enabled
 #endif
 
+// Sized deletes have to forward to the unsized ones, since those may have been replaced. But in
+// Fil-C we can still catch a size that's wrong before we do. This is on top of the copy from
+// libcxx/src/new.cpp.
+static void check_delete_size(void* ptr, size_t size) noexcept
+{
+    if (ptr && !zvalinbounds(ptr, size))
+        zerror("sized delete with a size that is bigger than the object");
+}
+
 // ------------------ BEGIN COPY ------------------
 // Implement all new and delete operators as weak definitions
 // in this shared library, so that they can be overridden by programs
@@ -115,8 +125,9 @@ operator delete(void* ptr, const std::nothrow_t&) noexcept
 
 _LIBCPP_WEAK
 void
-operator delete(void* ptr, size_t) noexcept
+operator delete(void* ptr, size_t size) noexcept
 {
+    check_delete_size(ptr, size);
     ::operator delete(ptr);
 }
 
@@ -136,8 +147,9 @@ operator delete[] (void* ptr, const std::nothrow_t&) noexcept
 
 _LIBCPP_WEAK
 void
-operator delete[] (void* ptr, size_t) noexcept
+operator delete[] (void* ptr, size_t size) noexcept
 {
+    check_delete_size(ptr, size);
     ::operator delete[](ptr);
 }
 
@@ -236,8 +248,9 @@ operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) no
 
 _LIBCPP_WEAK
 void
-operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept
+operator delete(void* ptr, size_t size, std::align_val_t alignment) noexcept
 {
+    check_delete_size(ptr, size);
     ::operator delete(ptr, alignment);
 }
 
@@ -257,8 +270,9 @@ operator delete[] (void* ptr, std::align_val_t alignment, const std::nothrow_t&)
 
 _LIBCPP_WEAK
 void
-operator delete[] (void* ptr, size_t, std::align_val_t alignment) noexcept
+operator delete[] (void* ptr, size_t size, std::align_val_t alignment) noexcept
 {
+    check_delete_size(ptr, size);
     ::operator delete[](ptr, alignment);
 }
 
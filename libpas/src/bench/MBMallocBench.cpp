@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+// A multithreaded driver for the allocation patterns that we care about. It loads an mbmalloc
+// library (one of the mbmalloc_*.c shims built as a shared library), runs one benchmark against it,
+// and prints "key: value" lines, including ops per second and peak RSS. run_mbmalloc_bench.rb runs
+// every benchmark against every allocator and makes a table.
+//
+// It can also replay an allocation trace that a Fil-C program recorded with FILC_ALLOC_TRACE (see
+// filc_alloc_trace.h), with one thread for each thread in the trace.
+//
+// Usage: MBMallocBench <mbmalloc library> <benchmark> [<threads> [<scale>]]
+//        MBMallocBench <mbmalloc library> replay <trace>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <memory>
+#include <mutex>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void* (*mbmalloc)(size_t);
+void* (*mbmemalign)(size_t, size_t);
+void (*mbfree)(void*, size_t);
+void (*mbscavenge)(void);
+
+struct Random {
+    explicit Random(uint64_t seed) : state(seed * 0x9e3779b97f4a7c15ull + 1) { }
+
+    uint64_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    size_t size(size_t min, size_t max) { return min + next() % (max - min + 1); }
+
+    uint64_t state;
+};
+
+void* allocate(size_t size)
+{
+    void* result = mbmalloc(size);
+    if (!result) {
+        fprintf(stderr, "Allocation of %zu bytes failed.\n", size);
+        exit(1);
+    }
+    // Touch it, so that the allocator can't get away with handing out memory that it never
+    // commits.
+    *static_cast<char*>(result) = static_cast<char>(size);
+    return result;
+}
+
+void* allocateWithAlignment(size_t size, size_t alignment)
+{
+    if (alignment <= 16 || !mbmemalign)
+        return allocate(size);
+    void* result = mbmemalign(alignment, size);
+    if (!result) {
+        fprintf(stderr, "Allocation of %zu bytes with %zu alignment failed.\n", size, alignment);
+        exit(1);
+    }
+    *static_cast<char*>(result) = static_cast<char>(size);
+    return result;
+}
+
+void deallocate(void* ptr, size_t size)
+{
+    if (*static_cast<char*>(ptr) != static_cast<char>(size)) {
+        fprintf(stderr, "Object %p of size %zu got corrupted.\n", ptr, size);
+        exit(1);
+    }
+    mbfree(ptr, size);
+}
+
+size_t currentRSS()
+{
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file)
+        return 0;
+    size_t totalPages;
+    size_t residentPages;
+    if (fscanf(file, "%zu %zu", &totalPages, &residentPages) != 2)
+        residentPages = 0;
+    fclose(file);
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t peakRSS()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+class Barrier {
+public:
+    explicit Barrier(unsigned numThreads) : m_numThreads(numThreads) { }
+
+    void wait()
+    {
+        unique_lock<mutex> locker(m_lock);
+        uint64_t generation = m_generation;
+        if (++m_numWaiting == m_numThreads) {
+            m_numWaiting = 0;
+            m_generation++;
+            m_condition.notify_all();
+            return;
+        }
+        m_condition.wait(locker, [&] { return m_generation != generation; });
+    }
+
+private:
+    mutex m_lock;
+    condition_variable m_condition;
+    unsigned m_numThreads;
+    unsigned m_numWaiting { 0 };
+    uint64_t m_generation { 0 };
+};
+
+template<typename Func>
+void runThreads(unsigned numThreads, const Func& func)
+{
+    vector<thread> threads;
+    for (unsigned index = 0; index < numThreads; ++index)
+        threads.emplace_back([&func, index] { func(index); });
+    for (thread& thread : threads)
+        thread.join();
+}
+
+struct Object {
+    void* ptr;
+    size_t size;
+};
+
+// Each producer allocates and hands its objects to a consumer thread over a ring, which frees
+// them. So every free is remote.
+uint64_t producerConsumer(unsigned numThreads, unsigned scale)
+{
+    static constexpr size_t ringSize = 4096;
+    struct Ring {
+        Object slots[ringSize];
+        atomic<size_t> head { 0 };
+        atomic<size_t> tail { 0 };
+    };
+
+    unsigned numPairs = numThreads / 2 ? numThreads / 2 : 1;
+    size_t numObjectsPerPair = static_cast<size_t>(scale) * 1000000;
+    vector<Ring> rings(numPairs);
+
+    runThreads(numPairs * 2, [&] (unsigned index) {
+        Ring& ring = rings[index / 2];
+        if (!(index & 1)) {
+            Random random(index);
+            for (size_t count = 0; count < numObjectsPerPair; ++count) {
+                size_t tail = ring.tail.load(memory_order_relaxed);
+                while (tail - ring.head.load(memory_order_acquire) == ringSize)
+                    this_thread::yield();
+                size_t size = random.size(16, 256);
+                ring.slots[tail % ringSize] = Object { allocate(size), size };
+                ring.tail.store(tail + 1, memory_order_release);
+            }
+            return;
+        }
+        for (size_t count = 0; count < numObjectsPerPair; ++count) {
+            size_t head = ring.head.load(memory_order_relaxed);
+            while (ring.tail.load(memory_order_acquire) == head)
+                this_thread::yield();
+            Object object = ring.slots[head % ringSize];
+            ring.head.store(head + 1, memory_order_release);
+            deallocate(object.ptr, object.size);
+        }
+    });
+
+    return numPairs * numObjectsPerPair * 2;
+}
+
+// Larson and Krishnan's server benchmark. Each thread replaces random objects in its own array
+// with new ones of random sizes. After every round, the arrays move on to the next thread, so the
+// objects that a thread frees were mostly allocated by some other thread.
+uint64_t larson(unsigned numThreads, unsigned scale)
+{
+    static constexpr size_t numSlots = 1000;
+    static constexpr size_t numReplacementsPerRound = 10000;
+    unsigned numRounds = 50 * scale;
+
+    vector<vector<Object>> arrays(numThreads);
+    for (unsigned index = 0; index < numThreads; ++index) {
+        Random random(index);
+        for (size_t slot = 0; slot < numSlots; ++slot) {
+            size_t size = random.size(16, 512);
+            arrays[index].push_back(Object { allocate(size), size });
+        }
+    }
+
+    Barrier barrier(numThreads);
+    runThreads(numThreads, [&] (unsigned index) {
+        Random random(index + numThreads);
+        for (unsigned round = 0; round < numRounds; ++round) {
+            vector<Object>& array = arrays[(index + round) % numThreads];
+            for (size_t count = 0; count < numReplacementsPerRound; ++count) {
+                Object& object = array[random.next() % numSlots];
+                deallocate(object.ptr, object.size);
+                object.size = random.size(16, 512);
+                object.ptr = allocate(object.size);
+            }
+            barrier.wait();
+        }
+    });
+
+    for (vector<Object>& array : arrays) {
+        for (Object& object : array)
+            deallocate(object.ptr, object.size);
+    }
+
+    return static_cast<uint64_t>(numThreads) * numRounds * numReplacementsPerRound * 2;
+}
+
+// Like Lever and Boreham's xmalloc-test: half of the threads allocate batches of objects and
+// put them on a shared stack, and the other half take them off and free them.
+uint64_t xmallocTest(unsigned numThreads, unsigned scale)
+{
+    static constexpr size_t batchSize = 100;
+    static constexpr size_t maxBatches = 1000;
+
+    unsigned numAllocators = numThreads / 2 ? numThreads / 2 : 1;
+    unsigned numFreers = numAllocators;
+    size_t numBatchesPerAllocator = static_cast<size_t>(scale) * 10000;
+
+    mutex lock;
+    condition_variable condition;
+    vector<vector<Object>> batches;
+    unsigned numAllocatorsDone = 0;
+
+    runThreads(numAllocators + numFreers, [&] (unsigned index) {
+        if (index < numAllocators) {
+            Random random(index);
+            for (size_t count = 0; count < numBatchesPerAllocator; ++count) {
+                vector<Object> batch;
+                batch.reserve(batchSize);
+                for (size_t objectIndex = 0; objectIndex < batchSize; ++objectIndex) {
+                    size_t size = random.size(8, 128);
+                    batch.push_back(Object { allocate(size), size });
+                }
+                unique_lock<mutex> locker(lock);
+                condition.wait(locker, [&] { return batches.size() < maxBatches; });
+                batches.push_back(move(batch));
+                condition.notify_all();
+            }
+            lock_guard<mutex> locker(lock);
+            numAllocatorsDone++;
+            condition.notify_all();
+            return;
+        }
+        for (;;) {
+            vector<Object> batch;
+            {
+                unique_lock<mutex> locker(lock);
+                condition.wait(locker, [&] {
+                    return !batches.empty() || numAllocatorsDone == numAllocators;
+                });
+                if (batches.empty())
+                    return;
+                batch = move(batches.back());
+                batches.pop_back();
+                condition.notify_all();
+            }
+            for (Object& object : batch)
+                deallocate(object.ptr, object.size);
+        }
+    });
+
+    return static_cast<uint64_t>(numAllocators) * numBatchesPerAllocator * batchSize * 2;
+}
+
+// Hoard's cache-scratch. The main thread allocates one small object for each thread, so they
+// are probably next to each other. Each thread frees its object and then keeps allocating objects
+// of the same size and writing to them. An allocator that hands the freed object's cache line
+// back to the thread that freed it gets false sharing between the threads.
+uint64_t cacheScratch(unsigned numThreads, unsigned scale)
+{
+    static constexpr size_t objectSize = 8;
+    static constexpr unsigned numRepetitions = 1000;
+    unsigned numIterations = 10000 * scale;
+
+    vector<void*> initialObjects;
+    for (unsigned index = 0; index < numThreads; ++index)
+        initialObjects.push_back(allocate(objectSize));
+
+    runThreads(numThreads, [&] (unsigned index) {
+        deallocate(initialObjects[index], objectSize);
+        for (unsigned iteration = 0; iteration < numIterations; ++iteration) {
+            volatile char* object = static_cast<volatile char*>(allocate(objectSize));
+            for (unsigned repetition = 0; repetition < numRepetitions; ++repetition) {
+                for (size_t offset = 1; offset < objectSize; ++offset)
+                    object[offset] = static_cast<char>(object[offset] + 1);
+            }
+            deallocate(const_cast<char*>(object), objectSize);
+        }
+    });
+
+    return static_cast<uint64_t>(numThreads) * numIterations * 2;
+}
+
+// A long-running test of how well the allocator reuses memory as the size distribution drifts.
+// Each phase allocates a lot of objects from a size range that's bigger than the last one's, and
+// then frees most of them, keeping a random tenth alive. What matters here is the RSS compared to
+// the bytes that are actually live.
+atomic<size_t> liveBytes;
+
+uint64_t fragmentation(unsigned numThreads, unsigned scale)
+{
+    static constexpr unsigned numPhases = 20;
+    size_t numObjectsPerPhase = static_cast<size_t>(scale) * 20000;
+
+    atomic<uint64_t> numOps { 0 };
+    vector<vector<Object>> survivors(numThreads);
+
+    runThreads(numThreads, [&] (unsigned index) {
+        Random random(index);
+        vector<Object> phaseObjects;
+        size_t myLiveBytes = 0;
+        uint64_t myNumOps = 0;
+        for (unsigned phase = 0; phase < numPhases; ++phase) {
+            size_t minSize = 16 << (phase / 4);
+            size_t maxSize = minSize * 8;
+            for (size_t count = 0; count < numObjectsPerPhase; ++count) {
+                size_t size = random.size(minSize, maxSize);
+                phaseObjects.push_back(Object { allocate(size), size });
+            }
+            myNumOps += numObjectsPerPhase;
+            for (Object& object : phaseObjects) {
+                if (!(random.next() % 10)) {
+                    survivors[index].push_back(object);
+                    myLiveBytes += object.size;
+                    continue;
+                }
+                deallocate(object.ptr, object.size);
+                myNumOps++;
+            }
+            phaseObjects.clear();
+        }
+        liveBytes += myLiveBytes;
+        numOps += myNumOps;
+    });
+
+    printf("live bytes: %zu\n", liveBytes.load());
+    mbscavenge();
+    printf("rss after scavenge with survivors: %zu\n", currentRSS());
+
+    for (vector<Object>& array : survivors) {
+        for (Object& object : array)
+            deallocate(object.ptr, object.size);
+    }
+    return numOps;
+}
+
+// This has to match filc_alloc_trace_record.
+struct TraceRecord {
+    uint64_t timestamp;
+    uint64_t address;
+    uint64_t size;
+    uint32_t thread;
+    uint8_t kind;
+    uint8_t logAlign;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord has to match filc_alloc_trace_record");
+
+constexpr uint8_t traceAllocate = 1;
+
+struct ReplayOp {
+    bool isAllocate;
+    size_t id;
+};
+
+// Replays the trace with one thread for each of its threads, plus one for the GC's die records if
+// there are any. A free waits until the allocation it frees has been replayed, which can't
+// deadlock, since everything that anyone waits for happened earlier in the trace. A sampler thread
+// records the RSS and the live bytes every 10 ms, so we can tell how the RSS tracks the live bytes
+// over time and how fragmented the heap gets.
+uint64_t replay(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s.\n", path);
+        exit(1);
+    }
+    vector<TraceRecord> records;
+    TraceRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+        records.push_back(record);
+    fclose(file);
+
+    // Give every allocation an id, and turn each free into the id of the allocation it frees.
+    // Frees of objects that we never saw get dropped.
+    vector<size_t> sizes;
+    vector<size_t> alignments;
+    unordered_map<uint64_t, size_t> liveIds;
+    unordered_map<uint32_t, unsigned> threadIndices;
+    vector<vector<ReplayOp>> opsForThread;
+    for (const TraceRecord& record : records) {
+        auto iter = threadIndices.find(record.thread);
+        if (iter == threadIndices.end()) {
+            iter = threadIndices.emplace(record.thread, opsForThread.size()).first;
+            opsForThread.emplace_back();
+        }
+        vector<ReplayOp>& ops = opsForThread[iter->second];
+        if (record.kind == traceAllocate) {
+            size_t id = sizes.size();
+            sizes.push_back(record.size ? record.size : 1);
+            alignments.push_back(static_cast<size_t>(1) << record.logAlign);
+            liveIds[record.address] = id;
+            ops.push_back(ReplayOp { true, id });
+            continue;
+        }
+        auto liveIter = liveIds.find(record.address);
+        if (liveIter == liveIds.end())
+            continue;
+        ops.push_back(ReplayOp { false, liveIter->second });
+        liveIds.erase(liveIter);
+    }
+
+    unique_ptr<atomic<void*>[]> slots(new atomic<void*>[sizes.size()]);
+    for (size_t id = 0; id < sizes.size(); ++id)
+        slots[id].store(nullptr, memory_order_relaxed);
+
+    atomic<size_t> currentLiveBytes { 0 };
+    atomic<bool> isDone { false };
+    struct Sample {
+        double milliseconds;
+        size_t rss;
+        size_t liveBytes;
+    };
+    vector<Sample> samples;
+    auto start = chrono::steady_clock::now();
+    thread sampler([&] {
+        while (!isDone.load()) {
+            samples.push_back(Sample {
+                chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(),
+                currentRSS(), currentLiveBytes.load() });
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    });
+
+    uint64_t numOps = 0;
+    for (vector<ReplayOp>& ops : opsForThread)
+        numOps += ops.size();
+    runThreads(opsForThread.size(), [&] (unsigned index) {
+        for (const ReplayOp& op : opsForThread[index]) {
+            if (op.isAllocate) {
+                slots[op.id].store(
+                    allocateWithAlignment(sizes[op.id], alignments[op.id]),
+                    memory_order_release);
+                currentLiveBytes += sizes[op.id];
+                continue;
+            }
+            void* ptr;
+            while (!(ptr = slots[op.id].exchange(nullptr, memory_order_acquire)))
+                this_thread::yield();
+            deallocate(ptr, sizes[op.id]);
+            currentLiveBytes -= sizes[op.id];
+        }
+    });
+
+    isDone.store(true);
+    sampler.join();
+    samples.push_back(Sample {
+        chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(),
+        currentRSS(), currentLiveBytes.load() });
+
+    size_t peakLiveBytes = 0;
+    Sample peakRSSSample { 0, 0, 0 };
+    printf("rss over time:");
+    for (const Sample& sample : samples) {
+        printf(" %.0fms=%zu/%zu", sample.milliseconds, sample.rss, sample.liveBytes);
+        peakLiveBytes = max(peakLiveBytes, sample.liveBytes);
+        if (sample.rss > peakRSSSample.rss)
+            peakRSSSample = sample;
+    }
+    printf("\n");
+    printf("trace threads: %zu\n", opsForThread.size());
+    printf("peak live bytes: %zu\n", peakLiveBytes);
+    if (peakRSSSample.liveBytes) {
+        printf("rss over live bytes at peak rss: %.2f\n",
+               static_cast<double>(peakRSSSample.rss) / peakRSSSample.liveBytes);
+    }
+
+    // The trace's survivors are still live at this point, and that's what the RSS after scavenge
+    // will measure.
+    return numOps;
+}
+
+struct Benchmark {
+    const char* name;
+    uint64_t (*function)(unsigned numThreads, unsigned scale);
+};
+
+const Benchmark benchmarks[] = {
+    { "producer-consumer", producerConsumer },
+    { "larson", larson },
+    { "xmalloc-test", xmallocTest },
+    { "cache-scratch", cacheScratch },
+    { "fragmentation", fragmentation },
+};
+
+template<typename T>
+T loadSymbol(void* library, const char* name)
+{
+    void* result = dlsym(library, name);
+    if (!result) {
+        fprintf(stderr, "Could not find %s: %s\n", name, dlerror());
+        exit(1);
+    }
+    return reinterpret_cast<T>(result);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || argc > 5) {
+        fprintf(stderr,
+                "Usage: MBMallocBench <mbmalloc library> <benchmark> [<threads> [<scale>]]\n");
+        fprintf(stderr, "       MBMallocBench <mbmalloc library> replay <trace>\n");
+        fprintf(stderr, "Benchmarks:");
+        for (const Benchmark& benchmark : benchmarks)
+            fprintf(stderr, " %s", benchmark.name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    void* library = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        fprintf(stderr, "Could not load %s: %s\n", argv[1], dlerror());
+        return 1;
+    }
+    mbmalloc = loadSymbol<void* (*)(size_t)>(library, "mbmalloc");
+    mbfree = loadSymbol<void (*)(void*, size_t)>(library, "mbfree");
+    mbscavenge = loadSymbol<void (*)(void)>(library, "mbscavenge");
+    // Not every shim has this. Without it, the replay ignores alignment.
+    mbmemalign = reinterpret_cast<void* (*)(size_t, size_t)>(dlsym(library, "mbmemalign"));
+
+    if (!strcmp(argv[2], "replay")) {
+        if (argc != 4) {
+            fprintf(stderr, "Usage: MBMallocBench <mbmalloc library> replay <trace>\n");
+            return 1;
+        }
+        auto before = chrono::steady_clock::now();
+        uint64_t numOps = replay(argv[3]);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - before).count();
+        size_t peak = peakRSS();
+        mbscavenge();
+
+        printf("benchmark: replay\n");
+        printf("trace: %s\n", argv[3]);
+        printf("allocator: %s\n", argv[1]);
+        printf("ops: %llu\n", static_cast<unsigned long long>(numOps));
+        printf("seconds: %.3f\n", seconds);
+        printf("ops per second: %.0f\n", numOps / seconds);
+        printf("peak rss: %zu\n", peak);
+        printf("rss after scavenge: %zu\n", currentRSS());
+        return 0;
+    }
+
+    unsigned numThreads = thread::hardware_concurrency();
+    if (argc >= 4)
+        numThreads = static_cast<unsigned>(atoi(argv[3]));
+    unsigned scale = argc >= 5 ? static_cast<unsigned>(atoi(argv[4])) : 1;
+    if (!numThreads)
+        numThreads = 1;
+    if (!scale)
+        scale = 1;
+
+    for (const Benchmark& benchmark : benchmarks) {
+        if (strcmp(benchmark.name, argv[2]))
+            continue;
+
+        auto before = chrono::steady_clock::now();
+        uint64_t numOps = benchmark.function(numThreads, scale);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - before).count();
+        size_t peak = peakRSS();
+        mbscavenge();
+
+        printf("benchmark: %s\n", benchmark.name);
+        printf("allocator: %s\n", argv[1]);
+        printf("threads: %u\n", numThreads);
+        printf("ops: %llu\n", static_cast<unsigned long long>(numOps));
+        printf("seconds: %.3f\n", seconds);
+        printf("ops per second: %.0f\n", numOps / seconds);
+        printf("peak rss: %zu\n", peak);
+        printf("rss after scavenge: %zu\n", currentRSS());
+        return 0;
+    }
+
+    fprintf(stderr, "Unknown benchmark: %s\n", argv[2]);
+    return 1;
+}
@@ -0,0 +1,224 @@
+#!/usr/bin/env ruby
+#
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+# Builds MBMallocBench and an mbmalloc library for each libpas heap, and then runs every benchmark
+# against each of them, plus the system malloc and (if we can find them) jemalloc and mimalloc.
+# Reports the median ops/sec and peak RSS of each pairing.
+#
+# Usage: run_mbmalloc_bench.rb [--threads N] [--scale N] [--runs N] [--benchmark NAME]
+#                              [--allocator NAME] [--jemalloc PATH] [--mimalloc PATH]
+#                              [--trace PATH]
+#
+# --trace replays a FILC_ALLOC_TRACE trace against each allocator instead of running the benchmarks.
+#
+# jemalloc and mimalloc are loaded with LD_PRELOAD underneath the system malloc shim.
+
+require 'etc'
+require 'fileutils'
+require 'getoptlong'
+
+SRC = File.expand_path(File.join(File.dirname(__FILE__), ".."))
+BUILD = File.join(SRC, "..", "build", "mbmalloc_bench")
+
+CC = ENV["CC"] || "clang"
+CXX = ENV["CXX"] || "clang++"
+CFLAGS = "-O3 -g -fPIC -pthread -DNDEBUG -I#{SRC}/libpas -I#{SRC}/verifier"
+
+BENCHMARKS = [ "producer-consumer", "larson", "xmalloc-test", "cache-scratch", "fragmentation" ]
+LIBPAS_VARIANTS = {
+    "bmalloc" => "mbmalloc_bmalloc.c",
+    "hotbit" => "mbmalloc_hotbit.c",
+    "iso" => "mbmalloc_iso_common_primitive.c",
+    "lineref" => "mbmalloc_lineref.c"
+}
+
+def mysys(*cmd)
+    unless system(*cmd)
+        raise "Command failed: #{cmd.join(' ')}"
+    end
+end
+
+def median(values)
+    sorted = values.sort
+    if sorted.size.odd?
+        sorted[sorted.size / 2]
+    else
+        (sorted[sorted.size / 2 - 1] + sorted[sorted.size / 2]) / 2.0
+    end
+end
+
+def findLibrary(name)
+    [ "/usr/lib/x86_64-linux-gnu", "/usr/lib64", "/usr/lib", "/usr/local/lib" ].each {
+        | directory |
+        path = File.join(directory, "lib#{name}.so")
+        return path if File.exist? path
+        Dir.glob(path + ".*").each {
+            | candidate |
+            return candidate
+        }
+    }
+    nil
+end
+
+def compile(compiler, source, object)
+    return if File.exist?(object) and File.mtime(object) >= File.mtime(source)
+    mysys("#{compiler} #{CFLAGS} -c -o #{object} #{source}")
+end
+
+# The Fil-C runtime parts of libpas need the generated forwarders and only make sense inside Fil-C,
+# so they're left out.
+def buildLibpasObjects
+    FileUtils.mkdir_p(File.join(BUILD, "libpas"))
+    sources = Dir.glob(File.join(SRC, "libpas", "*.c")).reject {
+        | path |
+        File.basename(path) =~ /^(filc_|fugc)/
+    }
+    objects = []
+    sources.each {
+        | source |
+        object = File.join(BUILD, "libpas", File.basename(source, ".c") + ".o")
+        compile(CC, source, object)
+        objects << object
+    }
+    verifierObject = File.join(BUILD, "libpas", "Verifier.o")
+    compile(CXX, File.join(SRC, "verifier", "Verifier.cpp"), verifierObject)
+    objects << verifierObject
+    objects
+end
+
+def wanted?(name)
+    not $allocatorFilter or $allocatorFilter == name
+end
+
+def buildAllocators
+    result = {}
+    libpasObjects = nil
+    LIBPAS_VARIANTS.each_pair {
+        | name, shim |
+        next unless wanted? name
+        libpasObjects ||= buildLibpasObjects
+        object = File.join(BUILD, "mbmalloc_#{name}.o")
+        compile(CC, File.join(SRC, "mbmalloc", shim), object)
+        library = File.join(BUILD, "libmbmalloc_#{name}.so")
+        mysys("#{CXX} -shared -pthread -o #{library} #{object} #{libpasObjects.join(' ')}")
+        result[name] = { :library => library, :env => {} }
+    }
+    object = File.join(BUILD, "mbmalloc_system.o")
+    compile(CC, File.join(SRC, "mbmalloc", "mbmalloc_system.c"), object)
+    systemLibrary = File.join(BUILD, "libmbmalloc_system.so")
+    mysys("#{CC} -shared -o #{systemLibrary} #{object}")
+    result["system"] = { :library => systemLibrary, :env => {} } if wanted? "system"
+    { "jemalloc" => $jemalloc, "mimalloc" => $mimalloc }.each_pair {
+        | name, path |
+        next unless wanted? name
+        if path
+            result[name] = { :library => systemLibrary, :env => { "LD_PRELOAD" => path } }
+        else
+            $stderr.puts "Could not find #{name}, so not running against it."
+        end
+    }
+    result
+end
+
+def runOnce(driver, allocator, benchmark)
+    if benchmark == "replay"
+        arguments = [ $trace ]
+    else
+        arguments = [ $threads.to_s, $scale.to_s ]
+    end
+    output = IO.popen(allocator[:env], [ driver, allocator[:library], benchmark ] + arguments,
+                      &:read)
+    raise "#{benchmark} failed" unless $?.success?
+    result = {}
+    output.each_line {
+        | line |
+        if line =~ /^([a-z ]+): ([0-9.]+)$/
+            result[$1] = $2.to_f
+        end
+    }
+    result
+end
+
+$threads = Etc.nprocessors
+$scale = 1
+$runs = 3
+$benchmarks = BENCHMARKS
+$allocatorFilter = nil
+$jemalloc = findLibrary("jemalloc")
+$mimalloc = findLibrary("mimalloc")
+$trace = nil
+
+GetoptLong.new([ "--threads", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--scale", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--runs", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--benchmark", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--allocator", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--jemalloc", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--mimalloc", GetoptLong::REQUIRED_ARGUMENT ],
+               [ "--trace", GetoptLong::REQUIRED_ARGUMENT ]).each {
+    | opt, arg |
+    case opt
+    when "--threads"
+        $threads = arg.to_i
+    when "--scale"
+        $scale = arg.to_i
+    when "--runs"
+        $runs = arg.to_i
+    when "--benchmark"
+        $benchmarks = [ arg ]
+    when "--allocator"
+        $allocatorFilter = arg
+    when "--jemalloc"
+        $jemalloc = arg
+    when "--mimalloc"
+        $mimalloc = arg
+    when "--trace"
+        $trace = File.expand_path(arg)
+        $benchmarks = [ "replay" ]
+    end
+}
+
+FileUtils.mkdir_p(BUILD)
+driver = File.join(BUILD, "MBMallocBench")
+mysys("#{CXX} -std=c++17 -O3 -g -pthread -o #{driver} " +
+      "#{File.join(SRC, 'bench', 'MBMallocBench.cpp')} -ldl")
+allocators = buildAllocators
+
+puts "threads: #{$threads}, scale: #{$scale}, runs: #{$runs}"
+$benchmarks.each {
+    | benchmark |
+    puts
+    puts benchmark
+    puts "    %-10s %15s %15s %20s" % [
+        "allocator", "ops/sec", "peak RSS (MB)", "RSS after scav. (MB)" ]
+    allocators.each_pair {
+        | name, allocator |
+        results = (1..$runs).map { runOnce(driver, allocator, benchmark) }
+        opsPerSecond = median(results.map { | result | result["ops per second"] })
+        peakRSS = median(results.map { | result | result["peak rss"] }) / 1024.0 / 1024.0
+        finalRSS = median(results.map { | result | result["rss after scavenge"] }) / 1024.0 / 1024.0
+        puts "    %-10s %15.0f %15.1f %20.1f" % [ name, opsPerSecond, peakRSS, finalRSS ]
+    }
+}
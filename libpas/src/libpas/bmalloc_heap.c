@@ -34,6 +34,7 @@
 
 #include "bmalloc_heap_inlines.h"
 #include "pas_deallocate.h"
+#include "pas_debug_heap.h"
 #include "pas_ensure_heap_forced_into_reserved_memory.h"
 #include "pas_get_allocation_size.h"
 #include "pas_get_heap.h"
@@ -163,6 +164,56 @@ void* bmalloc_allocate_zeroed(size_t size)
     return bmalloc_allocate_zeroed_inline(size);
 }
 
+size_t bmalloc_try_allocate_batch(size_t size, size_t count, void** results)
+{
+    pas_thread_local_cache* cache;
+    size_t index;
+
+    cache = pas_thread_local_cache_try_get();
+    for (index = 0; index < count; ++index) {
+        pas_allocation_result result;
+        void* ptr;
+
+        if (PAS_LIKELY(cache)) {
+            result = bmalloc_try_allocate_impl_inline_only_with_cache(size, 1, cache);
+            if (PAS_LIKELY(result.did_succeed)) {
+                results[index] = (void*)result.begin;
+                continue;
+            }
+        }
+
+        /* The slow path may create or resize the cache, so we have to look it up again. */
+        ptr = bmalloc_try_allocate_casual(size);
+        if (!ptr)
+            return index;
+        results[index] = ptr;
+        cache = pas_thread_local_cache_try_get();
+    }
+    return count;
+}
+
+void bmalloc_allocate_batch(size_t size, size_t count, void** results)
+{
+    pas_thread_local_cache* cache;
+    size_t index;
+
+    cache = pas_thread_local_cache_try_get();
+    for (index = 0; index < count; ++index) {
+        pas_allocation_result result;
+
+        if (PAS_LIKELY(cache)) {
+            result = bmalloc_allocate_impl_inline_only_with_cache(size, 1, cache);
+            if (PAS_LIKELY(result.did_succeed)) {
+                results[index] = (void*)result.begin;
+                continue;
+            }
+        }
+
+        results[index] = bmalloc_allocate_casual(size);
+        cache = pas_thread_local_cache_try_get();
+    }
+}
+
 void* bmalloc_try_reallocate(void* old_ptr, size_t new_size,
                              pas_reallocate_free_mode free_mode)
 {
@@ -436,6 +487,41 @@ void bmalloc_deallocate(void* ptr)
     bmalloc_deallocate_inline(ptr);
 }
 
+static size_t max_non_large_object_size(void)
+{
+    return pas_max_uintptr(
+        pas_max_uintptr(
+            pas_max_uintptr(BMALLOC_HEAP_CONFIG.small_segregated_config.base.max_object_size,
+                            BMALLOC_HEAP_CONFIG.medium_segregated_config.base.max_object_size),
+            pas_max_uintptr(BMALLOC_HEAP_CONFIG.small_bitfit_config.base.max_object_size,
+                            BMALLOC_HEAP_CONFIG.medium_bitfit_config.base.max_object_size)),
+        BMALLOC_HEAP_CONFIG.marge_bitfit_config.base.max_object_size);
+}
+
+void bmalloc_deallocate_with_size(void* ptr, size_t size)
+{
+    if (PAS_UNLIKELY(size > max_non_large_object_size())
+        && ptr
+        && !pas_debug_heap_is_enabled(BMALLOC_HEAP_CONFIG.kind)) {
+        PAS_TESTING_ASSERT(bmalloc_get_allocation_size(ptr) >= size);
+        pas_deallocate_known_large(ptr, &bmalloc_heap_config);
+        return;
+    }
+    PAS_TESTING_ASSERT(!ptr || bmalloc_get_allocation_size(ptr) >= size);
+    bmalloc_deallocate_inline(ptr);
+}
+
+void bmalloc_deallocate_batch(void** ptrs, size_t count)
+{
+    size_t index;
+
+    /* Frees of small objects just go into the thread local cache's deallocation log, which then
+       takes each page's lock once for a run of frees to that page. So the win here is that the
+       whole loop gets to use the inlined fast path. */
+    for (index = 0; index < count; ++index)
+        bmalloc_deallocate_inline(ptrs[index]);
+}
+
 pas_heap* bmalloc_force_auxiliary_heap_into_reserved_memory(pas_primitive_heap_ref* heap_ref,
                                                             uintptr_t begin,
                                                             uintptr_t end)
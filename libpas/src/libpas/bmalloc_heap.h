@@ -45,6 +45,21 @@ PAS_API void* bmalloc_allocate_zeroed(size_t size);
 
 PAS_API void* bmalloc_allocate_with_alignment(size_t size, size_t alignment);
 
+/* Allocates count objects of the given size into results, looking up the thread local cache and
+   the size class only once for the whole batch. The try variant returns how many it managed to
+   allocate before the first failure, and those are always at the front of results. */
+PAS_API size_t bmalloc_try_allocate_batch(size_t size, size_t count, void** results);
+PAS_API void bmalloc_allocate_batch(size_t size, size_t count, void** results);
+
+/* Frees an object whose requested size the caller knows, like C++ sized delete does. The size has
+   to be no bigger than what was asked for when the object was allocated. Objects that are too big
+   for any segregated or bitfit page go straight to the large heap, which skips the page lookups
+   that the unsized path has to do to find that out. */
+PAS_API void bmalloc_deallocate_with_size(void* ptr, size_t size);
+
+/* Frees count objects. NULL entries are ignored. */
+PAS_API void bmalloc_deallocate_batch(void** ptrs, size_t count);
+
 PAS_API void* bmalloc_try_reallocate(void* old_ptr, size_t new_size,
                                      pas_reallocate_free_mode free_mode);
 
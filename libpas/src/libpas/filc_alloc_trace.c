@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_alloc_trace.h"
+
+#include "bmalloc_heap.h"
+#include "verse_heap.h"
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+#define BUFFER_SIZE ((size_t)65536 / sizeof(filc_alloc_trace_record))
+
+bool filc_alloc_trace_is_enabled;
+
+static const char* trace_path;
+static int trace_fd = -1;
+static uint64_t start_time;
+
+/* Protects everything below. Mutators take this while entered, but never hold it across a
+   pollcheck, so FUGC may take it at any time. */
+static pas_lock trace_lock = PAS_LOCK_INITIALIZER;
+static filc_alloc_trace_record buffer[BUFFER_SIZE];
+static size_t buffer_size;
+static bool did_fail_to_write;
+/* Every traced object that hasn't been freed or found dead yet. */
+static filc_object** live_objects;
+static size_t num_live_objects;
+static size_t live_objects_capacity;
+
+static uint64_t current_time(void)
+{
+    struct timespec now;
+    PAS_ASSERT(!clock_gettime(CLOCK_MONOTONIC, &now));
+    return (uint64_t)now.tv_sec * 1000000000llu + (uint64_t)now.tv_nsec;
+}
+
+static void flush_buffer(void)
+{
+    char* data = (char*)buffer;
+    size_t size = buffer_size * sizeof(filc_alloc_trace_record);
+    buffer_size = 0;
+    while (size && !did_fail_to_write) {
+        ssize_t result = write(trace_fd, data, size);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0) {
+            pas_log("filc alloc trace: failed to write to %s: %s\n", trace_path, strerror(errno));
+            did_fail_to_write = true;
+            return;
+        }
+        data += result;
+        size -= (size_t)result;
+    }
+}
+
+static void append_record(uint8_t kind, filc_object* object, size_t size, filc_log_align log_align,
+                          unsigned thread)
+{
+    if (buffer_size == BUFFER_SIZE)
+        flush_buffer();
+    filc_alloc_trace_record* record = buffer + buffer_size++;
+    /* Taking the time under the lock keeps the timestamps in file order. */
+    record->timestamp = current_time() - start_time;
+    record->address = (uint64_t)(uintptr_t)object;
+    record->size = size;
+    record->thread = thread;
+    record->kind = kind;
+    record->log_align = log_align;
+    record->reserved = 0;
+}
+
+static void append_live_object(filc_object* object)
+{
+    if (num_live_objects == live_objects_capacity) {
+        size_t new_capacity = pas_max_uintptr(live_objects_capacity * 2, 1024);
+        filc_object** new_live_objects =
+            bmalloc_allocate(filc_mul_size(new_capacity, sizeof(filc_object*)));
+        memcpy(new_live_objects, live_objects, num_live_objects * sizeof(filc_object*));
+        bmalloc_deallocate(live_objects);
+        live_objects = new_live_objects;
+        live_objects_capacity = new_capacity;
+    }
+    live_objects[num_live_objects++] = object;
+}
+
+static void flush_at_exit(void)
+{
+    pas_lock_lock(&trace_lock);
+    flush_buffer();
+    pas_lock_unlock(&trace_lock);
+}
+
+void filc_alloc_trace_initialize(void)
+{
+    trace_path = getenv("FILC_ALLOC_TRACE");
+    if (!trace_path || !*trace_path) {
+        trace_path = NULL;
+        return;
+    }
+
+    trace_fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd < 0) {
+        pas_log("filc alloc trace: failed to open %s: %s\n", trace_path, strerror(errno));
+        trace_path = NULL;
+        return;
+    }
+    start_time = current_time();
+    atexit(flush_at_exit);
+    filc_alloc_trace_is_enabled = true;
+}
+
+void filc_alloc_trace_record_allocation(filc_thread* my_thread, filc_object* object, size_t size)
+{
+    PAS_ASSERT(filc_alloc_trace_is_enabled);
+    pas_lock_lock(&trace_lock);
+    append_record(FILC_ALLOC_TRACE_ALLOCATE, object, size, filc_object_log_align(object),
+                  my_thread->tid);
+    append_live_object(object);
+    pas_lock_unlock(&trace_lock);
+}
+
+void filc_alloc_trace_record_free(filc_object* object)
+{
+    PAS_ASSERT(filc_alloc_trace_is_enabled);
+    filc_thread* my_thread = filc_get_my_thread();
+    pas_lock_lock(&trace_lock);
+    append_record(FILC_ALLOC_TRACE_FREE, object, 0, 0, my_thread ? my_thread->tid : 0);
+    pas_lock_unlock(&trace_lock);
+}
+
+void filc_alloc_trace_record_dead(void)
+{
+    if (!filc_alloc_trace_is_enabled)
+        return;
+
+    pas_lock_lock(&trace_lock);
+    /* None of these objects have been swept yet, so it's safe to look at their headers. Freed
+       objects already have their free record, so we just forget them. Objects allocated from here
+       until the sweep starts are allocated black. */
+    size_t src_index;
+    size_t dst_index = 0;
+    for (src_index = 0; src_index < num_live_objects; ++src_index) {
+        filc_object* object = live_objects[src_index];
+        if (filc_object_get_flags(object) & FILC_OBJECT_FLAG_FREE)
+            continue;
+        if (!verse_heap_is_marked(filc_object_mark_base(object))) {
+            append_record(FILC_ALLOC_TRACE_DIE, object, 0, 0, 0);
+            continue;
+        }
+        live_objects[dst_index++] = object;
+    }
+    num_live_objects = dst_index;
+    /* This way the trace is never more than a cycle behind. */
+    flush_buffer();
+    pas_lock_unlock(&trace_lock);
+}
+
+void filc_alloc_trace_dump_setup(void)
+{
+    if (!filc_alloc_trace_is_enabled) {
+        pas_log("    alloc trace: off\n");
+        return;
+    }
+    pas_log("    alloc trace: writing to %s\n", trace_path);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef FILC_ALLOC_TRACE_H
+#define FILC_ALLOC_TRACE_H
+
+#include "filc_runtime.h"
+
+/* This records every heap allocation and free, so that the program's allocation pattern can be
+   replayed against other allocators without running the program (see the replay mode of
+   libpas/src/bench/MBMallocBench.cpp). It's enabled by setting FILC_ALLOC_TRACE to the path of the
+   file that the trace should go to.
+   
+   The trace is just an array of filc_alloc_trace_records in native byte order. Objects are
+   identified by their address, and an address only gets reused after the record that ends the
+   previous object's life, so a free matches the most recent allocation at its address. There are
+   two ways for an object to die: zgc_free() (or free()) writes a free record right away, and the
+   GC writes a die record for every traced object that it finds unmarked after marking. The die
+   records come before the sweep that reuses their memory.
+   
+   Recording takes a global lock on every allocation and free, so it's only good for benchmarking
+   the allocation pattern, not for timing the program. */
+
+#define FILC_ALLOC_TRACE_ALLOCATE ((uint8_t)1)
+#define FILC_ALLOC_TRACE_FREE     ((uint8_t)2)
+#define FILC_ALLOC_TRACE_DIE      ((uint8_t)3)
+
+struct filc_alloc_trace_record {
+    uint64_t timestamp; /* Nanoseconds since the trace started. */
+    uint64_t address;
+    uint64_t size; /* For allocations, the bytes the heap handed out, including the header. */
+    uint32_t thread; /* The tid of the thread that did it, or zero for the GC. */
+    uint8_t kind;
+    uint8_t log_align; /* For allocations. */
+    uint16_t reserved;
+};
+
+typedef struct filc_alloc_trace_record filc_alloc_trace_record;
+
+PAS_API extern bool filc_alloc_trace_is_enabled;
+
+PAS_API void filc_alloc_trace_initialize(void);
+
+PAS_API void filc_alloc_trace_record_allocation(
+    filc_thread* my_thread, filc_object* object, size_t size);
+PAS_API void filc_alloc_trace_record_free(filc_object* object);
+
+/* Called by FUGC after marking, before sweeping. */
+PAS_API void filc_alloc_trace_record_dead(void);
+
+PAS_API void filc_alloc_trace_dump_setup(void);
+
+static PAS_ALWAYS_INLINE void filc_alloc_trace_note_allocation(
+    filc_thread* my_thread, filc_object* object, size_t size)
+{
+    if (PAS_UNLIKELY(filc_alloc_trace_is_enabled))
+        filc_alloc_trace_record_allocation(my_thread, object, size);
+}
+
+static PAS_ALWAYS_INLINE void filc_alloc_trace_note_free(filc_object* object)
+{
+    if (PAS_UNLIKELY(filc_alloc_trace_is_enabled))
+        filc_alloc_trace_record_free(object);
+}
+
+#endif /* FILC_ALLOC_TRACE_H */
+
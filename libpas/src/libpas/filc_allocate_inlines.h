@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_ALLOCATE_INLINES_H
+#define FILC_ALLOCATE_INLINES_H
+
+#include "filc_alloc_trace.h"
+#include "filc_heap_profiler.h"
+#include "filc_runtime.h"
+#include "pas_fd_stream.h"
+
+/* The fast paths of filc_allocate(), filc_allocate_with_aux(), and filc_allocate_uninitialized().
+   They're in a header so that the runtime inlines bitcode (see filc_runtime_inlines.c) can hand
+   them to the pizlonator, which links them into every module as available_externally definitions
+   that the inliner may use. So, everything in here may only use state that's visible outside
+   filc_runtime.c. */
+
+PAS_API PAS_NO_RETURN void filc_allocation_size_too_big(size_t size);
+
+/* Zeroes a big object with the thread exited, so that it doesn't hold up soft handshakes. */
+PAS_API filc_object* filc_finish_allocate_large(
+    filc_thread* my_thread, filc_object* result, size_t size);
+
+static PAS_ALWAYS_INLINE void filc_prepare_allocate_object(size_t* size)
+{
+    if (PAS_UNLIKELY(*size > FILC_MAX_ALLOCATION_SIZE))
+        filc_allocation_size_too_big(*size);
+    size_t original_size = *size;
+    *size = pas_round_up_to_power_of_2(*size, FILC_MINALIGN);
+    PAS_TESTING_ASSERT(*size >= original_size);
+}
+
+static PAS_ALWAYS_INLINE void filc_prepare_allocate(
+    size_t* size, size_t alignment, size_t* offset_to_payload, size_t* total_size)
+{
+    PAS_ASSERT(sizeof(filc_object) == FILC_MINALIGN);
+    filc_prepare_allocate_object(size);
+    *offset_to_payload = pas_max_uintptr(alignment, sizeof(filc_object));
+    *total_size = *size + *offset_to_payload;
+    PAS_TESTING_ASSERT(*total_size > *size);
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_initialize_object_header(
+    void* allocation, size_t size, size_t alignment, size_t offset_to_payload,
+    filc_object_flags object_flags, char* aux_ptr)
+{
+    static const bool verbose = false;
+    if (verbose) {
+        pas_log("initializing new object with allocation at %p, payload at %p, size %zu, end at %p\n",
+                allocation, (char*)allocation + offset_to_payload, size,
+                (char*)allocation + offset_to_payload + size);
+    }
+    PAS_TESTING_ASSERT(pas_is_aligned(size, FILC_WORD_SIZE));
+    PAS_TESTING_ASSERT(!filc_object_flags_is_special(object_flags));
+    PAS_TESTING_ASSERT(!filc_object_flags_is_aligned(object_flags));
+    if (alignment > sizeof(filc_object)) {
+        PAS_TESTING_ASSERT(offset_to_payload > sizeof(filc_object));
+        PAS_TESTING_ASSERT(offset_to_payload == alignment);
+        filc_alignment_header_construct((filc_alignment_header*)allocation, alignment);
+    }
+    filc_object* result = filc_object_for_lower_not_null((char*)allocation + offset_to_payload);
+    result->upper = filc_object_encode_upper((char*)(result + 1) + size, object_flags);
+    if (alignment > FILC_MINALIGN) {
+        object_flags = filc_object_flags_create(
+            object_flags, FILC_SPECIAL_TYPE_NONE, pas_log2(alignment));
+        PAS_TESTING_ASSERT(filc_object_flags_alignment(object_flags) == alignment);
+    }
+    result->aux = filc_aux_create(object_flags, aux_ptr);
+    return result;
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_finish_allocate_small(filc_object* result, size_t size)
+{
+    filc_memset_small_word(filc_object_lower(result), 0, size);
+    pas_store_store_fence();
+    return result;
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_finish_allocate(
+    filc_thread* my_thread, void* allocation, size_t size, size_t alignment,
+    size_t offset_to_payload, filc_object_flags object_flags)
+{
+    filc_object* result = filc_initialize_object_header(
+        allocation, size, alignment, offset_to_payload, object_flags, NULL);
+    if (PAS_UNLIKELY(size > FILC_MAX_BYTES_BETWEEN_POLLCHECKS))
+        return filc_finish_allocate_large(my_thread, result, size);
+    return filc_finish_allocate_small(result, size);
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_allocate_impl(
+    filc_thread* my_thread, size_t size, filc_object_flags object_flags)
+{
+    static const bool verbose = false;
+    
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
+    PAS_TESTING_ASSERT(!(object_flags & FILC_OBJECT_FLAG_MMAP));
+
+    if (verbose) {
+        pas_log("Allocating %zu bytes\n", size);
+        filc_thread_dump_stack(my_thread, &pas_log_stream.base);
+    }
+
+    size_t offset_to_payload;
+    size_t total_size;
+    filc_prepare_allocate(&size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
+    filc_object* result = filc_finish_allocate(
+        my_thread, filc_thread_allocate(my_thread, total_size),
+        size, FILC_WORD_SIZE, offset_to_payload, object_flags);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size);
+    return result;
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_allocate_inline(filc_thread* my_thread, size_t size)
+{
+    return filc_allocate_impl(my_thread, size, 0);
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_allocate_uninitialized_inline(
+    filc_thread* my_thread, size_t size)
+{
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
+
+    size_t requested_size = size;
+    size_t offset_to_payload;
+    size_t total_size;
+    filc_prepare_allocate(&size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
+    filc_object* result = filc_initialize_object_header(
+        filc_thread_allocate(my_thread, total_size), size, FILC_WORD_SIZE, offset_to_payload, 0,
+        NULL);
+    /* The caller only overwrites the bytes it asked for, but the rest of the last word is readable
+       too. */
+    if (size != requested_size)
+        filc_memset_small_word(
+            (char*)filc_object_upper(result) - FILC_WORD_SIZE, 0, FILC_WORD_SIZE);
+    pas_store_store_fence();
+    filc_heap_profiler_note_allocation(my_thread, result, total_size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size);
+    return result;
+}
+
+static PAS_ALWAYS_INLINE filc_object* filc_allocate_with_aux_inline(
+    filc_thread* my_thread, size_t size)
+{
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
+
+    size_t offset_to_payload;
+    size_t total_size;
+    filc_prepare_allocate(&size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
+    if (!size)
+        return filc_allocate_impl(my_thread, size, 0);
+    void* allocation = filc_thread_allocate(my_thread, total_size + size);
+    filc_object* result = filc_initialize_object_header(
+        allocation, size, FILC_WORD_SIZE, offset_to_payload, FILC_OBJECT_FLAG_INLINE_AUX,
+        (char*)allocation + total_size);
+    /* The aux starts right at the upper, so this zeroes both the payload and the aux. */
+    if (PAS_UNLIKELY(size * 2 > FILC_MAX_BYTES_BETWEEN_POLLCHECKS))
+        filc_finish_allocate_large(my_thread, result, size * 2);
+    else
+        filc_finish_allocate_small(result, size * 2);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size + size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size + size);
+    return result;
+}
+
+#endif /* FILC_ALLOCATE_INLINES_H */
+
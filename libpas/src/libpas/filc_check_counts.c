@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_check_counts.h"
+
+#include "bmalloc_heap.h"
+#include "pas_fd_stream.h"
+#include <stdlib.h>
+
+#if PAS_ENABLE_FILC
+
+/* Tables get registered from global constructors, so this has to work before filc_initialize(). */
+static pas_lock tables_lock = PAS_LOCK_INITIALIZER;
+static filc_check_counter_table* tables;
+static bool should_dump;
+
+void filc_register_check_counters(filc_check_counter_table* table)
+{
+    pas_lock_lock(&tables_lock);
+    table->next = tables;
+    tables = table;
+    pas_lock_unlock(&tables_lock);
+}
+
+static int compare_counters_by_count(const void* a_ptr, const void* b_ptr)
+{
+    const filc_check_counter* a = *(const filc_check_counter**)a_ptr;
+    const filc_check_counter* b = *(const filc_check_counter**)b_ptr;
+    if (a->count > b->count)
+        return -1;
+    if (a->count < b->count)
+        return 1;
+    return 0;
+}
+
+static const char* kind_string(unsigned kind)
+{
+    switch (kind) {
+    case filc_check_count_access:
+        return "access check";
+    case filc_check_count_pollcheck:
+        return "pollcheck";
+    case filc_check_count_store_barrier:
+        return "store barrier";
+    default:
+        return "<bad kind>";
+    }
+}
+
+/* Runs from atexit, so other threads may still be bumping the counts. That just makes them a bit
+   stale. */
+static void dump_check_counts(void)
+{
+    pas_lock_lock(&tables_lock);
+    size_t num_counters = 0;
+    filc_check_counter_table* table;
+    for (table = tables; table; table = table->next)
+        num_counters += table->num_counters;
+    filc_check_counter** sorted_counters = bmalloc_allocate(
+        filc_mul_size(pas_max_uintptr(num_counters, 1), sizeof(filc_check_counter*)));
+    size_t num_hit_counters = 0;
+    uint64_t totals[3] = { 0, 0, 0 };
+    for (table = tables; table; table = table->next) {
+        size_t index;
+        for (index = 0; index < table->num_counters; ++index) {
+            filc_check_counter* counter = table->counters[index];
+            if (!counter->count)
+                continue;
+            sorted_counters[num_hit_counters++] = counter;
+            if (counter->kind < 3)
+                totals[counter->kind] += counter->count;
+        }
+    }
+    pas_lock_unlock(&tables_lock);
+    qsort(sorted_counters, num_hit_counters, sizeof(filc_check_counter*),
+          compare_counters_by_count);
+
+    pas_stream* stream = &pas_log_stream.base;
+    pas_stream_printf(
+        stream, "filc check counts: %" PRIu64 " access checks, %" PRIu64 " pollchecks, %" PRIu64
+        " store barriers at %zu of %zu sites\n",
+        totals[filc_check_count_access], totals[filc_check_count_pollcheck],
+        totals[filc_check_count_store_barrier], num_hit_counters, num_counters);
+    size_t index;
+    for (index = 0; index < num_hit_counters; ++index) {
+        filc_check_counter* counter = sorted_counters[index];
+        pas_stream_printf(
+            stream, "    %" PRIu64 " %s: ", counter->count, kind_string(counter->kind));
+        if (counter->origin)
+            filc_origin_dump_all_inline(counter->origin, "; ", stream);
+        else
+            pas_stream_printf(stream, "<null origin>");
+        pas_stream_printf(stream, "\n");
+    }
+    bmalloc_deallocate(sorted_counters);
+}
+
+void filc_check_counts_initialize(void)
+{
+    should_dump = filc_get_bool_env("FILC_DUMP_CHECK_COUNTS", false);
+    if (should_dump)
+        atexit(dump_check_counts);
+}
+
+void filc_check_counts_dump_setup(void)
+{
+    pas_log("    dump check counts: %s\n", should_dump ? "yes" : "no");
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
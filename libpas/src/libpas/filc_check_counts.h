@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_CHECK_COUNTS_H
+#define FILC_CHECK_COUNTS_H
+
+#include "filc_runtime.h"
+
+/* Code compiled with -mllvm -filc-count-checks gives every access check, pollcheck, and store
+   barrier that it emits a counter, which it bumps each time the check runs. Each module registers a
+   table of its counters from a global constructor, which may run before filc_initialize(). With
+   FILC_DUMP_CHECK_COUNTS=1, we log the counts at exit, hottest first, along with the origin of the
+   check.
+
+   The pizlonator expects these layouts, so they have to match the types that it makes for them. */
+
+enum filc_check_count_kind {
+    filc_check_count_access,
+    filc_check_count_pollcheck,
+    filc_check_count_store_barrier
+};
+
+typedef enum filc_check_count_kind filc_check_count_kind;
+
+struct filc_check_counter;
+struct filc_check_counter_table;
+typedef struct filc_check_counter filc_check_counter;
+typedef struct filc_check_counter_table filc_check_counter_table;
+
+struct filc_check_counter {
+    uint64_t count;
+    const filc_origin* origin;
+    unsigned kind; /* filc_check_count_kind */
+};
+
+struct filc_check_counter_table {
+    filc_check_counter_table* next;
+    size_t num_counters;
+    filc_check_counter** counters;
+};
+
+PAS_API void filc_register_check_counters(filc_check_counter_table* table);
+
+PAS_API void filc_check_counts_initialize(void);
+
+PAS_API void filc_check_counts_dump_setup(void);
+
+#endif /* FILC_CHECK_COUNTS_H */
+
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_checksum.h"
+
+#if PAS_ENABLE_FILC
+
+#if PAS_X86_64
+#include <cpuid.h>
+#include <immintrin.h>
+#endif /* PAS_X86_64 */
+
+#define CRC32_POLY 0xedb88320u
+#define CRC64_POLY 0xc96c5795d7870f42ull
+
+/* The largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits, i.e. how many bytes Adler-32
+   can take before it has to reduce. This is zlib's NMAX. */
+#define ADLER32_BASE 65521u
+#define ADLER32_NMAX 5552u
+
+static uint32_t crc32_table[8][256];
+static uint64_t crc64_table[8][256];
+static bool has_pclmul;
+static bool has_ssse3;
+static pas_system_once initialize_once = PAS_SYSTEM_ONCE_INIT;
+
+static void initialize(void)
+{
+    unsigned index;
+    unsigned slice;
+
+    for (index = 0; index < 256; ++index) {
+        uint32_t crc32 = index;
+        uint64_t crc64 = index;
+        unsigned bit;
+        for (bit = 0; bit < 8; ++bit) {
+            crc32 = (crc32 >> 1) ^ ((crc32 & 1) ? CRC32_POLY : 0);
+            crc64 = (crc64 >> 1) ^ ((crc64 & 1) ? CRC64_POLY : 0);
+        }
+        crc32_table[0][index] = crc32;
+        crc64_table[0][index] = crc64;
+    }
+    for (slice = 1; slice < 8; ++slice) {
+        for (index = 0; index < 256; ++index) {
+            uint32_t crc32 = crc32_table[slice - 1][index];
+            uint64_t crc64 = crc64_table[slice - 1][index];
+            crc32_table[slice][index] = (crc32 >> 8) ^ crc32_table[0][crc32 & 0xff];
+            crc64_table[slice][index] = (crc64 >> 8) ^ crc64_table[0][crc64 & 0xff];
+        }
+    }
+
+#if PAS_X86_64
+    unsigned eax;
+    unsigned ebx;
+    unsigned ecx;
+    unsigned edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        has_ssse3 = !!(ecx & bit_SSSE3);
+        has_pclmul = has_ssse3 && (ecx & bit_SSE4_1) && (ecx & bit_PCLMUL);
+    }
+#endif /* PAS_X86_64 */
+}
+
+static inline uint32_t load_le32(const uint8_t* ptr)
+{
+    uint32_t result;
+    memcpy(&result, ptr, sizeof(result));
+    return result;
+}
+
+static inline uint64_t load_le64(const uint8_t* ptr)
+{
+    uint64_t result;
+    memcpy(&result, ptr, sizeof(result));
+    return result;
+}
+
+/* These work on the raw CRC register, without the inversions. */
+static uint32_t crc32_slice_by_8(uint32_t crc, const uint8_t* data, size_t size)
+{
+    for (; size && ((uintptr_t)data & 7); --size)
+        crc = (crc >> 8) ^ crc32_table[0][(crc ^ *data++) & 0xff];
+    for (; size >= 8; size -= 8, data += 8) {
+        uint32_t low = crc ^ load_le32(data);
+        uint32_t high = load_le32(data + 4);
+        crc = crc32_table[7][low & 0xff] ^ crc32_table[6][(low >> 8) & 0xff]
+            ^ crc32_table[5][(low >> 16) & 0xff] ^ crc32_table[4][low >> 24]
+            ^ crc32_table[3][high & 0xff] ^ crc32_table[2][(high >> 8) & 0xff]
+            ^ crc32_table[1][(high >> 16) & 0xff] ^ crc32_table[0][high >> 24];
+    }
+    for (; size; --size)
+        crc = (crc >> 8) ^ crc32_table[0][(crc ^ *data++) & 0xff];
+    return crc;
+}
+
+static uint64_t crc64_slice_by_8(uint64_t crc, const uint8_t* data, size_t size)
+{
+    for (; size && ((uintptr_t)data & 7); --size)
+        crc = (crc >> 8) ^ crc64_table[0][(crc ^ *data++) & 0xff];
+    for (; size >= 8; size -= 8, data += 8) {
+        crc ^= load_le64(data);
+        crc = crc64_table[7][crc & 0xff] ^ crc64_table[6][(crc >> 8) & 0xff]
+            ^ crc64_table[5][(crc >> 16) & 0xff] ^ crc64_table[4][(crc >> 24) & 0xff]
+            ^ crc64_table[3][(crc >> 32) & 0xff] ^ crc64_table[2][(crc >> 40) & 0xff]
+            ^ crc64_table[1][(crc >> 48) & 0xff] ^ crc64_table[0][crc >> 56];
+    }
+    for (; size; --size)
+        crc = (crc >> 8) ^ crc64_table[0][(crc ^ *data++) & 0xff];
+    return crc;
+}
+
+#if PAS_X86_64
+#define CRC32_PCLMUL_MIN_SIZE 64
+
+/* This is the folding algorithm from Intel's "Fast CRC Computation for Generic Polynomials Using
+   PCLMULQDQ Instruction", with the constants for zlib's bit-reflected polynomial. It folds four
+   lanes of 128 bits at a time, then folds those down to one lane, and finishes with a Barrett
+   reduction. It takes at least 64 bytes, in multiples of 16. */
+__attribute__((target("sse4.1,pclmul"))) static uint32_t crc32_pclmul(
+    uint32_t crc, const uint8_t* data, size_t size)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596ll, 0x0154442bd4ll);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009ell, 0x01751997d0ll);
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124ll);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641ll, 0x01db710641ll);
+    const __m128i low_32_of_64 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0;
+    __m128i x1;
+    __m128i x2;
+    __m128i x3;
+    __m128i x4;
+
+    PAS_TESTING_ASSERT(size >= CRC32_PCLMUL_MIN_SIZE);
+    PAS_TESTING_ASSERT(!(size % 16));
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)data), _mm_cvtsi32_si128((int)crc));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 16));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 32));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 48));
+    data += 64;
+    size -= 64;
+
+    for (; size >= 64; size -= 64, data += 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)data));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 48)));
+    }
+
+    x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x0);
+    x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x0);
+    x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x0);
+
+    for (; size >= 16; size -= 16, data += 16) {
+        x0 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11),
+                                         _mm_loadu_si128((const __m128i*)data)),
+                           x0);
+    }
+
+    /* Fold 128 bits down to 64. */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, low_32_of_64);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5, 0x00), x2);
+
+    /* Barrett reduce to 32 bits. */
+    x2 = _mm_and_si128(x1, low_32_of_64);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, low_32_of_64);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+/* This is the Adler-32 kernel from Chromium's zlib: each 32 byte block adds the byte sums to s1
+   with psadbw, and the byte sums weighted by their distance from the end of the block to s2 with
+   pmaddubsw. Blocks go in runs of up to NMAX bytes so that the sums can't overflow before we
+   reduce them. */
+__attribute__((target("ssse3"))) static uint32_t adler32_ssse3(uint32_t adler, const uint8_t* data,
+                                                              size_t size, size_t* remaining)
+{
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18,
+                                       17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    size_t num_blocks = size / 32;
+
+    *remaining = size % 32;
+    while (num_blocks) {
+        size_t run = pas_min_uintptr(num_blocks, ADLER32_NMAX / 32);
+        __m128i previous_s1 = _mm_set_epi32(0, 0, 0, (int)(s1 * run));
+        __m128i vector_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        __m128i vector_s1 = _mm_setzero_si128();
+
+        num_blocks -= run;
+        do {
+            __m128i bytes1 = _mm_loadu_si128((const __m128i*)data);
+            __m128i bytes2 = _mm_loadu_si128((const __m128i*)(data + 16));
+            previous_s1 = _mm_add_epi32(previous_s1, vector_s1);
+            vector_s1 = _mm_add_epi32(vector_s1, _mm_sad_epu8(bytes1, zero));
+            vector_s2 = _mm_add_epi32(
+                vector_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            vector_s1 = _mm_add_epi32(vector_s1, _mm_sad_epu8(bytes2, zero));
+            vector_s2 = _mm_add_epi32(
+                vector_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            data += 32;
+        } while (--run);
+
+        vector_s2 = _mm_add_epi32(vector_s2, _mm_slli_epi32(previous_s1, 5));
+
+        vector_s1 = _mm_add_epi32(vector_s1, _mm_shuffle_epi32(vector_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+        vector_s1 = _mm_add_epi32(vector_s1, _mm_shuffle_epi32(vector_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (uint32_t)_mm_cvtsi128_si32(vector_s1);
+        vector_s2 = _mm_add_epi32(vector_s2, _mm_shuffle_epi32(vector_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        vector_s2 = _mm_add_epi32(vector_s2, _mm_shuffle_epi32(vector_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (uint32_t)_mm_cvtsi128_si32(vector_s2);
+
+        s1 %= ADLER32_BASE;
+        s2 %= ADLER32_BASE;
+    }
+    return s1 | (s2 << 16);
+}
+#endif /* PAS_X86_64 */
+
+uint32_t filc_checksum_crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    pas_system_once_run(&initialize_once, initialize);
+    crc = ~crc;
+#if PAS_X86_64
+    if (has_pclmul && size >= CRC32_PCLMUL_MIN_SIZE) {
+        size_t folded_size = pas_round_down_to_power_of_2(size, 16);
+        crc = crc32_pclmul(crc, data, folded_size);
+        data += folded_size;
+        size -= folded_size;
+    }
+#endif /* PAS_X86_64 */
+    return ~crc32_slice_by_8(crc, data, size);
+}
+
+uint32_t filc_checksum_adler32(uint32_t adler, const uint8_t* data, size_t size)
+{
+    uint32_t s1;
+    uint32_t s2;
+
+    pas_system_once_run(&initialize_once, initialize);
+#if PAS_X86_64
+    if (has_ssse3 && size >= 32) {
+        size_t remaining;
+        adler = adler32_ssse3(adler, data, size, &remaining);
+        data += size - remaining;
+        size = remaining;
+    }
+#endif /* PAS_X86_64 */
+
+    s1 = adler & 0xffff;
+    s2 = adler >> 16;
+    while (size) {
+        size_t run = pas_min_uintptr(size, ADLER32_NMAX);
+        size -= run;
+        while (run--) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= ADLER32_BASE;
+        s2 %= ADLER32_BASE;
+    }
+    return s1 | (s2 << 16);
+}
+
+uint64_t filc_checksum_crc64(uint64_t crc, const uint8_t* data, size_t size)
+{
+    pas_system_once_run(&initialize_once, initialize);
+    return ~crc64_slice_by_8(~crc, data, size);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
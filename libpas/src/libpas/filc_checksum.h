@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_CHECKSUM_H
+#define FILC_CHECKSUM_H
+
+#include "pas_utils.h"
+
+PAS_BEGIN_EXTERN_C;
+
+/* These are the checksum kernels behind zcrc32, zadler32, and zcrc64 in stdfil.h. They take the
+   same arguments and give the same answers as zlib's crc32() and adler32() and xz's lzma_crc64(),
+   including the pre and post inversion of the CRCs, so a running checksum can be passed from one
+   call to the next.
+
+   CRC-32 uses carry-less multiply folding when the CPU has PCLMULQDQ, and Adler-32 uses SSSE3.
+   CRC-64 and the fallbacks use slicing-by-8 tables. Note that SSE4.2's crc32 instruction doesn't
+   help here, since it computes CRC-32C, which is a different polynomial from the one that zlib and
+   xz use.
+
+   The natives check the buffer before calling in here. */
+
+PAS_API uint32_t filc_checksum_crc32(uint32_t crc, const uint8_t* data, size_t size);
+PAS_API uint32_t filc_checksum_adler32(uint32_t adler, const uint8_t* data, size_t size);
+PAS_API uint64_t filc_checksum_crc64(uint64_t crc, const uint8_t* data, size_t size);
+
+PAS_END_EXTERN_C;
+
+#endif /* FILC_CHECKSUM_H */
@@ -0,0 +1,691 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_crypto.h"
+
+#if PAS_ENABLE_FILC
+
+#if PAS_X86_64
+#include <cpuid.h>
+#include <immintrin.h>
+#define TARGET_CRYPTO __attribute__((target("sse4.1,ssse3,aes,pclmul,sha")))
+#endif /* PAS_X86_64 */
+
+static inline uint32_t load_le32(const uint8_t* ptr)
+{
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16)
+        | ((uint32_t)ptr[3] << 24);
+}
+
+static inline void store_le32(uint8_t* ptr, uint32_t value)
+{
+    ptr[0] = (uint8_t)value;
+    ptr[1] = (uint8_t)(value >> 8);
+    ptr[2] = (uint8_t)(value >> 16);
+    ptr[3] = (uint8_t)(value >> 24);
+}
+
+static inline uint64_t load_le64(const uint8_t* ptr)
+{
+    return (uint64_t)load_le32(ptr) | ((uint64_t)load_le32(ptr + 4) << 32);
+}
+
+static inline void store_le64(uint8_t* ptr, uint64_t value)
+{
+    store_le32(ptr, (uint32_t)value);
+    store_le32(ptr + 4, (uint32_t)(value >> 32));
+}
+
+static inline uint32_t load_be32(const uint8_t* ptr)
+{
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8)
+        | (uint32_t)ptr[3];
+}
+
+static inline uint64_t load_be64(const uint8_t* ptr)
+{
+    return ((uint64_t)load_be32(ptr) << 32) | (uint64_t)load_be32(ptr + 4);
+}
+
+static inline uint32_t rotr32(uint32_t value, unsigned amount)
+{
+    return (value >> amount) | (value << (32 - amount));
+}
+
+static inline uint32_t rotl32(uint32_t value, unsigned amount)
+{
+    return (value << amount) | (value >> (32 - amount));
+}
+
+static inline uint64_t rotr64(uint64_t value, unsigned amount)
+{
+    return (value >> amount) | (value << (64 - amount));
+}
+
+static unsigned features;
+static pas_system_once features_once = PAS_SYSTEM_ONCE_INIT;
+
+static void initialize_features(void)
+{
+#if PAS_X86_64
+    unsigned eax;
+    unsigned ebx;
+    unsigned ecx;
+    unsigned edx;
+    bool has_sse;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return;
+    has_sse = (ecx & bit_SSSE3) && (ecx & bit_SSE4_1);
+    if (has_sse && (ecx & bit_AES))
+        features |= FILC_CRYPTO_AES;
+    if (has_sse && (ecx & bit_PCLMUL))
+        features |= FILC_CRYPTO_PCLMUL;
+    if (has_sse && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA))
+        features |= FILC_CRYPTO_SHA;
+#endif /* PAS_X86_64 */
+}
+
+unsigned filc_crypto_features(void)
+{
+    pas_system_once_run(&features_once, initialize_features);
+    return features;
+}
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void sha256_blocks_portable(uint32_t* state, const uint8_t* data, size_t num_blocks)
+{
+    for (; num_blocks--; data += 64) {
+        uint32_t w[64];
+        uint32_t v[8];
+        unsigned index;
+
+        for (index = 0; index < 16; ++index)
+            w[index] = load_be32(data + index * 4);
+        for (index = 16; index < 64; ++index) {
+            uint32_t s0 = rotr32(w[index - 15], 7) ^ rotr32(w[index - 15], 18)
+                ^ (w[index - 15] >> 3);
+            uint32_t s1 = rotr32(w[index - 2], 17) ^ rotr32(w[index - 2], 19)
+                ^ (w[index - 2] >> 10);
+            w[index] = w[index - 16] + s0 + w[index - 7] + s1;
+        }
+
+        for (index = 0; index < 8; ++index)
+            v[index] = state[index];
+        for (index = 0; index < 64; ++index) {
+            uint32_t s1 = rotr32(v[4], 6) ^ rotr32(v[4], 11) ^ rotr32(v[4], 25);
+            uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+            uint32_t t1 = v[7] + s1 + ch + sha256_k[index] + w[index];
+            uint32_t s0 = rotr32(v[0], 2) ^ rotr32(v[0], 13) ^ rotr32(v[0], 22);
+            uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+            v[7] = v[6];
+            v[6] = v[5];
+            v[5] = v[4];
+            v[4] = v[3] + t1;
+            v[3] = v[2];
+            v[2] = v[1];
+            v[1] = v[0];
+            v[0] = t1 + s0 + maj;
+        }
+        for (index = 0; index < 8; ++index)
+            state[index] += v[index];
+    }
+}
+
+#if PAS_X86_64
+/* SHA-NI wants the state as ABEF and CDGH rather than ABCD and EFGH, and does two rounds per
+   sha256rnds2. The message schedule is done four words at a time, as a ring of four vectors. */
+TARGET_CRYPTO static void sha256_blocks_sha_ni(uint32_t* state, const uint8_t* data,
+                                               size_t num_blocks)
+{
+    __m128i byte_swap_mask = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+    __m128i abcd = _mm_loadu_si128((const __m128i*)state);
+    __m128i efgh = _mm_loadu_si128((const __m128i*)(state + 4));
+    __m128i cdab = _mm_shuffle_epi32(abcd, 0xb1);
+    __m128i abef;
+    __m128i cdgh;
+
+    efgh = _mm_shuffle_epi32(efgh, 0x1b);
+    abef = _mm_alignr_epi8(cdab, efgh, 8);
+    cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for (; num_blocks--; data += 64) {
+        __m128i saved_abef = abef;
+        __m128i saved_cdgh = cdgh;
+        __m128i w[4];
+        unsigned group;
+
+        for (group = 0; group < 16; ++group) {
+            __m128i words;
+            if (group < 4) {
+                w[group] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i*)(data + group * 16)), byte_swap_mask);
+            } else {
+                __m128i newest = w[(group - 1) & 3];
+                w[group & 3] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(_mm_sha256msg1_epu32(w[group & 3], w[(group - 3) & 3]),
+                                  _mm_alignr_epi8(newest, w[(group - 2) & 3], 4)),
+                    newest);
+            }
+            words = _mm_add_epi32(w[group & 3],
+                                  _mm_loadu_si128((const __m128i*)(sha256_k + group * 4)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0e));
+        }
+
+        abef = _mm_add_epi32(abef, saved_abef);
+        cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+    }
+
+    abef = _mm_shuffle_epi32(abef, 0x1b);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(abef, cdgh, 0xf0));
+    _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(cdgh, abef, 8));
+}
+#endif /* PAS_X86_64 */
+
+void filc_crypto_sha256_blocks(uint32_t* state, const uint8_t* data, size_t num_blocks)
+{
+#if PAS_X86_64
+    if (filc_crypto_features() & FILC_CRYPTO_SHA) {
+        sha256_blocks_sha_ni(state, data, num_blocks);
+        return;
+    }
+#endif /* PAS_X86_64 */
+    sha256_blocks_portable(state, data, num_blocks);
+}
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull
+};
+
+void filc_crypto_sha512_blocks(uint64_t* state, const uint8_t* data, size_t num_blocks)
+{
+    for (; num_blocks--; data += 128) {
+        uint64_t w[80];
+        uint64_t v[8];
+        unsigned index;
+
+        for (index = 0; index < 16; ++index)
+            w[index] = load_be64(data + index * 8);
+        for (index = 16; index < 80; ++index) {
+            uint64_t s0 = rotr64(w[index - 15], 1) ^ rotr64(w[index - 15], 8)
+                ^ (w[index - 15] >> 7);
+            uint64_t s1 = rotr64(w[index - 2], 19) ^ rotr64(w[index - 2], 61)
+                ^ (w[index - 2] >> 6);
+            w[index] = w[index - 16] + s0 + w[index - 7] + s1;
+        }
+
+        for (index = 0; index < 8; ++index)
+            v[index] = state[index];
+        for (index = 0; index < 80; ++index) {
+            uint64_t s1 = rotr64(v[4], 14) ^ rotr64(v[4], 18) ^ rotr64(v[4], 41);
+            uint64_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+            uint64_t t1 = v[7] + s1 + ch + sha512_k[index] + w[index];
+            uint64_t s0 = rotr64(v[0], 28) ^ rotr64(v[0], 34) ^ rotr64(v[0], 39);
+            uint64_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+            v[7] = v[6];
+            v[6] = v[5];
+            v[5] = v[4];
+            v[4] = v[3] + t1;
+            v[3] = v[2];
+            v[2] = v[1];
+            v[1] = v[0];
+            v[0] = t1 + s0 + maj;
+        }
+        for (index = 0; index < 8; ++index)
+            state[index] += v[index];
+    }
+}
+
+static const uint8_t aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+/* This is the key expansion from FIPS-197, one byte at a time. It only runs once per key, so it's
+   not worth using aeskeygenassist, and this way it works on any CPU. */
+bool filc_crypto_aes_set_encrypt_key(const uint8_t* user_key, unsigned bits,
+                                     filc_crypto_aes_key* key)
+{
+    unsigned key_words;
+    unsigned num_words;
+    unsigned index;
+    uint8_t round_constant;
+
+    switch (bits) {
+    case 128:
+    case 192:
+    case 256:
+        break;
+    default:
+        return false;
+    }
+
+    key_words = bits / 32;
+    key->rounds = key_words + 6;
+    num_words = 4 * (key->rounds + 1);
+    memcpy(key->round_keys, user_key, bits / 8);
+
+    round_constant = 1;
+    for (index = key_words; index < num_words; ++index) {
+        uint8_t word[4];
+        unsigned byte_index;
+
+        memcpy(word, key->round_keys + (index - 1) * 4, 4);
+        if (!(index % key_words)) {
+            uint8_t first = word[0];
+            word[0] = aes_sbox[word[1]] ^ round_constant;
+            word[1] = aes_sbox[word[2]];
+            word[2] = aes_sbox[word[3]];
+            word[3] = aes_sbox[first];
+            round_constant = (uint8_t)((round_constant << 1) ^ ((round_constant >> 7) * 0x1b));
+        } else if (key_words > 6 && index % key_words == 4) {
+            for (byte_index = 0; byte_index < 4; ++byte_index)
+                word[byte_index] = aes_sbox[word[byte_index]];
+        }
+        for (byte_index = 0; byte_index < 4; ++byte_index) {
+            key->round_keys[index * 4 + byte_index] =
+                key->round_keys[(index - key_words) * 4 + byte_index] ^ word[byte_index];
+        }
+    }
+    return true;
+}
+
+#if PAS_X86_64
+TARGET_CRYPTO static inline __m128i aes_round_key(const filc_crypto_aes_key* key, unsigned index)
+{
+    return _mm_loadu_si128((const __m128i*)(key->round_keys + index * 16));
+}
+
+TARGET_CRYPTO void filc_crypto_aes_encrypt_block(const uint8_t* in, uint8_t* out,
+                                                 const filc_crypto_aes_key* key)
+{
+    __m128i block;
+    unsigned index;
+
+    PAS_ASSERT(filc_crypto_aes_rounds_are_valid(key->rounds));
+    block = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), aes_round_key(key, 0));
+    for (index = 1; index < key->rounds; ++index)
+        block = _mm_aesenc_si128(block, aes_round_key(key, index));
+    block = _mm_aesenclast_si128(block, aes_round_key(key, key->rounds));
+    _mm_storeu_si128((__m128i*)out, block);
+}
+
+/* Does four blocks at a time, since aesenc has a latency of several cycles but can issue every
+   cycle. */
+TARGET_CRYPTO void filc_crypto_aes_ctr32_encrypt_blocks(const uint8_t* in, uint8_t* out,
+                                                        size_t num_blocks,
+                                                        const filc_crypto_aes_key* key,
+                                                        const uint8_t* ivec)
+{
+    __m128i round_keys[FILC_CRYPTO_AES_MAX_ROUNDS + 1];
+    uint8_t counter_block[16];
+    uint32_t counter;
+    unsigned rounds;
+    unsigned index;
+
+    rounds = key->rounds;
+    PAS_ASSERT(filc_crypto_aes_rounds_are_valid(rounds));
+    for (index = 0; index <= rounds; ++index)
+        round_keys[index] = aes_round_key(key, index);
+    memcpy(counter_block, ivec, 16);
+    counter = load_be32(ivec + 12);
+
+    while (num_blocks) {
+        __m128i blocks[4];
+        unsigned num_lanes;
+        unsigned lane;
+
+        num_lanes = (unsigned)pas_min_uintptr(num_blocks, 4);
+        for (lane = 0; lane < num_lanes; ++lane) {
+            uint32_t value = counter++;
+            counter_block[12] = (uint8_t)(value >> 24);
+            counter_block[13] = (uint8_t)(value >> 16);
+            counter_block[14] = (uint8_t)(value >> 8);
+            counter_block[15] = (uint8_t)value;
+            blocks[lane] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)counter_block),
+                                         round_keys[0]);
+        }
+        for (index = 1; index < rounds; ++index) {
+            for (lane = 0; lane < num_lanes; ++lane)
+                blocks[lane] = _mm_aesenc_si128(blocks[lane], round_keys[index]);
+        }
+        for (lane = 0; lane < num_lanes; ++lane) {
+            __m128i block = _mm_aesenclast_si128(blocks[lane], round_keys[rounds]);
+            block = _mm_xor_si128(block, _mm_loadu_si128((const __m128i*)(in + lane * 16)));
+            _mm_storeu_si128((__m128i*)(out + lane * 16), block);
+        }
+        in += num_lanes * 16;
+        out += num_lanes * 16;
+        num_blocks -= num_lanes;
+    }
+}
+
+/* This is the carry-less multiply and reduction from Intel's "Carry-Less Multiplication
+   Instruction and its Usage for Computing the GCM Mode". GHASH's bit order is reflected, so the
+   operands are byte swapped into place and the product is shifted left by one before reducing. */
+TARGET_CRYPTO static inline __m128i ghash_multiply(__m128i a, __m128i b)
+{
+    __m128i low = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                   _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i high = _mm_clmulepi64_si128(a, b, 0x11);
+    __m128i low_carry;
+    __m128i high_carry;
+    __m128i spill;
+    __m128i fold;
+    __m128i fold_high;
+
+    low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+    high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+    low_carry = _mm_srli_epi32(low, 31);
+    high_carry = _mm_srli_epi32(high, 31);
+    low = _mm_slli_epi32(low, 1);
+    high = _mm_slli_epi32(high, 1);
+    spill = _mm_srli_si128(low_carry, 12);
+    high_carry = _mm_slli_si128(high_carry, 4);
+    low_carry = _mm_slli_si128(low_carry, 4);
+    low = _mm_or_si128(low, low_carry);
+    high = _mm_or_si128(_mm_or_si128(high, high_carry), spill);
+
+    fold = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)),
+                         _mm_slli_epi32(low, 25));
+    fold_high = _mm_srli_si128(fold, 4);
+    low = _mm_xor_si128(low, _mm_slli_si128(fold, 12));
+    fold = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)),
+                         _mm_srli_epi32(low, 7));
+    fold = _mm_xor_si128(fold, fold_high);
+    low = _mm_xor_si128(low, fold);
+    return _mm_xor_si128(high, low);
+}
+
+TARGET_CRYPTO void filc_crypto_ghash(uint8_t* xi, const uint8_t* h, const uint8_t* in, size_t len)
+{
+    __m128i byte_swap_mask = _mm_set_epi64x(0x0001020304050607ll, 0x08090a0b0c0d0e0fll);
+    __m128i hash_key = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)h), byte_swap_mask);
+    __m128i state = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)xi), byte_swap_mask);
+
+    for (; len >= 16; len -= 16, in += 16) {
+        __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), byte_swap_mask);
+        state = ghash_multiply(_mm_xor_si128(state, block), hash_key);
+    }
+    _mm_storeu_si128((__m128i*)xi, _mm_shuffle_epi8(state, byte_swap_mask));
+}
+#else /* PAS_X86_64 -> so !PAS_X86_64 */
+void filc_crypto_aes_encrypt_block(const uint8_t* in, uint8_t* out, const filc_crypto_aes_key* key)
+{
+    PAS_UNUSED_PARAM(in);
+    PAS_UNUSED_PARAM(out);
+    PAS_UNUSED_PARAM(key);
+    PAS_UNREACHABLE();
+}
+
+void filc_crypto_aes_ctr32_encrypt_blocks(const uint8_t* in, uint8_t* out, size_t num_blocks,
+                                          const filc_crypto_aes_key* key, const uint8_t* ivec)
+{
+    PAS_UNUSED_PARAM(in);
+    PAS_UNUSED_PARAM(out);
+    PAS_UNUSED_PARAM(num_blocks);
+    PAS_UNUSED_PARAM(key);
+    PAS_UNUSED_PARAM(ivec);
+    PAS_UNREACHABLE();
+}
+
+void filc_crypto_ghash(uint8_t* xi, const uint8_t* h, const uint8_t* in, size_t len)
+{
+    PAS_UNUSED_PARAM(xi);
+    PAS_UNUSED_PARAM(h);
+    PAS_UNUSED_PARAM(in);
+    PAS_UNUSED_PARAM(len);
+    PAS_UNREACHABLE();
+}
+#endif /* PAS_X86_64 -> so end of !PAS_X86_64 */
+
+#define CHACHA20_QUARTER_ROUND(a, b, c, d) do { \
+        a += b; d = rotl32(d ^ a, 16); \
+        c += d; b = rotl32(b ^ c, 12); \
+        a += b; d = rotl32(d ^ a, 8); \
+        c += d; b = rotl32(b ^ c, 7); \
+    } while (false)
+
+void filc_crypto_chacha20_ctr32(uint8_t* out, const uint8_t* in, size_t len,
+                                const uint32_t* key, const uint32_t* counter)
+{
+    uint32_t input[16];
+    unsigned index;
+
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (index = 0; index < 8; ++index)
+        input[4 + index] = key[index];
+    for (index = 0; index < 4; ++index)
+        input[12 + index] = counter[index];
+
+    while (len) {
+        uint32_t x[16];
+        uint8_t keystream[64];
+        size_t chunk;
+        size_t byte_index;
+
+        memcpy(x, input, sizeof(x));
+        for (index = 0; index < 10; ++index) {
+            CHACHA20_QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+            CHACHA20_QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+            CHACHA20_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+            CHACHA20_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+            CHACHA20_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+            CHACHA20_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+            CHACHA20_QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+            CHACHA20_QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+        }
+        for (index = 0; index < 16; ++index)
+            store_le32(keystream + index * 4, x[index] + input[index]);
+
+        chunk = pas_min_uintptr(len, 64);
+        for (byte_index = 0; byte_index < chunk; ++byte_index)
+            out[byte_index] = in[byte_index] ^ keystream[byte_index];
+        in += chunk;
+        out += chunk;
+        len -= chunk;
+        input[12]++;
+    }
+}
+
+/* This is poly1305-donna's 64-bit flavor: h and r are kept as three limbs of 44, 44, and 42 bits,
+   so the products fit in 128 bits with room to spare. */
+#define POLY1305_MASK44 0xfffffffffffull
+#define POLY1305_MASK42 0x3ffffffffffull
+
+void filc_crypto_poly1305_init(filc_crypto_poly1305* state, const uint8_t* key)
+{
+    uint64_t t0 = load_le64(key);
+    uint64_t t1 = load_le64(key + 8);
+
+    state->r[0] = t0 & 0xffc0fffffffull;
+    state->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffull;
+    state->r[2] = (t1 >> 24) & 0x00ffffffc0full;
+    state->h[0] = 0;
+    state->h[1] = 0;
+    state->h[2] = 0;
+}
+
+void filc_crypto_poly1305_blocks(filc_crypto_poly1305* state, const uint8_t* in, size_t len,
+                                 unsigned padbit)
+{
+    uint64_t hibit = (uint64_t)(padbit & 1) << 40;
+    uint64_t r0 = state->r[0];
+    uint64_t r1 = state->r[1];
+    uint64_t r2 = state->r[2];
+    uint64_t s1 = r1 * (5 << 2);
+    uint64_t s2 = r2 * (5 << 2);
+    uint64_t h0 = state->h[0];
+    uint64_t h1 = state->h[1];
+    uint64_t h2 = state->h[2];
+
+    for (; len >= 16; len -= 16, in += 16) {
+        uint64_t t0 = load_le64(in);
+        uint64_t t1 = load_le64(in + 8);
+        unsigned __int128 d0;
+        unsigned __int128 d1;
+        unsigned __int128 d2;
+        uint64_t carry;
+
+        h0 += t0 & POLY1305_MASK44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44;
+        h2 += ((t1 >> 24) & POLY1305_MASK42) | hibit;
+
+        d0 = (unsigned __int128)h0 * r0 + (unsigned __int128)h1 * s2 + (unsigned __int128)h2 * s1;
+        d1 = (unsigned __int128)h0 * r1 + (unsigned __int128)h1 * r0 + (unsigned __int128)h2 * s2;
+        d2 = (unsigned __int128)h0 * r2 + (unsigned __int128)h1 * r1 + (unsigned __int128)h2 * r0;
+
+        carry = (uint64_t)(d0 >> 44);
+        h0 = (uint64_t)d0 & POLY1305_MASK44;
+        d1 += carry;
+        carry = (uint64_t)(d1 >> 44);
+        h1 = (uint64_t)d1 & POLY1305_MASK44;
+        d2 += carry;
+        carry = (uint64_t)(d2 >> 42);
+        h2 = (uint64_t)d2 & POLY1305_MASK42;
+        h0 += carry * 5;
+        carry = h0 >> 44;
+        h0 &= POLY1305_MASK44;
+        h1 += carry;
+    }
+
+    state->h[0] = h0;
+    state->h[1] = h1;
+    state->h[2] = h2;
+}
+
+void filc_crypto_poly1305_emit(const filc_crypto_poly1305* state, uint8_t* mac,
+                               const uint8_t* nonce)
+{
+    uint64_t h0 = state->h[0];
+    uint64_t h1 = state->h[1];
+    uint64_t h2 = state->h[2];
+    uint64_t g0;
+    uint64_t g1;
+    uint64_t g2;
+    uint64_t carry;
+    uint64_t mask;
+    uint64_t t0;
+    uint64_t t1;
+    unsigned pass;
+
+    for (pass = 0; pass < 2; ++pass) {
+        carry = h1 >> 44;
+        h1 &= POLY1305_MASK44;
+        h2 += carry;
+        carry = h2 >> 42;
+        h2 &= POLY1305_MASK42;
+        h0 += carry * 5;
+        carry = h0 >> 44;
+        h0 &= POLY1305_MASK44;
+        h1 += carry;
+    }
+
+    /* Compute h - p = h + 5 - 2^130, and pick it if it didn't go negative. */
+    g0 = h0 + 5;
+    carry = g0 >> 44;
+    g0 &= POLY1305_MASK44;
+    g1 = h1 + carry;
+    carry = g1 >> 44;
+    g1 &= POLY1305_MASK44;
+    g2 = h2 + carry - ((uint64_t)1 << 42);
+    mask = (g2 >> 63) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+
+    t0 = load_le64(nonce);
+    t1 = load_le64(nonce + 8);
+    h0 += t0 & POLY1305_MASK44;
+    carry = h0 >> 44;
+    h0 &= POLY1305_MASK44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44) + carry;
+    carry = h1 >> 44;
+    h1 &= POLY1305_MASK44;
+    h2 += ((t1 >> 24) & POLY1305_MASK42) + carry;
+    h2 &= POLY1305_MASK42;
+
+    store_le64(mac, h0 | (h1 << 44));
+    store_le64(mac + 8, (h1 >> 20) | (h2 << 24));
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
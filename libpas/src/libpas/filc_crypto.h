@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_CRYPTO_H
+#define FILC_CRYPTO_H
+
+#include "pas_utils.h"
+
+PAS_BEGIN_EXTERN_C;
+
+/* These are the crypto kernels behind the zcrypto natives in stdfil.h. Fil-C can't run perlasm, so
+   OpenSSL and friends get built with no-asm, and their C fallbacks are slow even before Fil-C's
+   checks. These kernels have the same semantics as the OpenSSL assembly entry points that they
+   stand in for, so a port only has to swap the calls.
+   
+   The natives check the capabilities of every buffer before calling in here, so these functions
+   trust their arguments completely. Keys and states live in user memory, so the natives also have
+   to make sure that anything used as a loop bound (like the number of AES rounds) is sane. None of
+   the values in here are used as addresses, so the worst that a corrupted key or state can do is
+   give the wrong answer. */
+
+#define FILC_CRYPTO_AES    1u /* AES-NI, so the AES functions work. */
+#define FILC_CRYPTO_PCLMUL 2u /* Carry-less multiply, so filc_crypto_ghash() works. */
+#define FILC_CRYPTO_SHA    4u /* SHA extensions. SHA-256 is faster, but works either way. */
+
+/* Tells which of the hardware features above this CPU has. */
+PAS_API unsigned filc_crypto_features(void);
+
+/* Updates the state with num_blocks 64-byte blocks, like OpenSSL's sha256_block_data_order. */
+PAS_API void filc_crypto_sha256_blocks(uint32_t* state, const uint8_t* data, size_t num_blocks);
+
+/* Updates the state with num_blocks 128-byte blocks, like OpenSSL's sha512_block_data_order. */
+PAS_API void filc_crypto_sha512_blocks(uint64_t* state, const uint8_t* data, size_t num_blocks);
+
+#define FILC_CRYPTO_AES_MAX_ROUNDS 14
+
+/* This must stay in sync with zcrypto_aes_key in stdfil.h. The round keys are in the byte order
+   that FIPS-197 gives them in, which is also what AES-NI wants. */
+struct filc_crypto_aes_key {
+    uint8_t round_keys[16 * (FILC_CRYPTO_AES_MAX_ROUNDS + 1)];
+    uint32_t rounds;
+};
+
+typedef struct filc_crypto_aes_key filc_crypto_aes_key;
+
+/* Tells if the number of rounds is one that a key could have, which is to say 10, 12, or 14. */
+static inline bool filc_crypto_aes_rounds_are_valid(uint32_t rounds)
+{
+    return rounds == 10 || rounds == 12 || rounds == 14;
+}
+
+/* Expands a 128, 192, or 256 bit key for encryption. Returns false for any other number of bits.
+   This doesn't need AES-NI. */
+PAS_API bool filc_crypto_aes_set_encrypt_key(const uint8_t* user_key, unsigned bits,
+                                             filc_crypto_aes_key* key);
+
+/* These need FILC_CRYPTO_AES. */
+PAS_API void filc_crypto_aes_encrypt_block(const uint8_t* in, uint8_t* out,
+                                           const filc_crypto_aes_key* key);
+
+/* Like OpenSSL's aesni_ctr32_encrypt_blocks: encrypts num_blocks blocks in counter mode, where the
+   counter is the last 32 bits of ivec, big endian, and wraps around without carrying into the rest
+   of ivec. Doesn't update ivec. */
+PAS_API void filc_crypto_aes_ctr32_encrypt_blocks(const uint8_t* in, uint8_t* out,
+                                                  size_t num_blocks,
+                                                  const filc_crypto_aes_key* key,
+                                                  const uint8_t* ivec);
+
+/* Needs FILC_CRYPTO_PCLMUL. Like OpenSSL's gcm_ghash_clmul, but takes the hash key H itself (i.e.
+   the encryption of the zero block) rather than a precomputed table. Folds len bytes of input into
+   Xi. len must be a multiple of 16. */
+PAS_API void filc_crypto_ghash(uint8_t* xi, const uint8_t* h, const uint8_t* in, size_t len);
+
+/* Like OpenSSL's ChaCha20_ctr32: key is 8 little endian words and counter is the 32-bit block
+   counter followed by the 96-bit nonce, as 4 words. Doesn't update counter. */
+PAS_API void filc_crypto_chacha20_ctr32(uint8_t* out, const uint8_t* in, size_t len,
+                                        const uint32_t* key, const uint32_t* counter);
+
+/* This must stay in sync with zcrypto_poly1305 in stdfil.h. */
+struct filc_crypto_poly1305 {
+    uint64_t h[3];
+    uint64_t r[3];
+};
+
+typedef struct filc_crypto_poly1305 filc_crypto_poly1305;
+
+/* Like OpenSSL's poly1305_init, poly1305_blocks, and poly1305_emit. The key is the 16 byte r half
+   of the one time key, and the nonce is the s half. len must be a multiple of 16, and padbit is 1
+   for full blocks and 0 for a final block that the caller has already padded. */
+PAS_API void filc_crypto_poly1305_init(filc_crypto_poly1305* state, const uint8_t* key);
+PAS_API void filc_crypto_poly1305_blocks(filc_crypto_poly1305* state, const uint8_t* in, size_t len,
+                                         unsigned padbit);
+PAS_API void filc_crypto_poly1305_emit(const filc_crypto_poly1305* state, uint8_t* mac,
+                                       const uint8_t* nonce);
+
+PAS_END_EXTERN_C;
+
+#endif /* FILC_CRYPTO_H */
@@ -0,0 +1,73 @@
+# Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+
+	.text
+	.globl filc_fiber_switch_stacks
+	.p2align 4, 0x90
+	.type filc_fiber_switch_stacks,@function
+
+        # void filc_fiber_switch_stacks(void** saved_sp, void* new_sp)
+        #
+        # Everything the SysV ABI says is callee-saved goes on the stack we're leaving, and the
+        # return address is already there. So the saved stack looks like this, from the top:
+        #
+        #     mxcsr and x87 control word, r15, r14, r13, r12, rbx, rbp, return address
+        #
+        # filc_fiber_create() has to lay out a new fiber's stack the same way.
+filc_fiber_switch_stacks:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size filc_fiber_switch_stacks, .-filc_fiber_switch_stacks
+
+	.globl filc_fiber_entry
+	.p2align 4, 0x90
+	.type filc_fiber_entry,@function
+
+        # A new fiber "returns" here the first time it's switched to, with the fiber in r12 and a
+        # 16-byte aligned stack. filc_fiber_start() never returns, since a fiber that's done
+        # switches away for good.
+filc_fiber_entry:
+	movq %r12, %rdi
+	call filc_fiber_start@PLT
+	ud2
+	.size filc_fiber_entry, .-filc_fiber_entry
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_heap_composition.h"
+
+#include "bmalloc_heap.h"
+#include "fugc.h"
+#include "pas_lock.h"
+#include "pas_ptr_hash_set.h"
+#include "verse_heap_inlines.h"
+
+#if PAS_ENABLE_FILC
+
+bool filc_heap_composition_is_recording;
+bool filc_heap_composition_should_log;
+
+/* Protects the request state and the last result. */
+static pas_system_mutex request_lock;
+static unsigned num_requests;
+static uint64_t last_recorded_cycle;
+static filc_heap_composition last_composition;
+
+/* Markers add to this with atomics while recording. */
+static filc_heap_composition current_composition;
+
+/* The freed objects that we've counted so far this cycle. Freed objects don't get marked, so this
+   is how we tell if we've seen one before. */
+static pas_lock freed_objects_lock = PAS_LOCK_INITIALIZER;
+static pas_ptr_hash_set freed_objects;
+static pas_allocation_config allocation_config;
+
+void filc_heap_composition_initialize(void)
+{
+    pas_system_mutex_construct(&request_lock);
+    pas_ptr_hash_set_construct(&freed_objects);
+    bmalloc_initialize_allocation_config(&allocation_config);
+}
+
+static void add(uint64_t* counter, uint64_t value)
+{
+    /* Fil-C is 64-bit only, so uint64_t is uintptr_t. */
+    if (value)
+        pas_atomic_exchange_add_uintptr((uintptr_t*)counter, value);
+}
+
+static filc_heap_composition_bucket* bucket_for_size(size_t size)
+{
+    unsigned index = size ? pas_log2(size) + 1 : 0;
+    return current_composition.buckets
+        + pas_min_uint32(index, FILC_HEAP_COMPOSITION_NUM_BUCKETS - 1);
+}
+
+void filc_heap_composition_record_object(filc_object* object, void* mark_base, uintptr_t aux)
+{
+    filc_object_flags flags = filc_aux_get_flags(aux);
+    if (PAS_UNLIKELY(flags & FILC_OBJECT_FLAG_FREE)) {
+        filc_heap_composition_record_freed(object);
+        return;
+    }
+
+    size_t allocation_size = verse_heap_get_allocation_size_inline((uintptr_t)mark_base);
+    filc_heap_composition_bucket* bucket = bucket_for_size(allocation_size);
+    if (filc_object_flags_is_special(flags)) {
+        add(&bucket->num_special_objects, 1);
+        add(&bucket->special_bytes, allocation_size);
+        return;
+    }
+
+    size_t payload_size = filc_object_size_not_null(object);
+    size_t alignment_size = (uintptr_t)object - (uintptr_t)mark_base;
+    size_t used_size = alignment_size + sizeof(filc_object) + payload_size;
+    size_t aux_size = 0;
+    char* aux_ptr = filc_aux_get_ptr(aux);
+    if (aux_ptr) {
+        if (flags & FILC_OBJECT_FLAG_INLINE_AUX) {
+            aux_size = payload_size;
+            used_size += payload_size;
+        } else if (!(flags & FILC_OBJECT_FLAG_GLOBAL_AUX))
+            aux_size = verse_heap_get_allocation_size_inline((uintptr_t)aux_ptr);
+    }
+
+    add(&bucket->num_objects, 1);
+    add(&bucket->payload_bytes, payload_size);
+    add(&bucket->header_bytes, sizeof(filc_object));
+    add(&bucket->alignment_bytes, alignment_size);
+    if (allocation_size > used_size)
+        add(&bucket->slack_bytes, allocation_size - used_size);
+    add(&bucket->aux_bytes, aux_size);
+}
+
+void filc_heap_composition_record_box(filc_atomic_box* box)
+{
+    add(&current_composition.num_atomic_boxes, 1);
+    add(&current_composition.atomic_box_bytes,
+        verse_heap_get_allocation_size_inline((uintptr_t)box));
+}
+
+void filc_heap_composition_record_freed(filc_object* object)
+{
+    if (object == &filc_free_singleton)
+        return;
+
+    pas_lock_lock(&freed_objects_lock);
+    bool is_new = filc_heap_composition_is_recording
+        && pas_ptr_hash_set_set(&freed_objects, object, NULL, &allocation_config);
+    pas_lock_unlock(&freed_objects_lock);
+    if (!is_new)
+        return;
+
+    /* Freed objects have a size of zero, so we have to ask the heap how big they were. Big ones
+       already gave their pages back to the OS, but their address space is still taken. */
+    size_t allocation_size = verse_heap_get_allocation_size_inline(
+        (uintptr_t)filc_object_mark_base(object));
+    filc_heap_composition_bucket* bucket = bucket_for_size(allocation_size);
+    add(&bucket->num_freed_objects, 1);
+    add(&bucket->freed_bytes, allocation_size);
+}
+
+void filc_heap_composition_get(filc_heap_composition* result)
+{
+    pas_system_mutex_lock(&request_lock);
+    uint64_t cycle_before = last_recorded_cycle;
+    num_requests++;
+    pas_system_mutex_unlock(&request_lock);
+
+    /* The cycle that's running now may have started before we asked, and in generational mode the
+       one after it may be young, so this can take a few tries. */
+    for (;;) {
+        fugc_wait(fugc_request_fresh());
+        pas_system_mutex_lock(&request_lock);
+        bool done = last_recorded_cycle != cycle_before;
+        pas_system_mutex_unlock(&request_lock);
+        if (done)
+            break;
+    }
+
+    pas_system_mutex_lock(&request_lock);
+    num_requests--;
+    *result = last_composition;
+    pas_system_mutex_unlock(&request_lock);
+}
+
+bool filc_heap_composition_is_pending(void)
+{
+    /* Nobody can be waiting until someone has called filc_heap_composition_get(), so it's OK to
+       skip the lock when nobody has. */
+    if (!num_requests)
+        return false;
+    pas_system_mutex_lock(&request_lock);
+    bool result = !!num_requests;
+    pas_system_mutex_unlock(&request_lock);
+    return result;
+}
+
+void filc_heap_composition_start_cycle(uint64_t cycle, bool is_full)
+{
+    if (!is_full || (!filc_heap_composition_should_log && !filc_heap_composition_is_pending()))
+        return;
+
+    PAS_ASSERT(!filc_heap_composition_is_recording);
+    pas_zero_memory(&current_composition, sizeof(current_composition));
+    current_composition.cycle = cycle;
+    pas_lock_lock(&freed_objects_lock);
+    PAS_ASSERT(!freed_objects.key_count);
+    filc_heap_composition_is_recording = true;
+    pas_lock_unlock(&freed_objects_lock);
+}
+
+void filc_heap_composition_finish_cycle(void)
+{
+    if (!filc_heap_composition_is_recording)
+        return;
+
+    pas_lock_lock(&freed_objects_lock);
+    filc_heap_composition_is_recording = false;
+    pas_ptr_hash_set_destruct(&freed_objects, &allocation_config);
+    pas_ptr_hash_set_construct(&freed_objects);
+    pas_lock_unlock(&freed_objects_lock);
+
+    if (filc_heap_composition_should_log) {
+        pas_log("[%d] fugc: heap composition:\n", pas_getpid());
+        filc_heap_composition_dump(&current_composition, &pas_log_stream.base);
+    }
+
+    pas_system_mutex_lock(&request_lock);
+    last_composition = current_composition;
+    last_recorded_cycle = current_composition.cycle;
+    pas_system_mutex_unlock(&request_lock);
+}
+
+void filc_heap_composition_dump(filc_heap_composition* composition, pas_stream* stream)
+{
+    filc_heap_composition_bucket total;
+    size_t index;
+
+    pas_zero_memory(&total, sizeof(total));
+    pas_stream_printf(
+        stream, "    %12s %10s %12s %12s %12s %12s %12s %10s %12s %10s %12s\n",
+        "size <", "objects", "payload", "headers", "alignment", "slack", "aux", "special",
+        "special B", "freed", "freed B");
+    for (index = 0; index < FILC_HEAP_COMPOSITION_NUM_BUCKETS; ++index) {
+        filc_heap_composition_bucket* bucket = composition->buckets + index;
+        if (!bucket->num_objects && !bucket->num_special_objects && !bucket->num_freed_objects)
+            continue;
+        if (index == FILC_HEAP_COMPOSITION_NUM_BUCKETS - 1)
+            pas_stream_printf(stream, "    %12s", "more");
+        else
+            pas_stream_printf(stream, "    %12" PRIu64, (uint64_t)1 << index);
+        pas_stream_printf(
+            stream,
+            " %10" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+            " %10" PRIu64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n",
+            bucket->num_objects, bucket->payload_bytes, bucket->header_bytes,
+            bucket->alignment_bytes, bucket->slack_bytes, bucket->aux_bytes,
+            bucket->num_special_objects, bucket->special_bytes, bucket->num_freed_objects,
+            bucket->freed_bytes);
+        total.num_objects += bucket->num_objects;
+        total.payload_bytes += bucket->payload_bytes;
+        total.header_bytes += bucket->header_bytes;
+        total.alignment_bytes += bucket->alignment_bytes;
+        total.slack_bytes += bucket->slack_bytes;
+        total.aux_bytes += bucket->aux_bytes;
+        total.num_special_objects += bucket->num_special_objects;
+        total.special_bytes += bucket->special_bytes;
+        total.num_freed_objects += bucket->num_freed_objects;
+        total.freed_bytes += bucket->freed_bytes;
+    }
+    pas_stream_printf(
+        stream,
+        "    %12s %10" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+        " %10" PRIu64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n",
+        "total", total.num_objects, total.payload_bytes, total.header_bytes,
+        total.alignment_bytes, total.slack_bytes, total.aux_bytes, total.num_special_objects,
+        total.special_bytes, total.num_freed_objects, total.freed_bytes);
+    pas_stream_printf(
+        stream, "    atomic boxes: %" PRIu64 " (%" PRIu64 " bytes)\n",
+        composition->num_atomic_boxes, composition->atomic_box_bytes);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef FILC_HEAP_COMPOSITION_H
+#define FILC_HEAP_COMPOSITION_H
+
+#include "filc_runtime.h"
+
+/* This breaks down the live heap by what the bytes are for: payloads versus filc_object headers,
+   alignment headers, aux arrays, atomic boxes, special objects, and freed objects that have not
+   been swept yet. Asking for it (zgc_heap_composition) makes the next full collection cycle add up
+   every object that its markers mark, so it costs one concurrent GC cycle. FUGC_VERBOSE=2 or more
+   also records and logs it for every full cycle.
+
+   Objects allocated while the cycle is running are allocated black rather than marked, so they
+   don't show up. Neither do globals, stack objects, or freed objects that nothing points at
+   anymore. */
+
+#define FILC_HEAP_COMPOSITION_NUM_BUCKETS 32
+
+/* This must stay in sync with zgc_heap_composition_bucket in stdfil.h. */
+typedef struct {
+    uint64_t num_objects;
+    uint64_t payload_bytes;
+    uint64_t header_bytes;
+    uint64_t alignment_bytes;
+    uint64_t slack_bytes;
+    uint64_t aux_bytes;
+    uint64_t num_special_objects;
+    uint64_t special_bytes;
+    uint64_t num_freed_objects;
+    uint64_t freed_bytes;
+} filc_heap_composition_bucket;
+
+/* This must stay in sync with zgc_heap_composition_report in stdfil.h. Bucket i is for
+   allocations that are less than 2^i bytes but at least 2^(i-1). The last bucket also gets
+   everything bigger. */
+typedef struct {
+    uint64_t cycle;
+    uint64_t num_atomic_boxes;
+    uint64_t atomic_box_bytes;
+    filc_heap_composition_bucket buckets[FILC_HEAP_COMPOSITION_NUM_BUCKETS];
+} filc_heap_composition;
+
+PAS_API extern bool filc_heap_composition_is_recording;
+
+/* Set by FUGC from FUGC_VERBOSE. */
+PAS_API extern bool filc_heap_composition_should_log;
+
+PAS_API void filc_heap_composition_initialize(void);
+
+/* Waits for a full cycle to record the composition, and then returns it. Must be called with the
+   filc_thread exited. */
+PAS_API void filc_heap_composition_get(filc_heap_composition* result);
+
+/* Called by FUGC right before it starts marking. If someone is waiting for the composition, or if
+   we're logging it, and the cycle is full, then this starts recording. */
+PAS_API void filc_heap_composition_start_cycle(uint64_t cycle, bool is_full);
+
+/* Called by FUGC once marking is done, before destructing. */
+PAS_API void filc_heap_composition_finish_cycle(void);
+
+PAS_API bool filc_heap_composition_is_pending(void);
+
+/* Called by markers for every object that they newly mark, and for every atomic box. */
+PAS_API void filc_heap_composition_record_object(filc_object* object, void* mark_base,
+                                                 uintptr_t aux);
+PAS_API void filc_heap_composition_record_box(filc_atomic_box* box);
+
+/* Called by markers when they find a ptr to a freed object. It's fine to call this more than once
+   for the same object. */
+PAS_API void filc_heap_composition_record_freed(filc_object* object);
+
+PAS_API void filc_heap_composition_dump(filc_heap_composition* composition, pas_stream* stream);
+
+#endif /* FILC_HEAP_COMPOSITION_H */
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_heap_profiler.h"
+
+#include "bmalloc_heap.h"
+#include "pas_fd_stream.h"
+#include "verse_heap.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+#define NUM_SITE_BUCKETS 1024u
+
+typedef struct site site;
+typedef struct sample sample;
+
+struct site {
+    site* next_in_bucket;
+    unsigned depth;
+    const filc_origin* stack[FILC_HEAP_PROFILER_MAX_DEPTH];
+    uint64_t allocated_bytes;
+    size_t live_bytes;
+    size_t num_live_samples;
+};
+
+struct sample {
+    filc_object* object;
+    site* site;
+    size_t weight;
+};
+
+static const char* profile_path;
+static size_t sample_bytes;
+static pas_fd_stream profile_stream;
+
+/* Protects everything below. Mutators take this while entered, but never hold it across a
+   pollcheck, so FUGC may take it at any time. */
+static pas_lock heap_profile_lock = PAS_LOCK_INITIALIZER;
+static site* site_buckets[NUM_SITE_BUCKETS];
+static size_t num_sites;
+static sample* samples;
+static size_t num_samples;
+static size_t samples_capacity;
+/* Sampled bytes allocated since start, by filc_thread allocator index. */
+static uint64_t size_histogram[FILC_THREAD_NUM_ALLOCATORS];
+
+static unsigned site_hash(const filc_origin** stack, unsigned depth)
+{
+    uintptr_t hash = depth;
+    unsigned index;
+    for (index = 0; index < depth; ++index)
+        hash = (hash * 33) ^ ((uintptr_t)stack[index] >> 3);
+    return (unsigned)(hash ^ (hash >> 17)) % NUM_SITE_BUCKETS;
+}
+
+static site* find_or_add_site(const filc_origin** stack, unsigned depth)
+{
+    unsigned bucket = site_hash(stack, depth);
+    site* result;
+    for (result = site_buckets[bucket]; result; result = result->next_in_bucket) {
+        if (result->depth == depth && !memcmp(result->stack, stack, depth * sizeof(stack[0])))
+            return result;
+    }
+    result = bmalloc_allocate_zeroed(sizeof(site));
+    result->depth = depth;
+    memcpy(result->stack, stack, depth * sizeof(stack[0]));
+    result->next_in_bucket = site_buckets[bucket];
+    site_buckets[bucket] = result;
+    num_sites++;
+    return result;
+}
+
+static void append_sample(filc_object* object, site* site, size_t weight)
+{
+    if (num_samples == samples_capacity) {
+        size_t new_capacity = pas_max_uintptr(samples_capacity * 2, 64);
+        sample* new_samples = bmalloc_allocate(filc_mul_size(new_capacity, sizeof(sample)));
+        memcpy(new_samples, samples, num_samples * sizeof(sample));
+        bmalloc_deallocate(samples);
+        samples = new_samples;
+        samples_capacity = new_capacity;
+    }
+    samples[num_samples].object = object;
+    samples[num_samples].site = site;
+    samples[num_samples].weight = weight;
+    num_samples++;
+}
+
+void filc_heap_profiler_initialize(void)
+{
+    profile_path = getenv("FILC_HEAP_PROFILE");
+    if (!profile_path || !*profile_path) {
+        profile_path = NULL;
+        return;
+    }
+    sample_bytes = pas_max_uintptr(
+        filc_get_size_env("FILC_HEAP_PROFILE_SAMPLE_BYTES", 512 * 1024), 1);
+
+    int fd = open(profile_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        pas_log("filc heap profiler: failed to open %s: %s\n", profile_path, strerror(errno));
+        profile_path = NULL;
+        return;
+    }
+    pas_fd_stream_construct(&profile_stream, fd);
+}
+
+size_t filc_heap_profiler_initial_countdown(void)
+{
+    if (!profile_path)
+        return SIZE_MAX;
+    return sample_bytes;
+}
+
+void filc_heap_profiler_sample(filc_thread* my_thread, filc_object* object, size_t size)
+{
+    PAS_ASSERT(profile_path);
+    PAS_ASSERT(size >= my_thread->bytes_until_heap_sample);
+
+    size_t overshoot = size - my_thread->bytes_until_heap_sample;
+    size_t weight = filc_mul_size(1 + overshoot / sample_bytes, sample_bytes);
+    my_thread->bytes_until_heap_sample = sample_bytes - overshoot % sample_bytes;
+
+    const filc_origin* stack[FILC_HEAP_PROFILER_MAX_DEPTH];
+    unsigned depth = 0;
+    filc_frame* frame;
+    for (frame = my_thread->top_frame;
+         frame && depth < FILC_HEAP_PROFILER_MAX_DEPTH;
+         frame = frame->parent)
+        stack[depth++] = frame->origin;
+
+    pas_lock_lock(&heap_profile_lock);
+    site* site = find_or_add_site(stack, depth);
+    site->allocated_bytes += weight;
+    size_t allocator_index = filc_compute_allocator_index(size);
+    if (filc_is_fast_allocator_index(allocator_index))
+        size_histogram[allocator_index] += weight;
+    append_sample(object, site, weight);
+    pas_lock_unlock(&heap_profile_lock);
+}
+
+void filc_heap_profiler_prune_dead(void)
+{
+    if (!profile_path)
+        return;
+
+    pas_lock_lock(&heap_profile_lock);
+    unsigned bucket;
+    for (bucket = 0; bucket < NUM_SITE_BUCKETS; ++bucket) {
+        site* site;
+        for (site = site_buckets[bucket]; site; site = site->next_in_bucket) {
+            site->live_bytes = 0;
+            site->num_live_samples = 0;
+        }
+    }
+    /* None of these objects have been swept yet, so it's safe to look at their headers. An object
+       that is unmarked now will be swept, and one that is freed will be unmarked next time, so we
+       forget those. Objects allocated from here until the sweep starts are allocated black. */
+    size_t src_index;
+    size_t dst_index = 0;
+    for (src_index = 0; src_index < num_samples; ++src_index) {
+        sample sample = samples[src_index];
+        if (!verse_heap_is_marked(filc_object_mark_base(sample.object))
+            || (filc_object_get_flags(sample.object) & FILC_OBJECT_FLAG_FREE))
+            continue;
+        sample.site->live_bytes += sample.weight;
+        sample.site->num_live_samples++;
+        samples[dst_index++] = sample;
+    }
+    num_samples = dst_index;
+    pas_lock_unlock(&heap_profile_lock);
+}
+
+void filc_heap_profiler_for_each_live_sample(
+    void (*callback)(filc_object* object, size_t weight, const filc_origin** stack, unsigned depth,
+                     void* arg),
+    void* arg)
+{
+    if (!profile_path)
+        return;
+
+    pas_lock_lock(&heap_profile_lock);
+    size_t index;
+    for (index = 0; index < num_samples; ++index) {
+        sample sample = samples[index];
+        if (!verse_heap_is_marked(filc_object_mark_base(sample.object))
+            || (filc_object_get_flags(sample.object) & FILC_OBJECT_FLAG_FREE))
+            continue;
+        callback(sample.object, sample.weight, sample.site->stack, sample.site->depth, arg);
+    }
+    pas_lock_unlock(&heap_profile_lock);
+}
+
+static int compare_sites_by_live_bytes(const void* a_ptr, const void* b_ptr)
+{
+    const site* a = *(const site**)a_ptr;
+    const site* b = *(const site**)b_ptr;
+    if (a->live_bytes > b->live_bytes)
+        return -1;
+    if (a->live_bytes < b->live_bytes)
+        return 1;
+    return 0;
+}
+
+void filc_heap_profiler_report(uint64_t cycle)
+{
+    if (!profile_path)
+        return;
+
+    pas_lock_lock(&heap_profile_lock);
+    site** sorted_sites = bmalloc_allocate(filc_mul_size(num_sites, sizeof(site*)));
+    size_t num_live_sites = 0;
+    size_t total_live_bytes = 0;
+    unsigned bucket;
+    for (bucket = 0; bucket < NUM_SITE_BUCKETS; ++bucket) {
+        site* site;
+        for (site = site_buckets[bucket]; site; site = site->next_in_bucket) {
+            if (!site->live_bytes)
+                continue;
+            sorted_sites[num_live_sites++] = site;
+            total_live_bytes += site->live_bytes;
+        }
+    }
+    qsort(sorted_sites, num_live_sites, sizeof(site*), compare_sites_by_live_bytes);
+
+    pas_stream* stream = &profile_stream.base;
+    pas_stream_printf(
+        stream, "heap profile after cycle %" PRIu64 ": %zu live bytes at %zu sites "
+        "(sampling every %zu bytes)\n", cycle, total_live_bytes, num_live_sites, sample_bytes);
+    size_t index;
+    for (index = 0; index < num_live_sites; ++index) {
+        site* site = sorted_sites[index];
+        pas_stream_printf(
+            stream, "    %zu live bytes (%zu samples), %" PRIu64 " bytes allocated since start:\n",
+            site->live_bytes, site->num_live_samples, site->allocated_bytes);
+        unsigned depth;
+        for (depth = 0; depth < site->depth; ++depth) {
+            const filc_origin* origin = site->stack[depth];
+            if (!origin) {
+                pas_stream_printf(stream, "        <null origin>\n");
+                continue;
+            }
+            for (; origin; origin = filc_origin_next_inline(origin)) {
+                const filc_origin_node* node = origin->origin_node;
+                pas_stream_printf(stream, "        %s (%s:%u)\n",
+                                  node->function ? node->function : "<somewhere>",
+                                  node->filename ? node->filename : "<somewhere>",
+                                  origin->line);
+            }
+        }
+    }
+    /* This is what FILC_SIZE_CLASS_PROFILE wants. It's the estimated number of allocations since
+       start for each inline size. */
+    pas_stream_printf(stream, "    size histogram:");
+    for (index = 1; index < FILC_THREAD_NUM_ALLOCATORS; ++index) {
+        size_t size = index << VERSE_HEAP_MIN_ALIGN_SHIFT;
+        if (size_histogram[index])
+            pas_stream_printf(stream, " %zu=%" PRIu64, size, size_histogram[index] / size);
+    }
+    pas_stream_printf(stream, "\n\n");
+    pas_lock_unlock(&heap_profile_lock);
+
+    bmalloc_deallocate(sorted_sites);
+}
+
+void filc_heap_profiler_dump_setup(void)
+{
+    if (!profile_path) {
+        pas_log("    heap profiler: off\n");
+        return;
+    }
+    pas_log("    heap profiler: writing to %s, sampling every %zu bytes\n",
+            profile_path, sample_bytes);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_HEAP_PROFILER_H
+#define FILC_HEAP_PROFILER_H
+
+#include "filc_runtime.h"
+
+/* This is a sampling heap profiler. It's enabled by setting FILC_HEAP_PROFILE to the path of the
+   file that the reports should go to.
+   
+   Each thread counts down the bytes it allocates, and the allocation that crosses the next
+   FILC_HEAP_PROFILE_SAMPLE_BYTES (default 512KB) boundary gets sampled. A sample remembers the
+   object, how many bytes of allocation it stands for, and the allocation site, which is the top
+   FILC_HEAP_PROFILER_MAX_DEPTH filc_frame origins of the allocating thread.
+   
+   Once FUGC is done marking and destructing, but before it sweeps, it asks us to forget samples
+   whose objects are unmarked or freed. Whatever's left is live, so at the end of each cycle we
+   write a report of the live bytes per allocation site, biggest first. Since samples hold their
+   objects weakly, their objects die on schedule.
+   
+   Each report ends with a size histogram line, which estimates how many allocations of each inline
+   size there have been since start. Feeding a report to FILC_SIZE_CLASS_PROFILE tunes the inline
+   size classes to it (see filc_size_classes.h). */
+
+#define FILC_HEAP_PROFILER_MAX_DEPTH 8u
+
+PAS_API void filc_heap_profiler_initialize(void);
+
+/* Returns what filc_thread::bytes_until_heap_sample should start out as. This is SIZE_MAX if the
+   heap profiler is off, so that the countdown never runs out. */
+PAS_API size_t filc_heap_profiler_initial_countdown(void);
+
+PAS_API void filc_heap_profiler_sample(filc_thread* my_thread, filc_object* object, size_t size);
+
+/* Called by FUGC after marking, before sweeping. */
+PAS_API void filc_heap_profiler_prune_dead(void);
+
+/* Calls the callback for each sample whose object is marked and not freed, with the heap profiler's
+   lock held. Used by the heap snapshot once marking is done. Does nothing if the heap profiler is
+   off. */
+PAS_API void filc_heap_profiler_for_each_live_sample(
+    void (*callback)(filc_object* object, size_t weight, const filc_origin** stack, unsigned depth,
+                     void* arg),
+    void* arg);
+
+/* Called by FUGC at the end of each cycle. */
+PAS_API void filc_heap_profiler_report(uint64_t cycle);
+
+PAS_API void filc_heap_profiler_dump_setup(void);
+
+static PAS_ALWAYS_INLINE void filc_heap_profiler_note_allocation(
+    filc_thread* my_thread, filc_object* object, size_t size)
+{
+    if (PAS_LIKELY(size < my_thread->bytes_until_heap_sample)) {
+        my_thread->bytes_until_heap_sample -= size;
+        return;
+    }
+    filc_heap_profiler_sample(my_thread, object, size);
+}
+
+#endif /* FILC_HEAP_PROFILER_H */
+
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_heap_snapshot.h"
+
+#include "filc_heap_profiler.h"
+#include "fugc.h"
+#include "pas_lock.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+#define BUFFER_SIZE 65536u
+
+bool filc_heap_snapshot_is_recording;
+
+/* Protects the request state. Callers of filc_heap_snapshot_write() wait on the condition. */
+static pas_system_mutex request_lock;
+static pas_system_condition request_cond;
+static bool is_requested;
+static bool is_done;
+static int snapshot_fd = -1;
+static int snapshot_error;
+
+/* Protects the buffer and the counts. Mutators take this while entered when they help with marking,
+   but never hold it across a pollcheck, so FUGC may take it at any time. */
+static pas_lock snapshot_lock = PAS_LOCK_INITIALIZER;
+static char buffer[BUFFER_SIZE];
+static size_t buffer_size;
+static size_t num_objects;
+static size_t num_leaves;
+static size_t num_edges;
+/* What the object being recorded points at, so that we can say which of those are leaves once
+   we're done with its line. */
+static filc_object_array leaves;
+
+void filc_heap_snapshot_initialize(void)
+{
+    pas_system_mutex_construct(&request_lock);
+    pas_system_condition_construct(&request_cond);
+    filc_object_array_construct(&leaves);
+}
+
+static void flush(void)
+{
+    size_t offset = 0;
+    while (offset < buffer_size && !snapshot_error) {
+        ssize_t result = write(snapshot_fd, buffer + offset, buffer_size - offset);
+        if (result < 0) {
+            if (errno != EINTR)
+                snapshot_error = errno;
+            continue;
+        }
+        offset += (size_t)result;
+    }
+    buffer_size = 0;
+}
+
+static void append(const char* format, ...) PAS_FORMAT_PRINTF(1, 2);
+static void append(const char* format, ...)
+{
+    for (;;) {
+        va_list arg_list;
+        va_start(arg_list, format);
+        int result = vsnprintf(buffer + buffer_size, BUFFER_SIZE - buffer_size, format, arg_list);
+        va_end(arg_list);
+        PAS_ASSERT(result >= 0);
+        if ((size_t)result < BUFFER_SIZE - buffer_size) {
+            buffer_size += (size_t)result;
+            return;
+        }
+        if (!buffer_size) {
+            /* Doesn't fit even in an empty buffer, so write what we can. Only really long function
+               names could get here. */
+            buffer_size = BUFFER_SIZE - 1;
+            return;
+        }
+        flush();
+    }
+}
+
+static void append_leaf_if_needed(filc_object* object)
+{
+    if (filc_object_aux_ptr(object) || filc_object_is_special(object))
+        return;
+    append("l %" PRIxPTR " %zu %x\n", (uintptr_t)object, filc_object_size_not_null(object),
+           (unsigned)filc_object_get_flags(object));
+    num_leaves++;
+}
+
+static filc_object* object_for_lower_or_box(filc_lower_or_box lower_or_box)
+{
+    void* lower;
+    if (filc_lower_or_box_is_null(lower_or_box))
+        return NULL;
+    if (filc_lower_or_box_is_box(lower_or_box))
+        lower = filc_flight_ptr_load_lower(&filc_lower_or_box_get_box(lower_or_box)->ptr);
+    else
+        lower = filc_lower_or_box_get_lower(lower_or_box);
+    if (!lower)
+        return NULL;
+    filc_object* result = filc_object_for_lower_not_null(lower);
+    if ((filc_object_get_flags(result) & FILC_OBJECT_FLAG_FREE))
+        return NULL;
+    return result;
+}
+
+void filc_heap_snapshot_record_object(filc_object* object)
+{
+    pas_lock_lock(&snapshot_lock);
+    /* The cycle may have finished recording while we were on our way here. */
+    if (!filc_heap_snapshot_is_recording) {
+        pas_lock_unlock(&snapshot_lock);
+        return;
+    }
+    size_t size = filc_object_size_not_null(object);
+    append("o %" PRIxPTR " %zu %x", (uintptr_t)object, size,
+           (unsigned)filc_object_get_flags(object));
+    num_objects++;
+    char* aux_ptr = filc_object_aux_ptr(object);
+    if (aux_ptr && !filc_object_is_special(object)) {
+        size_t offset;
+        for (offset = 0; offset < size; offset += sizeof(filc_lower_or_box)) {
+            filc_object* target = object_for_lower_or_box(
+                filc_lower_or_box_load_unfenced((filc_lower_or_box*)(aux_ptr + offset)));
+            if (!target)
+                continue;
+            append(" %" PRIxPTR, (uintptr_t)target);
+            num_edges++;
+            filc_object_array_push(&leaves, target);
+        }
+    }
+    append("\n");
+    /* Objects without ptrs never get scanned, so the objects that point at them have to say how
+       big they are. */
+    filc_object* leaf;
+    while ((leaf = filc_object_array_pop(&leaves)))
+        append_leaf_if_needed(leaf);
+    pas_lock_unlock(&snapshot_lock);
+}
+
+void filc_heap_snapshot_record_root(filc_object* object)
+{
+    pas_lock_lock(&snapshot_lock);
+    if (filc_heap_snapshot_is_recording) {
+        append("r %" PRIxPTR "\n", (uintptr_t)object);
+        append_leaf_if_needed(object);
+    }
+    pas_lock_unlock(&snapshot_lock);
+}
+
+bool filc_heap_snapshot_write(int fd)
+{
+    pas_system_mutex_lock(&request_lock);
+    while (is_requested)
+        pas_system_condition_wait(&request_cond, &request_lock);
+    is_requested = true;
+    is_done = false;
+    snapshot_fd = fd;
+    snapshot_error = 0;
+    pas_system_mutex_unlock(&request_lock);
+
+    /* The cycle that's running now may have started before we asked, and in generational mode the
+       one after it may be young, so this can take a few tries. */
+    for (;;) {
+        fugc_wait(fugc_request_fresh());
+        pas_system_mutex_lock(&request_lock);
+        bool done = is_done;
+        pas_system_mutex_unlock(&request_lock);
+        if (done)
+            break;
+    }
+
+    pas_system_mutex_lock(&request_lock);
+    int error = snapshot_error;
+    is_requested = false;
+    snapshot_fd = -1;
+    pas_system_condition_broadcast(&request_cond);
+    pas_system_mutex_unlock(&request_lock);
+
+    if (error) {
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+bool filc_heap_snapshot_is_pending(void)
+{
+    /* Nobody can be waiting on a snapshot until someone has called filc_heap_snapshot_write(), so
+       it's OK to skip the lock when nobody has. */
+    if (!is_requested)
+        return false;
+    pas_system_mutex_lock(&request_lock);
+    bool result = is_requested && !is_done;
+    pas_system_mutex_unlock(&request_lock);
+    return result;
+}
+
+void filc_heap_snapshot_start_cycle(uint64_t cycle, bool is_full)
+{
+    if (!is_full || !filc_heap_snapshot_is_pending())
+        return;
+
+    pas_lock_lock(&snapshot_lock);
+    PAS_ASSERT(!filc_heap_snapshot_is_recording);
+    PAS_ASSERT(!buffer_size);
+    num_objects = 0;
+    num_leaves = 0;
+    num_edges = 0;
+    append("filc heap snapshot 1\ncycle %" PRIu64 "\n", cycle);
+    filc_heap_snapshot_is_recording = true;
+    pas_lock_unlock(&snapshot_lock);
+}
+
+static void append_sample(filc_object* object, size_t weight, const filc_origin** stack,
+                          unsigned depth, void* arg)
+{
+    PAS_ASSERT(!arg);
+    append("s %" PRIxPTR " %zu\n", (uintptr_t)object, weight);
+    unsigned index;
+    for (index = 0; index < depth; ++index) {
+        const filc_origin* origin;
+        for (origin = stack[index]; origin; origin = filc_origin_next_inline(origin)) {
+            const filc_origin_node* node = origin->origin_node;
+            append("f %s\t%s\t%u\n",
+                   node->function ? node->function : "<somewhere>",
+                   node->filename ? node->filename : "<somewhere>",
+                   origin->line);
+        }
+    }
+}
+
+void filc_heap_snapshot_finish_cycle(void)
+{
+    if (!filc_heap_snapshot_is_recording)
+        return;
+
+    pas_lock_lock(&snapshot_lock);
+    filc_heap_snapshot_is_recording = false;
+    filc_heap_profiler_for_each_live_sample(append_sample, NULL);
+    append("end %zu %zu %zu\n", num_objects, num_leaves, num_edges);
+    flush();
+    pas_lock_unlock(&snapshot_lock);
+
+    pas_system_mutex_lock(&request_lock);
+    is_done = true;
+    pas_system_condition_broadcast(&request_cond);
+    pas_system_mutex_unlock(&request_lock);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
+
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef FILC_HEAP_SNAPSHOT_H
+#define FILC_HEAP_SNAPSHOT_H
+
+#include "filc_runtime.h"
+
+/* This writes snapshots of the object graph for offline analysis, like finding the retention paths
+   behind memory bloat. Asking for a snapshot (zgc_write_heap_snapshot) makes the next full
+   collection cycle record every object that its markers scan, along with that object's outgoing
+   ptrs, as it scans it. So the snapshot costs one concurrent GC cycle plus the writing. The world
+   is never stopped for it. In generational mode, a pending snapshot makes the sweep before it
+   non-sticky, so that the cycle it gets recorded in is full.
+
+   The format is line-oriented text, so that it can be written as we go and read with a streaming
+   parser. Ids are object addresses in hex. Sizes are payload sizes in decimal. Lines are:
+
+       filc heap snapshot 1
+       cycle <cycle>
+       o <id> <size> <flags> <target id>...   an object that was scanned, and what it points at
+       l <id> <size> <flags>                  an object that was pointed at but holds no ptrs
+       r <id>                                 an object that a thread's stack points at
+       s <id> <bytes>                         a live heap profiler sample standing for that many
+                                              allocated bytes (only with FILC_HEAP_PROFILE)
+       f <function>\t<file>\t<line>            a frame of the preceding sample's allocation site,
+                                              innermost first
+       end <objects> <leaves> <edges>
+
+   Flags are the filc_object_flags in hex, so globals and stack objects can be told apart from heap
+   objects. The same id may show up in more than one o, l or r line. That happens for leaves with
+   many referrers, and for stack objects, which get scanned each time their frame is. Readers
+   should merge such lines. Since marking is concurrent, each object's edges are what it held when
+   it got scanned. Objects allocated during the cycle are allocated black rather than scanned, so
+   they may show up as edge targets but never get their own o line. */
+
+PAS_API extern bool filc_heap_snapshot_is_recording;
+
+PAS_API void filc_heap_snapshot_initialize(void);
+
+/* Asks for a snapshot to be written to fd, and waits for it. Returns false and sets errno if
+   writing failed. Must be called with the filc_thread exited. */
+PAS_API bool filc_heap_snapshot_write(int fd);
+
+/* Called by FUGC right before it starts marking. If a snapshot is pending and the cycle is full,
+   then this starts recording. */
+PAS_API void filc_heap_snapshot_start_cycle(uint64_t cycle, bool is_full);
+
+/* Called by FUGC once marking is done, before destructing. */
+PAS_API void filc_heap_snapshot_finish_cycle(void);
+
+PAS_API bool filc_heap_snapshot_is_pending(void);
+
+PAS_API void filc_heap_snapshot_record_object(filc_object* object);
+PAS_API void filc_heap_snapshot_record_root(filc_object* object);
+
+#endif /* FILC_HEAP_SNAPSHOT_H */
+
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_memory_pressure.h"
+
+#include "pas_scavenger.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+#define CGROUP_DIR_SIZE 512
+#define POLL_TIMEOUT_MILLISECONDS 1000
+#define HIGH_PRESSURE_HOLD_MILLISECONDS 5000.
+#define PSI_WINDOW_USEC 2000000u
+
+static bool is_enabled;
+static bool is_monitoring;
+static unsigned stall_usec;
+static char cgroup_dir[CGROUP_DIR_SIZE];
+static const char* psi_path;
+static int psi_fd = -1;
+static int events_fd = -1;
+static uint64_t last_high_count;
+static double high_pressure_until;
+
+/* Held by the monitor thread while it's reacting to an event, so that fork() doesn't catch it
+   holding the scavenger's lock. */
+static pas_system_mutex monitor_lock;
+
+static bool read_fd(int fd, char* buf, size_t size)
+{
+    PAS_ASSERT(size);
+    ssize_t result;
+    do {
+        result = pread(fd, buf, size - 1, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0)
+        return false;
+    buf[result] = 0;
+    return true;
+}
+
+static bool read_file(const char* path, char* buf, size_t size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool result = read_fd(fd, buf, size);
+    close(fd);
+    return result;
+}
+
+static bool cgroup_path(char* buf, size_t size, const char* file)
+{
+    if (!cgroup_dir[0])
+        return false;
+    return (size_t)snprintf(buf, size, "%s/%s", cgroup_dir, file) < size;
+}
+
+static void find_cgroup_dir(void)
+{
+    char buf[CGROUP_DIR_SIZE];
+    if (!read_file("/proc/self/cgroup", buf, sizeof(buf)))
+        return;
+
+    /* On cgroup v2, there is a line like "0::/some/path". */
+    char* line = buf;
+    for (;;) {
+        char* end = strchr(line, '\n');
+        if (end)
+            *end = 0;
+        if (!strncmp(line, "0::", 3)) {
+            const char* path = line + 3;
+            if (!strcmp(path, "/"))
+                path = "";
+            if ((size_t)snprintf(cgroup_dir, sizeof(cgroup_dir), "/sys/fs/cgroup%s", path)
+                >= sizeof(cgroup_dir))
+                cgroup_dir[0] = 0;
+            return;
+        }
+        if (!end)
+            return;
+        line = end + 1;
+    }
+}
+
+static int open_psi_trigger(const char* path)
+{
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    char trigger[64];
+    int length = snprintf(trigger, sizeof(trigger), "some %u %u", stall_usec, PSI_WINDOW_USEC);
+    PAS_ASSERT(length > 0 && (size_t)length < sizeof(trigger));
+    if (write(fd, trigger, (size_t)length + 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void open_psi(void)
+{
+    static char cgroup_psi_path[CGROUP_DIR_SIZE];
+    if (cgroup_path(cgroup_psi_path, sizeof(cgroup_psi_path), "memory.pressure")) {
+        psi_fd = open_psi_trigger(cgroup_psi_path);
+        if (psi_fd >= 0) {
+            psi_path = cgroup_psi_path;
+            return;
+        }
+    }
+    psi_fd = open_psi_trigger("/proc/pressure/memory");
+    if (psi_fd >= 0)
+        psi_path = "/proc/pressure/memory";
+}
+
+static bool read_high_count(uint64_t* result)
+{
+    char buf[512];
+    if (!read_fd(events_fd, buf, sizeof(buf)))
+        return false;
+    char* line = strstr(buf, "high ");
+    if (!line || (line != buf && line[-1] != '\n'))
+        return false;
+    unsigned long long count;
+    if (sscanf(line + 5, "%llu", &count) != 1)
+        return false;
+    *result = count;
+    return true;
+}
+
+static void open_events(void)
+{
+    char path[CGROUP_DIR_SIZE];
+    if (!cgroup_path(path, sizeof(path), "memory.events"))
+        return;
+    events_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (events_fd < 0)
+        return;
+    /* Reading the file is also what rearms the notification. */
+    if (!read_high_count(&last_high_count)) {
+        close(events_fd);
+        events_fd = -1;
+    }
+}
+
+static bool read_cgroup_number(const char* file, uint64_t* result)
+{
+    char path[CGROUP_DIR_SIZE];
+    char buf[64];
+    unsigned long long value;
+    if (!cgroup_path(path, sizeof(path), file) || !read_file(path, buf, sizeof(buf)))
+        return false;
+    if (sscanf(buf, "%llu", &value) != 1)
+        return false; /* This includes memory.max being "max". */
+    *result = value;
+    return true;
+}
+
+static bool read_meminfo_field(const char* buf, const char* name, uint64_t* result)
+{
+    const char* field = strstr(buf, name);
+    unsigned long long value;
+    if (!field || sscanf(field + strlen(name), " %llu", &value) != 1)
+        return false;
+    *result = value * 1024;
+    return true;
+}
+
+static bool memory_is_plentiful(void)
+{
+    uint64_t limit;
+    uint64_t current;
+    if (read_cgroup_number("memory.high", &limit) || read_cgroup_number("memory.max", &limit)) {
+        if (!read_cgroup_number("memory.current", &current))
+            return false;
+        return current < limit / 2;
+    }
+
+    char buf[4096];
+    uint64_t total;
+    uint64_t available;
+    if (!read_file("/proc/meminfo", buf, sizeof(buf))
+        || !read_meminfo_field(buf, "MemTotal:", &total)
+        || !read_meminfo_field(buf, "MemAvailable:", &available))
+        return false;
+    return available > total / 2;
+}
+
+static void handle_events(short psi_revents, short events_revents)
+{
+    double now = pas_get_time_in_milliseconds();
+
+    if (psi_revents & POLLPRI)
+        high_pressure_until = now + HIGH_PRESSURE_HOLD_MILLISECONDS;
+    if (psi_revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        /* The trigger went away, which happens if our cgroup got deleted. */
+        close(psi_fd);
+        psi_fd = -1;
+    }
+
+    if (events_revents & (POLLPRI | POLLERR)) {
+        uint64_t count;
+        if (read_high_count(&count)) {
+            if (count > last_high_count)
+                high_pressure_until = now + HIGH_PRESSURE_HOLD_MILLISECONDS;
+            last_high_count = count;
+        }
+    }
+
+    pas_scavenger_memory_pressure pressure;
+    if (now < high_pressure_until)
+        pressure = pas_scavenger_high_memory_pressure;
+    else if (memory_is_plentiful())
+        pressure = pas_scavenger_low_memory_pressure;
+    else
+        pressure = pas_scavenger_normal_memory_pressure;
+    pas_scavenger_set_memory_pressure(pressure);
+}
+
+static pas_thread_return_type monitor_thread(void* arg)
+{
+    PAS_ASSERT(!arg);
+
+    for (;;) {
+        struct pollfd fds[2];
+        nfds_t num_fds = 0;
+        int psi_index = -1;
+        int events_index = -1;
+
+        if (psi_fd >= 0) {
+            psi_index = (int)num_fds++;
+            fds[psi_index].fd = psi_fd;
+            fds[psi_index].events = POLLPRI;
+            fds[psi_index].revents = 0;
+        }
+        if (events_fd >= 0) {
+            events_index = (int)num_fds++;
+            fds[events_index].fd = events_fd;
+            fds[events_index].events = POLLPRI;
+            fds[events_index].revents = 0;
+        }
+
+        /* Even if we have nothing to poll, this still gets us a periodic check of whether memory
+           is plentiful. */
+        int result = poll(fds, num_fds, POLL_TIMEOUT_MILLISECONDS);
+        if (result < 0 && errno != EINTR)
+            pas_panic("filc memory pressure: poll failed: %s\n", strerror(errno));
+
+        pas_system_mutex_lock(&monitor_lock);
+        handle_events(result > 0 && psi_index >= 0 ? fds[psi_index].revents : 0,
+                      result > 0 && events_index >= 0 ? fds[events_index].revents : 0);
+        pas_system_mutex_unlock(&monitor_lock);
+    }
+
+    return PAS_THREAD_RETURN_VALUE;
+}
+
+void filc_memory_pressure_initialize(void)
+{
+    pas_system_mutex_construct(&monitor_lock);
+
+    is_enabled = filc_get_bool_env("FILC_MEMORY_PRESSURE", false);
+    if (!is_enabled)
+        return;
+    stall_usec = filc_get_unsigned_env("FILC_MEMORY_PRESSURE_STALL_USEC", 150000);
+    if (!stall_usec || stall_usec >= PSI_WINDOW_USEC)
+        pas_panic("invalid environment variable FILC_MEMORY_PRESSURE_STALL_USEC value: %u "
+                  "(expected more than 0 and less than %u)\n", stall_usec, PSI_WINDOW_USEC);
+
+    find_cgroup_dir();
+    open_psi();
+    open_events();
+    is_monitoring = true;
+
+    sigset_t fullset;
+    pas_reasonably_fill_sigset(&fullset);
+    sigset_t oldset;
+    PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &oldset));
+    pas_create_detached_thread(monitor_thread, NULL);
+    PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
+}
+
+void filc_memory_pressure_did_finish_collection(void)
+{
+    if (pas_scavenger_current_memory_pressure == pas_scavenger_high_memory_pressure)
+        pas_scavenger_decommit_free_memory();
+}
+
+void filc_memory_pressure_suspend(void)
+{
+    pas_system_mutex_lock(&monitor_lock);
+}
+
+void filc_memory_pressure_resume(void)
+{
+    pas_system_mutex_unlock(&monitor_lock);
+}
+
+void filc_memory_pressure_did_fork_child(void)
+{
+    if (!is_monitoring)
+        return;
+    is_monitoring = false;
+    pas_scavenger_current_memory_pressure = pas_scavenger_normal_memory_pressure;
+}
+
+void filc_memory_pressure_dump_setup(void)
+{
+    if (!is_enabled) {
+        pas_log("    memory pressure: off\n");
+        return;
+    }
+    pas_log("    memory pressure: psi %s (%u usec stall), memory.high events %s\n",
+            psi_path ? psi_path : "unavailable", stall_usec, events_fd >= 0 ? "on" : "unavailable");
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
+
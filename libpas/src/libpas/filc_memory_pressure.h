@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_MEMORY_PRESSURE_H
+#define FILC_MEMORY_PRESSURE_H
+
+#include "filc_runtime.h"
+
+/* This watches for memory pressure and tells the scavenger about it. It's enabled by setting
+   FILC_MEMORY_PRESSURE=1.
+   
+   The monitor thread listens for PSI memory stall notifications (from our cgroup's memory.pressure
+   if we are in one, or from /proc/pressure/memory otherwise) and for our cgroup's memory.high
+   events. Either one puts the scavenger into high pressure mode for a while, during which it
+   decommits free pages eagerly and FUGC decommits whatever it freed at the end of each cycle. When
+   things are quiet and more than half of our memory limit (or of the machine's memory, if we have
+   no limit) is available, the scavenger backs off into low pressure mode.
+   
+   FILC_MEMORY_PRESSURE_STALL_USEC (default 150000) is how much stall time, within a two second
+   window, counts as pressure. */
+
+PAS_API void filc_memory_pressure_initialize(void);
+
+/* Called by FUGC once a cycle has swept, so that freed pages can go back to the OS right away. */
+PAS_API void filc_memory_pressure_did_finish_collection(void);
+
+/* Needed for fork(). The child doesn't get a monitor thread, so it goes back to normal pressure. */
+PAS_API void filc_memory_pressure_suspend(void);
+PAS_API void filc_memory_pressure_resume(void);
+PAS_API void filc_memory_pressure_did_fork_child(void);
+
+PAS_API void filc_memory_pressure_dump_setup(void);
+
+#endif /* FILC_MEMORY_PRESSURE_H */
+
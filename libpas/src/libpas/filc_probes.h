@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef FILC_PROBES_H
+#define FILC_PROBES_H
+
+#include "pas_utils.h"
+
+/* USDT probes for tracing the runtime and the collector with bpftrace, perf, or SystemTap. For
+   example, this shows how long soft handshakes take, if $LIB is the path to libpizlo.so:
+
+       bpftrace -e "usdt:$LIB:filc:soft_handshake_start { @t = nsecs; }
+                    usdt:$LIB:filc:soft_handshake_end { @us = hist((nsecs - @t) / 1000); }"
+
+   A probe is a nop in the code plus a note in the .note.stapsdt section that tells the tracer where
+   the nop is and where to find the arguments, so probes cost nothing when nothing is attached.
+   Arguments must be integers or pointers, and they must be cheap to compute, since the compiler
+   has to materialize them whether or not anyone is tracing.
+
+   The probes compile to nothing if <sys/sdt.h> is not available (it comes from systemtap-sdt-dev or
+   systemtap-sdt-devel) or if FILC_DISABLE_PROBES is defined. */
+
+#if PAS_OS(LINUX) && defined(__has_include) && !defined(FILC_DISABLE_PROBES)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define FILC_HAVE_PROBES 1
+#endif
+#endif
+
+#ifndef FILC_HAVE_PROBES
+#define FILC_HAVE_PROBES 0
+#endif
+
+#if FILC_HAVE_PROBES
+#define FILC_PROBE0(name) DTRACE_PROBE(filc, name)
+#define FILC_PROBE1(name, a) DTRACE_PROBE1(filc, name, a)
+#define FILC_PROBE2(name, a, b) DTRACE_PROBE2(filc, name, a, b)
+#define FILC_PROBE3(name, a, b, c) DTRACE_PROBE3(filc, name, a, b, c)
+#define FILC_PROBE4(name, a, b, c, d) DTRACE_PROBE4(filc, name, a, b, c, d)
+#else /* FILC_HAVE_PROBES -> so !FILC_HAVE_PROBES */
+#define FILC_PROBE0(name) do { } while (false)
+#define FILC_PROBE1(name, a) do { } while (false)
+#define FILC_PROBE2(name, a, b) do { } while (false)
+#define FILC_PROBE3(name, a, b, c) do { } while (false)
+#define FILC_PROBE4(name, a, b, c, d) do { } while (false)
+#endif /* FILC_HAVE_PROBES -> so end of !FILC_HAVE_PROBES */
+
+#endif /* FILC_PROBES_H */
+
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_profiler.h"
+
+#include "bmalloc_heap.h"
+#include "pas_string_stream.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+static const char* profile_path;
+static unsigned interval_usec;
+static int profile_fd = -1;
+
+/* Held by the profiler thread for the duration of each sample, so that fork() can keep it from
+   starting a soft handshake. */
+static pas_system_mutex profiler_lock;
+
+/* Samples get formatted into here by whichever thread answers the handshake, and then get written
+   out by the profiler thread. */
+static pas_lock samples_lock = PAS_LOCK_INITIALIZER;
+static pas_string_stream samples;
+static double sample_time;
+
+static void dump_origin(const filc_origin* origin, pas_stream* stream)
+{
+    if (!origin) {
+        pas_stream_printf(stream, "\t0 <null origin> ([unknown])\n");
+        return;
+    }
+    for (; origin; origin = filc_origin_next_inline(origin)) {
+        const filc_origin_node* node = origin->origin_node;
+        PAS_ASSERT(node);
+        pas_stream_printf(stream, "\t0 %s (%s:%u)\n",
+                          node->function ? node->function : "<somewhere>",
+                          node->filename ? node->filename : "<somewhere>",
+                          origin->line);
+    }
+}
+
+static void sample_callback(filc_thread* thread, void* arg)
+{
+    PAS_ASSERT(!arg);
+
+    /* If we're running on the sampled thread, then it was entered and got here from a pollcheck or
+       from an enter/exit transition. Otherwise, the profiler thread is running this for a thread
+       that is exited. */
+    bool is_exited = thread != filc_get_my_thread();
+
+    /* Threads that haven't started running pizlonated code yet have nothing to report. */
+    if (!thread->top_frame)
+        return;
+
+    pas_lock_lock(&samples_lock);
+    pas_string_stream_printf(&samples, "filc %d/%u %.6f: 1 cpu-clock:\n",
+                             pas_getpid(), thread->tid, sample_time / 1000.);
+    if (is_exited)
+        pas_string_stream_printf(&samples, "\t0 [exited] ([native])\n");
+    filc_frame* frame;
+    for (frame = thread->top_frame; frame; frame = frame->parent)
+        dump_origin(frame->origin, &samples.base);
+    pas_string_stream_printf(&samples, "\n");
+    pas_lock_unlock(&samples_lock);
+}
+
+static void flush_samples(void)
+{
+    pas_lock_lock(&samples_lock);
+    const char* buffer = pas_string_stream_get_string(&samples);
+    size_t size = pas_string_stream_get_string_length(&samples);
+    while (size) {
+        ssize_t result = write(profile_fd, buffer, size);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            pas_log("filc profiler: failed to write to %s: %s\n", profile_path, strerror(errno));
+            break;
+        }
+        buffer += result;
+        size -= result;
+    }
+    pas_string_stream_reset(&samples);
+    pas_lock_unlock(&samples_lock);
+}
+
+static pas_thread_return_type profiler_thread(void* arg)
+{
+    PAS_ASSERT(!arg);
+
+    double interval = (double)interval_usec / 1000.;
+    double next_sample = pas_get_time_in_milliseconds();
+    for (;;) {
+        next_sample += interval;
+        double now = pas_get_time_in_milliseconds();
+        if (now < next_sample)
+            usleep((useconds_t)((next_sample - now) * 1000.));
+        else
+            next_sample = now;
+
+        pas_system_mutex_lock(&profiler_lock);
+        sample_time = pas_get_time_in_milliseconds();
+        filc_soft_handshake(sample_callback, NULL);
+        flush_samples();
+        pas_system_mutex_unlock(&profiler_lock);
+    }
+
+    return PAS_THREAD_RETURN_VALUE;
+}
+
+void filc_profiler_initialize(void)
+{
+    pas_system_mutex_construct(&profiler_lock);
+
+    profile_path = getenv("FILC_PROFILE");
+    if (!profile_path || !*profile_path) {
+        profile_path = NULL;
+        return;
+    }
+    interval_usec = pas_max_uint32(filc_get_unsigned_env("FILC_PROFILE_INTERVAL_USEC", 10000), 1);
+
+    profile_fd = open(profile_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (profile_fd < 0) {
+        pas_log("filc profiler: failed to open %s: %s\n", profile_path, strerror(errno));
+        profile_path = NULL;
+        return;
+    }
+
+    pas_allocation_config allocation_config;
+    bmalloc_initialize_allocation_config(&allocation_config);
+    pas_string_stream_construct(&samples, &allocation_config);
+
+    sigset_t fullset;
+    pas_reasonably_fill_sigset(&fullset);
+    sigset_t oldset;
+    PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &oldset));
+    pas_create_detached_thread(profiler_thread, NULL);
+    PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
+}
+
+void filc_profiler_suspend(void)
+{
+    pas_system_mutex_lock(&profiler_lock);
+}
+
+void filc_profiler_resume(void)
+{
+    pas_system_mutex_unlock(&profiler_lock);
+}
+
+void filc_profiler_dump_setup(void)
+{
+    if (!profile_path) {
+        pas_log("    profiler: off\n");
+        return;
+    }
+    pas_log("    profiler: writing to %s every %u usec\n", profile_path, interval_usec);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
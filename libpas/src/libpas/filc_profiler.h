@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_PROFILER_H
+#define FILC_PROFILER_H
+
+#include "filc_runtime.h"
+
+/* This is a sampling profiler for pizlonated code. It's enabled by setting FILC_PROFILE to the path
+   of the file that the samples should go to.
+   
+   The profiler thread does a soft handshake every FILC_PROFILE_INTERVAL_USEC microseconds (default
+   10000). Entered threads answer it at their next pollcheck, so each sample is the thread's
+   filc_frame chain with the top frame's origin pointing at that pollcheck. Threads that are exited (blocked in
+   a syscall, say) get sampled by the profiler thread itself, and their samples get an "[exited]"
+   leaf frame so that they are easy to filter out.
+   
+   Samples are written in the same text format as `perf script`, so anything that consumes that
+   (like FlameGraph's stackcollapse-perf.pl) can consume them. Inline frames show up as frames of
+   their own. */
+
+PAS_API void filc_profiler_initialize(void);
+
+/* Needed for fork(), since the profiler's soft handshakes would deadlock against a stopped world.
+   The child doesn't get a profiler thread. */
+PAS_API void filc_profiler_suspend(void);
+PAS_API void filc_profiler_resume(void);
+
+PAS_API void filc_profiler_dump_setup(void);
+
+#endif /* FILC_PROFILER_H */
+
@@ -33,14 +33,36 @@
 
 #include "bmalloc_heap.h"
 #include "bmalloc_heap_config.h"
+#include "filc_alloc_trace.h"
+#include "filc_allocate_inlines.h"
+#include "filc_check_counts.h"
+#include "filc_checksum.h"
+#include "filc_crypto.h"
+#include "filc_heap_composition.h"
+#include "filc_heap_profiler.h"
+#include "filc_heap_snapshot.h"
+#include "filc_memory_pressure.h"
 #include "filc_native.h"
+#include "filc_probes.h"
+#include "filc_profiler.h"
+#include "filc_size_classes.h"
+#include "filc_startup_profiler.h"
+#include "filc_zygote.h"
 #include "fugc.h"
 #include "pas_hashtable.h"
+#include "pas_numa.h"
+#include "pas_page_malloc.h"
 #include "pas_scavenger.h"
+#include "pas_segregated_size_directory.h"
+#include "pas_snprintf.h"
+#include "pas_status_reporter.h"
 #include "pas_string_stream.h"
 #include "pas_utils.h"
 #include "verse_heap_inlines.h"
+#include "verse_heap_large_cache.h"
+#include "verse_heap_reserve.h"
 #include <ctype.h>
+#include <setjmp.h>
 #include <termios.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -70,8 +92,16 @@
 #include <sys/epoll.h>
 #include <sys/sysinfo.h>
 #include <sched.h>
+#include <spawn.h>
 #include <sys/prctl.h>
 #include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <linux/perf_event.h>
+#include <linux/fs.h>
 
 #define DEFINE_LOCK(name) \
     pas_system_mutex filc_## name ## _lock; \
@@ -103,9 +133,18 @@ pas_system_condition filc_stop_the_world_cond;
 filc_thread* filc_first_thread;
 pthread_key_t filc_thread_key;
 bool filc_is_marking;
+bool filc_store_barrier_is_on;
+uintptr_t filc_stack_scan_epoch;
+bool filc_should_assist_marking;
+size_t filc_mark_assist_budget;
+size_t filc_remembered_set_limit = SIZE_MAX;
 
 pas_heap* filc_default_heap;
 pas_heap* filc_destructor_heap;
+pas_heap* filc_mmap_heap;
+unsigned filc_num_iso_heaps = 16;
+static pas_heap** iso_heaps;
+static uintptr_t next_iso_heap_index;
 verse_heap_object_set* filc_destructor_set;
 
 const filc_object filc_free_singleton = {
@@ -116,8 +155,6 @@ const filc_object filc_free_singleton = {
                            NULL)
 };
 
-filc_object_array filc_global_variable_roots;
-
 void filc_check_user_sigset(filc_ptr ptr, filc_access_kind access_kind)
 {
     filc_check_access(ptr, sizeof(sigset_t), access_kind);
@@ -151,50 +188,20 @@ filc_thread* filc_thread_create_with_manual_tracking(void)
     pas_system_condition_construct(&thread->cond);
     filc_ptr_array_construct(&thread->allocation_roots);
     filc_object_array_construct(&thread->mark_stack);
+    thread->bytes_until_heap_sample = filc_heap_profiler_initial_countdown();
 
-    unsigned allocator_index = 0;
-    unsigned last_size = UINT_MAX;
-#define SIZE_CLASS(size) do { \
-        PAS_ASSERT(allocator_index < FILC_THREAD_NUM_ALLOCATORS); \
-        PAS_ASSERT((allocator_index << VERSE_HEAP_MIN_ALIGN_SHIFT) <= (size)); \
-        PAS_ASSERT(size); \
-        PAS_ASSERT(pas_is_aligned((size), VERSE_HEAP_MIN_ALIGN)); \
-        verse_local_allocator_construct( \
-            filc_thread_allocator(thread, allocator_index), filc_default_heap, (size), \
-            FILC_THREAD_ALLOCATOR_SIZE); \
-        last_size = (size); \
-        allocator_index++; \
-    } while (false)
-    SIZE_CLASS(16);
-    SIZE_CLASS(16);
-    SIZE_CLASS(32);
-    SIZE_CLASS(48);
-    SIZE_CLASS(64);
-    SIZE_CLASS(80);
-    SIZE_CLASS(96);
-    SIZE_CLASS(128);
-    SIZE_CLASS(128);
-    SIZE_CLASS(160);
-    SIZE_CLASS(160);
-    SIZE_CLASS(192);
-    SIZE_CLASS(192);
-    SIZE_CLASS(224);
-    SIZE_CLASS(224);
-    SIZE_CLASS(256);
-    SIZE_CLASS(256);
-    SIZE_CLASS(304);
-    SIZE_CLASS(304);
-    SIZE_CLASS(304);
-    SIZE_CLASS(352);
-    SIZE_CLASS(352);
-    SIZE_CLASS(352);
-    SIZE_CLASS(416);
-    SIZE_CLASS(416);
-    SIZE_CLASS(416);
-    SIZE_CLASS(416);
-#undef SIZE_CLASS
-    PAS_ASSERT(allocator_index == FILC_THREAD_NUM_ALLOCATORS);
-    PAS_ASSERT(last_size == FILC_THREAD_MAX_INLINE_SIZE_CLASS);
+    unsigned allocator_index;
+    for (allocator_index = 0; allocator_index < FILC_THREAD_NUM_ALLOCATORS; ++allocator_index) {
+        unsigned size = filc_size_class_table[allocator_index];
+        PAS_ASSERT((allocator_index << VERSE_HEAP_MIN_ALIGN_SHIFT) <= size);
+        PAS_ASSERT(size);
+        PAS_ASSERT(pas_is_aligned(size, VERSE_HEAP_MIN_ALIGN));
+        verse_local_allocator_construct(
+            filc_thread_allocator(thread, allocator_index), filc_default_heap, size,
+            FILC_THREAD_ALLOCATOR_SIZE);
+    }
+    PAS_ASSERT(filc_size_class_table[FILC_THREAD_NUM_ALLOCATORS - 1]
+               == FILC_THREAD_MAX_INLINE_SIZE_CLASS);
 
     /* The rest of the fields are initialized to zero already. */
 
@@ -299,13 +306,21 @@ static bool exit_on_panic = false;
 static bool dump_errnos = false;
 static bool run_global_ctors = true;
 static bool run_global_dtors = true;
+static unsigned thread_pool_size = 8;
+static unsigned ttsp_warn_ms = 0; /* Zero means don't measure time to safepoint. */
+static filc_thread_pool_entry* first_pooled_thread; /* protected by the thread_pool_lock. */
+static unsigned num_pooled_threads; /* protected by the thread_pool_lock. */
+/* Parked threads broadcast this when they answer a claim. Used with the thread_pool_lock. */
+static pas_system_condition thread_pool_claim_cond;
+
+/* The compiler relies on this slack: runtime calls and small functions that don't call (see
+   needsStackOverflowCheck() in FilPizlonator) run below the limit without checking it. */
+static const size_t stack_slack = 32768;
 
 static void set_stack_limit(filc_thread* thread)
 {
     static const bool verbose = false;
     
-    static const size_t stack_slack = 32768;
-    
     char* stack = (char*)pthread_getstack_yolo(pthread_self());
     size_t stack_size = pthread_getstacksize_yolo(pthread_self());
 
@@ -322,6 +337,20 @@ static void set_stack_limit(filc_thread* thread)
     thread->stack_limit = stack - stack_size + stack_slack;
 }
 
+static pas_huge_page_mode get_huge_page_mode_env(void)
+{
+    char* value = getenv("FILC_HUGE_PAGES");
+    if (!value || !strcasecmp(value, "none") || !strcmp(value, "0"))
+        return pas_no_huge_pages;
+    if (!strcasecmp(value, "thp"))
+        return pas_transparent_huge_pages;
+    if (!strcasecmp(value, "hugetlb"))
+        return pas_hugetlb_huge_pages;
+    pas_panic("invalid environment variable FILC_HUGE_PAGES value: %s (expected none, thp, or "
+              "hugetlb)\n", value);
+    return pas_no_huge_pages;
+}
+
 void filc_initialize(void)
 {
     PAS_ASSERT(!is_initialized);
@@ -347,6 +376,8 @@ void filc_initialize(void)
     PAS_ASSERT(FILC_OBJECT_FLAG_GLOBAL_AUX == 16);
     PAS_ASSERT(FILC_OBJECT_FLAGS_SPECIAL_SHIFT == 5);
     PAS_ASSERT(FILC_OBJECT_FLAGS_ALIGN_SHIFT == 9);
+    PAS_ASSERT(FILC_OBJECT_FLAG_STACK == 16384);
+    PAS_ASSERT(FILC_OBJECT_FLAG_INLINE_AUX == 32768);
     PAS_ASSERT(FILC_ATOMIC_BOX_BIT == 1);
     PAS_ASSERT(FILC_NUM_UNWIND_REGISTERS == 2);
     PAS_ASSERT(FILC_CC_INLINE_SIZE == 256);
@@ -358,14 +389,60 @@ void filc_initialize(void)
 #undef INITIALIZE_LOCK
 
     pas_system_condition_construct(&filc_stop_the_world_cond);
+    pas_system_condition_construct(&thread_pool_claim_cond);
+
+    /* This has to happen before the heaps start reserving memory. */
+    pas_page_malloc_huge_page_mode = get_huge_page_mode_env();
+    pas_page_malloc_decommit_lazily = filc_get_bool_env("FILC_LAZY_DECOMMIT", false);
+
+    /* This has to happen before the first refill, so that the refill counts cover the whole run. */
+    if (getenv("FILC_STATUS_JSON_FD")) {
+        pas_status_reporter_json_fd = (int)filc_get_unsigned_env("FILC_STATUS_JSON_FD", 0);
+        pas_segregated_size_directory_count_refills = true;
+    }
+    pas_status_reporter_period_in_milliseconds = filc_get_unsigned_env(
+        "FILC_STATUS_PERIOD_MS", pas_status_reporter_period_in_milliseconds);
+
+    verse_heap_large_cache_max_bytes = filc_get_size_env(
+        "FILC_LARGE_CACHE_BYTES", verse_heap_large_cache_max_bytes);
+    verse_heap_reserve_slack_bytes = filc_get_size_env(
+        "FILC_HEAP_RESERVE_SLACK", verse_heap_reserve_slack_bytes);
 
     filc_default_heap = verse_heap_create(1, 0, 0);
     filc_destructor_heap = verse_heap_create(1, 0, 0);
+    filc_mmap_heap = verse_heap_create(1, 0, 0);
+    filc_num_iso_heaps = filc_get_unsigned_env("FILC_ISO_HEAPS", filc_num_iso_heaps);
+    if (filc_num_iso_heaps) {
+        unsigned iso_heap_index;
+        iso_heaps = (pas_heap**)pas_immortal_heap_allocate(
+            sizeof(pas_heap*) * filc_num_iso_heaps, "filc_iso_heaps", pas_object_allocation);
+        for (iso_heap_index = 0; iso_heap_index < filc_num_iso_heaps; ++iso_heap_index)
+            iso_heaps[iso_heap_index] = verse_heap_create(1, 0, 0);
+    }
     filc_destructor_set = verse_heap_object_set_create();
     verse_heap_add_to_set(filc_destructor_heap, filc_destructor_set);
+    /* Mmap objects need destructing, so that they get mapped back to heap memory when they die. The
+       object is just a placeholder for the mapping, so it shouldn't make the GC run any sooner than
+       the mapping itself would. Otherwise, mapping a big file would trigger a collection. */
+    verse_heap_add_to_set(filc_mmap_heap, filc_destructor_set);
+    verse_heap_set_large_objects_are_uncounted(filc_mmap_heap);
     verse_heap_did_become_ready_for_allocation();
 
-    filc_object_array_construct(&filc_global_variable_roots);
+    /* This has to happen before we create any threads, since they start their heap sample countdown
+       when they are created. */
+    filc_heap_profiler_initialize();
+    filc_heap_snapshot_initialize();
+    filc_heap_composition_initialize();
+    filc_alloc_trace_initialize();
+    filc_check_counts_initialize();
+
+    /* And this has to happen before we create any threads, since they construct their local
+       allocators from the table. */
+    filc_size_classes_initialize();
+
+    /* This has to happen before anything allocates out of the default heap, or else the hot slots
+       would not be first. Creating the first thread allocates. */
+    filc_size_classes_reserve_hot_slots();
 
     filc_thread* thread = filc_thread_create_with_manual_tracking();
     thread->has_started = true;
@@ -380,12 +457,24 @@ void filc_initialize(void)
     set_stack_limit(thread);
 
     /* This has to happen *after* we do our primordial allocations. */
+    double fugc_initialize_start_time = filc_startup_phase_begin();
     fugc_initialize();
+    filc_startup_phase_end(filc_startup_phase_fugc_initialize, fugc_initialize_start_time, NULL);
+
+    /* The profiler does soft handshakes, so it needs the thread list to be ready. */
+    filc_profiler_initialize();
+
+    filc_memory_pressure_initialize();
 
     exit_on_panic = filc_get_bool_env("FILC_EXIT_ON_PANIC", false);
     dump_errnos = filc_get_bool_env("FILC_DUMP_ERRNOS", false);
     run_global_ctors = filc_get_bool_env("FILC_RUN_GLOBAL_CTORS", true);
     run_global_dtors = filc_get_bool_env("FILC_RUN_GLOBAL_DTORS", true);
+    thread_pool_size = filc_get_unsigned_env("FILC_THREAD_POOL_SIZE", thread_pool_size);
+    ttsp_warn_ms = filc_get_unsigned_env("FILC_TTSP_WARN_MS", ttsp_warn_ms);
+    bool numa_requested = filc_get_bool_env("FILC_NUMA", false);
+    if (numa_requested)
+        pas_numa_enable_local_page_preference();
     
     if (filc_get_bool_env("FILC_DUMP_SETUP", false)) {
         pas_log("filc setup:\n");
@@ -394,7 +483,34 @@ void filc_initialize(void)
         pas_log("    dump errnos: %s\n", dump_errnos ? "yes" : "no");
         pas_log("    run global ctors: %s\n", run_global_ctors ? "yes" : "no");
         pas_log("    run global dtors: %s\n", run_global_dtors ? "yes" : "no");
+        pas_log("    thread pool size: %u\n", thread_pool_size);
+        if (ttsp_warn_ms)
+            pas_log("    ttsp warn: %u ms\n", ttsp_warn_ms);
+        else
+            pas_log("    ttsp warn: off\n");
+        pas_log("    huge pages: %s\n",
+                pas_huge_page_mode_get_string(pas_page_malloc_huge_page_mode));
+        pas_log("    lazy decommit: %s\n", pas_page_malloc_decommit_lazily ? "yes" : "no");
+        pas_log("    large cache bytes: %zu\n", verse_heap_large_cache_max_bytes);
+        pas_log("    heap reserve slack: %zu\n", verse_heap_reserve_slack_bytes);
+        pas_log("    iso heaps: %u\n", filc_num_iso_heaps);
+        if (pas_status_reporter_json_fd >= 0) {
+            pas_log("    status json: fd %d every %u ms\n",
+                    pas_status_reporter_json_fd, pas_status_reporter_period_in_milliseconds);
+        } else
+            pas_log("    status json: off\n");
+        pas_log("    numa local pages: %s (requested: %s, nodes: %u)\n",
+                pas_numa_prefer_local_pages ? "yes" : "no", numa_requested ? "yes" : "no",
+                pas_numa_num_nodes());
         fugc_dump_setup();
+        filc_profiler_dump_setup();
+        filc_heap_profiler_dump_setup();
+        filc_alloc_trace_dump_setup();
+        filc_check_counts_dump_setup();
+        filc_startup_profiler_dump_setup();
+        filc_size_classes_dump_setup();
+        filc_memory_pressure_dump_setup();
+        filc_zygote_dump_setup();
     }
     
     is_initialized = true;
@@ -476,6 +592,7 @@ void filc_stop_the_world(void)
     filc_thread** threads;
     size_t num_threads;
     snapshot_threads(&threads, &num_threads);
+    FILC_PROBE1(stop_the_world_start, num_threads);
 
     size_t index;
     for (index = num_threads; index--;) {
@@ -505,6 +622,7 @@ void filc_stop_the_world(void)
         pas_system_mutex_unlock(&thread->lock);
     }
 
+    FILC_PROBE1(stop_the_world_end, num_threads);
     bmalloc_deallocate(threads);
 
     if (verbose)
@@ -569,13 +687,83 @@ void filc_wait_for_world_resumption_holding_lock(void)
         pas_system_condition_wait(&filc_stop_the_world_cond, &filc_stop_the_world_lock);
 }
 
+/* The number of threads that still have to run the callback for the current soft handshake. The
+   handshaking thread futex-waits on this, and whoever runs the last callback wakes it up. */
+static uint32_t soft_handshake_num_pending;
+
+/* The threads of the current soft handshake. Helpers claim chunks of them to run the callbacks of
+   the exited ones. It's the CHECK_CLAIMED bit that makes sure no callback runs twice, so the index
+   only has to spread the threads out among the helpers. */
+#define SOFT_HANDSHAKE_HELP_CHUNK_SIZE 16
+static filc_thread** soft_handshake_threads;
+static size_t soft_handshake_num_threads;
+static uintptr_t soft_handshake_help_index;
+
+/* When the current soft handshake was posted, if FILC_TTSP_WARN_MS is set. It's written before any
+   thread can see CHECK_REQUESTED, so a thread that sees the request can also read this. */
+static double soft_handshake_start_time;
+
+/* Called by an entered thread that is about to run its own callback, which means that it was
+   running Fil-C code (or native code that doesn't exit) while the handshake waited for it. The
+   stack we dump is where the thread was when it finally got around to a pollcheck or an exit, and
+   the loop that made it late is in there somewhere. We're entered, so our frames can't change
+   under us. */
+static void check_time_to_safepoint(filc_thread* my_thread)
+{
+    double time_to_safepoint = pas_get_time_in_milliseconds() - soft_handshake_start_time;
+    if (time_to_safepoint < (double)ttsp_warn_ms)
+        return;
+    pas_log("[%d] filc: thread %d took %.3lf ms to respond to a soft handshake (limit is %u ms), "
+            "responding at:\n",
+            pas_getpid(), (int)my_thread->tid, time_to_safepoint, ttsp_warn_ms);
+    filc_thread_dump_stack(my_thread, &pas_log_stream.base);
+}
+
+/* Called by the handshaking thread once it has waited FILC_TTSP_WARN_MS. Threads that still have a
+   request pending are the late ones. We can't look at their stacks, since they're running, but
+   they'll log their stacks themselves when they respond. */
+static void report_late_soft_handshake_responders(filc_thread** threads, size_t num_threads)
+{
+    pas_log("[%d] filc: soft handshake still waiting after %u ms for threads:",
+            pas_getpid(), ttsp_warn_ms);
+    size_t index;
+    for (index = 0; index < num_threads; ++index) {
+        filc_thread* thread = threads[index];
+        if (participates_in_handshakes(thread)
+            && (thread->state & FILC_THREAD_STATE_CHECK_REQUESTED))
+            pas_log(" %d", (int)thread->tid);
+    }
+    pas_log("\n");
+}
+
+/* Whoever sets CHECK_CLAIMED gets to run the callback, without taking the thread's lock. The thread
+   itself can claim whenever it wants to, but the handshake only claims for threads that are exited,
+   so a thread that is entered never sees a claim that isn't its own. Returns true if we claimed. */
+static bool claim_pollcheck_callback(filc_thread* thread, bool only_if_exited)
+{
+    for (;;) {
+        uint8_t old_state = thread->state;
+        if (!(old_state & FILC_THREAD_STATE_CHECK_REQUESTED)
+            || (old_state & FILC_THREAD_STATE_CHECK_CLAIMED))
+            return false;
+        if (only_if_exited && (old_state & FILC_THREAD_STATE_ENTERED))
+            return false;
+        uint8_t new_state = old_state | FILC_THREAD_STATE_CHECK_CLAIMED;
+        if (pas_compare_and_swap_uint8_weak(&thread->state, old_state, new_state))
+            return true;
+    }
+}
+
 static void run_pollcheck_callback(filc_thread* thread)
 {
     /* Worth noting that this may run either with the thread having entered, or with the thread
        having exited. It doesn't matter.
     
-       What matters is that we're holding the lock! */
+       What matters is that we claimed it! */
     PAS_ASSERT(thread->state & FILC_THREAD_STATE_CHECK_REQUESTED);
+    PAS_ASSERT(thread->state & FILC_THREAD_STATE_CHECK_CLAIMED);
+    /* The callback is posted without holding the lock, so make sure we see it. */
+    pas_fence();
     PAS_ASSERT(thread->pollcheck_callback);
     assert_participates_in_handshakes(thread);
     if (participates_in_pollchecks(thread))
@@ -585,35 +773,70 @@ static void run_pollcheck_callback(filc_thread* thread)
     for (;;) {
         uint8_t old_state = thread->state;
         PAS_ASSERT(old_state & FILC_THREAD_STATE_CHECK_REQUESTED);
-        uint8_t new_state = old_state & ~FILC_THREAD_STATE_CHECK_REQUESTED;
+        PAS_ASSERT(old_state & FILC_THREAD_STATE_CHECK_CLAIMED);
+        uint8_t new_state =
+            old_state & ~(FILC_THREAD_STATE_CHECK_REQUESTED | FILC_THREAD_STATE_CHECK_CLAIMED);
         if (pas_compare_and_swap_uint8_weak(&thread->state, old_state, new_state))
             break;
     }
     PAS_ASSERT(!(thread->state & FILC_THREAD_STATE_CHECK_REQUESTED));
     PAS_ASSERT(!thread->pollcheck_callback);
     PAS_ASSERT(!thread->pollcheck_arg);
+
+    /* This has to be the last thing we do to the handshake state, since the moment the count hits
+       zero, the next handshake may start posting. */
+    for (;;) {
+        uint32_t old_num_pending = soft_handshake_num_pending;
+        PAS_ASSERT(old_num_pending);
+        if (pas_compare_and_swap_uint32_weak(
+                &soft_handshake_num_pending, old_num_pending, old_num_pending - 1)) {
+            if (old_num_pending == 1)
+                futex_wake((volatile int*)&soft_handshake_num_pending, INT_MAX, 1);
+            break;
+        }
+    }
 }
 
-/* Returns true if the callback has run already (either because we ran it or because it ran already
-   some other way.
+static void run_pollcheck_callback_if_exited(filc_thread* thread)
+{
+    if (claim_pollcheck_callback(thread, true))
+        run_pollcheck_callback(thread);
+}
 
-   The thread's lock must be held to call this! */
-static bool run_pollcheck_callback_from_handshake(filc_thread* thread)
+/* While the deferral depth is nonzero, signal_pizlonator just counts signals instead of running
+   their handlers. This is how we keep handlers from running while we hold runtime locks, without
+   paying for two pthread_sigmask calls each time. */
+static void begin_special_signal_deferral(filc_thread* my_thread)
 {
-    if (!(thread->state & FILC_THREAD_STATE_CHECK_REQUESTED)) {
-        PAS_ASSERT(!thread->pollcheck_callback);
-        PAS_ASSERT(!thread->pollcheck_arg);
-        return true;
-    }
+    my_thread->special_signal_deferral_depth++;
+    pas_compiler_fence();
+}
 
-    PAS_ASSERT(thread->pollcheck_callback);
-    
-    if (!(thread->state & FILC_THREAD_STATE_ENTERED)) {
-        run_pollcheck_callback(thread);
-        return true;
-    }
+/* Returns true if signals got deferred and now need handling. The caller has to arrange for that by
+   calling set_deferred_signal_state() once it's entered. */
+static bool end_special_signal_deferral(filc_thread* my_thread)
+{
+    pas_compiler_fence();
+    PAS_ASSERT(my_thread->special_signal_deferral_depth);
+    if (--my_thread->special_signal_deferral_depth)
+        return false;
+    pas_compiler_fence();
+    bool result = my_thread->have_deferred_signal_special;
+    my_thread->have_deferred_signal_special = false;
+    return result;
+}
 
-    return false;
+static void set_deferred_signal_state(filc_thread* my_thread)
+{
+    for (;;) {
+        uint8_t old_state = my_thread->state;
+        PAS_ASSERT(old_state & FILC_THREAD_STATE_ENTERED);
+        if (old_state & FILC_THREAD_STATE_DEFERRED_SIGNAL)
+            break;
+        uint8_t new_state = old_state | FILC_THREAD_STATE_DEFERRED_SIGNAL;
+        if (pas_compare_and_swap_uint8_weak(&my_thread->state, old_state, new_state))
+            break;
+    }
 }
 
 void filc_soft_handshake_no_op_callback(filc_thread* my_thread, void* arg)
@@ -622,38 +845,74 @@ void filc_soft_handshake_no_op_callback(filc_thread* my_thread, void* arg)
     PAS_ASSERT(!arg);
 }
 
+void filc_soft_handshake_help(void)
+{
+    for (;;) {
+        size_t begin = pas_atomic_exchange_add_uintptr(
+            &soft_handshake_help_index, SOFT_HANDSHAKE_HELP_CHUNK_SIZE);
+        if (begin >= soft_handshake_num_threads)
+            return;
+        size_t end = pas_min_uintptr(begin + SOFT_HANDSHAKE_HELP_CHUNK_SIZE,
+                                     soft_handshake_num_threads);
+        size_t index;
+        for (index = begin; index < end; ++index) {
+            filc_thread* thread = soft_handshake_threads[index];
+            if (participates_in_handshakes(thread))
+                run_pollcheck_callback_if_exited(thread);
+        }
+    }
+}
+
 void filc_soft_handshake(void (*callback)(filc_thread* my_thread, void* arg), void* arg)
+{
+    filc_soft_handshake_with_helpers(callback, arg, NULL);
+}
+
+void filc_soft_handshake_with_helpers(
+    void (*callback)(filc_thread* my_thread, void* arg), void* arg, void (*help)(void))
 {
     static const bool verbose = false;
 
     filc_assert_my_thread_is_not_entered();
     filc_soft_handshake_lock_lock();
 
-    sigset_t fullset;
-    sigset_t oldset;
-    pas_reasonably_fill_sigset(&fullset);
-    if (verbose)
-        pas_log("%s: blocking signals\n", __PRETTY_FUNCTION__);
-    PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &oldset));
+    /* Service threads have all of our signals blocked from the start, so only a Fil-C thread needs
+       to hold off its handlers. */
+    filc_thread* my_thread = filc_get_my_thread();
+    if (my_thread) {
+        if (verbose)
+            pas_log("%s: deferring signals\n", __PRETTY_FUNCTION__);
+        begin_special_signal_deferral(my_thread);
+    }
 
     filc_thread** threads;
     size_t num_threads;
     snapshot_threads(&threads, &num_threads);
 
+    size_t index;
+    uint32_t num_pending = 0;
+    for (index = num_threads; index--;) {
+        if (participates_in_handshakes(threads[index]))
+            num_pending++;
+    }
+    PAS_ASSERT(!soft_handshake_num_pending);
+    soft_handshake_num_pending = num_pending;
+    FILC_PROBE2(soft_handshake_start, num_threads, num_pending);
+    if (ttsp_warn_ms)
+        soft_handshake_start_time = pas_get_time_in_milliseconds();
+
     /* Tell all the threads that the soft handshake is happening sort of as fast as we possibly
        can, so without calling the callback just yet. We want to maximize the window of time during
        which all threads know that they're supposed to do work for us.
     
-       It's questionable if that buys us anything. It does create this kind of situation where
-       filc_enter() has to consider the possibility of a pollcheck having been requested, which is
-       perhaps awkward. */
-    size_t index;
+       We don't need the thread's lock for this. Nobody looks at the callback until they see
+       CHECK_REQUESTED, and the previous handshake's callback was cleared before its completion was
+       counted. */
     for (index = num_threads; index--;) {
         filc_thread* thread = threads[index];
         if (!participates_in_handshakes(thread))
             continue;
 
-        pas_system_mutex_lock(&thread->lock);
         PAS_ASSERT(!thread->pollcheck_callback);
         PAS_ASSERT(!thread->pollcheck_arg);
         thread->pollcheck_callback = callback;
@@ -666,45 +925,65 @@ void filc_soft_handshake(void (*callback)(filc_thread* my_thread, void* arg), vo
             if (pas_compare_and_swap_uint8_weak(&thread->state, old_state, new_state))
                 break;
         }
-        pas_system_mutex_unlock(&thread->lock);
     }
 
-    /* Try to run any callbacks we can run ourselves. In the time it takes us to do this, the threads
-       that have to run the callbacks themselves might just end up doing it. */
-    for (index = num_threads; index--;) {
-        filc_thread* thread = threads[index];
-        if (!participates_in_handshakes(thread))
-            continue;
-        
-        pas_system_mutex_lock(&thread->lock);
-        run_pollcheck_callback_from_handshake(thread);
-        pas_system_mutex_unlock(&thread->lock);
-    }
+    /* Run the callbacks of threads that are exited ourselves, possibly with help. Threads that are
+       entered will run the callback themselves at their next pollcheck or exit, and if a thread
+       enters after we post but before we claim, then it runs the callback on its way in. None of
+       this takes a thread's lock, and we never wait on any particular thread. Helping ourselves
+       after help() returns is cheap, since by then everything has been claimed. */
+    soft_handshake_threads = threads;
+    soft_handshake_num_threads = num_threads;
+    soft_handshake_help_index = 0;
+    pas_fence();
+    if (help)
+        help();
+    filc_soft_handshake_help();
 
-    /* Now actually wait for every thread to do it. */
-    for (index = num_threads; index--;) {
-        filc_thread* thread = threads[index];
-        if (!participates_in_handshakes(thread))
+    /* Now actually wait for every thread to do it. If we're measuring time to safepoint, then the
+       first wait has a deadline, so that we can say who we're waiting for. */
+    bool should_report_late_responders = !!ttsp_warn_ms;
+    for (;;) {
+        uint32_t num_pending = soft_handshake_num_pending;
+        if (!num_pending)
+            break;
+        if (!should_report_late_responders) {
+            futex_wait((volatile int*)&soft_handshake_num_pending, (int)num_pending, 1);
             continue;
-        
-        pas_system_mutex_lock(&thread->lock);
-        while (!run_pollcheck_callback_from_handshake(thread))
-            pas_system_condition_wait(&thread->cond, &thread->lock);
-        pas_system_mutex_unlock(&thread->lock);
-    }
+        }
+        double deadline = soft_handshake_start_time + (double)ttsp_warn_ms;
+        if (pas_get_time_in_milliseconds() >= deadline) {
+            report_late_soft_handshake_responders(threads, num_threads);
+            should_report_late_responders = false;
+            continue;
+        }
+        struct timespec deadline_timespec;
+        deadline_timespec.tv_sec = (time_t)(deadline / 1000.);
+        deadline_timespec.tv_nsec =
+            (long)((deadline - (double)deadline_timespec.tv_sec * 1000.) * 1000000.);
+        if (deadline_timespec.tv_nsec >= 1000000000)
+            deadline_timespec.tv_nsec = 999999999;
+        futex_timedwait((volatile int*)&soft_handshake_num_pending, (int)num_pending,
+                        CLOCK_REALTIME, &deadline_timespec, 1);
+    }
+    FILC_PROBE1(soft_handshake_end, num_threads);
     
+    soft_handshake_threads = NULL;
+    soft_handshake_num_threads = 0;
     bmalloc_deallocate(threads);
-    if (verbose)
-        pas_log("%s: unblocking signals\n", __PRETTY_FUNCTION__);
-    PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
+    bool have_deferred_signals = false;
+    if (my_thread) {
+        if (verbose)
+            pas_log("%s: undeferring signals\n", __PRETTY_FUNCTION__);
+        have_deferred_signals = end_special_signal_deferral(my_thread);
+    }
     filc_soft_handshake_lock_unlock();
-}
 
-static void run_pollcheck_callback_if_necessary(filc_thread* my_thread)
-{
-    if (my_thread->state & FILC_THREAD_STATE_CHECK_REQUESTED) {
-        run_pollcheck_callback(my_thread);
-        pas_system_condition_broadcast(&my_thread->cond);
+    if (have_deferred_signals) {
+        /* Exiting is what runs the deferred handlers. */
+        filc_enter(my_thread);
+        set_deferred_signal_state(my_thread);
+        filc_exit(my_thread);
     }
 }
 
@@ -726,37 +1005,51 @@ void filc_enter(filc_thread* my_thread)
     PAS_ASSERT(my_thread == filc_get_my_thread());
     PAS_ASSERT(!(my_thread->state & FILC_THREAD_STATE_DEFERRED_SIGNAL));
     PAS_ASSERT(!(my_thread->state & FILC_THREAD_STATE_ENTERED));
-    
+
+    bool have_deferred_signals = false;
     for (;;) {
         uint8_t old_state = my_thread->state;
         PAS_ASSERT(!(old_state & FILC_THREAD_STATE_DEFERRED_SIGNAL));
         PAS_ASSERT(!(old_state & FILC_THREAD_STATE_ENTERED));
-        if ((old_state & (FILC_THREAD_STATE_CHECK_REQUESTED |
-                          FILC_THREAD_STATE_STOP_REQUESTED))) {
-            /* NOTE: We could avoid doing this if the ENTERED state used by signal handling
-               was separate from the ENTERED state used for all other purposes.
-            
-               Note sure it's worth it, since we would only get here for STOP (super rare) or
-               for CHECK requests that happen while we're exited (super rare since that's a
-               transient kind of state). */
-            sigset_t fullset;
-            sigset_t oldset;
-            pas_reasonably_fill_sigset(&fullset);
+        if ((old_state & FILC_THREAD_STATE_CHECK_REQUESTED)
+            && !(old_state & FILC_THREAD_STATE_STOP_REQUESTED)) {
+            if ((old_state & FILC_THREAD_STATE_CHECK_CLAIMED)) {
+                /* The handshake is running our callback for us right now. It won't take long, and
+                   we don't get to touch the heap until it's done. */
+                sched_yield();
+                continue;
+            }
+            /* Enter and claim the callback in one go, and then run it like a pollcheck would. This
+               needs neither our lock nor any signal mask changes, since signals that arrive now
+               are deferred like they would be for any entered thread. */
+            uint8_t new_state =
+                old_state | FILC_THREAD_STATE_ENTERED | FILC_THREAD_STATE_CHECK_CLAIMED;
+            if (!pas_compare_and_swap_uint8_weak(&my_thread->state, old_state, new_state))
+                continue;
+            run_pollcheck_callback(my_thread);
+            break;
+        }
+        
+        if ((old_state & FILC_THREAD_STATE_STOP_REQUESTED)) {
+            /* Signal handlers must not run while we hold our lock, since they would enter and
+               try to take it again. Any signals that arrive in the meantime get handled at our
+               next pollcheck or exit. */
             if (verbose)
-                pas_log("%s: blocking signals\n", __PRETTY_FUNCTION__);
-            PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &oldset));
+                pas_log("%s: deferring signals\n", __PRETTY_FUNCTION__);
+            begin_special_signal_deferral(my_thread);
+            fugc_lend_stopped_thread();
             pas_system_mutex_lock(&my_thread->lock);
             PAS_ASSERT(!(my_thread->state & FILC_THREAD_STATE_DEFERRED_SIGNAL));
             PAS_ASSERT(!(my_thread->state & FILC_THREAD_STATE_ENTERED));
-            run_pollcheck_callback_if_necessary(my_thread);
+            run_pollcheck_callback_if_exited(my_thread);
             while ((my_thread->state & FILC_THREAD_STATE_STOP_REQUESTED)) {
                 PAS_ASSERT(!(my_thread->state & FILC_THREAD_STATE_ENTERED));
                 pas_system_condition_wait(&my_thread->cond, &my_thread->lock);
             }
             pas_system_mutex_unlock(&my_thread->lock);
             if (verbose)
-                pas_log("%s: unblocking signals\n", __PRETTY_FUNCTION__);
-            PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
+                pas_log("%s: undeferring signals\n", __PRETTY_FUNCTION__);
+            have_deferred_signals |= end_special_signal_deferral(my_thread);
             continue;
         }
 
@@ -766,6 +1059,12 @@ void filc_enter(filc_thread* my_thread)
     }
 
     PAS_ASSERT((my_thread->state & FILC_THREAD_STATE_ENTERED));
+
+    my_thread->entered_since_cache_reclaim = true;
+    my_thread->entered_since_stack_scan = true;
+
+    if (have_deferred_signals)
+        set_deferred_signal_state(my_thread);
 }
 
 static void call_signal_handler(filc_thread* my_thread, filc_signal_handler* handler, int signum)
@@ -818,18 +1117,27 @@ static void handle_deferred_signals(filc_thread* my_thread)
             break;
     }
 
+    /* Grab all of the counts before calling any handlers, so that everything that was pending gets
+       dispatched in this one pass. Signals that arrive while the handlers run get counted again and
+       set DEFERRED_SIGNAL again, so they'll be handled at the next pollcheck or exit. The atomic
+       exchange is also our fence. */
+    uint64_t num_deferred_signals[FILC_MAX_USER_SIGNUM + 1];
     size_t index;
+    for (index = FILC_MAX_USER_SIGNUM + 1; index--;) {
+        num_deferred_signals[index] = __atomic_exchange_n(
+            my_thread->num_deferred_signals + index, 0, __ATOMIC_SEQ_CST);
+    }
+
+    /* Each handler has to run with its own mask blocked on top of the mask we had before. We only
+       change the mask when we go from one handler's mask to a different one, and we restore it once
+       at the end. That way, a storm of the same signal, or signals whose handlers share a mask,
+       costs us two pthread_sigmask calls no matter how many handlers we run. */
+    sigset_t oldset;
+    filc_signal_handler* masked_handler = NULL;
     /* I'm guessing at some point I'll actually have to care about the order here? */
     for (index = FILC_MAX_USER_SIGNUM + 1; index--;) {
-        uint64_t num_deferred_signals;
-        /* We rely on the CAS for a fence, too. */
-        for (;;) {
-            num_deferred_signals = my_thread->num_deferred_signals[index];
-            if (pas_compare_and_swap_uint64_weak(
-                    my_thread->num_deferred_signals + index, num_deferred_signals, 0))
-                break;
-        }
-        if (!num_deferred_signals)
+        uint64_t count = num_deferred_signals[index];
+        if (!count)
             continue;
 
         if (verbose)
@@ -838,18 +1146,102 @@ static void handle_deferred_signals(filc_thread* my_thread)
         /* We're a bit unsafe here because the handler object might get collected at the next exit. */
         filc_signal_handler* handler = signal_table[index];
         PAS_ASSERT(handler);
-        sigset_t oldset;
-        if (verbose)
-            pas_log("%s: blocking signals\n", __PRETTY_FUNCTION__);
-        PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &handler->mask, &oldset));
-        while (num_deferred_signals--)
+        if (!masked_handler) {
+            if (verbose)
+                pas_log("%s: blocking signals\n", __PRETTY_FUNCTION__);
+            PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &handler->mask, &oldset));
+        } else if (memcmp(&masked_handler->mask, &handler->mask, sizeof(sigset_t))) {
+            sigset_t set;
+            if (verbose)
+                pas_log("%s: switching blocked signals\n", __PRETTY_FUNCTION__);
+            PAS_ASSERT(!sigorset(&set, &oldset, &handler->mask));
+            PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &set, NULL));
+        }
+        masked_handler = handler;
+        while (count--)
             call_signal_handler(my_thread, handler, (int)index);
+    }
+
+    if (masked_handler) {
         if (verbose)
             pas_log("%s: unblocking signals\n", __PRETTY_FUNCTION__);
         PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
     }
 }
 
+static void flush_store_barrier_buffer(filc_thread* thread)
+{
+    size_t index;
+    for (index = FILC_STORE_BARRIER_BUFFER_SIZE; index--;) {
+        fugc_mark(&thread->mark_stack, thread->store_barrier_buffer[index]);
+        thread->store_barrier_buffer[index] = NULL;
+    }
+}
+
+/* Pays off the allocation debt by tracing objects off of our own mark stack, a byte of object for
+   each byte allocated. We only ever take from our own stack. A mutator that pulled work out of
+   FUGC's global stack could be holding it when the collector decides that marking is done.
+   Whatever we push here stays on our stack, and goes to the collector when the next handshake
+   makes us donate.
+
+   This runs from filc_exit() before we clear ENTERED, which is also where pollcheck callbacks
+   run. That means we don't hold any runtime locks, and nobody else can be looking at our mark
+   stack. Allocation itself could be holding locks that tracing needs (like a ptr table's), which
+   is why the allocator only asks for the assist instead of doing it. */
+static void assist_marking(filc_thread* my_thread)
+{
+    size_t debt = my_thread->mark_assist_debt;
+    my_thread->mark_assist_debt = 0;
+    if (!filc_should_assist_marking || !participates_in_pollchecks(my_thread))
+        return;
+    flush_store_barrier_buffer(my_thread);
+    filc_object* object;
+    while (debt && (object = filc_object_array_pop(&my_thread->mark_stack))) {
+        debt -= pas_min_uintptr(debt, pas_max_uintptr(filc_object_size(object), FILC_WORD_SIZE));
+        fugc_mark_outgoing_ptrs(&my_thread->mark_stack, object);
+    }
+}
+
+static void charge_mark_assist(filc_thread* my_thread, size_t bytes)
+{
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
+    my_thread->mark_assist_debt += bytes;
+    if (my_thread->mark_assist_debt < filc_mark_assist_budget)
+        return;
+    /* With nothing on our stack, there's nothing that we could do to help. */
+    if (!my_thread->mark_stack.num_objects) {
+        my_thread->mark_assist_debt = 0;
+        return;
+    }
+    for (;;) {
+        uint8_t old_state = my_thread->state;
+        if ((old_state & FILC_THREAD_STATE_ASSIST_REQUESTED))
+            return;
+        uint8_t new_state = old_state | FILC_THREAD_STATE_ASSIST_REQUESTED;
+        if (pas_compare_and_swap_uint8_weak(&my_thread->state, old_state, new_state))
+            return;
+    }
+}
+
+void* filc_thread_allocate_slow(filc_thread* thread, pas_local_allocator* allocator)
+{
+    FILC_PROBE2(allocate_slow, thread, allocator->object_size);
+    void* result = verse_local_allocator_allocate(allocator);
+    if (PAS_UNLIKELY(filc_should_assist_marking))
+        charge_mark_assist(thread, (size_t)allocator->remaining + allocator->object_size);
+    return result;
+}
+
+void* filc_thread_allocate_large(filc_thread* thread, size_t size)
+{
+    FILC_PROBE2(allocate_large, thread, size);
+    void* result = verse_heap_allocate(filc_default_heap, size);
+    if (PAS_UNLIKELY(filc_should_assist_marking))
+        charge_mark_assist(thread, size);
+    return result;
+}
+
 void filc_exit(filc_thread* my_thread)
 {
     static const bool verbose = false;
@@ -867,15 +1259,23 @@ void filc_exit(filc_thread* my_thread)
         }
 
         if ((old_state & FILC_THREAD_STATE_CHECK_REQUESTED)) {
-            pas_system_mutex_lock(&my_thread->lock);
-            PAS_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
-            run_pollcheck_callback_if_necessary(my_thread);
-            pas_system_mutex_unlock(&my_thread->lock);
+            PAS_ASSERT(claim_pollcheck_callback(my_thread, false));
+            if (ttsp_warn_ms)
+                check_time_to_safepoint(my_thread);
+            run_pollcheck_callback(my_thread);
+            continue;
+        }
+
+        if ((old_state & FILC_THREAD_STATE_ASSIST_REQUESTED)) {
+            uint8_t new_state = old_state & ~FILC_THREAD_STATE_ASSIST_REQUESTED;
+            if (pas_compare_and_swap_uint8_weak(&my_thread->state, old_state, new_state))
+                assist_marking(my_thread);
             continue;
         }
 
         PAS_ASSERT(!(old_state & FILC_THREAD_STATE_DEFERRED_SIGNAL));
         PAS_ASSERT(!(old_state & FILC_THREAD_STATE_CHECK_REQUESTED));
+        PAS_ASSERT(!(old_state & FILC_THREAD_STATE_ASSIST_REQUESTED));
         uint8_t new_state = old_state & ~FILC_THREAD_STATE_ENTERED;
         if (pas_compare_and_swap_uint8_weak(&my_thread->state, old_state, new_state))
             break;
@@ -936,69 +1336,139 @@ void filc_ptr_array_add(filc_ptr_array* array, void* ptr)
     array->array[array->size++] = ptr;
 }
 
-PAS_NEVER_INLINE static void enlarge_array(filc_object_array* array, size_t anticipated_size)
+/* This is enough to cover the mark stacks of a bunch of threads and a collector, without holding on
+   to everything after a GC that needed a deep mark stack. */
+#define MAX_NUM_POOLED_OBJECT_ARRAY_CHUNKS 256
+
+static pas_lock object_array_chunk_pool_lock = PAS_LOCK_INITIALIZER;
+/* Protected by the object_array_chunk_pool_lock. */
+static filc_object_array_chunk* first_pooled_object_array_chunk;
+static size_t num_pooled_object_array_chunks;
+
+static filc_object_array_chunk* allocate_object_array_chunk(void)
 {
-    PAS_ASSERT(anticipated_size > array->objects_capacity);
-    
-    filc_object** new_objects;
-    size_t new_objects_capacity;
-    PAS_ASSERT(!pas_mul_uintptr_overflow(anticipated_size, 3, &new_objects_capacity));
-    new_objects_capacity /= 2;
-    PAS_ASSERT(new_objects_capacity > array->objects_capacity);
-    PAS_ASSERT(new_objects_capacity >= anticipated_size);
-    size_t total_size;
-    PAS_ASSERT(!pas_mul_uintptr_overflow(new_objects_capacity, sizeof(filc_object*), &total_size));
-    new_objects = bmalloc_allocate(total_size);
-    memcpy(new_objects, array->objects, array->num_objects * sizeof(filc_object*));
-    bmalloc_deallocate(array->objects);
-    array->objects = new_objects;
-    array->objects_capacity = new_objects_capacity;
+    filc_object_array_chunk* result;
+    pas_lock_lock(&object_array_chunk_pool_lock);
+    result = first_pooled_object_array_chunk;
+    if (result) {
+        first_pooled_object_array_chunk = result->next;
+        num_pooled_object_array_chunks--;
+    }
+    pas_lock_unlock(&object_array_chunk_pool_lock);
+    if (!result)
+        result = bmalloc_allocate(sizeof(filc_object_array_chunk));
+    result->next = NULL;
+    result->num_objects = 0;
+    return result;
 }
 
-static void enlarge_array_if_necessary(filc_object_array* array, size_t anticipated_size)
+static void deallocate_object_array_chunk(filc_object_array_chunk* chunk)
 {
-    if (PAS_UNLIKELY(anticipated_size > array->objects_capacity))
-        enlarge_array(array, anticipated_size);
+    pas_lock_lock(&object_array_chunk_pool_lock);
+    if (num_pooled_object_array_chunks < MAX_NUM_POOLED_OBJECT_ARRAY_CHUNKS) {
+        chunk->next = first_pooled_object_array_chunk;
+        first_pooled_object_array_chunk = chunk;
+        num_pooled_object_array_chunks++;
+        chunk = NULL;
+    }
+    pas_lock_unlock(&object_array_chunk_pool_lock);
+    if (chunk)
+        bmalloc_deallocate(chunk);
+}
+
+static void object_array_push_chunk(filc_object_array* array, filc_object_array_chunk* chunk)
+{
+    PAS_ASSERT(chunk->num_objects);
+    chunk->next = array->top;
+    if (!array->top)
+        array->bottom = chunk;
+    array->top = chunk;
+    array->num_objects += chunk->num_objects;
+}
+
+static filc_object_array_chunk* object_array_take_top_chunk(filc_object_array* array)
+{
+    filc_object_array_chunk* chunk = array->top;
+    PAS_ASSERT(chunk);
+    array->top = chunk->next;
+    if (!array->top)
+        array->bottom = NULL;
+    PAS_ASSERT(array->num_objects >= chunk->num_objects);
+    array->num_objects -= chunk->num_objects;
+    chunk->next = NULL;
+    return chunk;
+}
+
+void filc_object_array_pop_chunk(filc_object_array* array)
+{
+    PAS_ASSERT(array->top);
+    PAS_ASSERT(!array->top->num_objects);
+    deallocate_object_array_chunk(object_array_take_top_chunk(array));
+}
+
+static PAS_NEVER_INLINE void object_array_push_slow(filc_object_array* array, filc_object* object)
+{
+    filc_object_array_chunk* chunk = allocate_object_array_chunk();
+    chunk->objects[chunk->num_objects++] = object;
+    object_array_push_chunk(array, chunk);
 }
 
 void filc_object_array_push(filc_object_array* array, filc_object* object)
 {
-    enlarge_array_if_necessary(array, array->num_objects + 1);
-    PAS_TESTING_ASSERT(array->num_objects < array->objects_capacity);
-    array->objects[array->num_objects++] = object;
+    filc_object_array_chunk* chunk = array->top;
+    if (PAS_UNLIKELY(!chunk || chunk->num_objects == FILC_OBJECT_ARRAY_CHUNK_CAPACITY)) {
+        object_array_push_slow(array, object);
+        return;
+    }
+    chunk->objects[chunk->num_objects++] = object;
+    array->num_objects++;
 }
 
 void filc_object_array_push_all(filc_object_array* to, filc_object_array* from)
 {
-    size_t new_num_objects;
-    PAS_ASSERT(!pas_add_uintptr_overflow(from->num_objects, to->num_objects, &new_num_objects));
-    enlarge_array_if_necessary(to, new_num_objects);
-    memcpy(to->objects + to->num_objects, from->objects, sizeof(filc_object*) * from->num_objects);
-    to->num_objects += from->num_objects;
+    filc_object_array_chunk* chunk;
+    for (chunk = from->top; chunk; chunk = chunk->next) {
+        size_t index;
+        for (index = 0; index < chunk->num_objects; ++index)
+            filc_object_array_push(to, chunk->objects[index]);
+    }
 }
 
 void filc_object_array_pop_all_from_and_push_to(filc_object_array* from, filc_object_array* to)
 {
-    if (!from->num_objects)
+    if (!from->top)
         return;
 
-    if (!to->num_objects) {
-        filc_object_array tmp;
-        tmp = *to;
-        *to = *from;
-        *from = tmp;
-        PAS_ASSERT(!from->num_objects);
-        return;
-    }
+    from->bottom->next = to->top;
+    if (!to->top)
+        to->bottom = from->bottom;
+    to->top = from->top;
+    to->num_objects += from->num_objects;
+    filc_object_array_construct(from);
+}
 
-    filc_object_array_push_all(to, from);
-    filc_object_array_reset(from);
+void filc_object_array_pop_some_from_and_push_to(filc_object_array* from,
+                                                 filc_object_array* to,
+                                                 size_t count)
+{
+    PAS_ASSERT(count <= from->num_objects);
+    /* Whole chunks move without copying. Then we copy whatever is left, which is less than a
+       chunk's worth. */
+    while (count && count >= from->top->num_objects) {
+        filc_object_array_chunk* chunk = object_array_take_top_chunk(from);
+        count -= chunk->num_objects;
+        object_array_push_chunk(to, chunk);
+    }
+    while (count--)
+        filc_object_array_push(to, filc_object_array_pop(from));
 }
 
 void filc_object_array_reset(filc_object_array* array)
 {
-    filc_object_array_destruct(array);
-    filc_object_array_construct(array);
+    while (array->top)
+        deallocate_object_array_chunk(object_array_take_top_chunk(array));
+    PAS_ASSERT(!array->num_objects);
+    PAS_ASSERT(!array->bottom);
 }
 
 static PAS_NEVER_INLINE void native_frame_enlarge(filc_native_frame* frame)
@@ -1088,6 +1558,8 @@ PAS_NEVER_INLINE void filc_pollcheck_slow(filc_thread* my_thread, const filc_ori
     if (origin && my_thread->top_frame)
         my_thread->top_frame->origin = origin;
 
+    FILC_PROBE2(pollcheck_slow, my_thread, my_thread->state);
+
     /* This could be made more efficient, but even if it was, we'd need to have an exit path for the
        STOP_REQUESTED case. */
     filc_exit(my_thread);
@@ -1113,22 +1585,32 @@ void filc_thread_stop_allocators(filc_thread* my_thread)
         verse_local_allocator_stop(filc_thread_allocator(my_thread, index));
 }
 
-void filc_thread_mark_roots(filc_thread* my_thread)
+void filc_thread_start_allocating_black(filc_thread* my_thread)
 {
-    static const bool verbose = false;
-    
     assert_participates_in_pollchecks(my_thread);
 
-    size_t index;
-    for (index = my_thread->allocation_roots.size; index--;) {
-        void* allocation_root = my_thread->allocation_roots.array[index];
-        /* Allocation roots have to have the mark bit set without being put on any mark stack, since
-           they have no outgoing references and they are not ready for scanning. */
-        verse_heap_set_is_marked_relaxed(allocation_root, true);
-    }
+    pas_thread_local_cache_node* node = my_thread->tlc_node;
+    uint64_t version = my_thread->tlc_node_version;
+    if (node && version)
+        verse_heap_thread_local_cache_node_stop_local_allocators(node, version);
+
+    unsigned index;
+    for (index = FILC_THREAD_NUM_ALLOCATORS; index--;)
+        verse_local_allocator_start_allocating_black(filc_thread_allocator(my_thread, index));
+}
+
+static void mark_frame_roots(filc_thread* my_thread, filc_frame* top_frame)
+{
+    static const bool verbose = false;
 
     filc_frame* frame;
-    for (frame = my_thread->top_frame; frame; frame = frame->parent) {
+    for (frame = top_frame; frame; frame = frame->parent) {
+        /* Everything below a frame we scanned this cycle was also scanned this cycle and hasn't
+           been the top frame since. */
+        if (frame->scan_epoch == filc_stack_scan_epoch)
+            break;
+        if (frame != top_frame)
+            frame->scan_epoch = filc_stack_scan_epoch;
         PAS_ASSERT(frame->origin);
         const filc_function_origin* function_origin = filc_origin_get_function_origin(frame->origin);
         PAS_ASSERT(function_origin);
@@ -1138,15 +1620,30 @@ void filc_thread_mark_roots(filc_thread* my_thread)
             pas_log("\n");
         }
         PAS_ASSERT(function_origin->base.num_lowers_ish < UINT_MAX);
+        size_t index;
         for (index = function_origin->base.num_lowers_ish; index--;) {
             if (verbose)
                 pas_log("Marking thread root %p\n", frame->lowers[index]);
-            fugc_mark(&my_thread->mark_stack, filc_object_for_lower(frame->lowers[index]));
+            filc_object* object = filc_object_for_lower(frame->lowers[index]);
+            if (PAS_UNLIKELY(filc_heap_snapshot_is_recording) && object)
+                filc_heap_snapshot_record_root(object);
+            /* Stack objects go away when the frame returns, so we have to scan them now rather than
+               putting them on the mark stack. It's OK to scan them here, since the thread that owns
+               the frame is either running this or is exited. */
+            if (object && (filc_object_get_flags(object) & FILC_OBJECT_FLAG_STACK)) {
+                fugc_mark_outgoing_ptrs(&my_thread->mark_stack, object);
+                continue;
+            }
+            fugc_mark(&my_thread->mark_stack, object);
         }
     }
+}
 
+static void mark_native_frame_roots(filc_thread* my_thread, filc_native_frame* top_native_frame)
+{
     filc_native_frame* native_frame;
-    for (native_frame = my_thread->top_native_frame; native_frame; native_frame = native_frame->parent) {
+    for (native_frame = top_native_frame; native_frame; native_frame = native_frame->parent) {
+        size_t index;
         for (index = native_frame->size; index--;) {
             uintptr_t encoded_ptr = native_frame->array[index];
             if ((encoded_ptr & FILC_NATIVE_FRAME_PTR_MASK) == FILC_NATIVE_FRAME_TRACKED_PTR) {
@@ -1159,6 +1656,52 @@ void filc_thread_mark_roots(filc_thread* my_thread)
             }
         }
     }
+}
+
+void filc_thread_mark_roots(filc_thread* my_thread)
+{
+    assert_participates_in_pollchecks(my_thread);
+
+    PAS_ASSERT(filc_stack_scan_epoch);
+
+    /* A thread that we scan for while it's exited keeps running after, so we can only conclude that
+       nothing changed if it hasn't entered since a scan we did on its behalf. */
+    if (my_thread != filc_get_my_thread()) {
+        if (my_thread->stack_scan_epoch == filc_stack_scan_epoch
+            && !my_thread->entered_since_stack_scan)
+            return;
+        my_thread->entered_since_stack_scan = false;
+    }
+    my_thread->stack_scan_epoch = filc_stack_scan_epoch;
+
+    size_t index;
+    for (index = my_thread->allocation_roots.size; index--;) {
+        void* allocation_root = my_thread->allocation_roots.array[index];
+        /* Allocation roots have to have the mark bit set without being put on any mark stack, since
+           they have no outgoing references and they are not ready for scanning. */
+        verse_heap_set_is_marked_relaxed(allocation_root, true);
+    }
+
+    mark_frame_roots(my_thread, my_thread->top_frame);
+    mark_native_frame_roots(my_thread, my_thread->top_native_frame);
+
+    /* Suspended fibers can only be resumed by this thread, so their frames can't change under us.
+       Their saved top frame is the one that becomes the top frame when they resume, so
+       mark_frame_roots() never gives it a scan_epoch, just like for the running stack. */
+    if (my_thread->current_fiber) {
+        fugc_mark(&my_thread->mark_stack,
+                  filc_object_for_special_payload(my_thread->current_fiber));
+        fugc_mark(&my_thread->mark_stack,
+                  filc_object_for_special_payload(my_thread->root_fiber));
+    }
+    filc_fiber* fiber;
+    for (fiber = my_thread->first_suspended_fiber; fiber; fiber = fiber->next_suspended) {
+        PAS_ASSERT(fiber->carrier == my_thread);
+        PAS_ASSERT(!fiber->is_done);
+        fugc_mark(&my_thread->mark_stack, filc_object_for_special_payload(fiber));
+        mark_frame_roots(my_thread, fiber->top_frame);
+        mark_native_frame_roots(my_thread, fiber->top_native_frame);
+    }
 
     for (index = FILC_NUM_UNWIND_REGISTERS; index--;)
         PAS_ASSERT(filc_ptr_is_totally_null(my_thread->unwind_registers[index]));
@@ -1168,12 +1711,19 @@ void filc_thread_sweep_mark_stack(filc_thread* my_thread)
 {
     assert_participates_in_pollchecks(my_thread);
 
+    /* Everything that's still buffered was barriered after marking was done, so it's all marked
+       already. */
+    flush_store_barrier_buffer(my_thread);
+
     if (my_thread->mark_stack.num_objects) {
         pas_log("Non-empty thread mark stack at start of sweep! Objects:\n");
-        size_t index;
-        for (index = 0; index < my_thread->mark_stack.num_objects; ++index) {
-            filc_object_dump(my_thread->mark_stack.objects[index], &pas_log_stream.base);
-            pas_log("\n");
+        filc_object_array_chunk* chunk;
+        for (chunk = my_thread->mark_stack.top; chunk; chunk = chunk->next) {
+            size_t index;
+            for (index = 0; index < chunk->num_objects; ++index) {
+                filc_object_dump(chunk->objects[index], &pas_log_stream.base);
+                pas_log("\n");
+            }
         }
     }
     PAS_ASSERT(!my_thread->mark_stack.num_objects);
@@ -1184,21 +1734,168 @@ void filc_thread_donate(filc_thread* my_thread)
 {
     assert_participates_in_pollchecks(my_thread);
 
+    flush_store_barrier_buffer(my_thread);
     fugc_donate(&my_thread->mark_stack);
 }
 
-void filc_mark_global_roots(filc_object_array* mark_stack)
+/* The global variable roots live in an append-only list of chunks, so that the GC can scan them
+   without taking the global_initialization_lock. Appending is done with the lock held (since it
+   happens in the middle of global initialization anyway), but the GC only needs to load
+   num_global_variable_roots with acquire to know how many of the slots are ready. Chunks are never
+   freed. */
+#define GLOBAL_ROOT_CHUNK_CAPACITY \
+    ((FILC_OBJECT_ARRAY_CHUNK_SIZE - sizeof(global_root_chunk*)) / sizeof(filc_object*))
+
+typedef struct global_root_chunk global_root_chunk;
+
+struct global_root_chunk {
+    global_root_chunk* next;
+    filc_object* objects[GLOBAL_ROOT_CHUNK_CAPACITY];
+};
+
+static global_root_chunk* first_global_root_chunk = NULL;
+/* Protected by the global_initialization_lock. */
+static global_root_chunk* last_global_root_chunk = NULL;
+static size_t num_global_variable_roots = 0;
+
+/* Only touched by the collector. */
+static size_t num_scanned_global_variable_roots = 0;
+
+static void add_global_variable_root(filc_object* object)
+{
+    filc_global_initialization_lock_assert_held();
+    size_t index = num_global_variable_roots;
+    size_t chunk_index = index % GLOBAL_ROOT_CHUNK_CAPACITY;
+    if (!chunk_index) {
+        global_root_chunk* chunk = (global_root_chunk*)bmalloc_allocate(sizeof(global_root_chunk));
+        chunk->next = NULL;
+        if (last_global_root_chunk)
+            __atomic_store_n(&last_global_root_chunk->next, chunk, __ATOMIC_RELEASE);
+        else
+            __atomic_store_n(&first_global_root_chunk, chunk, __ATOMIC_RELEASE);
+        last_global_root_chunk = chunk;
+    }
+    last_global_root_chunk->objects[chunk_index] = object;
+    __atomic_store_n(&num_global_variable_roots, index + 1, __ATOMIC_RELEASE);
+}
+
+/* The io_urings that have I/O in flight. See filc_io_uring. */
+static filc_io_uring* in_flight_io_urings = NULL;
+static pas_lock in_flight_io_urings_lock = PAS_LOCK_INITIALIZER;
+
+/* The fds of live io_urings. These belong to the runtime: if the user could close one, we'd close
+   whatever reused that fd when the ring dies, and if they could dup, mmap, or send one, they could
+   get at the rings behind our back. So the zsys calls that could do any of that refuse io_uring fds
+   with EBADF. They hold io_uring_fds_lock for reading across the syscall, while creating and
+   destroying a ring holds it for writing, so an fd can't turn into a ring fd between the check and
+   the syscall. Only ever take this lock while exited, since the holder may block in a syscall. */
+static pthread_rwlock_t io_uring_fds_lock = PTHREAD_RWLOCK_INITIALIZER;
+static int* io_uring_fds = NULL;
+static size_t num_io_uring_fds = 0;
+static size_t io_uring_fds_capacity = 0;
+
+static void lock_io_uring_fds_for_user(void)
+{
+    PAS_ASSERT(!pthread_rwlock_rdlock(&io_uring_fds_lock));
+}
+
+static void lock_io_uring_fds_for_ring(void)
+{
+    PAS_ASSERT(!pthread_rwlock_wrlock(&io_uring_fds_lock));
+}
+
+static void unlock_io_uring_fds(void)
+{
+    PAS_ASSERT(!pthread_rwlock_unlock(&io_uring_fds_lock));
+}
+
+static bool is_io_uring_fd(int fd)
+{
+    size_t index;
+    for (index = num_io_uring_fds; index--;) {
+        if (io_uring_fds[index] == fd)
+            return true;
+    }
+    return false;
+}
+
+static void add_io_uring_fd(int fd)
+{
+    PAS_ASSERT(!is_io_uring_fd(fd));
+    if (num_io_uring_fds == io_uring_fds_capacity) {
+        size_t new_capacity = pas_max_uintptr(4, io_uring_fds_capacity * 2);
+        int* new_fds = bmalloc_allocate(filc_mul_size(sizeof(int), new_capacity));
+        if (num_io_uring_fds)
+            memcpy(new_fds, io_uring_fds, sizeof(int) * num_io_uring_fds);
+        if (io_uring_fds)
+            bmalloc_deallocate(io_uring_fds);
+        io_uring_fds = new_fds;
+        io_uring_fds_capacity = new_capacity;
+    }
+    io_uring_fds[num_io_uring_fds++] = fd;
+}
+
+static void remove_io_uring_fd(int fd)
+{
+    size_t index;
+    for (index = num_io_uring_fds; index--;) {
+        if (io_uring_fds[index] == fd) {
+            io_uring_fds[index] = io_uring_fds[--num_io_uring_fds];
+            return;
+        }
+    }
+    PAS_ASSERT(!"not an io_uring fd");
+}
+
+/* Checks the SCM_RIGHTS fds in a msghdr whose control data the runtime owns. */
+static bool msghdr_passes_io_uring_fd(struct msghdr* msghdr)
+{
+    if (!num_io_uring_fds)
+        return false;
+    struct cmsghdr* cmsg;
+    for (cmsg = CMSG_FIRSTHDR(msghdr); cmsg; cmsg = CMSG_NXTHDR(msghdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len < CMSG_LEN(0))
+            continue;
+        size_t num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t index;
+        for (index = num_fds; index--;) {
+            int fd;
+            memcpy(&fd, (char*)CMSG_DATA(cmsg) + index * sizeof(int), sizeof(int));
+            if (is_io_uring_fd(fd))
+                return true;
+        }
+    }
+    return false;
+}
+
+void filc_mark_global_roots(filc_object_array* mark_stack, bool only_new_global_variables)
 {
     size_t index;
     for (index = FILC_MAX_USER_SIGNUM + 1; index--;)
         fugc_mark(mark_stack, filc_object_for_special_payload(signal_table[index]));
 
-    filc_global_initialization_lock_lock();
     /* Global roots point to filc_objects that are global, i.e. they are not GC-allocated, but they do
        have outgoing pointers. So, rather than fugc_marking them, we just shove them into the mark
-       stack. */
-    filc_object_array_push_all(mark_stack, &filc_global_variable_roots);
-    filc_global_initialization_lock_unlock();
+       stack. Roots that get added while we're scanning are picked up by the next scan. */
+    size_t begin = only_new_global_variables ? num_scanned_global_variable_roots : 0;
+    size_t end = __atomic_load_n(&num_global_variable_roots, __ATOMIC_ACQUIRE);
+    PAS_ASSERT(begin <= end);
+    global_root_chunk* chunk = __atomic_load_n(&first_global_root_chunk, __ATOMIC_ACQUIRE);
+    size_t chunk_begin = 0;
+    while (chunk_begin + GLOBAL_ROOT_CHUNK_CAPACITY <= begin) {
+        chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+        chunk_begin += GLOBAL_ROOT_CHUNK_CAPACITY;
+    }
+    for (index = begin; index < end; ++index) {
+        if (index - chunk_begin == GLOBAL_ROOT_CHUNK_CAPACITY) {
+            chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+            chunk_begin = index;
+        }
+        PAS_ASSERT(chunk);
+        filc_object_array_push(mark_stack, chunk->objects[index - chunk_begin]);
+    }
+    num_scanned_global_variable_roots = end;
 
     filc_thread** threads;
     size_t num_threads;
@@ -1206,6 +1903,12 @@ void filc_mark_global_roots(filc_object_array* mark_stack)
     for (index = num_threads; index--;)
         fugc_mark(mark_stack, filc_object_for_special_payload(threads[index]));
     bmalloc_deallocate(threads);
+
+    pas_lock_lock(&in_flight_io_urings_lock);
+    filc_io_uring* ring;
+    for (ring = in_flight_io_urings; ring; ring = ring->next_in_flight)
+        fugc_mark(mark_stack, filc_object_for_special_payload(ring));
+    pas_lock_unlock(&in_flight_io_urings_lock);
 }
 
 static void dump_signals_mask(void)
@@ -1242,7 +1945,7 @@ static void signal_pizlonator(int signum)
     }
     PAS_ASSERT(thread);
     
-    if ((thread->state & FILC_THREAD_STATE_ENTERED)) {
+    if ((thread->state & FILC_THREAD_STATE_ENTERED) || thread->special_signal_deferral_depth) {
         /* For all we know the user asked for a mask that allows us to recurse, hence the lock-freedom. */
         for (;;) {
             uint64_t old_value = thread->num_deferred_signals[signum];
@@ -1250,20 +1953,19 @@ static void signal_pizlonator(int signum)
                     thread->num_deferred_signals + signum, old_value, old_value + 1))
                 break;
         }
-        for (;;) {
-            uint8_t old_state = thread->state;
-            PAS_ASSERT(old_state & FILC_THREAD_STATE_ENTERED);
-            if (old_state & FILC_THREAD_STATE_DEFERRED_SIGNAL)
-                break;
-            uint8_t new_state = old_state | FILC_THREAD_STATE_DEFERRED_SIGNAL;
-            if (pas_compare_and_swap_uint8_weak(&thread->state, old_state, new_state))
-                break;
+        /* If we're deferring signals while exited, then whoever is deferring them will set the
+           DEFERRED_SIGNAL state once it's entered, since that state is only legal while entered. */
+        if (!(thread->state & FILC_THREAD_STATE_ENTERED)) {
+            thread->have_deferred_signal_special = true;
+            return;
         }
+        set_deferred_signal_state(thread);
         return;
     }
 
     /* These shenanigans work only because if we ever grab the thread's lock, we are either entered
-       (so we won't get here) or we block all signals (so we won't get here). */
+       (so we won't get here), we defer signals (so we won't get here either), or we block all
+       signals (so we won't get here). */
     filc_enter(thread);
     /* Even if the signal mask allows the signal to recurse, at this point the signal_pizlonator
        will just count and defer. */
@@ -1335,6 +2037,18 @@ void filc_special_type_dump(filc_special_type type, pas_stream* stream)
     case FILC_SPECIAL_TYPE_EXACT_PTR_TABLE:
         pas_stream_printf(stream, "exact_ptr_table");
         return;
+    case FILC_SPECIAL_TYPE_IO_URING:
+        pas_stream_printf(stream, "io_uring");
+        return;
+    case FILC_SPECIAL_TYPE_WEAK:
+        pas_stream_printf(stream, "weak");
+        return;
+    case FILC_SPECIAL_TYPE_ARENA:
+        pas_stream_printf(stream, "arena");
+        return;
+    case FILC_SPECIAL_TYPE_FIBER:
+        pas_stream_printf(stream, "fiber");
+        return;
     case FILC_SPECIAL_TYPE_FUNCTION:
         pas_stream_printf(stream, "function");
         return;
@@ -1382,10 +2096,21 @@ void filc_object_flags_dump_with_comma(filc_object_flags flags, bool* comma, pas
         pas_stream_print_comma(stream, comma, ",");
         pas_stream_printf(stream, "global");
     }
-    if (flags & FILC_OBJECT_FLAG_GLOBAL_AUX) {
+    if (filc_object_flags_is_shared(flags)) {
+        pas_stream_print_comma(stream, comma, ",");
+        pas_stream_printf(stream, "shared");
+    } else if (flags & FILC_OBJECT_FLAG_GLOBAL_AUX) {
         pas_stream_print_comma(stream, comma, ",");
         pas_stream_printf(stream, "global_aux");
     }
+    if (flags & FILC_OBJECT_FLAG_STACK) {
+        pas_stream_print_comma(stream, comma, ",");
+        pas_stream_printf(stream, "stack");
+    }
+    if (flags & FILC_OBJECT_FLAG_INLINE_AUX) {
+        pas_stream_print_comma(stream, comma, ",");
+        pas_stream_printf(stream, "inline_aux");
+    }
     if (flags & FILC_OBJECT_FLAG_MMAP) {
         pas_stream_print_comma(stream, comma, ",");
         pas_stream_printf(stream, "mmap");
@@ -1506,6 +2231,9 @@ bool filc_weak_cas_ptr(filc_thread* my_thread, filc_ptr ptr, ptrdiff_t offset,
     filc_check_native_access(ptr, sizeof(void*), filc_write_access);
     filc_lower_or_box* lower_or_box_ptr = filc_ptr_ensure_lower_or_box_ptr(my_thread, ptr);
     filc_store_barrier(my_thread, filc_ptr_object(new_value));
+    /* If we lose the race to install a box, then we retry with the same box, so that contention
+       doesn't turn into one allocation per attempt. */
+    filc_atomic_box* new_box = NULL;
     for (;;) {
         filc_lower_or_box lower_or_box = filc_lower_or_box_load(lower_or_box_ptr);
         bool did_succeed;
@@ -1515,10 +2243,10 @@ bool filc_weak_cas_ptr(filc_thread* my_thread, filc_ptr ptr, ptrdiff_t offset,
         } else if (*(void**)filc_ptr_ptr(ptr) != filc_ptr_ptr(expected))
             return false;
         else {
+            if (!new_box)
+                new_box = filc_atomic_box_create_for_ptr_store(my_thread, new_value);
             if (!filc_lower_or_box_cas_weak_unbarriered(
-                    lower_or_box_ptr, lower_or_box,
-                    filc_lower_or_box_create_box(
-                        filc_atomic_box_create_for_ptr_store(my_thread, new_value))))
+                    lower_or_box_ptr, lower_or_box, filc_lower_or_box_create_box(new_box)))
                 continue;
             did_succeed = true;
         }
@@ -1535,6 +2263,7 @@ filc_ptr filc_strong_cas_ptr_with_manual_tracking(
     filc_check_native_access(ptr, sizeof(void*), filc_write_access);
     filc_lower_or_box* lower_or_box_ptr = filc_ptr_ensure_lower_or_box_ptr(my_thread, ptr);
     filc_store_barrier(my_thread, filc_ptr_object(new_value));
+    filc_atomic_box* new_box = NULL;
     for (;;) {
         filc_lower_or_box lower_or_box = filc_lower_or_box_load(lower_or_box_ptr);
         filc_ptr old_value;
@@ -1547,10 +2276,10 @@ filc_ptr filc_strong_cas_ptr_with_manual_tracking(
                 old_value = filc_ptr_create_with_lower_and_ptr_and_manual_tracking(
                     filc_lower_or_box_get_lower(lower_or_box), old_ptr);
             } else {
+                if (!new_box)
+                    new_box = filc_atomic_box_create_for_ptr_store(my_thread, new_value);
                 if (!filc_lower_or_box_cas_weak_unbarriered(
-                        lower_or_box_ptr, lower_or_box,
-                        filc_lower_or_box_create_box(
-                            filc_atomic_box_create_for_ptr_store(my_thread, new_value))))
+                        lower_or_box_ptr, lower_or_box, filc_lower_or_box_create_box(new_box)))
                     continue;
                 old_value = filc_ptr_create_with_lower_and_ptr_and_manual_tracking(
                     filc_lower_or_box_get_lower(lower_or_box), filc_ptr_ptr(expected));
@@ -1601,18 +2330,34 @@ char* filc_cc_cursor_to_new_string(filc_cc_cursor cursor)
     return pas_string_stream_take_string(&stream);
 }
 
+/* It's fine for a barriered object to sit in the buffer without being marked, since the collector
+   only learns about what a thread marked when the thread donates, and donating flushes. */
+static PAS_ALWAYS_INLINE void store_barrier_buffered(filc_thread* my_thread, filc_object* object)
+{
+    PAS_TESTING_ASSERT(object);
+    size_t index =
+        ((uintptr_t)object / FILC_WORD_SIZE) & (FILC_STORE_BARRIER_BUFFER_SIZE - 1);
+    filc_object* old_object = my_thread->store_barrier_buffer[index];
+    if (old_object == object)
+        return;
+    my_thread->store_barrier_buffer[index] = object;
+    fugc_mark(&my_thread->mark_stack, old_object);
+    if (PAS_UNLIKELY(my_thread->mark_stack.num_objects >= filc_remembered_set_limit))
+        fugc_donate(&my_thread->mark_stack);
+}
+
 PAS_NEVER_INLINE void filc_store_barrier_slow(filc_thread* my_thread, filc_object* object)
 {
     PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
     PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
-    fugc_mark(&my_thread->mark_stack, object);
+    store_barrier_buffered(my_thread, object);
 }
 
 PAS_NEVER_INLINE void filc_store_barrier_for_lower_slow(filc_thread* my_thread, void* lower)
 {
     PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
     PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
-    fugc_mark(&my_thread->mark_stack, filc_object_for_lower_not_null(lower));
+    store_barrier_buffered(my_thread, filc_object_for_lower_not_null(lower));
 }
 
 PAS_NO_RETURN PAS_NEVER_INLINE void filc_check_native_access_fail(filc_ptr ptr,
@@ -1672,11 +2417,15 @@ PAS_NO_RETURN PAS_NEVER_INLINE void filc_check_native_access_fail(filc_ptr ptr,
             fail; \
     } while (false)
 
-/* Also checks that the object isn't free or special, just because it's cheap to do such a check. */
-#define CHECK_WRITE_FAST(object, fail) do { \
-        if ((filc_object_get_flags(object) & (FILC_OBJECT_FLAG_READONLY | \
-                                              FILC_OBJECT_FLAG_FREE | \
-                                              FILC_OBJECT_FLAGS_SPECIAL_MASK))) \
+/* Checks bounds and writability at once by doing signed compares against the write upper. See
+   FILC_OBJECT_UPPER_READONLY_TAG. Free and special objects fail this, since their upper is their
+   lower. */
+#define CHECK_WRITE_BOUNDS_FAST(raw_ptr, lower, write_upper, count, fail) do { \
+        char* my_raw_ptr = (raw_ptr); \
+        char* my_write_upper = (write_upper); \
+        if ((intptr_t)my_raw_ptr < (intptr_t)(lower) || \
+            (intptr_t)my_raw_ptr >= (intptr_t)my_write_upper || \
+            (count) > (size_t)(my_write_upper - my_raw_ptr)) \
             fail; \
     } while (false)
 
@@ -1824,6 +2573,68 @@ filc_ptr_pair filc_get_next_ptr_bytes_for_va_arg(filc_ptr ptr_ptr, size_t size,
     return result;
 }
 
+static size_t payload_capacity_for_allocation(void* allocation, size_t offset_to_payload,
+                                              size_t size)
+{
+    size_t allocation_size = verse_heap_get_allocation_size_inline((uintptr_t)allocation);
+    if (allocation_size <= offset_to_payload + size)
+        return size;
+    return pas_round_down_to_power_of_2(allocation_size - offset_to_payload, FILC_WORD_SIZE);
+}
+
+/* Returns how big the object's payload can get without moving, which is how big its aux has to be.
+   Objects that don't live in a heap allocation of their own can't grow, and neither can objects
+   whose aux is right after their payload. */
+static size_t object_capacity(filc_object* object)
+{
+    size_t size = filc_object_size_not_null(object);
+    filc_object_flags flags = filc_object_get_flags(object);
+    if ((flags & (FILC_OBJECT_FLAG_GLOBAL | FILC_OBJECT_FLAG_MMAP | FILC_OBJECT_FLAG_INLINE_AUX |
+                  FILC_OBJECT_FLAGS_SPECIAL_MASK)))
+        return size;
+    char* mark_base = (char*)filc_object_mark_base_with_flags(object, flags);
+    return payload_capacity_for_allocation(
+        mark_base, (char*)filc_object_lower_not_null(object) - mark_base, size);
+}
+
+PAS_ALWAYS_INLINE static void nuke_aux_entry(char* aux_ptr, size_t offset)
+{
+    filc_lower_or_box* lower_or_box_ptr = (filc_lower_or_box*)(aux_ptr + offset);
+    filc_lower_or_box_store_unfenced_unbarriered(
+        lower_or_box_ptr, filc_lower_or_box_create_lower(NULL));
+}
+
+#define NUKE_AUX_MIN_BYTES_TO_DECOMMIT ((size_t)1024 * 1024)
+
+/* For big ranges, it's cheaper to have the kernel throw the aux pages away than to write zeros to
+   all of them. MADV_DONTNEED on private anonymous memory, which is what the heap is made of, means
+   that the next touch gets a zero page. That's not true of globals, whose aux may be in the image's
+   data section, so those always get written. If the madvise fails (for example because the memory
+   is mlocked), we fall back on writing zeros.
+
+   It's fine for the collector to read the aux while this happens, since it will see either the old
+   lowers or NULL, just like it would if we wrote the zeros one at a time. */
+static void nuke_aux_range_large(char* aux_ptr, size_t aligned_start_offset,
+                                 size_t aligned_end_offset, bool can_decommit)
+{
+    size_t offset = aligned_start_offset;
+    if (can_decommit
+        && aligned_end_offset - aligned_start_offset >= NUKE_AUX_MIN_BYTES_TO_DECOMMIT) {
+        size_t page_size = pas_page_malloc_alignment();
+        char* pages_begin = (char*)pas_round_up_to_power_of_2(
+            (uintptr_t)(aux_ptr + aligned_start_offset), page_size);
+        char* pages_end = (char*)pas_round_down_to_power_of_2(
+            (uintptr_t)(aux_ptr + aligned_end_offset), page_size);
+        PAS_ASSERT(pages_begin < pages_end);
+        for (; aux_ptr + offset < pages_begin; offset += FILC_WORD_SIZE)
+            nuke_aux_entry(aux_ptr, offset);
+        if (!madvise(pages_begin, pages_end - pages_begin, MADV_DONTNEED))
+            offset = pages_end - aux_ptr;
+    }
+    for (; offset < aligned_end_offset; offset += FILC_WORD_SIZE)
+        nuke_aux_entry(aux_ptr, offset);
+}
+
 char* filc_object_ensure_aux_ptr_slow(filc_thread* my_thread, filc_object* object)
 {
     static const bool verbose = false;
@@ -1848,6 +2659,9 @@ char* filc_object_ensure_aux_ptr_slow(filc_thread* my_thread, filc_object* objec
         NULL,
         "attempt to create aux for object with zero size %s.\n",
         filc_object_to_new_string(object));
+    /* The aux covers everything that the object could grow to in place. Otherwise, we'd race with
+       try_grow_in_place() and install an aux that's too small. */
+    size = object_capacity(object);
     char* aux_ptr = filc_thread_allocate(my_thread, size);
     if (verbose)
         pas_log("allocated aux at %p with size %zu, ending at %p\n", aux_ptr, size, aux_ptr + size);
@@ -1865,10 +2679,15 @@ char* filc_object_ensure_aux_ptr_slow(filc_thread* my_thread, filc_object* objec
            already true due to the fantastic properties of Phil's concurrent marking (even if you just
            allocated an object you still need a barrier). */
         filc_exit_with_allocation_root(my_thread, aux_ptr);
-        memset(aux_ptr, 0, size);
+        /* Letting the kernel hand us zero pages means that the parts of a big aux that never get a
+           ptr stored into them never get committed, and FUGC can skip them when marking. */
+        if (pas_is_aligned(size, FILC_WORD_SIZE))
+            nuke_aux_range_large(aux_ptr, 0, size, true);
+        else
+            memset(aux_ptr, 0, size);
         filc_enter_with_allocation_root(my_thread, aux_ptr);
     }
-    if (PAS_UNLIKELY(filc_is_marking))
+    if (PAS_UNLIKELY(filc_store_barrier_is_on))
         verse_heap_set_is_marked_relaxed(aux_ptr, true);
     for (;;) {
         uintptr_t aux = object->aux;
@@ -1886,12 +2705,17 @@ char* filc_object_ensure_aux_ptr_slow(filc_thread* my_thread, filc_object* objec
             NULL,
             "attempt to create aux for free object %s.\n",
             filc_object_to_new_string(object));
+        filc_object_flags flags = filc_aux_get_flags(aux);
+        /* Installing an aux into a shared object turns it into an ordinary mmap object, whose aux
+           the GC marks. The flags change in the same CAS, so nobody sees one without the other. */
+        if (filc_object_flags_is_shared(flags))
+            flags &= ~FILC_OBJECT_FLAG_GLOBAL_AUX;
         if (not_atomic_hack) {
-            object->aux = filc_aux_create(filc_aux_get_flags(aux), aux_ptr);
+            object->aux = filc_aux_create(flags, aux_ptr);
             return aux_ptr;
         }
         if (pas_compare_and_swap_uintptr_weak(
-                &object->aux, aux, filc_aux_create(filc_aux_get_flags(aux), aux_ptr))) {
+                &object->aux, aux, filc_aux_create(flags, aux_ptr))) {
             if (verbose) {
                 pas_log("created aux at %p: ", aux_ptr);
                 filc_object_dump(object, &pas_log_stream.base);
@@ -1912,7 +2736,7 @@ filc_atomic_box* filc_atomic_box_create_for_ptr_store(filc_thread* my_thread, fi
     filc_atomic_box* result = filc_thread_allocate(my_thread, sizeof(filc_atomic_box));
     /* We know that the ptr value is already barriered. */
     result->ptr = value;
-    if (PAS_UNLIKELY(filc_is_marking))
+    if (PAS_UNLIKELY(filc_store_barrier_is_on))
         verse_heap_set_is_marked_relaxed(result, true);
     pas_store_store_fence();
     return result;
@@ -1971,20 +2795,6 @@ filc_object* filc_allocate_special(filc_thread* my_thread, size_t size, size_t a
     return filc_allocate_special_early(size, alignment, special_type);
 }
 
-static PAS_NEVER_INLINE PAS_NO_RETURN void size_too_big(size_t size)
-{
-    filc_safety_panic(NULL, "attempt to allocate object that is too big (size = %zu).", size);
-}
-
-static PAS_ALWAYS_INLINE void prepare_allocate_object(size_t* size)
-{
-    if (PAS_UNLIKELY(*size > FILC_MAX_ALLOCATION_SIZE))
-        size_too_big(*size);
-    size_t original_size = *size;
-    *size = pas_round_up_to_power_of_2(*size, FILC_MINALIGN);
-    PAS_TESTING_ASSERT(*size >= original_size);
-}
-
 filc_object* filc_allocate_special_with_existing_payload(
     filc_thread* my_thread, void* payload, filc_special_type special_type)
 {
@@ -2002,48 +2812,21 @@ filc_object* filc_allocate_special_with_existing_payload(
     return result;
 }
 
-static PAS_ALWAYS_INLINE void prepare_allocate(
-    size_t* size, size_t alignment, size_t* offset_to_payload, size_t* total_size)
-{
-    PAS_ASSERT(sizeof(filc_object) == FILC_MINALIGN);
-    prepare_allocate_object(size);
-    *offset_to_payload = pas_max_uintptr(alignment, sizeof(filc_object));
-    *total_size = *size + *offset_to_payload;
-    PAS_TESTING_ASSERT(*total_size > *size);
-}
-
-static PAS_ALWAYS_INLINE filc_object* initialize_object_header(
-    void* allocation, size_t size, size_t alignment, size_t offset_to_payload,
-    filc_object_flags object_flags, char* aux_ptr)
+PAS_NEVER_INLINE PAS_NO_RETURN void filc_allocation_size_too_big(size_t size)
 {
-    static const bool verbose = false;
-    if (verbose) {
-        pas_log("initializing new object with allocation at %p, payload at %p, size %zu, end at %p\n",
-                allocation, (char*)allocation + offset_to_payload, size,
-                (char*)allocation + offset_to_payload + size);
-    }
-    PAS_TESTING_ASSERT(pas_is_aligned(size, FILC_WORD_SIZE));
-    PAS_TESTING_ASSERT(!filc_object_flags_is_special(object_flags));
-    PAS_TESTING_ASSERT(!filc_object_flags_is_aligned(object_flags));
-    if (alignment > sizeof(filc_object)) {
-        PAS_TESTING_ASSERT(offset_to_payload > sizeof(filc_object));
-        PAS_TESTING_ASSERT(offset_to_payload == alignment);
-        filc_alignment_header_construct((filc_alignment_header*)allocation, alignment);
-    }
-    filc_object* result = filc_object_for_lower_not_null((char*)allocation + offset_to_payload);
-    result->upper = (char*)(result + 1) + size;
-    if (alignment > FILC_MINALIGN) {
-        object_flags = filc_object_flags_create(
-            object_flags, FILC_SPECIAL_TYPE_NONE, pas_log2(alignment));
-        PAS_TESTING_ASSERT(filc_object_flags_alignment(object_flags) == alignment);
-    }
-    result->aux = filc_aux_create(object_flags, aux_ptr);
-    return result;
+    filc_safety_panic(NULL, "attempt to allocate object that is too big (size = %zu).", size);
 }
 
-static PAS_NEVER_INLINE filc_object* finish_allocate_large(
+PAS_NEVER_INLINE filc_object* filc_finish_allocate_large(
     filc_thread* my_thread, filc_object* result, size_t size)
 {
+    /* Large objects often come out of memory that is fresh from the OS or that the collector zeroed
+       after sweeping it (see verse_heap_large_cache_zero()). */
+    if (verse_heap_is_known_zero_large_object((uintptr_t)filc_object_lower(result))) {
+        pas_store_store_fence();
+        return result;
+    }
+    
     filc_exit_with_allocation_root(my_thread, filc_object_mark_base(result));
     
     pas_zero_memory(filc_object_lower(result), size);
@@ -2054,50 +2837,86 @@ static PAS_NEVER_INLINE filc_object* finish_allocate_large(
     return result;
 }
 
-static PAS_ALWAYS_INLINE filc_object* finish_allocate_small(filc_object* result, size_t size)
+filc_object* filc_allocate(filc_thread* my_thread, size_t size)
 {
-    filc_memset_small_word(filc_object_lower(result), 0, size);
-    pas_store_store_fence();
-    return result;
+    return filc_allocate_inline(my_thread, size);
 }
 
-static PAS_ALWAYS_INLINE filc_object* finish_allocate(
-    filc_thread* my_thread, void* allocation, size_t size, size_t alignment,
-    size_t offset_to_payload, filc_object_flags object_flags)
+filc_object* filc_allocate_with_aux(filc_thread* my_thread, size_t size)
 {
-    filc_object* result = initialize_object_header(
-        allocation, size, alignment, offset_to_payload, object_flags, NULL);
-    if (PAS_UNLIKELY(size > FILC_MAX_BYTES_BETWEEN_POLLCHECKS))
-        return finish_allocate_large(my_thread, result, size);
-    return finish_allocate_small(result, size);
+    return filc_allocate_with_aux_inline(my_thread, size);
 }
 
-static PAS_ALWAYS_INLINE filc_object* allocate_impl(
-    filc_thread* my_thread, size_t size, filc_object_flags object_flags)
+filc_object* filc_allocate_uninitialized(filc_thread* my_thread, size_t size)
 {
-    static const bool verbose = false;
-    
-    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
-    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
-    PAS_TESTING_ASSERT(!(object_flags & FILC_OBJECT_FLAG_MMAP));
+    return filc_allocate_uninitialized_inline(my_thread, size);
+}
 
-    if (verbose) {
-        pas_log("Allocating %zu bytes\n", size);
-        filc_thread_dump_stack(my_thread, &pas_log_stream.base);
+static PAS_NEVER_INLINE pas_heap* iso_heap_get_slow(filc_iso_heap* iso_heap)
+{
+    pas_heap* heap;
+    pas_heap* old_heap;
+    if (!filc_num_iso_heaps)
+        heap = filc_default_heap;
+    else {
+        heap = iso_heaps[pas_atomic_exchange_add_uintptr(&next_iso_heap_index, 1)
+                         % filc_num_iso_heaps];
     }
+    /* If another thread picked a heap first, then we use theirs, so that the type only ever has
+       one. */
+    old_heap = (pas_heap*)pas_compare_and_swap_ptr_strong(&iso_heap->heap, NULL, heap);
+    if (old_heap)
+        return old_heap;
+    return heap;
+}
+
+static PAS_ALWAYS_INLINE pas_heap* iso_heap_get(filc_iso_heap* iso_heap)
+{
+    /* The heaps were all created before we started allocating, so there's nothing to fence. */
+    pas_heap* heap = iso_heap->heap;
+    if (PAS_LIKELY(heap))
+        return heap;
+    return iso_heap_get_slow(iso_heap);
+}
+
+filc_object* filc_allocate_iso(filc_thread* my_thread, filc_iso_heap* iso_heap, size_t size)
+{
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
 
-    size_t num_words;
     size_t offset_to_payload;
     size_t total_size;
-    prepare_allocate(&size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
-    return finish_allocate(
-        my_thread, filc_thread_allocate(my_thread, total_size),
-        size, FILC_WORD_SIZE, offset_to_payload, object_flags);
+    filc_prepare_allocate(&size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
+    filc_object* result = filc_finish_allocate(
+        my_thread, verse_heap_allocate(iso_heap_get(iso_heap), total_size),
+        size, FILC_WORD_SIZE, offset_to_payload, 0);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size);
+    return result;
 }
 
-filc_object* filc_allocate(filc_thread* my_thread, size_t size)
+filc_object* filc_allocate_iso_with_aux(filc_thread* my_thread, filc_iso_heap* iso_heap,
+                                        size_t size)
 {
-    return allocate_impl(my_thread, size, 0);
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
+
+    size_t offset_to_payload;
+    size_t total_size;
+    filc_prepare_allocate(&size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
+    if (!size)
+        return filc_allocate_iso(my_thread, iso_heap, size);
+    void* allocation = verse_heap_allocate(iso_heap_get(iso_heap), total_size + size);
+    filc_object* result = filc_initialize_object_header(
+        allocation, size, FILC_WORD_SIZE, offset_to_payload, FILC_OBJECT_FLAG_INLINE_AUX,
+        (char*)allocation + total_size);
+    if (PAS_UNLIKELY(size * 2 > FILC_MAX_BYTES_BETWEEN_POLLCHECKS))
+        filc_finish_allocate_large(my_thread, result, size * 2);
+    else
+        filc_finish_allocate_small(result, size * 2);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size + size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size + size);
+    return result;
 }
 
 static PAS_ALWAYS_INLINE filc_object* allocate_aligned_impl(
@@ -2116,7 +2935,7 @@ static PAS_ALWAYS_INLINE filc_object* allocate_aligned_impl(
     pas_heap* heap;
     if ((object_flags & FILC_OBJECT_FLAG_MMAP)) {
         PAS_TESTING_ASSERT(alignment == pas_page_malloc_alignment());
-        heap = filc_destructor_heap;
+        heap = filc_mmap_heap;
     } else
         heap = filc_default_heap;
 
@@ -2124,10 +2943,13 @@ static PAS_ALWAYS_INLINE filc_object* allocate_aligned_impl(
     size_t num_words;
     size_t offset_to_payload;
     size_t total_size;
-    prepare_allocate(&size, alignment, &offset_to_payload, &total_size);
-    return finish_allocate(
-        my_thread, verse_heap_allocate_with_alignment(filc_default_heap, total_size, alignment),
+    filc_prepare_allocate(&size, alignment, &offset_to_payload, &total_size);
+    filc_object* result = filc_finish_allocate(
+        my_thread, verse_heap_allocate_with_alignment(heap, total_size, alignment),
         size, alignment, offset_to_payload, object_flags);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size);
+    return result;
 }
 
 filc_object* filc_allocate_with_alignment(filc_thread* my_thread, size_t size, size_t alignment)
@@ -2151,10 +2973,13 @@ static filc_object* finish_reallocate(
 
     size_t common_size = pas_min_uintptr(new_size, old_size);
     char* new_aux_ptr = NULL;
-    if (old_aux_ptr)
-        new_aux_ptr = filc_thread_allocate(my_thread, new_size);
+    size_t new_aux_size = 0;
+    if (old_aux_ptr) {
+        new_aux_size = payload_capacity_for_allocation(allocation, offset_to_payload, new_size);
+        new_aux_ptr = filc_thread_allocate(my_thread, new_aux_size);
+    }
 
-    filc_object* result = initialize_object_header(
+    filc_object* result = filc_initialize_object_header(
         allocation, new_size, alignment, offset_to_payload, 0, new_aux_ptr);
     if (verbose)
         pas_log("old_object = %p, result = %p\n", old_object, result);
@@ -2167,7 +2992,7 @@ static filc_object* finish_reallocate(
     if (new_size > common_size)
         pas_zero_memory((char*)filc_object_lower(result) + common_size, new_size - common_size);
     if (new_aux_ptr)
-        pas_zero_memory(new_aux_ptr, new_size);
+        pas_zero_memory(new_aux_ptr, new_aux_size);
     if (new_size > FILC_MAX_BYTES_BETWEEN_POLLCHECKS) {
         filc_enter_with_allocation_root(my_thread, allocation);
         if (new_aux_ptr)
@@ -2177,11 +3002,13 @@ static filc_object* finish_reallocate(
             NULL,
             "source object became free during realloc (object = %s).",
             filc_object_to_new_string(old_object));
+        /* FUGC may have detached the old aux while we were exited, if it was empty. */
+        old_aux_ptr = filc_object_aux_ptr(old_object);
     }
     /* FIXME: We could conditionalize this. */
     filc_thread_track_object(my_thread, result);
     /* FIXME: This could be optimized the same way that memmove is. */
-    if (new_aux_ptr) {
+    if (new_aux_ptr && old_aux_ptr) {
         size_t offset;
         PAS_ASSERT(pas_is_aligned(common_size, sizeof(filc_lower_or_box)));
         for (offset = 0; offset < common_size; offset += sizeof(filc_lower_or_box)) {
@@ -2198,6 +3025,10 @@ static filc_object* finish_reallocate(
                     NULL,
                     "source object became free during realloc (object = %s).",
                     filc_object_to_new_string(old_object));
+                /* If the old aux got detached, then the rest of it was empty. */
+                old_aux_ptr = filc_object_aux_ptr(old_object);
+                if (!old_aux_ptr)
+                    break;
             }
         }
     }
@@ -2208,6 +3039,41 @@ static filc_object* finish_reallocate(
     return result;
 }
 
+/* Grows the object within the slack of its allocation, if there's room. This just zeroes the new
+   bytes and bumps the upper. The aux already covers the capacity, see object_capacity().
+
+   The old object stays valid, since it's the same object. */
+static bool try_grow_in_place(filc_thread* my_thread, filc_object* object, size_t new_size,
+                              size_t alignment)
+{
+    if ((filc_object_get_flags(object) & (FILC_OBJECT_FLAG_FREE | FILC_OBJECT_FLAG_GLOBAL |
+                                          FILC_OBJECT_FLAG_READONLY | FILC_OBJECT_FLAG_MMAP |
+                                          FILC_OBJECT_FLAGS_SPECIAL_MASK)))
+        return false;
+    char* lower = (char*)filc_object_lower_not_null(object);
+    char* old_upper = (char*)object->upper;
+    size_t old_size = old_upper - lower;
+    /* Freeing sets the upper to the lower, so we can't tell a racing free apart from a zero-sized
+       object. */
+    if (!old_size || new_size <= old_size)
+        return false;
+    if (!pas_is_aligned((uintptr_t)lower, alignment))
+        return false;
+    if (new_size > object_capacity(object))
+        return false;
+    if (new_size - old_size > FILC_MAX_BYTES_BETWEEN_POLLCHECKS) {
+        filc_exit_with_allocation_root(my_thread, filc_object_mark_base(object));
+        pas_zero_memory(old_upper, new_size - old_size);
+        filc_enter_with_allocation_root(my_thread, filc_object_mark_base(object));
+    } else
+        filc_memset_small_word(old_upper, 0, new_size - old_size);
+    pas_store_store_fence();
+    /* If this fails, then someone else freed or resized the object. Let the slow path sort it
+       out. */
+    return pas_compare_and_swap_ptr_strong(&object->upper, old_upper, lower + new_size)
+        == old_upper;
+}
+
 filc_object* filc_reallocate(filc_thread* my_thread, filc_object* object, size_t new_size)
 {
     PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
@@ -2215,10 +3081,15 @@ filc_object* filc_reallocate(filc_thread* my_thread, filc_object* object, size_t
 
     size_t offset_to_payload;
     size_t total_size;
-    prepare_allocate(&new_size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
-    return finish_reallocate(
+    filc_prepare_allocate(&new_size, FILC_WORD_SIZE, &offset_to_payload, &total_size);
+    if (try_grow_in_place(my_thread, object, new_size, FILC_WORD_SIZE))
+        return object;
+    filc_object* result = finish_reallocate(
         my_thread, filc_thread_allocate(my_thread, total_size),
         object, new_size, FILC_WORD_SIZE, offset_to_payload);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size);
+    return result;
 }
 
 filc_object* filc_reallocate_with_alignment(filc_thread* my_thread, filc_object* object,
@@ -2230,10 +3101,48 @@ filc_object* filc_reallocate_with_alignment(filc_thread* my_thread, filc_object*
     alignment = pas_max_uintptr(alignment, FILC_WORD_SIZE);
     size_t offset_to_payload;
     size_t total_size;
-    prepare_allocate(&new_size, alignment, &offset_to_payload, &total_size);
-    return finish_reallocate(
+    filc_prepare_allocate(&new_size, alignment, &offset_to_payload, &total_size);
+    if (try_grow_in_place(my_thread, object, new_size, alignment))
+        return object;
+    filc_object* result = finish_reallocate(
         my_thread, verse_heap_allocate_with_alignment(filc_default_heap, total_size, alignment),
         object, new_size, alignment, offset_to_payload);
+    filc_heap_profiler_note_allocation(my_thread, result, total_size);
+    filc_alloc_trace_note_allocation(my_thread, result, total_size);
+    return result;
+}
+
+#define FREE_MIN_BYTES_TO_DECOMMIT ((size_t)1024 * 1024)
+
+static void decommit_pages_inside(char* begin, char* end)
+{
+    size_t page_size = pas_page_malloc_alignment();
+    char* pages_begin = (char*)pas_round_up_to_power_of_2((uintptr_t)begin, page_size);
+    char* pages_end = (char*)pas_round_down_to_power_of_2((uintptr_t)end, page_size);
+    if (pages_begin < pages_end)
+        madvise(pages_begin, pages_end - pages_begin, MADV_DONTNEED);
+}
+
+/* A freed object can't be accessed anymore, but FUGC only reclaims its memory once nobody points at
+   it. Until then, a big free would keep all of its pages resident, so we give the payload and aux
+   pages that lie wholly inside the object back to the kernel right away. The header stays, since
+   it's what makes accesses fail. An access that raced with the free and got past its bounds check
+   sees zero pages, just like with nuke_aux_range_large(), and the same goes for the collector if it
+   is scanning the aux. When the memory gets reused, the allocation zeroes it anyway.
+
+   mmap objects are skipped, since filc_free() is only called on them after they got unmapped. So
+   are global auxes, which may be in the image's data section. The object stays an allocation root
+   while we're exited, so its pages can't be swept and handed out again under us. */
+static void decommit_freed_object(filc_object* object, size_t size, uintptr_t aux)
+{
+    filc_thread* my_thread = filc_get_my_thread();
+    char* lower = (char*)filc_object_lower(object);
+    char* aux_ptr = filc_aux_get_ptr(aux);
+    filc_exit_with_allocation_root(my_thread, filc_object_mark_base(object));
+    decommit_pages_inside(lower, lower + size);
+    if (aux_ptr && !(filc_aux_get_flags(aux) & FILC_OBJECT_FLAG_GLOBAL_AUX))
+        decommit_pages_inside(aux_ptr, aux_ptr + size);
+    filc_enter_with_allocation_root(my_thread, filc_object_mark_base(object));
 }
 
 void filc_free(filc_object* object)
@@ -2247,9 +3156,11 @@ void filc_free(filc_object* object)
     PAS_TESTING_ASSERT(!filc_object_is_special(object)); /* We could allow freeing special objects
                                                             at some point. */
     PAS_TESTING_ASSERT(!(filc_object_get_flags(object) & FILC_OBJECT_FLAG_GLOBAL));
+    size_t size = filc_object_size(object);
+    uintptr_t aux;
     object->upper = filc_object_lower_not_null(object);
     for (;;) {
-        uintptr_t aux = object->aux;
+        aux = object->aux;
         FILC_CHECK(
             !(filc_aux_get_flags(aux) & FILC_OBJECT_FLAG_FREE),
             NULL,
@@ -2262,6 +3173,10 @@ void filc_free(filc_object* object)
                                 filc_aux_get_ptr(aux))))
             break;
     }
+    filc_alloc_trace_note_free(object);
+    if (size >= FREE_MIN_BYTES_TO_DECOMMIT
+        && !(filc_aux_get_flags(aux) & FILC_OBJECT_FLAG_MMAP))
+        decommit_freed_object(object, size, aux);
 }
 
 static size_t num_ptrtables = 0;
@@ -2335,6 +3250,10 @@ static uintptr_t ptr_table_encode_holding_lock(
             }
 
             new_array->num_entries = ptr_table->array->num_entries;
+
+            /* Decoders read the array without holding the lock, so they must not see the new array
+               before they see its contents. */
+            pas_store_store_fence();
             ptr_table->array = new_array;
         }
 
@@ -2361,6 +3280,17 @@ uintptr_t filc_ptr_table_encode(filc_thread* my_thread, filc_ptr_table* ptr_tabl
     return result;
 }
 
+/* Decoding never takes the lock. This works because:
+
+   - The array is only replaced wholesale, after the store-store fence in the encoder, and we only
+     ever load it once. We may be looking at a stale array if an encode is racing with us, but the
+     stale array is still valid memory (we're entered, so the GC can't have freed it), and any index
+     that was handed out before the array grew is also in the stale array.
+
+   - An index in [0, num_entries) whose ptr hasn't been stored yet reads as NULL, and so does an
+     index freed by the GC. Either way we return NULL, which is also what a bogus index gets.
+
+   - Ptrs that go free are caught by the free check. */
 filc_ptr filc_ptr_table_decode_with_manual_tracking(filc_ptr_table* ptr_table, uintptr_t encoded_ptr)
 {
     filc_ptr_table_array* array = ptr_table->array;
@@ -2658,6 +3588,20 @@ void filc_native_zgc_free(filc_thread* my_thread, filc_ptr ptr)
     filc_free(object_for_deallocate(ptr));
 }
 
+void filc_native_zgc_free_sized(filc_thread* my_thread, filc_ptr ptr, size_t size)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    if (!filc_ptr_ptr(ptr))
+        return;
+    filc_object* object = object_for_deallocate(ptr);
+    FILC_CHECK(
+        size <= filc_object_size(object),
+        NULL,
+        "cannot free ptr with size %zu, which is bigger than the object (ptr = %s).",
+        size, filc_ptr_to_new_string(ptr));
+    filc_free(object);
+}
+
 filc_ptr filc_native_zgetlower(filc_thread* my_thread, filc_ptr ptr)
 {
     PAS_UNUSED_PARAM(my_thread);
@@ -2716,37 +3660,501 @@ filc_ptr filc_native_zexact_ptrtable_decode(filc_thread* my_thread, filc_ptr tab
         (filc_exact_ptr_table*)filc_ptr_ptr(table_ptr), encoded_ptr);
 }
 
-size_t filc_native_ztesting_get_num_ptrtables(filc_thread* my_thread)
+static pas_lock weak_list_lock = PAS_LOCK_INITIALIZER;
+static filc_weak* first_weak; /* protected by the weak_list_lock. */
+static size_t num_weaks; /* protected by the weak_list_lock. */
+static bool weaks_are_frozen;
+
+filc_weak* filc_weak_create(filc_thread* my_thread, filc_ptr target)
 {
-    PAS_UNUSED_PARAM(my_thread);
-    return num_ptrtables;
+    filc_weak* result = (filc_weak*)
+        filc_object_special_payload_with_manual_tracking(
+            filc_allocate_special(my_thread, sizeof(filc_weak), 1, FILC_SPECIAL_TYPE_WEAK));
+
+    pas_lock_construct(&result->lock);
+    /* The target is reachable from our caller, so there's no need to barrier it. */
+    filc_flight_ptr_store_without_barrier(&result->target, target);
+
+    pas_lock_lock(&weak_list_lock);
+    result->prev = NULL;
+    result->next = first_weak;
+    if (first_weak)
+        first_weak->prev = result;
+    first_weak = result;
+    num_weaks++;
+    pas_lock_unlock(&weak_list_lock);
+
+    return result;
 }
 
-void filc_validate_object(filc_object* object, const filc_origin* origin)
+void filc_weak_destruct(filc_weak* weak)
 {
-    if (object == &filc_free_singleton) {
-        FILC_ASSERT(!filc_object_size_not_null(object), origin);
-        FILC_ASSERT(object->aux == filc_aux_create(FILC_OBJECT_FLAG_FREE |
-                                                   FILC_OBJECT_FLAG_GLOBAL |
-                                                   FILC_OBJECT_FLAG_READONLY,
-                                                   NULL), origin);
-        return;
+    pas_lock_lock(&weak_list_lock);
+    if (weak->prev)
+        weak->prev->next = weak->next;
+    else {
+        PAS_ASSERT(first_weak == weak);
+        first_weak = weak->next;
     }
+    if (weak->next)
+        weak->next->prev = weak->prev;
+    PAS_ASSERT(num_weaks);
+    num_weaks--;
+    pas_lock_unlock(&weak_list_lock);
+}
 
-    if (filc_object_is_special(object)) {
-        FILC_CHECK(
-            !filc_object_size_not_null(object),
-            origin,
-            "special object has non-null size (object = %s, object at %p, upper = %p)",
-            filc_object_to_new_string(object), object, object->upper);
-        FILC_ASSERT(filc_special_type_is_valid(filc_object_special_type(object)), origin);
-        if (filc_object_special_type(object) != FILC_SPECIAL_TYPE_FUNCTION &&
-            filc_object_special_type(object) != FILC_SPECIAL_TYPE_DL_HANDLE) {
-            FILC_ASSERT(pas_is_aligned(
-                            (uintptr_t)filc_object_special_payload_with_manual_tracking(object),
-                            FILC_WORD_SIZE), origin);
-            FILC_ASSERT(filc_object_aux_ptr(object)
-                        == filc_object_special_payload_with_manual_tracking(object), origin);
+static bool weak_target_is_marked(filc_object* object)
+{
+    filc_object_flags flags = filc_object_get_flags(object);
+    if ((flags & FILC_OBJECT_FLAG_GLOBAL))
+        return true;
+    return verse_heap_is_marked(filc_object_mark_base_with_flags(object, flags));
+}
+
+/* Handing out the target of a weak creates a strong reference that marking might not know about.
+   While we're marking, the store barrier takes care of that, since it marks the target and puts it
+   on our mark stack. But once marking is over, there's nobody left to trace from the target, so
+   handing out an unmarked target then would mean handing out an object that is about to be swept.
+
+   That's why the collector freezes the weaks when it thinks it's done marking. After that, gets
+   never barrier an unmarked target. They clear the weak instead, just like the collector is about
+   to. The collector then handshakes and drains once more to pick up whatever got barriered before
+   the freeze, and then clears the dead weaks and unfreezes. */
+filc_ptr filc_weak_get_with_manual_tracking(filc_thread* my_thread, filc_weak* weak)
+{
+    pas_lock_lock(&weak->lock);
+    filc_ptr result = filc_flight_ptr_load_with_manual_tracking(&weak->target);
+    filc_object* object = filc_ptr_object(result);
+    if (object) {
+        if (weaks_are_frozen && !weak_target_is_marked(object)) {
+            result = filc_ptr_forge_null();
+            filc_flight_ptr_store_without_barrier(&weak->target, result);
+        } else
+            filc_store_barrier(my_thread, object);
+    }
+    pas_lock_unlock(&weak->lock);
+    return result;
+}
+
+bool filc_freeze_weaks(void)
+{
+    PAS_ASSERT(filc_is_marking);
+    PAS_ASSERT(!weaks_are_frozen);
+    pas_lock_lock(&weak_list_lock);
+    bool result = !!num_weaks;
+    pas_lock_unlock(&weak_list_lock);
+    if (result) {
+        pas_store_store_fence();
+        weaks_are_frozen = true;
+    }
+    return result;
+}
+
+void filc_clear_dead_weaks(void)
+{
+    static const bool verbose = false;
+    PAS_ASSERT(filc_is_marking);
+    pas_lock_lock(&weak_list_lock);
+    filc_weak* weak;
+    size_t num_cleared = 0;
+    for (weak = first_weak; weak; weak = weak->next) {
+        pas_lock_lock(&weak->lock);
+        filc_object* object = filc_ptr_object(
+            filc_flight_ptr_load_with_manual_tracking(&weak->target));
+        if (object && !weak_target_is_marked(object)) {
+            filc_flight_ptr_store_without_barrier(&weak->target, filc_ptr_forge_null());
+            num_cleared++;
+        }
+        pas_lock_unlock(&weak->lock);
+    }
+    if (verbose)
+        pas_log("Cleared %zu out of %zu weaks.\n", num_cleared, num_weaks);
+    weaks_are_frozen = false;
+    pas_lock_unlock(&weak_list_lock);
+}
+
+filc_ptr filc_native_zweak_new(filc_thread* my_thread, filc_ptr target)
+{
+    return filc_ptr_for_special_payload_with_manual_tracking(filc_weak_create(my_thread, target));
+}
+
+filc_ptr filc_native_zweak_get(filc_thread* my_thread, filc_ptr weak_ptr)
+{
+    filc_check_access_special(weak_ptr, FILC_SPECIAL_TYPE_WEAK);
+    return filc_weak_get_with_manual_tracking(my_thread, (filc_weak*)filc_ptr_ptr(weak_ptr));
+}
+
+filc_arena* filc_arena_create(filc_thread* my_thread)
+{
+    filc_arena* result = (filc_arena*)
+        filc_object_special_payload_with_manual_tracking(
+            filc_allocate_special(my_thread, sizeof(filc_arena), 1, FILC_SPECIAL_TYPE_ARENA));
+
+    pas_lock_construct(&result->lock);
+    result->is_destroyed = false;
+    filc_object_array_construct(&result->objects);
+    return result;
+}
+
+void filc_arena_destruct(filc_arena* arena)
+{
+    filc_object_array_destruct(&arena->objects);
+}
+
+void filc_arena_mark_outgoing_ptrs(filc_arena* arena, filc_object_array* stack)
+{
+    pas_lock_lock(&arena->lock);
+    filc_object_array_chunk* chunk;
+    for (chunk = arena->objects.top; chunk; chunk = chunk->next) {
+        size_t index;
+        /* Note that this marks the objects even if they're free, since destroying an arena frees
+           its objects without taking the lock. */
+        for (index = chunk->num_objects; index--;)
+            fugc_mark(stack, chunk->objects[index]);
+    }
+    pas_lock_unlock(&arena->lock);
+}
+
+filc_ptr filc_native_zarena_new(filc_thread* my_thread)
+{
+    return filc_ptr_for_special_payload_with_manual_tracking(filc_arena_create(my_thread));
+}
+
+filc_ptr filc_native_zarena_alloc(filc_thread* my_thread, filc_ptr arena_ptr, size_t size)
+{
+    filc_check_access_special(arena_ptr, FILC_SPECIAL_TYPE_ARENA);
+    filc_arena* arena = (filc_arena*)filc_ptr_ptr(arena_ptr);
+
+    /* Allocate before grabbing the lock, since allocation might exit. */
+    filc_object* result = filc_allocate(my_thread, size);
+
+    pas_lock_lock(&arena->lock);
+    FILC_CHECK(
+        !arena->is_destroyed,
+        NULL,
+        "cannot allocate in destroyed arena %s.",
+        filc_ptr_to_new_string(arena_ptr));
+    filc_object_array_push(&arena->objects, result);
+    /* The arena might already have been marked, so the object has to get marked on its behalf. */
+    filc_store_barrier(my_thread, result);
+    pas_lock_unlock(&arena->lock);
+
+    return filc_ptr_create_with_object_and_manual_tracking(result);
+}
+
+void filc_native_zarena_destroy(filc_thread* my_thread, filc_ptr arena_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    filc_check_access_special(arena_ptr, FILC_SPECIAL_TYPE_ARENA);
+    filc_arena* arena = (filc_arena*)filc_ptr_ptr(arena_ptr);
+
+    pas_lock_lock(&arena->lock);
+    FILC_CHECK(
+        !arena->is_destroyed,
+        NULL,
+        "cannot destroy already destroyed arena %s.",
+        filc_ptr_to_new_string(arena_ptr));
+    arena->is_destroyed = true;
+    pas_lock_unlock(&arena->lock);
+
+    /* Nobody can push anymore, so we can walk the list without the lock. We have to not hold it
+       anyway, since freeing a big object exits. The objects stay on the list until we're done, so
+       that the GC keeps them alive while we free them. */
+    filc_object_array_chunk* chunk;
+    for (chunk = arena->objects.top; chunk; chunk = chunk->next) {
+        size_t index;
+        for (index = chunk->num_objects; index--;) {
+            filc_object* object = chunk->objects[index];
+            /* The program may have already freed some of these itself. */
+            if (!(filc_object_get_flags(object) & FILC_OBJECT_FLAG_FREE))
+                filc_free(object);
+        }
+    }
+
+    pas_lock_lock(&arena->lock);
+    filc_object_array_reset(&arena->objects);
+    pas_lock_unlock(&arena->lock);
+}
+
+#define FILC_FIBER_DEFAULT_STACK_SIZE ((size_t)131072)
+#define FILC_FIBER_MIN_STACK_SIZE     ((size_t)65536)
+
+static filc_fiber* fiber_allocate(filc_thread* my_thread)
+{
+    filc_fiber* result = (filc_fiber*)
+        filc_object_special_payload_with_manual_tracking(
+            filc_allocate_special(my_thread, sizeof(filc_fiber), 1, FILC_SPECIAL_TYPE_FIBER));
+    pas_zero_memory(result, sizeof(filc_fiber));
+    result->carrier = my_thread;
+    return result;
+}
+
+static filc_fiber* get_current_fiber(filc_thread* my_thread)
+{
+    if (my_thread->current_fiber)
+        return my_thread->current_fiber;
+
+    /* The first time a thread uses fibers, the code it's already running becomes its root fiber.
+       The root fiber's stack is the thread's own stack, so it never gets freed, and it never
+       finishes, since the thread's main function returning ends the thread. */
+    filc_fiber* root = fiber_allocate(my_thread);
+    my_thread->root_fiber = root;
+    my_thread->current_fiber = root;
+    return root;
+}
+
+static void add_suspended_fiber(filc_thread* my_thread, filc_fiber* fiber)
+{
+    PAS_ASSERT(!fiber->prev_suspended);
+    PAS_ASSERT(!fiber->next_suspended);
+    PAS_ASSERT(my_thread->first_suspended_fiber != fiber);
+    fiber->next_suspended = my_thread->first_suspended_fiber;
+    if (fiber->next_suspended)
+        fiber->next_suspended->prev_suspended = fiber;
+    my_thread->first_suspended_fiber = fiber;
+}
+
+static void remove_suspended_fiber(filc_thread* my_thread, filc_fiber* fiber)
+{
+    if (fiber->prev_suspended)
+        fiber->prev_suspended->next_suspended = fiber->next_suspended;
+    else {
+        PAS_ASSERT(my_thread->first_suspended_fiber == fiber);
+        my_thread->first_suspended_fiber = fiber->next_suspended;
+    }
+    if (fiber->next_suspended)
+        fiber->next_suspended->prev_suspended = fiber->prev_suspended;
+    fiber->prev_suspended = NULL;
+    fiber->next_suspended = NULL;
+}
+
+static void free_fiber_stack(filc_fiber* fiber)
+{
+    if (!fiber->stack)
+        return;
+    pas_page_malloc_deallocate(fiber->stack, fiber->stack_size);
+    fiber->stack = NULL;
+    fiber->stack_size = 0;
+}
+
+static void reap_finished_fiber(filc_thread* my_thread)
+{
+    filc_fiber* fiber = my_thread->fiber_to_reap;
+    if (!fiber)
+        return;
+    /* The GC can't have destructed the fiber yet, since it was the current fiber when this thread
+       last scanned its roots, and we haven't pollchecked since it finished. */
+    PAS_ASSERT(fiber->is_done);
+    my_thread->fiber_to_reap = NULL;
+    free_fiber_stack(fiber);
+}
+
+/* Callers have to have already put from on the suspended list (unless it's done) and taken to off
+   of it. There's no pollcheck or exit in here, so neither the GC nor the soft handshake can see the
+   carrier in the middle of a switch. */
+static void switch_fiber(filc_thread* my_thread, filc_fiber* from, filc_fiber* to)
+{
+    PAS_ASSERT(my_thread->current_fiber == from);
+    PAS_ASSERT(to->carrier == my_thread);
+    PAS_ASSERT(!to->is_done);
+
+    from->stack_limit = my_thread->stack_limit;
+    from->top_frame = my_thread->top_frame;
+    from->top_native_frame = my_thread->top_native_frame;
+
+    my_thread->stack_limit = to->stack_limit;
+    my_thread->top_frame = to->top_frame;
+    my_thread->top_native_frame = to->top_native_frame;
+    my_thread->current_fiber = to;
+    to->top_frame = NULL;
+    to->top_native_frame = NULL;
+
+    filc_fiber_switch_stacks(&from->saved_sp, to->saved_sp);
+
+    /* Now we're running as from again, having been switched to by somebody. */
+    PAS_ASSERT(my_thread->current_fiber == from);
+    reap_finished_fiber(my_thread);
+}
+
+void filc_fiber_start(filc_fiber* fiber)
+{
+    filc_thread* my_thread = fiber->carrier;
+    PAS_ASSERT(my_thread == filc_get_my_thread());
+    PAS_ASSERT(my_thread->current_fiber == fiber);
+    PAS_ASSERT(!my_thread->top_frame);
+    PAS_ASSERT(!my_thread->top_native_frame);
+    reap_finished_fiber(my_thread);
+
+    FILC_DEFINE_FRAME("zfiber_start");
+    filc_push_frame(my_thread, frame);
+
+    filc_native_frame native_frame;
+    filc_push_native_frame(my_thread, &native_frame);
+
+    filc_ptr main_ptr = filc_flight_ptr_load(my_thread, &fiber->main_ptr);
+    filc_ptr arg_ptr = filc_flight_ptr_load(my_thread, &fiber->arg_ptr);
+    filc_flight_ptr_store(my_thread, &fiber->main_ptr, filc_ptr_forge_null());
+    filc_flight_ptr_store(my_thread, &fiber->arg_ptr, filc_ptr_forge_null());
+
+    filc_call_user_void_ptr(my_thread, (pizlonated_function)filc_ptr_ptr(main_ptr), arg_ptr);
+
+    filc_pop_native_frame(my_thread, &native_frame);
+    filc_pop_frame(my_thread, frame);
+    PAS_ASSERT(!my_thread->top_frame);
+    PAS_ASSERT(!my_thread->top_native_frame);
+
+    /* If whoever switched to us last has finished in the meantime, then there's nobody in
+       particular waiting for us, so we go back to the root fiber, which can never be done. */
+    fiber->is_done = true;
+    filc_fiber* target = fiber->resumer;
+    if (!target || target->is_done)
+        target = my_thread->root_fiber;
+    remove_suspended_fiber(my_thread, target);
+    my_thread->fiber_to_reap = fiber;
+    switch_fiber(my_thread, fiber, target);
+
+    PAS_ASSERT(!"Should not get here");
+}
+
+void filc_fiber_destruct(filc_fiber* fiber)
+{
+    free_fiber_stack(fiber);
+}
+
+void filc_fiber_mark_outgoing_ptrs(filc_fiber* fiber, filc_object_array* stack)
+{
+    fugc_mark_or_free_flight(stack, &fiber->main_ptr);
+    fugc_mark_or_free_flight(stack, &fiber->arg_ptr);
+
+    /* The carrier has to outlive its fibers, since nothing but fiber->carrier stops a thread that
+       reuses a dead carrier's address from resuming its unscanned fibers. */
+    fugc_mark(stack, filc_object_for_special_payload(fiber->carrier));
+    filc_fiber* resumer = *(filc_fiber* volatile*)&fiber->resumer;
+    if (resumer)
+        fugc_mark(stack, filc_object_for_special_payload(resumer));
+}
+
+filc_ptr filc_native_zfiber_create(filc_thread* my_thread, filc_ptr main_ptr, filc_ptr arg_ptr,
+                                   size_t stack_size)
+{
+    filc_check_function_call(main_ptr);
+
+    if (!stack_size)
+        stack_size = FILC_FIBER_DEFAULT_STACK_SIZE;
+    size_t page_size = pas_page_malloc_alignment();
+    stack_size = pas_round_up_to_power_of_2(
+        pas_max_uintptr(stack_size, FILC_FIBER_MIN_STACK_SIZE), page_size);
+    PAS_ASSERT(stack_size > stack_slack);
+
+    filc_fiber* fiber = fiber_allocate(my_thread);
+
+    pas_aligned_allocation_result result = pas_page_malloc_try_allocate_without_deallocating_padding(
+        stack_size + page_size, pas_alignment_create_trivial(), pas_committed);
+    if (!result.result) {
+        filc_set_errno(ENOMEM);
+        return filc_ptr_forge_null();
+    }
+    PAS_ASSERT(!result.left_padding_size);
+    PAS_ASSERT(!result.right_padding_size);
+    pas_page_malloc_protect_reservation((char*)result.result, page_size);
+    fiber->stack = (char*)result.result;
+    fiber->stack_size = stack_size + page_size;
+
+    char* stack_top = fiber->stack + fiber->stack_size;
+    fiber->stack_limit = stack_top - stack_size + stack_slack;
+
+    /* Lay out what filc_fiber_switch_stacks() would have saved, so that switching to the fiber
+       resumes into filc_fiber_entry() with the fiber in r12 and the stack 16-byte aligned. The
+       first word is the default mxcsr in the low half and the default x87 control word in the
+       high half. */
+    uintptr_t* sp = (uintptr_t*)stack_top - 8;
+    sp[0] = ((uintptr_t)0x037f << 32) | 0x1f80;
+    sp[1] = 0; /* r15 */
+    sp[2] = 0; /* r14 */
+    sp[3] = 0; /* r13 */
+    sp[4] = (uintptr_t)fiber; /* r12 */
+    sp[5] = 0; /* rbx */
+    sp[6] = 0; /* rbp */
+    sp[7] = (uintptr_t)filc_fiber_entry;
+    fiber->saved_sp = sp;
+
+    filc_flight_ptr_store(my_thread, &fiber->main_ptr, main_ptr);
+    filc_flight_ptr_store(my_thread, &fiber->arg_ptr, arg_ptr);
+
+    get_current_fiber(my_thread);
+    add_suspended_fiber(my_thread, fiber);
+    return filc_ptr_for_special_payload_with_manual_tracking(fiber);
+}
+
+void filc_native_zfiber_switch(filc_thread* my_thread, filc_ptr fiber_ptr)
+{
+    filc_check_access_special(fiber_ptr, FILC_SPECIAL_TYPE_FIBER);
+    filc_fiber* to = (filc_fiber*)filc_ptr_ptr(fiber_ptr);
+    FILC_CHECK(
+        to->carrier == my_thread,
+        NULL,
+        "cannot switch to fiber %s, which belongs to another thread.",
+        filc_ptr_to_new_string(fiber_ptr));
+    FILC_CHECK(
+        !to->is_done,
+        NULL,
+        "cannot switch to fiber %s, which is done.",
+        filc_ptr_to_new_string(fiber_ptr));
+
+    filc_fiber* from = get_current_fiber(my_thread);
+    if (from == to)
+        return;
+
+    remove_suspended_fiber(my_thread, to);
+    add_suspended_fiber(my_thread, from);
+    filc_store_barrier(my_thread, filc_object_for_special_payload(from));
+    to->resumer = from;
+    switch_fiber(my_thread, from, to);
+}
+
+filc_ptr filc_native_zfiber_self(filc_thread* my_thread)
+{
+    return filc_ptr_for_special_payload_with_manual_tracking(get_current_fiber(my_thread));
+}
+
+bool filc_native_zfiber_is_done(filc_thread* my_thread, filc_ptr fiber_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    filc_check_access_special(fiber_ptr, FILC_SPECIAL_TYPE_FIBER);
+    return ((filc_fiber*)filc_ptr_ptr(fiber_ptr))->is_done;
+}
+
+size_t filc_native_ztesting_get_num_ptrtables(filc_thread* my_thread)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    return num_ptrtables;
+}
+
+void filc_validate_object(filc_object* object, const filc_origin* origin)
+{
+    if (object == &filc_free_singleton) {
+        FILC_ASSERT(!filc_object_size_not_null(object), origin);
+        FILC_ASSERT(object->aux == filc_aux_create(FILC_OBJECT_FLAG_FREE |
+                                                   FILC_OBJECT_FLAG_GLOBAL |
+                                                   FILC_OBJECT_FLAG_READONLY,
+                                                   NULL), origin);
+        return;
+    }
+
+    if (filc_object_is_special(object)) {
+        FILC_CHECK(
+            !filc_object_size_not_null(object),
+            origin,
+            "special object has non-null size (object = %s, object at %p, upper = %p)",
+            filc_object_to_new_string(object), object, object->upper);
+        FILC_ASSERT(filc_special_type_is_valid(filc_object_special_type(object)), origin);
+        if (filc_object_special_type(object) != FILC_SPECIAL_TYPE_FUNCTION &&
+            filc_object_special_type(object) != FILC_SPECIAL_TYPE_DL_HANDLE) {
+            FILC_ASSERT(pas_is_aligned(
+                            (uintptr_t)filc_object_special_payload_with_manual_tracking(object),
+                            FILC_WORD_SIZE), origin);
+            FILC_ASSERT(filc_object_aux_ptr(object)
+                        == filc_object_special_payload_with_manual_tracking(object), origin);
         }
         return;
     }
@@ -3050,26 +4458,22 @@ PAS_NO_RETURN PAS_NEVER_INLINE static void memset_fail(
     PAS_UNREACHABLE();
 }
 
-PAS_ALWAYS_INLINE static void nuke_aux_entry(char* aux_ptr, size_t offset)
-{
-    filc_lower_or_box* lower_or_box_ptr = (filc_lower_or_box*)(aux_ptr + offset);
-    filc_lower_or_box_store_unfenced_unbarriered(
-        lower_or_box_ptr, filc_lower_or_box_create_lower(NULL));
-}
-
-PAS_ALWAYS_INLINE static void nuke_aux_range(filc_thread* my_thread, char* aux_ptr,
+PAS_ALWAYS_INLINE static void nuke_aux_range(filc_thread* my_thread, filc_object* object,
+                                             char* aux_ptr,
                                              size_t aligned_start_offset, size_t aligned_end_offset,
                                              filc_size_mode size_mode)
 {
-    if (size_mode == filc_large_size)
-        filc_exit(my_thread);
+    if (size_mode == filc_small_size) {
+        size_t offset;
+        for (offset = aligned_start_offset; offset < aligned_end_offset; offset += FILC_WORD_SIZE)
+            nuke_aux_entry(aux_ptr, offset);
+        return;
+    }
 
-    size_t offset;
-    for (offset = aligned_start_offset; offset < aligned_end_offset; offset += FILC_WORD_SIZE)
-        nuke_aux_entry(aux_ptr, offset);
-    
-    if (size_mode == filc_large_size)
-        filc_enter(my_thread);
+    bool can_decommit = !(filc_object_get_flags(object) & FILC_OBJECT_FLAG_GLOBAL);
+    filc_exit(my_thread);
+    nuke_aux_range_large(aux_ptr, aligned_start_offset, aligned_end_offset, can_decommit);
+    filc_enter(my_thread);
 }
 
 PAS_ALWAYS_INLINE static void memset_impl_specialized(filc_thread* my_thread, filc_ptr ptr,
@@ -3086,14 +4490,26 @@ PAS_ALWAYS_INLINE static void memset_impl_specialized(filc_thread* my_thread, fi
         memset_fail(ptr, count, origin);
 
     char* lower = (char*)filc_object_lower(object);
-    char* upper = (char*)filc_object_upper(object);
-    CHECK_BOUNDS_FAST(raw_ptr, lower, upper, count, memset_fail(ptr, count, origin));
-    CHECK_WRITE_FAST(object, memset_fail(ptr, count, origin));
+    CHECK_WRITE_BOUNDS_FAST(raw_ptr, lower, (char*)filc_object_write_upper_not_null(object), count,
+                            memset_fail(ptr, count, origin));
 
     if (size_mode == filc_small_size)
         filc_memset_small(raw_ptr, value, count);
-    else
-        filc_memset_with_exit(my_thread, raw_ptr, value, count);
+    else {
+        /* We stay entered and pollcheck between strips, rather than exiting around the whole thing.
+           If the pollcheck ran a handshake, then the object might have been freed or munmapped, so
+           we have to recheck before touching it again. */
+        size_t offset = 0;
+        for (;;) {
+            size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, count - offset);
+            memset(raw_ptr + offset, value, step);
+            offset += step;
+            if (offset >= count)
+                break;
+            if (PAS_UNLIKELY(filc_pollcheck(my_thread, origin)))
+                CHECK_ACCESSIBLE_FAST(object, memset_fail(ptr, count, origin));
+        }
+    }
 
     char* aux_ptr = filc_object_aux_ptr(object);
     if (!aux_ptr)
@@ -3103,7 +4519,8 @@ PAS_ALWAYS_INLINE static void memset_impl_specialized(filc_thread* my_thread, fi
     size_t end_offset = start_offset + count;
     size_t aligned_start_offset = pas_round_down_to_power_of_2(start_offset, FILC_WORD_SIZE);
     size_t aligned_end_offset = pas_round_up_to_power_of_2(end_offset, FILC_WORD_SIZE);
-    nuke_aux_range(my_thread, aux_ptr, aligned_start_offset, aligned_end_offset, size_mode);
+    nuke_aux_range(my_thread, object, aux_ptr, aligned_start_offset, aligned_end_offset,
+                   size_mode);
 }
 
 PAS_NEVER_INLINE static void memset_large(filc_thread* my_thread, filc_ptr ptr, unsigned value,
@@ -3190,6 +4607,77 @@ static PAS_ALWAYS_INLINE void memmove_smidgen(memmove_smidgen_part part, char* d
     PAS_ASSERT(!"Bad part");
 }
 
+#define MEMMOVE_AUX_BLOCK_NUM_WORDS ((size_t)4)
+
+/* Copies as much of the aux range as it can in blocks of MEMMOVE_AUX_BLOCK_NUM_WORDS entries, and
+   leaves the rest for the word-at-a-time loop. This only works when we already have a dst aux.
+
+   We can't use vector loads and stores here, since every aux entry has to be read and written
+   atomically (a concurrent store to the same slot must not tear). But we can load the whole block
+   up front and OR the entries together. That tells us, with a single branch per block, whether the
+   block is all NULL (common for sparse ptr arrays, so there's nothing to barrier) and whether there
+   are any boxes (rare, so only then do we pay for unboxing). Loading the whole block before storing
+   any of it is fine for overlapping ranges, as long as blocks go in the memmove direction. */
+PAS_ALWAYS_INLINE static void memmove_aux_blocks(filc_thread* my_thread,
+                                                 char* dst_aux_ptr,
+                                                 char* src_aux_ptr,
+                                                 size_t dst_start_offset,
+                                                 size_t dst_end_offset,
+                                                 size_t* dst_offset_ptr,
+                                                 size_t* src_offset_ptr,
+                                                 bool do_barrier,
+                                                 bool is_up)
+{
+    static const size_t block_size = MEMMOVE_AUX_BLOCK_NUM_WORDS * FILC_WORD_SIZE;
+    size_t dst_offset = *dst_offset_ptr;
+    size_t src_offset = *src_offset_ptr;
+    for (;;) {
+        if (is_up) {
+            if (dst_end_offset - dst_offset < block_size)
+                break;
+        } else {
+            if (dst_offset - dst_start_offset < block_size)
+                break;
+            dst_offset -= block_size;
+            src_offset -= block_size;
+        }
+        filc_lower_or_box values[MEMMOVE_AUX_BLOCK_NUM_WORDS];
+        uintptr_t combined = 0;
+        size_t index;
+        for (index = 0; index < MEMMOVE_AUX_BLOCK_NUM_WORDS; ++index) {
+            values[index] = filc_lower_or_box_load_unfenced(
+                (filc_lower_or_box*)(src_aux_ptr + src_offset + index * FILC_WORD_SIZE));
+            combined |= values[index].encoded_value;
+        }
+        if (PAS_UNLIKELY(combined & FILC_ATOMIC_BOX_BIT)) {
+            for (index = 0; index < MEMMOVE_AUX_BLOCK_NUM_WORDS; ++index) {
+                values[index] = filc_lower_or_box_create_lower(
+                    filc_lower_or_box_extract_lower(values[index]));
+            }
+        }
+        if (do_barrier && combined) {
+            for (index = 0; index < MEMMOVE_AUX_BLOCK_NUM_WORDS; ++index) {
+                if (!filc_lower_or_box_is_null(values[index])) {
+                    fugc_mark(&my_thread->mark_stack,
+                              filc_object_for_lower_not_null(
+                                  filc_lower_or_box_get_lower(values[index])));
+                }
+            }
+        }
+        for (index = 0; index < MEMMOVE_AUX_BLOCK_NUM_WORDS; ++index) {
+            filc_lower_or_box_store_unfenced_unbarriered(
+                (filc_lower_or_box*)(dst_aux_ptr + dst_offset + index * FILC_WORD_SIZE),
+                values[index]);
+        }
+        if (is_up) {
+            dst_offset += block_size;
+            src_offset += block_size;
+        }
+    }
+    *dst_offset_ptr = dst_offset;
+    *src_offset_ptr = src_offset;
+}
+
 PAS_ALWAYS_INLINE static void memmove_aux_loop_body(filc_thread* my_thread,
                                                     char** dst_aux_ptr,
                                                     char* src_aux_ptr,
@@ -3199,6 +4687,7 @@ PAS_ALWAYS_INLINE static void memmove_aux_loop_body(filc_thread* my_thread,
                                                     bool do_barrier,
                                                     bool has_dst_aux,
                                                     filc_object* dst_object,
+                                                    filc_object* src_object,
                                                     bool is_up)
 {
     PAS_TESTING_ASSERT(dst_end_offset >= dst_start_offset);
@@ -3216,6 +4705,10 @@ PAS_ALWAYS_INLINE static void memmove_aux_loop_body(filc_thread* my_thread,
         dst_offset = dst_end_offset;
         src_offset = src_start_offset + (dst_end_offset - dst_start_offset);
     }
+    if (has_dst_aux) {
+        memmove_aux_blocks(my_thread, *dst_aux_ptr, src_aux_ptr, dst_start_offset, dst_end_offset,
+                           &dst_offset, &src_offset, do_barrier, is_up);
+    }
     for (;;) {
         if (is_up) {
             if (dst_offset >= dst_end_offset) {
@@ -3235,9 +4728,13 @@ PAS_ALWAYS_INLINE static void memmove_aux_loop_body(filc_thread* my_thread,
         void* lower = filc_lower_or_box_extract_lower(src_lower_or_box);
         bool do_store = true;
         if (!has_dst_aux && !*dst_aux_ptr) {
-            if (lower)
+            if (lower) {
                 *dst_aux_ptr = filc_object_ensure_aux_ptr(my_thread, dst_object);
-            else
+                /* Creating the aux might have exited, and FUGC detaches auxes that it finds empty.
+                   If that happened to the source, then there's nothing left to copy. */
+                if (src_object && filc_object_aux_ptr(src_object) != src_aux_ptr)
+                    return;
+            } else
                 do_store = false;
         }
         if (do_store) {
@@ -3288,7 +4785,7 @@ PAS_ALWAYS_INLINE static void memmove_aux_loop(filc_thread* my_thread,
     case filc_small_size:
         memmove_aux_loop_body(my_thread, &dst_aux_ptr, src_aux_ptr,
                               dst_start_offset, src_start_offset, dst_end_offset,
-                              do_barrier, has_dst_aux, dst_object, is_up);
+                              do_barrier, has_dst_aux, dst_object, src_object, is_up);
         break;
 
     case filc_large_size: {
@@ -3336,18 +4833,18 @@ PAS_ALWAYS_INLINE static void memmove_aux_loop(filc_thread* my_thread,
             PAS_TESTING_ASSERT(pas_is_aligned(current_dst_start_offset, FILC_WORD_SIZE));
             PAS_TESTING_ASSERT(pas_is_aligned(current_dst_end_offset, FILC_WORD_SIZE));
             PAS_TESTING_ASSERT(pas_is_aligned(current_src_start_offset, FILC_WORD_SIZE));
-            if (!has_dst_aux && PAS_UNLIKELY(filc_is_marking)) {
+            if (!has_dst_aux && PAS_UNLIKELY(filc_store_barrier_is_on)) {
                 bool do_barrier = true;
                 memmove_aux_loop_body(my_thread, &dst_aux_ptr, src_aux_ptr,
                                       current_dst_start_offset, current_src_start_offset,
                                       current_dst_end_offset,
-                                      do_barrier, has_dst_aux, dst_object, is_up);
+                                      do_barrier, has_dst_aux, dst_object, src_object, is_up);
             } else {
                 bool do_barrier = false;
                 memmove_aux_loop_body(my_thread, &dst_aux_ptr, src_aux_ptr,
                                       current_dst_start_offset, current_src_start_offset,
                                       current_dst_end_offset,
-                                      do_barrier, has_dst_aux, dst_object, is_up);
+                                      do_barrier, has_dst_aux, dst_object, src_object, is_up);
             }
             if (PAS_UNLIKELY(filc_pollcheck(my_thread, passed_origin))) {
                 /* NOTE: The destination object check isn't strictly necessary for memory safety. */
@@ -3441,13 +4938,15 @@ PAS_NEVER_INLINE static void memmove_aux_small_no_dst(filc_thread* my_thread,
                                                       size_t dst_start_offset,
                                                       size_t src_start_offset,
                                                       size_t dst_end_offset,
-                                                      filc_object* dst_object)
+                                                      filc_object* dst_object,
+                                                      filc_object* src_object)
 {
     bool do_barrier = false;
     bool has_dst_aux = false;
     memmove_aux_barrier_specialized(my_thread, dst_aux_ptr, src_aux_ptr,
                                     dst_start_offset, src_start_offset, dst_end_offset,
-                                    filc_small_size, do_barrier, has_dst_aux, dst_object, NULL, NULL);
+                                    filc_small_size, do_barrier, has_dst_aux, dst_object,
+                                    src_object, NULL);
 }
 
 PAS_NEVER_INLINE static void memmove_aux_large_no_dst(filc_thread* my_thread,
@@ -3468,6 +4967,80 @@ PAS_NEVER_INLINE static void memmove_aux_large_no_dst(filc_thread* my_thread,
                                     passed_origin);
 }
 
+/* Large moves where both objects have aux and the offsets are in phase, which is what relocating a
+   big array of ptrs (std::vector<T*> growth, std::deque block moves) looks like. Rather than moving
+   all of the payload and then walking all of the aux, we move each strip's payload and then its aux
+   before we pollcheck, so we make one pass over memory instead of two. Each strip's aux range
+   starts at the first word that starts inside the strip's payload, so together they cover the aux
+   range exactly once. The block copy in memmove_aux_blocks takes care of skipping the per-entry
+   work for the common case of no boxes and no barrier.
+
+   We don't use non-temporal stores for the aux, since the collector reads it concurrently and
+   non-temporal stores aren't ordered with the fences that pollchecks rely on. The libc memmove
+   already picks non-temporal stores for the payload once the strip is big enough to want them. */
+PAS_NEVER_INLINE static void memmove_large_in_phase_with_aux(filc_thread* my_thread,
+                                                             filc_ptr dst, filc_ptr src,
+                                                             size_t count,
+                                                             filc_object* dst_object,
+                                                             filc_object* src_object,
+                                                             char* dst_aux_ptr,
+                                                             char* src_aux_ptr,
+                                                             const filc_origin* origin)
+{
+    char* dst_start = filc_ptr_ptr(dst);
+    char* src_start = filc_ptr_ptr(src);
+    size_t dst_start_offset = dst_start - (char*)filc_object_lower(dst_object);
+    size_t src_start_offset = src_start - (char*)filc_object_lower(src_object);
+    size_t dst_end_offset = dst_start_offset + count;
+    size_t aux_end_offset = pas_round_down_to_power_of_2(dst_end_offset, FILC_WORD_SIZE);
+    bool is_up = dst_start < src_start;
+    bool has_dst_aux = true;
+
+    PAS_ASSERT(pas_is_aligned(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, FILC_WORD_SIZE));
+
+    memmove_smidgen(is_up ? memmove_lower_smidgen : memmove_upper_smidgen,
+                    dst_aux_ptr, dst_start_offset, dst_end_offset, has_dst_aux);
+
+    size_t offset = 0;
+    for (;;) {
+        size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, count - offset);
+        size_t strip_offset = is_up ? offset : count - offset - step;
+        memmove(dst_start + strip_offset, src_start + strip_offset, step);
+
+        size_t aux_start_offset = pas_min_uintptr(
+            pas_round_up_to_power_of_2(dst_start_offset + strip_offset, FILC_WORD_SIZE),
+            aux_end_offset);
+        size_t aux_strip_end_offset = pas_min_uintptr(
+            pas_round_up_to_power_of_2(dst_start_offset + strip_offset + step, FILC_WORD_SIZE),
+            aux_end_offset);
+        if (aux_strip_end_offset > aux_start_offset) {
+            size_t aux_src_start_offset = aux_start_offset - dst_start_offset + src_start_offset;
+            if (PAS_UNLIKELY(filc_store_barrier_is_on)) {
+                bool do_barrier = true;
+                memmove_aux_loop_body(my_thread, &dst_aux_ptr, src_aux_ptr,
+                                      aux_start_offset, aux_src_start_offset, aux_strip_end_offset,
+                                      do_barrier, has_dst_aux, dst_object, src_object, is_up);
+            } else {
+                bool do_barrier = false;
+                memmove_aux_loop_body(my_thread, &dst_aux_ptr, src_aux_ptr,
+                                      aux_start_offset, aux_src_start_offset, aux_strip_end_offset,
+                                      do_barrier, has_dst_aux, dst_object, src_object, is_up);
+            }
+        }
+
+        offset += step;
+        if (offset >= count)
+            break;
+        if (PAS_UNLIKELY(filc_pollcheck(my_thread, origin))) {
+            CHECK_ACCESSIBLE_FAST(src_object, memmove_fail(dst, src, count, origin));
+            CHECK_ACCESSIBLE_FAST(dst_object, memmove_fail(dst, src, count, origin));
+        }
+    }
+
+    memmove_smidgen(is_up ? memmove_upper_smidgen : memmove_lower_smidgen,
+                    dst_aux_ptr, dst_start_offset, dst_end_offset, has_dst_aux);
+}
+
 /* Assumes that the dst/src are tracked by GC. Assumes that count is nonzero. */
 PAS_ALWAYS_INLINE static void memmove_impl_size_specialized(filc_thread* my_thread, filc_ptr dst,
                                                             filc_ptr src, size_t count,
@@ -3496,23 +5069,53 @@ PAS_ALWAYS_INLINE static void memmove_impl_size_specialized(filc_thread* my_thre
     char* src_start = filc_ptr_ptr(src);
 
     char* dst_lower = (char*)filc_object_lower(dst_object);
-    char* dst_upper = (char*)filc_object_upper(dst_object);
+    char* dst_write_upper = (char*)filc_object_write_upper_not_null(dst_object);
     char* src_lower = (char*)filc_object_lower(src_object);
     char* src_upper = (char*)filc_object_upper(src_object);
 
-    CHECK_BOUNDS_FAST(dst_start, dst_lower, dst_upper, count, memmove_fail(dst, src, count, origin));
+    CHECK_WRITE_BOUNDS_FAST(dst_start, dst_lower, dst_write_upper, count,
+                            memmove_fail(dst, src, count, origin));
     CHECK_BOUNDS_FAST(src_start, src_lower, src_upper, count, memmove_fail(dst, src, count, origin));
-    CHECK_WRITE_FAST(dst_object, memmove_fail(dst, src, count, origin));
+
+    if (size_mode == filc_large_size) {
+        char* dst_aux_ptr = filc_object_aux_ptr(dst_object);
+        char* src_aux_ptr = filc_object_aux_ptr(src_object);
+        if (dst_aux_ptr && src_aux_ptr
+            && (pas_modulo_power_of_2((uintptr_t)dst_start, FILC_WORD_SIZE) ==
+                pas_modulo_power_of_2((uintptr_t)src_start, FILC_WORD_SIZE))) {
+            memmove_large_in_phase_with_aux(my_thread, dst, src, count, dst_object, src_object,
+                                            dst_aux_ptr, src_aux_ptr, origin);
+            return;
+        }
+    }
 
     if (size_mode == filc_small_size)
         filc_memmove_small(dst_start, src_start, count);
     else {
-        filc_memmove_with_exit(my_thread, dst_start, src_start, count);
-        CHECK_ACCESSIBLE_FAST(src_object, memmove_fail(dst, src, count, origin));
-        CHECK_ACCESSIBLE_FAST(dst_object, memmove_fail(dst, src, count, origin));
-    }
-
-    /* Here are the cases in descending order of nastiness:
+        /* Same deal as memset_impl_specialized: copy in strips and pollcheck in between. Going in
+           strips means that we have to pick the direction ourselves, so that an overlapping move
+           never reads bytes that an earlier strip already overwrote. */
+        bool is_up = dst_start < src_start;
+        size_t offset = 0;
+        for (;;) {
+            size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, count - offset);
+            if (is_up)
+                memmove(dst_start + offset, src_start + offset, step);
+            else {
+                memmove(dst_start + count - offset - step, src_start + count - offset - step,
+                        step);
+            }
+            offset += step;
+            if (offset >= count)
+                break;
+            if (PAS_UNLIKELY(filc_pollcheck(my_thread, origin))) {
+                CHECK_ACCESSIBLE_FAST(src_object, memmove_fail(dst, src, count, origin));
+                CHECK_ACCESSIBLE_FAST(dst_object, memmove_fail(dst, src, count, origin));
+            }
+        }
+    }
+
+    /* Here are the cases in descending order of nastiness:
        
        - Target doesn't have an aux, but the source does, and the offsets are in phase. In that case,
          we have to scan through the source aux until we find a non-NULL lower, and then allocate the
@@ -3526,7 +5129,8 @@ PAS_ALWAYS_INLINE static void memmove_impl_size_specialized(filc_thread* my_thre
          Doesn't matter if we have a barrier in this case. We just nuke the dst aux range.
 
        - Neither has aux. Or, source has aux, the destination does not, but the offsets are out of
-         phase. Then there's just nothing to do. Best case ever! */
+         phase or the destination is shared memory. Then there's just nothing to do. Best case
+         ever! */
     char* dst_aux_ptr = filc_object_aux_ptr(dst_object);
     char* src_aux_ptr = filc_object_aux_ptr(src_object);
     size_t dst_start_offset = dst_start - dst_lower;
@@ -3535,13 +5139,13 @@ PAS_ALWAYS_INLINE static void memmove_impl_size_specialized(filc_thread* my_thre
     if (dst_aux_ptr) {
         if (!src_aux_ptr || (pas_modulo_power_of_2((uintptr_t)dst_start, FILC_WORD_SIZE) !=
                              pas_modulo_power_of_2((uintptr_t)src_start, FILC_WORD_SIZE))) {
-            nuke_aux_range(my_thread, dst_aux_ptr,
+            nuke_aux_range(my_thread, dst_object, dst_aux_ptr,
                            pas_round_down_to_power_of_2(dst_start_offset, FILC_WORD_SIZE),
                            pas_round_up_to_power_of_2(dst_end_offset, FILC_WORD_SIZE),
                            size_mode);
             return;
         }
-        if (size_mode == filc_large_size || PAS_LIKELY(!filc_is_marking)) {
+        if (size_mode == filc_large_size || PAS_LIKELY(!filc_store_barrier_is_on)) {
             /* NOTE: do_barrier is ignored if we're in large_size. */
             bool do_barrier = false;
             bool has_dst_aux = true;
@@ -3556,11 +5160,12 @@ PAS_ALWAYS_INLINE static void memmove_impl_size_specialized(filc_thread* my_thre
         return;
     }
     if (src_aux_ptr && (pas_modulo_power_of_2((uintptr_t)dst_start, FILC_WORD_SIZE) ==
-                        pas_modulo_power_of_2((uintptr_t)src_start, FILC_WORD_SIZE))) {
+                        pas_modulo_power_of_2((uintptr_t)src_start, FILC_WORD_SIZE))
+        && !filc_object_flags_is_shared(filc_object_get_flags(dst_object))) {
         if (size_mode == filc_small_size) {
             memmove_aux_small_no_dst(my_thread, dst_aux_ptr, src_aux_ptr,
                                      dst_start_offset, src_start_offset, dst_end_offset,
-                                     dst_object);
+                                     dst_object, src_object);
             return;
         }
         memmove_aux_large_no_dst(my_thread, dst_aux_ptr, src_aux_ptr,
@@ -3603,6 +5208,260 @@ void filc_memmove(filc_thread* my_thread, filc_ptr dst, filc_ptr src, size_t cou
     memmove_impl(my_thread, dst, src, count, passed_origin);
 }
 
+PAS_NO_RETURN PAS_NEVER_INLINE static void memscan_fail(filc_ptr ptr, size_t count,
+                                                        const filc_origin* passed_origin)
+{
+    filc_thread* my_thread = filc_get_my_thread();
+
+    fix_origin(passed_origin);
+
+    FILC_DEFINE_FRAME("memscan");
+    filc_push_frame(my_thread, frame);
+
+    filc_check_access(ptr, count, filc_read_access);
+    PAS_UNREACHABLE();
+}
+
+/* Returns the object after checking that [ptr, ptr + count) is in bounds. */
+static PAS_ALWAYS_INLINE filc_object* memscan_check(filc_ptr ptr, size_t count,
+                                                    const filc_origin* origin)
+{
+    PAS_TESTING_ASSERT(count);
+    filc_object* object = filc_ptr_object(ptr);
+    if (!object)
+        memscan_fail(ptr, count, origin);
+    CHECK_BOUNDS_FAST((char*)filc_ptr_ptr(ptr), (char*)filc_object_lower(object),
+                      (char*)filc_object_upper(object), count, memscan_fail(ptr, count, origin));
+    return object;
+}
+
+/* The scans go in strips with pollchecks in between, like memmove_impl_size_specialized, so that a
+   huge scan doesn't hold up a handshake. If the pollcheck exited, then the object may have been
+   freed in the meantime. */
+static PAS_ALWAYS_INLINE void memscan_pollcheck(filc_thread* my_thread, filc_object* object,
+                                                filc_ptr ptr, size_t count,
+                                                const filc_origin* origin)
+{
+    if (PAS_UNLIKELY(filc_pollcheck(my_thread, origin)))
+        CHECK_ACCESSIBLE_FAST(object, memscan_fail(ptr, count, origin));
+}
+
+int filc_memcmp(filc_thread* my_thread, filc_ptr a, filc_ptr b, size_t count,
+                const filc_origin* origin)
+{
+    if (!count)
+        return 0;
+    filc_object* a_object = memscan_check(a, count, origin);
+    filc_object* b_object = memscan_check(b, count, origin);
+    char* a_start = (char*)filc_ptr_ptr(a);
+    char* b_start = (char*)filc_ptr_ptr(b);
+    size_t offset = 0;
+    for (;;) {
+        size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, count - offset);
+        int result = memcmp(a_start + offset, b_start + offset, step);
+        if (result)
+            return result;
+        offset += step;
+        if (offset >= count)
+            return 0;
+        memscan_pollcheck(my_thread, a_object, a, count, origin);
+        memscan_pollcheck(my_thread, b_object, b, count, origin);
+    }
+}
+
+filc_ptr filc_memchr(filc_thread* my_thread, filc_ptr ptr, int chr, size_t count,
+                     const filc_origin* origin)
+{
+    if (!count)
+        return filc_ptr_forge_null();
+    /* memchr stops at the first match, so the count may go past the upper bound so long as there's
+       a match before it. Idioms like memchr(ptr, 0, SIZE_MAX) rely on that. */
+    filc_object* object = memscan_check(ptr, 1, origin);
+    char* start = (char*)filc_ptr_ptr(ptr);
+    size_t available = pas_min_uintptr(count, (char*)filc_object_upper(object) - start);
+    size_t offset = 0;
+    for (;;) {
+        size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, available - offset);
+        char* result = (char*)memchr(start + offset, chr, step);
+        if (result)
+            return filc_ptr_with_ptr(ptr, result);
+        offset += step;
+        if (offset >= available)
+            break;
+        memscan_pollcheck(my_thread, object, ptr, count, origin);
+    }
+    if (available < count)
+        memscan_fail(ptr, count, origin);
+    return filc_ptr_forge_null();
+}
+
+filc_ptr filc_memrchr(filc_thread* my_thread, filc_ptr ptr, int chr, size_t count,
+                      const filc_origin* origin)
+{
+    if (!count)
+        return filc_ptr_forge_null();
+    filc_object* object = memscan_check(ptr, count, origin);
+    char* start = (char*)filc_ptr_ptr(ptr);
+    size_t offset = 0;
+    for (;;) {
+        size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, count - offset);
+        char* result = (char*)memrchr(start + count - offset - step, chr, step);
+        if (result)
+            return filc_ptr_with_ptr(ptr, result);
+        offset += step;
+        if (offset >= count)
+            return filc_ptr_forge_null();
+        memscan_pollcheck(my_thread, object, ptr, count, origin);
+    }
+}
+
+filc_ptr filc_memmem(filc_thread* my_thread, filc_ptr haystack, size_t haystack_size,
+                     filc_ptr needle, size_t needle_size, const filc_origin* origin)
+{
+    if (!needle_size)
+        return haystack;
+    if (needle_size > haystack_size)
+        return filc_ptr_forge_null();
+    filc_object* haystack_object = memscan_check(haystack, haystack_size, origin);
+    filc_object* needle_object = memscan_check(needle, needle_size, origin);
+    char* haystack_start = (char*)filc_ptr_ptr(haystack);
+    char* needle_start = (char*)filc_ptr_ptr(needle);
+    /* Each strip looks for matches that start in it, so the strips overlap by needle_size - 1. */
+    size_t num_starts = haystack_size - needle_size + 1;
+    size_t offset = 0;
+    for (;;) {
+        size_t step = pas_min_uintptr(FILC_MAX_BYTES_BETWEEN_POLLCHECKS, num_starts - offset);
+        char* result = (char*)memmem(haystack_start + offset, step + needle_size - 1,
+                                     needle_start, needle_size);
+        if (result)
+            return filc_ptr_with_ptr(haystack, result);
+        offset += step;
+        if (offset >= num_starts)
+            return filc_ptr_forge_null();
+        memscan_pollcheck(my_thread, haystack_object, haystack, haystack_size, origin);
+        memscan_pollcheck(my_thread, needle_object, needle, needle_size, origin);
+    }
+}
+
+PAS_NO_RETURN PAS_NEVER_INLINE static void masked_access_fail(filc_ptr ptr, size_t count,
+                                                             filc_access_kind access_kind,
+                                                             const filc_origin* passed_origin)
+{
+    filc_thread* my_thread = filc_get_my_thread();
+
+    fix_origin(passed_origin);
+
+    FILC_DEFINE_FRAME("masked_access");
+    filc_push_frame(my_thread, frame);
+
+    filc_check_access(ptr, count, access_kind);
+    PAS_UNREACHABLE();
+}
+
+void filc_check_masked_access(filc_ptr ptr, uint64_t lane_mask, size_t lane_size,
+                              filc_access_kind access_kind, const filc_origin* origin)
+{
+    if (!lane_mask)
+        return;
+    size_t first_lane = (size_t)__builtin_ctzll(lane_mask);
+    size_t last_lane = (size_t)(63 - __builtin_clzll(lane_mask));
+    filc_ptr start = filc_ptr_with_offset(ptr, first_lane * lane_size);
+    size_t count = (last_lane - first_lane + 1) * lane_size;
+    filc_object* object = filc_ptr_object(start);
+    if (!object)
+        masked_access_fail(start, count, access_kind, origin);
+    if (access_kind == filc_write_access) {
+        CHECK_WRITE_BOUNDS_FAST((char*)filc_ptr_ptr(start), (char*)filc_object_lower(object),
+                                (char*)filc_object_write_upper_not_null(object), count,
+                                masked_access_fail(start, count, access_kind, origin));
+    } else {
+        CHECK_BOUNDS_FAST((char*)filc_ptr_ptr(start), (char*)filc_object_lower(object),
+                          (char*)filc_object_upper(object), count,
+                          masked_access_fail(start, count, access_kind, origin));
+        CHECK_ACCESSIBLE_FAST(object, masked_access_fail(start, count, access_kind, origin));
+    }
+}
+
+PAS_NO_RETURN PAS_NEVER_INLINE static void deallocate_fail(filc_ptr ptr,
+                                                           const filc_origin* passed_origin)
+{
+    filc_thread* my_thread = filc_get_my_thread();
+
+    fix_origin(passed_origin);
+
+    FILC_DEFINE_FRAME("free");
+    filc_push_frame(my_thread, frame);
+
+    object_for_deallocate(ptr);
+    PAS_UNREACHABLE();
+}
+
+/* Same checks as object_for_deallocate, but the failure reports the caller's origin. */
+static PAS_ALWAYS_INLINE filc_object* deallocate_check(filc_ptr ptr, const filc_origin* origin)
+{
+    filc_object* object = filc_ptr_object(ptr);
+    if (PAS_UNLIKELY(!object
+                     || filc_ptr_ptr(ptr) != filc_ptr_lower(ptr)
+                     || filc_object_is_special(object)
+                     || (filc_object_get_flags(object)
+                         & (FILC_OBJECT_FLAG_GLOBAL | FILC_OBJECT_FLAG_MMAP))))
+        deallocate_fail(ptr, origin);
+    return object;
+}
+
+filc_ptr filc_calloc(filc_thread* my_thread, size_t count, size_t size)
+{
+    size_t total_size;
+    if (PAS_UNLIKELY(__builtin_mul_overflow(count, size, &total_size))) {
+        filc_set_errno(ENOMEM);
+        return filc_ptr_forge_null();
+    }
+    return filc_ptr_create_with_object_and_manual_tracking(filc_allocate(my_thread, total_size));
+}
+
+filc_ptr filc_realloc(filc_thread* my_thread, filc_ptr old_ptr, size_t size,
+                      const filc_origin* origin)
+{
+    if (!filc_ptr_ptr(old_ptr))
+        return filc_ptr_create_with_object_and_manual_tracking(filc_allocate(my_thread, size));
+    return filc_ptr_create_with_object_and_manual_tracking(
+        filc_reallocate(my_thread, deallocate_check(old_ptr, origin), size));
+}
+
+void filc_free_ptr(filc_thread* my_thread, filc_ptr ptr, const filc_origin* origin)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    if (!filc_ptr_ptr(ptr))
+        return;
+    filc_free(deallocate_check(ptr, origin));
+}
+
+/* The cc buffer is split into the inline part and the outline part, so the bulk copies in and out
+   of it are at most two memcpys each. */
+static void copy_from_cc(filc_thread* my_thread, char* dst, size_t size)
+{
+    size_t inline_size = pas_min_uintptr(size, FILC_CC_INLINE_SIZE);
+    memcpy(dst, my_thread->cc_inline_buffer, inline_size);
+    if (size > inline_size)
+        memcpy(dst + inline_size, my_thread->cc_outline_buffer, size - inline_size);
+}
+
+static void copy_to_cc(filc_thread* my_thread, const char* src, size_t size)
+{
+    size_t inline_size = pas_min_uintptr(size, FILC_CC_INLINE_SIZE);
+    memcpy(my_thread->cc_inline_buffer, src, inline_size);
+    if (size > inline_size)
+        memcpy(my_thread->cc_outline_buffer, src + inline_size, size - inline_size);
+}
+
+static void clear_cc_aux(filc_thread* my_thread, size_t size)
+{
+    size_t inline_size = pas_min_uintptr(size, FILC_CC_INLINE_SIZE);
+    pas_zero_memory(my_thread->cc_inline_aux_buffer, inline_size);
+    if (size > inline_size)
+        pas_zero_memory(my_thread->cc_outline_aux_buffer, size - inline_size);
+}
+
 static filc_ptr promote_cc_to_heap(filc_thread* my_thread, size_t size)
 {
     PAS_ASSERT(size <= filc_thread_cc_total_size(my_thread));
@@ -3613,15 +5472,12 @@ static filc_ptr promote_cc_to_heap(filc_thread* my_thread, size_t size)
     /* The calling convention requires that the CC size is always a multiple of word size. */
     PAS_ASSERT(pas_is_aligned(size, FILC_WORD_SIZE));
 
-    filc_object* result_object = allocate_impl(my_thread, size, FILC_OBJECT_FLAG_READONLY);
+    filc_object* result_object = filc_allocate_impl(my_thread, size, FILC_OBJECT_FLAG_READONLY);
     filc_thread_track_object(my_thread, result_object);
 
+    copy_from_cc(my_thread, (char*)filc_object_lower(result_object), size);
+
     size_t offset;
-    for (offset = 0; offset < size; offset += FILC_WORD_SIZE) {
-        *(filc_word*)((char*)filc_object_lower(result_object) + offset) =
-            *(filc_word*)filc_thread_cc_slot_at_offset(my_thread, offset);
-    }
-    
     for (offset = 0; offset < size; offset += FILC_WORD_SIZE) {
         void* lower = filc_lower_or_box_get_lower(
             filc_lower_or_box_load_unfenced(
@@ -3676,13 +5532,17 @@ static size_t demote_cc_from_heap(filc_thread* my_thread, filc_ptr ptr, const fi
     
     filc_thread_ensure_cc_total_buffer(my_thread, available);
 
-    size_t offset;
-    for (offset = 0; offset < available; offset += FILC_WORD_SIZE) {
-        *(filc_word*)filc_thread_cc_slot_at_offset(my_thread, offset) =
-            *(filc_word*)((char*)filc_ptr_ptr(ptr) + offset);
-    }
+    copy_to_cc(my_thread, (char*)filc_ptr_ptr(ptr), available);
 
+    /* Objects that never had a ptr stored into them have no aux, so there's nothing to track and
+       the cc aux is all null. */
     char* aux_ptr = filc_ptr_aux_ptr(ptr);
+    if (!aux_ptr) {
+        clear_cc_aux(my_thread, available);
+        return available;
+    }
+
+    size_t offset;
     for (offset = 0; offset < available; offset += FILC_WORD_SIZE) {
         void* lower;
         if (aux_ptr) {
@@ -3756,7 +5616,11 @@ static char* finish_check_and_get_new_str(char* base, size_t length)
     return result;
 }
 
-char* filc_check_and_get_new_str(filc_ptr str)
+/* Checks that there's a terminated string at str and returns its length. The scan is the host's
+   strnlen, so it's as fast as legacy C's, and it never goes past the upper bound. Note that the
+   string may change after we return, so callers that need the contents have to copy it and check
+   the terminator again. */
+static size_t check_and_get_str_length(filc_ptr str)
 {
     size_t available;
     size_t length;
@@ -3765,7 +5629,12 @@ char* filc_check_and_get_new_str(filc_ptr str)
     length = strnlen((char*)filc_ptr_ptr(str), available);
     FILC_ASSERT(length < available, NULL);
     FILC_ASSERT(length + 1 <= available, NULL);
+    return length;
+}
 
+char* filc_check_and_get_new_str(filc_ptr str)
+{
+    size_t length = check_and_get_str_length(str);
     return finish_check_and_get_new_str((char*)filc_ptr_ptr(str), length);
 }
 
@@ -3787,25 +5656,58 @@ char* filc_check_and_get_new_str_or_null(filc_ptr ptr)
     return NULL;
 }
 
-char* filc_check_and_get_tmp_str(filc_thread* my_thread, filc_ptr ptr)
+static char* finish_check_and_get_tmp_str(filc_thread* my_thread, char* base, size_t length)
 {
-    char* result = filc_check_and_get_new_str(ptr);
+    PAS_TESTING_ASSERT(my_thread == filc_get_my_thread());
+    PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
+
+    filc_native_frame* frame = my_thread->top_native_frame;
+    PAS_TESTING_ASSERT(frame);
+    PAS_TESTING_ASSERT(!frame->locked);
+    PAS_TESTING_ASSERT(frame->str_scratch_used <= FILC_NATIVE_FRAME_STR_SCRATCH_SIZE);
+
+    if (length < FILC_NATIVE_FRAME_STR_SCRATCH_SIZE - frame->str_scratch_used) {
+        char* result = frame->str_scratch + frame->str_scratch_used;
+        memcpy(result, base, length + 1);
+        FILC_ASSERT(!result[length], NULL);
+        frame->str_scratch_used += length + 1;
+        return result;
+    }
+
+    char* result = finish_check_and_get_new_str(base, length);
     filc_defer_bmalloc_deallocate(my_thread, result);
     return result;
 }
 
+char* filc_check_and_get_tmp_str(filc_thread* my_thread, filc_ptr ptr)
+{
+    size_t length = check_and_get_str_length(ptr);
+
+    /* Readonly globals can neither be written nor freed, so the terminator we just found will still
+       be there when the kernel looks at the string. */
+    filc_object_flags flags = filc_object_get_flags(filc_ptr_object(ptr));
+    if ((flags & FILC_OBJECT_FLAG_GLOBAL) && (flags & FILC_OBJECT_FLAG_READONLY))
+        return (char*)filc_ptr_ptr(ptr);
+
+    return finish_check_and_get_tmp_str(my_thread, (char*)filc_ptr_ptr(ptr), length);
+}
+
 char* filc_check_and_get_tmp_str_for_valid_range(filc_thread* my_thread, char* base, size_t size)
 {
-    char* result = filc_check_and_get_new_str_for_valid_range(base, size);
-    filc_defer_bmalloc_deallocate(my_thread, result);
-    return result;
+    size_t length;
+    FILC_ASSERT(size, NULL);
+    length = strnlen(base, size);
+    FILC_ASSERT(length < size, NULL);
+    FILC_ASSERT(length + 1 <= size, NULL);
+
+    return finish_check_and_get_tmp_str(my_thread, base, length);
 }
 
 char* filc_check_and_get_tmp_str_or_null(filc_thread* my_thread, filc_ptr ptr)
 {
-    char* result = filc_check_and_get_new_str_or_null(ptr);
-    filc_defer_bmalloc_deallocate(my_thread, result);
-    return result;
+    if (filc_ptr_ptr(ptr))
+        return filc_check_and_get_tmp_str(my_thread, ptr);
+    return NULL;
 }
 
 filc_ptr filc_strdup(filc_thread* my_thread, const char* str)
@@ -3836,17 +5738,19 @@ filc_global_initialization_context* filc_global_initialization_context_create(
         return parent;
     }
 
-    /* Can't exit to grab this lock, because the GC might grab it, and we support running the GC in
-       STW mode.
-       
-       Also, not need to exit to grab this lock, since we don't exit while the lock is held anyway. */
+    /* No need to exit to grab this lock, since we don't exit while the lock is held anyway, and the
+       GC never grabs it (it scans the global roots without it). Threads that find their globals
+       already initialized never get here. */
     filc_global_initialization_lock_lock();
     result = (filc_global_initialization_context*)
         bmalloc_allocate(sizeof(filc_global_initialization_context));
     if (verbose)
         pas_log("new context at %p\n", result);
     result->ref_count = 1;
-    pas_ptr_hash_map_construct(&result->map);
+    filc_global_object_map_construct(&result->map);
+    result->lazy_ctors = NULL;
+    result->profile_start_time = filc_startup_phase_begin();
+    result->first_gptr = NULL;
 
     return result;
 }
@@ -3892,7 +5796,7 @@ bool filc_global_initialization_context_add(
     if (verbose)
         pas_log("object = %s\n", filc_object_to_new_string(object));
 
-    pas_ptr_hash_map_add_result add_result = pas_ptr_hash_map_add(
+    filc_global_object_map_add_result add_result = filc_global_object_map_add(
         &context->map, pizlonated_gptr, NULL, &allocation_config);
     if (!add_result.is_new_entry) {
         if (verbose)
@@ -3905,7 +5809,9 @@ bool filc_global_initialization_context_add(
     if (verbose)
         pas_log("going to initialize object = %s\n", filc_object_to_new_string(object));
 
-    filc_object_array_push(&filc_global_variable_roots, object);
+    add_global_variable_root(object);
+    if (!context->first_gptr)
+        context->first_gptr = pizlonated_gptr;
 
     add_result.entry->key = pizlonated_gptr;
     add_result.entry->value = object;
@@ -3913,6 +5819,8 @@ bool filc_global_initialization_context_add(
     return true;
 }
 
+static void run_lazy_global_ctors(filc_lazy_global_ctors* lazy_ctors);
+
 void filc_global_initialization_context_destroy(filc_global_initialization_context* context)
 {
     static const bool verbose = false;
@@ -3943,9 +5851,34 @@ void filc_global_initialization_context_destroy(filc_global_initialization_conte
 
     bmalloc_initialize_allocation_config(&allocation_config);
 
-    pas_ptr_hash_map_destruct(&context->map, &allocation_config);
+    filc_lazy_global_ctors* lazy_ctors = context->lazy_ctors;
+    double profile_start_time = context->profile_start_time;
+    const void* first_gptr = context->first_gptr;
+
+    filc_global_object_map_destruct(&context->map, &allocation_config);
     bmalloc_deallocate(context);
     filc_global_initialization_lock_unlock();
+
+    filc_startup_phase_end(
+        filc_startup_phase_global_initialization, profile_start_time, first_gptr);
+
+    /* This has to happen after we drop the lock, since the ctors can do anything. The globals that
+       they use are all initialized by now. */
+    if (lazy_ctors)
+        run_lazy_global_ctors(lazy_ctors);
+}
+
+void filc_global_initialization_context_add_lazy_ctors(
+    filc_global_initialization_context* context, filc_lazy_global_ctors* lazy_ctors)
+{
+    PAS_ASSERT(context);
+    PAS_ASSERT(context->ref_count);
+    filc_global_initialization_lock_assert_held();
+    if (lazy_ctors->is_queued)
+        return;
+    lazy_ctors->is_queued = true;
+    lazy_ctors->next = context->lazy_ctors;
+    context->lazy_ctors = lazy_ctors;
 }
 
 static filc_ptr get_constant_value(filc_constant_kind kind, void* target,
@@ -3982,6 +5915,7 @@ void filc_execute_constant_relocations(
     PAS_ASSERT(context);
     if (verbose)
         pas_log("Executing constant relocations!\n");
+    double start_time = filc_startup_phase_begin();
     /* Nothing here needs to be atomic, since the constant doesn't become visible to the universe
        until the initialization context is destroyed. */
     char* payload_ptr = (char*)filc_object_lower(constant);
@@ -4001,6 +5935,23 @@ void filc_execute_constant_relocations(
         filc_lower_or_box_store_unfenced_unbarriered(
             lower_or_box_ptr, filc_lower_or_box_create_lower(filc_ptr_lower(value)));
     }
+    filc_startup_phase_end(filc_startup_phase_constant_relocations, start_time, NULL);
+}
+
+void filc_initialize_module_globals(filc_global_initialization_context* context,
+                                    pizlonated_linker_stub* getters, size_t num_getters)
+{
+    size_t index;
+    PAS_ASSERT(context);
+    PAS_ASSERT(context->ref_count);
+    filc_global_initialization_lock_assert_held();
+    /* Only the outermost initialization pulls in the rest of the module. If we're nested then
+       whoever started this context is either doing that already, or it belongs to another
+       module. */
+    if (context->ref_count != 1)
+        return;
+    for (index = 0; index < num_getters; ++index)
+        getters[index](context);
 }
 
 static bool did_run_deferred_global_ctors = false;
@@ -4018,22 +5969,17 @@ static void run_global_ctor(filc_thread* my_thread, pizlonated_function global_c
     FILC_DEFINE_FRAME("run_global_ctor");
     filc_push_frame(my_thread, frame);
 
+    double start_time = filc_startup_phase_begin();
     filc_call_user_void(my_thread, global_ctor);
+    filc_startup_phase_end(filc_startup_phase_global_ctor, start_time, global_ctor);
 
     filc_pop_frame(my_thread, frame);
 }
 
-void filc_defer_or_run_global_ctor(pizlonated_function global_ctor)
+static void defer_global_ctor(pizlonated_function global_ctor)
 {
-    if (did_run_deferred_global_ctors) {
-        filc_thread* my_thread = filc_get_my_thread();
-        
-        filc_enter(my_thread);
-        run_global_ctor(my_thread, global_ctor);
-        filc_exit(my_thread);
-        return;
-    }
-
+    PAS_ASSERT(!did_run_deferred_global_ctors);
+    
     if (num_deferred_global_ctors >= deferred_global_ctors_capacity) {
         pizlonated_function* new_deferred_global_ctors;
         size_t new_deferred_global_ctors_capacity;
@@ -4056,6 +6002,48 @@ void filc_defer_or_run_global_ctor(pizlonated_function global_ctor)
     deferred_global_ctors[num_deferred_global_ctors++] = global_ctor;
 }
 
+void filc_defer_or_run_global_ctor(pizlonated_function global_ctor)
+{
+    if (did_run_deferred_global_ctors) {
+        filc_thread* my_thread = filc_get_my_thread();
+        
+        filc_enter(my_thread);
+        run_global_ctor(my_thread, global_ctor);
+        filc_exit(my_thread);
+        return;
+    }
+
+    defer_global_ctor(global_ctor);
+}
+
+static void run_lazy_global_ctors(filc_lazy_global_ctors* lazy_ctors)
+{
+    filc_thread* my_thread = filc_get_my_thread();
+    filc_lazy_global_ctors* reversed = NULL;
+
+    /* The context collected them most recent first, but the modules whose globals got initialized
+       first should get their ctors run first. */
+    while (lazy_ctors) {
+        filc_lazy_global_ctors* next = lazy_ctors->next;
+        lazy_ctors->next = reversed;
+        reversed = lazy_ctors;
+        lazy_ctors = next;
+    }
+
+    for (; reversed; reversed = reversed->next) {
+        size_t index;
+        for (index = 0; index < reversed->num_ctors; ++index) {
+            /* If the globals got touched before libc got around to running the deferred ctors,
+               then these ctors just join the queue. Otherwise, we're called from pizlonated code,
+               so we're already entered. */
+            if (did_run_deferred_global_ctors)
+                run_global_ctor(my_thread, reversed->ctors[index]);
+            else
+                defer_global_ctor(reversed->ctors[index]);
+        }
+    }
+}
+
 void filc_run_deferred_global_ctors(filc_thread* my_thread)
 {
     FILC_CHECK(
@@ -4070,6 +6058,8 @@ void filc_run_deferred_global_ctors(filc_thread* my_thread)
     bmalloc_deallocate(deferred_global_ctors);
     num_deferred_global_ctors = 0;
     deferred_global_ctors_capacity = 0;
+    /* Both libc and filc_start_program() call main() right after this. */
+    filc_startup_profiler_did_reach_main();
 }
 
 void filc_run_global_dtor(pizlonated_function global_dtor)
@@ -4116,6 +6106,16 @@ PAS_NEVER_INLINE PAS_NO_RETURN static void panic_impl(
     va_list args)
 {
     fix_origin(origin);
+#if FILC_HAVE_PROBES
+    /* Panics are rare, so formatting the message for the probe is cheap enough even when nothing
+       is attached. */
+    char message[256];
+    va_list message_args;
+    va_copy(message_args, args);
+    pas_vsnprintf(message, sizeof(message), format, message_args);
+    va_end(message_args);
+    FILC_PROBE2(panic, prefix, message);
+#endif /* FILC_HAVE_PROBES */
     pas_log("%s: ", prefix);
     pas_vlog(format, args);
     pas_log("\n");
@@ -4216,7 +6216,50 @@ void filc_native_zerror(filc_thread* my_thread, filc_ptr ptr)
 
 size_t filc_native_zstrlen(filc_thread* my_thread, filc_ptr ptr)
 {
-    return strlen(filc_check_and_get_tmp_str(my_thread, ptr));
+    PAS_UNUSED_PARAM(my_thread);
+    return check_and_get_str_length(ptr);
+}
+
+size_t filc_native_zstrnlen(filc_thread* my_thread, filc_ptr ptr, size_t maxlen)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    if (!maxlen)
+        return 0;
+    filc_check_access(ptr, 1, filc_read_access);
+    size_t available = pas_min_uintptr(filc_ptr_available(ptr), maxlen);
+    size_t length = strnlen((char*)filc_ptr_ptr(ptr), available);
+    /* If we didn't find the terminator before the upper bound, then strnlen would have read past
+       it. */
+    if (length == available)
+        filc_check_access(ptr, maxlen, filc_read_access);
+    return length;
+}
+
+filc_ptr filc_native_zmemchr(filc_thread* my_thread, filc_ptr ptr, int chr, size_t count)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    if (!count)
+        return filc_ptr_forge_null();
+    filc_check_access(ptr, 1, filc_read_access);
+    size_t available = pas_min_uintptr(filc_ptr_available(ptr), count);
+    char* result = (char*)memchr(filc_ptr_ptr(ptr), chr, available);
+    if (result)
+        return filc_ptr_with_ptr(ptr, result);
+    /* memchr stops at the first match, so it's only an error to pass a count that goes past the
+       upper bound if there was no match before it. */
+    filc_check_access(ptr, count, filc_read_access);
+    return filc_ptr_forge_null();
+}
+
+filc_ptr filc_native_zstrchr(filc_thread* my_thread, filc_ptr ptr, int chr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    size_t length = check_and_get_str_length(ptr);
+    /* Searching the terminator too is what makes zstrchr(str, 0) find it. */
+    char* result = (char*)memchr(filc_ptr_ptr(ptr), chr, length + 1);
+    if (!result)
+        return filc_ptr_forge_null();
+    return filc_ptr_with_ptr(ptr, result);
 }
 
 int filc_native_zisdigit(filc_thread* my_thread, int chr)
@@ -4249,38 +6292,102 @@ void filc_native_zgc_request_and_wait(filc_thread* my_thread)
         pas_log("Done with GC.\n");
 }
 
+void filc_native_zgc_collect_async(filc_thread* my_thread)
+{
+    filc_exit(my_thread);
+    fugc_request();
+    filc_enter(my_thread);
+}
+
+bool filc_native_zgc_hint_idle(filc_thread* my_thread, unsigned long long budget_nanoseconds)
+{
+    filc_exit(my_thread);
+    bool result = fugc_hint_idle((double)budget_nanoseconds / 1000000.);
+    filc_enter(my_thread);
+    return result;
+}
+
 bool filc_native_zgc_is_stw(filc_thread* my_thread)
 {
     PAS_UNUSED_PARAM(my_thread);
     return fugc_is_stw();
 }
 
-void filc_native_zscavenge_synchronously(filc_thread* my_thread)
+void filc_native_zgc_get_stats(filc_thread* my_thread, filc_ptr stats_ptr)
 {
+    /* fugc_get_stats() takes the collector's lock, and waiting for that while entered could hold up
+       a soft handshake. */
+    fugc_stats stats;
     filc_exit(my_thread);
-    pas_scavenger_run_synchronously_now();
+    fugc_get_stats(&stats);
     filc_enter(my_thread);
+    filc_check_write(stats_ptr, sizeof(fugc_stats));
+    memcpy(filc_ptr_ptr(stats_ptr), &stats, sizeof(fugc_stats));
 }
 
-void filc_native_zscavenger_suspend(filc_thread* my_thread)
+void filc_native_zgc_heap_composition(filc_thread* my_thread, filc_ptr composition_ptr)
 {
+    filc_heap_composition composition;
     filc_exit(my_thread);
-    pas_scavenger_suspend();
+    filc_heap_composition_get(&composition);
     filc_enter(my_thread);
+    filc_check_write(composition_ptr, sizeof(filc_heap_composition));
+    memcpy(filc_ptr_ptr(composition_ptr), &composition, sizeof(filc_heap_composition));
 }
 
-void filc_native_zscavenger_resume(filc_thread* my_thread)
+bool filc_native_zgc_write_heap_snapshot(filc_thread* my_thread, int fd)
 {
     filc_exit(my_thread);
-    pas_scavenger_resume();
+    bool result = filc_heap_snapshot_write(fd);
+    int my_errno = errno;
     filc_enter(my_thread);
+    if (!result)
+        filc_set_errno(my_errno);
+    return result;
 }
 
-void filc_native_zdump_stack(filc_thread* my_thread)
+void filc_native_zscavenge_synchronously(filc_thread* my_thread)
 {
-    filc_thread_dump_stack(my_thread, &pas_log_stream.base);
-}
-
+    filc_exit(my_thread);
+    pas_scavenger_run_synchronously_now();
+    filc_enter(my_thread);
+}
+
+bool filc_native_zheap_reserve(filc_thread* my_thread, size_t bytes)
+{
+    filc_exit(my_thread);
+    bool result = verse_heap_reserve_memory(filc_default_heap, bytes, false);
+    filc_enter(my_thread);
+    return result;
+}
+
+bool filc_native_zheap_prefault(filc_thread* my_thread, size_t bytes)
+{
+    filc_exit(my_thread);
+    bool result = verse_heap_reserve_memory(filc_default_heap, bytes, true);
+    filc_enter(my_thread);
+    return result;
+}
+
+void filc_native_zscavenger_suspend(filc_thread* my_thread)
+{
+    filc_exit(my_thread);
+    pas_scavenger_suspend();
+    filc_enter(my_thread);
+}
+
+void filc_native_zscavenger_resume(filc_thread* my_thread)
+{
+    filc_exit(my_thread);
+    pas_scavenger_resume();
+    filc_enter(my_thread);
+}
+
+void filc_native_zdump_stack(filc_thread* my_thread)
+{
+    filc_thread_dump_stack(my_thread, &pas_log_stream.base);
+}
+
 struct stack_frame_description {
     const char* function_name;
     const char* filename;
@@ -4710,11 +6817,18 @@ static void longjmp_impl(filc_thread* my_thread, filc_ptr jmp_buf_ptr, int value
         "cannot mix %s with %s.",
         filc_jmp_buf_kind_get_longjmp_string(kind), filc_jmp_buf_kind_get_string(jmp_buf->kind));
 
+    /* We only have to find the saved frame by identity, which is just a pointer chase over the same
+       frames that we're about to pop anyway. Once we find it, the frame is live, and it's the
+       activation that did the setjmp if one of its setjmp slots still holds this jmp_buf. A later
+       activation that reused the same stack address would have nulled its slots on entry, and every
+       setjmp creates a fresh jmp_buf, so the slot can't match by accident. */
     filc_frame* current_frame;
-    bool found_frame = false;
     for (current_frame = my_thread->top_frame;
-         current_frame && !found_frame;
-         current_frame = current_frame->parent) {
+         current_frame && current_frame != jmp_buf->saved_top_frame;
+         current_frame = current_frame->parent);
+
+    bool found_frame = false;
+    if (current_frame) {
         PAS_ASSERT(current_frame->origin);
         const filc_function_origin* function_origin =
             filc_origin_get_function_origin(current_frame->origin);
@@ -4722,11 +6836,10 @@ static void longjmp_impl(filc_thread* my_thread, filc_ptr jmp_buf_ptr, int value
         PAS_ASSERT(function_origin->base.num_lowers_ish < UINT_MAX);
         PAS_ASSERT(function_origin->num_setjmps <= function_origin->base.num_lowers_ish);
         unsigned index;
-        for (index = function_origin->num_setjmps; index-- && !found_frame;) {
+        for (index = function_origin->num_setjmps; index--;) {
             unsigned lower_index = function_origin->base.num_lowers_ish - 1 - index;
             PAS_ASSERT(lower_index < function_origin->base.num_lowers_ish);
             if (jmp_buf == current_frame->lowers[lower_index]) {
-                PAS_ASSERT(current_frame == jmp_buf->saved_top_frame);
                 found_frame = true;
                 break;
             }
@@ -4826,6 +6939,252 @@ unsigned long filc_native_zxgetbv(filc_thread* my_thread)
     return (unsigned long)low | ((unsigned long)high << (unsigned long)32);
 }
 
+/* The crypto and checksum natives run their kernels with the thread exited when the input is big,
+   so that a multi-megabyte hash or cipher operation doesn't hold up the GC. Keys get copied and
+   validated before we exit, so that nothing another thread does to the user's copy can change how
+   many rounds we run. */
+static bool kernel_should_exit(size_t bytes)
+{
+    return bytes > FILC_MAX_BYTES_BETWEEN_POLLCHECKS;
+}
+
+unsigned filc_native_zcrypto_features(filc_thread* my_thread)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    return filc_crypto_features();
+}
+
+void filc_native_zcrypto_sha256_blocks(filc_thread* my_thread, filc_ptr state_ptr,
+                                       filc_ptr data_ptr, size_t num_blocks)
+{
+    size_t size = filc_mul_size(num_blocks, 64);
+    filc_check_write(state_ptr, sizeof(uint32_t) * 8);
+    filc_check_read(data_ptr, size);
+    uint32_t* state = (uint32_t*)filc_ptr_ptr(state_ptr);
+    const uint8_t* data = (const uint8_t*)filc_ptr_ptr(data_ptr);
+    if (!kernel_should_exit(size)) {
+        filc_crypto_sha256_blocks(state, data, num_blocks);
+        return;
+    }
+    filc_exit(my_thread);
+    filc_crypto_sha256_blocks(state, data, num_blocks);
+    filc_enter(my_thread);
+}
+
+void filc_native_zcrypto_sha512_blocks(filc_thread* my_thread, filc_ptr state_ptr,
+                                       filc_ptr data_ptr, size_t num_blocks)
+{
+    size_t size = filc_mul_size(num_blocks, 128);
+    filc_check_write(state_ptr, sizeof(uint64_t) * 8);
+    filc_check_read(data_ptr, size);
+    uint64_t* state = (uint64_t*)filc_ptr_ptr(state_ptr);
+    const uint8_t* data = (const uint8_t*)filc_ptr_ptr(data_ptr);
+    if (!kernel_should_exit(size)) {
+        filc_crypto_sha512_blocks(state, data, num_blocks);
+        return;
+    }
+    filc_exit(my_thread);
+    filc_crypto_sha512_blocks(state, data, num_blocks);
+    filc_enter(my_thread);
+}
+
+bool filc_native_zcrypto_aes_set_encrypt_key(filc_thread* my_thread, filc_ptr user_key_ptr,
+                                             unsigned bits, filc_ptr key_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    filc_crypto_aes_key key;
+    if (bits != 128 && bits != 192 && bits != 256)
+        return false;
+    filc_check_read(user_key_ptr, bits / 8);
+    filc_check_write(key_ptr, sizeof(filc_crypto_aes_key));
+    PAS_ASSERT(filc_crypto_aes_set_encrypt_key((const uint8_t*)filc_ptr_ptr(user_key_ptr), bits,
+                                               &key));
+    memcpy(filc_ptr_ptr(key_ptr), &key, sizeof(filc_crypto_aes_key));
+    return true;
+}
+
+static void check_aes(void)
+{
+    FILC_CHECK(
+        filc_crypto_features() & FILC_CRYPTO_AES,
+        NULL,
+        "cannot use the AES natives because this CPU doesn't have AES-NI.");
+}
+
+static void copy_aes_key(filc_ptr key_ptr, filc_crypto_aes_key* key)
+{
+    filc_check_read(key_ptr, sizeof(filc_crypto_aes_key));
+    memcpy(key, filc_ptr_ptr(key_ptr), sizeof(filc_crypto_aes_key));
+    FILC_CHECK(
+        filc_crypto_aes_rounds_are_valid(key->rounds),
+        NULL,
+        "AES key has invalid number of rounds (rounds = %u).",
+        key->rounds);
+}
+
+void filc_native_zcrypto_aes_encrypt_block(filc_thread* my_thread, filc_ptr in_ptr,
+                                           filc_ptr out_ptr, filc_ptr key_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    filc_crypto_aes_key key;
+    check_aes();
+    copy_aes_key(key_ptr, &key);
+    filc_check_read(in_ptr, 16);
+    filc_check_write(out_ptr, 16);
+    filc_crypto_aes_encrypt_block((const uint8_t*)filc_ptr_ptr(in_ptr),
+                                  (uint8_t*)filc_ptr_ptr(out_ptr), &key);
+}
+
+void filc_native_zcrypto_aes_ctr32_encrypt_blocks(filc_thread* my_thread, filc_ptr in_ptr,
+                                                  filc_ptr out_ptr, size_t num_blocks,
+                                                  filc_ptr key_ptr, filc_ptr ivec_ptr)
+{
+    filc_crypto_aes_key key;
+    uint8_t ivec[16];
+    check_aes();
+    copy_aes_key(key_ptr, &key);
+    filc_check_read(ivec_ptr, 16);
+    memcpy(ivec, filc_ptr_ptr(ivec_ptr), 16);
+    size_t size = filc_mul_size(num_blocks, 16);
+    filc_check_read(in_ptr, size);
+    filc_check_write(out_ptr, size);
+    const uint8_t* in = (const uint8_t*)filc_ptr_ptr(in_ptr);
+    uint8_t* out = (uint8_t*)filc_ptr_ptr(out_ptr);
+    if (!kernel_should_exit(size)) {
+        filc_crypto_aes_ctr32_encrypt_blocks(in, out, num_blocks, &key, ivec);
+        return;
+    }
+    filc_exit(my_thread);
+    filc_crypto_aes_ctr32_encrypt_blocks(in, out, num_blocks, &key, ivec);
+    filc_enter(my_thread);
+}
+
+void filc_native_zcrypto_ghash(filc_thread* my_thread, filc_ptr xi_ptr, filc_ptr h_ptr,
+                               filc_ptr in_ptr, size_t len)
+{
+    FILC_CHECK(
+        filc_crypto_features() & FILC_CRYPTO_PCLMUL,
+        NULL,
+        "cannot use zcrypto_ghash because this CPU doesn't have PCLMULQDQ.");
+    FILC_CHECK(
+        !(len % 16),
+        NULL,
+        "GHASH input length must be a multiple of 16 (len = %zu).",
+        len);
+    filc_check_write(xi_ptr, 16);
+    filc_check_read(h_ptr, 16);
+    filc_check_read(in_ptr, len);
+    uint8_t* xi = (uint8_t*)filc_ptr_ptr(xi_ptr);
+    const uint8_t* h = (const uint8_t*)filc_ptr_ptr(h_ptr);
+    const uint8_t* in = (const uint8_t*)filc_ptr_ptr(in_ptr);
+    if (!kernel_should_exit(len)) {
+        filc_crypto_ghash(xi, h, in, len);
+        return;
+    }
+    filc_exit(my_thread);
+    filc_crypto_ghash(xi, h, in, len);
+    filc_enter(my_thread);
+}
+
+void filc_native_zcrypto_chacha20_ctr32(filc_thread* my_thread, filc_ptr out_ptr, filc_ptr in_ptr,
+                                        size_t len, filc_ptr key_ptr, filc_ptr counter_ptr)
+{
+    filc_check_write(out_ptr, len);
+    filc_check_read(in_ptr, len);
+    filc_check_read(key_ptr, sizeof(uint32_t) * 8);
+    filc_check_read(counter_ptr, sizeof(uint32_t) * 4);
+    uint8_t* out = (uint8_t*)filc_ptr_ptr(out_ptr);
+    const uint8_t* in = (const uint8_t*)filc_ptr_ptr(in_ptr);
+    const uint32_t* key = (const uint32_t*)filc_ptr_ptr(key_ptr);
+    const uint32_t* counter = (const uint32_t*)filc_ptr_ptr(counter_ptr);
+    if (!kernel_should_exit(len)) {
+        filc_crypto_chacha20_ctr32(out, in, len, key, counter);
+        return;
+    }
+    filc_exit(my_thread);
+    filc_crypto_chacha20_ctr32(out, in, len, key, counter);
+    filc_enter(my_thread);
+}
+
+void filc_native_zcrypto_poly1305_init(filc_thread* my_thread, filc_ptr state_ptr, filc_ptr key_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    filc_check_write(state_ptr, sizeof(filc_crypto_poly1305));
+    filc_check_read(key_ptr, 16);
+    filc_crypto_poly1305_init((filc_crypto_poly1305*)filc_ptr_ptr(state_ptr),
+                              (const uint8_t*)filc_ptr_ptr(key_ptr));
+}
+
+void filc_native_zcrypto_poly1305_blocks(filc_thread* my_thread, filc_ptr state_ptr,
+                                         filc_ptr in_ptr, size_t len, unsigned padbit)
+{
+    FILC_CHECK(
+        !(len % 16),
+        NULL,
+        "Poly1305 input length must be a multiple of 16 (len = %zu).",
+        len);
+    filc_check_write(state_ptr, sizeof(filc_crypto_poly1305));
+    filc_check_read(in_ptr, len);
+    filc_crypto_poly1305* state = (filc_crypto_poly1305*)filc_ptr_ptr(state_ptr);
+    const uint8_t* in = (const uint8_t*)filc_ptr_ptr(in_ptr);
+    if (!kernel_should_exit(len)) {
+        filc_crypto_poly1305_blocks(state, in, len, padbit);
+        return;
+    }
+    filc_exit(my_thread);
+    filc_crypto_poly1305_blocks(state, in, len, padbit);
+    filc_enter(my_thread);
+}
+
+void filc_native_zcrypto_poly1305_emit(filc_thread* my_thread, filc_ptr state_ptr, filc_ptr mac_ptr,
+                                       filc_ptr nonce_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    filc_check_read(state_ptr, sizeof(filc_crypto_poly1305));
+    filc_check_write(mac_ptr, 16);
+    filc_check_read(nonce_ptr, 16);
+    filc_crypto_poly1305_emit((const filc_crypto_poly1305*)filc_ptr_ptr(state_ptr),
+                              (uint8_t*)filc_ptr_ptr(mac_ptr),
+                              (const uint8_t*)filc_ptr_ptr(nonce_ptr));
+}
+
+unsigned filc_native_zcrc32(filc_thread* my_thread, unsigned crc, filc_ptr buf_ptr, size_t len)
+{
+    filc_check_read(buf_ptr, len);
+    const uint8_t* buf = (const uint8_t*)filc_ptr_ptr(buf_ptr);
+    if (!kernel_should_exit(len))
+        return filc_checksum_crc32(crc, buf, len);
+    filc_exit(my_thread);
+    crc = filc_checksum_crc32(crc, buf, len);
+    filc_enter(my_thread);
+    return crc;
+}
+
+unsigned filc_native_zadler32(filc_thread* my_thread, unsigned adler, filc_ptr buf_ptr, size_t len)
+{
+    filc_check_read(buf_ptr, len);
+    const uint8_t* buf = (const uint8_t*)filc_ptr_ptr(buf_ptr);
+    if (!kernel_should_exit(len))
+        return filc_checksum_adler32(adler, buf, len);
+    filc_exit(my_thread);
+    adler = filc_checksum_adler32(adler, buf, len);
+    filc_enter(my_thread);
+    return adler;
+}
+
+unsigned long long filc_native_zcrc64(filc_thread* my_thread, unsigned long long crc,
+                                      filc_ptr buf_ptr, size_t len)
+{
+    filc_check_read(buf_ptr, len);
+    const uint8_t* buf = (const uint8_t*)filc_ptr_ptr(buf_ptr);
+    if (!kernel_should_exit(len))
+        return filc_checksum_crc64(crc, buf, len);
+    filc_exit(my_thread);
+    crc = filc_checksum_crc64(crc, buf, len);
+    filc_enter(my_thread);
+    return crc;
+}
+
 static pizlonated_function pizlonated_errno_handler;
 
 void filc_native_zregister_sys_errno_handler(filc_thread* my_thread, filc_ptr errno_handler)
@@ -4964,8 +7323,15 @@ ssize_t filc_native_zsys_write(filc_thread* my_thread, int fd, filc_ptr buf, siz
 int filc_native_zsys_close(filc_thread* my_thread, int fd)
 {
     filc_exit(my_thread);
-    int result = close(fd);
+    lock_io_uring_fds_for_user();
+    int result;
+    if (is_io_uring_fd(fd)) {
+        result = -1;
+        errno = EBADF;
+    } else
+        result = close(fd);
     int my_errno = errno;
+    unlock_io_uring_fds();
     filc_enter(my_thread);
     if (result < 0)
         filc_set_errno(my_errno);
@@ -4992,34 +7358,22 @@ void filc_native_zsys_exit(filc_thread* my_thread, int return_code)
 
 unsigned filc_native_zsys_getuid(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    unsigned result = getuid();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, getuid());
 }
 
 unsigned filc_native_zsys_geteuid(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    unsigned result = geteuid();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, geteuid());
 }
 
 unsigned filc_native_zsys_getgid(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    unsigned result = getgid();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, getgid());
 }
 
 unsigned filc_native_zsys_getegid(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    unsigned result = getegid();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, getegid());
 }
 
 int filc_native_zsys_open(filc_thread* my_thread, filc_ptr path_ptr, int flags,
@@ -5040,16 +7394,13 @@ int filc_native_zsys_open(filc_thread* my_thread, filc_ptr path_ptr, int flags,
 
 int filc_native_zsys_getpid(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    int result = getpid();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, getpid());
 }
 
 int filc_native_zsys_clock_gettime(filc_thread* my_thread, int clock_id, filc_ptr timespec_ptr)
 {
     filc_check_write(timespec_ptr, sizeof(struct timespec));
-    return FILC_SYSCALL(
+    return FILC_FAST_SYSCALL(
         my_thread, clock_gettime(clock_id, (struct timespec*)filc_ptr_ptr(timespec_ptr)));
 }
 
@@ -5368,8 +7719,15 @@ int filc_native_zsys_raise(filc_thread* my_thread, int sig)
 int filc_native_zsys_dup(filc_thread* my_thread, int fd)
 {
     filc_exit(my_thread);
-    int result = dup(fd);
+    lock_io_uring_fds_for_user();
+    int result;
+    if (is_io_uring_fd(fd)) {
+        result = -1;
+        errno = EBADF;
+    } else
+        result = dup(fd);
     int my_errno = errno;
+    unlock_io_uring_fds();
     filc_enter(my_thread);
     if (result < 0)
         filc_set_errno(my_errno);
@@ -5379,8 +7737,15 @@ int filc_native_zsys_dup(filc_thread* my_thread, int fd)
 int filc_native_zsys_dup2(filc_thread* my_thread, int oldfd, int newfd)
 {
     filc_exit(my_thread);
-    int result = dup2(oldfd, newfd);
+    lock_io_uring_fds_for_user();
+    int result;
+    if (is_io_uring_fd(oldfd) || is_io_uring_fd(newfd)) {
+        result = -1;
+        errno = EBADF;
+    } else
+        result = dup2(oldfd, newfd);
     int my_errno = errno;
+    unlock_io_uring_fds();
     filc_enter(my_thread);
     if (result < 0)
         filc_set_errno(my_errno);
@@ -5448,14 +7813,24 @@ int filc_native_zsys_fork(filc_thread* my_thread)
     if (verbose)
         pas_log("suspending GC\n");
     fugc_suspend();
+    if (verbose)
+        pas_log("suspending profiler\n");
+    filc_profiler_suspend();
+    if (verbose)
+        pas_log("suspending memory pressure monitor\n");
+    filc_memory_pressure_suspend();
+    if (verbose)
+        pas_log("suspending status reporter\n");
+    pas_status_reporter_suspend();
     if (verbose)
         pas_log("stopping world\n");
     filc_stop_the_world();
     /* NOTE: We don't have to lock the soft handshake lock, since now that the world is stopped and the
-       FUGC is suspended, nobody could be using it. */
+       FUGC and profiler are suspended, nobody could be using it. */
     if (verbose)
         pas_log("locking thread list\n");
     filc_thread_list_lock_lock();
+    filc_thread_pool_lock_lock();
     pas_lock_disallowed = true;
     filc_thread* thread;
     for (thread = filc_first_thread; thread; thread = thread->next_thread)
@@ -5496,12 +7871,22 @@ int filc_native_zsys_fork(filc_thread* my_thread)
         PAS_ASSERT(filc_first_thread == my_thread);
         PAS_ASSERT(!filc_first_thread->next_thread);
         PAS_ASSERT(!filc_first_thread->prev_thread);
+
+        /* The parked native threads didn't make it into the child. */
+        first_pooled_thread = NULL;
+        num_pooled_threads = 0;
+
+        filc_memory_pressure_did_fork_child();
     } else {
         for (thread = filc_first_thread; thread; thread = thread->next_thread)
             pas_system_mutex_unlock(&thread->lock);
     }
+    filc_thread_pool_lock_unlock();
     filc_thread_list_lock_unlock();
     filc_resume_the_world();
+    pas_status_reporter_resume();
+    filc_memory_pressure_resume();
+    filc_profiler_resume();
     fugc_resume();
     pas_scavenger_resume();
     filc_enter(my_thread);
@@ -5583,10 +7968,7 @@ int filc_native_zsys_execve(filc_thread* my_thread, filc_ptr pathname_ptr, filc_
 
 int filc_native_zsys_getppid(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    int result = getppid();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, getppid());
 }
 
 int filc_native_zsys_chroot(filc_thread* my_thread, filc_ptr path_ptr)
@@ -5792,14 +8174,25 @@ filc_ptr filc_native_zsys_mmap(filc_thread* my_thread, filc_ptr address, size_t
         return mmap_error_result();
     }
     if (!filc_ptr_ptr(address)) {
+        /* We map over the object with the user's flags, so MAP_POPULATE, MAP_NORESERVE, and the
+           like work just as they would without MAP_FIXED. Later madvise calls apply to the same
+           mapping, since it replaces whatever the heap had there. */
         address = filc_ptr_create_with_object(
             my_thread, allocate_aligned_impl(
-                my_thread, length, pas_page_malloc_alignment(), FILC_OBJECT_FLAG_MMAP));
+                my_thread, length, pas_page_malloc_alignment(),
+                (flags & MAP_SHARED) ? FILC_OBJECT_FLAGS_SHARED : FILC_OBJECT_FLAG_MMAP));
         flags |= MAP_FIXED;
     }
     filc_exit(my_thread);
-    void* raw_result = mmap(filc_ptr_ptr(address), length, prot, flags, fd, offset);
+    lock_io_uring_fds_for_user();
+    void* raw_result;
+    if (!(flags & MAP_ANONYMOUS) && is_io_uring_fd(fd)) {
+        raw_result = MAP_FAILED;
+        errno = EBADF;
+    } else
+        raw_result = mmap(filc_ptr_ptr(address), length, prot, flags, fd, offset);
     int my_errno = errno;
+    unlock_io_uring_fds();
     filc_enter(my_thread);
     if (raw_result == (void*)(intptr_t)-1) {
         filc_set_errno(my_errno);
@@ -5841,6 +8234,94 @@ int filc_native_zsys_munmap(filc_thread* my_thread, filc_ptr address, size_t len
     return 0;
 }
 
+#ifndef MREMAP_DONTUNMAP
+#define MREMAP_DONTUNMAP 4
+#endif
+
+static bool from_user_mremap_flags(int user_flags, int* flags)
+{
+    if ((user_flags & ~MREMAP_MAYMOVE))
+        return false;
+    *flags = user_flags;
+    return true;
+}
+
+filc_ptr filc_native_zsys_mremap(filc_thread* my_thread, filc_ptr old_address, size_t old_size,
+                                 size_t new_size, int user_flags)
+{
+    int flags;
+    if (!from_user_mremap_flags(user_flags, &flags)
+        || !old_size || !new_size
+        || new_size > SIZE_MAX - pas_page_malloc_alignment()
+        || !pas_is_aligned((uintptr_t)filc_ptr_ptr(old_address), pas_page_malloc_alignment())) {
+        filc_set_errno(EINVAL);
+        return mmap_error_result();
+    }
+    old_size = pas_round_up_to_power_of_2(old_size, pas_page_malloc_alignment());
+    new_size = pas_round_up_to_power_of_2(new_size, pas_page_malloc_alignment());
+    filc_check_write(old_address, old_size);
+    check_mmap(old_address);
+    char* old_raw = (char*)filc_ptr_ptr(old_address);
+
+    /* Shrinking is just munmap of the tail, which leaves the object as big as it was. */
+    if (new_size <= old_size) {
+        if (new_size < old_size) {
+            filc_exit(my_thread);
+            filc_unmap(old_raw + new_size, old_size - new_size);
+            filc_enter(my_thread);
+        }
+        return old_address;
+    }
+
+    /* The memory right after the mapping is part of the heap, so we can't grow in place. */
+    if (!(flags & MREMAP_MAYMOVE)) {
+        filc_set_errno(ENOMEM);
+        return mmap_error_result();
+    }
+
+    /* We can't give the kernel a mapping to move and then put anonymous memory back where it
+       was, since in between, the old range would be a hole in the heap that another thread's mmap
+       could land in, and we'd map over it. MREMAP_DONTUNMAP leaves the old range mapped, so it can
+       be replaced atomically, but it only moves mappings without changing their size. So the
+       kernel moves the old pages to the start of a new mmap object, and the rest of that object is
+       fresh zero memory, just like mremap would give us for a private anonymous mapping (for a
+       private file mapping, the kernel would have mapped more of the file there). A shared mapping
+       would need its new pages to be shared, too, and we have no way of growing it without a hole,
+       so that's ENOMEM. The old object's aux stays with it, since the kernel doesn't know about
+       it. */
+    if (filc_object_flags_is_shared(filc_object_get_flags(filc_ptr_object(old_address)))) {
+        filc_set_errno(ENOMEM);
+        return mmap_error_result();
+    }
+    filc_ptr new_address = filc_ptr_create_with_object(
+        my_thread, allocate_aligned_impl(
+            my_thread, new_size, pas_page_malloc_alignment(), FILC_OBJECT_FLAG_MMAP));
+    char* new_raw = (char*)filc_ptr_ptr(new_address);
+    filc_exit(my_thread);
+    void* raw_result = mremap(old_raw, old_size, old_size,
+                              MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, new_raw);
+    int my_errno = errno;
+    if (raw_result == (void*)(intptr_t)-1 && my_errno == EINVAL) {
+        /* Kernels before 5.7 don't have MREMAP_DONTUNMAP, so copy instead. */
+        memcpy(new_raw, old_raw, old_size);
+        raw_result = new_raw;
+    }
+    if (raw_result != (void*)(intptr_t)-1) {
+        filc_unmap(new_raw + old_size, new_size - old_size);
+        filc_unmap(old_raw, old_size);
+    }
+    filc_enter(my_thread);
+    if (raw_result == (void*)(intptr_t)-1) {
+        filc_free(filc_ptr_object(new_address));
+        filc_set_errno(my_errno);
+        return mmap_error_result();
+    }
+    PAS_ASSERT(raw_result == new_raw);
+    if (old_raw == filc_ptr_lower(old_address) && old_size == filc_ptr_available(old_address))
+        filc_free(filc_ptr_object(old_address));
+    return new_address;
+}
+
 int filc_native_zsys_ftruncate(filc_thread* my_thread, int fd, long length)
 {
     filc_exit(my_thread);
@@ -5892,75 +8373,254 @@ filc_ptr filc_native_zsys_dlopen(filc_thread* my_thread, filc_ptr filename_ptr,
         filc_allocate_special_with_existing_payload(my_thread, handle, FILC_SPECIAL_TYPE_DL_HANDLE));
 }
 
-filc_ptr filc_native_zsys_dlsym(filc_thread* my_thread, filc_ptr handle_ptr, filc_ptr symbol_ptr)
+typedef filc_ptr (*dlsym_getter)(filc_global_initialization_context*);
+
+typedef struct {
+    void* handle;
+    const char* symbol;
+} dlsym_cache_key;
+
+typedef struct {
+    dlsym_cache_key key;
+    dlsym_getter getter;
+} dlsym_cache_entry;
+
+static inline dlsym_cache_entry dlsym_cache_entry_create_empty(void)
 {
-    filc_check_access_special(handle_ptr, FILC_SPECIAL_TYPE_DL_HANDLE);
-    void* handle = filc_ptr_ptr(handle_ptr);
-    char* symbol = filc_check_and_get_tmp_str(my_thread, symbol_ptr);
-    pas_allocation_config allocation_config;
-    bmalloc_initialize_allocation_config(&allocation_config);
-    pas_string_stream stream;
-    pas_string_stream_construct(&stream, &allocation_config);
-    pas_string_stream_printf(&stream, "pizlonated_%s", symbol);
-    filc_exit(my_thread);
-    filc_ptr (*raw_symbol)(filc_global_initialization_context*) =
-        dlsym(handle, pas_string_stream_get_string(&stream));
-    filc_enter(my_thread);
-    pas_string_stream_destruct(&stream);
-    if (!raw_symbol) {
-        set_dlerror(dlerror());
-        return filc_ptr_forge_null();
-    }
-    return raw_symbol(NULL);
+    dlsym_cache_entry result;
+    result.key.handle = NULL;
+    result.key.symbol = NULL;
+    result.getter = NULL;
+    return result;
 }
 
-int filc_native_zsys_faccessat(filc_thread* my_thread, int dirfd, filc_ptr pathname_ptr, int mode,
-                               int flags)
+static inline dlsym_cache_entry dlsym_cache_entry_create_deleted(void)
 {
-    char* pathname = filc_check_and_get_tmp_str(my_thread, pathname_ptr);
-    filc_exit(my_thread);
-    int result = faccessat(dirfd, pathname, mode, flags);
-    int my_errno = errno;
-    filc_enter(my_thread);
-    if (result < 0)
-        filc_set_errno(my_errno);
+    dlsym_cache_entry result;
+    result.key.handle = NULL;
+    result.key.symbol = (const char*)(uintptr_t)1;
+    result.getter = NULL;
     return result;
 }
 
-int filc_native_zsys_sigwait(filc_thread* my_thread, filc_ptr sigmask_ptr, filc_ptr sig_ptr)
+static inline bool dlsym_cache_entry_is_empty_or_deleted(dlsym_cache_entry entry)
 {
-    filc_check_user_sigset(sigmask_ptr, filc_read_access);
-    sigset_t sigmask;
-    filc_from_user_sigset((sigset_t*)filc_ptr_ptr(sigmask_ptr), &sigmask);
-    filc_exit(my_thread);
-    int signum;
-    int result = sigwait(&sigmask, &signum);
-    filc_enter(my_thread);
-    if (result)
-        return result;
-    filc_check_write(sig_ptr, sizeof(int));
-    *(int*)filc_ptr_ptr(sig_ptr) = signum;
-    return 0;
+    return !entry.key.handle;
 }
 
-int filc_native_zsys_fsync(filc_thread* my_thread, int fd)
+static inline bool dlsym_cache_entry_is_empty(dlsym_cache_entry entry)
 {
-    filc_exit(my_thread);
-    int result = fsync(fd);
-    int my_errno = errno;
-    filc_enter(my_thread);
-    PAS_ASSERT(!result || result == -1);
-    if (result < 0)
-        filc_set_errno(my_errno);
-    return result;
+    return !entry.key.handle && !entry.key.symbol;
 }
 
-int filc_native_zsys_shutdown(filc_thread* my_thread, int fd, int user_how)
+static inline bool dlsym_cache_entry_is_deleted(dlsym_cache_entry entry)
 {
-    int how;
-    how = user_how;
-    filc_exit(my_thread);
-    int result = shutdown(fd, how);
+    return !entry.key.handle && entry.key.symbol;
+}
+
+static inline dlsym_cache_key dlsym_cache_entry_get_key(dlsym_cache_entry entry)
+{
+    return entry.key;
+}
+
+static inline unsigned dlsym_cache_key_get_hash(dlsym_cache_key key)
+{
+    unsigned result = pas_hash_ptr(key.handle);
+    const char* ptr;
+    for (ptr = key.symbol; *ptr; ++ptr)
+        result = result * 31 + (unsigned char)*ptr;
+    return result;
+}
+
+static inline bool dlsym_cache_key_is_equal(dlsym_cache_key a, dlsym_cache_key b)
+{
+    return a.handle == b.handle && !strcmp(a.symbol, b.symbol);
+}
+
+PAS_CREATE_HASHTABLE(dlsym_cache,
+                     dlsym_cache_entry,
+                     dlsym_cache_key);
+
+/* Maps (dlopen handle, symbol) to the pizlonated getter for that symbol. There's no dlclose, so an
+   entry never goes stale. Only hits are cached, so that misses still get the real dlerror(). */
+static dlsym_cache dlsym_cache_instance = PAS_HASHTABLE_INITIALIZER;
+static pas_lock dlsym_cache_lock = PAS_LOCK_INITIALIZER;
+
+static dlsym_getter get_cached_dlsym_getter(void* handle, const char* symbol)
+{
+    dlsym_cache_key key;
+    key.handle = handle;
+    key.symbol = symbol;
+    pas_lock_lock(&dlsym_cache_lock);
+    dlsym_getter result = dlsym_cache_get(&dlsym_cache_instance, key).getter;
+    pas_lock_unlock(&dlsym_cache_lock);
+    return result;
+}
+
+static char* strdup_with_bmalloc(const char* string)
+{
+    size_t length = strlen(string);
+    char* result = bmalloc_allocate(length + 1);
+    memcpy(result, string, length + 1);
+    return result;
+}
+
+static void cache_dlsym_getter(void* handle, const char* symbol, dlsym_getter getter)
+{
+    pas_allocation_config allocation_config;
+    bmalloc_initialize_allocation_config(&allocation_config);
+    char* symbol_copy = strdup_with_bmalloc(symbol);
+    dlsym_cache_entry entry;
+    entry.key.handle = handle;
+    entry.key.symbol = symbol_copy;
+    entry.getter = getter;
+    pas_lock_lock(&dlsym_cache_lock);
+    dlsym_cache_add_result add_result =
+        dlsym_cache_add(&dlsym_cache_instance, entry.key, NULL, &allocation_config);
+    if (add_result.is_new_entry)
+        *add_result.entry = entry;
+    pas_lock_unlock(&dlsym_cache_lock);
+    if (!add_result.is_new_entry)
+        bmalloc_deallocate(symbol_copy);
+}
+
+/* Must be called exited. Returns the getter for the symbol, or NULL if the symbol isn't there, in
+   which case dlerror() says why. */
+static dlsym_getter dlsym_getter_uncached(void* handle, const char* symbol)
+{
+    pas_allocation_config allocation_config;
+    bmalloc_initialize_allocation_config(&allocation_config);
+    pas_string_stream stream;
+    pas_string_stream_construct(&stream, &allocation_config);
+    pas_string_stream_printf(&stream, "pizlonated_%s", symbol);
+    dlsym_getter result = dlsym(handle, pas_string_stream_get_string(&stream));
+    pas_string_stream_destruct(&stream);
+    return result;
+}
+
+filc_ptr filc_native_zsys_dlsym(filc_thread* my_thread, filc_ptr handle_ptr, filc_ptr symbol_ptr)
+{
+    filc_check_access_special(handle_ptr, FILC_SPECIAL_TYPE_DL_HANDLE);
+    void* handle = filc_ptr_ptr(handle_ptr);
+    char* symbol = filc_check_and_get_tmp_str(my_thread, symbol_ptr);
+    dlsym_getter getter = get_cached_dlsym_getter(handle, symbol);
+    if (!getter) {
+        filc_exit(my_thread);
+        getter = dlsym_getter_uncached(handle, symbol);
+        filc_enter(my_thread);
+        if (!getter) {
+            set_dlerror(dlerror());
+            return filc_ptr_forge_null();
+        }
+        cache_dlsym_getter(handle, symbol, getter);
+    }
+    return getter(NULL);
+}
+
+size_t filc_native_zsys_dlsym_many(filc_thread* my_thread, filc_ptr handle_ptr,
+                                   filc_ptr symbols_ptr, filc_ptr results_ptr, size_t count)
+{
+    filc_check_access_special(handle_ptr, FILC_SPECIAL_TYPE_DL_HANDLE);
+    void* handle = filc_ptr_ptr(handle_ptr);
+    char** symbols = (char**)filc_bmalloc_allocate_tmp(
+        my_thread, filc_mul_size(count, sizeof(char*)));
+    dlsym_getter* getters = (dlsym_getter*)filc_bmalloc_allocate_tmp(
+        my_thread, filc_mul_size(count, sizeof(dlsym_getter)));
+    size_t num_misses = 0;
+    size_t index;
+    for (index = 0; index < count; ++index) {
+        symbols[index] = filc_check_and_get_tmp_str(
+            my_thread,
+            filc_load_ptr(my_thread, symbols_ptr, (ptrdiff_t)filc_mul_size(index, sizeof(void*))));
+        getters[index] = get_cached_dlsym_getter(handle, symbols[index]);
+        if (!getters[index])
+            num_misses++;
+    }
+    size_t num_unresolved = 0;
+    if (num_misses) {
+        /* Resolve all of the misses with one exit, rather than one per symbol. Setting the user's
+           dlerror means calling into the user, so we hold onto the last error until we're entered
+           again. */
+        char* last_error = NULL;
+        filc_exit(my_thread);
+        for (index = 0; index < count; ++index) {
+            if (getters[index])
+                continue;
+            getters[index] = dlsym_getter_uncached(handle, symbols[index]);
+            if (!getters[index]) {
+                if (last_error)
+                    bmalloc_deallocate(last_error);
+                last_error = strdup_with_bmalloc(dlerror());
+                num_unresolved++;
+            }
+        }
+        filc_enter(my_thread);
+        if (last_error) {
+            set_dlerror(last_error);
+            bmalloc_deallocate(last_error);
+        }
+    }
+    for (index = 0; index < count; ++index) {
+        filc_ptr result;
+        if (getters[index]) {
+            if (num_misses)
+                cache_dlsym_getter(handle, symbols[index], getters[index]);
+            result = getters[index](NULL);
+        } else
+            result = filc_ptr_forge_null();
+        filc_store_ptr(
+            my_thread, results_ptr, (ptrdiff_t)filc_mul_size(index, sizeof(void*)), result);
+    }
+    return num_unresolved;
+}
+
+int filc_native_zsys_faccessat(filc_thread* my_thread, int dirfd, filc_ptr pathname_ptr, int mode,
+                               int flags)
+{
+    char* pathname = filc_check_and_get_tmp_str(my_thread, pathname_ptr);
+    filc_exit(my_thread);
+    int result = faccessat(dirfd, pathname, mode, flags);
+    int my_errno = errno;
+    filc_enter(my_thread);
+    if (result < 0)
+        filc_set_errno(my_errno);
+    return result;
+}
+
+int filc_native_zsys_sigwait(filc_thread* my_thread, filc_ptr sigmask_ptr, filc_ptr sig_ptr)
+{
+    filc_check_user_sigset(sigmask_ptr, filc_read_access);
+    sigset_t sigmask;
+    filc_from_user_sigset((sigset_t*)filc_ptr_ptr(sigmask_ptr), &sigmask);
+    filc_exit(my_thread);
+    int signum;
+    int result = sigwait(&sigmask, &signum);
+    filc_enter(my_thread);
+    if (result)
+        return result;
+    filc_check_write(sig_ptr, sizeof(int));
+    *(int*)filc_ptr_ptr(sig_ptr) = signum;
+    return 0;
+}
+
+int filc_native_zsys_fsync(filc_thread* my_thread, int fd)
+{
+    filc_exit(my_thread);
+    int result = fsync(fd);
+    int my_errno = errno;
+    filc_enter(my_thread);
+    PAS_ASSERT(!result || result == -1);
+    if (result < 0)
+        filc_set_errno(my_errno);
+    return result;
+}
+
+int filc_native_zsys_shutdown(filc_thread* my_thread, int fd, int user_how)
+{
+    int how;
+    how = user_how;
+    filc_exit(my_thread);
+    int result = shutdown(fd, how);
     int my_errno = errno;
     filc_enter(my_thread);
     PAS_ASSERT(!result || result == -1);
@@ -6088,10 +8748,7 @@ int filc_native_zsys_getgroups(filc_thread* my_thread, int size, filc_ptr list_p
 
 int filc_native_zsys_getpgrp(filc_thread* my_thread)
 {
-    filc_exit(my_thread);
-    int result = getpgrp();
-    filc_enter(my_thread);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, getpgrp());
 }
 
 int filc_native_zsys_getpgid(filc_thread* my_thread, int pid)
@@ -6284,6 +8941,53 @@ static void ioctl_callback(void* guarded_arg, void* user_arg)
     data->result = ioctl(data->fd, data->request, guarded_arg);
 }
 
+typedef struct {
+    unsigned request;
+    unsigned size;
+    bool kernel_reads;
+    bool kernel_writes;
+} known_ioctl;
+
+/* These are ioctls whose argument is a fixed-size buffer with no pointers in it, so we can check
+   the user's buffer in place and hand it straight to the kernel instead of bouncing it through the
+   guard page. Anything that takes a struct with pointers in it (like SIOCGIFCONF or most of DRM)
+   must not go in here, since the kernel would chase those pointers without us having checked
+   them. */
+static const known_ioctl known_ioctls[] = {
+    { FIONREAD, sizeof(int), false, true },
+    { FIONBIO, sizeof(int), true, false },
+    { FIOASYNC, sizeof(int), true, false },
+    { TIOCOUTQ, sizeof(int), false, true },
+    { TIOCGWINSZ, sizeof(struct winsize), false, true },
+    { TIOCSWINSZ, sizeof(struct winsize), true, false },
+    { TIOCGPGRP, sizeof(pid_t), false, true },
+    { TIOCSPGRP, sizeof(pid_t), true, false },
+    { TIOCGPTN, sizeof(unsigned), false, true },
+    { TIOCSPTLCK, sizeof(int), true, false },
+    { SIOCGIFFLAGS, sizeof(struct ifreq), true, true },
+    { SIOCSIFFLAGS, sizeof(struct ifreq), true, false },
+    { SIOCGIFMTU, sizeof(struct ifreq), true, true },
+    { SIOCSIFMTU, sizeof(struct ifreq), true, false },
+    { SIOCGIFINDEX, sizeof(struct ifreq), true, true },
+    { SIOCGIFADDR, sizeof(struct ifreq), true, true },
+    { SIOCGIFHWADDR, sizeof(struct ifreq), true, true },
+    { TUNSETIFF, sizeof(struct ifreq), true, true },
+    { TUNGETIFF, sizeof(struct ifreq), false, true },
+    { PERF_EVENT_IOC_ID, sizeof(uint64_t), false, true },
+    { BLKGETSIZE64, sizeof(uint64_t), false, true },
+    { BLKSSZGET, sizeof(int), false, true },
+};
+
+static const known_ioctl* find_known_ioctl(int request)
+{
+    size_t index;
+    for (index = 0; index < sizeof(known_ioctls) / sizeof(known_ioctls[0]); ++index) {
+        if (known_ioctls[index].request == (unsigned)request)
+            return known_ioctls + index;
+    }
+    return NULL;
+}
+
 int filc_native_zsys_ioctl(filc_thread* my_thread, int fd, int request, filc_cc_cursor* args)
 {
     filc_ptr arg_ptr;
@@ -6292,6 +8996,15 @@ int filc_native_zsys_ioctl(filc_thread* my_thread, int fd, int request, filc_cc_
     else
         arg_ptr = filc_ptr_forge_null();
 
+    const known_ioctl* known = find_known_ioctl(request);
+    if (known) {
+        if (known->kernel_reads)
+            filc_check_read(arg_ptr, known->size);
+        if (known->kernel_writes)
+            filc_check_write(arg_ptr, known->size);
+        return FILC_SYSCALL(my_thread, ioctl(fd, request, filc_ptr_ptr(arg_ptr)));
+    }
+
     ioctl_data data;
     data.fd = fd;
     data.request = request;
@@ -6540,10 +9253,23 @@ static void from_user_msghdr_impl(filc_thread* my_thread, filc_ptr user_msghdr_p
     }
 }
 
+/* The kernel takes SCM_RIGHTS fds out of the control data, so sending copies it out of the user's
+   memory before checking it for io_uring fds. Otherwise, another thread could swap one in after the
+   check. */
+static void copy_msghdr_control(filc_thread* my_thread, struct msghdr* msghdr)
+{
+    if (!msghdr->msg_controllen)
+        return;
+    void* control = filc_bmalloc_allocate_tmp(my_thread, msghdr->msg_controllen);
+    memcpy(control, msghdr->msg_control, msghdr->msg_controllen);
+    msghdr->msg_control = control;
+}
+
 static void from_user_msghdr_for_send(filc_thread* my_thread, filc_ptr user_msghdr_ptr,
                                       struct msghdr* msghdr)
 {
     from_user_msghdr_impl(my_thread, user_msghdr_ptr, msghdr, filc_read_access);
+    copy_msghdr_control(my_thread, msghdr);
 }
 
 static void from_user_msghdr_for_recv(filc_thread* my_thread, filc_ptr user_msghdr_ptr,
@@ -6576,8 +9302,15 @@ ssize_t filc_native_zsys_sendmsg(filc_thread* my_thread, int sockfd, filc_ptr ms
     filc_exit(my_thread);
     if (verbose)
         pas_log("Actually doing sendmsg\n");
-    ssize_t result = sendmsg(sockfd, &msg, flags);
+    lock_io_uring_fds_for_user();
+    ssize_t result;
+    if (msghdr_passes_io_uring_fd(&msg)) {
+        result = -1;
+        errno = EBADF;
+    } else
+        result = sendmsg(sockfd, &msg, flags);
     int my_errno = errno;
+    unlock_io_uring_fds();
     if (verbose)
         pas_log("sendmsg result = %ld\n", (long)result);
     filc_enter(my_thread);
@@ -6620,6 +9353,90 @@ einval:
     return -1;
 }
 
+/* The user's mmsghdr has the same layout as ours, so we check the whole vector at once and then
+   translate each header into a tmp vector that lives until the native frame is popped. The vector
+   itself always needs write access since the kernel reports msg_len per entry; the access_kind is
+   for the buffers that the headers point at. The kernel clamps vlen to UIO_MAXIOV anyway, so we do
+   the same before allocating anything. */
+static struct mmsghdr* from_user_mmsghdrs(filc_thread* my_thread, filc_ptr msgvec_ptr,
+                                          unsigned vlen, filc_access_kind access_kind)
+{
+    filc_check_write(msgvec_ptr, filc_mul_size(vlen, sizeof(struct mmsghdr)));
+    struct mmsghdr* user_msgvec = (struct mmsghdr*)filc_ptr_ptr(msgvec_ptr);
+    struct mmsghdr* msgvec = (struct mmsghdr*)filc_bmalloc_allocate_tmp(
+        my_thread, filc_mul_size(vlen, sizeof(struct mmsghdr)));
+    unsigned index;
+    for (index = 0; index < vlen; ++index) {
+        from_user_msghdr_impl(my_thread, filc_ptr_with_ptr(msgvec_ptr, &user_msgvec[index].msg_hdr),
+                              &msgvec[index].msg_hdr, access_kind);
+    }
+    return msgvec;
+}
+
+int filc_native_zsys_sendmmsg(filc_thread* my_thread, int sockfd, filc_ptr msgvec_ptr,
+                              unsigned vlen, int flags)
+{
+    if (vlen > UIO_MAXIOV)
+        vlen = UIO_MAXIOV;
+    struct mmsghdr* msgvec = from_user_mmsghdrs(my_thread, msgvec_ptr, vlen, filc_read_access);
+    unsigned msg_index;
+    for (msg_index = vlen; msg_index--;)
+        copy_msghdr_control(my_thread, &msgvec[msg_index].msg_hdr);
+    filc_exit(my_thread);
+    lock_io_uring_fds_for_user();
+    bool passes_io_uring_fd = false;
+    for (msg_index = vlen; msg_index-- && !passes_io_uring_fd;)
+        passes_io_uring_fd = msghdr_passes_io_uring_fd(&msgvec[msg_index].msg_hdr);
+    int result;
+    if (passes_io_uring_fd) {
+        result = -1;
+        errno = EBADF;
+    } else
+        result = sendmmsg(sockfd, msgvec, vlen, flags);
+    int my_errno = errno;
+    unlock_io_uring_fds();
+    filc_enter(my_thread);
+    if (result < 0) {
+        filc_set_errno(my_errno);
+        return result;
+    }
+    struct mmsghdr* user_msgvec = (struct mmsghdr*)filc_ptr_ptr(msgvec_ptr);
+    int index;
+    for (index = 0; index < result; ++index)
+        user_msgvec[index].msg_len = msgvec[index].msg_len;
+    return result;
+}
+
+int filc_native_zsys_recvmmsg(filc_thread* my_thread, int sockfd, filc_ptr msgvec_ptr,
+                              unsigned vlen, int flags, filc_ptr timeout_ptr)
+{
+    struct timespec timeout;
+    bool have_timeout = !!filc_ptr_ptr(timeout_ptr);
+    if (have_timeout) {
+        filc_check_read(timeout_ptr, sizeof(struct timespec));
+        timeout = *(struct timespec*)filc_ptr_ptr(timeout_ptr);
+    }
+    if (vlen > UIO_MAXIOV)
+        vlen = UIO_MAXIOV;
+    struct mmsghdr* msgvec = from_user_mmsghdrs(my_thread, msgvec_ptr, vlen, filc_write_access);
+    filc_exit(my_thread);
+    int result = recvmmsg(sockfd, msgvec, vlen, flags, have_timeout ? &timeout : NULL);
+    int my_errno = errno;
+    filc_enter(my_thread);
+    if (result < 0) {
+        filc_set_errno(my_errno);
+        return result;
+    }
+    struct mmsghdr* user_msgvec = (struct mmsghdr*)filc_ptr_ptr(msgvec_ptr);
+    int index;
+    for (index = 0; index < result; ++index) {
+        to_user_msghdr_for_recv(&msgvec[index].msg_hdr,
+                                filc_ptr_with_ptr(msgvec_ptr, &user_msgvec[index].msg_hdr));
+        user_msgvec[index].msg_len = msgvec[index].msg_len;
+    }
+    return result;
+}
+
 int filc_native_zsys_fcntl(filc_thread* my_thread, int fd, int cmd, filc_cc_cursor* args)
 {
     static const bool verbose = false;
@@ -6714,13 +9531,18 @@ int filc_native_zsys_fcntl(filc_thread* my_thread, int fd, int cmd, filc_cc_curs
         pas_log("so far so good.\n");
     int result;
     filc_exit(my_thread);
-    if (have_arg_int)
+    lock_io_uring_fds_for_user();
+    if ((cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC) && is_io_uring_fd(fd)) {
+        result = -1;
+        errno = EBADF;
+    } else if (have_arg_int)
         result = fcntl(fd, cmd, arg_int);
     else if (arg_ptr)
         result = fcntl(fd, cmd, arg_ptr);
     else
         result = fcntl(fd, cmd);
     int my_errno = errno;
+    unlock_io_uring_fds();
     filc_enter(my_thread);
     if (verbose)
         pas_log("result = %d\n", result);
@@ -6793,6 +9615,34 @@ int filc_native_zsys_madvise(filc_thread* my_thread, filc_ptr ptr, size_t length
     return FILC_SYSCALL(my_thread, madvise(filc_ptr_ptr(ptr), length, advice));
 }
 
+static bool from_user_msync_flags(int user_flags, int* flags)
+{
+    if ((user_flags & ~(MS_ASYNC | MS_SYNC | MS_INVALIDATE)))
+        return false;
+    if (!!(user_flags & MS_ASYNC) == !!(user_flags & MS_SYNC))
+        return false;
+    *flags = user_flags;
+    return true;
+}
+
+int filc_native_zsys_msync(filc_thread* my_thread, filc_ptr ptr, size_t length, int user_flags)
+{
+    int flags;
+    if (!from_user_msync_flags(user_flags, &flags)
+        || !pas_is_aligned((uintptr_t)filc_ptr_ptr(ptr), pas_page_malloc_alignment())) {
+        filc_set_errno(EINVAL);
+        return -1;
+    }
+    if (!length)
+        return 0;
+    /* The kernel rounds the length up to a page, and so do mmap objects, so this covers the whole
+       range that the kernel will flush. */
+    length = pas_round_up_to_power_of_2(length, pas_page_malloc_alignment());
+    filc_check_read(ptr, length);
+    check_mmap(ptr);
+    return FILC_SYSCALL(my_thread, msync(filc_ptr_ptr(ptr), length, flags));
+}
+
 int filc_native_zsys_mincore(filc_thread* my_thread, filc_ptr addr, size_t len, filc_ptr vec_ptr)
 {
     filc_check_write(
@@ -6839,15 +9689,8 @@ int filc_native_zsys_gettimeofday(filc_thread* my_thread, filc_ptr tp_ptr, filc_
         filc_check_write(tp_ptr, sizeof(struct timeval));
     if (filc_ptr_ptr(tzp_ptr))
         filc_check_write(tzp_ptr, sizeof(struct timezone));
-    filc_exit(my_thread);
-    int result = gettimeofday((struct timeval*)filc_ptr_ptr(tp_ptr),
-                              (struct timezone*)filc_ptr_ptr(tzp_ptr));
-    int my_errno = errno;
-    filc_enter(my_thread);
-    PAS_ASSERT(!result || result == -1);
-    if (result < 0)
-        filc_set_errno(my_errno);
-    return result;
+    return FILC_FAST_SYSCALL(my_thread, gettimeofday((struct timeval*)filc_ptr_ptr(tp_ptr),
+                                                     (struct timezone*)filc_ptr_ptr(tzp_ptr)));
 }
 
 int filc_native_zsys_settimeofday(filc_thread* my_thread, filc_ptr tp_ptr, filc_ptr tzp_ptr)
@@ -7107,14 +9950,8 @@ int filc_native_zsys_clock_settime(filc_thread* my_thread, int clock_id, filc_pt
 int filc_native_zsys_clock_getres(filc_thread* my_thread, int clock_id, filc_ptr tp_ptr)
 {
     filc_check_write(tp_ptr, sizeof(struct timespec));
-    filc_exit(my_thread);
-    int result = clock_getres(clock_id, (struct timespec*)filc_ptr_ptr(tp_ptr));
-    int my_errno = errno;
-    filc_enter(my_thread);
-    PAS_ASSERT(!result || result == -1);
-    if (result < 0)
-        filc_set_errno(my_errno);
-    return result;
+    return FILC_FAST_SYSCALL(
+        my_thread, clock_getres(clock_id, (struct timespec*)filc_ptr_ptr(tp_ptr)));
 }
 
 int filc_native_zsys_issetugid(filc_thread* my_thread)
@@ -7242,11 +10079,110 @@ int filc_native_zsys_sendfile(filc_thread* my_thread, int out_fd, int in_fd, fil
     return FILC_SYSCALL(my_thread, sendfile(out_fd, in_fd, (off_t*)filc_ptr_ptr(offset_ptr), count));
 }
 
+static loff_t* check_optional_loff(filc_ptr offset_ptr)
+{
+    if (!filc_ptr_ptr(offset_ptr))
+        return NULL;
+    filc_check_write(offset_ptr, sizeof(loff_t));
+    return (loff_t*)filc_ptr_ptr(offset_ptr);
+}
+
+ssize_t filc_native_zsys_splice(filc_thread* my_thread, int fd_in, filc_ptr off_in_ptr, int fd_out,
+                                filc_ptr off_out_ptr, size_t len, unsigned flags)
+{
+    loff_t* off_in = check_optional_loff(off_in_ptr);
+    loff_t* off_out = check_optional_loff(off_out_ptr);
+    return FILC_SYSCALL(my_thread, splice(fd_in, off_in, fd_out, off_out, len, flags));
+}
+
+ssize_t filc_native_zsys_tee(filc_thread* my_thread, int fd_in, int fd_out, size_t len,
+                             unsigned flags)
+{
+    return FILC_SYSCALL(my_thread, tee(fd_in, fd_out, len, flags));
+}
+
+/* vmsplice into the write end of a pipe leaves the pipe referencing the pages, even after the call
+   returns. That's no good for GC memory: once the objects die, the GC reuses the memory, and the
+   reader would see whatever got allocated there. So we copy into pages that only the pipe will ever
+   see, and then unmap them. The pipe can only take as many bytes as it has capacity for, so that's
+   all we copy. */
+static ssize_t vmsplice_copy(filc_thread* my_thread, int fd, struct iovec* iov, size_t nr_segs,
+                             unsigned flags)
+{
+    int capacity = FILC_SYSCALL(my_thread, fcntl(fd, F_GETPIPE_SZ));
+    if (capacity < 0)
+        return -1;
+
+    size_t size = 0;
+    size_t index;
+    for (index = 0; index < nr_segs && size < (size_t)capacity; ++index)
+        size += pas_min_uintptr(iov[index].iov_len, (size_t)capacity - size);
+    if (!size)
+        return 0;
+
+    void* buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        filc_set_errno(errno);
+        return -1;
+    }
+    size_t offset = 0;
+    for (index = 0; offset < size; ++index) {
+        size_t count = pas_min_uintptr(iov[index].iov_len, size - offset);
+        memcpy((char*)buf + offset, iov[index].iov_base, count);
+        offset += count;
+    }
+
+    struct iovec copy_iov;
+    copy_iov.iov_base = buf;
+    copy_iov.iov_len = size;
+    ssize_t result = FILC_SYSCALL(my_thread, vmsplice(fd, &copy_iov, 1, flags));
+    PAS_ASSERT(!munmap(buf, size));
+    return result;
+}
+
+ssize_t filc_native_zsys_vmsplice(filc_thread* my_thread, int fd, filc_ptr user_iov, size_t nr_segs,
+                                  unsigned flags)
+{
+    if (nr_segs > UIO_MAXIOV) {
+        filc_set_errno(EINVAL);
+        return -1;
+    }
+
+    /* vmsplice into the write end of a pipe reads the user's memory. vmsplice out of the read end
+       of a pipe writes to the user's memory, and that's done by the time it returns, so that one
+       can be zero-copy. So what we do depends on which end of the pipe we were given. */
+    int fd_flags = FILC_SYSCALL(my_thread, fcntl(fd, F_GETFL));
+    if (fd_flags < 0)
+        return -1;
+    /* The kernel goes by whether the fd is writable, so an O_RDWR fd (like a FIFO opened that way)
+       counts as a write end. */
+    bool is_write_end = (fd_flags & O_ACCMODE) != O_RDONLY;
+
+    /* Gifting pages to the kernel is a promise that we will never touch them again. We can't make
+       that promise for GC memory, since the GC will reuse it once the object dies. */
+    flags &= ~SPLICE_F_GIFT;
+
+    struct iovec* iov = filc_prepare_iovec(
+        my_thread, user_iov, (int)nr_segs, is_write_end ? filc_read_access : filc_write_access);
+    if (is_write_end)
+        return vmsplice_copy(my_thread, fd, iov, nr_segs, flags);
+    return FILC_SYSCALL(my_thread, vmsplice(fd, iov, nr_segs, flags));
+}
+
+ssize_t filc_native_zsys_copy_file_range(filc_thread* my_thread, int fd_in, filc_ptr off_in_ptr,
+                                         int fd_out, filc_ptr off_out_ptr, size_t len,
+                                         unsigned flags)
+{
+    loff_t* off_in = check_optional_loff(off_in_ptr);
+    loff_t* off_out = check_optional_loff(off_out_ptr);
+    return FILC_SYSCALL(my_thread, copy_file_range(fd_in, off_in, fd_out, off_out, len, flags));
+}
+
+/* Waking never blocks, so there's no need to exit for it. */
 void filc_native_zsys_futex_wake(filc_thread* my_thread, filc_ptr addr_ptr, int cnt, int priv)
 {
-    filc_exit(my_thread);
+    PAS_UNUSED_PARAM(my_thread);
     futex_wake((volatile int*)filc_ptr_ptr(addr_ptr), cnt, priv);
-    filc_enter(my_thread);
 }
 
 void filc_native_zsys_futex_wait(filc_thread* my_thread, filc_ptr addr_ptr, int val, int priv)
@@ -7295,32 +10231,211 @@ int filc_native_zsys_futex_lock_pi(filc_thread* my_thread, filc_ptr addr_ptr, in
 void filc_native_zsys_futex_requeue(filc_thread* my_thread, filc_ptr addr_ptr, int priv,
                                     int wake_count, int requeue_count, filc_ptr addr2_ptr)
 {
-    filc_exit(my_thread);
+    PAS_UNUSED_PARAM(my_thread);
     futex_requeue((volatile int*)filc_ptr_ptr(addr_ptr), priv, wake_count, requeue_count,
                   (volatile int*)filc_ptr_ptr(addr2_ptr));
-    filc_enter(my_thread);
 }
 
-int filc_native_zsys_getdents(filc_thread* my_thread, int fd, filc_ptr dirent_ptr, size_t size)
-{
-    filc_check_write(dirent_ptr, size);
-    return FILC_SYSCALL(my_thread, getdents(fd, (struct dirent*)filc_ptr_ptr(dirent_ptr), size));
-}
+/* How many times zmutex_lock tries to grab a contended mutex, with pollchecks in between, before it
+   exits and parks on the futex. */
+#define FILC_MUTEX_SPIN_LIMIT 100
 
-long filc_native_zsys_getrandom(filc_thread* my_thread, filc_ptr buf_ptr, size_t buflen,
-                                unsigned flags)
+static int* check_and_get_lock_word(filc_ptr ptr)
 {
-    filc_check_write(buf_ptr, buflen);
-    return FILC_SYSCALL(my_thread, getrandom(filc_ptr_ptr(buf_ptr), buflen, flags));
+    filc_check_write(ptr, sizeof(int));
+    FILC_CHECK(
+        pas_is_aligned((uintptr_t)filc_ptr_ptr(ptr), sizeof(int)),
+        NULL,
+        "lock word must be aligned to %zu bytes (ptr = %s).",
+        sizeof(int), filc_ptr_to_new_string(ptr));
+    return (int*)filc_ptr_ptr(ptr);
 }
 
-int filc_native_zsys_epoll_create1(filc_thread* my_thread, int flags)
+/* The mutex word is 0 when unlocked, 1 when locked, and 2 when locked with possible waiters. This
+   is the classic futex mutex, except that we spin while entered first, so a quick handoff never
+   exits. Parked threads are exited, so soft handshakes run their callbacks for them without waking
+   them up. */
+static void lock_mutex_word(filc_thread* my_thread, int* mutex)
 {
-    return FILC_SYSCALL(my_thread, epoll_create1(flags));
-}
+    int expected = 0;
+    if (__atomic_compare_exchange_n(mutex, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
 
-struct user_epoll_event {
-	uint32_t events;
+    unsigned spin_count;
+    for (spin_count = 0; spin_count < FILC_MUTEX_SPIN_LIMIT; ++spin_count) {
+        expected = 0;
+        if (__atomic_load_n(mutex, __ATOMIC_RELAXED) == 0
+            && __atomic_compare_exchange_n(mutex, &expected, 1, false, __ATOMIC_ACQUIRE,
+                                           __ATOMIC_RELAXED))
+            return;
+        filc_pollcheck(my_thread, NULL);
+    }
+
+    while (__atomic_exchange_n(mutex, 2, __ATOMIC_ACQUIRE)) {
+        filc_exit(my_thread);
+        futex_wait((volatile int*)mutex, 2, 1);
+        filc_enter(my_thread);
+    }
+}
+
+static void unlock_mutex_word(int* mutex)
+{
+    if (__atomic_exchange_n(mutex, 0, __ATOMIC_RELEASE) == 2)
+        futex_wake((volatile int*)mutex, 1, 1);
+}
+
+void filc_native_zmutex_lock(filc_thread* my_thread, filc_ptr mutex_ptr)
+{
+    lock_mutex_word(my_thread, check_and_get_lock_word(mutex_ptr));
+}
+
+bool filc_native_zmutex_trylock(filc_thread* my_thread, filc_ptr mutex_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    int expected = 0;
+    return __atomic_compare_exchange_n(check_and_get_lock_word(mutex_ptr), &expected, 1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void filc_native_zmutex_unlock(filc_thread* my_thread, filc_ptr mutex_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    unlock_mutex_word(check_and_get_lock_word(mutex_ptr));
+}
+
+/* The condvar word is a sequence number that every signal and broadcast bumps. A waiter sleeps only
+   if the sequence hasn't changed since it released the mutex, so wakeups can't get lost. When it
+   wakes up, it takes the mutex in the contended state, since other waiters may be behind it. */
+void filc_native_zcondvar_wait(filc_thread* my_thread, filc_ptr condvar_ptr, filc_ptr mutex_ptr)
+{
+    int* condvar = check_and_get_lock_word(condvar_ptr);
+    int* mutex = check_and_get_lock_word(mutex_ptr);
+    int sequence = __atomic_load_n(condvar, __ATOMIC_RELAXED);
+    unlock_mutex_word(mutex);
+    filc_exit(my_thread);
+    futex_wait((volatile int*)condvar, sequence, 1);
+    filc_enter(my_thread);
+    while (__atomic_exchange_n(mutex, 2, __ATOMIC_ACQUIRE)) {
+        filc_exit(my_thread);
+        futex_wait((volatile int*)mutex, 2, 1);
+        filc_enter(my_thread);
+    }
+}
+
+void filc_native_zcondvar_signal(filc_thread* my_thread, filc_ptr condvar_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    int* condvar = check_and_get_lock_word(condvar_ptr);
+    __atomic_fetch_add(condvar, 1, __ATOMIC_RELEASE);
+    futex_wake((volatile int*)condvar, 1, 1);
+}
+
+void filc_native_zcondvar_broadcast(filc_thread* my_thread, filc_ptr condvar_ptr)
+{
+    PAS_UNUSED_PARAM(my_thread);
+    int* condvar = check_and_get_lock_word(condvar_ptr);
+    __atomic_fetch_add(condvar, 1, __ATOMIC_RELEASE);
+    futex_wake((volatile int*)condvar, INT_MAX, 1);
+}
+
+int filc_native_zsys_getdents(filc_thread* my_thread, int fd, filc_ptr dirent_ptr, size_t size)
+{
+    filc_check_write(dirent_ptr, size);
+    return FILC_SYSCALL(my_thread, getdents(fd, (struct dirent*)filc_ptr_ptr(dirent_ptr), size));
+}
+
+/* This must stay in sync with zdirent in stdfil.h. */
+struct user_zdirent {
+    uint64_t ino;
+    uint8_t type;
+    char* name;
+};
+
+/* The smallest that a struct dirent record from getdents can be. We size the buffer so that it
+   can't hold many more records than the user asked for. */
+#define READDIR_BATCH_MIN_RECORD_SIZE 24
+#define READDIR_BATCH_MIN_BUFFER_SIZE 4096
+#define READDIR_BATCH_MAX_BUFFER_SIZE 65536
+
+long filc_native_zreaddir_batch(filc_thread* my_thread, int fd, filc_ptr entries_ptr, size_t count)
+{
+    if (!count)
+        return 0;
+    filc_check_write(entries_ptr, filc_mul_size(count, sizeof(struct user_zdirent)));
+    size_t buffer_size = pas_min_uintptr(
+        pas_max_uintptr(filc_mul_size(count, READDIR_BATCH_MIN_RECORD_SIZE),
+                        READDIR_BATCH_MIN_BUFFER_SIZE),
+        READDIR_BATCH_MAX_BUFFER_SIZE);
+    char* buffer = (char*)filc_bmalloc_allocate_tmp(my_thread, buffer_size);
+
+    size_t num_entries = 0;
+    size_t names_size = 0;
+    filc_exit(my_thread);
+    long result = getdents(fd, (struct dirent*)buffer, buffer_size);
+    int my_errno = errno;
+    if (result > 0) {
+        size_t offset = 0;
+        size_t last_offset = 0;
+        while (offset < (size_t)result && num_entries < count) {
+            struct dirent* dirent = (struct dirent*)(buffer + offset);
+            names_size += strlen(dirent->d_name) + 1;
+            num_entries++;
+            last_offset = offset;
+            offset += dirent->d_reclen;
+        }
+        /* Leave the records that didn't fit for the next call, the same way seekdir would. */
+        if (offset < (size_t)result
+            && lseek(fd, ((struct dirent*)(buffer + last_offset))->d_off, SEEK_SET) < 0) {
+            result = -1;
+            my_errno = errno;
+        }
+    }
+    filc_enter(my_thread);
+    if (result < 0) {
+        filc_set_errno(my_errno);
+        return -1;
+    }
+    if (!num_entries)
+        return 0;
+
+    /* All of the names go in one object, so a batch is one allocation no matter how many entries it
+       has. */
+    filc_ptr names_ptr = filc_ptr_create_with_object(
+        my_thread, filc_allocate(my_thread, names_size));
+    char* names = (char*)filc_ptr_ptr(names_ptr);
+    struct user_zdirent* entries = (struct user_zdirent*)filc_ptr_ptr(entries_ptr);
+    size_t offset = 0;
+    size_t name_offset = 0;
+    size_t index;
+    for (index = 0; index < num_entries; ++index) {
+        struct dirent* dirent = (struct dirent*)(buffer + offset);
+        size_t name_size = strlen(dirent->d_name) + 1;
+        memcpy(names + name_offset, dirent->d_name, name_size);
+        entries[index].ino = dirent->d_ino;
+        entries[index].type = dirent->d_type;
+        filc_store_ptr_at(my_thread, entries_ptr, &entries[index].name,
+                          filc_ptr_with_offset(names_ptr, name_offset));
+        name_offset += name_size;
+        offset += dirent->d_reclen;
+    }
+    PAS_ASSERT(name_offset == names_size);
+    return (long)num_entries;
+}
+
+long filc_native_zsys_getrandom(filc_thread* my_thread, filc_ptr buf_ptr, size_t buflen,
+                                unsigned flags)
+{
+    filc_check_write(buf_ptr, buflen);
+    return FILC_SYSCALL(my_thread, getrandom(filc_ptr_ptr(buf_ptr), buflen, flags));
+}
+
+int filc_native_zsys_epoll_create1(filc_thread* my_thread, int flags)
+{
+    return FILC_SYSCALL(my_thread, epoll_create1(flags));
+}
+
+struct user_epoll_event {
+	uint32_t events;
 	epoll_data_t data;
 };
 
@@ -7336,21 +10451,36 @@ static struct epoll_event* from_user_epoll_event(filc_thread* my_thread, filc_pt
     return ev;
 }
 
-static struct epoll_event* make_epoll_events(filc_thread* my_thread, int maxevents)
+/* The kernel writes its events straight into the user's buffer, so we don't need a temporary. That
+   works because the kernel's epoll_event is never bigger than ours (on x86_64 it's packed, so it's
+   12 bytes instead of 16), and we check the whole buffer for maxevents of our events up front. */
+static struct epoll_event* check_user_epoll_events(filc_ptr evs_ptr, int maxevents)
 {
-    return filc_bmalloc_allocate_tmp(my_thread, filc_mul_size(maxevents, sizeof(struct epoll_event)));
+    PAS_ASSERT(sizeof(struct epoll_event) <= sizeof(struct user_epoll_event));
+    if (maxevents > 0)
+        filc_check_write(evs_ptr, filc_mul_size(maxevents, sizeof(struct user_epoll_event)));
+    return (struct epoll_event*)filc_ptr_ptr(evs_ptr);
 }
 
-static int to_user_epoll_events(int result, struct epoll_event* evs, filc_ptr evs_ptr)
+/* Converts only the events that the kernel returned, in place. We walk backwards because our
+   events are at least as big as the kernel's, so converting the event at some index can only
+   clobber kernel events at higher indices, which we have already converted. When the layouts agree, there's
+   nothing to do at all. */
+static int to_user_epoll_events(int result, filc_ptr evs_ptr)
 {
-    if (result < 0)
+    if (result <= 0)
         return result;
-    filc_check_write(evs_ptr, filc_mul_size(result, sizeof(struct user_epoll_event)));
+    if (sizeof(struct epoll_event) == sizeof(struct user_epoll_event)
+        && PAS_OFFSETOF(struct epoll_event, data) == PAS_OFFSETOF(struct user_epoll_event, data))
+        return result;
+    struct epoll_event* evs = (struct epoll_event*)filc_ptr_ptr(evs_ptr);
     struct user_epoll_event* user_evs = (struct user_epoll_event*)filc_ptr_ptr(evs_ptr);
     int index;
     for (index = result; index--;) {
-        user_evs[index].events = evs[index].events;
-        memcpy(&user_evs[index].data, &evs[index].data, sizeof(epoll_data_t));
+        struct epoll_event ev;
+        memcpy(&ev, evs + index, sizeof(struct epoll_event));
+        user_evs[index].events = ev.events;
+        memcpy(&user_evs[index].data, &ev.data, sizeof(epoll_data_t));
     }
     return result;
 }
@@ -7364,10 +10494,9 @@ int filc_native_zsys_epoll_ctl(filc_thread* my_thread, int epfd, int op, int fd,
 int filc_native_zsys_epoll_wait(filc_thread* my_thread, int epfd, filc_ptr events_ptr, int maxevents,
                                 int timeout)
 {
-    struct epoll_event* evs = make_epoll_events(my_thread, maxevents);
+    struct epoll_event* evs = check_user_epoll_events(events_ptr, maxevents);
     return to_user_epoll_events(
-        FILC_SYSCALL(my_thread, epoll_wait(epfd, evs, maxevents, timeout)),
-        evs, events_ptr);
+        FILC_SYSCALL(my_thread, epoll_wait(epfd, evs, maxevents, timeout)), events_ptr);
 }
 
 int filc_native_zsys_epoll_pwait(filc_thread* my_thread, int epfd, filc_ptr events_ptr, int maxevents,
@@ -7379,10 +10508,459 @@ int filc_native_zsys_epoll_pwait(filc_thread* my_thread, int epfd, filc_ptr even
         sigmask = alloca(sizeof(sigset_t));
         filc_from_user_sigset((sigset_t*)filc_ptr_ptr(sigmask_ptr), sigmask);
     }
-    struct epoll_event* evs = make_epoll_events(my_thread, maxevents);
+    struct epoll_event* evs = check_user_epoll_events(events_ptr, maxevents);
     return to_user_epoll_events(
         FILC_SYSCALL(my_thread, epoll_pwait(epfd, evs, maxevents, timeout, sigmask)),
-        evs, events_ptr);
+        events_ptr);
+}
+
+struct user_io_uring_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t ioprio;
+    int32_t fd;
+    uint64_t off;
+    void* addr;
+    uint32_t len;
+    uint32_t op_flags;
+    int32_t buf_index;
+    void* user_data;
+};
+
+struct user_io_uring_cqe {
+    void* user_data;
+    int32_t res;
+    uint32_t flags;
+};
+
+#define IO_URING_NO_SLOT UINT_MAX
+
+/* Must be called holding the ring's lock. */
+static void io_uring_did_change_num_in_flight(filc_io_uring* ring, unsigned old_num_in_flight)
+{
+    if (!!old_num_in_flight == !!ring->num_in_flight)
+        return;
+    pas_lock_lock(&in_flight_io_urings_lock);
+    if (ring->num_in_flight) {
+        ring->prev_in_flight = NULL;
+        ring->next_in_flight = in_flight_io_urings;
+        if (in_flight_io_urings)
+            in_flight_io_urings->prev_in_flight = ring;
+        in_flight_io_urings = ring;
+    } else {
+        if (ring->prev_in_flight)
+            ring->prev_in_flight->next_in_flight = ring->next_in_flight;
+        else {
+            PAS_ASSERT(in_flight_io_urings == ring);
+            in_flight_io_urings = ring->next_in_flight;
+        }
+        if (ring->next_in_flight)
+            ring->next_in_flight->prev_in_flight = ring->prev_in_flight;
+        ring->next_in_flight = NULL;
+        ring->prev_in_flight = NULL;
+    }
+    pas_lock_unlock(&in_flight_io_urings_lock);
+}
+
+static void io_uring_unmap(void* sq_ring, size_t sq_ring_size, void* cq_ring, size_t cq_ring_size,
+                           void* sqes, size_t sqes_size)
+{
+    if (sq_ring && sq_ring != MAP_FAILED)
+        munmap(sq_ring, sq_ring_size);
+    if (cq_ring && cq_ring != MAP_FAILED)
+        munmap(cq_ring, cq_ring_size);
+    if (sqes && sqes != MAP_FAILED)
+        munmap(sqes, sqes_size);
+}
+
+/* Must be called exited, or from a thread that isn't a filc_thread. */
+static void close_io_uring_fd(int fd)
+{
+    lock_io_uring_fds_for_ring();
+    remove_io_uring_fd(fd);
+    close(fd);
+    unlock_io_uring_fds();
+}
+
+void filc_io_uring_destruct(filc_io_uring* ring)
+{
+    static const bool verbose = false;
+    if (verbose)
+        pas_log("Destructing io_uring\n");
+    /* If there was anything in flight, then the ring would have been a root. */
+    PAS_ASSERT(!ring->num_in_flight);
+    io_uring_unmap(ring->sq_ring, ring->sq_ring_size, ring->cq_ring, ring->cq_ring_size,
+                   ring->sqes, ring->sqes_size);
+    close_io_uring_fd(ring->fd);
+    bmalloc_deallocate(ring->slots);
+    if (ring->fixed_buffers)
+        bmalloc_deallocate(ring->fixed_buffers);
+}
+
+void filc_io_uring_mark_outgoing_ptrs(filc_io_uring* ring, filc_object_array* stack)
+{
+    pas_lock_lock(&ring->lock);
+    size_t index;
+    for (index = ring->num_slots; index--;) {
+        fugc_mark_or_free_flight(stack, &ring->slots[index].user_data);
+        /* Note that this marks the object even if it's free. That's the point: the kernel could
+           still be writing to it. */
+        fugc_mark(stack, ring->slots[index].pinned);
+    }
+    for (index = ring->num_pinned_fixed_buffers; index--;)
+        fugc_mark(stack, ring->fixed_buffers[index].object);
+    pas_lock_unlock(&ring->lock);
+}
+
+filc_ptr filc_native_zsys_io_uring_setup(filc_thread* my_thread, unsigned entries, unsigned flags)
+{
+    if ((flags & ~(IORING_SETUP_CLAMP | IORING_SETUP_SQPOLL))) {
+        filc_set_errno(EINVAL);
+        return filc_ptr_forge_null();
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = flags;
+    /* The fd has to be registered before anyone else can see it, so that user code can never get
+       to close it or dup it. */
+    filc_exit(my_thread);
+    lock_io_uring_fds_for_ring();
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    int my_errno = errno;
+    if (fd >= 0)
+        add_io_uring_fd(fd);
+    unlock_io_uring_fds();
+    filc_enter(my_thread);
+    if (fd < 0) {
+        filc_set_errno(my_errno);
+        return filc_ptr_forge_null();
+    }
+
+    size_t sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    char* sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+    char* cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        my_errno = errno;
+        io_uring_unmap(sq_ring, sq_ring_size, cq_ring, cq_ring_size, sqes, sqes_size);
+        filc_exit(my_thread);
+        close_io_uring_fd(fd);
+        filc_enter(my_thread);
+        filc_set_errno(my_errno);
+        return filc_ptr_forge_null();
+    }
+
+    /* We never have more in flight than the CQ can hold, so the CQ never overflows. */
+    unsigned num_slots = params.cq_entries;
+    filc_io_uring_slot* slots = bmalloc_allocate(
+        filc_mul_size(sizeof(filc_io_uring_slot), num_slots));
+    memset(slots, 0, sizeof(filc_io_uring_slot) * num_slots);
+    unsigned index;
+    for (index = num_slots; index--;)
+        slots[index].next_free = index + 1 < num_slots ? index + 1 : IO_URING_NO_SLOT;
+
+    filc_io_uring* ring = (filc_io_uring*)filc_object_special_payload_with_manual_tracking(
+        filc_allocate_special(my_thread, sizeof(filc_io_uring), 1, FILC_SPECIAL_TYPE_IO_URING));
+    pas_lock_construct(&ring->lock);
+    ring->fd = fd;
+    ring->setup_flags = params.flags;
+    ring->sq_ring = sq_ring;
+    ring->sq_ring_size = sq_ring_size;
+    ring->cq_ring = cq_ring;
+    ring->cq_ring_size = cq_ring_size;
+    ring->sqes = sqes;
+    ring->sqes_size = sqes_size;
+    ring->sq_head = (unsigned*)(sq_ring + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq_ring + params.sq_off.tail);
+    ring->sq_flags = (unsigned*)(sq_ring + params.sq_off.flags);
+    ring->sq_array = (unsigned*)(sq_ring + params.sq_off.array);
+    ring->sq_mask = *(unsigned*)(sq_ring + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->num_to_submit = 0;
+    ring->cq_head = (unsigned*)(cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq_ring + params.cq_off.tail);
+    ring->cqes = cq_ring + params.cq_off.cqes;
+    ring->cq_mask = *(unsigned*)(cq_ring + params.cq_off.ring_mask);
+    ring->num_in_flight = 0;
+    ring->fixed_buffers = NULL;
+    ring->num_pinned_fixed_buffers = 0;
+    ring->num_fixed_buffers = 0;
+    ring->next_in_flight = NULL;
+    ring->prev_in_flight = NULL;
+    ring->free_slot_head = num_slots ? 0 : IO_URING_NO_SLOT;
+    pas_store_store_fence();
+    ring->num_slots = num_slots;
+    ring->slots = slots;
+
+    return filc_ptr_for_special_payload_with_manual_tracking(ring);
+}
+
+static filc_io_uring* io_uring_for_ptr(filc_ptr ring_ptr)
+{
+    filc_check_access_special(ring_ptr, FILC_SPECIAL_TYPE_IO_URING);
+    return (filc_io_uring*)filc_ptr_ptr(ring_ptr);
+}
+
+/* The kernel will access this memory after we return, so it can't be memory that munmap could later
+   hand to someone else. */
+static void check_io_uring_buffer(filc_ptr ptr, size_t size, filc_access_kind access_kind)
+{
+    filc_check_access(ptr, size, access_kind);
+    FILC_CHECK(
+        !(filc_object_get_flags(filc_ptr_object(ptr)) & FILC_OBJECT_FLAG_MMAP),
+        NULL,
+        "cannot use mmapped memory for io_uring I/O (ptr = %s).",
+        filc_ptr_to_new_string(ptr));
+}
+
+int filc_native_zsys_io_uring_register_buffers(filc_thread* my_thread, filc_ptr ring_ptr,
+                                               filc_ptr user_iov, unsigned nr_iovecs)
+{
+    filc_io_uring* ring = io_uring_for_ptr(ring_ptr);
+    if (!nr_iovecs) {
+        filc_set_errno(EINVAL);
+        return -1;
+    }
+
+    filc_io_uring_fixed_buffer* fixed_buffers = bmalloc_allocate(
+        filc_mul_size(sizeof(filc_io_uring_fixed_buffer), nr_iovecs));
+    struct iovec* iov = filc_bmalloc_allocate_tmp(
+        my_thread, filc_mul_size(sizeof(struct iovec), nr_iovecs));
+    unsigned index;
+    for (index = 0; index < nr_iovecs; ++index) {
+        filc_ptr base;
+        size_t len;
+        filc_extract_user_iovec_entry(
+            my_thread, filc_ptr_with_offset(user_iov, filc_mul_size(sizeof(struct iovec), index)),
+            &base, &len);
+        check_io_uring_buffer(base, len, filc_write_access);
+        filc_store_barrier(my_thread, filc_ptr_object(base));
+        fixed_buffers[index].object = filc_ptr_object(base);
+        fixed_buffers[index].base = filc_ptr_ptr(base);
+        fixed_buffers[index].size = len;
+        iov[index].iov_base = filc_ptr_ptr(base);
+        iov[index].iov_len = len;
+    }
+
+    /* Pin the buffers before the kernel gets them, but don't let SQEs use them until it does. */
+    pas_lock_lock(&ring->lock);
+    if (ring->fixed_buffers) {
+        pas_lock_unlock(&ring->lock);
+        bmalloc_deallocate(fixed_buffers);
+        filc_set_errno(EBUSY);
+        return -1;
+    }
+    ring->fixed_buffers = fixed_buffers;
+    ring->num_pinned_fixed_buffers = nr_iovecs;
+    pas_lock_unlock(&ring->lock);
+
+    int result = FILC_SYSCALL(
+        my_thread,
+        (int)syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, nr_iovecs));
+
+    pas_lock_lock(&ring->lock);
+    if (result < 0) {
+        ring->num_pinned_fixed_buffers = 0;
+        ring->fixed_buffers = NULL;
+    } else
+        ring->num_fixed_buffers = nr_iovecs;
+    pas_lock_unlock(&ring->lock);
+    if (result < 0)
+        bmalloc_deallocate(fixed_buffers);
+    return result;
+}
+
+int filc_native_zsys_io_uring_prep(filc_thread* my_thread, filc_ptr ring_ptr, filc_ptr sqe_ptr)
+{
+    filc_io_uring* ring = io_uring_for_ptr(ring_ptr);
+    filc_check_read(sqe_ptr, sizeof(struct user_io_uring_sqe));
+    struct user_io_uring_sqe* user_sqe = (struct user_io_uring_sqe*)filc_ptr_ptr(sqe_ptr);
+    filc_ptr addr = filc_load_ptr_at(my_thread, sqe_ptr, &user_sqe->addr);
+    filc_ptr user_data = filc_load_ptr_at(my_thread, sqe_ptr, &user_sqe->user_data);
+
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = user_sqe->opcode;
+    sqe.flags = user_sqe->flags;
+    sqe.ioprio = user_sqe->ioprio;
+    sqe.fd = user_sqe->fd;
+    sqe.off = user_sqe->off;
+    sqe.len = user_sqe->len;
+    unsigned op_flags = user_sqe->op_flags;
+    int buf_index = user_sqe->buf_index;
+
+    /* No fixed files, and no provided buffers, since then the kernel would pick the memory. */
+    if ((sqe.flags & ~(IOSQE_IO_DRAIN | IOSQE_IO_LINK | IOSQE_IO_HARDLINK | IOSQE_ASYNC))) {
+        filc_set_errno(EINVAL);
+        return -1;
+    }
+
+    filc_object* pinned = NULL;
+    switch (sqe.opcode) {
+    case IORING_OP_NOP:
+        break;
+    case IORING_OP_READ:
+    case IORING_OP_WRITE:
+        if (sqe.len) {
+            check_io_uring_buffer(
+                addr, sqe.len,
+                sqe.opcode == IORING_OP_READ ? filc_write_access : filc_read_access);
+            pinned = filc_ptr_object(addr);
+        }
+        sqe.addr = (uintptr_t)filc_ptr_ptr(addr);
+        sqe.rw_flags = op_flags;
+        break;
+    case IORING_OP_READ_FIXED:
+    case IORING_OP_WRITE_FIXED: {
+        filc_check_access(
+            addr, sqe.len,
+            sqe.opcode == IORING_OP_READ_FIXED ? filc_write_access : filc_read_access);
+        pas_lock_lock(&ring->lock);
+        bool is_valid = false;
+        if (buf_index >= 0 && (unsigned)buf_index < ring->num_fixed_buffers) {
+            filc_io_uring_fixed_buffer* buffer = ring->fixed_buffers + buf_index;
+            char* raw_addr = filc_ptr_ptr(addr);
+            is_valid = raw_addr >= buffer->base
+                && raw_addr <= buffer->base + buffer->size
+                && sqe.len <= (size_t)(buffer->base + buffer->size - raw_addr);
+        }
+        pas_lock_unlock(&ring->lock);
+        if (!is_valid) {
+            filc_set_errno(EFAULT);
+            return -1;
+        }
+        sqe.addr = (uintptr_t)filc_ptr_ptr(addr);
+        sqe.buf_index = (uint16_t)buf_index;
+        sqe.rw_flags = op_flags;
+        break;
+    }
+    case IORING_OP_FSYNC:
+        if (sqe.len || sqe.off) {
+            filc_set_errno(EINVAL);
+            return -1;
+        }
+        sqe.fsync_flags = op_flags;
+        break;
+    default:
+        filc_set_errno(EINVAL);
+        return -1;
+    }
+
+    pas_lock_lock(&ring->lock);
+    unsigned tail = *ring->sq_tail;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->sq_entries || ring->free_slot_head == IO_URING_NO_SLOT) {
+        pas_lock_unlock(&ring->lock);
+        filc_set_errno(EBUSY);
+        return -1;
+    }
+    unsigned slot_index = ring->free_slot_head;
+    filc_io_uring_slot* slot = ring->slots + slot_index;
+    ring->free_slot_head = slot->next_free;
+    filc_flight_ptr_store(my_thread, &slot->user_data, user_data);
+    filc_store_barrier(my_thread, pinned);
+    slot->pinned = pinned;
+    sqe.user_data = slot_index;
+
+    unsigned index = tail & ring->sq_mask;
+    ((struct io_uring_sqe*)ring->sqes)[index] = sqe;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->num_to_submit++;
+    unsigned old_num_in_flight = ring->num_in_flight++;
+    io_uring_did_change_num_in_flight(ring, old_num_in_flight);
+    pas_lock_unlock(&ring->lock);
+    return 0;
+}
+
+int filc_native_zsys_io_uring_submit(filc_thread* my_thread, filc_ptr ring_ptr, unsigned wait_nr)
+{
+    filc_io_uring* ring = io_uring_for_ptr(ring_ptr);
+
+    pas_lock_lock(&ring->lock);
+    unsigned to_submit = ring->num_to_submit;
+    ring->num_to_submit = 0;
+    pas_lock_unlock(&ring->lock);
+
+    unsigned flags = 0;
+    if (wait_nr)
+        flags |= IORING_ENTER_GETEVENTS;
+    if ((ring->setup_flags & IORING_SETUP_SQPOLL)) {
+        /* The kernel thread picks up SQEs on its own, so we only need a syscall to wake it up or
+           to wait. */
+        if ((__atomic_load_n(ring->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP))
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        if (!flags)
+            return to_submit;
+    }
+
+    int result = FILC_SYSCALL(
+        my_thread,
+        (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags, NULL, 0));
+    if (!(ring->setup_flags & IORING_SETUP_SQPOLL)) {
+        unsigned num_submitted = result < 0 ? 0 : (unsigned)result;
+        if (num_submitted < to_submit) {
+            /* Those SQEs are still in the ring, so the next submit has to tell the kernel about
+               them. */
+            pas_lock_lock(&ring->lock);
+            ring->num_to_submit += to_submit - num_submitted;
+            pas_lock_unlock(&ring->lock);
+        }
+    }
+    return result;
+}
+
+int filc_native_zsys_io_uring_reap(filc_thread* my_thread, filc_ptr ring_ptr, filc_ptr cqes_ptr,
+                                   unsigned max_cqes)
+{
+    filc_io_uring* ring = io_uring_for_ptr(ring_ptr);
+    if (!max_cqes)
+        return 0;
+    filc_check_write(cqes_ptr, filc_mul_size(sizeof(struct user_io_uring_cqe), max_cqes));
+    struct user_io_uring_cqe* user_cqes = (struct user_io_uring_cqe*)filc_ptr_ptr(cqes_ptr);
+
+    filc_ptr* user_datas = filc_bmalloc_allocate_tmp(
+        my_thread, filc_mul_size(sizeof(filc_ptr), max_cqes));
+    struct io_uring_cqe* cqes = filc_bmalloc_allocate_tmp(
+        my_thread, filc_mul_size(sizeof(struct io_uring_cqe), max_cqes));
+
+    pas_lock_lock(&ring->lock);
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned num_cqes = 0;
+    while (head != tail && num_cqes < max_cqes) {
+        struct io_uring_cqe cqe = ((struct io_uring_cqe*)ring->cqes)[head & ring->cq_mask];
+        PAS_ASSERT(cqe.user_data < ring->num_slots);
+        filc_io_uring_slot* slot = ring->slots + cqe.user_data;
+        user_datas[num_cqes] = filc_flight_ptr_load(my_thread, &slot->user_data);
+        cqes[num_cqes] = cqe;
+        filc_flight_ptr_store(my_thread, &slot->user_data, filc_ptr_forge_null());
+        slot->pinned = NULL;
+        slot->next_free = ring->free_slot_head;
+        ring->free_slot_head = (unsigned)cqe.user_data;
+        head++;
+        num_cqes++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    unsigned old_num_in_flight = ring->num_in_flight;
+    PAS_ASSERT(old_num_in_flight >= num_cqes);
+    ring->num_in_flight -= num_cqes;
+    io_uring_did_change_num_in_flight(ring, old_num_in_flight);
+    pas_lock_unlock(&ring->lock);
+
+    unsigned index;
+    for (index = 0; index < num_cqes; ++index) {
+        filc_store_ptr_at(my_thread, cqes_ptr, &user_cqes[index].user_data, user_datas[index]);
+        user_cqes[index].res = cqes[index].res;
+        user_cqes[index].flags = cqes[index].flags;
+    }
+    return (int)num_cqes;
 }
 
 int filc_native_zsys_sysinfo(filc_thread* my_thread, filc_ptr info_ptr)
@@ -7401,7 +10979,8 @@ int filc_native_zsys_sched_setaffinity(filc_thread* my_thread, int tid, size_t s
 int filc_native_zsys_sched_getaffinity(filc_thread* my_thread, int tid, size_t size, filc_ptr set_ptr)
 {
     filc_check_write(set_ptr, size);
-    return FILC_SYSCALL(my_thread, sched_getaffinity(tid, size, (cpu_set_t*)filc_ptr_ptr(set_ptr)));
+    return FILC_FAST_SYSCALL(
+        my_thread, sched_getaffinity(tid, size, (cpu_set_t*)filc_ptr_ptr(set_ptr)));
 }
 
 int filc_native_zsys_posix_fadvise(filc_thread* my_thread, int fd, long base, long len, int advice)
@@ -7463,6 +11042,230 @@ int filc_native_zsys_eventfd(filc_thread* my_thread, unsigned initval, int flags
     return FILC_SYSCALL(my_thread, eventfd(initval, flags));
 }
 
+int filc_native_zsys_signalfd(filc_thread* my_thread, int fd, filc_ptr mask_ptr, int flags)
+{
+    sigset_t mask;
+    filc_check_user_sigset(mask_ptr, filc_read_access);
+    filc_from_user_sigset((sigset_t*)filc_ptr_ptr(mask_ptr), &mask);
+    return FILC_SYSCALL(my_thread, signalfd(fd, &mask, flags));
+}
+
+struct user_spawn_action {
+    int32_t kind;
+    int32_t fd;
+    int32_t newfd;
+    int32_t oflag;
+    uint32_t mode;
+    void* path;
+};
+
+#define USER_SPAWN_CLOSE 0
+#define USER_SPAWN_DUP2 1
+#define USER_SPAWN_OPEN 2
+#define USER_SPAWN_CHDIR 3
+#define USER_SPAWN_FCHDIR 4
+
+struct user_spawn_attr {
+    int32_t flags;
+    int32_t pgroup;
+    void* sigmask;
+    void* sigdefault;
+    char* search_path;
+};
+
+#define USER_SPAWN_SETPGROUP 1
+#define USER_SPAWN_SETSID 2
+#define USER_SPAWN_RESETIDS 4
+#define USER_SPAWN_SETSIGMASK 8
+#define USER_SPAWN_SETSIGDEF 16
+#define USER_SPAWN_USEPATH 32
+
+static int add_spawn_action(filc_thread* my_thread, posix_spawn_file_actions_t* actions,
+                            filc_ptr action_ptr)
+{
+    struct user_spawn_action* user_action = (struct user_spawn_action*)filc_ptr_ptr(action_ptr);
+    switch (user_action->kind) {
+    case USER_SPAWN_CLOSE:
+        return posix_spawn_file_actions_addclose(actions, user_action->fd);
+    case USER_SPAWN_DUP2:
+        return posix_spawn_file_actions_adddup2(actions, user_action->fd, user_action->newfd);
+    case USER_SPAWN_OPEN:
+        return posix_spawn_file_actions_addopen(
+            actions, user_action->fd,
+            filc_check_and_get_tmp_str(
+                my_thread, filc_load_ptr_at(my_thread, action_ptr, &user_action->path)),
+            user_action->oflag, user_action->mode);
+    case USER_SPAWN_CHDIR:
+        return posix_spawn_file_actions_addchdir_np(
+            actions,
+            filc_check_and_get_tmp_str(
+                my_thread, filc_load_ptr_at(my_thread, action_ptr, &user_action->path)));
+    case USER_SPAWN_FCHDIR:
+        return posix_spawn_file_actions_addfchdir_np(actions, user_action->fd);
+    default:
+        return EINVAL;
+    }
+}
+
+/* Same as musl's default, since that's the libc the user is running. */
+#define DEFAULT_SPAWN_SEARCH_PATH "/usr/local/bin:/bin:/usr/bin"
+
+/* Sets search_path to NULL unless the attr has USER_SPAWN_USEPATH. */
+static int set_spawn_attr(filc_thread* my_thread, posix_spawnattr_t* attr, filc_ptr attr_ptr,
+                          char** search_path)
+{
+    *search_path = NULL;
+    if (!filc_ptr_ptr(attr_ptr))
+        return 0;
+
+    filc_check_read(attr_ptr, sizeof(struct user_spawn_attr));
+    struct user_spawn_attr* user_attr = (struct user_spawn_attr*)filc_ptr_ptr(attr_ptr);
+    int user_flags = user_attr->flags;
+    if ((user_flags & ~(USER_SPAWN_SETPGROUP | USER_SPAWN_SETSID | USER_SPAWN_RESETIDS
+                        | USER_SPAWN_SETSIGMASK | USER_SPAWN_SETSIGDEF | USER_SPAWN_USEPATH)))
+        return EINVAL;
+
+    short flags = 0;
+    int result;
+    if ((user_flags & USER_SPAWN_SETPGROUP)) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        result = posix_spawnattr_setpgroup(attr, user_attr->pgroup);
+        if (result)
+            return result;
+    }
+    if ((user_flags & USER_SPAWN_SETSID))
+        flags |= POSIX_SPAWN_SETSID;
+    if ((user_flags & USER_SPAWN_RESETIDS))
+        flags |= POSIX_SPAWN_RESETIDS;
+    if ((user_flags & USER_SPAWN_SETSIGMASK)) {
+        filc_ptr sigmask_ptr = filc_load_ptr_at(my_thread, attr_ptr, &user_attr->sigmask);
+        sigset_t sigmask;
+        filc_check_user_sigset(sigmask_ptr, filc_read_access);
+        filc_from_user_sigset((sigset_t*)filc_ptr_ptr(sigmask_ptr), &sigmask);
+        flags |= POSIX_SPAWN_SETSIGMASK;
+        result = posix_spawnattr_setsigmask(attr, &sigmask);
+        if (result)
+            return result;
+    }
+    if ((user_flags & USER_SPAWN_SETSIGDEF)) {
+        filc_ptr sigdefault_ptr = filc_load_ptr_at(my_thread, attr_ptr, &user_attr->sigdefault);
+        sigset_t sigdefault;
+        filc_check_user_sigset(sigdefault_ptr, filc_read_access);
+        filc_from_user_sigset((sigset_t*)filc_ptr_ptr(sigdefault_ptr), &sigdefault);
+        flags |= POSIX_SPAWN_SETSIGDEF;
+        result = posix_spawnattr_setsigdefault(attr, &sigdefault);
+        if (result)
+            return result;
+    }
+    if ((user_flags & USER_SPAWN_USEPATH)) {
+        filc_ptr search_path_ptr = filc_load_ptr_at(my_thread, attr_ptr, &user_attr->search_path);
+        if (filc_ptr_ptr(search_path_ptr))
+            *search_path = filc_check_and_get_tmp_str(my_thread, search_path_ptr);
+        else
+            *search_path = DEFAULT_SPAWN_SEARCH_PATH;
+    }
+    return posix_spawnattr_setflags(attr, flags);
+}
+
+/* Like posix_spawnp, except that it searches the given PATH. The system's posix_spawnp would search
+   the PATH in our environ, which belongs to the system libc and not to the user. The buffer has to
+   fit any directory in the search path, plus a slash, plus the file. Like musl, an EACCES on the way
+   wins over an ENOENT at the end. */
+static int spawn_with_search_path(pid_t* pid, char* file, char* search_path, char* buffer,
+                                  posix_spawn_file_actions_t* actions, posix_spawnattr_t* attr,
+                                  char** argv, char** envp)
+{
+    if (!*file)
+        return ENOENT;
+    if (strchr(file, '/'))
+        return posix_spawn(pid, file, actions, attr, argv, envp);
+    size_t file_length = strlen(file);
+    bool saw_eacces = false;
+    char* dir = search_path;
+    for (;;) {
+        char* dir_end = strchr(dir, ':');
+        if (!dir_end)
+            dir_end = dir + strlen(dir);
+        size_t dir_length = dir_end - dir;
+        char* candidate;
+        if (dir_length) {
+            memcpy(buffer, dir, dir_length);
+            buffer[dir_length] = '/';
+            memcpy(buffer + dir_length + 1, file, file_length + 1);
+            candidate = buffer;
+        } else
+            candidate = file; /* An empty entry means the current directory. */
+        int result = posix_spawn(pid, candidate, actions, attr, argv, envp);
+        switch (result) {
+        case EACCES:
+            saw_eacces = true;
+            break;
+        case ENOENT:
+        case ENOTDIR:
+            break;
+        default:
+            return result;
+        }
+        if (!*dir_end)
+            return saw_eacces ? EACCES : ENOENT;
+        dir = dir_end + 1;
+    }
+}
+
+int filc_native_zsys_posix_spawn(filc_thread* my_thread, filc_ptr pid_ptr, filc_ptr path_ptr,
+                                 filc_ptr actions_ptr, unsigned num_actions, filc_ptr attr_ptr,
+                                 filc_ptr argv_ptr, filc_ptr envp_ptr)
+{
+    if (filc_ptr_ptr(pid_ptr))
+        filc_check_write(pid_ptr, sizeof(int));
+    char* path = filc_check_and_get_tmp_str(my_thread, path_ptr);
+    char** argv = filc_check_and_get_null_terminated_string_array(my_thread, argv_ptr);
+    char** envp = filc_check_and_get_null_terminated_string_array(my_thread, envp_ptr);
+
+    filc_check_read(actions_ptr, filc_mul_size(num_actions, sizeof(struct user_spawn_action)));
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    PAS_ASSERT(!posix_spawn_file_actions_init(&actions));
+    PAS_ASSERT(!posix_spawnattr_init(&attr));
+
+    char* search_path;
+    int result = set_spawn_attr(my_thread, &attr, attr_ptr, &search_path);
+    unsigned index;
+    for (index = 0; index < num_actions && !result; ++index) {
+        result = add_spawn_action(
+            my_thread, &actions,
+            filc_ptr_with_offset(actions_ptr, index * sizeof(struct user_spawn_action)));
+    }
+
+    /* The child only runs system libc code until it execs, so there is nothing for us to stop or
+       lock. */
+    pid_t pid = 0;
+    if (!result) {
+        char* buffer = NULL;
+        if (search_path) {
+            buffer = filc_bmalloc_allocate_tmp(
+                my_thread, strlen(search_path) + 1 + strlen(path) + 1);
+        }
+        filc_exit(my_thread);
+        if (search_path) {
+            result = spawn_with_search_path(
+                &pid, path, search_path, buffer, &actions, &attr, argv, envp);
+        } else
+            result = posix_spawn(&pid, path, &actions, &attr, argv, envp);
+        filc_enter(my_thread);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (result)
+        return filc_to_user_errno(result);
+    if (filc_ptr_ptr(pid_ptr))
+        *(int*)filc_ptr_ptr(pid_ptr) = pid;
+    return 0;
+}
+
 filc_ptr filc_native_zthread_self(filc_thread* my_thread)
 {
     static const bool verbose = false;
@@ -7517,6 +11320,202 @@ void filc_native_zthread_set_self_cookie(filc_thread* my_thread, filc_ptr cookie
     }
 }
 
+/* A native thread that has finished running a filc_thread can be parked here, so that the next
+   zthread_create can hand it a new filc_thread instead of doing pthread_create. The filc_thread is
+   never reused, since the user may still be holding on to it to join it or to get its cookie. What
+   gets reused is the kernel thread, its stack, and the pthread.
+
+   A fresh pthread inherits some kernel state from whoever created it, and the user can change that
+   state while the thread runs. So, we snapshot that state when the native thread first starts, only
+   park the thread if it still has that state when its filc_thread exits, and only hand it to a
+   creator whose own state matches. If any of that doesn't hold, we fall back on a fresh pthread. */
+typedef struct {
+    cpu_set_t affinity;
+    int policy;
+    struct sched_param param;
+    int nice;
+    char name[16];
+} native_thread_state;
+
+/* Lives on the stack of the thread that claims a parked thread. The parked thread answers it once it
+   has checked for pending signals, and never touches it again after that, so it's fine for the
+   parked thread to exit right after rejecting the claim. */
+typedef struct {
+    bool is_answered;
+    bool is_accepted;
+} thread_pool_claim;
+
+struct filc_thread_pool_entry {
+    /* These are protected by the thread_pool_lock. */
+    filc_thread_pool_entry* next;
+    filc_thread_pool_entry* prev;
+    bool is_parked;
+    thread_pool_claim* claim; /* Set from when we're claimed until we answer. */
+    filc_thread* thread_to_start;
+    
+    pas_system_condition cond;
+    native_thread_state state;
+    jmp_buf exit_jmp_buf;
+};
+
+/* How long a parked native thread waits to be reused before it exits. */
+#define THREAD_POOL_IDLE_TIMEOUT_MILLISECONDS 1000.
+
+static bool get_native_thread_state(native_thread_state* state)
+{
+    pas_zero_memory(state, sizeof(native_thread_state));
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &state->affinity))
+        return false;
+    /* Use the raw syscalls, since some libcs stub out the sched_getscheduler family. */
+    state->policy = syscall(SYS_sched_getscheduler, 0);
+    if (state->policy < 0)
+        return false;
+    if (syscall(SYS_sched_getparam, 0, &state->param))
+        return false;
+    errno = 0;
+    state->nice = getpriority(PRIO_PROCESS, 0);
+    if (errno)
+        return false;
+    if (prctl(PR_GET_NAME, state->name))
+        return false;
+    return true;
+}
+
+static void remove_pooled_thread(filc_thread_pool_entry* entry)
+{
+    filc_thread_pool_lock_assert_held();
+    PAS_ASSERT(entry->is_parked);
+    PAS_ASSERT(num_pooled_threads);
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else {
+        PAS_ASSERT(first_pooled_thread == entry);
+        first_pooled_thread = entry->next;
+    }
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->is_parked = false;
+    num_pooled_threads--;
+}
+
+/* Signals sent to the old filc_thread's tid must not go to the new one. */
+static bool has_pending_signals(void)
+{
+    sigset_t pending;
+    return sigpending(&pending) || !sigisemptyset(&pending);
+}
+
+/* Called with the filc_thread that last ran on this native thread already disposed. Returns the
+   next filc_thread to run, or NULL if this native thread should exit. */
+static filc_thread* park_native_thread(filc_thread_pool_entry* entry)
+{
+    /* Keep signals blocked for as long as we're parked, so that anything sent to this tid stays
+       pending where we can see it. run_thread() installs the new filc_thread's mask. */
+    sigset_t set;
+    pas_reasonably_fill_sigset(&set);
+    PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &set, NULL));
+
+    if (has_pending_signals())
+        return NULL;
+
+    native_thread_state state;
+    if (!get_native_thread_state(&state)
+        || !pas_memory_is_equal(&state, &entry->state, sizeof(native_thread_state)))
+        return NULL;
+
+    PAS_ASSERT(!pthread_setspecific(filc_thread_key, NULL));
+
+    double deadline = pas_get_time_in_milliseconds() + THREAD_POOL_IDLE_TIMEOUT_MILLISECONDS;
+    filc_thread* result;
+    filc_thread_pool_lock_lock();
+    if (num_pooled_threads >= thread_pool_size) {
+        filc_thread_pool_lock_unlock();
+        return NULL;
+    }
+    PAS_ASSERT(!entry->is_parked);
+    PAS_ASSERT(!entry->claim);
+    PAS_ASSERT(!entry->thread_to_start);
+    entry->prev = NULL;
+    entry->next = first_pooled_thread;
+    if (first_pooled_thread)
+        first_pooled_thread->prev = entry;
+    first_pooled_thread = entry;
+    entry->is_parked = true;
+    num_pooled_threads++;
+    while (!entry->thread_to_start) {
+        if (entry->claim) {
+            /* A signal could have come in between when we parked and when we got claimed. If so,
+               let the claimer create a fresh native thread instead. */
+            bool is_accepted = !has_pending_signals();
+            entry->claim->is_answered = true;
+            entry->claim->is_accepted = is_accepted;
+            entry->claim = NULL;
+            pas_system_condition_broadcast(&thread_pool_claim_cond);
+            if (!is_accepted) {
+                filc_thread_pool_lock_unlock();
+                return NULL;
+            }
+            continue;
+        }
+        if (!entry->is_parked) {
+            /* Someone has claimed us but hasn't handed us the thread yet. */
+            pas_system_condition_wait(&entry->cond, &filc_thread_pool_lock);
+            continue;
+        }
+        if (pas_get_time_in_milliseconds() >= deadline) {
+            remove_pooled_thread(entry);
+            filc_thread_pool_lock_unlock();
+            return NULL;
+        }
+        pas_system_condition_timed_wait(&entry->cond, &filc_thread_pool_lock, deadline);
+    }
+    result = entry->thread_to_start;
+    entry->thread_to_start = NULL;
+    filc_thread_pool_lock_unlock();
+    return result;
+}
+
+/* Must be called exited. Returns a parked native thread that has been removed from the pool and that
+   had no pending signals, or NULL if there isn't one that the calling thread could have created. */
+static filc_thread_pool_entry* claim_pooled_thread(void)
+{
+    filc_thread_pool_lock_lock();
+    bool is_empty = !first_pooled_thread;
+    filc_thread_pool_lock_unlock();
+    if (is_empty)
+        return NULL;
+
+    native_thread_state state;
+    if (!get_native_thread_state(&state))
+        return NULL;
+
+    filc_thread_pool_entry* entry;
+    thread_pool_claim claim;
+    claim.is_answered = false;
+    claim.is_accepted = false;
+    filc_thread_pool_lock_lock();
+    for (entry = first_pooled_thread; entry; entry = entry->next) {
+        if (pas_memory_is_equal(&state, &entry->state, sizeof(native_thread_state))) {
+            remove_pooled_thread(entry);
+            PAS_ASSERT(!entry->claim);
+            entry->claim = &claim;
+            pas_system_condition_broadcast(&entry->cond);
+            break;
+        }
+    }
+    if (entry) {
+        while (!claim.is_answered)
+            pas_system_condition_wait(&thread_pool_claim_cond, &filc_thread_pool_lock);
+        /* A rejecting thread is on its way out, and its entry goes away with it. */
+        if (!claim.is_accepted)
+            entry = NULL;
+    }
+    filc_thread_pool_lock_unlock();
+    return entry;
+}
+
 void filc_native_zthread_exit(filc_thread* thread, filc_ptr result)
 {
     static const bool verbose = false;
@@ -7528,6 +11527,13 @@ void filc_native_zthread_exit(filc_thread* thread, filc_ptr result)
     if (verbose)
         pas_log("thread %u main function returned\n", tid);
 
+    /* Once we exit, nothing keeps the fiber we're running on alive, so its stack could get freed
+       out from under us. */
+    FILC_CHECK(
+        thread->current_fiber == thread->root_fiber,
+        NULL,
+        "cannot exit thread while running on a fiber other than the thread's root fiber.");
+
     pas_system_mutex_lock(&thread->lock);
     PAS_ASSERT(!thread->has_stopped);
     PAS_ASSERT(thread->thread);
@@ -7549,6 +11555,7 @@ void filc_native_zthread_exit(filc_thread* thread, filc_ptr result)
         pas_log("%s: blocking signals\n", __PRETTY_FUNCTION__);
     PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &set, NULL));
 
+    flush_store_barrier_buffer(thread);
     fugc_donate(&thread->mark_stack);
     filc_thread_stop_allocators(thread);
     thread->tid = 0;
@@ -7575,25 +11582,24 @@ void filc_native_zthread_exit(filc_thread* thread, filc_ptr result)
     if (verbose)
         pas_log("thread %u disposing\n", tid);
 
+    filc_thread_pool_entry* pool_entry = thread->pool_entry;
     filc_thread_dispose(thread);
 
     /* At this point, the GC no longer sees this thread except if the user is holding references to it.
        And since we're exited, the GC could run at any time. So the thread might be alive or it might be
        dead - we don't know. */
 
+    if (pool_entry)
+        longjmp(pool_entry->exit_jmp_buf, 1);
     pthread_exit(NULL);
 
     PAS_ASSERT(!"Should not get here");
 }
 
-static void* start_thread(void* arg)
+static void run_thread(filc_thread* thread, filc_thread_pool_entry* pool_entry)
 {
     static const bool verbose = false;
     
-    filc_thread* thread;
-
-    thread = (filc_thread*)arg;
-
     set_stack_limit(thread);
 
     pas_system_mutex_lock(&thread->lock);
@@ -7612,11 +11618,11 @@ static void* start_thread(void* arg)
 
     PAS_ASSERT(!pthread_setspecific(filc_thread_key, thread));
     PAS_ASSERT(!thread->thread);
+    PAS_ASSERT(!thread->pool_entry);
+    thread->pool_entry = pool_entry;
     pas_fence();
     thread->thread = pthread_self();
 
-    PAS_ASSERT(!pthread_detach(thread->thread));
-
     PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &thread->initial_blocked_sigs, NULL));
     
     filc_enter(thread);
@@ -7641,7 +11647,27 @@ static void* start_thread(void* arg)
     filc_native_zthread_exit(thread, result);
 
     PAS_ASSERT(!"Should not get here");
-    return NULL;
+}
+
+static void* start_thread(void* arg)
+{
+    filc_thread* thread = (filc_thread*)arg;
+
+    PAS_ASSERT(!pthread_detach(pthread_self()));
+
+    filc_thread_pool_entry pool_entry;
+    pas_zero_memory(&pool_entry, sizeof(pool_entry));
+    pas_system_condition_construct(&pool_entry.cond);
+    bool can_pool = thread_pool_size && get_native_thread_state(&pool_entry.state);
+
+    for (;;) {
+        /* zthread_exit longjmps back here if it's OK to park this native thread. */
+        if (!setjmp(pool_entry.exit_jmp_buf))
+            run_thread(thread, can_pool ? &pool_entry : NULL);
+        thread = park_native_thread(&pool_entry);
+        if (!thread)
+            return NULL;
+    }
 }
 
 filc_ptr filc_native_zthread_create(filc_thread* my_thread, filc_ptr callback_ptr, filc_ptr arg_ptr)
@@ -7659,17 +11685,29 @@ filc_ptr filc_native_zthread_create(filc_thread* my_thread, filc_ptr callback_pt
     filc_flight_ptr_store(my_thread, &thread->arg_ptr, arg_ptr);
     pas_system_mutex_unlock(&thread->lock);
     filc_exit(my_thread);
+    filc_thread_pool_entry* pool_entry = claim_pooled_thread();
     /* Make sure we don't create threads while in a handshake. This will hold the thread in the
        !has_started && !thread state, so if the soft handshake doesn't see it, that's fine. */
     filc_stop_the_world_lock_lock();
     filc_wait_for_world_resumption_holding_lock();
     filc_soft_handshake_lock_lock();
     thread->has_started = true;
-    pthread_t ignored_thread;
     sigset_t fullset;
     pas_reasonably_fill_sigset(&fullset);
     PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &thread->initial_blocked_sigs));
-    int result = pthread_create(&ignored_thread, NULL, start_thread, thread);
+    int result;
+    if (pool_entry) {
+        filc_thread_pool_lock_lock();
+        PAS_ASSERT(!pool_entry->is_parked);
+        PAS_ASSERT(!pool_entry->thread_to_start);
+        pool_entry->thread_to_start = thread;
+        pas_system_condition_broadcast(&pool_entry->cond);
+        filc_thread_pool_lock_unlock();
+        result = 0;
+    } else {
+        pthread_t ignored_thread;
+        result = pthread_create(&ignored_thread, NULL, start_thread, thread);
+    }
     PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &thread->initial_blocked_sigs, NULL));
     if (result)
         thread->has_started = false;
@@ -7732,6 +11770,14 @@ void filc_thread_destroy_space_with_guard_page(filc_thread* my_thread)
     my_thread->guard_page = NULL;
 }
 
+void filc_thread_reclaim_idle_space_with_guard_page(filc_thread* thread)
+{
+    PAS_ASSERT(!(thread->state & FILC_THREAD_STATE_ENTERED));
+    if (thread->is_using_space_with_guard_page)
+        return;
+    filc_thread_destroy_space_with_guard_page(thread);
+}
+
 char* filc_thread_get_end_of_space_with_guard_page_with_size(filc_thread* my_thread,
                                                              size_t desired_size)
 {
@@ -7816,11 +11862,13 @@ void filc_call_syscall_with_guarded_ptr(filc_thread* my_thread,
             pas_log("start_of_space = %p\n", start_of_space);
         memcpy(start_of_space, input_copy, limited_extent);
 
+        my_thread->is_using_space_with_guard_page = true;
         filc_exit(my_thread);
         errno = 0;
         syscall_callback(start_of_space, user_arg);
         int my_errno = errno;
         filc_enter(my_thread);
+        my_thread->is_using_space_with_guard_page = false;
         if (my_errno != EFAULT) {
             if (!my_errno) {
                 size_t index;
@@ -28,13 +28,14 @@
 
 #include "bmalloc_heap.h"
 #include "pas_allocation_config.h"
-#include "pas_hashtable.h"
 #include "pas_heap_ref.h"
+#include "pas_local_allocator.h"
 #include "pas_lock.h"
 #include "pas_lock_free_read_ptr_ptr_hashtable.h"
 #include "pas_ptr_hash_map.h"
 #include "pas_range.h"
 #include "pas_segmented_vector.h"
+#include "pas_swiss_hashtable.h"
 #include "verse_heap.h"
 #include "verse_heap_config.h"
 #include "ue_include/verse_local_allocator_ue.h"
@@ -54,6 +55,8 @@ PAS_BEGIN_EXTERN_C;
 
 struct filc_alignment_and_offset;
 struct filc_alignment_header;
+struct filc_arena;
+struct filc_fiber;
 struct filc_atomic_box;
 struct filc_cc_cursor;
 struct filc_cc_sizer;
@@ -66,11 +69,17 @@ struct filc_frame;
 struct filc_function_origin;
 struct filc_global_initialization_context;
 struct filc_inline_frame;
+struct filc_io_uring;
+struct filc_io_uring_fixed_buffer;
+struct filc_io_uring_slot;
+struct filc_lazy_global_ctors;
+struct filc_iso_heap;
 struct filc_jmp_buf;
 struct filc_lower_or_box;
 struct filc_native_frame;
 struct filc_object;
 struct filc_object_array;
+struct filc_object_array_chunk;
 struct filc_optimized_access_check_origin;
 struct filc_optimized_alignment_contradiction_origin;
 struct filc_origin;
@@ -84,7 +93,9 @@ struct filc_ptr_table_array;
 struct filc_ptr_uintptr_hash_map_entry;
 struct filc_signal_handler;
 struct filc_thread;
+struct filc_thread_pool_entry;
 struct filc_uintptr_ptr_hash_map_entry;
+struct filc_weak;
 struct pas_basic_heap_runtime_config;
 struct pas_local_allocator;
 struct pas_stream;
@@ -93,6 +104,8 @@ struct pizlonated_return_value;
 struct verse_heap_object_set;
 typedef struct filc_alignment_and_offset filc_alignment_and_offset;
 typedef struct filc_alignment_header filc_alignment_header;
+typedef struct filc_arena filc_arena;
+typedef struct filc_fiber filc_fiber;
 typedef struct filc_atomic_box filc_atomic_box;
 typedef struct filc_cc_cursor filc_cc_cursor;
 typedef struct filc_cc_sizer filc_cc_sizer;
@@ -105,11 +118,17 @@ typedef struct filc_frame filc_frame;
 typedef struct filc_function_origin filc_function_origin;
 typedef struct filc_global_initialization_context filc_global_initialization_context;
 typedef struct filc_inline_frame filc_inline_frame;
+typedef struct filc_io_uring filc_io_uring;
+typedef struct filc_io_uring_fixed_buffer filc_io_uring_fixed_buffer;
+typedef struct filc_io_uring_slot filc_io_uring_slot;
+typedef struct filc_lazy_global_ctors filc_lazy_global_ctors;
+typedef struct filc_iso_heap filc_iso_heap;
 typedef struct filc_jmp_buf filc_jmp_buf;
 typedef struct filc_lower_or_box filc_lower_or_box;
 typedef struct filc_native_frame filc_native_frame;
 typedef struct filc_object filc_object;
 typedef struct filc_object_array filc_object_array;
+typedef struct filc_object_array_chunk filc_object_array_chunk;
 typedef struct filc_optimized_access_check_origin filc_optimized_access_check_origin;
 typedef struct filc_optimized_alignment_contradiction_origin filc_optimized_alignment_contradiction_origin;
 typedef struct filc_origin filc_origin;
@@ -123,7 +142,9 @@ typedef struct filc_ptr_table_array filc_ptr_table_array;
 typedef struct filc_ptr_uintptr_hash_map_entry filc_ptr_uintptr_hash_map_entry;
 typedef struct filc_signal_handler filc_signal_handler;
 typedef struct filc_thread filc_thread;
+typedef struct filc_thread_pool_entry filc_thread_pool_entry;
 typedef struct filc_uintptr_ptr_hash_map_entry filc_uintptr_ptr_hash_map_entry;
+typedef struct filc_weak filc_weak;
 typedef struct pas_basic_heap_runtime_config pas_basic_heap_runtime_config;
 typedef struct pas_local_allocator pas_local_allocator;
 typedef struct pas_stream pas_stream;
@@ -160,6 +181,10 @@ typedef uintptr_t filc_word;
 #define FILC_SPECIAL_TYPE_DL_HANDLE       ((filc_special_type)6)
 #define FILC_SPECIAL_TYPE_JMP_BUF         ((filc_special_type)7)
 #define FILC_SPECIAL_TYPE_EXACT_PTR_TABLE ((filc_special_type)8)
+#define FILC_SPECIAL_TYPE_IO_URING        ((filc_special_type)9)
+#define FILC_SPECIAL_TYPE_WEAK            ((filc_special_type)10)
+#define FILC_SPECIAL_TYPE_ARENA           ((filc_special_type)11)
+#define FILC_SPECIAL_TYPE_FIBER           ((filc_special_type)12)
 #define FILC_SPECIAL_TYPE_MASK            ((filc_special_type)15)
 
 #define FILC_LOG_ALIGN_MASK               ((filc_log_align)31)
@@ -200,6 +225,28 @@ typedef uintptr_t filc_word;
                                            << FILC_OBJECT_FLAGS_SPECIAL_SHIFT)
 #define FILC_OBJECT_FLAGS_ALIGN_SHIFT     ((filc_object_flags)9)  /* The shift amount to get the log
                                                                      align. */
+#define FILC_OBJECT_FLAG_STACK            ((filc_object_flags)16384) /* The object lives in the
+                                                                        native frame of a function
+                                                                        that proved that it does not
+                                                                        escape. It's also flagged
+                                                                        global, so nobody marks or
+                                                                        frees it. The GC scans its
+                                                                        outgoing ptrs when it scans
+                                                                        that frame. */
+#define FILC_OBJECT_FLAG_INLINE_AUX       ((filc_object_flags)32768) /* The aux lives right after
+                                                                        the payload, in the same
+                                                                        allocation, so it shouldn't
+                                                                        be marked separately. */
+/* An mmap object for MAP_SHARED memory. mmap objects never have a global aux, so this combination
+   of flags is free. See filc_object_flags_is_shared(). */
+#define FILC_OBJECT_FLAGS_SHARED          (FILC_OBJECT_FLAG_MMAP | FILC_OBJECT_FLAG_GLOBAL_AUX)
+
+/* Readonly objects that have a payload set this bit in their upper, which makes the upper negative
+   when compared as a signed value. So, a write check that does signed compares against the raw upper
+   (the "write upper") checks bounds and writability at once, without loading the flags. Free and
+   special objects have upper == lower, so they fail such a check anyway. Use filc_object_upper() to
+   get the real upper. */
+#define FILC_OBJECT_UPPER_READONLY_TAG    ((uintptr_t)1 << (uintptr_t)63)
 
 #define FILC_ATOMIC_BOX_BIT               ((uintptr_t)1)
 
@@ -209,6 +256,10 @@ typedef uintptr_t filc_word;
 #define FILC_THREAD_STATE_CHECK_REQUESTED ((uint8_t)2)
 #define FILC_THREAD_STATE_STOP_REQUESTED  ((uint8_t)4)
 #define FILC_THREAD_STATE_DEFERRED_SIGNAL ((uint8_t)8)
+#define FILC_THREAD_STATE_CHECK_CLAIMED   ((uint8_t)16)
+#define FILC_THREAD_STATE_ASSIST_REQUESTED ((uint8_t)32) /* Only the thread itself sets this, when
+                                                             it has run up enough allocation debt
+                                                             to owe the GC some marking. */
 
 #define FILC_MAX_BYTES_FOR_SMALL_CASE     ((size_t)1000)
 #define FILC_MAX_BYTES_BETWEEN_POLLCHECKS ((size_t)10000)
@@ -218,13 +269,15 @@ typedef uintptr_t filc_word;
 
 #define FILC_NUM_UNWIND_REGISTERS         2u
 
+#define FILC_STORE_BARRIER_BUFFER_SIZE    16u
+
 /* These sizes are part of the ABI that the compiler will eventually use, so they are hardcoded
    even though we could have just computed them off what the compiler tells us. This forces us to
    realize if something changes in a way that the compiler needs to know about.
 
    Note that both the allocator offset and allocator size give breathing room for fields to be
    added. */
-#define FILC_THREAD_ALLOCATOR_OFFSET      1792u
+#define FILC_THREAD_ALLOCATOR_OFFSET      1920u
 #define FILC_THREAD_ALLOCATOR_SIZE        208u
 #define FILC_THREAD_MAX_INLINE_SIZE_CLASS 416u
 #define FILC_THREAD_NUM_ALLOCATORS \
@@ -239,6 +292,9 @@ typedef uintptr_t filc_word;
 #define FILC_NATIVE_FRAME_BMALLOC_PTR     ((uintptr_t)2)
 
 #define FILC_NATIVE_FRAME_INLINE_CAPACITY 5u
+#define FILC_NATIVE_FRAME_STR_SCRATCH_SIZE 512u
+/* Popping a native frame frees its deferred bmalloc objects in batches of up to this many. */
+#define FILC_NATIVE_FRAME_DEALLOCATION_BATCH_SIZE 16u
 
 #define FILC_CC_INLINE_SIZE               256u
 #define FILC_CC_ALIGNMENT                 64u
@@ -342,7 +398,11 @@ struct filc_object {
     
        We should test if size is better than upper at some point! The hardest part of such an
        experiment is that it substantially changes how the FilPizlonator pass works, in particular how
-       the abstract interpreter deals with check merging. */
+       the abstract interpreter deals with check merging.
+
+       The pizlonator's -filc-size-bounds-checks flag gets at the branch half of that question
+       without changing this struct: it checks (ptr - lower) < (upper - lower) in one branch, which
+       is the check that size would give us, plus the extra subtraction. */
     void* upper;
     uintptr_t aux;
 };
@@ -465,9 +525,13 @@ struct filc_origin_with_eh {
     pizlonated_linker_stub eh_data_getter;
 };
 
+/* scan_epoch is the filc_stack_scan_epoch at which the GC last scanned this frame's lowers, or zero
+   if the frame has been the top frame since then. Only frames that are not the top frame can have
+   a nonzero scan_epoch, since only the top frame can change its lowers. */
 #define FILC_FRAME_BODY \
     filc_frame* parent; \
-    const filc_origin* origin
+    const filc_origin* origin; \
+    uintptr_t scan_epoch
 
 /* Defines the following variables: origin, actual_frame, and frame. */
 #define FILC_DEFINE_FRAME(function_name) \
@@ -490,10 +554,27 @@ struct filc_ptr_array {
     unsigned capacity;
 };
 
+#define FILC_OBJECT_ARRAY_CHUNK_SIZE 8192
+#define FILC_OBJECT_ARRAY_CHUNK_CAPACITY \
+    ((FILC_OBJECT_ARRAY_CHUNK_SIZE - sizeof(filc_object_array_chunk*) - sizeof(size_t)) \
+     / sizeof(filc_object*))
+
+struct filc_object_array_chunk {
+    filc_object_array_chunk* next;
+    size_t num_objects;
+    filc_object* objects[FILC_OBJECT_ARRAY_CHUNK_CAPACITY];
+};
+
+/* A stack of objects, made up of fixed-size chunks so that it never has to be copied to grow, and
+   so that handing a whole stack (like a mark stack) over to someone else is just a pointer swap.
+   Chunks are recycled through a global pool.
+
+   Every chunk in the stack is nonempty. Only pushing puts objects into chunks, so if nobody has
+   ever moved chunks in from another stack, then every chunk but the top one is full. */
 struct filc_object_array {
     size_t num_objects;
-    size_t objects_capacity;
-    filc_object** objects;
+    filc_object_array_chunk* top;
+    filc_object_array_chunk* bottom;
 };
 
 struct filc_native_frame {
@@ -503,6 +584,11 @@ struct filc_native_frame {
     unsigned capacity;
     bool locked;
     uintptr_t inline_array[FILC_NATIVE_FRAME_INLINE_CAPACITY];
+
+    /* Short tmp strings (mostly paths passed to syscalls) get bump-allocated here, so that they
+       don't need a bmalloc allocation and a deferred free. */
+    unsigned str_scratch_used;
+    char str_scratch[FILC_NATIVE_FRAME_STR_SCRATCH_SIZE];
 };
 
 struct filc_signal_handler {
@@ -566,6 +652,12 @@ struct PAS_ALIGNED(FILC_CC_ALIGNMENT) filc_thread {
 
     filc_object_array mark_stack;
 
+    /* Objects that the store barrier was asked to mark, direct-mapped by address. An object only
+       gets marked when it's evicted or when the buffer is flushed, so stores that keep barriering
+       the same hot objects cost a compare instead of a trip to the mark bits. The buffer is flushed
+       into the mark_stack before the mark_stack is handed off or checked. */
+    filc_object* store_barrier_buffer[FILC_STORE_BARRIER_BUFFER_SIZE];
+
     pas_system_mutex lock; /* We grab all of these during fork(). */
     pas_system_condition cond;
     bool has_started; /* set to true when we actually commence starting the thread, after grabbing
@@ -584,6 +676,14 @@ struct PAS_ALIGNED(FILC_CC_ALIGNMENT) filc_thread {
                     precise semantics in that case; it allows zthread_join to return false/ESRCH if
                     you try to join a thread that died due to fork. */
     bool has_set_tid; /* set to true when the thread actually sets the tid. */
+    bool entered_since_cache_reclaim; /* set to true by filc_enter, and cleared when FUGC's idle
+                                         cache reclaim finds the thread exited. a thread that is
+                                         found exited with this still clear has stayed exited for
+                                         a whole reclaim period. */
+    bool entered_since_stack_scan; /* set to true by filc_enter, and cleared when the GC scans the
+                                      thread's roots on its behalf while it's exited. */
+    uintptr_t stack_scan_epoch; /* the filc_stack_scan_epoch at which the GC last scanned this
+                                   thread's roots. */
     pthread_t thread; /* the underlying thread is always detached and this stays non-NULL so long
                          as the thread is running.
                          
@@ -593,6 +693,18 @@ struct PAS_ALIGNED(FILC_CC_ALIGNMENT) filc_thread {
     filc_ptr arg_ptr;
     filc_ptr result_ptr;
 
+    /* The native thread that is running this filc_thread, if that native thread can be parked in
+       the thread pool once this filc_thread exits. NULL for the main thread. */
+    filc_thread_pool_entry* pool_entry;
+
+    /* How many more bytes this thread can allocate before the heap profiler samples an allocation.
+       SIZE_MAX if the heap profiler is off. */
+    size_t bytes_until_heap_sample;
+
+    /* How many bytes this thread has allocated while filc_should_assist_marking that it hasn't
+       paid for by draining its mark stack yet. */
+    size_t mark_assist_debt;
+
     filc_ptr unwind_context_ptr;
     filc_ptr exception_object_ptr;
     filc_frame* found_frame_for_unwind;
@@ -610,11 +722,30 @@ struct PAS_ALIGNED(FILC_CC_ALIGNMENT) filc_thread {
     /* On platforms that implement ioctl (and similar syscalls) by passing the data
        down to the kernel directly, we need to have some way of telling the kernel
        how much data we are able to pass. Ioctl doesn't take a length. So, we do it
-       by having a guard page. */
+       by having a guard page.
+
+       This is allocated on first use. FUGC's idle cache reclaim frees it for threads that have
+       stayed exited for a whole reclaim period, unless they're exited in the middle of a syscall
+       that's using it, which is what is_using_space_with_guard_page is for. That's only written
+       while entered, so the reclaim, which runs while the thread is exited, can trust it. */
     char* space_with_guard_page;
     char* guard_page;
+    bool is_using_space_with_guard_page;
+
+    /* The running fiber, or NULL if this thread has never used fibers. Fibers that are neither
+       running nor done are on the suspended list, and this thread scans their frames as part of
+       its roots. A finished fiber can't free the stack it's running on, so it leaves that to
+       whoever runs next by setting fiber_to_reap. */
+    filc_fiber* current_fiber;
+    filc_fiber* root_fiber;
+    filc_fiber* first_suspended_fiber;
+    filc_fiber* fiber_to_reap;
 };
 
+PAS_CREATE_SWISS_HASHTABLE(filc_global_object_map,
+                           pas_ptr_hash_map_entry,
+                           pas_ptr_hash_map_key);
+
 struct filc_global_initialization_context {
     size_t ref_count;
     
@@ -623,7 +754,28 @@ struct filc_global_initialization_context {
        
        Key: filc_ptr* pizlonated_gptr
        Value: filc_object* object */
-    pas_ptr_hash_map map;
+    filc_global_object_map map;
+
+    /* The lazy ctors of the modules whose globals got initialized in this context, most recent
+       first. They run once the context is destroyed. */
+    filc_lazy_global_ctors* lazy_ctors;
+
+    /* For the startup profiler. */
+    double profile_start_time;
+    const void* first_gptr;
+};
+
+/* The compiler emits one of these for each module built with -filc-lazy-global-ctors, instead of
+   registering the module's global ctors. Its global getters add it to their initialization context,
+   so the ctors run (in priority order) right after the first of the module's globals is
+   initialized. */
+struct filc_lazy_global_ctors {
+    /* Protected by the global_initialization_lock. */
+    filc_lazy_global_ctors* next;
+    uintptr_t is_queued;
+    
+    size_t num_ctors;
+    pizlonated_function ctors[];
 };
 
 enum filc_constant_kind {
@@ -729,9 +881,9 @@ static inline bool filc_ptr_uintptr_hash_map_key_is_equal(filc_ptr a, filc_ptr b
     return filc_ptr_is_totally_equal(a, b);
 }
 
-PAS_CREATE_HASHTABLE(filc_ptr_uintptr_hash_map,
-                     filc_ptr_uintptr_hash_map_entry,
-                     filc_ptr_uintptr_hash_map_key);
+PAS_CREATE_SWISS_HASHTABLE(filc_ptr_uintptr_hash_map,
+                           filc_ptr_uintptr_hash_map_entry,
+                           filc_ptr_uintptr_hash_map_key);
 
 typedef uintptr_t filc_uintptr_ptr_hash_map_key;
 
@@ -805,9 +957,9 @@ static inline bool filc_uintptr_ptr_hash_map_key_is_equal(uintptr_t a, uintptr_t
     return a == b;
 }
 
-PAS_CREATE_HASHTABLE(filc_uintptr_ptr_hash_map,
-                     filc_uintptr_ptr_hash_map_entry,
-                     filc_uintptr_ptr_hash_map_key);
+PAS_CREATE_SWISS_HASHTABLE(filc_uintptr_ptr_hash_map,
+                           filc_uintptr_ptr_hash_map_entry,
+                           filc_uintptr_ptr_hash_map_key);
 
 struct filc_ptr_table {
     pas_lock lock;
@@ -836,6 +988,121 @@ struct filc_exact_ptr_table {
     filc_uintptr_ptr_hash_map decode_map;
 };
 
+/* Each submitted SQE gets a slot, and the kernel's user_data is the slot index. The slot holds the
+   user's user_data ptr and the object whose memory the kernel is going to read or write, so that
+   the GC keeps that object around until we reap the CQE, even if the user frees it. */
+struct filc_io_uring_slot {
+    filc_ptr user_data;
+    filc_object* pinned;
+    unsigned next_free;
+};
+
+struct filc_io_uring_fixed_buffer {
+    filc_object* object;
+    char* base;
+    size_t size;
+};
+
+/* A runtime-owned io_uring. The SQ and CQ rings are mapped only into the runtime's view of things;
+   the user never gets to write a raw SQE, since that would let them hand the kernel any address. */
+struct filc_io_uring {
+    pas_lock lock;
+    int fd;
+    unsigned setup_flags;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    void* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_flags;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned num_to_submit;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    void* cqes;
+    unsigned cq_mask;
+
+    filc_io_uring_slot* slots;
+    unsigned num_slots;
+    unsigned free_slot_head;
+    unsigned num_in_flight;
+
+    filc_io_uring_fixed_buffer* fixed_buffers;
+    unsigned num_pinned_fixed_buffers; /* How many the GC marks. */
+    unsigned num_fixed_buffers; /* How many SQEs may use. Zero until the kernel accepts them. */
+
+    /* Rings with I/O in flight are GC roots, since the kernel may still write to pinned memory
+       even if nobody can reach the ring anymore. */
+    filc_io_uring* next_in_flight;
+    filc_io_uring* prev_in_flight;
+};
+
+/* A weak reference. The GC doesn't mark the target through this. Instead, at the end of marking,
+   the collector clears every weak whose target didn't get marked. See
+   filc_weak_get_with_manual_tracking() for how this interacts with concurrent marking. */
+struct filc_weak {
+    pas_lock lock;
+    filc_ptr target;
+    filc_weak* prev; /* protected by the weak list lock */
+    filc_weak* next; /* protected by the weak list lock */
+};
+
+/* An arena is just a list of the objects allocated in it. While the arena is alive, it keeps all
+   of them alive. Destroying the arena frees all of them at once, as if by zgc_free(), after which
+   the arena can't be used anymore. */
+struct filc_arena {
+    pas_lock lock;
+    bool is_destroyed; /* protected by the lock */
+    filc_object_array objects; /* protected by the lock until destroyed, immutable after */
+};
+
+/* A fiber is a stack that takes turns running on its carrier thread. Switching fibers just swaps
+   the machine registers along with the carrier's top_frame, top_native_frame and stack_limit, so
+   the GC and the soft handshake only ever see the carrier. The carrier scans the frames of its
+   suspended fibers as part of its own roots, which is race-free since fibers only switch while
+   the carrier is entered and scanning only happens at the carrier's pollchecks or while it's
+   exited.
+
+   Everything in here is only touched by the carrier, except that the collector reads main_ptr,
+   arg_ptr and resumer when marking the fiber. */
+struct filc_fiber {
+    filc_thread* carrier;
+
+    /* The saved machine stack pointer, if the fiber isn't running. */
+    void* saved_sp;
+
+    /* The carrier's state for this fiber, if the fiber isn't running. */
+    void* stack_limit;
+    filc_frame* top_frame;
+    filc_native_frame* top_native_frame;
+
+    /* The stack, including the guard page at the bottom. NULL for the carrier's root fiber, which
+       runs on the thread's own stack. */
+    char* stack;
+    size_t stack_size;
+
+    filc_ptr main_ptr;
+    filc_ptr arg_ptr;
+
+    /* The fiber that last switched to this one. It's what we switch to when the fiber's main
+       function returns. */
+    filc_fiber* resumer;
+
+    /* Links in the carrier's list of suspended fibers. */
+    filc_fiber* prev_suspended;
+    filc_fiber* next_suspended;
+
+    bool is_done;
+};
+
 struct filc_exception_and_int {
     bool has_exception;
     int value;
@@ -855,8 +1122,8 @@ struct filc_jmp_buf {
     bool did_save_sigmask;
     sigset_t sigmask;
     filc_jmp_buf_kind kind;
-    filc_frame* saved_top_frame; /* This is only here for assertions since longjmp does a search to
-                                    find the frame, and the frame knows about the jmp_buf. */
+    filc_frame* saved_top_frame; /* longjmp looks for this frame by identity and then checks that
+                                    one of its setjmp slots still refers to this jmp_buf. */
     filc_native_frame* saved_top_native_frame;
     size_t saved_allocation_roots_size;
     /* Need to save the GC objects referenced at that point in the stack. These must be marked so
@@ -874,7 +1141,8 @@ typedef enum filc_size_mode filc_size_mode;
 
 #define FILC_FOR_EACH_LOCK(macro) \
     macro(thread_list); \
-    macro(stop_the_world)
+    macro(stop_the_world); \
+    macro(thread_pool)
 
 /* We use the system mutex for our global locks so that they are fork-friendly. The Darwin
    os_unfair_lock, which we use for most of libpas, is not fork-friendly. That's because
@@ -899,16 +1167,36 @@ PAS_API extern pas_system_condition filc_stop_the_world_cond;
 PAS_API extern filc_thread* filc_first_thread;
 PAS_API extern pthread_key_t filc_thread_key;
 
+/* True while a FUGC cycle is marking. */
 PAS_API extern bool filc_is_marking;
 
+/* True whenever the store barrier has to run, which includes allocating auxes and atomic boxes
+   black. That's the same as filc_is_marking, except that in generational mode, the barrier also
+   builds the remembered set between cycles, so it's on from the first cycle onward. Compiled code
+   checks this one. */
+PAS_API extern bool filc_store_barrier_is_on;
+
+/* Bumped by FUGC at the start of each cycle. Never zero once marking has started. Lets
+   filc_thread_mark_roots() skip the frames and threads that it already scanned this cycle. */
+PAS_API extern uintptr_t filc_stack_scan_epoch;
+
+/* Set by FUGC while it's marking, if mutators that allocate filc_mark_assist_budget bytes have to
+   pay for it by draining their own mark stacks at their next pollcheck or exit. */
+PAS_API extern bool filc_should_assist_marking;
+PAS_API extern size_t filc_mark_assist_budget;
+
+/* In generational mode, the store barrier keeps pushing onto mutator mark stacks between cycles.
+   A mutator whose mark stack reaches this many objects donates it, and FUGC starts a cycle once
+   the donated objects reach it, too. SIZE_MAX otherwise. */
+PAS_API extern size_t filc_remembered_set_limit;
+
 PAS_API extern pas_heap* filc_default_heap;
 PAS_API extern pas_heap* filc_destructor_heap;
+PAS_API extern pas_heap* filc_mmap_heap;
 PAS_API extern verse_heap_object_set* filc_destructor_set;
 
 PAS_API extern const filc_object filc_free_singleton;
 
-PAS_API extern filc_object_array filc_global_variable_roots;
-
 /* Anything that takes origin for checking has the following meaning:
    
    - If the origin is NULL, we just use the origin that's at the top of the stack already.
@@ -989,10 +1277,34 @@ static inline size_t filc_is_fast_allocator_index(size_t allocator_index)
     return allocator_index < FILC_THREAD_NUM_ALLOCATORS;
 }
 
+/* These are the slow paths of filc_thread_allocate(). They're also where allocation debt gets
+   charged, since a refill hands the thread a whole bump region at once, and charging for that is
+   much cheaper than charging for each object. */
+PAS_API void* filc_thread_allocate_slow(filc_thread* thread, pas_local_allocator* allocator);
+PAS_API void* filc_thread_allocate_large(filc_thread* thread, size_t size);
+
+/* The local allocator is in bump mode whenever it's allocating out of a page that was totally
+   empty when it picked it up, which is the common case for allocation-heavy code that churns
+   through short-lived objects. We inline that case here so that it's just a decrement and a
+   branch. Anything else (free bits, refill) is left to verse_local_allocator_allocate.
+
+   Bump allocation doesn't need any special handling during marking. The verse_heap does black
+   allocation at refill time, when it hands the page to the local allocator, so the fast path never
+   has to look at GC state. It also means that we don't need a separate nursery: FUGC
+   doesn't move objects, so a nursery couldn't be evacuated anyway, and the local allocator already
+   bump allocates out of empty pages. */
 static inline void* filc_thread_allocate_with_allocator_index(filc_thread* thread,
                                                               size_t allocator_index)
 {
-    return verse_local_allocator_allocate(filc_thread_allocator(thread, allocator_index));
+    pas_local_allocator* allocator = filc_thread_allocator(thread, allocator_index);
+    unsigned remaining = allocator->remaining;
+    if (PAS_LIKELY(remaining)) {
+        PAS_TESTING_ASSERT(allocator->payload_end);
+        PAS_TESTING_ASSERT(remaining - allocator->object_size < remaining);
+        allocator->remaining = remaining - allocator->object_size;
+        return (void*)(allocator->payload_end - remaining);
+    }
+    return filc_thread_allocate_slow(thread, allocator);
 }
 
 /* Super fast allocation function usable only when for the default heap and only if you don't need
@@ -1002,7 +1314,7 @@ static inline void* filc_thread_allocate(filc_thread* thread, size_t size)
     size_t allocator_index = filc_compute_allocator_index(size);
     if (PAS_LIKELY(filc_is_fast_allocator_index(allocator_index)))
         return filc_thread_allocate_with_allocator_index(thread, allocator_index);
-    return verse_heap_allocate(filc_default_heap, size);
+    return filc_thread_allocate_large(thread, size);
 }
 
 PAS_API filc_thread* filc_get_my_thread(void);
@@ -1019,6 +1331,17 @@ PAS_API void filc_soft_handshake_no_op_callback(filc_thread* my_thread, void* ar
 /* Calls the callback from every thread. Returns when every thread has done so. */
 PAS_API void filc_soft_handshake(void (*callback)(filc_thread* my_thread, void* arg), void* arg);
 
+/* Like filc_soft_handshake(), but once the handshake is posted, the handshaking thread calls help()
+   instead of running the callbacks of exited threads one at a time by itself. The help() function
+   should get any number of threads, including the calling one, to call filc_soft_handshake_help(),
+   and must not return until all of them have returned. The help() function is optional. */
+PAS_API void filc_soft_handshake_with_helpers(
+    void (*callback)(filc_thread* my_thread, void* arg), void* arg, void (*help)(void));
+
+/* Claims and runs the callbacks of the current handshake's exited threads, until there are none
+   left to claim. Can only be called from a filc_soft_handshake_with_helpers() help() function. */
+PAS_API void filc_soft_handshake_help(void);
+
 PAS_API void filc_stop_the_world(void);
 PAS_API void filc_resume_the_world(void);
 
@@ -1047,6 +1370,8 @@ static inline void filc_pop_frame(filc_thread* my_thread, filc_frame* frame)
 {
     PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
     PAS_TESTING_ASSERT(my_thread->top_frame == frame);
+    if (frame->parent)
+        frame->parent->scan_epoch = 0;
     my_thread->top_frame = frame->parent;
 }
 
@@ -1074,30 +1399,44 @@ static inline void* filc_ptr_array_pop(filc_ptr_array* array)
 static inline void filc_object_array_construct(filc_object_array* array)
 {
     array->num_objects = 0;
-    array->objects_capacity = 0;
-    array->objects = NULL;
+    array->top = NULL;
+    array->bottom = NULL;
 }
 
+PAS_API void filc_object_array_reset(filc_object_array* array);
+
 static inline void filc_object_array_destruct(filc_object_array* array)
 {
-    if (array->objects)
-        bmalloc_deallocate(array->objects);
+    filc_object_array_reset(array);
 }
 
 PAS_API void filc_object_array_push(filc_object_array* array, filc_object* object);
 
+/* Gets rid of the top chunk, which must be empty. */
+PAS_API void filc_object_array_pop_chunk(filc_object_array* array);
+
 static filc_object* filc_object_array_pop(filc_object_array* array)
 {
-    if (!array->num_objects)
+    filc_object_array_chunk* chunk = array->top;
+    filc_object* result;
+    if (!chunk)
         return NULL;
-    return array->objects[--array->num_objects];
+    PAS_TESTING_ASSERT(chunk->num_objects);
+    result = chunk->objects[--chunk->num_objects];
+    array->num_objects--;
+    if (!chunk->num_objects)
+        filc_object_array_pop_chunk(array);
+    return result;
 }
-
-PAS_API void filc_object_array_reset(filc_object_array* array);
 PAS_API void filc_object_array_push_all(filc_object_array* to, filc_object_array* from);
 PAS_API void filc_object_array_pop_all_from_and_push_to(filc_object_array* from,
                                                         filc_object_array* to);
 
+/* Moves the `count` most recently pushed objects from `from` to `to`. */
+PAS_API void filc_object_array_pop_some_from_and_push_to(filc_object_array* from,
+                                                         filc_object_array* to,
+                                                         size_t count);
+
 static inline void filc_push_allocation_root(filc_thread* my_thread, void* allocation_root)
 {
     PAS_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
@@ -1159,6 +1498,7 @@ static PAS_ALWAYS_INLINE void filc_push_native_frame(
     frame->size = 0;
     frame->capacity = FILC_NATIVE_FRAME_INLINE_CAPACITY;
     frame->locked = false;
+    frame->str_scratch_used = 0;
     
     PAS_TESTING_ASSERT(my_thread->top_native_frame != frame);
     filc_assert_top_frame_locked(my_thread);
@@ -1173,6 +1513,8 @@ static PAS_ALWAYS_INLINE void filc_pop_native_frame(filc_thread* my_thread, filc
     if (frame->size) {
         unsigned index;
         uintptr_t* array = frame->array;
+        void* deferred[FILC_NATIVE_FRAME_DEALLOCATION_BATCH_SIZE];
+        size_t num_deferred = 0;
         for (index = frame->size; index--;) {
             uintptr_t encoded_ptr = array[index];
             if ((encoded_ptr & FILC_NATIVE_FRAME_PTR_MASK) == FILC_NATIVE_FRAME_TRACKED_PTR)
@@ -1180,8 +1522,14 @@ static PAS_ALWAYS_INLINE void filc_pop_native_frame(filc_thread* my_thread, filc
             
             PAS_TESTING_ASSERT(
                 (encoded_ptr & FILC_NATIVE_FRAME_PTR_MASK) == FILC_NATIVE_FRAME_BMALLOC_PTR);
-            bmalloc_deallocate((void*)(encoded_ptr & ~FILC_NATIVE_FRAME_PTR_MASK));
+            deferred[num_deferred++] = (void*)(encoded_ptr & ~FILC_NATIVE_FRAME_PTR_MASK);
+            if (num_deferred == FILC_NATIVE_FRAME_DEALLOCATION_BATCH_SIZE) {
+                bmalloc_deallocate_batch(deferred, num_deferred);
+                num_deferred = 0;
+            }
         }
+        if (num_deferred)
+            bmalloc_deallocate_batch(deferred, num_deferred);
         if (array != frame->inline_array)
             bmalloc_deallocate(array);
     } else {
@@ -1226,7 +1574,8 @@ static inline bool filc_pollcheck(filc_thread* my_thread, const filc_origin* ori
     PAS_TESTING_ASSERT(my_thread->state & FILC_THREAD_STATE_ENTERED);
     if (PAS_UNLIKELY((my_thread->state & (FILC_THREAD_STATE_CHECK_REQUESTED |
                                           FILC_THREAD_STATE_STOP_REQUESTED |
-                                          FILC_THREAD_STATE_DEFERRED_SIGNAL)))) {
+                                          FILC_THREAD_STATE_DEFERRED_SIGNAL |
+                                          FILC_THREAD_STATE_ASSIST_REQUESTED)))) {
         filc_pollcheck_slow(my_thread, origin);
         return true;
     }
@@ -1238,11 +1587,28 @@ static inline bool filc_pollcheck(filc_thread* my_thread, const filc_origin* ori
 PAS_API void filc_pollcheck_outline(filc_thread* my_thread, const filc_origin* origin);
 
 PAS_API void filc_thread_stop_allocators(filc_thread* my_thread);
+
+/* Like filc_thread_stop_allocators(), but for the start of marking. The thread's inline allocators
+   that are bump allocating switch to black allocation in place, so the thread doesn't have to
+   refill them all right after the handshake. */
+PAS_API void filc_thread_start_allocating_black(filc_thread* my_thread);
+
+/* Marks the thread's allocation roots, frames, and native frames. This only rescans what might
+   have changed since the last time it ran for this thread in the current cycle: frames that have
+   not been the top frame since then are skipped, and a thread that stayed exited since then is
+   skipped entirely. That's sound because the store barrier has been on since the first scan, so
+   anything stored into a stack object of a skipped frame has already been marked. */
 PAS_API void filc_thread_mark_roots(filc_thread* my_thread);
 PAS_API void filc_thread_sweep_mark_stack(filc_thread* my_thread);
 PAS_API void filc_thread_donate(filc_thread* my_thread);
 
-PAS_API void filc_mark_global_roots(filc_object_array* mark_stack);
+/* Marks the signal handlers and threads, and pushes the global variables that have outgoing ptrs.
+
+   If only_new_global_variables is true, then only global variables that were registered since the
+   last call get pushed. That's only correct if the store barrier has been on continuously since the
+   last call and the marks from then have not been cleared, since then anything stored into an
+   older global variable has already been marked. */
+PAS_API void filc_mark_global_roots(filc_object_array* mark_stack, bool only_new_global_variables);
 
 static inline bool filc_origin_node_is_inline_frame(const filc_origin_node* origin_node)
 {
@@ -1472,6 +1838,15 @@ static inline bool filc_object_flags_is_special(filc_object_flags flags)
     return filc_object_flags_special_type(flags) != FILC_SPECIAL_TYPE_NONE;
 }
 
+/* Ptrs can't be shared across processes, so memmoves into shared objects only copy the bytes, and
+   the GC never has an aux to scan for them. A ptr store into a shared object does get an aux, since
+   compiled code reads lowers back from the aux that it ensured, and that turns the object into an
+   ordinary mmap object. */
+static inline bool filc_object_flags_is_shared(filc_object_flags flags)
+{
+    return (flags & FILC_OBJECT_FLAGS_SHARED) == FILC_OBJECT_FLAGS_SHARED;
+}
+
 static inline filc_log_align filc_object_flags_log_align(filc_object_flags flags)
 {
     return (flags >> FILC_OBJECT_FLAGS_ALIGN_SHIFT) & FILC_LOG_ALIGN_MASK;
@@ -1570,11 +1945,25 @@ static inline void* filc_object_lower(filc_object* object)
 }
 
 static inline void* filc_object_upper_not_null(filc_object* object)
+{
+    PAS_TESTING_ASSERT(object);
+    return (void*)((uintptr_t)object->upper & ~FILC_OBJECT_UPPER_READONLY_TAG);
+}
+
+/* The upper that write checks compare against as signed. See FILC_OBJECT_UPPER_READONLY_TAG. */
+static inline void* filc_object_write_upper_not_null(filc_object* object)
 {
     PAS_TESTING_ASSERT(object);
     return object->upper;
 }
 
+static inline void* filc_object_encode_upper(void* upper, filc_object_flags flags)
+{
+    if ((flags & FILC_OBJECT_FLAG_READONLY))
+        return (void*)((uintptr_t)upper | FILC_OBJECT_UPPER_READONLY_TAG);
+    return upper;
+}
+
 static inline void* filc_object_upper(filc_object* object)
 {
     if (!object)
@@ -1605,7 +1994,11 @@ static inline void filc_object_validate_special_with_payload(filc_object* object
                filc_object_special_type(object) == FILC_SPECIAL_TYPE_PTR_TABLE ||
                filc_object_special_type(object) == FILC_SPECIAL_TYPE_PTR_TABLE_ARRAY ||
                filc_object_special_type(object) == FILC_SPECIAL_TYPE_JMP_BUF ||
-               filc_object_special_type(object) == FILC_SPECIAL_TYPE_EXACT_PTR_TABLE);
+               filc_object_special_type(object) == FILC_SPECIAL_TYPE_EXACT_PTR_TABLE ||
+               filc_object_special_type(object) == FILC_SPECIAL_TYPE_IO_URING ||
+               filc_object_special_type(object) == FILC_SPECIAL_TYPE_WEAK ||
+               filc_object_special_type(object) == FILC_SPECIAL_TYPE_ARENA ||
+               filc_object_special_type(object) == FILC_SPECIAL_TYPE_FIBER);
 }
 
 static inline void filc_object_testing_validate_special_with_payload(filc_object* object)
@@ -1663,7 +2056,8 @@ static inline bool filc_allocation_starts_with_alignment_header(void* allocation
 {
     filc_alignment_header* header = (filc_alignment_header*)allocation;
     if (header->encoded_alignment & PAS_ADDRESS_MASK) {
-        PAS_TESTING_ASSERT(!(header->encoded_alignment >> (uintptr_t)PAS_ADDRESS_BITS));
+        PAS_TESTING_ASSERT(!((header->encoded_alignment & ~FILC_OBJECT_UPPER_READONLY_TAG)
+                             >> (uintptr_t)PAS_ADDRESS_BITS));
         return false;
     }
     PAS_TESTING_ASSERT(filc_alignment_header_get_alignment(header) > FILC_MINALIGN);
@@ -1713,7 +2107,7 @@ static inline void* filc_ptr_upper(filc_ptr ptr)
 {
     if (filc_ptr_is_boxed_int(ptr))
         return 0;
-    return filc_ptr_object(ptr)->upper;
+    return filc_object_upper_not_null(filc_ptr_object(ptr));
 }
 
 static inline uintptr_t filc_ptr_offset(filc_ptr ptr)
@@ -1937,7 +2331,7 @@ PAS_API void filc_store_barrier_slow(filc_thread* my_thread, filc_object* target
 
 static inline void filc_store_barrier(filc_thread* my_thread, filc_object* target)
 {
-    if (PAS_UNLIKELY(filc_is_marking) && target)
+    if (PAS_UNLIKELY(filc_store_barrier_is_on) && target)
         filc_store_barrier_slow(my_thread, target);
 }
 
@@ -1945,7 +2339,7 @@ void filc_store_barrier_for_lower_slow(filc_thread* my_thread, void* lower);
 
 static inline void filc_store_barrier_for_lower(filc_thread* my_thread, void* lower)
 {
-    if (PAS_UNLIKELY(filc_is_marking) && lower)
+    if (PAS_UNLIKELY(filc_store_barrier_is_on) && lower)
         filc_store_barrier_for_lower_slow(my_thread, lower);
 }
 
@@ -2062,8 +2456,10 @@ static PAS_ALWAYS_INLINE bool filc_is_native_access_ok(filc_ptr ptr,
     if (!pas_is_aligned((uintptr_t)filc_ptr_ptr(ptr), size_and_alignment))
         return false;
     filc_object* object = filc_ptr_object(ptr);
-    if (kind == filc_write_access && (filc_object_get_flags(object) & FILC_OBJECT_FLAG_READONLY))
-        return false;
+    if (kind == filc_write_access) {
+        return (intptr_t)filc_ptr_ptr(ptr) >= (intptr_t)filc_object_lower_not_null(object)
+            && (intptr_t)filc_ptr_ptr(ptr) < (intptr_t)filc_object_write_upper_not_null(object);
+    }
     return filc_ptr_ptr(ptr) >= filc_object_lower_not_null(object)
         && filc_ptr_ptr(ptr) < filc_object_upper_not_null(object);
 }
@@ -2619,6 +3015,10 @@ static inline bool filc_special_type_is_valid(filc_special_type special_type)
     case FILC_SPECIAL_TYPE_PTR_TABLE_ARRAY:
     case FILC_SPECIAL_TYPE_DL_HANDLE:
     case FILC_SPECIAL_TYPE_JMP_BUF:
+    case FILC_SPECIAL_TYPE_IO_URING:
+    case FILC_SPECIAL_TYPE_WEAK:
+    case FILC_SPECIAL_TYPE_ARENA:
+    case FILC_SPECIAL_TYPE_FIBER:
         return true;
     default:
         return false;
@@ -2631,6 +3031,10 @@ static inline bool filc_special_type_has_destructor(filc_special_type special_ty
     case FILC_SPECIAL_TYPE_THREAD:
     case FILC_SPECIAL_TYPE_PTR_TABLE:
     case FILC_SPECIAL_TYPE_EXACT_PTR_TABLE:
+    case FILC_SPECIAL_TYPE_IO_URING:
+    case FILC_SPECIAL_TYPE_WEAK:
+    case FILC_SPECIAL_TYPE_ARENA:
+    case FILC_SPECIAL_TYPE_FIBER:
         return true;
     case FILC_SPECIAL_TYPE_FUNCTION:
     case FILC_SPECIAL_TYPE_SIGNAL_HANDLER:
@@ -2672,6 +3076,35 @@ filc_object* filc_allocate_special_with_existing_payload(
    object's lower/upper are set accordingly. */
 filc_object* filc_allocate(filc_thread* my_thread, size_t size);
 
+/* Like filc_allocate, but for objects that are known to hold ptrs. The aux is allocated up front in
+   the same allocation as the payload, so it's one allocation instead of two and the aux is next to
+   the payload in memory. */
+filc_object* filc_allocate_with_aux(filc_thread* my_thread, size_t size);
+
+/* Like filc_allocate, but the payload is not zeroed, except for the padding past size. Only for
+   callers that overwrite all size bytes before anyone can see them. The compiler uses this for
+   mallocs that are immediately followed by a memcpy, memmove, or memset of the whole thing. */
+filc_object* filc_allocate_uninitialized(filc_thread* my_thread, size_t size);
+
+/* An iso heap is how the compiler asks for all objects of one type to share pages that no other
+   type uses, so that walking or marking a structure made of that type stays on a few pages. With
+   -mllvm -filc-iso-heaps, the compiler emits one of these per named struct type that it heap
+   allocates, and modules share it by name. The heap starts out NULL and is picked the first time
+   the type is allocated. Verse heaps can only be created before the first allocation, so we pick
+   from a pool of FILC_ISO_HEAPS heaps that is created at startup. Types get their own heap in the
+   order they are first allocated. Once the pool runs out, they share heaps round-robin. With
+   FILC_ISO_HEAPS=0, iso allocations go to the default heap. */
+struct filc_iso_heap {
+    pas_heap* heap;
+};
+
+PAS_API extern unsigned filc_num_iso_heaps;
+
+/* Like filc_allocate and filc_allocate_with_aux, but the object goes on the iso heap's pages. */
+filc_object* filc_allocate_iso(filc_thread* my_thread, filc_iso_heap* iso_heap, size_t size);
+filc_object* filc_allocate_iso_with_aux(filc_thread* my_thread, filc_iso_heap* iso_heap,
+                                        size_t size);
+
 /* Allocates an object with a payload of the given size and alignment. The object itself may or may not
    have that alignment. Word types start out unset and the object's lower/upper are set accordingly. */
 filc_object* filc_allocate_with_alignment(filc_thread* my_thread, size_t size, size_t alignment);
@@ -2715,6 +3148,34 @@ filc_ptr filc_exact_ptr_table_decode(filc_thread* my_thread, filc_exact_ptr_tabl
 void filc_exact_ptr_table_mark_outgoing_ptrs(filc_exact_ptr_table* ptr_table,
                                              filc_object_array* stack);
 
+void filc_io_uring_destruct(filc_io_uring* ring);
+void filc_io_uring_mark_outgoing_ptrs(filc_io_uring* ring, filc_object_array* stack);
+
+filc_weak* filc_weak_create(filc_thread* my_thread, filc_ptr target);
+void filc_weak_destruct(filc_weak* weak);
+filc_ptr filc_weak_get_with_manual_tracking(filc_thread* my_thread, filc_weak* weak);
+
+/* Called by the collector once there's nothing left to mark. If there are any weaks, this stops
+   them from handing out unmarked targets and returns true, in which case the collector has to
+   handshake and drain again before calling filc_clear_dead_weaks(). */
+PAS_API bool filc_freeze_weaks(void);
+PAS_API void filc_clear_dead_weaks(void);
+
+filc_arena* filc_arena_create(filc_thread* my_thread);
+void filc_arena_destruct(filc_arena* arena);
+void filc_arena_mark_outgoing_ptrs(filc_arena* arena, filc_object_array* stack);
+
+void filc_fiber_destruct(filc_fiber* fiber);
+void filc_fiber_mark_outgoing_ptrs(filc_fiber* fiber, filc_object_array* stack);
+
+/* Implemented in filc_fiber_switch.s. filc_fiber_switch_stacks() saves the callee-saved registers
+   on the current stack, stores the stack pointer to *saved_sp, and then resumes whatever was saved
+   at new_sp. A new fiber's stack is set up to resume into filc_fiber_entry(), which calls
+   filc_fiber_start() with the fiber that was saved in r12. */
+PAS_API void filc_fiber_switch_stacks(void** saved_sp, void* new_sp);
+PAS_API void filc_fiber_entry(void);
+PAS_API PAS_NO_RETURN void filc_fiber_start(filc_fiber* fiber);
+
 static inline const char* filc_access_kind_get_string(filc_access_kind access_kind)
 {
     switch (access_kind) {
@@ -2742,12 +3203,23 @@ static PAS_ALWAYS_INLINE void filc_check_aligned_access(
         return;
 
     if (PAS_UNLIKELY(!pas_is_aligned((uintptr_t)filc_ptr_ptr(ptr), alignment))
-        || PAS_UNLIKELY(!filc_ptr_object(ptr))
-        || PAS_UNLIKELY(filc_ptr_ptr(ptr) < filc_ptr_lower(ptr))
-        || PAS_UNLIKELY(filc_ptr_ptr(ptr) >= filc_ptr_upper(ptr))
-        || PAS_UNLIKELY(bytes > (uintptr_t)((char*)filc_ptr_upper(ptr) - (char*)filc_ptr_ptr(ptr)))
-        || (kind == filc_write_access
-            && PAS_UNLIKELY(filc_object_get_flags(filc_ptr_object(ptr)) & FILC_OBJECT_FLAG_READONLY)))
+        || PAS_UNLIKELY(!filc_ptr_object(ptr)))
+        filc_check_aligned_access_fail(ptr, bytes, alignment, kind);
+
+    char* raw_ptr = (char*)filc_ptr_ptr(ptr);
+    char* upper;
+    if (kind == filc_write_access) {
+        /* This also checks that the object is writable. See FILC_OBJECT_UPPER_READONLY_TAG. */
+        upper = (char*)filc_object_write_upper_not_null(filc_ptr_object(ptr));
+        if (PAS_UNLIKELY((intptr_t)raw_ptr < (intptr_t)filc_ptr_lower(ptr))
+            || PAS_UNLIKELY((intptr_t)raw_ptr >= (intptr_t)upper))
+            filc_check_aligned_access_fail(ptr, bytes, alignment, kind);
+    } else {
+        upper = (char*)filc_object_upper_not_null(filc_ptr_object(ptr));
+        if (PAS_UNLIKELY(raw_ptr < (char*)filc_ptr_lower(ptr)) || PAS_UNLIKELY(raw_ptr >= upper))
+            filc_check_aligned_access_fail(ptr, bytes, alignment, kind);
+    }
+    if (PAS_UNLIKELY(bytes > (uintptr_t)(upper - raw_ptr)))
         filc_check_aligned_access_fail(ptr, bytes, alignment, kind);
 }
 
@@ -2888,6 +3360,35 @@ void filc_memset(filc_thread* my_thread, filc_ptr ptr, unsigned value, size_t co
 void filc_memmove(filc_thread* my_thread, filc_ptr dst, filc_ptr src, size_t count,
                   const filc_origin* origin);
 
+/* These are what the compiler turns memcmp, bcmp, memchr, memrchr, and memmem calls into. They
+   check the bounds once and then run the host libc's routines, with pollchecks every
+   FILC_MAX_BYTES_BETWEEN_POLLCHECKS bytes. memchr only checks as far as it had to look, like
+   libc. */
+int filc_memcmp(filc_thread* my_thread, filc_ptr a, filc_ptr b, size_t count,
+                const filc_origin* origin);
+filc_ptr filc_memchr(filc_thread* my_thread, filc_ptr ptr, int chr, size_t count,
+                     const filc_origin* origin);
+filc_ptr filc_memrchr(filc_thread* my_thread, filc_ptr ptr, int chr, size_t count,
+                      const filc_origin* origin);
+filc_ptr filc_memmem(filc_thread* my_thread, filc_ptr haystack, size_t haystack_size,
+                     filc_ptr needle, size_t needle_size, const filc_origin* origin);
+
+/* This is what the compiler checks llvm.masked.load and llvm.masked.store (and the x86 maskload
+   and maskstore intrinsics) with when the mask isn't a constant. Bit i of lane_mask says if lane i
+   is enabled. The CPU doesn't touch disabled lanes, so only the span from the first enabled lane
+   to the last one has to be in bounds, and an all-zero mask checks nothing. */
+void filc_check_masked_access(filc_ptr ptr, uint64_t lane_mask, size_t lane_size,
+                              filc_access_kind access_kind, const filc_origin* origin);
+
+/* These are what the compiler turns calloc, realloc, and free calls into; malloc calls become
+   filc_allocate. They do what zgc_alloc, zgc_realloc, and zgc_free do, minus the trip through
+   libc and the native call path. calloc sets errno to ENOMEM and returns null if the size
+   overflows. */
+filc_ptr filc_calloc(filc_thread* my_thread, size_t count, size_t size);
+filc_ptr filc_realloc(filc_thread* my_thread, filc_ptr old_ptr, size_t size,
+                      const filc_origin* origin);
+void filc_free_ptr(filc_thread* my_thread, filc_ptr ptr, const filc_origin* origin);
+
 filc_ptr filc_promote_args_to_heap(filc_thread* my_thread, size_t size);
 size_t filc_prepare_to_return_with_data(filc_thread* my_thread, filc_ptr rets,
                                         const filc_origin* origin);
@@ -2914,8 +3415,11 @@ char* filc_check_and_get_new_str_for_valid_range(char* base, size_t size);
 
 char* filc_check_and_get_new_str_or_null(filc_ptr ptr);
 
-/* Helper around filc_check_and_get_new_str that doesn't require freeing, since the
-   new string is added to the native frame's bmalloc deferral list. */
+/* Helper around filc_check_and_get_new_str that doesn't require freeing, since the string lives
+   until the native frame is popped. Short strings are copied into the native frame's string
+   scratch, longer ones are added to the native frame's bmalloc deferral list, and strings in
+   readonly globals (like string literals) are returned without copying, since nobody can change
+   or free them. */
 char* filc_check_and_get_tmp_str(filc_thread* my_thread, filc_ptr ptr);
 char* filc_check_and_get_tmp_str_for_valid_range(filc_thread* my_thread,
                                                  char* base, size_t size);
@@ -2955,11 +3459,22 @@ bool filc_global_initialization_context_add(
    Destroying the set means storing all known ptr_capabilities into their corresponding pizlonated_gptrs
    atomically. */
 void filc_global_initialization_context_destroy(filc_global_initialization_context* context);
+/* Arranges for the lazy ctors to run when the context is destroyed, unless they already have been
+   queued by some earlier context. */
+void filc_global_initialization_context_add_lazy_ctors(
+    filc_global_initialization_context* context, filc_lazy_global_ctors* lazy_ctors);
 
 void filc_execute_constant_relocations(
     filc_object* constant, filc_constant_relocation* relocations, size_t num_relocations,
     filc_global_initialization_context* context);
 
+/* Called by a module's global getter when it initializes its global, so that all of the module's
+   globals get initialized under the same context. This means that we lock, allocate the context,
+   and commit the gptrs once per module instead of once per global. Does nothing unless this is the
+   outermost initialization. */
+void filc_initialize_module_globals(filc_global_initialization_context* context,
+                                    pizlonated_linker_stub* getters, size_t num_getters);
+
 void filc_defer_or_run_global_ctor(pizlonated_function global_ctor);
 void filc_run_deferred_global_ctors(filc_thread* my_thread); /* Important safety property: libc must
                                                                 call this before letting the user
@@ -3066,6 +3581,8 @@ PAS_API char** filc_check_and_get_null_terminated_string_array(
     filc_thread* my_thread, filc_ptr user_array_ptr);
 
 PAS_API void filc_thread_destroy_space_with_guard_page(filc_thread* my_thread);
+/* Called on behalf of a thread that is exited and idle. */
+PAS_API void filc_thread_reclaim_idle_space_with_guard_page(filc_thread* thread);
 PAS_API char* filc_thread_get_end_of_space_with_guard_page_with_size(filc_thread* my_thread,
                                                                      size_t desired_size);
 
@@ -3132,6 +3649,22 @@ PAS_API void filc_call_syscall_with_guarded_ptr(filc_thread* my_thread,
         syscall_result; \
     })
 
+/* Like FILC_SYSCALL, but stays entered across the call. Only use this for syscalls that can never
+   block and that finish in nanoseconds, like the vDSO-backed clock reads and the getpid family. The
+   GC's soft handshakes and stop-the-world wait on entered threads to pollcheck, so a thread that
+   blocks while entered stalls the collector. In exchange, there is no state CAS on either side of
+   the call, and the syscall_call expression may use filc APIs that require being entered. */
+#define FILC_FAST_SYSCALL(my_thread, syscall_call) ({ \
+        filc_thread* syscall_thread = (my_thread); \
+        PAS_TESTING_ASSERT(syscall_thread->state & FILC_THREAD_STATE_ENTERED); \
+        errno = 0; \
+        typeof(syscall_call) syscall_result = syscall_call; \
+        int syscall_errno = errno; \
+        if (syscall_errno) \
+            filc_set_errno(syscall_errno); \
+        syscall_result; \
+    })
+
 PAS_API bool filc_get_bool_env(const char* name, bool default_value);
 PAS_API unsigned filc_get_unsigned_env(const char* name, unsigned default_value);
 PAS_API size_t filc_get_size_env(const char* name, size_t default_value);
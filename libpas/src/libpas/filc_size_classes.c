@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_size_classes.h"
+
+#include "pas_heap.h"
+#include "pas_heap_lock.h"
+#include "pas_segregated_size_directory.h"
+#include "verse_heap_config.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+#define NUM_SIZES FILC_THREAD_NUM_ALLOCATORS
+
+unsigned filc_size_class_table[NUM_SIZES] = {
+    16, 16, 32, 48, 64, 80, 96, 128, 128, 160, 160, 192, 192, 224, 224, 256, 256, 304, 304, 304,
+    352, 352, 352, 416, 416, 416, 416
+};
+
+#define MAX_HOT_SIZES 32
+
+/* Payload sizes, not counting the filc_object header. Programs love to allocate buffers in powers
+   of two, and the rest are the size classes that the verse_heap picks just past the inline ones. */
+static const size_t default_hot_sizes[] = { 512, 1024, 4096, 2048, 768, 640, 1536, 8192 };
+
+static const char* profile_path;
+static bool did_tune;
+static const char* hot_sizes_string;
+static unsigned num_hot_slots;
+static unsigned num_size_classes;
+static double default_waste_fraction;
+static double tuned_waste_fraction;
+
+static size_t size_for_index(size_t index)
+{
+    return pas_max_uintptr(index, 1) << VERSE_HEAP_MIN_ALIGN_SHIFT;
+}
+
+static bool parse_histogram(const char* string, uint64_t* counts)
+{
+    pas_zero_memory(counts, sizeof(uint64_t) * NUM_SIZES);
+    for (;;) {
+        while (*string == ' ' || *string == '\t')
+            string++;
+        if (!*string || *string == '\n')
+            return true;
+        char* end;
+        unsigned long long size = strtoull(string, &end, 10);
+        if (end == string || *end != '=')
+            return false;
+        string = end + 1;
+        unsigned long long count = strtoull(string, &end, 10);
+        if (end == string)
+            return false;
+        string = end;
+        if (!size || size > FILC_THREAD_MAX_INLINE_SIZE_CLASS
+            || !pas_is_aligned(size, VERSE_HEAP_MIN_ALIGN))
+            return false;
+        counts[size >> VERSE_HEAP_MIN_ALIGN_SHIFT] += count;
+    }
+}
+
+static void handle_line(const char* line, uint64_t* counts, bool* found)
+{
+    static const char prefix[] = "size histogram:";
+    const char* histogram = strstr(line, prefix);
+    if (!histogram)
+        return;
+    uint64_t line_counts[NUM_SIZES];
+    if (!parse_histogram(histogram + sizeof(prefix) - 1, line_counts)) {
+        pas_log("filc size classes: ignoring malformed size histogram in %s\n", profile_path);
+        return;
+    }
+    memcpy(counts, line_counts, sizeof(line_counts));
+    *found = true;
+}
+
+/* Heap profiles can be big, so we read them a line at a time and remember the last histogram. */
+static bool read_last_histogram(uint64_t* counts)
+{
+    int fd = open(profile_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        pas_log("filc size classes: failed to open %s: %s\n", profile_path, strerror(errno));
+        return false;
+    }
+    char buf[4096];
+    size_t length = 0;
+    bool skipping_long_line = false;
+    bool found = false;
+    for (;;) {
+        ssize_t result = read(fd, buf + length, sizeof(buf) - 1 - length);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            pas_log("filc size classes: failed to read %s: %s\n", profile_path, strerror(errno));
+            close(fd);
+            return false;
+        }
+        if (!result)
+            break;
+        length += (size_t)result;
+        buf[length] = 0;
+        char* line = buf;
+        char* newline;
+        while ((newline = strchr(line, '\n'))) {
+            *newline = 0;
+            if (!skipping_long_line)
+                handle_line(line, counts, &found);
+            skipping_long_line = false;
+            line = newline + 1;
+        }
+        length -= (size_t)(line - buf);
+        memmove(buf, line, length);
+        if (length == sizeof(buf) - 1) {
+            /* None of the lines we care about are this long. */
+            skipping_long_line = true;
+            length = 0;
+        }
+    }
+    close(fd);
+    if (length && !skipping_long_line) {
+        buf[length] = 0;
+        handle_line(buf, counts, &found);
+    }
+    if (!found)
+        pas_log("filc size classes: no size histogram in %s\n", profile_path);
+    return found;
+}
+
+static double waste_fraction(const unsigned* table, const uint64_t* counts)
+{
+    double wasted = 0;
+    double total = 0;
+    size_t index;
+    for (index = 1; index < NUM_SIZES; ++index) {
+        wasted += (double)counts[index] * (double)(table[index] - size_for_index(index));
+        total += (double)counts[index] * (double)table[index];
+    }
+    return total ? wasted / total : 0;
+}
+
+/* Picks num_size_classes size classes, the last of which is FILC_THREAD_MAX_INLINE_SIZE_CLASS, to
+   minimize the bytes wasted by rounding each size up to its class. The cost of giving index i its
+   own class, with the previous class at index j, is what the sizes in (j, i] waste by rounding up
+   to size i. That makes this a textbook dynamic program over (number of classes, index of the last
+   class). No size gets rounded up by more than half, so that a sampled profile can't starve the
+   sizes it happened to miss. */
+static void compute_table(const uint64_t* raw_counts, unsigned* table)
+{
+    static double best[NUM_SIZES + 1][NUM_SIZES];
+    static size_t previous[NUM_SIZES + 1][NUM_SIZES];
+    double counts[NUM_SIZES];
+    uint64_t total = 0;
+    size_t index;
+    for (index = 1; index < NUM_SIZES; ++index)
+        total += raw_counts[index];
+
+    /* The profile is sampled, so sizes that it never saw may still happen. Spreading 1% of the mass
+       over every size keeps the table from ignoring them entirely. */
+    counts[0] = 0;
+    for (index = 1; index < NUM_SIZES; ++index)
+        counts[index] = (double)raw_counts[index] + (double)total / (100. * (NUM_SIZES - 1)) + 1.;
+
+    size_t num_classes;
+    for (num_classes = 0; num_classes <= num_size_classes; ++num_classes) {
+        for (index = 0; index < NUM_SIZES; ++index)
+            best[num_classes][index] = PAS_INFINITY;
+    }
+    best[0][0] = 0;
+    for (num_classes = 1; num_classes <= num_size_classes; ++num_classes) {
+        for (index = 1; index < NUM_SIZES; ++index) {
+            double cost = 0;
+            size_t previous_index;
+            for (previous_index = index; previous_index--;) {
+                if (2 * size_for_index(index) > 3 * size_for_index(previous_index + 1))
+                    break;
+                cost += counts[previous_index + 1]
+                    * (double)(size_for_index(index) - size_for_index(previous_index + 1));
+                double candidate = best[num_classes - 1][previous_index] + cost;
+                if (candidate < best[num_classes][index]) {
+                    best[num_classes][index] = candidate;
+                    previous[num_classes][index] = previous_index;
+                }
+            }
+        }
+    }
+    PAS_ASSERT(best[num_size_classes][NUM_SIZES - 1] < PAS_INFINITY);
+
+    size_t class_index = NUM_SIZES - 1;
+    for (num_classes = num_size_classes; num_classes; --num_classes) {
+        size_t previous_index = previous[num_classes][class_index];
+        for (index = class_index; index > previous_index; --index)
+            table[index] = (unsigned)size_for_index(class_index);
+        class_index = previous_index;
+    }
+    PAS_ASSERT(!class_index);
+    table[0] = table[1];
+}
+
+void filc_size_classes_initialize(void)
+{
+    size_t index;
+    num_size_classes = 1;
+    for (index = 1; index < NUM_SIZES; ++index) {
+        if (filc_size_class_table[index] != filc_size_class_table[index - 1])
+            num_size_classes++;
+    }
+
+    profile_path = getenv("FILC_SIZE_CLASS_PROFILE");
+    if (!profile_path || !*profile_path) {
+        profile_path = NULL;
+        return;
+    }
+
+    uint64_t counts[NUM_SIZES];
+    if (!read_last_histogram(counts))
+        return;
+
+    unsigned table[NUM_SIZES];
+    compute_table(counts, table);
+    default_waste_fraction = waste_fraction(filc_size_class_table, counts);
+    tuned_waste_fraction = waste_fraction(table, counts);
+    for (index = 0; index < NUM_SIZES; ++index) {
+        PAS_ASSERT(table[index] >= size_for_index(index));
+        PAS_ASSERT(pas_is_aligned(table[index], VERSE_HEAP_MIN_ALIGN));
+    }
+    PAS_ASSERT(table[NUM_SIZES - 1] == FILC_THREAD_MAX_INLINE_SIZE_CLASS);
+    memcpy(filc_size_class_table, table, sizeof(table));
+    did_tune = true;
+}
+
+static size_t parse_hot_sizes(const char* string, size_t* sizes)
+{
+    size_t num_sizes = 0;
+    while (*string) {
+        char* end;
+        unsigned long long size = strtoull(string, &end, 10);
+        if (end == string || (*end && *end != ',') || !size || num_sizes == MAX_HOT_SIZES) {
+            pas_log("filc size classes: ignoring malformed FILC_HOT_SIZE_CLASSES=%s\n",
+                    hot_sizes_string);
+            return 0;
+        }
+        sizes[num_sizes++] = (size_t)size;
+        string = *end ? end + 1 : end;
+    }
+    return num_sizes;
+}
+
+void filc_size_classes_reserve_hot_slots(void)
+{
+    size_t sizes[MAX_HOT_SIZES];
+    size_t num_sizes;
+    size_t index;
+
+    hot_sizes_string = getenv("FILC_HOT_SIZE_CLASSES");
+    if (hot_sizes_string)
+        num_sizes = parse_hot_sizes(hot_sizes_string, sizes);
+    else {
+        num_sizes = sizeof(default_hot_sizes) / sizeof(default_hot_sizes[0]);
+        memcpy(sizes, default_hot_sizes, sizeof(default_hot_sizes));
+    }
+
+    pas_heap_lock_lock();
+    for (index = 0; index < num_sizes; ++index) {
+        size_t total_size;
+        if (pas_add_uintptr_overflow(sizes[index], sizeof(filc_object), &total_size)
+            || total_size <= FILC_THREAD_MAX_INLINE_SIZE_CLASS)
+            continue;
+        pas_segregated_size_directory* directory;
+        directory = pas_segregated_heap_ensure_size_directory_for_size(
+            &filc_default_heap->segregated_heap, total_size, 1, pas_force_size_lookup,
+            &verse_heap_config, NULL, pas_segregated_size_directory_full_creation_mode);
+        /* Too big for segregated pages, so it doesn't get a local allocator anyway. */
+        if (!directory)
+            continue;
+        /* Several hot sizes may share a size class, in which case the allocator already exists. And
+           if the runtime config wants allocators created lazily, this makes sure it happens now. */
+        if (directory->allocator_index)
+            continue;
+        pas_segregated_size_directory_create_tlc_allocator(directory);
+        num_hot_slots++;
+    }
+    pas_heap_lock_unlock();
+}
+
+void filc_size_classes_dump_setup(void)
+{
+    pas_log("    hot size classes: %s, %u reserved\n",
+            hot_sizes_string ? hot_sizes_string : "default", num_hot_slots);
+    if (!did_tune) {
+        pas_log("    size classes: default%s%s\n",
+                profile_path ? ", could not use " : "", profile_path ? profile_path : "");
+        return;
+    }
+    pas_log("    size classes: tuned from %s, %u classes, internal fragmentation %.1lf%% "
+            "(default would be %.1lf%%):",
+            profile_path, num_size_classes, tuned_waste_fraction * 100.,
+            default_waste_fraction * 100.);
+    size_t index;
+    for (index = 1; index < NUM_SIZES; ++index) {
+        if (filc_size_class_table[index] != filc_size_class_table[index - 1] || index == 1)
+            pas_log(" %u", filc_size_class_table[index]);
+    }
+    pas_log("\n");
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
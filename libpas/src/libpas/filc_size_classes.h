@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef FILC_SIZE_CLASSES_H
+#define FILC_SIZE_CLASSES_H
+
+#include "filc_runtime.h"
+
+/* This is the table that maps each filc_thread allocator index to the size class that its local
+   allocator uses. Index i is for allocations of up to i * VERSE_HEAP_MIN_ALIGN bytes, including the
+   filc_object header.
+   
+   By default, the table is a fixed progression that tries to waste no more than around 15% of any
+   object. Setting FILC_SIZE_CLASS_PROFILE to the path of a heap profile (see filc_heap_profiler.h)
+   replaces it with a table that uses the same number of size classes but places them to minimize
+   the internal fragmentation that the profile's size histogram would have had. The last size
+   histogram in the file wins. If the file can't be read or has no histogram, we keep the default.
+   
+   Only the inline size classes are tuned. Bigger allocations go through the verse_heap's own size
+   class selection. */
+
+PAS_API extern unsigned filc_size_class_table[FILC_THREAD_NUM_ALLOCATORS];
+
+/* Must be called before the first filc_thread is created. */
+PAS_API void filc_size_classes_initialize(void);
+
+/* Bigger allocations use the local allocators in the thread local cache, which get their slots in
+   the order that size directories are created. Left alone, that order is whatever order the
+   program first happens to allocate each size in, so the hot ones end up scattered over the
+   whole cache.
+   
+   This creates the default heap's directories for the hot non-inline sizes up front, so that their
+   allocators get the first slots and sit together on a few cache lines. The sizes come from a
+   static table of common buffer sizes, or from FILC_HOT_SIZE_CLASSES, which is a comma separated
+   list of payload sizes, hottest first. Setting it to the empty string turns this off.
+   
+   Must be called after the heaps are ready for allocation, and before anything else allocates out
+   of them. */
+PAS_API void filc_size_classes_reserve_hot_slots(void);
+
+PAS_API void filc_size_classes_dump_setup(void);
+
+#endif /* FILC_SIZE_CLASSES_H */
+
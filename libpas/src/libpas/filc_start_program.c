@@ -25,6 +25,8 @@
 
 #include "filc_native.h"
 #include "filc_runtime.h"
+#include "filc_startup_profiler.h"
+#include "filc_zygote.h"
 #include <elf.h>
 #include <pthread.h>
 #include <stdalign.h>
@@ -44,10 +46,13 @@ static void really_start_program(
     filc_ptr pizlonated_argv;
     int index;
     filc_ptr main_ptr;
+    filc_ptr __libc_start_main_ptr;
 
     PAS_ASSERT(argc >= 1);
 
+    double initialize_start_time = filc_startup_phase_begin();
     filc_initialize();
+    filc_startup_phase_end(filc_startup_phase_filc_initialize, initialize_start_time, NULL);
     filc_thread* my_thread = filc_get_my_thread();
     filc_enter(my_thread);
 
@@ -57,6 +62,27 @@ static void really_start_program(
     filc_native_frame native_frame;
     filc_push_native_frame(my_thread, &native_frame);
 
+    main_ptr = pizlonated_main(NULL);
+    if (verbose)
+        pas_log("main_ptr.ptr = %p, main_ptr.lower = %p\n", main_ptr.ptr, main_ptr.lower);
+    filc_thread_track_object(my_thread, filc_ptr_object(main_ptr));
+
+    if (pizlonated___libc_start_main) {
+        __libc_start_main_ptr = pizlonated___libc_start_main(NULL);
+        if (verbose) {
+            pas_log("__libc_start_main object = %p\n", filc_ptr_object(__libc_start_main_ptr));
+            pas_log("__libc_start_main object->lower = %p\n",
+                    filc_ptr_lower(__libc_start_main_ptr));
+            pas_log("__libc_start_main object->upper = %p\n",
+                    filc_ptr_upper(__libc_start_main_ptr));
+            pas_log("__libc_start_main ptr = %p\n", filc_ptr_ptr(__libc_start_main_ptr));
+        }
+        filc_thread_track_object(my_thread, filc_ptr_object(__libc_start_main_ptr));
+    }
+
+    /* Everything up to here is what zygote children get to skip. */
+    filc_zygote_serve_if_requested(my_thread, &argc, &argv);
+
     pizlonated_argv = filc_ptr_create_with_object(
         my_thread, filc_allocate(my_thread, filc_mul_size(sizeof(void*), (argc + 1))));
 
@@ -69,15 +95,9 @@ static void really_start_program(
         filc_store_ptr(my_thread, pizlonated_argv, filc_mul_size(index, sizeof(void*)), arg);
     }
 
-    main_ptr = pizlonated_main(NULL);
-    if (verbose)
-        pas_log("main_ptr.ptr = %p, main_ptr.lower = %p\n", main_ptr.ptr, main_ptr.lower);
-    filc_thread_track_object(my_thread, filc_ptr_object(main_ptr));
-
     if (pizlonated___libc_start_main) {
         int environ_size;
         filc_ptr environ_ptr;
-        filc_ptr __libc_start_main_ptr;
         
         for (environ_size = 0; environ[environ_size]; ++environ_size);
         environ_size++;
@@ -122,16 +142,6 @@ static void really_start_program(
         }
         PAS_ASSERT(!auxv[num_entries - 1]);
 
-        __libc_start_main_ptr = pizlonated___libc_start_main(NULL);
-        if (verbose) {
-            pas_log("__libc_start_main object = %p\n", filc_ptr_object(__libc_start_main_ptr));
-            pas_log("__libc_start_main object->lower = %p\n",
-                    filc_ptr_lower(__libc_start_main_ptr));
-            pas_log("__libc_start_main object->upper = %p\n",
-                    filc_ptr_upper(__libc_start_main_ptr));
-            pas_log("__libc_start_main ptr = %p\n", filc_ptr_ptr(__libc_start_main_ptr));
-        }
-        filc_thread_track_object(my_thread, filc_ptr_object(__libc_start_main_ptr));
         filc_check_function_call(__libc_start_main_ptr);
         filc_call_user_libc_start_main(
             my_thread, (pizlonated_function)filc_ptr_ptr(__libc_start_main_ptr),
@@ -186,7 +196,11 @@ void filc_start_program(int argc, char** argv,
 {
     PAS_ASSERT(!pthread_getstack_yolo(pthread_self()));
     PAS_ASSERT(!pthread_getstacksize_yolo(pthread_self()));
+
+    filc_zygote_connect_if_requested(argc, argv);
     
+    filc_startup_profiler_begin();
+
     struct args* args = (struct args*)bmalloc_allocate(sizeof(struct args));
     args->argc = argc;
     args->argv = argv;
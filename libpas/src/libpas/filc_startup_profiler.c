@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_startup_profiler.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+#define NUM_TOP_ENTRIES 10
+
+typedef struct {
+    double milliseconds;
+    const void* subject;
+} top_entry;
+
+typedef struct {
+    size_t count;
+    double milliseconds;
+    size_t num_top_entries;
+    top_entry top_entries[NUM_TOP_ENTRIES];
+} phase_profile;
+
+bool filc_startup_profiler_is_enabled = false;
+
+/* Global ctors are allowed to start threads, so recording has to be locked. */
+static pas_lock profile_lock = PAS_LOCK_INITIALIZER;
+static double begin_time;
+static double milliseconds_before_begin = -1.;
+static phase_profile phase_profiles[FILC_NUM_STARTUP_PHASES];
+
+static const char* phase_string(filc_startup_phase phase)
+{
+    switch (phase) {
+    case filc_startup_phase_filc_initialize:
+        return "filc_initialize";
+    case filc_startup_phase_fugc_initialize:
+        return "fugc_initialize";
+    case filc_startup_phase_global_initialization:
+        return "global initializations";
+    case filc_startup_phase_constant_relocations:
+        return "constant relocations";
+    case filc_startup_phase_global_ctor:
+        return "global ctors";
+    }
+    PAS_ASSERT(!"Bad startup phase");
+    return NULL;
+}
+
+/* Returns how long ago the kernel thinks that this process started, or -1 if we can't tell. The
+   start time is in clock ticks since boot, so this is exec plus dynamic linking plus whatever
+   libpizlo's own constructors did, give or take a tick. */
+static double get_milliseconds_since_process_start(void)
+{
+    char buf[1024];
+    int fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1.;
+    ssize_t result = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (result <= 0)
+        return -1.;
+    buf[result] = 0;
+
+    /* The command name can have spaces and parens in it, so skip past the last paren. What follows
+       is field 3 (the state), and the start time is field 22. */
+    char* ptr = strrchr(buf, ')');
+    if (!ptr)
+        return -1.;
+    unsigned field;
+    for (field = 2; field < 22; ++field) {
+        ptr = strchr(ptr + 1, ' ');
+        if (!ptr)
+            return -1.;
+    }
+    unsigned long long start_ticks = strtoull(ptr + 1, NULL, 10);
+    long ticks_per_second = sysconf(_SC_CLK_TCK);
+    if (ticks_per_second <= 0)
+        return -1.;
+
+    struct timespec now;
+    if (clock_gettime(CLOCK_BOOTTIME, &now))
+        return -1.;
+    double now_milliseconds = (double)now.tv_sec * 1000. + (double)now.tv_nsec / 1000000.;
+    double start_milliseconds = (double)start_ticks * 1000. / (double)ticks_per_second;
+    if (now_milliseconds < start_milliseconds)
+        return 0.;
+    return now_milliseconds - start_milliseconds;
+}
+
+void filc_startup_profiler_begin(void)
+{
+    /* This runs before filc_initialize(), but the env helpers don't need the runtime. */
+    filc_startup_profiler_is_enabled = filc_get_bool_env("FILC_PROFILE_STARTUP", false);
+    if (!filc_startup_profiler_is_enabled)
+        return;
+    milliseconds_before_begin = get_milliseconds_since_process_start();
+    begin_time = pas_get_time_in_milliseconds();
+}
+
+void filc_startup_phase_end_slow(filc_startup_phase phase, double start_time, const void* subject)
+{
+    double milliseconds = pas_get_time_in_milliseconds() - start_time;
+    PAS_ASSERT((unsigned)phase < FILC_NUM_STARTUP_PHASES);
+
+    pas_lock_lock(&profile_lock);
+    if (!filc_startup_profiler_is_enabled) {
+        pas_lock_unlock(&profile_lock);
+        return;
+    }
+    phase_profile* profile = phase_profiles + phase;
+    profile->count++;
+    profile->milliseconds += milliseconds;
+    if (subject) {
+        /* Keep the top entries sorted slowest first with an insertion sort, since there are only a
+           handful of them. */
+        size_t index = profile->num_top_entries;
+        if (index == NUM_TOP_ENTRIES) {
+            if (milliseconds <= profile->top_entries[NUM_TOP_ENTRIES - 1].milliseconds) {
+                pas_lock_unlock(&profile_lock);
+                return;
+            }
+            index--;
+        } else
+            profile->num_top_entries++;
+        for (; index && profile->top_entries[index - 1].milliseconds < milliseconds; index--)
+            profile->top_entries[index] = profile->top_entries[index - 1];
+        profile->top_entries[index].milliseconds = milliseconds;
+        profile->top_entries[index].subject = subject;
+    }
+    pas_lock_unlock(&profile_lock);
+}
+
+/* Most ctors and gptrs aren't exported, so usually all we can say is which library they're in and
+   where. That's enough for addr2line. */
+static void dump_subject(const void* subject)
+{
+    Dl_info info;
+    if (!dladdr(subject, &info) || !info.dli_fname) {
+        pas_log("%p", subject);
+        return;
+    }
+    pas_log("%s+0x%lx", info.dli_fname,
+            (unsigned long)((uintptr_t)subject - (uintptr_t)info.dli_fbase));
+    if (info.dli_sname && info.dli_saddr == subject)
+        pas_log(" (%s)", info.dli_sname);
+}
+
+void filc_startup_profiler_did_reach_main(void)
+{
+    if (!filc_startup_profiler_is_enabled)
+        return;
+
+    pas_lock_lock(&profile_lock);
+    filc_startup_profiler_is_enabled = false;
+    pas_lock_unlock(&profile_lock);
+
+    double total_milliseconds = pas_get_time_in_milliseconds() - begin_time;
+
+    pas_log("filc startup profile:\n");
+    if (milliseconds_before_begin >= 0.) {
+        pas_log("    before filc_start_program (exec and dynamic linking): about %.3lf ms\n",
+                milliseconds_before_begin);
+    }
+    pas_log("    from filc_start_program to main: %.3lf ms\n", total_milliseconds);
+    unsigned phase;
+    for (phase = 0; phase < FILC_NUM_STARTUP_PHASES; ++phase) {
+        phase_profile* profile = phase_profiles + phase;
+        pas_log("    %s: %zu, %.3lf ms\n",
+                phase_string((filc_startup_phase)phase), profile->count, profile->milliseconds);
+        size_t index;
+        for (index = 0; index < profile->num_top_entries; ++index) {
+            pas_log("        %.3lf ms: ", profile->top_entries[index].milliseconds);
+            dump_subject(profile->top_entries[index].subject);
+            pas_log("\n");
+        }
+    }
+}
+
+void filc_startup_profiler_dump_setup(void)
+{
+    pas_log("    profile startup: %s\n", filc_startup_profiler_is_enabled ? "yes" : "no");
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef FILC_STARTUP_PROFILER_H
+#define FILC_STARTUP_PROFILER_H
+
+#include "filc_runtime.h"
+
+/* With FILC_PROFILE_STARTUP=1, we time the phases of startup from when filc_start_program() gets
+   control until main() is about to be called, and then log how long each one took, how many times
+   it ran, and which global initializations and global ctors were slowest. Time spent before we get
+   control (exec and dynamic linking) is estimated from the process start time, so it's only as
+   precise as the kernel's clock ticks.
+
+   Global initializations nest inside global ctors and constant relocations nest inside global
+   initializations, so their times overlap. Only the outermost global initialization is timed. */
+
+enum filc_startup_phase {
+    filc_startup_phase_filc_initialize,
+    filc_startup_phase_fugc_initialize,
+    filc_startup_phase_global_initialization,
+    filc_startup_phase_constant_relocations,
+    filc_startup_phase_global_ctor
+};
+
+typedef enum filc_startup_phase filc_startup_phase;
+
+#define FILC_NUM_STARTUP_PHASES 5
+
+PAS_API extern bool filc_startup_profiler_is_enabled;
+
+/* Called by filc_start_program() before anything else happens. */
+PAS_API void filc_startup_profiler_begin(void);
+
+/* Called right before the program's main() runs. Logs the profile and stops recording. */
+PAS_API void filc_startup_profiler_did_reach_main(void);
+
+static inline double filc_startup_phase_begin(void)
+{
+    if (!filc_startup_profiler_is_enabled)
+        return 0.;
+    return pas_get_time_in_milliseconds();
+}
+
+/* The subject is the address that the top-N list reports for this phase: the first global's
+   pizlonated_gptr for global initializations, and the ctor for global ctors. It's ignored for the
+   other phases. */
+PAS_API void filc_startup_phase_end_slow(
+    filc_startup_phase phase, double start_time, const void* subject);
+
+static inline void filc_startup_phase_end(
+    filc_startup_phase phase, double start_time, const void* subject)
+{
+    if (!filc_startup_profiler_is_enabled)
+        return;
+    filc_startup_phase_end_slow(phase, start_time, subject);
+}
+
+PAS_API void filc_startup_profiler_dump_setup(void);
+
+#endif /* FILC_STARTUP_PROFILER_H */
@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_zygote.h"
+
+#include "bmalloc_heap.h"
+#include "filc_native.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if PAS_ENABLE_FILC
+
+extern char** environ;
+
+#define ZYGOTE_MAGIC 0x65746f67797a6366llu /* "fczygote" */
+#define ZYGOTE_NUM_FDS 4 /* stdin, stdout, stderr, and the cwd. */
+#define ZYGOTE_MAX_STRINGS 65536
+#define ZYGOTE_MAX_STRINGS_SIZE ((size_t)16 << 20)
+
+/* The request is followed by argc + envc NUL-terminated strings, argv first, and comes with the fds
+   in an SCM_RIGHTS message. The zygote replies with the child's pid, or -1 if it won't run the
+   program, and then with the child's wait status once the child is done. */
+typedef struct {
+    uint64_t magic;
+    uint64_t exe_dev;
+    uint64_t exe_ino;
+    uint32_t argc;
+    uint32_t envc;
+    uint64_t strings_size;
+} zygote_request;
+
+typedef struct {
+    pid_t pid;
+    int connection_fd;
+} zygote_child;
+
+static bool read_fully(int fd, void* buf, size_t size)
+{
+    while (size) {
+        ssize_t result = read(fd, buf, size);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        buf = (char*)buf + result;
+        size -= result;
+    }
+    return true;
+}
+
+/* Only ever writes to sockets, and getting SIGPIPE for a peer that went away would kill the
+   zygote. */
+static bool write_fully(int fd, const void* buf, size_t size)
+{
+    while (size) {
+        ssize_t result = send(fd, buf, size, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        buf = (const char*)buf + result;
+        size -= result;
+    }
+    return true;
+}
+
+static bool get_exe_identity(uint64_t* dev, uint64_t* ino)
+{
+    struct stat exe_stat;
+    if (stat("/proc/self/exe", &exe_stat))
+        return false;
+    *dev = exe_stat.st_dev;
+    *ino = exe_stat.st_ino;
+    return true;
+}
+
+static bool fill_address(struct sockaddr_un* address, const char* path)
+{
+    size_t length = strlen(path);
+    if (length >= sizeof(address->sun_path))
+        return false;
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    memcpy(address->sun_path, path, length + 1);
+    return true;
+}
+
+static volatile sig_atomic_t client_child_pid;
+
+static void forward_signal(int signum)
+{
+    int saved_errno = errno;
+    kill(client_child_pid, signum);
+    errno = saved_errno;
+}
+
+static bool send_request(int fd, int argc, char** argv)
+{
+    zygote_request request;
+    if (!get_exe_identity(&request.exe_dev, &request.exe_ino))
+        return false;
+    request.magic = ZYGOTE_MAGIC;
+    request.argc = argc;
+    for (request.envc = 0; environ[request.envc]; ++request.envc);
+    if ((size_t)request.argc + request.envc > ZYGOTE_MAX_STRINGS)
+        return false;
+
+    size_t index;
+    request.strings_size = 0;
+    for (index = 0; index < (size_t)request.argc + request.envc; ++index) {
+        const char* string = index < request.argc ? argv[index] : environ[index - request.argc];
+        request.strings_size += strlen(string) + 1;
+    }
+    if (request.strings_size > ZYGOTE_MAX_STRINGS_SIZE)
+        return false;
+
+    int cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cwd_fd < 0)
+        return false;
+
+    int fds[ZYGOTE_NUM_FDS] = { 0, 1, 2, cwd_fd };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = { .iov_base = &request, .iov_len = sizeof(request) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    ssize_t result;
+    do
+        result = sendmsg(fd, &message, MSG_NOSIGNAL);
+    while (result < 0 && errno == EINTR);
+    close(cwd_fd);
+    if (result < 0)
+        return false;
+    if ((size_t)result < sizeof(request)
+        && !write_fully(fd, (char*)&request + result, sizeof(request) - result))
+        return false;
+
+    char* strings = (char*)bmalloc_allocate(request.strings_size);
+    char* ptr = strings;
+    for (index = 0; index < (size_t)request.argc + request.envc; ++index) {
+        const char* string = index < request.argc ? argv[index] : environ[index - request.argc];
+        size_t size = strlen(string) + 1;
+        memcpy(ptr, string, size);
+        ptr += size;
+    }
+    bool sent = write_fully(fd, strings, request.strings_size);
+    bmalloc_deallocate(strings);
+    return sent;
+}
+
+void filc_zygote_connect_if_requested(int argc, char** argv)
+{
+    const char* path = getenv("FILC_ZYGOTE_CONNECT");
+    if (!path || getenv("FILC_ZYGOTE"))
+        return;
+
+    struct sockaddr_un address;
+    if (!fill_address(&address, path))
+        return;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return;
+    int32_t pid;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address))
+        || !send_request(fd, argc, argv)
+        || !read_fully(fd, &pid, sizeof(pid))
+        || pid <= 0) {
+        close(fd);
+        return;
+    }
+
+    client_child_pid = pid;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = forward_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    PAS_ASSERT(!sigaction(SIGINT, &action, NULL));
+    PAS_ASSERT(!sigaction(SIGTERM, &action, NULL));
+    PAS_ASSERT(!sigaction(SIGHUP, &action, NULL));
+    PAS_ASSERT(!sigaction(SIGQUIT, &action, NULL));
+
+    int32_t status;
+    if (!read_fully(fd, &status, sizeof(status))) {
+        pas_log("filc: zygote at %s went away while running pid %d\n", path, (int)pid);
+        _exit(127);
+    }
+    if (WIFSIGNALED(status)) {
+        int signum = WTERMSIG(status);
+        sigset_t set;
+        signal(signum, SIG_DFL);
+        sigemptyset(&set);
+        sigaddset(&set, signum);
+        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+        raise(signum);
+        _exit(128 + signum);
+    }
+    _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 127);
+}
+
+static int child_exit_pipe[2];
+
+static void handle_sigchld(int signum)
+{
+    PAS_UNUSED_PARAM(signum);
+    int saved_errno = errno;
+    char byte = 0;
+    ssize_t result = write(child_exit_pipe[1], &byte, 1);
+    PAS_UNUSED_PARAM(result); /* If the pipe is full, then the zygote already knows to reap. */
+    errno = saved_errno;
+}
+
+static void close_received_fds(int* fds, size_t num_fds)
+{
+    size_t index;
+    for (index = 0; index < num_fds; ++index)
+        close(fds[index]);
+}
+
+/* Returns the connection's fds, argv, and envp, or false if the request is bad. */
+static bool receive_request(int connection_fd, uint64_t exe_dev, uint64_t exe_ino,
+                            int* fds, int* argc, char*** argv, char*** envp)
+{
+    struct ucred credentials;
+    socklen_t credentials_size = sizeof(credentials);
+    if (getsockopt(connection_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_size)
+        || credentials.uid != geteuid())
+        return false;
+
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    PAS_ASSERT(!setsockopt(connection_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+
+    zygote_request request;
+    char control[CMSG_SPACE(sizeof(int) * ZYGOTE_NUM_FDS)];
+    struct iovec iov = { .iov_base = &request, .iov_len = sizeof(request) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t result;
+    do
+        result = recvmsg(connection_fd, &message, MSG_CMSG_CLOEXEC);
+    while (result < 0 && errno == EINTR);
+    if (result <= 0)
+        return false;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        return false;
+    size_t num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    num_fds = pas_min_uintptr(num_fds, ZYGOTE_NUM_FDS);
+    memcpy(fds, CMSG_DATA(cmsg), num_fds * sizeof(int));
+    if (num_fds != ZYGOTE_NUM_FDS || (message.msg_flags & MSG_CTRUNC)) {
+        close_received_fds(fds, num_fds);
+        return false;
+    }
+
+    if ((size_t)result < sizeof(request)
+        && !read_fully(connection_fd, (char*)&request + result, sizeof(request) - result))
+        goto fail;
+    if (request.magic != ZYGOTE_MAGIC || request.exe_dev != exe_dev || request.exe_ino != exe_ino
+        || !request.argc || (size_t)request.argc + request.envc > ZYGOTE_MAX_STRINGS
+        || !request.strings_size || request.strings_size > ZYGOTE_MAX_STRINGS_SIZE)
+        goto fail;
+
+    /* The child keeps these for the rest of its life. The zygote frees its copies once it has
+       forked. argv[0] is the start of the strings. */
+    char* strings = (char*)bmalloc_allocate(request.strings_size);
+    char** pointers = (char**)bmalloc_allocate(
+        sizeof(char*) * ((size_t)request.argc + 1 + request.envc + 1));
+    if (!read_fully(connection_fd, strings, request.strings_size)
+        || strings[request.strings_size - 1])
+        goto fail_with_strings;
+
+    size_t index;
+    char* ptr = strings;
+    char* end = strings + request.strings_size;
+    for (index = 0; index < (size_t)request.argc + request.envc; ++index) {
+        if (ptr == end)
+            goto fail_with_strings;
+        size_t pointer_index = index < request.argc ? index : index + 1;
+        pointers[pointer_index] = ptr;
+        ptr += strlen(ptr) + 1;
+    }
+    if (ptr != end)
+        goto fail_with_strings;
+    pointers[request.argc] = NULL;
+    pointers[request.argc + 1 + request.envc] = NULL;
+
+    *argc = request.argc;
+    *argv = pointers;
+    *envp = pointers + request.argc + 1;
+    return true;
+
+fail_with_strings:
+    bmalloc_deallocate(strings);
+    bmalloc_deallocate(pointers);
+fail:
+    close_received_fds(fds, ZYGOTE_NUM_FDS);
+    return false;
+}
+
+static void become_child(int* fds, int listen_fd, zygote_child* children, size_t num_children,
+                         int connection_fd)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    PAS_ASSERT(!sigaction(SIGCHLD, &action, NULL));
+
+    size_t index;
+    close(listen_fd);
+    close(connection_fd);
+    close(child_exit_pipe[0]);
+    close(child_exit_pipe[1]);
+    for (index = 0; index < num_children; ++index)
+        close(children[index].connection_fd);
+
+    /* dup2() clears FD_CLOEXEC on the new fd, which is what we want for stdin, stdout, and
+       stderr. */
+    for (index = 0; index < 3; ++index)
+        PAS_ASSERT(dup2(fds[index], (int)index) == (int)index);
+    PAS_ASSERT(!fchdir(fds[3]));
+    for (index = 0; index < ZYGOTE_NUM_FDS; ++index) {
+        if (fds[index] > 2)
+            close(fds[index]);
+    }
+}
+
+static void reap_children(zygote_child* children, size_t* num_children)
+{
+    for (;;) {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0)
+            return;
+        size_t index;
+        for (index = 0; index < *num_children; ++index) {
+            if (children[index].pid != pid)
+                continue;
+            int32_t reply = status;
+            write_fully(children[index].connection_fd, &reply, sizeof(reply));
+            close(children[index].connection_fd);
+            children[index] = children[--*num_children];
+            break;
+        }
+    }
+}
+
+void filc_zygote_serve_if_requested(filc_thread* my_thread, int* argc, char*** argv)
+{
+    const char* path = getenv("FILC_ZYGOTE");
+    if (!path)
+        return;
+
+    uint64_t exe_dev;
+    uint64_t exe_ino;
+    struct sockaddr_un address;
+    if (!get_exe_identity(&exe_dev, &exe_ino))
+        pas_panic("FILC_ZYGOTE: could not stat /proc/self/exe\n");
+    if (!fill_address(&address, path))
+        pas_panic("FILC_ZYGOTE: socket path is too long: %s\n", path);
+
+    filc_exit(my_thread);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    PAS_ASSERT(listen_fd >= 0);
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) || listen(listen_fd, 128))
+        pas_panic("FILC_ZYGOTE: could not listen on %s: %s\n", path, strerror(errno));
+
+    PAS_ASSERT(!pipe2(child_exit_pipe, O_CLOEXEC | O_NONBLOCK));
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_sigchld;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    PAS_ASSERT(!sigaction(SIGCHLD, &action, NULL));
+
+    size_t children_capacity = 16;
+    size_t num_children = 0;
+    zygote_child* children = (zygote_child*)bmalloc_allocate(
+        sizeof(zygote_child) * children_capacity);
+
+    for (;;) {
+        struct pollfd pollfds[2];
+        pollfds[0].fd = listen_fd;
+        pollfds[0].events = POLLIN;
+        pollfds[1].fd = child_exit_pipe[0];
+        pollfds[1].events = POLLIN;
+        if (poll(pollfds, 2, -1) < 0) {
+            PAS_ASSERT(errno == EINTR);
+            continue;
+        }
+
+        if (pollfds[1].revents) {
+            char buf[64];
+            while (read(child_exit_pipe[0], buf, sizeof(buf)) > 0);
+            reap_children(children, &num_children);
+        }
+
+        if (!pollfds[0].revents)
+            continue;
+        int connection_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (connection_fd < 0)
+            continue;
+
+        int fds[ZYGOTE_NUM_FDS];
+        int new_argc;
+        char** new_argv;
+        char** new_envp;
+        if (!receive_request(connection_fd, exe_dev, exe_ino, fds, &new_argc, &new_argv,
+                             &new_envp)) {
+            int32_t reply = -1;
+            write_fully(connection_fd, &reply, sizeof(reply));
+            close(connection_fd);
+            continue;
+        }
+
+        if (num_children == children_capacity) {
+            zygote_child* new_children = (zygote_child*)bmalloc_allocate(
+                sizeof(zygote_child) * children_capacity * 2);
+            memcpy(new_children, children, sizeof(zygote_child) * num_children);
+            bmalloc_deallocate(children);
+            children = new_children;
+            children_capacity *= 2;
+        }
+
+        filc_enter(my_thread);
+        int32_t pid = filc_native_zsys_fork(my_thread);
+        if (!pid) {
+            become_child(fds, listen_fd, children, num_children, connection_fd);
+            bmalloc_deallocate(children);
+            environ = new_envp;
+            *argc = new_argc;
+            *argv = new_argv;
+            return;
+        }
+        filc_exit(my_thread);
+
+        close_received_fds(fds, ZYGOTE_NUM_FDS);
+        bmalloc_deallocate(new_argv[0]);
+        bmalloc_deallocate(new_argv);
+        if (pid < 0 || !write_fully(connection_fd, &pid, sizeof(pid))) {
+            close(connection_fd);
+            continue;
+        }
+        children[num_children].pid = pid;
+        children[num_children].connection_fd = connection_fd;
+        num_children++;
+    }
+}
+
+void filc_zygote_dump_setup(void)
+{
+    const char* path = getenv("FILC_ZYGOTE");
+    pas_log("    zygote: %s\n", path ? path : "off");
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef FILC_ZYGOTE_H
+#define FILC_ZYGOTE_H
+
+#include "filc_runtime.h"
+
+/* With FILC_ZYGOTE=<socket path>, a Fil-C program initializes the runtime and resolves main() and
+   __libc_start_main(), and then, instead of going further, listens on a Unix socket at that path.
+   Each connection asks it to fork a child that carries on starting the program with the argv,
+   environment, cwd, and stdin/stdout/stderr of whoever connected. The children start out with
+   the zygote's initialized heap and resolved globals, so they skip that part of startup. Global
+   ctors still run in each child, since they can look at argv and the environment. So do the
+   runtime's own environment variables, which the zygote read when it initialized.
+
+   With FILC_ZYGOTE_CONNECT=<socket path>, a Fil-C program first tries to hand its invocation to a
+   zygote of the same executable at that path. If one takes it, the program forwards SIGINT,
+   SIGTERM, SIGHUP, and SIGQUIT to the child, waits for the child to finish, and exits the same
+   way. Otherwise it starts up normally. The child isn't in the connecting program's process group
+   or session, so this is for scripts, not job control.
+
+   The zygote only takes connections from its own user, but anyone who can connect can run the
+   program as that user, so the socket should go in a private directory. */
+
+/* Called by filc_start_program() before anything else happens. Doesn't return if a zygote took
+   the invocation. */
+PAS_API void filc_zygote_connect_if_requested(int argc, char** argv);
+
+/* Called by filc_start_program() once main() is resolved. Only returns in the children (or if
+   FILC_ZYGOTE isn't set), with *argc, *argv, and environ replaced by the connecting program's. */
+PAS_API void filc_zygote_serve_if_requested(filc_thread* my_thread, int* argc, char*** argv);
+
+PAS_API void filc_zygote_dump_setup(void);
+
+#endif /* FILC_ZYGOTE_H */
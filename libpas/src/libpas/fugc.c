@@ -28,10 +28,24 @@
 #if LIBPAS_ENABLED
 
 #include "fugc.h"
+#include "filc_alloc_trace.h"
+#include "filc_heap_profiler.h"
+#include "filc_heap_composition.h"
+#include "filc_heap_snapshot.h"
+#include "filc_memory_pressure.h"
+#include "filc_probes.h"
 #include "pas_fd_stream.h"
+#include "pas_scavenger.h"
 #include "verse_heap_mark_bits_page_commit_controller.h"
 #include "verse_heap_object_set_inlines.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
 
 #if PAS_ENABLE_FILC
 
@@ -45,11 +59,81 @@
    mode to triage if the bug has to do with concurrency or not). Also maybe someday we'll want to
    add some thread stoppage for GC pacing (in case the mutator out-allocates us).
    
-   It would be easy to make the collector loop parallel, but it isn't, yet.
+   Marking can be parallel. The collector thread is always a marker, and FUGC_MARKER_THREADS-1
+   helper threads join it for each drain of the mark stack. Each marker has its own mark stack.
+   Markers that run dry steal from global_stack, and busy markers donate half of their stack to
+   global_stack whenever someone is idle. A drain ends when every marker is idle and global_stack
+   is empty, at which point the collector goes back to the soft handshake fixpoint.
+
+   Mutators that allocate a lot during marking help out with it. Every FUGC_MARK_ASSIST_BUDGET
+   bytes that a thread allocates (1MB by default, 0 to disable) costs it that many bytes of tracing
+   off of its own mark stack at its next pollcheck or exit. It only ever takes work from its own
+   stack, so the soft handshake fixpoint still sees everything.
+
+   Destructing and sweeping are parallel, too. The same helper threads claim chunks of the
+   destructor set from destruct_index, and then chunks of the verse_heap's views from sweep_index,
+   until there is nothing left to claim. They also claim chunks of the exited threads during each
+   soft handshake, and run those threads' callbacks for them. Mutator threads that call
+   fugc_hint_idle() join these rounds too, but leave when their time budget runs out. Dead mmap
+   objects don't get unmapped by the destructors themselves. Instead, they're queued for the
+   unmapper thread (unless FUGC_DEFER_UNMAP=0), so that a program that drops lots of mappings
+   doesn't hold up destructing. The sweep is what frees those objects' ranges, so it waits for the
+   queue to drain first. Otherwise, the heap could hand a range out again and then the unmap would
+   wipe whatever got allocated there.
+
+   In stop-the-world mode (FUGC_STW=1), there is one marker thread per core unless
+   FUGC_MARKER_THREADS says otherwise, since the mutators aren't using the cores anyway. With
+   FUGC_STW_LEND_MUTATORS=1, the parked mutator threads join the rounds, too, like they would in
+   fugc_hint_idle().
    
-   It would be possible to add a concurrent nursery GC, which would have the dual effect of reducing
-   floating garbage and increasing mutator throughput.
+   There is an optional generational mode (FUGC_GENERATIONAL=1) based on sticky mark bits. In that
+   mode, most sweeps leave the mark bits of survivors set, so the next cycle is a young cycle that
+   only has to trace objects allocated since then. The store barrier stays on between cycles
+   (filc_store_barrier_is_on is never cleared, even though filc_is_marking is), so any object that
+   gets stored into the heap is marked and put on the storing thread's mark stack right away. The
+   mark bit doubles as the log bit, so each object gets remembered at most once. That's the
+   remembered set: it's exactly the Dijkstra invariant that concurrent marking already relies on,
+   with old objects playing the role of black objects. Every FUGC_YOUNG_CYCLES_PER_FULL young cycles, we do a normal sweep, which
+   clears the mark bits and makes the next cycle a full one. Young cycles also only scan the global
+   variables that were registered since the last cycle, since stores into the others went through
+   the barrier (unless FUGC_RESCAN_ALL_GLOBALS=1). What gets remembered between cycles is bounded
+   by FUGC_REMEMBERED_SET_LIMIT objects: a mutator whose mark stack gets that big donates it, and
+   once the donated objects get that big too, the collector (which polls for this while waiting)
+   starts a young cycle to trace them.
    
+   Objects that once held ptrs keep their aux even after every ptr in them gets overwritten. So,
+   marking notices small heap objects whose aux is all NULL, and leaves the aux unmarked. Once
+   marking terminates, the collector briefly stops the world, rechecks those auxes (mutators may
+   have stored ptrs since), and detaches the ones that are still empty, which lets the sweep free
+   them. The next ptr store just allocates a fresh aux. Stopping the world is what makes this
+   safe, since compiled code never holds an aux ptr across a safepoint. The runtime either rechecks
+   the aux after exiting or only exits while holding the aux ptrs of objects that are too big to be
+   candidates (FUGC_DETACH_AUX=0 disables all of this).
+
+   Every thread caches partly used pages in its local allocators. Sweeping makes every thread give
+   those back, but with thousands of threads that mostly sit blocked in syscalls, and a heap that
+   doesn't grow much, that could take a long time, and the cached pages add up. So, while waiting
+   for a cycle, if anything got allocated since the last time it checked, the collector waits
+   FUGC_IDLE_CACHE_RECLAIM_MS milliseconds (1000 by default, 0 to disable) and then does a soft
+   handshake that empties the caches of the threads that are exited. The threads that are running
+   keep theirs. That way, the memory held
+   in caches grows with the number of threads that are actually running, which is bounded by the
+   number of cores, and not the number of threads.
+
+   The collector's own threads (the collector, the helpers, and the unmapper) can be pinned to the
+   cores in FUGC_CPU_AFFINITY (a list like 2-3,8) and reniced to FUGC_NICE. FUGC_DUTY_CYCLE_PERCENT
+   (100 by default) caps how much of a core each of them uses while it works: after every slice of
+   work, it sleeps long enough to stay under the cap. Lent mutator threads are never throttled.
+   The pacer doesn't need to be told about this, since it measures the collection rate in wall
+   clock time, so a throttled collector just triggers earlier. If the cgroup has a cpu.max quota,
+   the default number of marker threads in stop-the-world mode is capped by it, as well as by the
+   affinity mask.
+
+   Big auxes are zeroed by having the kernel throw their pages away, so their untouched pages are
+   never committed. Marking asks /proc/self/pagemap which pages of a big aux were never touched
+   and skips them. Zeroing the large cache after a cycle skips untouched pages the same way, so it
+   doesn't commit them.
+
    It's a nonmoving GC, but it redirects ptrs to free objects to the free singleton, which enables
    freed objects to definitely be freed. Except, it won't redirect ptrs from certain roots (like
    ones coming from the stack).
@@ -87,9 +171,65 @@ static filc_object_array global_stack;
 static filc_object_array local_stack;
 static pas_lock global_stack_lock;
 
+/* Set by fugc_donate() when global_stack reaches filc_remembered_set_limit. Donating happens while
+   entered (even from the store barrier), so it can't take collector_thread_state_lock to wake us up.
+   Instead, the collector polls for this every REMEMBERED_SET_POLL_PERIOD ms while it waits. */
+static bool remembered_set_is_full = false;
+#define REMEMBERED_SET_POLL_PERIOD 10.
+
+static unsigned num_marker_threads;
+
+#define MAX_EMPTY_AUX_CANDIDATES 65536
+
+/* Objects whose aux looked empty when we scanned them. Their auxes aren't marked yet. The
+   empty_aux_candidates_lock protects both of these. */
+static bool should_detach_empty_auxes;
+static filc_object_array empty_aux_candidates;
+static bool is_collecting_empty_aux_candidates = false;
+static pas_lock empty_aux_candidates_lock;
+
+/* The marker_lock protects everything below, and must be held when markers move objects in or out
+   of global_stack (mutators donating to global_stack only need global_stack_lock). Holding it for
+   stealing and donating is what makes it safe for idle markers to sleep on marker_cond. */
+static pas_system_mutex marker_lock;
+static pas_system_condition marker_cond;
+static unsigned num_marker_helpers_running = 0;
+static bool marker_helpers_should_stop = false;
+static uint64_t marker_round = 0;
+static bool marker_round_is_active = false;
+static void (*marker_round_task)(filc_object_array* stack, double deadline);
+static unsigned num_markers_in_round = 0;
+static unsigned num_idle_markers = 0;
+static unsigned num_lent_markers = 0; /* Mutator threads in fugc_hint_idle(). */
+/* The cycle that has the world stopped, or 0 if there isn't one. */
+static uint64_t stopped_cycle = 0;
+
 static size_t destruct_size = SIZE_MAX;
 static size_t destruct_index = SIZE_MAX;
 
+/* If set, we zero the large object ranges that the sweep cached at the end of each cycle, so that
+   large allocations don't have to. */
+static bool should_zero_large_cache;
+
+#define UNMAP_QUEUE_SIZE 256
+
+typedef struct {
+    void* ptr;
+    size_t size;
+} pending_unmap;
+
+/* The unmapper_lock protects everything below. If the queue is full, destructors just unmap
+   inline. */
+static bool should_defer_unmap;
+static pas_system_mutex unmapper_lock;
+static pas_system_condition unmapper_cond;
+static bool unmapper_is_running = false;
+static bool unmapper_should_stop = false;
+static bool unmapper_is_unmapping = false;
+static pending_unmap unmap_queue[UNMAP_QUEUE_SIZE];
+static size_t unmap_queue_head = 0;
+static size_t unmap_queue_tail = 0;
+
 static size_t sweep_size = SIZE_MAX;
 static size_t sweep_index = SIZE_MAX;
 
@@ -98,10 +238,33 @@ static size_t live_bytes_before_sweeping = SIZE_MAX;
 
 static size_t minimum_threshold;
 
+/* The pacer picks a heap goal for the next cycle (either FUGC_TARGET_HEAP_SIZE, or the surviving
+   bytes grown by FUGC_GROWTH_PERCENT, capped by the memory limit). Then it triggers early enough
+   that, at the allocation and collection rates we saw last time, the cycle finishes right as the
+   heap reaches the goal. */
+static unsigned growth_percent;
+static unsigned idle_trigger_percent;
+static unsigned idle_cache_reclaim_period; /* In milliseconds. Zero means never. */
+static size_t live_bytes_at_last_cache_reclaim;
+static bool found_idle_cache_candidates;
+static bool did_reclaim_idle_caches;
+static size_t target_heap_size;
+static size_t memory_limit;
+static double allocation_rate_estimate; /* Bytes allocated by mutators per ms of collection. */
+static double collection_rate_estimate; /* Bytes of heap collected per ms. */
+
 static double overall_start_time;
 static double mark_end_time;
+static bool froze_weaks;
+static double destruct_end_time;
 static double overall_end_time;
 
+/* The collector_thread_state_lock protects the stats, including the handshake counters, so that
+   fugc_get_stats() never sees the histogram disagree with num_handshakes. The mark stack high water
+   mark is kept outside of here while markers update it atomically. */
+static fugc_stats stats;
+static uintptr_t mark_stack_high_water;
+
 #define VERBOSE_HANDSHAKE_STACKS 6
 #define VERBOSE_HANDSHAKES 5
 #define VERBOSE_PHASES 4
@@ -109,8 +272,22 @@ static double overall_end_time;
 #define VERBOSE_BREAKDOWN 2
 #define VERBOSE_CYCLES 1
 
+#define DUTY_CYCLE_SLICE_MS 2.
+
+static bool has_cpu_affinity;
+static cpu_set_t cpu_affinity;
+static bool has_nice;
+static int nice_value;
+static unsigned duty_cycle_percent;
+
 static unsigned verbose;
 static bool should_stop_the_world;
+static bool should_lend_stopped_mutators;
+static bool is_generational;
+static unsigned young_cycles_per_full;
+static unsigned num_young_cycles_since_full = 0;
+static bool current_cycle_is_full = true;
+static bool should_rescan_all_globals;
 
 enum collector_state {
     collector_waiting,
@@ -161,11 +338,41 @@ static void stop_allocators_pollcheck_callback(filc_thread* thread, void* arg)
     filc_thread_stop_allocators(thread);
 }
 
+/* Threads that are entered keep their caches, since they're using them. But a thread whose callback
+   we run for it is exited, and it may be blocked for a long time. Threads that are in and out of
+   syscalls are also exited most of the time, and stopping their allocators would only send them
+   into refills. So we only take the caches of threads that haven't entered since the last pass.
+   Idle threads also give back their lazily allocated syscall scratch space. */
+static void reclaim_idle_caches_pollcheck_callback(filc_thread* thread, void* arg)
+{
+    PAS_ASSERT(!arg);
+    dump_handshake(thread, "reclaim_idle_caches");
+    if (thread == filc_get_my_thread())
+        return;
+    if (thread->entered_since_cache_reclaim) {
+        thread->entered_since_cache_reclaim = false;
+        found_idle_cache_candidates = true;
+        return;
+    }
+    filc_thread_stop_allocators(thread);
+    filc_thread_reclaim_idle_space_with_guard_page(thread);
+    did_reclaim_idle_caches = true;
+}
+
+/* Allocators that were bump allocating keep going, with the rest of their bump region marked. So
+   the start of a cycle doesn't send every thread into the allocation slow path. */
+static void start_allocating_black_pollcheck_callback(filc_thread* thread, void* arg)
+{
+    PAS_ASSERT(!arg);
+    dump_handshake(thread, "start_allocating_black");
+    filc_thread_start_allocating_black(thread);
+}
+
 static void marking_pollcheck_callback(filc_thread* thread, void* arg)
 {
     PAS_ASSERT(!arg);
     dump_handshake(thread, "marking");
-    filc_thread_stop_allocators(thread);
+    filc_thread_start_allocating_black(thread);
     filc_thread_mark_roots(thread);
     filc_thread_donate(thread);
 }
@@ -216,6 +423,21 @@ static void mark_outgoing_special_ptrs(filc_object_array* stack, filc_object* ob
         filc_exact_ptr_table_mark_outgoing_ptrs(
             (filc_exact_ptr_table*)filc_object_special_payload_with_manual_tracking(object), stack);
         break;
+    case FILC_SPECIAL_TYPE_IO_URING:
+        filc_io_uring_mark_outgoing_ptrs(
+            (filc_io_uring*)filc_object_special_payload_with_manual_tracking(object), stack);
+        break;
+    case FILC_SPECIAL_TYPE_WEAK:
+        /* The whole point is to not mark the target. */
+        break;
+    case FILC_SPECIAL_TYPE_ARENA:
+        filc_arena_mark_outgoing_ptrs(
+            (filc_arena*)filc_object_special_payload_with_manual_tracking(object), stack);
+        break;
+    case FILC_SPECIAL_TYPE_FIBER:
+        filc_fiber_mark_outgoing_ptrs(
+            (filc_fiber*)filc_object_special_payload_with_manual_tracking(object), stack);
+        break;
     default:
         pas_log("Got a bad special ptr type: ");
         filc_special_type_dump(special_type, &pas_log_stream.base);
@@ -228,11 +450,220 @@ static void mark_outgoing_special_ptrs(filc_object_array* stack, filc_object* ob
     }
 }
 
-static void mark_outgoing_ptrs(filc_object_array* stack, filc_object* object)
+#define MARK_PREFETCH_QUEUE_SIZE 8
+#define MARK_NULL_SKIP_GROUP_SIZE 8
+
+#define SPARSE_AUX_MIN_BYTES ((size_t)1024 * 1024)
+#define PAGEMAP_CHUNK_SIZE 512
+#define PAGEMAP_PRESENT ((uint64_t)1 << 63)
+#define PAGEMAP_SWAPPED ((uint64_t)1 << 62)
+
+/* This is -1 if we can't read our own pagemap. */
+static int pagemap_fd = -1;
+static int pagemap_pid;
+
+/* /proc/self/pagemap is resolved when it's opened, so a forked child has to open its own. */
+static void open_pagemap(void)
+{
+    if (pagemap_fd >= 0 && pagemap_pid == pas_getpid())
+        return;
+    if (pagemap_fd >= 0)
+        close(pagemap_fd);
+    pagemap_fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    pagemap_pid = pas_getpid();
+}
+
+/* Only small heap objects get their aux detached. The memset and memmove paths that exit while
+   holding an aux ptr only run for accesses bigger than FILC_MAX_BYTES_FOR_SMALL_CASE. */
+static bool can_detach_aux(filc_object* object, filc_object_flags flags)
+{
+    if ((flags & (FILC_OBJECT_FLAG_FREE | FILC_OBJECT_FLAG_GLOBAL | FILC_OBJECT_FLAG_READONLY |
+                  FILC_OBJECT_FLAG_MMAP | FILC_OBJECT_FLAG_GLOBAL_AUX | FILC_OBJECT_FLAG_STACK |
+                  FILC_OBJECT_FLAG_INLINE_AUX | FILC_OBJECT_FLAGS_SPECIAL_MASK)))
+        return false;
+    size_t size = filc_object_size(object);
+    return size && size <= FILC_MAX_BYTES_FOR_SMALL_CASE;
+}
+
+/* Returns false if the caller has to mark the aux itself. */
+static bool add_empty_aux_candidate(filc_object* object)
+{
+    bool result = false;
+    pas_lock_lock(&empty_aux_candidates_lock);
+    if (is_collecting_empty_aux_candidates
+        && empty_aux_candidates.num_objects < MAX_EMPTY_AUX_CANDIDATES) {
+        filc_object_array_push(&empty_aux_candidates, object);
+        result = true;
+    }
+    pas_lock_unlock(&empty_aux_candidates_lock);
+    return result;
+}
+
+typedef struct {
+    filc_lower_or_box* slots[MARK_PREFETCH_QUEUE_SIZE];
+    size_t head;
+    size_t tail;
+} mark_prefetch_queue;
+
+/* Returns true if the slot held a ptr. */
+static PAS_ALWAYS_INLINE bool mark_aux_slot(filc_object_array* stack, mark_prefetch_queue* queue,
+                                            filc_lower_or_box* lower_or_box_ptr)
+{
+    filc_lower_or_box lower_or_box = filc_lower_or_box_load_unfenced(lower_or_box_ptr);
+    if (filc_lower_or_box_is_null(lower_or_box))
+        return false;
+    if (filc_lower_or_box_is_box(lower_or_box))
+        __builtin_prefetch(filc_lower_or_box_get_box(lower_or_box));
+    else {
+        filc_object* target = filc_object_for_lower_not_null(
+            filc_lower_or_box_get_lower(lower_or_box));
+        __builtin_prefetch(target);
+        __builtin_prefetch(verse_heap_mark_bits_word_for_address((uintptr_t)target));
+    }
+    if (queue->tail - queue->head == MARK_PREFETCH_QUEUE_SIZE) {
+        fugc_mark_or_free_lower_or_box(
+            stack, queue->slots[queue->head++ % MARK_PREFETCH_QUEUE_SIZE]);
+    }
+    queue->slots[queue->tail++ % MARK_PREFETCH_QUEUE_SIZE] = lower_or_box_ptr;
+    return true;
+}
+
+/* Marks what the aux points to between the given offsets. Returns true if it saw any ptrs. */
+static PAS_ALWAYS_INLINE bool mark_aux_range(filc_object_array* stack, char* aux_ptr,
+                                             size_t begin_offset, size_t end_offset)
+{
+    size_t offset;
+    PAS_ASSERT(sizeof(filc_lower_or_box) == FILC_WORD_SIZE);
+    PAS_ASSERT(sizeof(filc_lower_or_box) == sizeof(void*));
+    /* Aux words are mostly null (ints, floats, and unused ptr slots), and the non-null ones usually
+       point at objects that aren't in cache. So, we skip null runs a cache line's worth of words at
+       a time and keep a small FIFO of the slots we found, prefetching each object's header and mark
+       bit word when it goes in so that the misses overlap with scanning the rest of the aux. A
+       group that isn't all null gets scanned word by word before we move on to the next group, so
+       dense groups aren't rechecked at every offset.
+
+       We can't skip slots based on the static type, since any word can hold a ptr in Fil-C (memcpy,
+       unions, and int-to-ptr casts all move capabilities into slots that aren't typed as ptrs).
+
+       Queued slots get reloaded when they come out of the FIFO, so it's fine if the mutator changes
+       them in the meantime. */
+    mark_prefetch_queue queue;
+    queue.head = 0;
+    queue.tail = 0;
+    bool saw_ptr = false;
+    for (offset = begin_offset; offset < end_offset;) {
+        if (offset + MARK_NULL_SKIP_GROUP_SIZE * sizeof(filc_lower_or_box) <= end_offset) {
+            filc_lower_or_box* group = (filc_lower_or_box*)(aux_ptr + offset);
+            uintptr_t combined = 0;
+            size_t index;
+            for (index = 0; index < MARK_NULL_SKIP_GROUP_SIZE; ++index)
+                combined |= filc_lower_or_box_load_unfenced(group + index).encoded_value;
+            offset += MARK_NULL_SKIP_GROUP_SIZE * sizeof(filc_lower_or_box);
+            if (!combined)
+                continue;
+            for (index = 0; index < MARK_NULL_SKIP_GROUP_SIZE; ++index)
+                saw_ptr |= mark_aux_slot(stack, &queue, group + index);
+            continue;
+        }
+        saw_ptr |= mark_aux_slot(stack, &queue, (filc_lower_or_box*)(aux_ptr + offset));
+        offset += sizeof(filc_lower_or_box);
+    }
+    while (queue.head != queue.tail)
+        fugc_mark_or_free_lower_or_box(stack, queue.slots[queue.head++ % MARK_PREFETCH_QUEUE_SIZE]);
+    return saw_ptr;
+}
+
+/* Calls the callback for each run of pages in [begin, end) that may have been touched. The kernel's
+   pagemap tells us which pages are neither present nor swapped out. Those are still demand-zero
+   pages, so we skip them. We can't use mincore() for this, since it says that swapped out pages
+   aren't resident. Requires pagemap_fd. */
+static void for_each_touched_range(uintptr_t begin, uintptr_t end,
+                                   void (*callback)(uintptr_t begin, uintptr_t end, void* arg),
+                                   void* arg)
+{
+    uint64_t entries[PAGEMAP_CHUNK_SIZE];
+    uintptr_t page_size = pas_page_malloc_alignment();
+    uintptr_t page = pas_round_down_to_power_of_2(begin, page_size);
+    uintptr_t touched_begin = 0;
+    PAS_ASSERT(pagemap_fd >= 0);
+    while (page < end) {
+        size_t num_pages = pas_min_uintptr(
+            PAGEMAP_CHUNK_SIZE, pas_round_up_to_power_of_2(end - page, page_size) / page_size);
+        ssize_t result = pread(pagemap_fd, entries, num_pages * sizeof(uint64_t),
+                               (off_t)(page / page_size * sizeof(uint64_t)));
+        /* If we can't tell, then we assume that the page was touched. */
+        size_t num_known_pages = result > 0 ? (size_t)result / sizeof(uint64_t) : 0;
+        size_t index;
+        for (index = 0; index < num_pages; ++index, page += page_size) {
+            bool is_touched = index >= num_known_pages
+                || (entries[index] & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED));
+            if (is_touched && !touched_begin)
+                touched_begin = pas_max_uintptr(page, begin);
+            else if (!is_touched && touched_begin) {
+                callback(touched_begin, page, arg);
+                touched_begin = 0;
+            }
+        }
+    }
+    if (touched_begin)
+        callback(touched_begin, end, arg);
+}
+
+typedef struct {
+    filc_object_array* stack;
+    char* aux_ptr;
+    bool saw_ptr;
+} mark_sparse_aux_data;
+
+static void mark_sparse_aux_callback(uintptr_t begin, uintptr_t end, void* arg)
+{
+    mark_sparse_aux_data* data = (mark_sparse_aux_data*)arg;
+    uintptr_t aux_begin = (uintptr_t)data->aux_ptr;
+    data->saw_ptr |= mark_aux_range(data->stack, data->aux_ptr, begin - aux_begin, end - aux_begin);
+}
+
+/* Big auxes start out as demand-zero pages (see filc_object_ensure_aux_ptr_slow()), so if only a
+   few ptrs ever get stored into them, most of their pages are never touched, and we skip those.
+
+   A page that we skip may get a ptr stored into it right after we look, but then the store barrier
+   marks what the ptr points to, just like for any other slot that we already scanned. */
+static bool mark_sparse_aux(filc_object_array* stack, char* aux_ptr, size_t size)
+{
+    mark_sparse_aux_data data;
+    data.stack = stack;
+    data.aux_ptr = aux_ptr;
+    data.saw_ptr = false;
+    for_each_touched_range(
+        (uintptr_t)aux_ptr, (uintptr_t)aux_ptr + size, mark_sparse_aux_callback, &data);
+    return data.saw_ptr;
+}
+
+static void zero_range_callback(uintptr_t begin, uintptr_t end, void* arg)
+{
+    PAS_ASSERT(!arg);
+    pas_zero_memory((void*)begin, end - begin);
+}
+
+/* The large cache holds ranges whose pages may never have been touched (big objects that were
+   mostly unused), or that got thrown away (unmapped mmap objects). Memsetting those would commit
+   them for nothing, since they're already zero. */
+static void zero_large_cache_range(void* begin, size_t size)
+{
+    if (pagemap_fd < 0) {
+        pas_zero_memory(begin, size);
+        return;
+    }
+    for_each_touched_range(
+        (uintptr_t)begin, (uintptr_t)begin + size, zero_range_callback, NULL);
+}
+
+void fugc_mark_outgoing_ptrs(filc_object_array* stack, filc_object* object)
 {
     static const bool verbose = false;
     if (verbose)
         pas_log("Marking outgoing objects from %p\n", object);
+    if (PAS_UNLIKELY(filc_heap_snapshot_is_recording))
+        filc_heap_snapshot_record_object(object);
     if (filc_object_is_special(object)) {
         mark_outgoing_special_ptrs(stack, object);
         return;
@@ -243,7 +674,10 @@ static void mark_outgoing_ptrs(filc_object_array* stack, filc_object* object)
     char* aux_ptr = filc_object_aux_ptr(object);
     if (PAS_UNLIKELY(!aux_ptr))
         return;
-    if (!(filc_object_get_flags(object) & FILC_OBJECT_FLAG_GLOBAL_AUX))
+    filc_object_flags flags = filc_object_get_flags(object);
+    /* If the aux might be detached, then we only mark it once we know that it holds something. */
+    bool can_detach = should_detach_empty_auxes && can_detach_aux(object, flags);
+    if (!can_detach && !(flags & (FILC_OBJECT_FLAG_GLOBAL_AUX | FILC_OBJECT_FLAG_INLINE_AUX)))
         verse_heap_set_is_marked_relaxed(aux_ptr, true);
     /* The only way for the aux to already be marked is if it's black, but then that means that all of
        the things it points to are already marked (either black-allocated atomic boxes or things
@@ -251,13 +685,384 @@ static void mark_outgoing_ptrs(filc_object_array* stack, filc_object* object)
     
        So, a possible optimization would be to skip this loop if the aux is already marked. */
     size_t size = filc_object_size_not_null(object);
-    size_t offset;
-    PAS_ASSERT(sizeof(filc_lower_or_box) == FILC_WORD_SIZE);
-    PAS_ASSERT(sizeof(filc_lower_or_box) == sizeof(void*));
-    for (offset = 0; offset < size; offset += sizeof(filc_lower_or_box)) {
-        filc_lower_or_box* lower_or_box_ptr = (filc_lower_or_box*)(aux_ptr + offset);
-        fugc_mark_or_free_lower_or_box(stack, lower_or_box_ptr);
+    bool saw_ptr;
+    if (size >= SPARSE_AUX_MIN_BYTES && pagemap_fd >= 0)
+        saw_ptr = mark_sparse_aux(stack, aux_ptr, size);
+    else
+        saw_ptr = mark_aux_range(stack, aux_ptr, 0, size);
+    if (can_detach && (saw_ptr || !add_empty_aux_candidate(object)))
+        verse_heap_set_is_marked_relaxed(aux_ptr, true);
+}
+
+/* Must be called with the world stopped. Any ptr that got stored into the aux since we scanned it
+   was marked by the store barrier, so all that's left to do for a nonempty aux is mark it. */
+static bool try_detach_empty_aux(filc_object* object)
+{
+    uintptr_t aux = filc_object_aux(object);
+    char* aux_ptr = filc_aux_get_ptr(aux);
+    if (!aux_ptr)
+        return false;
+    if (can_detach_aux(object, filc_aux_get_flags(aux))) {
+        size_t size = filc_object_size_not_null(object);
+        size_t offset;
+        bool is_empty = true;
+        for (offset = 0; offset < size && is_empty; offset += sizeof(filc_lower_or_box)) {
+            is_empty = filc_lower_or_box_is_null(
+                filc_lower_or_box_load_unfenced((filc_lower_or_box*)(aux_ptr + offset)));
+        }
+        if (is_empty
+            && pas_compare_and_swap_uintptr_strong(
+                &object->aux, aux, filc_aux_create(filc_aux_get_flags(aux), NULL)) == aux)
+            return true;
+    }
+    verse_heap_set_is_marked_relaxed(aux_ptr, true);
+    return false;
+}
+
+static void detach_empty_auxes(void)
+{
+    pas_lock_lock(&empty_aux_candidates_lock);
+    is_collecting_empty_aux_candidates = false;
+    pas_lock_unlock(&empty_aux_candidates_lock);
+
+    if (!empty_aux_candidates.num_objects)
+        return;
+
+    if (!should_stop_the_world)
+        filc_stop_the_world();
+    size_t num_candidates = 0;
+    size_t num_detached = 0;
+    filc_object* object;
+    while ((object = filc_object_array_pop(&empty_aux_candidates))) {
+        num_candidates++;
+        if (try_detach_empty_aux(object))
+            num_detached++;
+    }
+    if (!should_stop_the_world)
+        filc_resume_the_world();
+    filc_object_array_reset(&empty_aux_candidates);
+
+    if (verbose >= VERBOSE_PHASES) {
+        pas_log("[%d] fugc: detached %zu of %zu empty aux candidates\n",
+                pas_getpid(), num_detached, num_candidates);
+    }
+}
+
+static bool deadline_has_passed(double deadline)
+{
+    return deadline != PAS_INFINITY && pas_get_time_in_milliseconds() >= deadline;
+}
+
+/* Every thread that create_thread() starts calls this first. */
+static void configure_collector_thread(void)
+{
+    if (has_cpu_affinity && sched_setaffinity(0, sizeof(cpu_affinity), &cpu_affinity)
+        && verbose >= VERBOSE_CYCLES)
+        pas_log("[%d] fugc: could not set CPU affinity: %s\n", pas_getpid(), strerror(errno));
+    /* On Linux, this only renices the calling thread. */
+    if (has_nice && setpriority(PRIO_PROCESS, 0, nice_value) && verbose >= VERBOSE_CYCLES)
+        pas_log("[%d] fugc: could not set nice to %d: %s\n", pas_getpid(), nice_value,
+                strerror(errno));
+}
+
+/* Called every so often by the collector's threads while they work. The slice_start starts out as
+   the time the caller started working, and gets reset after every pause. */
+static void throttle_for_duty_cycle(double* slice_start)
+{
+    if (duty_cycle_percent >= 100 || filc_get_my_thread())
+        return;
+    double now = pas_get_time_in_milliseconds();
+    double worked = now - *slice_start;
+    if (worked < DUTY_CYCLE_SLICE_MS)
+        return;
+    double pause = worked * (100 - duty_cycle_percent) / duty_cycle_percent;
+    struct timespec duration;
+    duration.tv_sec = (time_t)(pause / 1000.);
+    duration.tv_nsec = (long)((pause - duration.tv_sec * 1000.) * 1000000.);
+    while (nanosleep(&duration, &duration) && errno == EINTR) { }
+    *slice_start = pas_get_time_in_milliseconds();
+}
+
+static bool steal_or_finish_round(filc_object_array* stack, double deadline)
+{
+    pas_system_mutex_lock(&marker_lock);
+    for (;;) {
+        PAS_ASSERT(marker_round_is_active);
+        if (!collector_control_request) {
+            pas_lock_lock(&global_stack_lock);
+            size_t count = global_stack.num_objects / num_markers_in_round;
+            if (!count)
+                count = global_stack.num_objects;
+            filc_object_array_pop_some_from_and_push_to(&global_stack, stack, count);
+            pas_lock_unlock(&global_stack_lock);
+            if (stack->num_objects) {
+                pas_system_mutex_unlock(&marker_lock);
+                return true;
+            }
+        }
+        num_idle_markers++;
+        PAS_ASSERT(num_idle_markers <= num_markers_in_round);
+        if (num_idle_markers == num_markers_in_round) {
+            marker_round_is_active = false;
+            pas_system_condition_broadcast(&marker_cond);
+            pas_system_mutex_unlock(&marker_lock);
+            return false;
+        }
+        if (deadline == PAS_INFINITY)
+            pas_system_condition_wait(&marker_cond, &marker_lock);
+        else
+            pas_system_condition_timed_wait(&marker_cond, &marker_lock, deadline);
+        if (!marker_round_is_active) {
+            pas_system_mutex_unlock(&marker_lock);
+            return false;
+        }
+        num_idle_markers--;
+        if (deadline_has_passed(deadline)) {
+            pas_system_mutex_unlock(&marker_lock);
+            return false;
+        }
+    }
+}
+
+static void donate(filc_object_array* stack, size_t count)
+{
+    pas_system_mutex_lock(&marker_lock);
+    pas_lock_lock(&global_stack_lock);
+    filc_object_array_pop_some_from_and_push_to(stack, &global_stack, count);
+    pas_lock_unlock(&global_stack_lock);
+    pas_system_condition_broadcast(&marker_cond);
+    pas_system_mutex_unlock(&marker_lock);
+}
+
+/* Must be called with the marker_lock held by a marker that leaves the round before the round is
+   over, which only happens to lent markers that run out of time. If everyone else is idle, then it's
+   up to us to end the round. */
+static void leave_round_early(void)
+{
+    PAS_ASSERT(num_markers_in_round);
+    num_markers_in_round--;
+    if (marker_round_is_active && num_markers_in_round
+        && num_idle_markers == num_markers_in_round) {
+        pas_lock_lock(&global_stack_lock);
+        if (collector_control_request || !global_stack.num_objects)
+            marker_round_is_active = false;
+        pas_lock_unlock(&global_stack_lock);
+    }
+    pas_system_condition_broadcast(&marker_cond);
+}
+
+static void note_mark_stack_high_water(size_t high_water)
+{
+    for (;;) {
+        uintptr_t old_high_water = mark_stack_high_water;
+        if (high_water <= old_high_water)
+            return;
+        if (pas_compare_and_swap_uintptr_weak(&mark_stack_high_water, old_high_water, high_water))
+            return;
+    }
+}
+
+/* Drains the given mark stack along with whatever it can steal from global_stack, until the round
+   ends. Returns with the stack empty. If there is a control request, the remaining work is put
+   back into global_stack so that the collector can pick it up when it resumes. If the deadline
+   passes, the remaining work is donated to the other markers. */
+static void drain_in_round(filc_object_array* stack, double deadline)
+{
+    size_t high_water = stack->num_objects;
+    double slice_start = pas_get_time_in_milliseconds();
+    for (;;) {
+        filc_object* object;
+        unsigned count = 0;
+        bool is_out_of_time = false;
+        while (!collector_control_request && (object = filc_object_array_pop(stack))) {
+            fugc_mark_outgoing_ptrs(stack, object);
+            high_water = pas_max_uintptr(high_water, stack->num_objects);
+            if (!(++count % 64)) {
+                if (deadline_has_passed(deadline)) {
+                    is_out_of_time = true;
+                    break;
+                }
+                if (num_idle_markers && stack->num_objects >= 2)
+                    donate(stack, stack->num_objects / 2);
+                throttle_for_duty_cycle(&slice_start);
+            }
+        }
+        if (is_out_of_time) {
+            donate(stack, stack->num_objects);
+            break;
+        }
+        if (stack->num_objects) {
+            PAS_ASSERT(collector_control_request);
+            pas_lock_lock(&global_stack_lock);
+            filc_object_array_pop_all_from_and_push_to(stack, &global_stack);
+            pas_lock_unlock(&global_stack_lock);
+        }
+        if (!steal_or_finish_round(stack, deadline))
+            break;
+        high_water = pas_max_uintptr(high_water, stack->num_objects);
+    }
+    PAS_ASSERT(!stack->num_objects);
+    note_mark_stack_high_water(high_water);
+}
+
+static void sweep_in_round(filc_object_array* stack, double deadline)
+{
+    PAS_ASSERT(!stack || !stack->num_objects);
+    double slice_start = pas_get_time_in_milliseconds();
+    for (;;) {
+        if (collector_control_request || deadline_has_passed(deadline))
+            return;
+        size_t begin = pas_atomic_exchange_add_uintptr(&sweep_index, 10);
+        if (begin >= sweep_size)
+            return;
+        verse_heap_sweep_range(begin, pas_min_uintptr(begin + 10, sweep_size));
+        throttle_for_duty_cycle(&slice_start);
+    }
+}
+
+/* Runs the task on the collector thread and any helpers that join. Returns once the task has
+   returned on every thread that joined. */
+static void run_round(void (*task)(filc_object_array* stack, double deadline),
+                      filc_object_array* stack)
+{
+    pas_system_mutex_lock(&marker_lock);
+    PAS_ASSERT(!marker_round_is_active);
+    PAS_ASSERT(!num_markers_in_round);
+    marker_round++;
+    marker_round_is_active = true;
+    marker_round_task = task;
+    num_markers_in_round = 1;
+    num_idle_markers = 0;
+    pas_system_condition_broadcast(&marker_cond);
+    pas_system_mutex_unlock(&marker_lock);
+
+    task(stack, PAS_INFINITY);
+
+    pas_system_mutex_lock(&marker_lock);
+    marker_round_is_active = false;
+    PAS_ASSERT(num_markers_in_round);
+    num_markers_in_round--;
+    while (num_markers_in_round)
+        pas_system_condition_wait(&marker_cond, &marker_lock);
+    pas_system_mutex_unlock(&marker_lock);
+}
+
+static void drain_local_stack(void)
+{
+    if (num_marker_threads == 1 && !num_lent_markers) {
+        filc_object* object;
+        size_t high_water = local_stack.num_objects;
+        while (!collector_control_request && (object = filc_object_array_pop(&local_stack))) {
+            fugc_mark_outgoing_ptrs(&local_stack, object);
+            high_water = pas_max_uintptr(high_water, local_stack.num_objects);
+        }
+        note_mark_stack_high_water(high_water);
+        return;
+    }
+
+    run_round(drain_in_round, &local_stack);
+}
+
+static pas_thread_return_type helper_thread(void* arg)
+{
+    PAS_ASSERT(!arg);
+
+    configure_collector_thread();
+
+    filc_object_array stack;
+    filc_object_array_construct(&stack);
+
+    uint64_t last_round = 0;
+    pas_system_mutex_lock(&marker_lock);
+    for (;;) {
+        while (!marker_helpers_should_stop
+               && !(marker_round_is_active && marker_round != last_round))
+            pas_system_condition_wait(&marker_cond, &marker_lock);
+        if (marker_helpers_should_stop)
+            break;
+        /* It's fine to join a round late. When marking, all of the work is either in global_stack
+           or in the stacks of markers that already joined. When sweeping, there may just be
+           nothing left to claim. */
+        last_round = marker_round;
+        void (*task)(filc_object_array* stack, double deadline) = marker_round_task;
+        num_markers_in_round++;
+        pas_system_mutex_unlock(&marker_lock);
+
+        task(&stack, PAS_INFINITY);
+
+        pas_system_mutex_lock(&marker_lock);
+        PAS_ASSERT(num_markers_in_round);
+        num_markers_in_round--;
+        pas_system_condition_broadcast(&marker_cond);
+    }
+    PAS_ASSERT(num_marker_helpers_running);
+    num_marker_helpers_running--;
+    pas_system_condition_broadcast(&marker_cond);
+    pas_system_mutex_unlock(&marker_lock);
+
+    filc_object_array_destruct(&stack);
+    pas_thread_local_cache_destroy(pas_lock_is_not_held);
+    
+    return PAS_THREAD_RETURN_VALUE;
+}
+
+static void defer_unmap(void* ptr, size_t size)
+{
+    if (should_defer_unmap) {
+        pas_system_mutex_lock(&unmapper_lock);
+        if (unmap_queue_tail - unmap_queue_head < UNMAP_QUEUE_SIZE) {
+            pending_unmap* pending = unmap_queue + unmap_queue_tail++ % UNMAP_QUEUE_SIZE;
+            pending->ptr = ptr;
+            pending->size = size;
+            pas_system_condition_broadcast(&unmapper_cond);
+            pas_system_mutex_unlock(&unmapper_lock);
+            return;
+        }
+        pas_system_mutex_unlock(&unmapper_lock);
+    }
+    filc_unmap(ptr, size);
+}
+
+static pas_thread_return_type unmapper_thread(void* arg)
+{
+    PAS_ASSERT(!arg);
+
+    configure_collector_thread();
+
+    pas_system_mutex_lock(&unmapper_lock);
+    for (;;) {
+        if (unmap_queue_head == unmap_queue_tail) {
+            if (unmapper_should_stop)
+                break;
+            pas_system_condition_wait(&unmapper_cond, &unmapper_lock);
+            continue;
+        }
+        pending_unmap pending = unmap_queue[unmap_queue_head++ % UNMAP_QUEUE_SIZE];
+        unmapper_is_unmapping = true;
+        pas_system_mutex_unlock(&unmapper_lock);
+        filc_unmap(pending.ptr, pending.size);
+        pas_system_mutex_lock(&unmapper_lock);
+        unmapper_is_unmapping = false;
+        if (unmap_queue_head == unmap_queue_tail)
+            pas_system_condition_broadcast(&unmapper_cond);
     }
+    PAS_ASSERT(unmapper_is_running);
+    unmapper_is_running = false;
+    pas_system_condition_broadcast(&unmapper_cond);
+    pas_system_mutex_unlock(&unmapper_lock);
+
+    return PAS_THREAD_RETURN_VALUE;
+}
+
+/* Waits for the unmapper to finish all of the unmaps that have been queued so far. */
+static void wait_for_unmapper(void)
+{
+    if (!should_defer_unmap)
+        return;
+    pas_system_mutex_lock(&unmapper_lock);
+    while (unmap_queue_head != unmap_queue_tail || unmapper_is_unmapping)
+        pas_system_condition_wait(&unmapper_cond, &unmapper_lock);
+    pas_system_mutex_unlock(&unmapper_lock);
 }
 
 static void destruct_object_callback(void* allocation, void* arg)
@@ -270,7 +1075,7 @@ static void destruct_object_callback(void* allocation, void* arg)
     if (filc_object_get_flags(object) & FILC_OBJECT_FLAG_MMAP) {
         if (filc_object_get_flags(object) & FILC_OBJECT_FLAG_FREE)
             return;
-        filc_unmap(filc_object_lower(object), filc_object_size(object));
+        defer_unmap(filc_object_lower(object), filc_object_size(object));
         return;
     }
     if (verbose)
@@ -288,12 +1093,101 @@ static void destruct_object_callback(void* allocation, void* arg)
         filc_exact_ptr_table_destruct(
             (filc_exact_ptr_table*)filc_object_special_payload_with_manual_tracking(object));
         break;
+    case FILC_SPECIAL_TYPE_IO_URING:
+        filc_io_uring_destruct(
+            (filc_io_uring*)filc_object_special_payload_with_manual_tracking(object));
+        break;
+    case FILC_SPECIAL_TYPE_WEAK:
+        filc_weak_destruct((filc_weak*)filc_object_special_payload_with_manual_tracking(object));
+        break;
+    case FILC_SPECIAL_TYPE_ARENA:
+        filc_arena_destruct((filc_arena*)filc_object_special_payload_with_manual_tracking(object));
+        break;
+    case FILC_SPECIAL_TYPE_FIBER:
+        filc_fiber_destruct((filc_fiber*)filc_object_special_payload_with_manual_tracking(object));
+        break;
     default:
         PAS_ASSERT(!"Encountered object in destructor space that should not have destructor.");
         break;
     }
 }
 
+static void destruct_in_round(filc_object_array* stack, double deadline)
+{
+    PAS_ASSERT(!stack || !stack->num_objects);
+    double slice_start = pas_get_time_in_milliseconds();
+    for (;;) {
+        if (collector_control_request || deadline_has_passed(deadline))
+            return;
+        size_t begin = pas_atomic_exchange_add_uintptr(&destruct_index, 10);
+        if (begin >= destruct_size)
+            return;
+        verse_heap_object_set_iterate_range_inline(
+            filc_destructor_set, begin, pas_min_uintptr(begin + 10, destruct_size),
+            verse_heap_iterate_unmarked, destruct_object_callback, NULL);
+        throttle_for_duty_cycle(&slice_start);
+    }
+}
+
+static void help_soft_handshake_in_round(filc_object_array* stack, double deadline)
+{
+    PAS_ASSERT(!stack || !stack->num_objects);
+    PAS_UNUSED_PARAM(deadline);
+    /* Lent markers are mutator threads, and those only run their own callbacks. Everyone else has
+       to finish what they claim, even past a deadline or a control request, since the handshake
+       cannot end until the callbacks of exited threads have run. */
+    if (filc_get_my_thread())
+        return;
+    filc_soft_handshake_help();
+}
+
+/* With 10k mostly-exited threads, running their callbacks (which for marking means scanning their
+   stacks) is most of the handshake, so the helpers split it up. */
+static void help_soft_handshake(void)
+{
+    run_round(help_soft_handshake_in_round, NULL);
+}
+
+static void soft_handshake(void (*callback)(filc_thread* my_thread, void* arg))
+{
+    double start_time = pas_get_time_in_milliseconds();
+    filc_soft_handshake_with_helpers(
+        callback, NULL, num_marker_threads == 1 ? NULL : help_soft_handshake);
+    double duration = pas_get_time_in_milliseconds() - start_time;
+
+    size_t bucket = 0;
+    double limit = 1. / 1000.;
+    while (bucket < FUGC_STATS_NUM_HANDSHAKE_BUCKETS - 1 && duration >= limit) {
+        bucket++;
+        limit *= 2.;
+    }
+    pas_system_mutex_lock(&collector_thread_state_lock);
+    stats.handshake_histogram[bucket]++;
+    stats.num_handshakes++;
+    stats.total_handshake_time += duration;
+    if (duration > stats.max_handshake_time)
+        stats.max_handshake_time = duration;
+    pas_system_mutex_unlock(&collector_thread_state_lock);
+}
+
+static void reclaim_idle_caches(void)
+{
+    if (verbose >= VERBOSE_PHASES) {
+        pas_log("[%d] fugc: reclaiming idle thread caches with %zu live bytes.\n",
+                pas_getpid(), verse_heap_live_bytes);
+    }
+    found_idle_cache_candidates = false;
+    did_reclaim_idle_caches = false;
+    soft_handshake(reclaim_idle_caches_pollcheck_callback);
+    live_bytes_at_last_cache_reclaim = verse_heap_live_bytes;
+
+    /* The pages that the stopped allocators were holding are now free for the scavenger to
+       decommit, and so are the parts of the thread local caches that held those allocators. Don't
+       wait for the scavenger to notice on its own. */
+    if (did_reclaim_idle_caches && pas_scavenger_did_create_eligible())
+        pas_scavenger_notify_eligibility_if_needed();
+}
+
 static void wait_and_start_marking(void)
 {
     PAS_ASSERT(!filc_is_marking);
@@ -306,27 +1200,57 @@ static void wait_and_start_marking(void)
     }
     
     while (completed_cycle == requested_cycle
-           && verse_heap_live_bytes < verse_heap_live_bytes_trigger_threshold) {
+           && verse_heap_live_bytes < verse_heap_live_bytes_trigger_threshold
+           && !__atomic_load_n(&remembered_set_is_full, __ATOMIC_RELAXED)) {
+        /* If anyone allocated since we last looked, then some threads may have warmed up their
+           caches and then blocked. If the last pass found threads that had just exited, then we
+           need another pass to see if they stayed that way. */
+        double reclaim_deadline = PAS_INFINITY;
+        if (idle_cache_reclaim_period
+            && (verse_heap_live_bytes != live_bytes_at_last_cache_reclaim
+                || found_idle_cache_candidates))
+            reclaim_deadline = pas_get_time_in_milliseconds() + idle_cache_reclaim_period;
+        double wait_deadline = reclaim_deadline;
+        if (is_generational) {
+            double poll_deadline = pas_get_time_in_milliseconds() + REMEMBERED_SET_POLL_PERIOD;
+            if (poll_deadline < wait_deadline)
+                wait_deadline = poll_deadline;
+        }
+        
         pas_system_mutex_lock(&collector_thread_state_lock);
         PAS_ASSERT(completed_cycle <= requested_cycle);
         while (completed_cycle == requested_cycle
                && verse_heap_live_bytes < verse_heap_live_bytes_trigger_threshold
-               && !collector_control_request)
-            pas_system_condition_wait(&collector_thread_state_cond, &collector_thread_state_lock);
+               && !__atomic_load_n(&remembered_set_is_full, __ATOMIC_RELAXED)
+               && !collector_control_request
+               && !deadline_has_passed(wait_deadline)) {
+            if (wait_deadline == PAS_INFINITY) {
+                pas_system_condition_wait(
+                    &collector_thread_state_cond, &collector_thread_state_lock);
+            } else {
+                pas_system_condition_timed_wait(
+                    &collector_thread_state_cond, &collector_thread_state_lock, wait_deadline);
+            }
+        }
         pas_system_mutex_unlock(&collector_thread_state_lock);
         
         if (collector_control_request)
             return;
+
+        if (deadline_has_passed(reclaim_deadline))
+            reclaim_idle_caches();
         
         PAS_ASSERT(completed_cycle <= requested_cycle);
     }
 
-    if (verbose >= VERBOSE_CYCLES)
-        overall_start_time = pas_get_time_in_milliseconds();
+    overall_start_time = pas_get_time_in_milliseconds();
 
     if (should_stop_the_world)
         filc_stop_the_world();
     
+    /* This cycle drains whatever got remembered so far. */
+    __atomic_store_n(&remembered_set_is_full, false, __ATOMIC_RELAXED);
+
     pas_system_mutex_lock(&collector_thread_state_lock);
     PAS_ASSERT(completed_cycle <= requested_cycle);
     if (completed_cycle == requested_cycle)
@@ -334,28 +1258,55 @@ static void wait_and_start_marking(void)
     PAS_ASSERT(completed_cycle <= requested_cycle);
     pas_system_mutex_unlock(&collector_thread_state_lock);
 
+    if (should_stop_the_world && should_lend_stopped_mutators) {
+        pas_system_mutex_lock(&marker_lock);
+        stopped_cycle = completed_cycle + 1;
+        pas_system_condition_broadcast(&marker_cond);
+        pas_system_mutex_unlock(&marker_lock);
+    }
+
     PAS_ASSERT(live_bytes_at_start == SIZE_MAX);
+    verse_heap_fold_live_bytes();
     live_bytes_at_start = verse_heap_live_bytes;
+    FILC_PROBE3(wait_and_start_marking, completed_cycle + 1, current_cycle_is_full,
+                live_bytes_at_start);
 
     if (verbose >= VERBOSE_PHASES) {
-        pas_log("[%d] fugc: starting cycle %" PRIu64 " with %zu live bytes\n",
-                pas_getpid(), completed_cycle + 1, live_bytes_at_start);
+        pas_log("[%d] fugc: starting %s cycle %" PRIu64 " with %zu live bytes\n",
+                pas_getpid(), current_cycle_is_full ? "full" : "young", completed_cycle + 1,
+                live_bytes_at_start);
     } else if (verbose >= VERBOSE_BEGIN) {
-        pas_log("[%d] fugc: starting cycle %" PRIu64 " with %zu kb\n",
-                pas_getpid(), completed_cycle + 1, live_bytes_at_start / 1024);
+        pas_log("[%d] fugc: starting %s cycle %" PRIu64 " with %zu kb\n",
+                pas_getpid(), current_cycle_is_full ? "full" : "young", completed_cycle + 1,
+                live_bytes_at_start / 1024);
     }
 
-    verse_heap_mark_bits_page_commit_controller_lock();
+    /* In generational mode, the mark bits stay live between cycles, so we only lock the commit
+       controller once. */
+    if (!verse_heap_mark_bits_page_commit_controller_is_locked)
+        verse_heap_mark_bits_page_commit_controller_lock();
+    /* This has to happen before the handshake so that every marker sees that we're recording. */
+    filc_heap_snapshot_start_cycle(completed_cycle + 1, current_cycle_is_full);
+    filc_heap_composition_start_cycle(completed_cycle + 1, current_cycle_is_full);
+    filc_stack_scan_epoch++;
+    PAS_ASSERT(filc_stack_scan_epoch);
     filc_is_marking = true;
-    filc_soft_handshake(no_op_pollcheck_callback, NULL);
+    filc_store_barrier_is_on = true;
+    soft_handshake(no_op_pollcheck_callback);
     
     verse_heap_start_allocating_black_before_handshake();
-    filc_soft_handshake(stop_allocators_pollcheck_callback, NULL);
+    soft_handshake(start_allocating_black_pollcheck_callback);
 
     filc_object_array_construct(&local_stack);
     /* FIXME: You could imagine this being a place we can suspend. */
-    filc_mark_global_roots(&local_stack);
+    filc_mark_global_roots(&local_stack, !current_cycle_is_full && !should_rescan_all_globals);
+
+    pas_lock_lock(&empty_aux_candidates_lock);
+    PAS_ASSERT(!empty_aux_candidates.num_objects);
+    is_collecting_empty_aux_candidates = should_detach_empty_auxes;
+    pas_lock_unlock(&empty_aux_candidates_lock);
 
+    filc_should_assist_marking = !!filc_mark_assist_budget;
     current_collector_state = collector_marking;
 }
 
@@ -367,36 +1318,51 @@ static void mark_and_start_destructing(void)
     PAS_ASSERT(filc_is_marking);
     PAS_ASSERT(current_collector_state == collector_marking);
 
+    double slice_start = pas_get_time_in_milliseconds();
     for (;;) {
-        filc_soft_handshake(marking_pollcheck_callback, NULL);
+        soft_handshake(marking_pollcheck_callback);
+        throttle_for_duty_cycle(&slice_start);
         
         pas_lock_lock(&global_stack_lock);
         filc_object_array_pop_all_from_and_push_to(&global_stack, &local_stack);
         pas_lock_unlock(&global_stack_lock);
         
-        if (!local_stack.num_objects)
-            break;
+        if (!local_stack.num_objects) {
+            /* Weak gets might have barriered something since the handshake, so once we've frozen
+               the weaks we have to go around one more time. */
+            if (froze_weaks || !filc_freeze_weaks())
+                break;
+            froze_weaks = true;
+            continue;
+        }
         
-        filc_object* object;
-        while (!collector_control_request && (object = filc_object_array_pop(&local_stack)))
-            mark_outgoing_ptrs(&local_stack, object);
+        drain_local_stack();
 
         if (collector_control_request)
             return;
     }
+
+    filc_should_assist_marking = false;
+    filc_heap_snapshot_finish_cycle();
+    filc_heap_composition_finish_cycle();
+    detach_empty_auxes();
+    filc_clear_dead_weaks();
+    froze_weaks = false;
     
     filc_is_marking = false;
+    if (!is_generational)
+        filc_store_barrier_is_on = false;
     
-    if (verbose >= VERBOSE_CYCLES)
-        mark_end_time = pas_get_time_in_milliseconds();
+    mark_end_time = pas_get_time_in_milliseconds();
 
     PAS_ASSERT(destruct_size == SIZE_MAX);
     PAS_ASSERT(destruct_index == SIZE_MAX);
     verse_heap_object_set_start_iterate_before_handshake(filc_destructor_set);
-    filc_soft_handshake(after_marking_pollcheck_callback, NULL);
+    soft_handshake(after_marking_pollcheck_callback);
     destruct_size = verse_heap_object_set_start_iterate_after_handshake(filc_destructor_set);
     destruct_index = 0;
 
+    FILC_PROBE2(mark_and_start_destructing, completed_cycle + 1, verse_heap_live_bytes);
     current_collector_state = collector_destructing;
 }
 
@@ -410,13 +1376,15 @@ static void destruct_and_start_sweeping(void)
     PAS_ASSERT(!filc_is_marking);
     PAS_ASSERT(current_collector_state == collector_destructing);
 
-    for (; destruct_index < destruct_size; destruct_index += 10) {
-        if (collector_control_request)
-            return;
-        size_t next_destruct_index = pas_min_uintptr(destruct_index + 10, destruct_size);
-        verse_heap_object_set_iterate_range_inline(
-            filc_destructor_set, destruct_index, next_destruct_index,
-            verse_heap_iterate_unmarked, destruct_object_callback, NULL);
+    if (num_marker_threads == 1 && !num_lent_markers)
+        destruct_in_round(NULL, PAS_INFINITY);
+    else
+        run_round(destruct_in_round, NULL);
+
+    /* Same as for sweeping: everything claimed got destructed. */
+    if (destruct_index < destruct_size) {
+        PAS_ASSERT(collector_control_request);
+        return;
     }
 
     destruct_index = SIZE_MAX;
@@ -424,14 +1392,32 @@ static void destruct_and_start_sweeping(void)
 
     verse_heap_object_set_end_iterate(filc_destructor_set);
 
+    destruct_end_time = pas_get_time_in_milliseconds();
+
     PAS_ASSERT(live_bytes_before_sweeping == SIZE_MAX);
+    verse_heap_fold_live_bytes();
     live_bytes_before_sweeping = verse_heap_live_bytes;
 
-    verse_heap_start_sweep_before_handshake();
-    filc_soft_handshake(stop_allocators_pollcheck_callback, NULL);
-    PAS_ASSERT(!global_stack.num_objects);
+    /* These have to happen before the sweep can reuse the memory of dead objects. */
+    filc_heap_profiler_prune_dead();
+    filc_alloc_trace_record_dead();
+
+    /* The sweep frees the ranges of dead mmap objects, so they have to be unmapped by then. */
+    wait_for_unmapper();
+
+    if (!current_cycle_is_full)
+        num_young_cycles_since_full++;
+    if (is_generational && num_young_cycles_since_full < young_cycles_per_full
+        && !filc_heap_snapshot_is_pending() && !filc_heap_composition_is_pending())
+        verse_heap_start_sticky_sweep_before_handshake();
+    else
+        verse_heap_start_sweep_before_handshake();
+    soft_handshake(stop_allocators_pollcheck_callback);
+    /* In generational mode, mutators may start donating again once the sweep lets them allocate
+       white (threads that exit donate, for example). Those objects are marked, so they survive the
+       sweep, and they stay in global_stack so that the next cycle traces them. */
+    PAS_ASSERT(is_generational || !global_stack.num_objects);
     PAS_ASSERT(!local_stack.num_objects);
-    filc_object_array_reset(&global_stack);
     filc_object_array_destruct(&local_stack);
 
     PAS_ASSERT(sweep_size == SIZE_MAX);
@@ -439,32 +1425,115 @@ static void destruct_and_start_sweeping(void)
     sweep_size = verse_heap_start_sweep_after_handshake();
     sweep_index = 0;
 
+    FILC_PROBE3(destruct_and_start_sweeping, completed_cycle + 1, live_bytes_before_sweeping,
+                sweep_size);
     current_collector_state = collector_sweeping;
 }
 
+static size_t heap_goal(size_t surviving_bytes)
+{
+    size_t goal;
+    if (target_heap_size)
+        goal = target_heap_size;
+    else {
+        double proposed_goal = (double)surviving_bytes * (1. + growth_percent / 100.);
+        if (proposed_goal >= (double)SIZE_MAX)
+            goal = SIZE_MAX;
+        else
+            goal = (size_t)proposed_goal;
+    }
+    goal = pas_min_uintptr(goal, memory_limit);
+    return pas_max_uintptr(goal, minimum_threshold);
+}
+
+static size_t compute_trigger_threshold(size_t surviving_bytes, size_t floated_bytes,
+                                        size_t collected_bytes, double duration)
+{
+    static const double smoothing = 0.5;
+    
+    if (duration < 0.001)
+        duration = 0.001;
+    double allocation_rate = floated_bytes / duration;
+    double collection_rate = collected_bytes / duration;
+    if (!collection_rate_estimate) {
+        allocation_rate_estimate = allocation_rate;
+        collection_rate_estimate = collection_rate;
+    } else {
+        allocation_rate_estimate =
+            smoothing * allocation_rate + (1. - smoothing) * allocation_rate_estimate;
+        collection_rate_estimate =
+            smoothing * collection_rate + (1. - smoothing) * collection_rate_estimate;
+    }
+
+    size_t goal = heap_goal(surviving_bytes);
+    size_t headroom = goal > surviving_bytes ? goal - surviving_bytes : 0;
+
+    /* The next cycle will have to deal with a heap of about goal bytes, during which time the
+       mutator will allocate the runway. */
+    double runway = 0;
+    if (collection_rate_estimate > 0)
+        runway = allocation_rate_estimate * ((double)goal / collection_rate_estimate);
+
+    /* Always leave the mutator some fraction of the headroom, so that a bad estimate doesn't make
+       us collect back-to-back. If we're over the memory limit, the headroom is zero and we will
+       collect back-to-back, which is the best we can do. */
+    size_t min_runway_left = headroom / 4;
+    size_t trigger;
+    if (runway >= (double)(headroom - min_runway_left))
+        trigger = surviving_bytes + min_runway_left;
+    else
+        trigger = goal - (size_t)runway;
+
+    if (verbose >= VERBOSE_PHASES) {
+        pas_log("[%d] fugc: pacer: goal %zu bytes, runway %.0lf bytes, trigger %zu bytes "
+                "(allocating %.0lf bytes/ms, collecting %.0lf bytes/ms)\n",
+                pas_getpid(), goal, runway, trigger, allocation_rate_estimate,
+                collection_rate_estimate);
+    }
+    
+    return pas_max_uintptr(trigger, minimum_threshold);
+}
+
 static void sweep_and_end(void)
 {
-    if (verbose >= VERBOSE_PHASES)
-        pas_log("[%d] fugc: sweeping\n", pas_getpid());
+    if (verbose >= VERBOSE_PHASES) {
+        pas_log("[%d] fugc: destructing took %lf ms; sweeping\n",
+                pas_getpid(), destruct_end_time - mark_end_time);
+    }
 
     PAS_ASSERT(!filc_is_marking);
     PAS_ASSERT(current_collector_state == collector_sweeping);
     
-    for (; sweep_index < sweep_size; sweep_index += 10) {
-        if (collector_control_request)
-            return;
-        size_t next_sweep_index = pas_min_uintptr(sweep_index + 10, sweep_size);
-        verse_heap_sweep_range(sweep_index, next_sweep_index);
+    if (num_marker_threads == 1 && !num_lent_markers)
+        sweep_in_round(NULL, PAS_INFINITY);
+    else
+        run_round(sweep_in_round, NULL);
+
+    /* All claimed chunks have been swept, so if we haven't claimed everything then we must have
+       stopped for a control request. */
+    if (sweep_index < sweep_size) {
+        PAS_ASSERT(collector_control_request);
+        return;
     }
 
     sweep_index = SIZE_MAX;
     sweep_size = SIZE_MAX;
+
+    /* A sticky sweep means that the next cycle only has to deal with young objects. Otherwise, all
+       of the mark bits are clear and the next cycle is a full one. */
+    bool cycle_was_full = current_cycle_is_full;
+    current_cycle_is_full = !verse_heap_sweep_is_sticky;
+    if (current_cycle_is_full)
+        num_young_cycles_since_full = 0;
     
     verse_heap_end_sweep();
-    verse_heap_mark_bits_page_commit_controller_unlock();
+    if (!is_generational)
+        verse_heap_mark_bits_page_commit_controller_unlock();
+    verse_heap_fold_live_bytes();
     
     pas_system_mutex_lock(&collector_thread_state_lock);
-    completed_cycle++;
+    /* lend_thread_until() reads this without the lock. */
+    __atomic_store_n(&completed_cycle, completed_cycle + 1, __ATOMIC_RELEASE);
     /* It's unusual but possible that we sweep more bytes than we thought were live, because it's
        possible for new objects to be allocated after we snapshot live bytes and then for those to
        be swept. */
@@ -473,24 +1542,31 @@ static void sweep_and_end(void)
         surviving_bytes = 0;
     else
         surviving_bytes = live_bytes_at_start - verse_heap_swept_bytes;
+    overall_end_time = pas_get_time_in_milliseconds();
+    size_t floated_bytes =
+        verse_heap_live_bytes > surviving_bytes ? verse_heap_live_bytes - surviving_bytes : 0;
     if (verbose >= VERBOSE_CYCLES) {
-        overall_end_time = pas_get_time_in_milliseconds();
         if (verbose >= VERBOSE_PHASES) {
-            pas_log("[%d] fugc: destructing and sweeping took %lf ms; completed cycle %" PRIu64
+            pas_log("[%d] fugc: sweeping took %lf ms; completed cycle %" PRIu64
                     " in %lf ms, swept %zu bytes, "
                     "survived %zu bytes, have %zu live bytes\n",
-                    pas_getpid(), overall_end_time - mark_end_time, completed_cycle,
+                    pas_getpid(), overall_end_time - destruct_end_time, completed_cycle,
                     overall_end_time - overall_start_time,
                     verse_heap_swept_bytes, surviving_bytes, verse_heap_live_bytes);
+            pas_log("[%d] fugc: %zu small pages hold %zu kb out of %zu kb, %zu deferred\n",
+                    pas_getpid(), verse_heap_swept_small_pages,
+                    verse_heap_swept_small_page_live_bytes / 1024,
+                    verse_heap_swept_small_page_capacity_bytes / 1024,
+                    verse_heap_deferred_small_pages);
         } else if (verbose >= VERBOSE_BREAKDOWN) {
             pas_log("[%d] fugc: %zu kb -> %zu kb -> %zu kb + %zu kb (floated) in %.3lf ms "
-                    "(%.0lf%% marking)\n",
+                    "(%.0lf%% marking, %.0lf%% destructing)\n",
                     pas_getpid(), live_bytes_at_start / 1024, live_bytes_before_sweeping / 1024,
-                    surviving_bytes / 1024,
-                    verse_heap_live_bytes > surviving_bytes
-                    ? (verse_heap_live_bytes - surviving_bytes) / 1024 : 0,
+                    surviving_bytes / 1024, floated_bytes / 1024,
                     overall_end_time - overall_start_time,
                     100. * (mark_end_time - overall_start_time)
+                    / (overall_end_time - overall_start_time),
+                    100. * (destruct_end_time - mark_end_time)
                     / (overall_end_time - overall_start_time));
         } else {
             pas_log("[%d] fugc: %zu kb -> %zu kb in %.3lf ms\n",
@@ -498,27 +1574,130 @@ static void sweep_and_end(void)
                     overall_end_time - overall_start_time);
         }
     }
+    verse_heap_live_bytes_trigger_threshold = compute_trigger_threshold(
+        surviving_bytes, floated_bytes, live_bytes_at_start, overall_end_time - overall_start_time);
+    stats.num_completed_cycles = completed_cycle;
+    if (!cycle_was_full)
+        stats.num_young_cycles++;
+    stats.last_cycle_time = overall_end_time - overall_start_time;
+    stats.last_mark_time = mark_end_time - overall_start_time;
+    stats.last_destruct_time = destruct_end_time - mark_end_time;
+    stats.last_sweep_time = overall_end_time - destruct_end_time;
+    stats.total_cycle_time += stats.last_cycle_time;
+    stats.total_mark_time += stats.last_mark_time;
+    stats.total_destruct_time += stats.last_destruct_time;
+    stats.total_sweep_time += stats.last_sweep_time;
+    stats.last_survived_bytes = surviving_bytes;
+    stats.last_swept_bytes = verse_heap_swept_bytes;
+    stats.last_floated_bytes = floated_bytes;
+    stats.total_swept_bytes += verse_heap_swept_bytes;
+    stats.last_num_small_pages = verse_heap_swept_small_pages;
+    stats.last_small_page_live_bytes = verse_heap_swept_small_page_live_bytes;
+    stats.last_small_page_capacity_bytes = verse_heap_swept_small_page_capacity_bytes;
+    stats.last_num_deferred_small_pages = verse_heap_deferred_small_pages;
+    /* No markers are running, so we don't have to be atomic here. */
+    stats.last_mark_stack_high_water = mark_stack_high_water;
+    mark_stack_high_water = 0;
+    stats.max_mark_stack_high_water = pas_max_uint64(
+        stats.max_mark_stack_high_water, stats.last_mark_stack_high_water);
     live_bytes_at_start = SIZE_MAX;
     live_bytes_before_sweeping = SIZE_MAX;
-    size_t proposed_threshold = (size_t)(surviving_bytes * 1.5);
-    PAS_ASSERT(proposed_threshold >= surviving_bytes);
-    PAS_ASSERT(!surviving_bytes || proposed_threshold < surviving_bytes * 2);
-    verse_heap_live_bytes_trigger_threshold = pas_max_uintptr(proposed_threshold, minimum_threshold);
     pas_system_condition_broadcast(&collector_thread_state_cond);
     pas_system_mutex_unlock(&collector_thread_state_lock);
 
+    /* Let lent markers know that the cycle is over. */
+    pas_system_mutex_lock(&marker_lock);
+    stopped_cycle = 0;
+    pas_system_condition_broadcast(&marker_cond);
+    pas_system_mutex_unlock(&marker_lock);
+
     if (should_stop_the_world)
         filc_resume_the_world();
 
+    filc_heap_profiler_report(completed_cycle);
+    filc_memory_pressure_did_finish_collection();
+
+    /* This happens after we've told everyone that the cycle is done, so that nobody waits on it. */
+    if (should_zero_large_cache)
+        verse_heap_large_cache_zero(filc_default_heap, zero_large_cache_range);
+
+    FILC_PROBE4(sweep_and_end, completed_cycle, cycle_was_full, surviving_bytes,
+                verse_heap_swept_bytes);
     current_collector_state = collector_waiting;
 }
 
+static void create_thread(pas_thread_return_type (*thread_main)(void* arg))
+{
+    sigset_t fullset;
+    pas_reasonably_fill_sigset(&fullset);
+    sigset_t oldset;
+    PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &oldset));
+    pas_create_detached_thread(thread_main, NULL);
+    PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
+}
+
+static void start_marker_helpers(void)
+{
+    unsigned index;
+    pas_system_mutex_lock(&marker_lock);
+    PAS_ASSERT(!num_marker_helpers_running);
+    marker_helpers_should_stop = false;
+    num_marker_helpers_running = num_marker_threads - 1;
+    pas_system_mutex_unlock(&marker_lock);
+    for (index = num_marker_threads - 1; index--;)
+        create_thread(helper_thread);
+}
+
+static void stop_marker_helpers(void)
+{
+    pas_system_mutex_lock(&marker_lock);
+    PAS_ASSERT(!marker_round_is_active);
+    marker_helpers_should_stop = true;
+    pas_system_condition_broadcast(&marker_cond);
+    while (num_marker_helpers_running)
+        pas_system_condition_wait(&marker_cond, &marker_lock);
+    pas_system_mutex_unlock(&marker_lock);
+}
+
+static void start_unmapper(void)
+{
+    if (!should_defer_unmap)
+        return;
+    pas_system_mutex_lock(&unmapper_lock);
+    PAS_ASSERT(!unmapper_is_running);
+    unmapper_should_stop = false;
+    unmapper_is_running = true;
+    pas_system_mutex_unlock(&unmapper_lock);
+    create_thread(unmapper_thread);
+}
+
+/* Waits for the unmapper to finish all queued unmaps. */
+static void stop_unmapper(void)
+{
+    if (!should_defer_unmap)
+        return;
+    pas_system_mutex_lock(&unmapper_lock);
+    unmapper_should_stop = true;
+    pas_system_condition_broadcast(&unmapper_cond);
+    while (unmapper_is_running)
+        pas_system_condition_wait(&unmapper_cond, &unmapper_lock);
+    PAS_ASSERT(unmap_queue_head == unmap_queue_tail);
+    pas_system_mutex_unlock(&unmapper_lock);
+}
+
 static pas_thread_return_type collector_thread(void* arg)
 {
     PAS_ASSERT(!arg);
     
     PAS_ASSERT(collector_thread_is_running);
 
+    configure_collector_thread();
+
+    /* The helpers and the unmapper are owned by the collector thread so that they go away when we
+       suspend for fork(). */
+    start_marker_helpers();
+    start_unmapper();
+
     while (!(collector_control_request & COLLECTOR_CONTROL_REQUEST_SUSPEND)) {
         if ((collector_control_request & COLLECTOR_CONTROL_REQUEST_HANDSHAKE)) {
             pas_system_mutex_lock(&collector_thread_state_lock);
@@ -543,6 +1722,9 @@ static pas_thread_return_type collector_thread(void* arg)
         PAS_ASSERT(!"Invalid collector state");
     }
 
+    stop_marker_helpers();
+    stop_unmapper();
+
     pas_thread_local_cache_destroy(pas_lock_is_not_held);
 
     pas_system_mutex_lock(&collector_thread_state_lock);
@@ -560,14 +1742,129 @@ static void trigger_callback(void)
     pas_system_mutex_unlock(&collector_thread_state_lock);
 }
 
-static void create_thread(void)
+/* Returns SIZE_MAX if there is no cgroup memory limit. */
+static size_t cgroup_memory_limit(void)
 {
-    sigset_t fullset;
-    pas_reasonably_fill_sigset(&fullset);
-    sigset_t oldset;
-    PAS_ASSERT(!pthread_sigmask(SIG_BLOCK, &fullset, &oldset));
-    pas_create_detached_thread(collector_thread, NULL);
-    PAS_ASSERT(!pthread_sigmask(SIG_SETMASK, &oldset, NULL));
+    static const char* const paths[] = {
+        "/sys/fs/cgroup/memory.max",
+        "/sys/fs/cgroup/memory/memory.limit_in_bytes"
+    };
+    size_t index;
+    for (index = 0; index < sizeof(paths) / sizeof(paths[0]); ++index) {
+        int fd = open(paths[index], O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        char buf[64];
+        ssize_t result = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (result <= 0)
+            continue;
+        buf[result] = 0;
+        size_t limit;
+        /* cgroup v2 says "max" when there is no limit, and cgroup v1 uses some huge number. */
+        if (sscanf(buf, "%zu", &limit) == 1 && limit < ((size_t)1 << 60))
+            return limit;
+        return SIZE_MAX;
+    }
+    return SIZE_MAX;
+}
+
+/* Returns the number of cores that the cgroup's CPU quota adds up to, rounded up, or zero if there
+   is no quota. */
+static unsigned cgroup_cpu_limit(void)
+{
+    char buf[64];
+    long long quota;
+    long long period;
+    int fd = open("/sys/fs/cgroup/cpu.max", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t result = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (result <= 0)
+            return 0;
+        buf[result] = 0;
+        /* cgroup v2 says "max 100000" when there is no quota. */
+        if (sscanf(buf, "%lld %lld", &quota, &period) != 2)
+            return 0;
+    } else {
+        static const char* const paths[] = {
+            "/sys/fs/cgroup/cpu/cpu.cfs_quota_us",
+            "/sys/fs/cgroup/cpu/cpu.cfs_period_us"
+        };
+        long long values[2];
+        size_t index;
+        for (index = 0; index < 2; ++index) {
+            fd = open(paths[index], O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return 0;
+            ssize_t result = read(fd, buf, sizeof(buf) - 1);
+            close(fd);
+            if (result <= 0)
+                return 0;
+            buf[result] = 0;
+            if (sscanf(buf, "%lld", values + index) != 1)
+                return 0;
+        }
+        /* cgroup v1 says -1 when there is no quota. */
+        quota = values[0];
+        period = values[1];
+    }
+    if (quota <= 0 || period <= 0)
+        return 0;
+    return (unsigned)pas_max_uint64((uint64_t)((quota + period - 1) / period), 1);
+}
+
+static void parse_cpu_affinity_env(void)
+{
+    char* value = getenv("FUGC_CPU_AFFINITY");
+    if (!value)
+        return;
+    CPU_ZERO(&cpu_affinity);
+    char* cursor = value;
+    for (;;) {
+        char* end;
+        unsigned long first;
+        unsigned long last;
+        if (*cursor < '0' || *cursor > '9')
+            goto invalid;
+        first = strtoul(cursor, &end, 10);
+        cursor = end;
+        last = first;
+        if (*cursor == '-') {
+            cursor++;
+            if (*cursor < '0' || *cursor > '9')
+                goto invalid;
+            last = strtoul(cursor, &end, 10);
+            cursor = end;
+        }
+        if (first > last || last >= CPU_SETSIZE)
+            goto invalid;
+        for (; first <= last; ++first)
+            CPU_SET(first, &cpu_affinity);
+        if (!*cursor)
+            break;
+        if (*cursor != ',')
+            goto invalid;
+        cursor++;
+    }
+    has_cpu_affinity = true;
+    return;
+
+invalid:
+    pas_panic("invalid environment variable FUGC_CPU_AFFINITY value: %s (expected list of CPUs "
+              "like 0-3,8)\n", value);
+}
+
+static void parse_nice_env(void)
+{
+    char* value = getenv("FUGC_NICE");
+    if (!value)
+        return;
+    if (sscanf(value, "%d", &nice_value) != 1 || nice_value < -20 || nice_value > 19) {
+        pas_panic("invalid environment variable FUGC_NICE value: %s (expected nice value from "
+                  "-20 to 19)\n", value);
+    }
+    has_nice = true;
 }
 
 void fugc_initialize(void)
@@ -576,21 +1873,67 @@ void fugc_initialize(void)
     pas_system_condition_construct(&collector_thread_state_cond);
     filc_object_array_construct(&global_stack);
     pas_lock_construct(&global_stack_lock);
+    filc_object_array_construct(&empty_aux_candidates);
+    pas_lock_construct(&empty_aux_candidates_lock);
+    pas_system_mutex_construct(&marker_lock);
+    pas_system_condition_construct(&marker_cond);
+    pas_system_mutex_construct(&unmapper_lock);
+    pas_system_condition_construct(&unmapper_cond);
 
     minimum_threshold = filc_get_size_env("FUGC_MIN_THRESHOLD", 1024 * 1024);
+    verse_heap_live_bytes_slack = filc_get_size_env("FUGC_LIVE_BYTES_SLACK", 1024 * 1024);
     verse_heap_live_bytes_trigger_threshold = minimum_threshold;
+    growth_percent = filc_get_unsigned_env("FUGC_GROWTH_PERCENT", 50);
+    idle_trigger_percent = filc_get_unsigned_env("FUGC_IDLE_TRIGGER_PERCENT", 50);
+    idle_cache_reclaim_period = filc_get_unsigned_env("FUGC_IDLE_CACHE_RECLAIM_MS", 1000);
+    target_heap_size = filc_get_size_env("FUGC_TARGET_HEAP_SIZE", 0);
+    memory_limit = filc_get_size_env("FUGC_MEMORY_LIMIT", cgroup_memory_limit());
     verse_heap_live_bytes_trigger_callback = trigger_callback;
 
     verbose = filc_get_unsigned_env("FUGC_VERBOSE", 0);
+    filc_heap_composition_should_log = verbose >= VERBOSE_BREAKDOWN;
     should_stop_the_world = filc_get_bool_env("FUGC_STW", false);
+    should_lend_stopped_mutators = filc_get_bool_env("FUGC_STW_LEND_MUTATORS", false);
+    is_generational = filc_get_bool_env("FUGC_GENERATIONAL", false);
+    young_cycles_per_full = filc_get_unsigned_env("FUGC_YOUNG_CYCLES_PER_FULL", 8);
+    if (is_generational) {
+        filc_remembered_set_limit = pas_max_uintptr(
+            filc_get_size_env("FUGC_REMEMBERED_SET_LIMIT", 1024 * 1024), 1);
+    }
+    should_rescan_all_globals = filc_get_bool_env("FUGC_RESCAN_ALL_GLOBALS", false);
+    parse_cpu_affinity_env();
+    parse_nice_env();
+    duty_cycle_percent = pas_max_uint32(
+        pas_min_uint32(filc_get_unsigned_env("FUGC_DUTY_CYCLE_PERCENT", 100), 100), 1);
+    /* When the world is stopped, the mutators aren't using the other cores, so we might as well,
+       but only the ones that we're allowed to run on. */
+    unsigned default_num_marker_threads = 1;
+    if (should_stop_the_world) {
+        long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (has_cpu_affinity)
+            num_cpus = pas_min_intptr(num_cpus, CPU_COUNT(&cpu_affinity));
+        unsigned cgroup_cpus = cgroup_cpu_limit();
+        if (cgroup_cpus)
+            num_cpus = pas_min_intptr(num_cpus, cgroup_cpus);
+        if (num_cpus > 1)
+            default_num_marker_threads = (unsigned)num_cpus;
+    }
+    num_marker_threads = pas_max_uint32(
+        filc_get_unsigned_env("FUGC_MARKER_THREADS", default_num_marker_threads), 1);
+    should_defer_unmap = filc_get_bool_env("FUGC_DEFER_UNMAP", true);
+    filc_mark_assist_budget = filc_get_size_env("FUGC_MARK_ASSIST_BUDGET", 1024 * 1024);
+    should_detach_empty_auxes = filc_get_bool_env("FUGC_DETACH_AUX", true);
+    should_zero_large_cache = filc_get_bool_env("FUGC_ZERO_LARGE_CACHE", true);
 
     if (verbose >= VERBOSE_PHASES) {
         pas_log("[%d] fugc: initializing GC with %zu live bytes.\n",
                 pas_getpid(), verse_heap_live_bytes);
     }
 
+    open_pagemap();
+
     collector_thread_is_running = true;
-    create_thread();
+    create_thread(collector_thread);
 }
 
 void fugc_suspend(void)
@@ -619,8 +1962,9 @@ void fugc_resume(void)
     PAS_ASSERT(!collector_thread_is_running);
     PAS_ASSERT(collector_control_request & COLLECTOR_CONTROL_REQUEST_SUSPEND);
     collector_control_request &= ~COLLECTOR_CONTROL_REQUEST_SUSPEND;
+    open_pagemap();
     collector_thread_is_running = true;
-    create_thread();
+    create_thread(collector_thread);
     pas_system_mutex_unlock(&collector_thread_state_lock);
 }
 
@@ -645,9 +1989,15 @@ void fugc_donate(filc_object_array* mark_stack)
     if (!mark_stack->num_objects)
         return;
     pas_lock_lock(&global_stack_lock);
-    PAS_ASSERT(filc_is_marking);
+    PAS_ASSERT(filc_store_barrier_is_on);
     filc_object_array_pop_all_from_and_push_to(mark_stack, &global_stack);
+    bool global_stack_is_full = global_stack.num_objects >= filc_remembered_set_limit;
     pas_lock_unlock(&global_stack_lock);
+
+    /* Between cycles in generational mode, nobody drains global_stack, so don't let it grow
+       without bound. If a cycle is already running, it will take care of what we donated. */
+    if (global_stack_is_full)
+        __atomic_store_n(&remembered_set_is_full, true, __ATOMIC_RELAXED);
 }
 
 static uint64_t request_impl(uint64_t offset)
@@ -681,6 +2031,91 @@ void fugc_wait(uint64_t cycle)
     pas_system_mutex_unlock(&collector_thread_state_lock);
 }
 
+/* Joins marking, destructing, and sweeping rounds until either the given cycle completes or the
+   deadline passes. */
+static void lend_thread_until(uint64_t cycle, double deadline)
+{
+    filc_object_array stack;
+    filc_object_array_construct(&stack);
+
+    uint64_t last_round = 0;
+    pas_system_mutex_lock(&marker_lock);
+    num_lent_markers++;
+    /* completed_cycle is protected by collector_thread_state_lock, and we don't want to nest that
+       inside marker_lock, so we read it with acquire. The collector broadcasts marker_cond after it
+       bumps completed_cycle. */
+    while (__atomic_load_n(&completed_cycle, __ATOMIC_ACQUIRE) < cycle
+           && !deadline_has_passed(deadline)) {
+        if (!marker_round_is_active || marker_round == last_round) {
+            pas_system_condition_timed_wait(&marker_cond, &marker_lock, deadline);
+            continue;
+        }
+        last_round = marker_round;
+        void (*task)(filc_object_array* stack, double deadline) = marker_round_task;
+        num_markers_in_round++;
+        pas_system_mutex_unlock(&marker_lock);
+
+        task(&stack, deadline);
+        PAS_ASSERT(!stack.num_objects);
+
+        pas_system_mutex_lock(&marker_lock);
+        leave_round_early();
+    }
+    PAS_ASSERT(num_lent_markers);
+    num_lent_markers--;
+    pas_system_mutex_unlock(&marker_lock);
+
+    filc_object_array_destruct(&stack);
+}
+
+bool fugc_hint_idle(double budget_milliseconds)
+{
+    double deadline = pas_get_time_in_milliseconds() + budget_milliseconds;
+    
+    pas_system_mutex_lock(&collector_thread_state_lock);
+    PAS_ASSERT(completed_cycle <= requested_cycle);
+    if (completed_cycle == requested_cycle
+        && (double)verse_heap_live_bytes
+        >= (double)verse_heap_live_bytes_trigger_threshold * idle_trigger_percent / 100.) {
+        requested_cycle++;
+        pas_system_condition_broadcast(&collector_thread_state_cond);
+    }
+    uint64_t cycle = requested_cycle;
+    bool is_done = completed_cycle >= cycle;
+    pas_system_mutex_unlock(&collector_thread_state_lock);
+
+    if (is_done)
+        return true;
+
+    lend_thread_until(cycle, deadline);
+
+    pas_system_mutex_lock(&collector_thread_state_lock);
+    is_done = completed_cycle >= cycle;
+    pas_system_mutex_unlock(&collector_thread_state_lock);
+    return is_done;
+}
+
+void fugc_get_stats(fugc_stats* result)
+{
+    pas_system_mutex_lock(&collector_thread_state_lock);
+    *result = stats;
+    pas_system_mutex_unlock(&collector_thread_state_lock);
+    verse_heap_fold_live_bytes();
+    result->live_bytes = verse_heap_live_bytes;
+    result->trigger_threshold = verse_heap_live_bytes_trigger_threshold;
+}
+
+void fugc_lend_stopped_thread(void)
+{
+    if (!should_lend_stopped_mutators)
+        return;
+    pas_system_mutex_lock(&marker_lock);
+    uint64_t cycle = stopped_cycle;
+    pas_system_mutex_unlock(&marker_lock);
+    if (cycle)
+        lend_thread_until(cycle, PAS_INFINITY);
+}
+
 bool fugc_is_stw(void)
 {
     return should_stop_the_world;
@@ -689,8 +2124,36 @@ bool fugc_is_stw(void)
 void fugc_dump_setup(void)
 {
     pas_log("    fugc minimum threshold: %zu\n", minimum_threshold);
+    pas_log("    fugc live bytes slack: %zu\n", verse_heap_live_bytes_slack);
+    pas_log("    fugc growth percent: %u\n", growth_percent);
+    pas_log("    fugc idle trigger percent: %u\n", idle_trigger_percent);
+    pas_log("    fugc idle cache reclaim period: %u ms\n", idle_cache_reclaim_period);
+    if (target_heap_size)
+        pas_log("    fugc target heap size: %zu\n", target_heap_size);
+    if (memory_limit != SIZE_MAX)
+        pas_log("    fugc memory limit: %zu\n", memory_limit);
     pas_log("    fugc verbose level: %u\n", verbose);
     pas_log("    fugc stop the world: %s\n", should_stop_the_world ? "yes" : "no");
+    if (should_stop_the_world)
+        pas_log("    fugc lend stopped mutators: %s\n",
+                should_lend_stopped_mutators ? "yes" : "no");
+    pas_log("    fugc marker threads: %u\n", num_marker_threads);
+    if (has_cpu_affinity)
+        pas_log("    fugc cpu affinity: %s\n", getenv("FUGC_CPU_AFFINITY"));
+    if (has_nice)
+        pas_log("    fugc nice: %d\n", nice_value);
+    pas_log("    fugc duty cycle percent: %u\n", duty_cycle_percent);
+    pas_log("    fugc defer unmap: %s\n", should_defer_unmap ? "yes" : "no");
+    pas_log("    fugc mark assist budget: %zu\n", filc_mark_assist_budget);
+    pas_log("    fugc detach empty aux: %s\n", should_detach_empty_auxes ? "yes" : "no");
+    pas_log("    fugc zero large cache: %s\n", should_zero_large_cache ? "yes" : "no");
+    pas_log("    fugc sparse aux scanning: %s\n", pagemap_fd >= 0 ? "yes" : "no");
+    pas_log("    fugc generational: %s\n", is_generational ? "yes" : "no");
+    if (is_generational) {
+        pas_log("    fugc young cycles per full: %u\n", young_cycles_per_full);
+        pas_log("    fugc remembered set limit: %zu\n", filc_remembered_set_limit);
+        pas_log("    fugc rescan all globals: %s\n", should_rescan_all_globals ? "yes" : "no");
+    }
 }
 
 #endif /* PAS_ENABLE_FILC */
@@ -26,6 +26,7 @@
 #ifndef FUGC_H
 #define FUGC_H
 
+#include "filc_heap_composition.h"
 #include "filc_runtime.h"
 #include "verse_heap.h"
 
@@ -60,8 +61,15 @@ static PAS_ALWAYS_INLINE void fugc_mark(filc_object_array* mark_stack, filc_obje
         pas_log("for object %p mark_base = %p\n", object, mark_base);
     if (!verse_heap_set_is_marked_relaxed(mark_base, true))
         return;
+    if (PAS_UNLIKELY(filc_heap_composition_is_recording))
+        filc_heap_composition_record_object(object, mark_base, aux);
     /* FIXME: We could tell by looking at the special type whether it needs to be pushed. For example,
-       functions do not need to be pushed. */
+       functions do not need to be pushed.
+       
+       Objects that never had a ptr stored into them have no aux, so they get marked but never
+       pushed. That's what makes byte buffers and numeric arrays free to trace. We don't need a
+       separate heap for pointer-free allocations to get that, and we couldn't have one anyway,
+       since C lets any memory hold ptrs no matter what type it was allocated with. */
     if (filc_aux_get_ptr(aux) || (flags & FILC_OBJECT_FLAGS_SPECIAL_MASK))
         filc_object_array_push(mark_stack, object);
 }
@@ -79,6 +87,8 @@ static PAS_ALWAYS_INLINE void fugc_mark_or_free_flight(filc_object_array* mark_s
         }
         if (object == &filc_free_singleton)
             return;
+        if (PAS_UNLIKELY(filc_heap_composition_is_recording))
+            filc_heap_composition_record_freed(object);
         if (filc_flight_ptr_unfenced_unbarriered_weak_cas_lower(
                 ptr, lower, filc_object_lower_not_null((filc_object*)&filc_free_singleton)))
             return;
@@ -117,7 +127,9 @@ static PAS_ALWAYS_INLINE void fugc_mark_or_free_lower_or_box(filc_object_array*
                But if it's stored into the aux, then we'll find it here, and we'll see that it's
                marked already. And we need to mark whatever it points at even though the box is
                marked! */
-            verse_heap_set_is_marked_relaxed(box, true);
+            if (verse_heap_set_is_marked_relaxed(box, true)
+                && PAS_UNLIKELY(filc_heap_composition_is_recording))
+                filc_heap_composition_record_box(box);
             fugc_mark_or_free_flight(mark_stack, &box->ptr);
             return;
         }
@@ -129,6 +141,8 @@ static PAS_ALWAYS_INLINE void fugc_mark_or_free_lower_or_box(filc_object_array*
         }
         if (object == &filc_free_singleton)
             return;
+        if (PAS_UNLIKELY(filc_heap_composition_is_recording))
+            filc_heap_composition_record_freed(object);
         if (filc_lower_or_box_cas_weak_unfenced_unbarriered(
                 lower_or_box_ptr, lower_or_box,
                 filc_lower_or_box_create_lower(
@@ -139,6 +153,10 @@ static PAS_ALWAYS_INLINE void fugc_mark_or_free_lower_or_box(filc_object_array*
 
 PAS_API void fugc_donate(filc_object_array* mark_stack);
 
+/* Marks everything that the object points to, without marking the object itself. This is how stack
+   objects get scanned. */
+PAS_API void fugc_mark_outgoing_ptrs(filc_object_array* mark_stack, filc_object* object);
+
 /* Request that a collection cycle begins. If one is already running, then that's the one you get.
  
    Normally, GCs are requested by the verse_heap calling the verse_heap_live_bytes_trigger_callback(),
@@ -154,9 +172,70 @@ PAS_API uint64_t fugc_request_fresh(void);
    To do the equivalent of "System.gc()", you do fugc_wait(fugc_request_fresh()). */
 PAS_API void fugc_wait(uint64_t cycle);
 
+/* Tells the GC that the calling thread is idle for up to the given budget. If the heap is at least
+   FUGC_IDLE_TRIGGER_PERCENT of the way to the trigger threshold, this starts a cycle early. Then, if
+   a cycle is running, the calling thread helps with marking, destructing, and sweeping until the
+   cycle completes or the budget runs out. Returns true if no cycle is running anymore.
+ 
+   Must be called with the filc_thread exited. */
+PAS_API bool fugc_hint_idle(double budget_milliseconds);
+
+/* Called by a mutator thread that is parked because the world is stopped. If the collector
+   stopped the world for a cycle and FUGC_STW_LEND_MUTATORS=1, then the thread helps with that
+   cycle until it is done, just like with fugc_hint_idle(). Must be called with the filc_thread
+   exited and its signal handlers deferred. */
+PAS_API void fugc_lend_stopped_thread(void);
+
 PAS_API bool fugc_is_stw(void);
 
 PAS_API void fugc_dump_setup(void);
 
+#define FUGC_STATS_NUM_HANDSHAKE_BUCKETS 24
+
+/* This must stay in sync with zgc_stats in stdfil.h. Times are in milliseconds. The "last" fields
+   describe the most recently completed cycle. */
+typedef struct {
+    uint64_t num_completed_cycles;
+    uint64_t num_young_cycles;
+    uint64_t live_bytes;
+    uint64_t trigger_threshold;
+
+    double last_cycle_time;
+    double last_mark_time;
+    double last_destruct_time;
+    double last_sweep_time;
+    double total_cycle_time;
+    double total_mark_time;
+    double total_destruct_time;
+    double total_sweep_time;
+
+    /* Survived bytes are what the cycle marked. Floated bytes were allocated during the cycle and
+       so survived it without being marked. */
+    uint64_t last_survived_bytes;
+    uint64_t last_swept_bytes;
+    uint64_t last_floated_bytes;
+    uint64_t total_swept_bytes;
+
+    /* Fragmentation of the small pages that survived the last sweep. */
+    uint64_t last_num_small_pages;
+    uint64_t last_small_page_live_bytes;
+    uint64_t last_small_page_capacity_bytes;
+    uint64_t last_num_deferred_small_pages;
+
+    /* The most objects that any one marker had on its mark stack. */
+    uint64_t last_mark_stack_high_water;
+    uint64_t max_mark_stack_high_water;
+
+    /* Soft handshake latencies as seen by the collector. Bucket i counts handshakes that took less
+       than 2^i microseconds (and at least 2^(i-1)). The last bucket counts everything slower. */
+    uint64_t num_handshakes;
+    double total_handshake_time;
+    double max_handshake_time;
+    uint64_t handshake_histogram[FUGC_STATS_NUM_HANDSHAKE_BUCKETS];
+} fugc_stats;
+
+/* Takes a snapshot of the GC's counters. */
+PAS_API void fugc_get_stats(fugc_stats* stats);
+
 #endif /* FUGC_H */
 
@@ -70,6 +70,25 @@ def canonicalArgType(type)
     end
 end
 
+def directTypeCode(type)
+    case type
+    when 'void'
+        'v'
+    when 'bool'
+        'b'
+    when 'int', 'unsigned'
+        'i'
+    when 'long', 'unsigned long', 'size_t', 'ssize_t', 'unsigned long long', 'long long'
+        'l'
+    when 'double'
+        'd'
+    when 'filc_ptr'
+        'p'
+    else
+        nil
+    end
+end
+
 class Signature
     attr_reader :name, :args, :rets
 
@@ -110,6 +129,32 @@ class Signature
             rets
         end
     end
+
+    # Syscalls also get a register-based entrypoint that FilPizlonator calls directly, without
+    # going through the CC buffers (see directlyCallSyscalls() there). Its name spells out the
+    # signature, so a caller with a different idea of the syscall's prototype won't find it and
+    # will use the normal entrypoint instead. Ptrs are passed as separate lower and ptr args.
+    def directName
+        return nil unless name =~ /^zsys_/
+        return nil if throwsException
+        codes = ([rets] + args).map {
+            | type |
+            type == "..." ? nil : directTypeCode(type)
+        }
+        return nil if codes.include? nil
+        "filc_direct_#{name}__#{codes.join}"
+    end
+
+    def directParams
+        ["filc_thread* my_thread"] + args.map.with_index {
+            | arg, index |
+            if arg == "filc_ptr"
+                "void* arg#{index}_lower, void* arg#{index}_ptr"
+            else
+                "#{arg} arg#{index}"
+            end
+        }
+    end
 end
 
 class OutSignature
@@ -147,6 +192,7 @@ addSig "filc_ptr", "zgc_aligned_alloc", "size_t", "size_t"
 addSig "filc_ptr", "zgc_realloc", "filc_ptr", "size_t"
 addSig "filc_ptr", "zgc_aligned_realloc", "filc_ptr", "size_t", "size_t"
 addSig "void", "zgc_free", "filc_ptr"
+addSig "void", "zgc_free_sized", "filc_ptr", "size_t"
 addSig "filc_ptr", "zgetlower", "filc_ptr"
 addSig "filc_ptr", "zgetupper", "filc_ptr"
 addSig "bool", "zhasvalidcap", "filc_ptr"
@@ -156,6 +202,15 @@ addSig "filc_ptr", "zptrtable_decode", "filc_ptr", "size_t"
 addSig "filc_ptr", "zexact_ptrtable_new"
 addSig "size_t", "zexact_ptrtable_encode", "filc_ptr", "filc_ptr"
 addSig "filc_ptr", "zexact_ptrtable_decode", "filc_ptr", "size_t"
+addSig "filc_ptr", "zweak_new", "filc_ptr"
+addSig "filc_ptr", "zweak_get", "filc_ptr"
+addSig "filc_ptr", "zarena_new"
+addSig "filc_ptr", "zarena_alloc", "filc_ptr", "size_t"
+addSig "void", "zarena_destroy", "filc_ptr"
+addSig "filc_ptr", "zfiber_create", "filc_ptr", "filc_ptr", "size_t"
+addSig "void", "zfiber_switch", "filc_ptr"
+addSig "filc_ptr", "zfiber_self"
+addSig "bool", "zfiber_is_done", "filc_ptr"
 addSig "size_t", "ztesting_get_num_ptrtables"
 addSig "filc_ptr", "zptr_to_new_string", "filc_ptr"
 addSig "filc_ptr", "zptr_contents_to_new_string", "filc_ptr"
@@ -166,14 +221,24 @@ addSig "void", "zprint", "filc_ptr"
 addSig "void", "zprint_long", "long"
 addSig "void", "zprint_ptr", "filc_ptr"
 addSig "size_t", "zstrlen", "filc_ptr"
+addSig "size_t", "zstrnlen", "filc_ptr", "size_t"
+addSig "filc_ptr", "zmemchr", "filc_ptr", "int", "size_t"
+addSig "filc_ptr", "zstrchr", "filc_ptr", "int"
 addSig "int", "zisdigit", "int"
 addSig "void", "zerror", "filc_ptr"
 addSig "filc_ptr", "zcall", "filc_ptr", "filc_ptr"
 addSig "bool", "zis_runtime_testing_enabled"
 addSig "void", "zvalidate_ptr", "filc_ptr"
 addSig "void", "zgc_request_and_wait"
+addSig "void", "zgc_collect_async"
+addSig "bool", "zgc_hint_idle", "unsigned long long"
 addSig "bool", "zgc_is_stw"
+addSig "void", "zgc_get_stats", "filc_ptr"
+addSig "bool", "zgc_write_heap_snapshot", "int"
+addSig "void", "zgc_heap_composition", "filc_ptr"
 addSig "void", "zscavenge_synchronously"
+addSig "bool", "zheap_reserve", "size_t"
+addSig "bool", "zheap_prefault", "size_t"
 addSig "void", "zscavenger_suspend"
 addSig "void", "zscavenger_resume"
 addSig "void", "zdump_stack"
@@ -187,6 +252,21 @@ addSig "void", "zcpuid", "unsigned", "filc_ptr", "filc_ptr", "filc_ptr", "filc_p
 addSig "void", "zcpuid_count", "unsigned", "unsigned", "filc_ptr", "filc_ptr", "filc_ptr",
        "filc_ptr"
 addSig "unsigned long", "zxgetbv"
+addSig "unsigned", "zcrypto_features"
+addSig "void", "zcrypto_sha256_blocks", "filc_ptr", "filc_ptr", "size_t"
+addSig "void", "zcrypto_sha512_blocks", "filc_ptr", "filc_ptr", "size_t"
+addSig "bool", "zcrypto_aes_set_encrypt_key", "filc_ptr", "unsigned", "filc_ptr"
+addSig "void", "zcrypto_aes_encrypt_block", "filc_ptr", "filc_ptr", "filc_ptr"
+addSig "void", "zcrypto_aes_ctr32_encrypt_blocks", "filc_ptr", "filc_ptr", "size_t", "filc_ptr",
+       "filc_ptr"
+addSig "void", "zcrypto_ghash", "filc_ptr", "filc_ptr", "filc_ptr", "size_t"
+addSig "void", "zcrypto_chacha20_ctr32", "filc_ptr", "filc_ptr", "size_t", "filc_ptr", "filc_ptr"
+addSig "void", "zcrypto_poly1305_init", "filc_ptr", "filc_ptr"
+addSig "void", "zcrypto_poly1305_blocks", "filc_ptr", "filc_ptr", "size_t", "unsigned"
+addSig "void", "zcrypto_poly1305_emit", "filc_ptr", "filc_ptr", "filc_ptr"
+addSig "unsigned", "zcrc32", "unsigned", "filc_ptr", "size_t"
+addSig "unsigned", "zadler32", "unsigned", "filc_ptr", "size_t"
+addSig "unsigned long long", "zcrc64", "unsigned long long", "filc_ptr", "size_t"
 addSig "void", "zregister_sys_errno_handler", "filc_ptr"
 addSig "void", "zregister_sys_dlerror_handler", "filc_ptr"
 
@@ -255,15 +335,19 @@ addSig "int", "zsys_chown", "filc_ptr", "unsigned", "unsigned"
 addSig "int", "zsys_lchown", "filc_ptr", "unsigned", "unsigned"
 addSig "ssize_t", "zsys_sendmsg", "int", "filc_ptr", "int"
 addSig "ssize_t", "zsys_recvmsg", "int", "filc_ptr", "int"
+addSig "int", "zsys_sendmmsg", "int", "filc_ptr", "unsigned", "int"
+addSig "int", "zsys_recvmmsg", "int", "filc_ptr", "unsigned", "int", "filc_ptr"
 addSig "int", "zsys_rename", "filc_ptr", "filc_ptr"
 addSig "int", "zsys_unlink", "filc_ptr"
 addSig "int", "zsys_link", "filc_ptr", "filc_ptr"
 addSig "filc_ptr", "zsys_mmap", "filc_ptr", "size_t", "int", "int", "int", "long"
 addSig "int", "zsys_munmap", "filc_ptr", "size_t"
+addSig "filc_ptr", "zsys_mremap", "filc_ptr", "size_t", "size_t", "int"
 addSig "int", "zsys_ftruncate", "int", "long"
 addSig "filc_ptr", "zsys_getcwd", "filc_ptr", "size_t"
 addSig "filc_ptr", "zsys_dlopen", "filc_ptr", "int"
 addSig "filc_ptr", "zsys_dlsym", "filc_ptr", "filc_ptr"
+addSig "size_t", "zsys_dlsym_many", "filc_ptr", "filc_ptr", "filc_ptr", "size_t"
 addSig "int", "zsys_poll", "filc_ptr", "unsigned long", "int"
 addSig "int", "zsys_faccessat", "int", "filc_ptr", "int", "int"
 addSig "int", "zsys_sigwait", "filc_ptr", "filc_ptr"
@@ -306,6 +390,7 @@ addSig "int", "zsys_unlinkat", "int", "filc_ptr", "int"
 addSig "int", "zsys_acct", "filc_ptr"
 addSig "int", "zsys_setgroups", "size_t", "filc_ptr"
 addSig "int", "zsys_madvise", "filc_ptr", "size_t", "int"
+addSig "int", "zsys_msync", "filc_ptr", "size_t", "int"
 addSig "int", "zsys_mincore", "filc_ptr", "size_t", "filc_ptr"
 addSig "int", "zsys_getpriority", "int", "int"
 addSig "int", "zsys_setpriority", "int", "int", "int"
@@ -351,6 +436,10 @@ addSig "int", "zsys_fexecve", "int", "filc_ptr", "filc_ptr"
 addSig "int", "zsys_isatty", "int"
 addSig "int", "zsys_uname", "filc_ptr"
 addSig "int", "zsys_sendfile", "int", "int", "filc_ptr", "size_t"
+addSig "ssize_t", "zsys_splice", "int", "filc_ptr", "int", "filc_ptr", "size_t", "unsigned"
+addSig "ssize_t", "zsys_tee", "int", "int", "size_t", "unsigned"
+addSig "ssize_t", "zsys_vmsplice", "int", "filc_ptr", "size_t", "unsigned"
+addSig "ssize_t", "zsys_copy_file_range", "int", "filc_ptr", "int", "filc_ptr", "size_t", "unsigned"
 addSig "void", "zsys_futex_wake", "filc_ptr", "int", "int"
 addSig "void", "zsys_futex_wait", "filc_ptr", "int", "int"
 addSig "int", "zsys_futex_timedwait", "filc_ptr", "int", "int", "filc_ptr", "int"
@@ -358,11 +447,17 @@ addSig "int", "zsys_futex_unlock_pi", "filc_ptr", "int"
 addSig "int", "zsys_futex_lock_pi", "filc_ptr", "int", "filc_ptr"
 addSig "void", "zsys_futex_requeue", "filc_ptr", "int", "int", "int", "filc_ptr"
 addSig "int", "zsys_getdents", "int", "filc_ptr", "size_t"
+addSig "long", "zreaddir_batch", "int", "filc_ptr", "size_t"
 addSig "long", "zsys_getrandom", "filc_ptr", "size_t", "unsigned"
 addSig "int", "zsys_epoll_create1", "int"
 addSig "int", "zsys_epoll_ctl", "int", "int", "int", "filc_ptr"
 addSig "int", "zsys_epoll_wait", "int", "filc_ptr", "int", "int"
 addSig "int", "zsys_epoll_pwait", "int", "filc_ptr", "int", "int", "filc_ptr"
+addSig "filc_ptr", "zsys_io_uring_setup", "unsigned", "unsigned"
+addSig "int", "zsys_io_uring_register_buffers", "filc_ptr", "filc_ptr", "unsigned"
+addSig "int", "zsys_io_uring_prep", "filc_ptr", "filc_ptr"
+addSig "int", "zsys_io_uring_submit", "filc_ptr", "unsigned"
+addSig "int", "zsys_io_uring_reap", "filc_ptr", "filc_ptr", "unsigned"
 addSig "int", "zsys_sysinfo", "filc_ptr"
 addSig "int", "zsys_sched_getaffinity", "int", "size_t", "filc_ptr"
 addSig "int", "zsys_sched_setaffinity", "int", "size_t", "filc_ptr"
@@ -372,10 +467,19 @@ addSig "int", "zsys_wait4", "int", "filc_ptr", "int", "filc_ptr"
 addSig "int", "zsys_sigsuspend", "filc_ptr"
 addSig "int", "zsys_prctl", "int", "..."
 addSig "int", "zsys_eventfd", "unsigned", "int"
+addSig "int", "zsys_signalfd", "int", "filc_ptr", "int"
+addSig "int", "zsys_posix_spawn", "filc_ptr", "filc_ptr", "filc_ptr", "unsigned", "filc_ptr",
+       "filc_ptr", "filc_ptr"
 
 addSig "filc_ptr", "zthread_self"
 addSig "unsigned", "zthread_get_id", "filc_ptr"
 addSig "unsigned", "zthread_self_id"
+addSig "void", "zmutex_lock", "filc_ptr"
+addSig "bool", "zmutex_trylock", "filc_ptr"
+addSig "void", "zmutex_unlock", "filc_ptr"
+addSig "void", "zcondvar_wait", "filc_ptr", "filc_ptr"
+addSig "void", "zcondvar_signal", "filc_ptr"
+addSig "void", "zcondvar_broadcast", "filc_ptr"
 addSig "filc_ptr", "zthread_get_cookie", "filc_ptr"
 addSig "void", "zthread_set_self_cookie", "filc_ptr"
 addSig "filc_ptr", "zthread_create", "filc_ptr", "filc_ptr"
@@ -417,6 +521,10 @@ when "src/libpas/filc_native.h"
                            }.join(', '))
             end
             outp.puts ");"
+            if signature.directName
+                outp.puts "PAS_API #{signature.rets} #{signature.directName}("
+                outp.puts "    #{signature.directParams.join(', ')});"
+            end
         }
         $outSignatures.each {
             | signature |
@@ -528,6 +636,44 @@ when "src/libpas/filc_native_forwarders.c"
             outp.puts "        &function_object_#{signature.name},"
             outp.puts "        native_thunk_#{signature.name});"
             outp.puts "}"
+            if signature.directName
+                outp.puts "#{signature.rets} #{signature.directName}("
+                outp.puts "    #{signature.directParams.join(', ')})"
+                outp.puts "{"
+                outp.puts "    FILC_DEFINE_FRAME(\"#{signature.name}\");"
+                outp.puts "    filc_native_frame native_frame;"
+                outp.puts "    filc_push_frame(my_thread, frame);"
+                outp.puts "    filc_push_native_frame(my_thread, &native_frame);"
+                signature.args.each_with_index {
+                    | arg, index |
+                    if arg == "filc_ptr"
+                        outp.puts "    filc_ptr arg#{index} ="
+                        outp.puts "        filc_ptr_create_with_lower_and_ptr_and_manual_tracking("
+                        outp.puts "            arg#{index}_lower, arg#{index}_ptr);"
+                        outp.puts "    filc_thread_track_object("
+                        outp.puts "        my_thread, filc_ptr_object(arg#{index}));"
+                    end
+                }
+                if signature.rets == "void"
+                    outp.print "    "
+                else
+                    outp.print "    #{signature.rets} result = "
+                end
+                outp.print "filc_native_#{signature.name}(my_thread"
+                unless signature.args.empty?
+                    outp.print(", " + signature.args.map.with_index {
+                                   | arg, index |
+                                   "arg#{index}"
+                               }.join(", "))
+                end
+                outp.puts ");"
+                outp.puts "    filc_pop_native_frame(my_thread, &native_frame);"
+                outp.puts "    filc_pop_frame(my_thread, frame);"
+                if signature.rets != "void"
+                    outp.puts "    return result;"
+                end
+                outp.puts "}"
+            end
         }
         $outSignatures.each {
             | signature |
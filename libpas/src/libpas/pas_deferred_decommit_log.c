@@ -208,8 +208,10 @@ static void decommit_all(pas_deferred_decommit_log* log,
 {
     size_t start_index;
     size_t index;
+    pas_page_malloc_decommit_batch batch;
     
     pas_virtual_range_min_heap_sort_descending(&log->impl);
+    pas_page_malloc_decommit_batch_construct(&batch);
     
     for (start_index = log->impl.size; start_index;) {
         pas_virtual_range range;
@@ -246,7 +248,8 @@ static void decommit_all(pas_deferred_decommit_log* log,
                         (void*)range.end);
             }
             
-            pas_page_malloc_decommit((void*)range.begin, pas_virtual_range_size(range), range.mmap_capability);
+            pas_page_malloc_decommit_batch_add(
+                &batch, (void*)range.begin, pas_virtual_range_size(range), range.mmap_capability);
         }
         
         PAS_ASSERT(end_index);
@@ -255,6 +258,9 @@ static void decommit_all(pas_deferred_decommit_log* log,
         start_index = end_index - 1;
     }
 
+    /* The decommits have to be done before we let go of the locks. */
+    pas_page_malloc_decommit_batch_flush(&batch);
+
     for (index = log->impl.size; index; index--) {
         pas_virtual_range range;
         pas_lock* lock_ptr;
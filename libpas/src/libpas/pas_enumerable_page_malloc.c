@@ -33,14 +33,8 @@
 
 pas_enumerable_range_list pas_enumerable_page_malloc_page_list;
 
-pas_aligned_allocation_result
-pas_enumerable_page_malloc_try_allocate_without_deallocating_padding(
-    size_t size, pas_alignment alignment, pas_commit_mode commit_mode)
+static pas_aligned_allocation_result append_to_page_list(pas_aligned_allocation_result result)
 {
-    pas_aligned_allocation_result result;
-
-    result = pas_page_malloc_try_allocate_without_deallocating_padding(size, alignment, commit_mode);
-
     if (result.result) {
         pas_enumerable_range_list_append(
             &pas_enumerable_page_malloc_page_list,
@@ -52,4 +46,21 @@ pas_enumerable_page_malloc_try_allocate_without_deallocating_padding(
     return result;
 }
 
+pas_aligned_allocation_result
+pas_enumerable_page_malloc_try_allocate_without_deallocating_padding(
+    size_t size, pas_alignment alignment, pas_commit_mode commit_mode)
+{
+    return append_to_page_list(
+        pas_page_malloc_try_allocate_without_deallocating_padding(size, alignment, commit_mode));
+}
+
+pas_aligned_allocation_result
+pas_enumerable_page_malloc_try_allocate_huge_without_deallocating_padding(
+    size_t size, pas_alignment alignment, pas_commit_mode commit_mode)
+{
+    return append_to_page_list(
+        pas_page_malloc_try_allocate_huge_without_deallocating_padding(
+            size, alignment, commit_mode));
+}
+
 #endif /* LIBPAS_ENABLED */
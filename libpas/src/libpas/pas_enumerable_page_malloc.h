@@ -41,6 +41,11 @@ PAS_API pas_aligned_allocation_result
 pas_enumerable_page_malloc_try_allocate_without_deallocating_padding(
     size_t size, pas_alignment alignment, pas_commit_mode commit_mode);
 
+/* Same, but uses pas_page_malloc_try_allocate_huge_without_deallocating_padding. */
+PAS_API pas_aligned_allocation_result
+pas_enumerable_page_malloc_try_allocate_huge_without_deallocating_padding(
+    size_t size, pas_alignment alignment, pas_commit_mode commit_mode);
+
 PAS_END_EXTERN_C;
 
 #endif /* PAS_ENUMERABLE_PAGE_MALLOC_H */
@@ -36,6 +36,7 @@
 #include "pas_enumerate_segregated_heaps.h"
 #include "pas_enumerate_unaccounted_pages_as_meta.h"
 #include "pas_enumerator_internal.h"
+#include "pas_enumerator_read_cache.h"
 #include "pas_enumerator_region.h"
 #include "pas_ptr_hash_set.h"
 #include "pas_root.h"
@@ -91,6 +92,11 @@ pas_enumerator* pas_enumerator_create(pas_root* remote_root_address,
     result->allocation_config.deallocate = deallocate;
     result->allocation_config.arg = result;
 
+    result->read_cache = pas_enumerator_allocate(result, sizeof(pas_enumerator_read_cache));
+    pas_enumerator_read_cache_construct(result->read_cache);
+    result->bulk_read_size = 0;
+    result->num_reader_calls = 0;
+
     result->heap_config_datas = pas_enumerator_allocate(
         result, sizeof(void*) * pas_heap_config_kind_num_kinds);
     pas_zero_memory(result->heap_config_datas, sizeof(void*) * pas_heap_config_kind_num_kinds);
@@ -176,6 +182,12 @@ void pas_enumerator_destroy(pas_enumerator* enumerator)
     pas_enumerator_region_destroy(enumerator->region);
 }
 
+void pas_enumerator_enable_bulk_reads(pas_enumerator* enumerator, size_t block_size)
+{
+    PAS_ASSERT_WITH_DETAIL(pas_is_power_of_2(block_size));
+    enumerator->bulk_read_size = block_size;
+}
+
 void* pas_enumerator_allocate(pas_enumerator* enumerator,
                               size_t size)
 {
@@ -196,6 +208,35 @@ void* pas_enumerator_read_compact(pas_enumerator* enumerator,
         + (uintptr_t)remote_address - (uintptr_t)enumerator->compact_heap_remote_base);
 }
 
+static void* cached_read(pas_enumerator* enumerator,
+                         void* remote_address,
+                         size_t size,
+                         bool should_remember_failure)
+{
+    pas_enumerator_read_cache_entry* entry;
+    pas_enumerator_read_cache_entry new_entry;
+    void* result;
+
+    entry = pas_enumerator_read_cache_find(
+        enumerator->read_cache, pas_enumerator_read_cache_key_create(remote_address, size));
+    if (entry)
+        return entry->local_address;
+
+    result = enumerator->reader(enumerator, remote_address, size, enumerator->reader_arg);
+    enumerator->num_reader_calls++;
+
+    /* A failed read means that enumeration is over, unless this is a bulk read, in which case we
+       don't want to try that block again. */
+    if (!result && !should_remember_failure)
+        return NULL;
+
+    new_entry.key = pas_enumerator_read_cache_key_create(remote_address, size);
+    new_entry.local_address = result;
+    pas_enumerator_read_cache_add_new(
+        enumerator->read_cache, new_entry, NULL, &enumerator->allocation_config);
+    return result;
+}
+
 void* pas_enumerator_read(pas_enumerator* enumerator,
                           void* remote_address,
                           size_t size)
@@ -215,8 +256,21 @@ void* pas_enumerator_read(pas_enumerator* enumerator,
 
     if (!size)
         return &enumerator->dummy_byte;
+
+    if (enumerator->bulk_read_size && size <= enumerator->bulk_read_size) {
+        uintptr_t block;
+
+        block = pas_round_down_to_power_of_2((uintptr_t)remote_address, enumerator->bulk_read_size);
+        if ((uintptr_t)remote_address + size <= block + enumerator->bulk_read_size) {
+            char* local_block;
+
+            local_block = cached_read(enumerator, (void*)block, enumerator->bulk_read_size, true);
+            if (local_block)
+                return local_block + ((uintptr_t)remote_address - block);
+        }
+    }
     
-    return enumerator->reader(enumerator, remote_address, size, enumerator->reader_arg);
+    return cached_read(enumerator, remote_address, size, false);
 }
 
 void pas_enumerator_add_unaccounted_pages(pas_enumerator* enumerator,
@@ -32,11 +32,13 @@
 PAS_BEGIN_EXTERN_C;
 
 struct pas_enumerator;
+struct pas_enumerator_read_cache;
 struct pas_enumerator_region;
 struct pas_heap_config;
 struct pas_ptr_hash_set;
 struct pas_root;
 typedef struct pas_enumerator pas_enumerator;
+typedef struct pas_enumerator_read_cache pas_enumerator_read_cache;
 typedef struct pas_enumerator_region pas_enumerator_region;
 typedef struct pas_heap_config pas_heap_config;
 typedef struct pas_ptr_hash_set pas_ptr_hash_set;
@@ -123,6 +125,18 @@ struct pas_enumerator {
        as payload if it is still in this set, and then removes it from this set. */
     pas_ptr_hash_set* unaccounted_pages;
 
+    /* Every read that pas_enumerator_read() has done, so that reading the same thing again doesn't
+       go back to the reader. Enumeration reads the same page headers, directories, and bitvectors
+       many times over, and each reader call may be a syscall or a trip through a core file. */
+    pas_enumerator_read_cache* read_cache;
+
+    /* If nonzero, reads that fit in an aligned block of this size are done by reading the whole
+       block. See pas_enumerator_enable_bulk_reads(). */
+    size_t bulk_read_size;
+
+    /* How many times we called the reader. Useful for telling if the caching is working. */
+    size_t num_reader_calls;
+
     pas_enumerator_reader reader;
     void* reader_arg;
 
@@ -154,6 +168,15 @@ PAS_API pas_enumerator* pas_enumerator_create(pas_root* remote_root_address,
 
 PAS_API void pas_enumerator_destroy(pas_enumerator* enumerator);
 
+/* Makes reads that fit in an aligned block of block_size bytes read that whole block, and then
+   serves all later reads in that block from the copy. This trades bandwidth for fewer reader calls,
+   which is a big win when the reader is slow per call, like when reading out of another process or
+   a core dump. The reader has to be OK with being asked for memory that isn't all there: it should
+   return NULL and carry on, in which case we fall back to reading just what was asked for. The
+   libmalloc reader in pas_root.c can't do that, so it doesn't use this. block_size has to be a
+   power of 2. */
+PAS_API void pas_enumerator_enable_bulk_reads(pas_enumerator* enumerator, size_t block_size);
+
 PAS_API void* pas_enumerator_allocate(pas_enumerator* enumerator,
                                       size_t size);
 
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef PAS_ENUMERATOR_READ_CACHE_H
+#define PAS_ENUMERATOR_READ_CACHE_H
+
+#include "pas_hashtable.h"
+
+PAS_BEGIN_EXTERN_C;
+
+/* Remembers the enumerator's reads, so that reading the same range twice only calls the reader
+   once. See pas_enumerator_read(). */
+
+struct pas_enumerator_read_cache_entry;
+struct pas_enumerator_read_cache_key;
+typedef struct pas_enumerator_read_cache_entry pas_enumerator_read_cache_entry;
+typedef struct pas_enumerator_read_cache_key pas_enumerator_read_cache_key;
+
+struct pas_enumerator_read_cache_key {
+    void* remote_address;
+    size_t size;
+};
+
+struct pas_enumerator_read_cache_entry {
+    pas_enumerator_read_cache_key key;
+    void* local_address; /* NULL if the reader couldn't read this range. */
+};
+
+static inline pas_enumerator_read_cache_key pas_enumerator_read_cache_key_create(
+    void* remote_address, size_t size)
+{
+    pas_enumerator_read_cache_key result;
+    result.remote_address = remote_address;
+    result.size = size;
+    return result;
+}
+
+static inline pas_enumerator_read_cache_entry pas_enumerator_read_cache_entry_create_empty(void)
+{
+    pas_enumerator_read_cache_entry result;
+    result.key = pas_enumerator_read_cache_key_create(NULL, 0);
+    result.local_address = NULL;
+    return result;
+}
+
+static inline pas_enumerator_read_cache_entry pas_enumerator_read_cache_entry_create_deleted(void)
+{
+    pas_enumerator_read_cache_entry result;
+    result.key = pas_enumerator_read_cache_key_create(NULL, 1);
+    result.local_address = NULL;
+    return result;
+}
+
+/* Zero-sized reads and reads of NULL never get here, so those can be our empty and deleted keys. */
+static inline bool pas_enumerator_read_cache_entry_is_empty_or_deleted(
+    pas_enumerator_read_cache_entry entry)
+{
+    return !entry.key.remote_address;
+}
+
+static inline bool pas_enumerator_read_cache_entry_is_empty(pas_enumerator_read_cache_entry entry)
+{
+    return !entry.key.remote_address && !entry.key.size;
+}
+
+static inline bool pas_enumerator_read_cache_entry_is_deleted(
+    pas_enumerator_read_cache_entry entry)
+{
+    return !entry.key.remote_address && entry.key.size == 1;
+}
+
+static inline pas_enumerator_read_cache_key pas_enumerator_read_cache_entry_get_key(
+    pas_enumerator_read_cache_entry entry)
+{
+    return entry.key;
+}
+
+static inline unsigned pas_enumerator_read_cache_key_get_hash(pas_enumerator_read_cache_key key)
+{
+    return pas_hash_ptr(key.remote_address) ^ pas_hash_intptr(key.size);
+}
+
+static inline bool pas_enumerator_read_cache_key_is_equal(pas_enumerator_read_cache_key a,
+                                                          pas_enumerator_read_cache_key b)
+{
+    return a.remote_address == b.remote_address && a.size == b.size;
+}
+
+PAS_CREATE_HASHTABLE(pas_enumerator_read_cache,
+                     pas_enumerator_read_cache_entry,
+                     pas_enumerator_read_cache_key);
+
+PAS_END_EXTERN_C;
+
+#endif /* PAS_ENUMERATOR_READ_CACHE_H */
+
@@ -144,9 +144,7 @@ static PAS_ALWAYS_INLINE size_t pas_get_allocation_size(void* ptr, pas_heap_conf
             return 0;
         }
         
-        pas_heap_lock_lock();
-        
-        entry = pas_large_map_find(begin);
+        entry = pas_large_map_find_lock_free(begin);
 
         result = 0;
         if (!pas_large_map_entry_is_empty(entry)) {
@@ -157,8 +155,6 @@ static PAS_ALWAYS_INLINE size_t pas_get_allocation_size(void* ptr, pas_heap_conf
                 result = entry.end - begin;
         }
         
-        pas_heap_lock_unlock();
-        
         return result;
     } }
     
@@ -104,9 +104,7 @@ static PAS_ALWAYS_INLINE pas_heap* pas_get_heap(void* ptr,
             return NULL;
         }
         
-        pas_heap_lock_lock();
-        
-        entry = pas_large_map_find(begin);
+        entry = pas_large_map_find_lock_free(begin);
         
         PAS_ASSERT(!pas_large_map_entry_is_empty(entry));
         PAS_ASSERT(entry.begin == begin);
@@ -114,8 +112,6 @@ static PAS_ALWAYS_INLINE pas_heap* pas_get_heap(void* ptr,
         
         result = pas_heap_for_large_heap(entry.heap);
         
-        pas_heap_lock_unlock();
-        
         return result;
     } }
     
@@ -58,11 +58,7 @@ static PAS_ALWAYS_INLINE pas_object_kind pas_get_object_kind(void* ptr,
             goto use_page_kind;
         }
         
-        pas_heap_lock_lock();
-        
-        entry = pas_large_map_find(begin);
-        
-        pas_heap_lock_unlock();
+        entry = pas_large_map_find_lock_free(begin);
         
         if (pas_large_map_entry_is_empty(entry))
             return pas_not_an_object_kind;
@@ -48,11 +48,7 @@ static PAS_ALWAYS_INLINE bool pas_has_object(void* ptr,
         if (config.page_header_func(begin))
             return true;
         
-        pas_heap_lock_lock();
-        
-        entry = pas_large_map_find(begin);
-        
-        pas_heap_lock_unlock();
+        entry = pas_large_map_find_lock_free(begin);
         
         return !pas_large_map_entry_is_empty(entry);
     } }
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef PAS_HUGE_PAGE_MODE_H
+#define PAS_HUGE_PAGE_MODE_H
+
+#include "pas_utils.h"
+
+PAS_BEGIN_EXTERN_C;
+
+/* How pas_page_malloc backs heap memory with huge pages. See pas_page_malloc_huge_page_mode. */
+
+enum pas_huge_page_mode {
+    /* Just use the system page size. */
+    pas_no_huge_pages,
+
+    /* Align heap memory to PAS_HUGE_PAGE_SIZE and madvise(MADV_HUGEPAGE) it. */
+    pas_transparent_huge_pages,
+
+    /* Map heap memory with MAP_HUGETLB, falling back on transparent huge pages if the system has no
+       huge pages left to give us. */
+    pas_hugetlb_huge_pages
+};
+
+typedef enum pas_huge_page_mode pas_huge_page_mode;
+
+static inline const char* pas_huge_page_mode_get_string(pas_huge_page_mode mode)
+{
+    switch (mode) {
+    case pas_no_huge_pages:
+        return "none";
+    case pas_transparent_huge_pages:
+        return "thp";
+    case pas_hugetlb_huge_pages:
+        return "hugetlb";
+    }
+    PAS_ASSERT(!"Should not be reached");
+    return NULL;
+}
+
+PAS_END_EXTERN_C;
+
+#endif /* PAS_HUGE_PAGE_MODE_H */
+
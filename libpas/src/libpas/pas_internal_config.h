@@ -98,6 +98,9 @@
 #define PAS_DEALLOCATION_LOG_MAX_BYTES   50000
 #endif
 
+/* How many deallocations a flush may leave in the log because their pages were locked. */
+#define PAS_DEALLOCATION_LOG_MAX_DEFERRED (PAS_DEALLOCATION_LOG_SIZE / 4)
+
 #define PAS_NUM_FAST_FAST_MEGAPAGE_BITS  524288
 
 #define PAS_MAX_OBJECT_SIZE(payload_size) ((size_t)(payload_size) / (size_t)PAS_MIN_OBJECTS_PER_PAGE)
@@ -32,10 +32,13 @@
 
 #include "pas_large_heap.h"
 #include "pas_large_utility_free_heap.h"
+#include "pas_page_malloc.h"
 
 pas_large_map_hashtable pas_large_map_hashtable_instance = PAS_HASHTABLE_INITIALIZER;
 pas_large_map_hashtable_in_flux_stash pas_large_map_hashtable_instance_in_flux_stash;
 
+pas_large_map_slot* pas_large_map_first_level[PAS_LARGE_MAP_FIRST_LEVEL_SIZE];
+
 pas_large_map_entry pas_large_map_find(uintptr_t begin)
 {
     pas_heap_lock_assert_held();
@@ -43,9 +46,63 @@ pas_large_map_entry pas_large_map_find(uintptr_t begin)
     return pas_large_map_hashtable_get(&pas_large_map_hashtable_instance, begin);
 }
 
+pas_large_map_entry pas_large_map_find_slow(uintptr_t begin)
+{
+    pas_large_map_entry result;
+
+    pas_heap_lock_lock();
+    result = pas_large_map_find(begin);
+    pas_heap_lock_unlock();
+
+    return result;
+}
+
+static pas_large_map_slot* get_slot(uintptr_t begin)
+{
+    pas_large_map_slot** second_level_ptr;
+
+    pas_heap_lock_assert_held();
+
+    PAS_ASSERT(begin <= PAS_MAX_ADDRESS);
+
+    second_level_ptr = pas_large_map_first_level +
+        ((begin >> PAS_LARGE_MAP_FIRST_LEVEL_SHIFT) & PAS_LARGE_MAP_FIRST_LEVEL_MASK);
+
+    if (!*second_level_ptr) {
+        /* The second levels are big but we only touch the slots we need, so we get them straight
+           from the OS. That way they're all zeroes and we don't use up the compact reservation. */
+        pas_aligned_allocation_result allocation_result;
+        allocation_result = pas_page_malloc_try_allocate_without_deallocating_padding(
+            sizeof(pas_large_map_slot) * PAS_LARGE_MAP_SECOND_LEVEL_SIZE,
+            pas_alignment_create_trivial(), pas_committed);
+        PAS_ASSERT(allocation_result.result);
+        PAS_ASSERT(allocation_result.zero_mode == pas_zero_mode_is_all_zero);
+        pas_store_store_fence();
+        *second_level_ptr = (pas_large_map_slot*)allocation_result.result;
+    }
+
+    return (*second_level_ptr) + ((begin >> PAS_LARGE_MAP_SECOND_LEVEL_SHIFT)
+                                  & PAS_LARGE_MAP_SECOND_LEVEL_MASK);
+}
+
+static void begin_writing_slot(pas_large_map_slot* slot)
+{
+    PAS_ASSERT(!(slot->version & 1));
+    slot->version++;
+    pas_store_store_fence();
+}
+
+static void end_writing_slot(pas_large_map_slot* slot)
+{
+    pas_store_store_fence();
+    slot->version++;
+}
+
 void pas_large_map_add(pas_large_map_entry entry)
 {
     static const bool verbose = false;
+
+    pas_large_map_slot* slot;
     
     pas_heap_lock_assert_held();
 
@@ -56,21 +113,55 @@ void pas_large_map_add(pas_large_map_entry entry)
         &pas_large_map_hashtable_instance, entry,
         &pas_large_map_hashtable_instance_in_flux_stash,
         &pas_large_utility_free_heap_allocation_config);
+
+    slot = get_slot(entry.begin);
+    begin_writing_slot(slot);
+    if (slot->num_entries) {
+        slot->begin = PAS_LARGE_MAP_SLOT_COLLIDED;
+        slot->end = 0;
+        slot->heap = NULL;
+    } else {
+        slot->begin = entry.begin;
+        slot->end = entry.end;
+        slot->heap = entry.heap;
+    }
+    PAS_ASSERT(slot->num_entries != UINT_MAX);
+    slot->num_entries++;
+    end_writing_slot(slot);
 }
 
 pas_large_map_entry pas_large_map_take(uintptr_t begin)
 {
     static const bool verbose = false;
+
+    pas_large_map_entry result;
+    pas_large_map_slot* slot;
     
     pas_heap_lock_assert_held();
 
     if (verbose)
         pas_log("taking begin = %p.\n", (void*)begin);
 
-    return pas_large_map_hashtable_take(
+    result = pas_large_map_hashtable_take(
         &pas_large_map_hashtable_instance, begin,
         &pas_large_map_hashtable_instance_in_flux_stash,
         &pas_large_utility_free_heap_allocation_config);
+    if (pas_large_map_entry_is_empty(result))
+        return result;
+
+    slot = get_slot(begin);
+    begin_writing_slot(slot);
+    PAS_ASSERT(slot->num_entries);
+    slot->num_entries--;
+    if (!slot->num_entries) {
+        slot->begin = 0;
+        slot->end = 0;
+        slot->heap = NULL;
+    } else
+        PAS_ASSERT(slot->begin == PAS_LARGE_MAP_SLOT_COLLIDED);
+    end_writing_slot(slot);
+
+    return result;
 }
 
 bool pas_large_map_for_each_entry(pas_large_map_for_each_entry_callback callback,
@@ -45,8 +45,93 @@ PAS_CREATE_HASHTABLE(pas_large_map_hashtable,
 PAS_API extern pas_large_map_hashtable pas_large_map_hashtable_instance;
 PAS_API extern pas_large_map_hashtable_in_flux_stash pas_large_map_hashtable_instance_in_flux_stash;
 
+/* The hashtable is the source of truth for the large map, but looking things up in it needs the
+   heap lock. So the large map also keeps a two-level radix tree, in the spirit of
+   verse_heap_chunk_map, that maps the granule that an object begins in to that object. That's what
+   lets pas_large_map_find_lock_free work without locks.
+
+   Two large objects can only begin in the same granule if the first of them is smaller than a
+   granule, which is rare. When it does happen, the slot is marked collided and lookups in that
+   granule go to the hashtable instead. A slot stays collided until all of its objects are gone. */
+#define PAS_LARGE_MAP_GRANULE_SHIFT 16u
+#define PAS_LARGE_MAP_FIRST_LEVEL_BITS ((PAS_ADDRESS_BITS - PAS_LARGE_MAP_GRANULE_SHIFT) >> 1u)
+#define PAS_LARGE_MAP_FIRST_LEVEL_MASK (((uintptr_t)1 << PAS_LARGE_MAP_FIRST_LEVEL_BITS) - 1)
+#define PAS_LARGE_MAP_FIRST_LEVEL_SIZE (1u << PAS_LARGE_MAP_FIRST_LEVEL_BITS)
+#define PAS_LARGE_MAP_SECOND_LEVEL_BITS ((PAS_ADDRESS_BITS - PAS_LARGE_MAP_GRANULE_SHIFT + 1) >> 1u)
+#define PAS_LARGE_MAP_SECOND_LEVEL_MASK (((uintptr_t)1 << PAS_LARGE_MAP_SECOND_LEVEL_BITS) - 1)
+#define PAS_LARGE_MAP_SECOND_LEVEL_SIZE (1u << PAS_LARGE_MAP_SECOND_LEVEL_BITS)
+
+#define PAS_LARGE_MAP_SECOND_LEVEL_SHIFT PAS_LARGE_MAP_GRANULE_SHIFT
+#define PAS_LARGE_MAP_FIRST_LEVEL_SHIFT \
+    (PAS_LARGE_MAP_SECOND_LEVEL_SHIFT + PAS_LARGE_MAP_SECOND_LEVEL_BITS)
+
+#define PAS_LARGE_MAP_SLOT_COLLIDED ((uintptr_t)1)
+
+struct pas_large_map_slot;
+typedef struct pas_large_map_slot pas_large_map_slot;
+
+/* Slots are only written with the heap lock held. The writer makes the version odd while it changes
+   the slot, so that readers can tell that they saw a torn slot and try again. */
+struct pas_large_map_slot {
+    unsigned version;
+    unsigned num_entries;
+    uintptr_t begin;
+    uintptr_t end;
+    pas_large_heap* heap;
+};
+
+PAS_API extern pas_large_map_slot* pas_large_map_first_level[PAS_LARGE_MAP_FIRST_LEVEL_SIZE];
+
 PAS_API pas_large_map_entry pas_large_map_find(uintptr_t begin);
 
+/* Called by pas_large_map_find_lock_free for collided slots. Grabs the heap lock. */
+PAS_API pas_large_map_entry pas_large_map_find_slow(uintptr_t begin);
+
+/* Like pas_large_map_find, but must be called without the heap lock. Racing with an add or take of
+   the same object gives the same answer as if we had grabbed the lock just before or just after
+   it. */
+static PAS_ALWAYS_INLINE pas_large_map_entry pas_large_map_find_lock_free(uintptr_t begin)
+{
+    pas_large_map_slot* second_level;
+    pas_large_map_slot* slot;
+    pas_large_map_entry result;
+
+    if (begin > PAS_MAX_ADDRESS)
+        return pas_large_map_entry_create_empty();
+
+    second_level = pas_large_map_first_level[
+        (begin >> PAS_LARGE_MAP_FIRST_LEVEL_SHIFT) & PAS_LARGE_MAP_FIRST_LEVEL_MASK];
+    if (!second_level)
+        return pas_large_map_entry_create_empty();
+
+    slot = second_level + ((begin >> PAS_LARGE_MAP_SECOND_LEVEL_SHIFT)
+                           & PAS_LARGE_MAP_SECOND_LEVEL_MASK);
+
+    for (;;) {
+        unsigned version;
+        uintptr_t depend;
+
+        version = slot->version;
+        depend = pas_depend(version);
+        if (version & 1)
+            continue;
+
+        result.begin = slot[depend].begin;
+        result.end = slot[depend].end;
+        result.heap = slot[depend].heap;
+        depend = pas_depend(result.begin + result.end + (uintptr_t)result.heap);
+
+        if (slot[depend].version == version)
+            break;
+    }
+
+    if (PAS_UNLIKELY(result.begin == PAS_LARGE_MAP_SLOT_COLLIDED))
+        return pas_large_map_find_slow(begin);
+    if (result.begin != begin)
+        return pas_large_map_entry_create_empty();
+    return result;
+}
+
 PAS_API void pas_large_map_add(pas_large_map_entry entry);
 PAS_API pas_large_map_entry pas_large_map_take(uintptr_t begin);
 
@@ -415,6 +415,16 @@ static PAS_ALWAYS_INLINE void pas_local_allocator_scan_bits_to_set_up_free_bits(
 
     allocator->current_word_is_valid = true;
 
+    if (pas_segregated_size_directory_count_refills) {
+        uintptr_t num_free_objects;
+        size_t index;
+        num_free_objects = 0;
+        for (index = full_alloc_bits.word_index_begin; index < full_alloc_bits.word_index_end; ++index)
+            num_free_objects += pas_popcount_uint32(((unsigned*)allocator->bits)[index]);
+        pas_segregated_size_directory_data_note_refill(
+            pas_segregated_size_directory_data_ptr_load_non_null(&directory->data), num_free_objects);
+    }
+
     switch (view_kind) {
     case pas_segregated_exclusive_view_kind: {
         uintptr_t full_num_non_empty_words_or_live_bytes = pas_segregated_size_directory_data_ptr_load_non_null(&directory->data)->full_num_non_empty_words_or_live_bytes;
@@ -768,6 +778,9 @@ pas_local_allocator_prepare_to_allocate(
         pas_local_allocator_make_bump(
             allocator, page_boundary, payload_begin, payload_end, page_config);
 
+        pas_segregated_size_directory_data_note_refill(
+            data, (payload_end - payload_begin) / allocator->object_size);
+
         pas_compiler_fence();
 
         full_alloc_bits = pas_compact_tagged_unsigned_ptr_load_non_null(&data->full_alloc_bits);
@@ -33,10 +33,113 @@
 #include <mach/mach_traps.h>
 #include <mach/thread_switch.h>
 #endif
+#if PAS_USE_SPINLOCKS && PAS_OS(LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 bool pas_lock_disallowed;
 
-#if PAS_USE_SPINLOCKS
+#if PAS_USE_SPINLOCKS && PAS_OS(LINUX)
+
+#define PAS_LOCK_DEFAULT_SPIN_LIMIT 256u
+#define PAS_LOCK_MIN_SPIN_LIMIT 16u
+#define PAS_LOCK_MAX_SPIN_LIMIT 4096u
+
+uintptr_t pas_lock_num_contended_locks;
+uintptr_t pas_lock_num_spin_acquisitions;
+uintptr_t pas_lock_num_parks;
+
+static void count(uintptr_t* counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+static unsigned get_spin_limit(pas_lock* lock)
+{
+    unsigned result;
+    result = lock->spin_limit;
+    if (!result)
+        return PAS_LOCK_DEFAULT_SPIN_LIMIT;
+    return result;
+}
+
+/* Only the spinning thread writes the spin limit, so this doesn't need to be atomic. We move the
+   limit by an eighth of the way to the target, so one unusually long or short hold doesn't throw it
+   off. The target is twice as long as it took us this time, so that we keep spinning long enough to
+   get the lock the next time it's held for about as long. */
+static void adapt_spin_limit(pas_lock* lock, unsigned target)
+{
+    unsigned limit;
+    limit = get_spin_limit(lock);
+    if (target > limit)
+        limit += (target - limit + 7) / 8;
+    else
+        limit -= (limit - target) / 8;
+    lock->spin_limit = (uint16_t)pas_min_uint32(
+        pas_max_uint32(limit, PAS_LOCK_MIN_SPIN_LIMIT), PAS_LOCK_MAX_SPIN_LIMIT);
+}
+
+static void futex_wait(uint32_t* word, uint32_t expected)
+{
+    /* This may return early for any reason (EINTR, EAGAIN); the caller just rechecks the lock. */
+    syscall(SYS_futex, word, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t* word, int count)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, NULL, NULL, 0);
+}
+
+PAS_NEVER_INLINE void pas_lock_lock_slow(pas_lock* lock)
+{
+    count(&pas_lock_num_contended_locks);
+
+    if (pas_compare_and_swap_bool_strong(&lock->is_spinning, false, true)) {
+        unsigned limit;
+        unsigned index;
+
+        limit = get_spin_limit(lock);
+
+        for (index = 0; index < limit; ++index) {
+            /* Spin on loads so we don't bounce the line around while someone holds the lock, and
+               don't steal the lock out from under parked threads' wakeups. */
+            if (__atomic_load_n(&lock->lock, __ATOMIC_RELAXED) == PAS_LOCK_UNLOCKED
+                && pas_compare_and_swap_uint32_weak(
+                    &lock->lock, PAS_LOCK_UNLOCKED, PAS_LOCK_LOCKED)) {
+                adapt_spin_limit(lock, 2 * (index + 1));
+                lock->is_spinning = false;
+                count(&pas_lock_num_spin_acquisitions);
+                return;
+            }
+            pas_compiler_fence();
+        }
+
+        /* Spinning didn't pay off, so spin less next time. */
+        adapt_spin_limit(lock, 0);
+        lock->is_spinning = false;
+    }
+
+    /* Once we park, we don't know if we were the last waiter, so we take the lock in the parked
+       state. That may cause a spurious wake, but never a lost one. */
+    while (__atomic_exchange_n(&lock->lock, PAS_LOCK_LOCKED_PARKED, __ATOMIC_SEQ_CST)
+           != PAS_LOCK_UNLOCKED) {
+        count(&pas_lock_num_parks);
+        futex_wait(&lock->lock, PAS_LOCK_LOCKED_PARKED);
+    }
+}
+
+PAS_NEVER_INLINE void pas_lock_unlock_slow(pas_lock* lock)
+{
+    uint32_t old_value;
+    old_value = __atomic_exchange_n(&lock->lock, PAS_LOCK_UNLOCKED, __ATOMIC_SEQ_CST);
+    PAS_ASSERT(old_value == PAS_LOCK_LOCKED_PARKED || old_value == PAS_LOCK_LOCKED);
+    if (old_value == PAS_LOCK_LOCKED_PARKED)
+        futex_wake(&lock->lock, 1);
+}
+
+#elif PAS_USE_SPINLOCKS
 
 PAS_NEVER_INLINE void pas_lock_lock_slow(pas_lock* lock)
 {
@@ -53,7 +53,93 @@ typedef enum pas_lock_lock_mode pas_lock_lock_mode;
 
 PAS_END_EXTERN_C;
 
-#if PAS_USE_SPINLOCKS
+#if PAS_USE_SPINLOCKS && PAS_OS(LINUX)
+
+PAS_BEGIN_EXTERN_C;
+
+/* On Linux, contended locks park on a futex instead of yielding, so that oversubscribed processes
+   don't burn their CPU time in sched_yield() storms.
+
+   The lock word is PAS_LOCK_UNLOCKED, PAS_LOCK_LOCKED, or PAS_LOCK_LOCKED_PARKED when there may be
+   threads parked on it, in which case unlocking has to wake one of them. Before parking, one thread
+   at a time spins. How long it spins adapts to how long it has usually taken for this lock to come
+   free. */
+
+#define PAS_LOCK_UNLOCKED 0u
+#define PAS_LOCK_LOCKED 1u
+#define PAS_LOCK_LOCKED_PARKED 2u
+
+struct pas_lock;
+typedef struct pas_lock pas_lock;
+
+struct pas_lock {
+    uint32_t lock;
+    bool is_spinning;
+    uint16_t spin_limit; /* Zero means that we haven't adapted yet. */
+};
+
+/* Contention counters for all locks, for diagnostics. They are updated racily. */
+PAS_API extern uintptr_t pas_lock_num_contended_locks;
+PAS_API extern uintptr_t pas_lock_num_spin_acquisitions;
+PAS_API extern uintptr_t pas_lock_num_parks;
+
+#define PAS_LOCK_INITIALIZER ((pas_lock){ \
+        .lock = PAS_LOCK_UNLOCKED, .is_spinning = false, .spin_limit = 0 })
+
+static inline void pas_lock_construct(pas_lock* lock)
+{
+    *lock = PAS_LOCK_INITIALIZER;
+}
+
+static inline void pas_lock_construct_disabled(pas_lock* lock)
+{
+    *lock = PAS_LOCK_INITIALIZER;
+    lock->lock = PAS_LOCK_LOCKED; /* Using the lock wrong will just park forever. */
+}
+
+PAS_API PAS_NEVER_INLINE void pas_lock_lock_slow(pas_lock* lock);
+PAS_API PAS_NEVER_INLINE void pas_lock_unlock_slow(pas_lock* lock);
+
+static inline void pas_lock_lock(pas_lock* lock)
+{
+    PAS_TESTING_ASSERT(!pas_lock_disallowed);
+    pas_race_test_will_lock(lock);
+    if (!pas_compare_and_swap_uint32_weak(&lock->lock, PAS_LOCK_UNLOCKED, PAS_LOCK_LOCKED))
+        pas_lock_lock_slow(lock);
+    pas_race_test_did_lock(lock);
+}
+
+static inline bool pas_lock_try_lock(pas_lock* lock)
+{
+    PAS_TESTING_ASSERT(!pas_lock_disallowed);
+    bool result;
+    result = pas_compare_and_swap_uint32_strong(
+        &lock->lock, PAS_LOCK_UNLOCKED, PAS_LOCK_LOCKED) == PAS_LOCK_UNLOCKED;
+    if (result)
+        pas_race_test_did_try_lock(lock);
+    return result;
+}
+
+static inline void pas_lock_unlock(pas_lock* lock)
+{
+    pas_race_test_will_unlock(lock);
+    if (!pas_compare_and_swap_uint32_weak(&lock->lock, PAS_LOCK_LOCKED, PAS_LOCK_UNLOCKED))
+        pas_lock_unlock_slow(lock);
+}
+
+static inline void pas_lock_assert_held(pas_lock* lock)
+{
+    PAS_ASSERT(lock->lock != PAS_LOCK_UNLOCKED);
+}
+
+static inline void pas_lock_testing_assert_held(pas_lock* lock)
+{
+    PAS_TESTING_ASSERT(lock->lock != PAS_LOCK_UNLOCKED);
+}
+
+PAS_END_EXTERN_C;
+
+#elif PAS_USE_SPINLOCKS
 
 PAS_BEGIN_EXTERN_C;
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "pas_numa.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if PAS_OS(LINUX)
+#include <sys/syscall.h>
+#endif /* PAS_OS(LINUX) */
+
+bool pas_numa_prefer_local_pages = false;
+
+#if PAS_OS(LINUX)
+/* These come from linux/mempolicy.h. We spell them out so we don't need libnuma's numaif.h. */
+#define PAS_NUMA_MPOL_F_NODE 1
+#define PAS_NUMA_MPOL_F_ADDR 2
+
+static unsigned compute_num_nodes(void)
+{
+    char buf[256];
+    int fd;
+    ssize_t size;
+    unsigned result;
+    char* ptr;
+
+    fd = open("/sys/devices/system/node/online", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 1;
+    size = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (size <= 0)
+        return 1;
+    buf[size] = 0;
+
+    /* The file has a list of ranges, like "0-1,3". */
+    result = 0;
+    ptr = buf;
+    for (;;) {
+        unsigned long begin;
+        unsigned long end;
+        char* end_ptr;
+
+        begin = strtoul(ptr, &end_ptr, 10);
+        if (end_ptr == ptr)
+            break;
+        ptr = end_ptr;
+        end = begin;
+        if (*ptr == '-') {
+            ptr++;
+            end = strtoul(ptr, &end_ptr, 10);
+            if (end_ptr == ptr || end < begin)
+                break;
+            ptr = end_ptr;
+        }
+        result += (unsigned)(end - begin + 1);
+        if (*ptr != ',')
+            break;
+        ptr++;
+    }
+
+    return pas_max_uint32(result, 1);
+}
+#endif /* PAS_OS(LINUX) */
+
+unsigned pas_numa_num_nodes(void)
+{
+#if PAS_OS(LINUX)
+    static unsigned num_nodes = 0;
+    unsigned result;
+
+    result = num_nodes;
+    if (!result) {
+        result = compute_num_nodes();
+        num_nodes = result;
+    }
+    return result;
+#else /* PAS_OS(LINUX) -> so !PAS_OS(LINUX) */
+    return 1;
+#endif /* !PAS_OS(LINUX) */
+}
+
+bool pas_numa_enable_local_page_preference(void)
+{
+    if (pas_numa_num_nodes() <= 1)
+        return false;
+    pas_numa_prefer_local_pages = true;
+    return true;
+}
+
+unsigned pas_numa_get_current_node(void)
+{
+#if PAS_OS(LINUX)
+    unsigned cpu;
+    unsigned node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL))
+        return 0;
+    return node;
+#else /* PAS_OS(LINUX) -> so !PAS_OS(LINUX) */
+    return 0;
+#endif /* !PAS_OS(LINUX) */
+}
+
+bool pas_numa_get_page_node(void* page, unsigned* node)
+{
+#if PAS_OS(LINUX)
+    int result;
+    if (syscall(SYS_get_mempolicy, &result, NULL, 0, page,
+                PAS_NUMA_MPOL_F_NODE | PAS_NUMA_MPOL_F_ADDR))
+        return false;
+    PAS_ASSERT(result >= 0);
+    *node = (unsigned)result;
+    return true;
+#else /* PAS_OS(LINUX) -> so !PAS_OS(LINUX) */
+    PAS_UNUSED_PARAM(page);
+    PAS_UNUSED_PARAM(node);
+    return false;
+#endif /* !PAS_OS(LINUX) */
+}
+
+#endif /* LIBPAS_ENABLED */
+
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef PAS_NUMA_H
+#define PAS_NUMA_H
+
+#include "pas_utils.h"
+
+PAS_BEGIN_EXTERN_C;
+
+/* How many remote pages a local allocator will pass over, when looking for an eligible page, before
+   it gives up and takes whatever it finds next. This bounds how many get_mempolicy calls a refill
+   can do and how far it can wander away from the front of the directory. */
+#define PAS_NUMA_MAX_REMOTE_SKIPS 8u
+
+/* If true, local allocators prefer eligible pages that were committed on the NUMA node that the
+   allocating thread is running on. Off by default. Use pas_numa_enable_local_page_preference() to
+   turn it on, which only does it if the machine has more than one node. */
+PAS_API extern bool pas_numa_prefer_local_pages;
+
+PAS_API unsigned pas_numa_num_nodes(void);
+
+/* Returns true if local page preference got turned on. */
+PAS_API bool pas_numa_enable_local_page_preference(void);
+
+PAS_API unsigned pas_numa_get_current_node(void);
+
+/* Tells what node the given page is on, or returns false if we cannot tell. Only ask about pages
+   that are committed, since asking about a page that was never touched will fault it in. */
+PAS_API bool pas_numa_get_page_node(void* page, unsigned* node);
+
+PAS_END_EXTERN_C;
+
+#endif /* PAS_NUMA_H */
+
@@ -42,6 +42,11 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #endif
+#if PAS_OS(LINUX)
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "pas_lock.h"
+#endif
 #if PAS_OS(DARWIN)
 #include <mach/vm_page_size.h>
 #include <mach/vm_statistics.h>
@@ -55,6 +60,9 @@ size_t pas_page_malloc_cached_alignment_shift;
 bool pas_page_malloc_decommit_zero_fill = false;
 #endif /* PAS_OS(DARWIN) */
 
+pas_huge_page_mode pas_page_malloc_huge_page_mode = pas_no_huge_pages;
+bool pas_page_malloc_decommit_lazily = false;
+
 #if PAS_OS(LINUX)
 #define PAS_NORESERVE MAP_NORESERVE
 #else
@@ -194,6 +202,88 @@ pas_page_malloc_try_allocate_without_deallocating_padding(
     return result;
 }
 
+#if PAS_OS(LINUX)
+static void advise_huge_pages(uintptr_t begin, uintptr_t end)
+{
+    begin = pas_round_up_to_power_of_2(begin, PAS_HUGE_PAGE_SIZE);
+    end = pas_round_down_to_power_of_2(end, PAS_HUGE_PAGE_SIZE);
+    if (begin >= end)
+        return;
+    /* This fails if THP is disabled system-wide. That's fine; we just don't get huge pages. */
+    if (madvise((void*)begin, end - begin, MADV_HUGEPAGE))
+        errno = 0;
+}
+
+static pas_aligned_allocation_result try_allocate_hugetlb(size_t size, pas_commit_mode commit_mode)
+{
+    size_t mapped_size;
+    void* mmap_result;
+    pas_aligned_allocation_result result;
+
+    pas_zero_memory(&result, sizeof(result));
+
+    mapped_size = pas_round_up_to_power_of_2(size, PAS_HUGE_PAGE_SIZE);
+    if (mapped_size < size)
+        return result;
+
+    mmap_result = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANON | MAP_HUGETLB | PAS_NORESERVE, -1, 0);
+    if (mmap_result == MAP_FAILED) {
+        errno = 0;
+        return result;
+    }
+    PAS_ASSERT(pas_is_aligned((uintptr_t)mmap_result, PAS_HUGE_PAGE_SIZE));
+
+    if (commit_mode == pas_decommitted)
+        pas_page_malloc_decommit(mmap_result, mapped_size, pas_may_mmap);
+
+    pas_page_malloc_num_allocated_bytes += mapped_size;
+
+    result.result = mmap_result;
+    result.result_size = size;
+    result.left_padding = mmap_result;
+    result.left_padding_size = 0;
+    result.right_padding = (char*)mmap_result + size;
+    result.right_padding_size = mapped_size - size;
+    result.zero_mode = pas_zero_mode_is_all_zero;
+    return result;
+}
+#endif /* PAS_OS(LINUX) */
+
+pas_aligned_allocation_result
+pas_page_malloc_try_allocate_huge_without_deallocating_padding(
+    size_t size, pas_alignment alignment, pas_commit_mode commit_mode)
+{
+#if PAS_OS(LINUX)
+    pas_aligned_allocation_result result;
+
+    pas_alignment_validate(alignment);
+
+    if (pas_page_malloc_huge_page_mode == pas_no_huge_pages
+        || alignment.alignment_begin
+        || alignment.alignment > PAS_HUGE_PAGE_SIZE) {
+        return pas_page_malloc_try_allocate_without_deallocating_padding(
+            size, alignment, commit_mode);
+    }
+
+    if (pas_page_malloc_huge_page_mode == pas_hugetlb_huge_pages) {
+        result = try_allocate_hugetlb(size, commit_mode);
+        if (result.result)
+            return result;
+    }
+
+    result = pas_page_malloc_try_allocate_without_deallocating_padding(
+        size, pas_alignment_create_traditional(PAS_HUGE_PAGE_SIZE), commit_mode);
+    if (result.result) {
+        advise_huge_pages((uintptr_t)result.left_padding,
+                          (uintptr_t)result.right_padding + result.right_padding_size);
+    }
+    return result;
+#else /* PAS_OS(LINUX) -> so !PAS_OS(LINUX) */
+    return pas_page_malloc_try_allocate_without_deallocating_padding(size, alignment, commit_mode);
+#endif /* !PAS_OS(LINUX) */
+}
+
 void pas_page_malloc_zero_fill(void* base, size_t size)
 {
     size_t page_size;
@@ -246,6 +336,37 @@ bool pas_page_malloc_lock(void* base, size_t size)
     return true;
 }
 
+#if PAS_OS(LINUX)
+/* Returns false if there is nothing left to decommit. */
+static bool trim_to_huge_pages(uintptr_t* begin, uintptr_t* end)
+{
+    if (pas_page_malloc_huge_page_mode == pas_no_huge_pages)
+        return *begin < *end;
+    *begin = pas_round_up_to_power_of_2(*begin, PAS_HUGE_PAGE_SIZE);
+    *end = pas_round_down_to_power_of_2(*end, PAS_HUGE_PAGE_SIZE);
+    return *begin < *end;
+}
+
+static int decommit_advice(void)
+{
+#ifdef MADV_FREE
+    if (pas_page_malloc_decommit_lazily)
+        return MADV_FREE;
+#endif
+    return MADV_DONTNEED;
+}
+
+static void linux_decommit(uintptr_t begin, uintptr_t end)
+{
+    int advice;
+    advice = decommit_advice();
+    if (advice != MADV_DONTNEED && !madvise((void*)begin, end - begin, advice))
+        return;
+    errno = 0;
+    PAS_SYSCALL(madvise((void*)begin, end - begin, MADV_DONTNEED));
+}
+#endif /* PAS_OS(LINUX) */
+
 #ifndef _WIN32
 static void posix_decommit(void* ptr, size_t size, pas_mmap_capability mmap_capability)
 {
@@ -261,6 +382,14 @@ static void posix_decommit(void* ptr, size_t size, pas_mmap_capability mmap_capa
             pas_log("Going down Darwin madvise path.\n");
         PAS_SYSCALL(madvise(ptr, size, MADV_FREE_REUSABLE));
     }
+#elif PAS_OS(LINUX)
+    uintptr_t begin;
+    uintptr_t end;
+    begin = (uintptr_t)ptr;
+    end = begin + size;
+    if (!trim_to_huge_pages(&begin, &end))
+        return;
+    linux_decommit(begin, end);
 #else
     PAS_SYSCALL(madvise(ptr, size, MADV_DONTNEED));
 #endif
@@ -487,6 +616,144 @@ void pas_page_malloc_decommit_without_mprotect(void* ptr, size_t size, pas_mmap_
     decommit_impl(ptr, size, do_mprotect, mmap_capability);
 }
 
+#if PAS_OS(LINUX) && defined(SYS_process_madvise) && defined(SYS_pidfd_open)
+#define PAS_PAGE_MALLOC_HAVE_PROCESS_MADVISE 1
+
+/* It's not worth the syscall overhead of getting the pidfd for tiny batches. */
+#define PAS_PAGE_MALLOC_MIN_RANGES_FOR_PROCESS_MADVISE 4
+
+static bool process_madvise_is_unavailable = false;
+static pas_lock self_pidfd_lock = PAS_LOCK_INITIALIZER;
+static int self_pidfd = -1;
+static pid_t self_pidfd_pid = 0;
+
+static int get_self_pidfd(void)
+{
+    int result;
+    pid_t pid;
+
+    pid = getpid();
+    pas_lock_lock(&self_pidfd_lock);
+    if (self_pidfd_pid != pid) {
+        /* We're either getting the pidfd for the first time or we're in a forked child, in which
+           case the pidfd we have refers to our parent. Madvising through that would be bad. */
+        if (self_pidfd >= 0)
+            close(self_pidfd);
+        self_pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+        self_pidfd_pid = pid;
+    }
+    result = self_pidfd;
+    pas_lock_unlock(&self_pidfd_lock);
+    return result;
+}
+
+static bool try_process_madvise(pas_page_malloc_decommit_batch* batch)
+{
+    struct iovec iovecs[PAS_PAGE_MALLOC_DECOMMIT_BATCH_CAPACITY];
+    size_t index;
+    size_t total_size;
+    ssize_t result;
+    size_t remaining;
+    int pidfd;
+
+    if (process_madvise_is_unavailable)
+        return false;
+
+    pidfd = get_self_pidfd();
+    if (pidfd < 0) {
+        errno = 0;
+        process_madvise_is_unavailable = true;
+        return false;
+    }
+
+    total_size = 0;
+    for (index = 0; index < batch->num_ranges; ++index) {
+        iovecs[index].iov_base = (void*)batch->ranges[index].begin;
+        iovecs[index].iov_len = pas_range_size(batch->ranges[index]);
+        total_size += iovecs[index].iov_len;
+    }
+
+    result = syscall(SYS_process_madvise, pidfd, iovecs, batch->num_ranges, decommit_advice(), 0);
+    if (result < 0) {
+        /* Kernels before 6.13 only allow a few advice values here, and MADV_FREE isn't allowed on
+           some memory. Either way, don't bother trying again. */
+        errno = 0;
+        process_madvise_is_unavailable = true;
+        return false;
+    }
+
+    /* A short result means the kernel stopped partway. Do the rest the slow way. */
+    remaining = total_size - (size_t)result;
+    for (index = batch->num_ranges; remaining && index--;) {
+        pas_range range;
+        range = batch->ranges[index];
+        if (pas_range_size(range) > remaining)
+            range.begin = range.end - remaining;
+        remaining -= pas_range_size(range);
+        linux_decommit(range.begin, range.end);
+    }
+
+    return true;
+}
+#else /* PAS_OS(LINUX) && defined(SYS_process_madvise) && defined(SYS_pidfd_open) -> so not that */
+#define PAS_PAGE_MALLOC_HAVE_PROCESS_MADVISE 0
+#endif /* not (PAS_OS(LINUX) && defined(SYS_process_madvise) && defined(SYS_pidfd_open)) */
+
+void pas_page_malloc_decommit_batch_construct(pas_page_malloc_decommit_batch* batch)
+{
+    batch->num_ranges = 0;
+}
+
+void pas_page_malloc_decommit_batch_add(
+    pas_page_malloc_decommit_batch* batch, void* base, size_t size,
+    pas_mmap_capability mmap_capability)
+{
+#if PAS_OS(LINUX)
+    uintptr_t begin;
+    uintptr_t end;
+
+    begin = (uintptr_t)base;
+    end = begin + size;
+    PAS_ASSERT(end >= begin);
+    PAS_ASSERT(pas_is_aligned(begin, pas_page_malloc_alignment()));
+    PAS_ASSERT(pas_is_aligned(end, pas_page_malloc_alignment()));
+
+    if (mmap_capability == pas_mmap_hard || should_mprotect_posix(true, mmap_capability)) {
+        pas_page_malloc_decommit(base, size, mmap_capability);
+        return;
+    }
+
+    if (!trim_to_huge_pages(&begin, &end))
+        return;
+
+    if (batch->num_ranges == PAS_PAGE_MALLOC_DECOMMIT_BATCH_CAPACITY)
+        pas_page_malloc_decommit_batch_flush(batch);
+    batch->ranges[batch->num_ranges++] = pas_range_create(begin, end);
+#else /* PAS_OS(LINUX) -> so !PAS_OS(LINUX) */
+    PAS_UNUSED_PARAM(batch);
+    pas_page_malloc_decommit(base, size, mmap_capability);
+#endif /* !PAS_OS(LINUX) */
+}
+
+void pas_page_malloc_decommit_batch_flush(pas_page_malloc_decommit_batch* batch)
+{
+#if PAS_OS(LINUX)
+    size_t index;
+
+#if PAS_PAGE_MALLOC_HAVE_PROCESS_MADVISE
+    if (batch->num_ranges >= PAS_PAGE_MALLOC_MIN_RANGES_FOR_PROCESS_MADVISE
+        && try_process_madvise(batch)) {
+        batch->num_ranges = 0;
+        return;
+    }
+#endif /* PAS_PAGE_MALLOC_HAVE_PROCESS_MADVISE */
+
+    for (index = 0; index < batch->num_ranges; ++index)
+        linux_decommit(batch->ranges[index].begin, batch->ranges[index].end);
+#endif /* PAS_OS(LINUX) */
+    batch->num_ranges = 0;
+}
+
 void pas_page_malloc_deallocate(void* ptr, size_t size)
 {
     uintptr_t ptr_as_int;
@@ -30,7 +30,9 @@
 #include "pas_aligned_allocation_result.h"
 #include "pas_alignment.h"
 #include "pas_commit_mode.h"
+#include "pas_huge_page_mode.h"
 #include "pas_mmap_capability.h"
+#include "pas_range.h"
 #include "pas_utils.h"
 
 PAS_BEGIN_EXTERN_C;
@@ -42,6 +44,24 @@ PAS_API extern size_t pas_page_malloc_cached_alignment_shift;
 PAS_API extern bool pas_page_malloc_decommit_zero_fill;
 #endif /* PAS_OS(DARWIN) */
 
+#define PAS_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+/* This is pas_no_huge_pages by default. Other modes only do anything on Linux, and only affect
+   memory allocated with pas_page_malloc_try_allocate_huge_without_deallocating_padding - but they
+   change how all decommits work: we only decommit the whole huge pages inside the range we are
+   asked to decommit, and leave the rest committed. Otherwise, every decommit of part of a huge page
+   would make the kernel split it up (or fail, for hugetlb pages). Decommitting hugetlb pages needs
+   Linux 5.18 or later.
+   
+   Set this before allocating heap memory and never change it after. */
+PAS_API extern pas_huge_page_mode pas_page_malloc_huge_page_mode;
+
+/* If true, decommit on Linux uses MADV_FREE, so the kernel only takes the pages back once it needs
+   the memory. That's cheaper than MADV_DONTNEED, but RSS stays up until then. Like with
+   MADV_FREE_REUSABLE on Darwin, pages may or may not come back zeroed, which libpas never relies
+   on. Falls back to MADV_DONTNEED for memory that MADV_FREE doesn't support, like hugetlb pages. */
+PAS_API extern bool pas_page_malloc_decommit_lazily;
+
 PAS_API PAS_NEVER_INLINE size_t pas_page_malloc_alignment_slow(void);
 
 static inline size_t pas_page_malloc_alignment(void)
@@ -82,6 +102,14 @@ PAS_API pas_aligned_allocation_result
 pas_page_malloc_try_allocate_without_deallocating_padding(
     size_t size, pas_alignment alignment, pas_commit_mode commit_mode);
 
+/* Like pas_page_malloc_try_allocate_without_deallocating_padding, but backs the memory with huge
+   pages according to pas_page_malloc_huge_page_mode. The result is PAS_HUGE_PAGE_SIZE aligned and
+   the right padding extends it to a whole number of huge pages, so callers that keep their padding
+   (like the reservation free heap) get to fill up the huge pages they asked for. */
+PAS_API pas_aligned_allocation_result
+pas_page_malloc_try_allocate_huge_without_deallocating_padding(
+    size_t size, pas_alignment alignment, pas_commit_mode commit_mode);
+
 PAS_API void pas_page_malloc_deallocate(void* base, size_t size);
 
 PAS_API void pas_page_malloc_zero_fill(void* base, size_t size);
@@ -108,6 +136,30 @@ PAS_API void pas_page_malloc_commit_without_mprotect(
 PAS_API void pas_page_malloc_decommit_without_mprotect(
     void* base, size_t size, pas_mmap_capability mmap_capability);
 
+#define PAS_PAGE_MALLOC_DECOMMIT_BATCH_CAPACITY 64
+
+/* Collects ranges to decommit so that the OS can be told about them all at once. On Linux, this
+   turns into vectored process_madvise calls (if the kernel lets us use it on ourselves, which needs
+   Linux 6.13), so we take mmap_lock once per batch rather than once per range. Ranges that need
+   more than an madvise, because they get mprotected or munlocked, are decommitted as soon as they
+   are added.
+   
+   Adding ranges and then flushing is the same as calling pas_page_malloc_decommit on each of them.
+   Nothing is guaranteed to be decommitted until the flush. */
+struct pas_page_malloc_decommit_batch;
+typedef struct pas_page_malloc_decommit_batch pas_page_malloc_decommit_batch;
+
+struct pas_page_malloc_decommit_batch {
+    size_t num_ranges;
+    pas_range ranges[PAS_PAGE_MALLOC_DECOMMIT_BATCH_CAPACITY];
+};
+
+PAS_API void pas_page_malloc_decommit_batch_construct(pas_page_malloc_decommit_batch* batch);
+PAS_API void pas_page_malloc_decommit_batch_add(
+    pas_page_malloc_decommit_batch* batch, void* base, size_t size,
+    pas_mmap_capability mmap_capability);
+PAS_API void pas_page_malloc_decommit_batch_flush(pas_page_malloc_decommit_batch* batch);
+
 PAS_END_EXTERN_C;
 
 #endif /* PAS_PAGE_MALLOC_H */
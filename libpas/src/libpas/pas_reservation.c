@@ -42,7 +42,10 @@ pas_commit_mode pas_reservation_commit_mode = pas_committed;
 
 pas_aligned_allocation_result pas_reservation_try_allocate_without_deallocating_padding(size_t size, pas_alignment alignment)
 {
-    return pas_enumerable_page_malloc_try_allocate_without_deallocating_padding(size, alignment, pas_reservation_commit_mode);
+    /* Reservations are where all of the heaps get their memory from, so this is where we ask for
+       huge pages, if we were told to. */
+    return pas_enumerable_page_malloc_try_allocate_huge_without_deallocating_padding(
+        size, alignment, pas_reservation_commit_mode);
 }
 
 void pas_reservation_commit(void* base, size_t size, pas_mmap_capability mmap_capability)
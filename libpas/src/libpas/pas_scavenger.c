@@ -45,6 +45,7 @@
 #include "pas_status_reporter.h"
 #include "pas_thread_local_cache.h"
 #include "pas_utility_heap.h"
+#include "verse_heap.h"
 #include "verse_heap_mark_bits_page_commit_controller.h"
 #include <stdio.h>
 #ifndef _WIN32
@@ -63,6 +64,12 @@ pas_scavenger_data* pas_scavenger_data_instance = NULL;
 double pas_scavenger_deep_sleep_timeout_in_milliseconds = 10. * 1000.;
 double pas_scavenger_period_in_milliseconds = 125.;
 uint64_t pas_scavenger_max_epoch_delta = 300ll * 1000ll * 1000ll;
+pas_scavenger_memory_pressure pas_scavenger_current_memory_pressure =
+    pas_scavenger_normal_memory_pressure;
+
+/* How much faster (or slower) the scavenger goes under high (or low) memory pressure. */
+#define PAS_SCAVENGER_PRESSURE_PERIOD_SCALE 4.
+#define PAS_SCAVENGER_LOW_PRESSURE_EPOCH_DELTA_SCALE 10
 
 #if PAS_OS(DARWIN)
 static _Atomic qos_class_t pas_scavenger_requested_qos_class = QOS_CLASS_USER_INITIATED;
@@ -108,6 +115,35 @@ static pas_scavenger_data* ensure_data_instance(pas_lock_hold_mode heap_lock_hol
     return instance;
 }
 
+static double period_in_milliseconds(void)
+{
+    switch (pas_scavenger_current_memory_pressure) {
+    case pas_scavenger_low_memory_pressure:
+        return pas_scavenger_period_in_milliseconds * PAS_SCAVENGER_PRESSURE_PERIOD_SCALE;
+    case pas_scavenger_normal_memory_pressure:
+        return pas_scavenger_period_in_milliseconds;
+    case pas_scavenger_high_memory_pressure:
+        return pas_scavenger_period_in_milliseconds / PAS_SCAVENGER_PRESSURE_PERIOD_SCALE;
+    }
+    PAS_ASSERT(!"Should not be reached");
+    return 0.;
+}
+
+static uint64_t max_epoch_delta(void)
+{
+    switch (pas_scavenger_current_memory_pressure) {
+    case pas_scavenger_low_memory_pressure:
+        return pas_scavenger_max_epoch_delta * PAS_SCAVENGER_LOW_PRESSURE_EPOCH_DELTA_SCALE;
+    case pas_scavenger_normal_memory_pressure:
+        return pas_scavenger_max_epoch_delta;
+    case pas_scavenger_high_memory_pressure:
+        /* Anything that is free right now is fair game. */
+        return 0;
+    }
+    PAS_ASSERT(!"Should not be reached");
+    return 0;
+}
+
 static bool handle_expendable_memory(pas_expendable_memory_scavenge_kind kind)
 {
     bool should_go_again = false;
@@ -214,7 +250,7 @@ static pas_thread_return_type scavenger_thread_main(void* arg)
            This code is engineered to kind of limp along when the epoch is a counter, but it doesn't
            actually achieve its full purpose unless the epoch really is time. */
         epoch = pas_get_epoch();
-        delta = pas_scavenger_max_epoch_delta;
+        delta = max_epoch_delta();
 
         did_overflow = pas_sub_uint64_overflow(epoch, delta, &max_epoch);
         if (did_overflow)
@@ -223,6 +259,9 @@ static pas_thread_return_type scavenger_thread_main(void* arg)
         if (verbose)
             pas_log("epoch = %llu, delta = %llu, max_epoch = %llu\n", (unsigned long long)epoch, (unsigned long long)delta, (unsigned long long)max_epoch);
 
+        should_go_again |= verse_heap_large_cache_scavenge_periodic(max_epoch);
+        verse_heap_reserve_trim();
+
         scavenge_result = pas_physical_page_sharing_pool_scavenge(max_epoch);
 
         switch (scavenge_result.take_result) {
@@ -273,10 +312,6 @@ static pas_thread_return_type scavenger_thread_main(void* arg)
         if (verbose)
             pas_log("Finished a round of scavenging at %.2lf.\n", time_in_milliseconds);
         
-        /* By default we need to sleep for a short while and then try again. */
-        absolute_timeout_in_milliseconds_for_period_sleep =
-            time_in_milliseconds + pas_scavenger_period_in_milliseconds;
-
         if (should_go_again) {
             if (verbose)
                 pas_log("Waiting for a period.\n");
@@ -318,8 +353,15 @@ static pas_thread_return_type scavenger_thread_main(void* arg)
             }
         }
         
-        while (pas_get_time_in_milliseconds_for_system_condition() < absolute_timeout_in_milliseconds_for_period_sleep
-               && !pas_scavenger_should_suspend_count) {
+        /* By default we need to sleep for a short while and then try again. The period depends on
+           memory pressure, which may change while we sleep, so recompute it every time we wake. */
+        for (;;) {
+            absolute_timeout_in_milliseconds_for_period_sleep =
+                time_in_milliseconds + period_in_milliseconds();
+            if (pas_scavenger_should_suspend_count
+                || pas_get_time_in_milliseconds_for_system_condition()
+                   >= absolute_timeout_in_milliseconds_for_period_sleep)
+                break;
             pas_system_condition_timed_wait(
                 &data->cond, &data->lock,
                 absolute_timeout_in_milliseconds_for_period_sleep);
@@ -424,6 +466,26 @@ done:
     pas_status_reporter_start_if_necessary();
 }
 
+void pas_scavenger_set_memory_pressure(pas_scavenger_memory_pressure pressure)
+{
+    pas_scavenger_data* data;
+
+    if (pas_scavenger_current_memory_pressure == pressure)
+        return;
+
+    data = ensure_data_instance(pas_lock_is_not_held);
+    pas_system_mutex_lock(&data->lock);
+    pas_scavenger_current_memory_pressure = pressure;
+    /* Wake up the scavenger if it's sleeping for a period, so that it picks up the new period. */
+    pas_system_condition_broadcast(&data->cond);
+    pas_system_mutex_unlock(&data->lock);
+
+    if (pressure == pas_scavenger_high_memory_pressure) {
+        pas_scavenger_did_create_eligible();
+        pas_scavenger_notify_eligibility_if_needed();
+    }
+}
+
 void pas_scavenger_suspend(void)
 {
     pas_scavenger_data* data;
@@ -532,6 +594,9 @@ size_t pas_scavenger_decommit_free_memory(void)
 {
     pas_page_sharing_pool_scavenge_result result;
 
+    verse_heap_large_cache_flush();
+    verse_heap_reserve_trim();
+
     result = pas_physical_page_sharing_pool_scavenge(PAS_EPOCH_MAX);
     
     PAS_ASSERT(result.take_result == pas_page_sharing_pool_take_none_available);
@@ -43,6 +43,33 @@ enum pas_scavenger_state {
 
 typedef enum pas_scavenger_state pas_scavenger_state;
 
+/* How badly the system wants memory back, as told to us by whoever is watching for that. Under high
+   pressure, the scavenger runs more often and decommits free pages as soon as it finds them. Under
+   low pressure, it runs less often and lets free pages sit around for longer, since somebody is
+   likely to want them again. */
+enum pas_scavenger_memory_pressure {
+    pas_scavenger_low_memory_pressure,
+    pas_scavenger_normal_memory_pressure,
+    pas_scavenger_high_memory_pressure
+};
+
+typedef enum pas_scavenger_memory_pressure pas_scavenger_memory_pressure;
+
+static inline const char*
+pas_scavenger_memory_pressure_get_string(pas_scavenger_memory_pressure pressure)
+{
+    switch (pressure) {
+    case pas_scavenger_low_memory_pressure:
+        return "low";
+    case pas_scavenger_normal_memory_pressure:
+        return "normal";
+    case pas_scavenger_high_memory_pressure:
+        return "high";
+    }
+    PAS_ASSERT(!"Should not be reached");
+    return NULL;
+}
+
 struct pas_scavenger_data;
 typedef struct pas_scavenger_data pas_scavenger_data;
 
@@ -67,6 +94,12 @@ PAS_API extern double pas_scavenger_period_in_milliseconds; /* How long to sleep
 PAS_API extern uint64_t pas_scavenger_max_epoch_delta; /* How much to subtract from the current epoch
                                                           to compute the max epoch. */
 
+PAS_API extern pas_scavenger_memory_pressure pas_scavenger_current_memory_pressure;
+
+/* It's legal to call this anytime. Raising the pressure to high wakes up the scavenger (or starts
+   it, if it had shut down) so that it can start decommitting right away. */
+PAS_API void pas_scavenger_set_memory_pressure(pas_scavenger_memory_pressure pressure);
+
 #if PAS_OS(DARWIN)
 /* It's legal to set this anytime. */
 PAS_API void pas_scavenger_set_requested_qos_class(qos_class_t);
@@ -44,6 +44,8 @@
 #include "pas_thread_local_cache_layout.h"
 #include "pas_utility_heap.h"
 
+bool pas_segregated_size_directory_count_refills = false;
+
 pas_segregated_size_directory* pas_segregated_size_directory_create(
     pas_segregated_heap* heap,
     unsigned object_size,
@@ -211,6 +213,8 @@ pas_segregated_size_directory_data* pas_segregated_size_directory_ensure_data(
     data->offset_from_page_boundary_to_first_object = 0;
     data->offset_from_page_boundary_to_end_of_last_object = 0;
     data->full_num_non_empty_words_or_live_bytes = 0;
+    data->num_refills = 0;
+    data->num_refilled_objects = 0;
 
     pas_fence();
 
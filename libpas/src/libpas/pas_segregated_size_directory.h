@@ -102,6 +102,14 @@ struct pas_segregated_size_directory_data {
     unsigned full_num_non_empty_words_or_live_bytes;
 
     pas_compact_tagged_unsigned_ptr full_alloc_bits; /* Precomputed alloc bits in the case that a page is empty. */
+
+    /* Refill statistics for the status reporter. These only get updated if
+       pas_segregated_size_directory_count_refills is set, and they get updated once per refill, so
+       they are not on the allocation fast path. Together they tell you the allocation rate for the
+       size class: every object handed to a local allocator is going to be allocated unless the
+       allocator gets stopped first. */
+    uintptr_t num_refills;
+    uintptr_t num_refilled_objects;
 };
 
 struct pas_extended_segregated_size_directory_data {
@@ -109,6 +117,18 @@ struct pas_extended_segregated_size_directory_data {
     pas_compact_tagged_page_granule_use_count_ptr full_use_counts;
 };
 
+PAS_API extern bool pas_segregated_size_directory_count_refills;
+
+static inline void pas_segregated_size_directory_data_note_refill(
+    pas_segregated_size_directory_data* data,
+    uintptr_t num_objects)
+{
+    if (PAS_LIKELY(!pas_segregated_size_directory_count_refills))
+        return;
+    pas_atomic_exchange_add_uintptr(&data->num_refills, 1);
+    pas_atomic_exchange_add_uintptr(&data->num_refilled_objects, num_objects);
+}
+
 #define PAS_SEGREGATED_SIZE_DIRECTORY_BASELINE_ALLOCATOR_INDEX_BITS 7u
 #define PAS_SEGREGATED_SIZE_DIRECTORY_MIN_INDEX_BITS                25u
 
@@ -31,7 +31,9 @@
 #include "pas_baseline_allocator_table.h"
 #include "pas_size_lookup_mode.h"
 #include "pas_local_allocator.h"
+#include "pas_numa.h"
 #include "pas_segregated_directory_inlines.h"
+#include "pas_segregated_exclusive_view.h"
 #include "pas_segregated_heap.h"
 #include "pas_segregated_size_directory.h"
 #include "pas_thread_local_cache.h"
@@ -145,6 +147,46 @@ pas_segregated_size_directory_take_first_eligible_impl_should_consider_view_para
     return segment.eligible_bits;
 }
 
+typedef struct {
+    unsigned node;
+    unsigned num_skips;
+} pas_segregated_size_directory_take_first_eligible_numa_state;
+
+/* Passes over exclusive pages that are committed on some other NUMA node. We look at is_owned and
+   page_boundary without holding any locks, which is fine since this is only a hint. Views whose
+   pages are decommitted are always taken, since whoever touches them first will fault them in on
+   their own node. */
+static PAS_NEVER_INLINE bool
+pas_segregated_size_directory_take_first_eligible_impl_consider_view_on_node(
+    pas_segregated_directory_iterate_config* config)
+{
+    pas_segregated_size_directory_take_first_eligible_numa_state* state;
+    pas_segregated_view view;
+    pas_segregated_exclusive_view* exclusive;
+    void* page_boundary;
+    unsigned node;
+
+    state = (pas_segregated_size_directory_take_first_eligible_numa_state*)config->arg;
+
+    if (state->num_skips >= PAS_NUMA_MAX_REMOTE_SKIPS)
+        return true;
+
+    view = pas_segregated_directory_get(config->directory, config->index);
+    if (!pas_segregated_view_is_some_exclusive(view))
+        return true;
+
+    exclusive = pas_segregated_view_get_exclusive(view);
+    page_boundary = exclusive->page_boundary;
+    if (!exclusive->is_owned || !page_boundary)
+        return true;
+
+    if (!pas_numa_get_page_node(page_boundary, &node) || node == state->node)
+        return true;
+
+    state->num_skips++;
+    return false;
+}
+
 static PAS_ALWAYS_INLINE pas_segregated_view
 pas_segregated_size_directory_take_first_eligible_impl(
     pas_segregated_directory* directory,
@@ -158,11 +200,17 @@ pas_segregated_size_directory_take_first_eligible_impl(
     const pas_segregated_page_config* page_config_ptr;
     pas_segregated_page_config page_config;
     pas_segregated_view view;
+    bool prefer_local_pages;
+    pas_segregated_size_directory_take_first_eligible_numa_state numa_state;
 
     page_config_ptr = pas_segregated_page_config_kind_get_config(directory->page_config_kind);
     page_config = *page_config_ptr;
 
     view = NULL;
+
+    prefer_local_pages = pas_numa_prefer_local_pages;
+    numa_state.num_skips = 0;
+    numa_state.node = prefer_local_pages ? pas_numa_get_current_node() : 0;
     
     if (verbose)
         pas_log("%p: At start of take_first_eligible_impl.\n", directory);
@@ -174,8 +222,14 @@ pas_segregated_size_directory_take_first_eligible_impl(
         config->directory = directory;
         config->should_consider_view_parallel =
             pas_segregated_size_directory_take_first_eligible_impl_should_consider_view_parallel;
-        config->consider_view = NULL;
-        config->arg = NULL;
+        if (prefer_local_pages) {
+            config->consider_view =
+                pas_segregated_size_directory_take_first_eligible_impl_consider_view_on_node;
+            config->arg = &numa_state;
+        } else {
+            config->consider_view = NULL;
+            config->arg = NULL;
+        }
 
         did_find_something = pas_segregated_directory_iterate_forward_to_take_first_eligible(config);
 
@@ -199,6 +253,13 @@ pas_segregated_size_directory_take_first_eligible_impl(
             }
         } else {
             size_t new_size;
+
+            /* If we passed over remote pages, then take one of those rather than growing the
+               directory. */
+            if (prefer_local_pages && numa_state.num_skips) {
+                prefer_local_pages = false;
+                continue;
+            }
             
             pas_heap_lock_lock_conditionally(
                 pas_segregated_page_config_heap_lock_hold_mode(page_config));
@@ -37,6 +37,7 @@
 #include "pas_bitfit_heap.h"
 #include "pas_bitfit_size_class.h"
 #include "pas_bitfit_view.h"
+#include "pas_bootstrap_free_heap.h"
 #include "pas_committed_pages_vector.h"
 #include "pas_compact_expendable_memory.h"
 #include "pas_compact_reservation_free_heap.h"
@@ -63,18 +64,23 @@
 #include "pas_segregated_size_directory.h"
 #include "pas_simple_type.h"
 #include "pas_stream.h"
+#include "pas_string_stream.h"
 #include "pas_thread_local_cache.h"
 #include "pas_thread_local_cache_layout.h"
 #include "pas_thread_local_cache_node.h"
 #include "pas_utility_heap.h"
+#include <errno.h>
+#include <string.h>
 #ifndef _WIN32
 #include <unistd.h>
 #endif
 
 unsigned pas_status_reporter_enabled = 0;
 unsigned pas_status_reporter_period_in_milliseconds = 10 * 1000;
+int pas_status_reporter_json_fd = -1;
 
 static pas_system_once once_control = PAS_SYSTEM_ONCE_INIT;
+static pas_lock reporter_lock = PAS_LOCK_INITIALIZER;
 
 static void dump_ratio_initial(
     pas_stream* stream, const char* full, uintptr_t numerator, uintptr_t denominator)
@@ -1196,13 +1202,132 @@ void pas_status_reporter_dump_everything(pas_stream* stream)
 	pas_status_reporter_dump_page_states(stream);
 }
 
+typedef struct {
+    pas_stream* stream;
+    pas_heap* heap;
+    bool is_first;
+} size_classes_json_data;
+
+static bool size_classes_json_size_directory_callback(
+    pas_segregated_heap* heap,
+    pas_segregated_size_directory* directory,
+    void* arg)
+{
+    size_classes_json_data* data;
+    pas_segregated_size_directory_data* directory_data;
+    pas_heap_summary summary;
+
+    PAS_UNUSED_PARAM(heap);
+
+    data = arg;
+
+    if (directory->base.page_config_kind == pas_segregated_page_config_kind_null)
+        return true;
+
+    directory_data = pas_segregated_size_directory_data_ptr_load(&directory->data);
+    summary = pas_segregated_directory_compute_summary(&directory->base);
+
+    pas_stream_printf(
+        data->stream,
+        "%s{\"heap\":\"%p\",\"object_size\":%u,\"alignment\":%zu,\"page_config\":\"%s\","
+        "\"views\":%zu,\"refills\":%zu,\"refilled_objects\":%zu,\"committed\":%zu,"
+        "\"allocated\":%zu,\"free\":%zu,\"fragmentation\":%zu}",
+        data->is_first ? "" : ",",
+        data->heap,
+        directory->object_size,
+        pas_segregated_size_directory_alignment(directory),
+        pas_segregated_page_config_kind_get_string(directory->base.page_config_kind),
+        pas_segregated_directory_size(&directory->base),
+        directory_data ? (size_t)directory_data->num_refills : 0,
+        directory_data ? (size_t)directory_data->num_refilled_objects : 0,
+        summary.committed,
+        summary.allocated,
+        summary.free,
+        pas_heap_summary_fragmentation(summary));
+    data->is_first = false;
+
+    return true;
+}
+
+static bool size_classes_json_heap_callback(pas_heap* heap, void* arg)
+{
+    size_classes_json_data* data;
+
+    data = arg;
+    data->heap = heap;
+
+    pas_segregated_heap_for_each_size_directory(
+        &heap->segregated_heap, size_classes_json_size_directory_callback, data);
+
+    return true;
+}
+
+void pas_status_reporter_dump_size_classes_json(pas_stream* stream)
+{
+    size_classes_json_data data;
+
+    pas_heap_lock_assert_held();
+
+    pas_stream_printf(
+        stream,
+        "{\"pid\":%d,\"time_ms\":%.3lf,\"num_heaps\":%zu,\"counting_refills\":%s,"
+        "\"exclusive_views\":%zu,\"partial_views\":%zu,\"shared_views\":%zu,"
+        "\"size_classes\":[",
+        pas_getpid(),
+        pas_get_time_in_milliseconds(),
+        pas_all_heaps_count,
+        pas_segregated_size_directory_count_refills ? "true" : "false",
+        pas_segregated_exclusive_view_count,
+        pas_segregated_partial_view_count,
+        pas_segregated_shared_view_count);
+
+    data.stream = stream;
+    data.heap = NULL;
+    data.is_first = true;
+    pas_all_heaps_for_each_heap(size_classes_json_heap_callback, &data);
+
+    pas_stream_printf(stream, "]}");
+}
+
+static bool write_json_fully(int fd, const char* ptr, size_t size)
+{
+    while (size) {
+        ssize_t result;
+#ifdef _WIN32
+        result = _write(fd, ptr, (unsigned)size);
+#else
+        result = write(fd, ptr, size);
+#endif
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            pas_log("%d: Status reporter failed to write JSON to fd %d: %s\n",
+                    pas_getpid(), fd, strerror(errno));
+            return false;
+        }
+        PAS_ASSERT(result);
+        ptr += result;
+        size -= (size_t)result;
+    }
+    return true;
+}
+
 static pas_thread_return_type status_reporter_thread_main(void* arg)
 {
     pas_fd_stream fd_stream;
+    pas_string_stream json_stream;
+    pas_allocation_config allocation_config;
 
     PAS_UNUSED_PARAM(arg);
 
     pas_fd_stream_construct(&fd_stream, PAS_LOG_DEFAULT_FD);
+
+    /* The JSON gets built while holding the heap lock and written after releasing it, so that a
+       slow reader does not stall the heap. */
+    pas_bootstrap_free_heap_allocation_config_construct(&allocation_config, pas_lock_is_held);
+    pas_heap_lock_lock();
+    pas_string_stream_construct(&json_stream, &allocation_config);
+    pas_heap_lock_unlock();
     
     for (;;) {
 #ifdef _WIN32
@@ -1211,16 +1336,30 @@ static pas_thread_return_type status_reporter_thread_main(void* arg)
         usleep(pas_status_reporter_period_in_milliseconds * 1000);
 #endif
 
-        PAS_ASSERT(pas_status_reporter_enabled);
+        pas_lock_lock(&reporter_lock);
 
-        if (pas_status_reporter_enabled == 1) {
+        if (pas_status_reporter_json_fd >= 0) {
+            pas_heap_lock_lock();
+            pas_string_stream_reset(&json_stream);
+            pas_status_reporter_dump_size_classes_json((pas_stream*)&json_stream);
+            pas_string_stream_printf(&json_stream, "\n");
+            pas_heap_lock_unlock();
+
+            if (!write_json_fully(pas_status_reporter_json_fd,
+                                  pas_string_stream_get_string(&json_stream),
+                                  pas_string_stream_get_string_length(&json_stream)))
+                pas_status_reporter_json_fd = -1;
+        }
+
+        if (pas_status_reporter_enabled == 1)
             pas_fd_stream_printf(&fd_stream, "%d: Num Heaps: %zu\n", pas_getpid(), pas_all_heaps_count);
-            continue;
+        else if (pas_status_reporter_enabled) {
+            pas_heap_lock_lock();
+            pas_status_reporter_dump_everything((pas_stream*)&fd_stream);
+            pas_heap_lock_unlock();
         }
-        
-        pas_heap_lock_lock();
-        pas_status_reporter_dump_everything((pas_stream*)&fd_stream);
-        pas_heap_lock_unlock();
+
+        pas_lock_unlock(&reporter_lock);
     }
     
     PAS_ASSERT(!"Should not be reached");
@@ -1234,10 +1373,20 @@ static void start_reporter(void)
 
 void pas_status_reporter_start_if_necessary(void)
 {
-    if (pas_status_reporter_enabled)
+    if (pas_status_reporter_enabled || pas_status_reporter_json_fd >= 0)
         pas_system_once_run(&once_control, start_reporter);
 }
 
+void pas_status_reporter_suspend(void)
+{
+    pas_lock_lock(&reporter_lock);
+}
+
+void pas_status_reporter_resume(void)
+{
+    pas_lock_unlock(&reporter_lock);
+}
+
 void pas_status_reporter_print_everything(void)
 {
     /* FIXME: This is a giant hack. */
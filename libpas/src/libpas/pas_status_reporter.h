@@ -47,7 +47,15 @@ typedef struct pas_segregated_size_directory pas_segregated_size_directory;
 typedef struct pas_stream pas_stream;
 
 PAS_API extern unsigned pas_status_reporter_enabled;
-PAS_API extern unsigned pas_status_reporter_period_in_microseconds;
+PAS_API extern unsigned pas_status_reporter_period_in_milliseconds;
+
+/* If this is not -1, then the status reporter thread also writes one line of JSON per period to
+   this fd. Each line is a complete JSON object describing every size class of every non-utility
+   heap: refill counts, objects handed out to local allocators, and the committed, allocated, free
+   and fragmented bytes. The refill counts stay zero unless
+   pas_segregated_size_directory_count_refills is also set. If a write fails, the reporter stops
+   writing JSON. */
+PAS_API extern int pas_status_reporter_json_fd;
 
 PAS_API void pas_status_reporter_dump_bitfit_directory(
     pas_stream* stream, pas_bitfit_directory* directory);
@@ -83,8 +91,15 @@ PAS_API void pas_status_reporter_dump_expendable_memories(pas_stream* stream);
 PAS_API void pas_status_reporter_dump_page_states(pas_stream* stream);
 PAS_API void pas_status_reporter_dump_everything(pas_stream* stream);
 
+/* Call with the heap lock held. Prints one line of JSON with no embedded newlines. */
+PAS_API void pas_status_reporter_dump_size_classes_json(pas_stream* stream);
+
 PAS_API void pas_status_reporter_start_if_necessary(void);
 
+/* Needed for fork(). Makes sure that the reporter is not holding the heap lock. */
+PAS_API void pas_status_reporter_suspend(void);
+PAS_API void pas_status_reporter_resume(void);
+
 PAS_END_EXTERN_C;
 
 #endif /* PAS_STATUS_REPORTER_H */
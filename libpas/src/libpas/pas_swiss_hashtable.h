@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef PAS_SWISS_HASHTABLE_H
+#define PAS_SWISS_HASHTABLE_H
+
+#include "pas_allocation_config.h"
+#include "pas_allocation_kind.h"
+#include "pas_log.h"
+#include "pas_utils.h"
+
+PAS_BEGIN_EXTERN_C;
+
+/* This is like PAS_CREATE_HASHTABLE, and takes the same entry and key helpers and has the same API,
+   but lays the table out like a Swiss table: next to the entries there is one control byte per
+   entry, which says whether the entry is empty, deleted, or full, and for full entries holds 7 bits
+   of the hash. Lookups probe a whole group of control bytes at a time using word-wide bit tricks,
+   and only look at the entries whose hash bits match, so misses and collisions almost never touch
+   the entries themselves. That makes it possible to fill the table up to 7/8 instead of 1/2.
+
+   The entries still get set to empty or deleted along with their control bytes, so code that walks
+   the table with entry_index_end()/entry_at_index() and entry_type##_is_empty_or_deleted() keeps
+   working.
+
+   Swiss tables can't be enumerated remotely, so there's no for_each_entry_remote(), and the
+   in_flux_stash has to be NULL. The parameter is only there so that switching a table between
+   PAS_CREATE_HASHTABLE and PAS_CREATE_SWISS_HASHTABLE doesn't require changing its callers.
+
+   Like the other hashtable, this is not thread-safe. */
+
+#define PAS_SWISS_HASHTABLE_GROUP_SIZE 8u
+#define PAS_SWISS_HASHTABLE_MIN_SIZE 16u
+#define PAS_SWISS_HASHTABLE_MIN_LOAD 6u
+
+#define PAS_SWISS_HASHTABLE_EMPTY ((uint8_t)0x80)
+#define PAS_SWISS_HASHTABLE_DELETED ((uint8_t)0xfe)
+
+#define PAS_SWISS_HASHTABLE_LSBS ((uint64_t)0x0101010101010101llu)
+#define PAS_SWISS_HASHTABLE_MSBS ((uint64_t)0x8080808080808080llu)
+
+static inline unsigned pas_swiss_hashtable_h1(unsigned hash)
+{
+    return hash >> 7;
+}
+
+static inline uint8_t pas_swiss_hashtable_h2(unsigned hash)
+{
+    return (uint8_t)(hash & 0x7f);
+}
+
+static PAS_ALWAYS_INLINE uint64_t pas_swiss_hashtable_group_load(const uint8_t* control)
+{
+    uint64_t result;
+    memcpy(&result, control, sizeof(result));
+    return result;
+}
+
+/* These return a mask with the high bit of each matching control byte set. Matching the hash might
+   have false positives (only for bytes right after a real match), which is fine since we compare
+   keys anyway. Matching empty and empty-or-deleted is exact. */
+static PAS_ALWAYS_INLINE uint64_t pas_swiss_hashtable_group_match(uint64_t group, uint8_t h2)
+{
+    uint64_t bytes = group ^ (PAS_SWISS_HASHTABLE_LSBS * h2);
+    return (bytes - PAS_SWISS_HASHTABLE_LSBS) & ~bytes & PAS_SWISS_HASHTABLE_MSBS;
+}
+
+static PAS_ALWAYS_INLINE uint64_t pas_swiss_hashtable_group_match_empty(uint64_t group)
+{
+    return group & ~(group << 6) & PAS_SWISS_HASHTABLE_MSBS;
+}
+
+static PAS_ALWAYS_INLINE uint64_t pas_swiss_hashtable_group_match_empty_or_deleted(uint64_t group)
+{
+    return group & ~(group << 7) & PAS_SWISS_HASHTABLE_MSBS;
+}
+
+/* This assumes little endian, which is all that libpas supports. */
+static PAS_ALWAYS_INLINE unsigned pas_swiss_hashtable_mask_first_index(uint64_t mask)
+{
+    PAS_TESTING_ASSERT(mask);
+    return (unsigned)(pas_count_trailing_zeroes64(mask) >> 3);
+}
+
+static PAS_ALWAYS_INLINE uint64_t pas_swiss_hashtable_mask_remove_first(uint64_t mask)
+{
+    return mask & (mask - 1);
+}
+
+#define PAS_SWISS_HASHTABLE_INITIALIZER { \
+        .table = NULL, \
+        .control = NULL, \
+        .table_size = 0, \
+        .table_mask = 0, \
+        .key_count = 0, \
+        .deleted_count = 0 \
+    }
+
+#define PAS_CREATE_SWISS_HASHTABLE(name, entry_type, key_type) \
+    struct name; \
+    struct name##_add_result; \
+    struct name##_in_flux_stash; \
+    typedef struct name name; \
+    typedef struct name##_add_result name##_add_result; \
+    typedef struct name##_in_flux_stash name##_in_flux_stash; \
+    \
+    struct name { \
+        entry_type* table; \
+        uint8_t* control; /* Allocated along with the table, right after it. */ \
+        unsigned table_size; \
+        unsigned table_mask; \
+        unsigned key_count; \
+        unsigned deleted_count; \
+    }; \
+    \
+    struct name##_add_result { \
+        entry_type* entry; \
+        bool is_new_entry; \
+    }; \
+    \
+    struct name##_in_flux_stash { \
+        int dummy; \
+    }; \
+    \
+    PAS_UNUSED static inline void name##_construct(name* table) \
+    { \
+        pas_zero_memory(table, sizeof(name)); \
+    } \
+    \
+    PAS_UNUSED static inline size_t name##_allocation_size(unsigned table_size) \
+    { \
+        return (size_t)table_size * (sizeof(entry_type) + 1); \
+    } \
+    \
+    PAS_UNUSED static inline void name##_destruct( \
+        name* table, const pas_allocation_config* allocation_config) \
+    { \
+        allocation_config->deallocate( \
+            table->table, name##_allocation_size(table->table_size), pas_object_allocation, \
+            allocation_config->arg); \
+    } \
+    \
+    /* Returns the index of the first empty (or deleted, if allowed) entry in the key's probe */ \
+    /* sequence. */ \
+    PAS_UNUSED static inline unsigned name##_find_slot( \
+        name* table, unsigned hash, bool allow_deleted) \
+    { \
+        unsigned index = (pas_swiss_hashtable_h1(hash) * PAS_SWISS_HASHTABLE_GROUP_SIZE) \
+            & table->table_mask; \
+        unsigned stride; \
+        for (stride = PAS_SWISS_HASHTABLE_GROUP_SIZE; ; \
+             stride += PAS_SWISS_HASHTABLE_GROUP_SIZE) { \
+            uint64_t group = pas_swiss_hashtable_group_load(table->control + index); \
+            uint64_t mask; \
+            if (allow_deleted) \
+                mask = pas_swiss_hashtable_group_match_empty_or_deleted(group); \
+            else \
+                mask = pas_swiss_hashtable_group_match_empty(group); \
+            if (mask) \
+                return index + pas_swiss_hashtable_mask_first_index(mask); \
+            PAS_TESTING_ASSERT(stride <= table->table_size); \
+            index = (index + stride) & table->table_mask; \
+        } \
+    } \
+    \
+    PAS_UNUSED static inline void name##_rehash( \
+        name* table, unsigned new_size, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        static const bool verbose = false; \
+        \
+        name new_table; \
+        unsigned index; \
+        \
+        PAS_ASSERT(!in_flux_stash); \
+        PAS_ASSERT(pas_is_power_of_2(new_size)); \
+        PAS_ASSERT(new_size >= PAS_SWISS_HASHTABLE_MIN_SIZE); \
+        \
+        if (verbose) \
+            pas_log("Allocating a new swiss table with new_size = %u.\n", new_size); \
+        new_table.table = (entry_type*)allocation_config->allocate( \
+            name##_allocation_size(new_size), #name "/table", pas_object_allocation, \
+            allocation_config->arg); \
+        new_table.control = (uint8_t*)(new_table.table + new_size); \
+        new_table.table_size = new_size; \
+        new_table.table_mask = new_size - 1; \
+        new_table.key_count = table->key_count; \
+        new_table.deleted_count = 0; \
+        \
+        for (index = new_size; index--;) \
+            new_table.table[index] = entry_type##_create_empty(); \
+        memset(new_table.control, PAS_SWISS_HASHTABLE_EMPTY, new_size); \
+        \
+        for (index = 0; index < table->table_size; ++index) { \
+            unsigned hash; \
+            unsigned new_index; \
+            \
+            if (table->control[index] & PAS_SWISS_HASHTABLE_EMPTY) \
+                continue; \
+            \
+            hash = key_type##_get_hash(entry_type##_get_key(table->table[index])); \
+            new_index = name##_find_slot(&new_table, hash, false); \
+            new_table.control[new_index] = pas_swiss_hashtable_h2(hash); \
+            new_table.table[new_index] = table->table[index]; \
+        } \
+        \
+        name##_destruct(table, allocation_config); \
+        *table = new_table; \
+    } \
+    \
+    PAS_UNUSED static inline void name##_expand( \
+        name* table, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        unsigned new_size; \
+        if (!table->table_size) \
+            new_size = PAS_SWISS_HASHTABLE_MIN_SIZE; \
+        else if (table->key_count * 2 < table->table_size) \
+            new_size = table->table_size; /* Mostly deleted entries, so just clean them up. */ \
+        else \
+            new_size = table->table_size * 2; \
+        name##_rehash(table, new_size, in_flux_stash, allocation_config); \
+    } \
+    \
+    PAS_UNUSED static inline void name##_shrink( \
+        name* table, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        name##_rehash(table, table->table_size / 2, in_flux_stash, allocation_config); \
+    } \
+    \
+    PAS_UNUSED static inline entry_type* name##_find(name* hashtable, key_type key) \
+    { \
+        unsigned hash; \
+        unsigned index; \
+        unsigned stride; \
+        uint8_t h2; \
+        \
+        if (!hashtable->table) \
+            return NULL; \
+        \
+        hash = key_type##_get_hash(key); \
+        h2 = pas_swiss_hashtable_h2(hash); \
+        index = (pas_swiss_hashtable_h1(hash) * PAS_SWISS_HASHTABLE_GROUP_SIZE) \
+            & hashtable->table_mask; \
+        for (stride = PAS_SWISS_HASHTABLE_GROUP_SIZE; ; \
+             stride += PAS_SWISS_HASHTABLE_GROUP_SIZE) { \
+            uint64_t group; \
+            uint64_t mask; \
+            \
+            group = pas_swiss_hashtable_group_load(hashtable->control + index); \
+            for (mask = pas_swiss_hashtable_group_match(group, h2); \
+                 mask; \
+                 mask = pas_swiss_hashtable_mask_remove_first(mask)) { \
+                entry_type* entry = hashtable->table + index \
+                    + pas_swiss_hashtable_mask_first_index(mask); \
+                if (key_type##_is_equal(entry_type##_get_key(*entry), key)) \
+                    return entry; \
+            } \
+            if (pas_swiss_hashtable_group_match_empty(group)) \
+                return NULL; \
+            PAS_TESTING_ASSERT(stride <= hashtable->table_size); \
+            index = (index + stride) & hashtable->table_mask; \
+        } \
+    } \
+    \
+    PAS_UNUSED static inline entry_type name##_get(name* hashtable, key_type key) \
+    { \
+        entry_type* result; \
+        result = name##_find(hashtable, key); \
+        if (!result) \
+            return entry_type##_create_empty(); \
+        return *result; \
+    } \
+    \
+    PAS_UNUSED static inline name##_add_result name##_add( \
+        name* table, key_type key, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        name##_add_result result; \
+        unsigned hash; \
+        unsigned index; \
+        \
+        PAS_ASSERT(!in_flux_stash); \
+        \
+        result.entry = name##_find(table, key); \
+        if (result.entry) { \
+            result.is_new_entry = false; \
+            return result; \
+        } \
+        \
+        /* Always leave at least one empty entry, so that probing terminates. */ \
+        if ((size_t)(table->key_count + table->deleted_count + 1) * 8 \
+            > (size_t)table->table_size * 7) \
+            name##_expand(table, in_flux_stash, allocation_config); \
+        \
+        hash = key_type##_get_hash(key); \
+        index = name##_find_slot(table, hash, true); \
+        if (table->control[index] == PAS_SWISS_HASHTABLE_DELETED) \
+            table->deleted_count--; \
+        table->control[index] = pas_swiss_hashtable_h2(hash); \
+        table->key_count++; \
+        \
+        result.entry = table->table + index; \
+        result.is_new_entry = true; \
+        return result; \
+    } \
+    \
+    PAS_UNUSED static inline void name##_add_new( \
+        name* table, entry_type new_entry, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        name##_add_result result = name##_add( \
+            table, entry_type##_get_key(new_entry), in_flux_stash, allocation_config); \
+        PAS_ASSERT(result.is_new_entry); \
+        *result.entry = new_entry; \
+    } \
+    \
+    PAS_UNUSED static inline bool name##_set( \
+        name* table, entry_type new_entry, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        name##_add_result result = name##_add( \
+            table, entry_type##_get_key(new_entry), in_flux_stash, allocation_config); \
+        *result.entry = new_entry; \
+        return result.is_new_entry; \
+    } \
+    \
+    PAS_UNUSED static inline bool name##_take_and_return_if_taken( \
+        name* table, key_type key, entry_type* result, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        entry_type* entry_ptr; \
+        entry_type entry; \
+        unsigned index; \
+        unsigned group_index; \
+        \
+        PAS_ASSERT(!in_flux_stash); \
+        \
+        entry_ptr = name##_find(table, key); \
+        if (!entry_ptr) { \
+            if (result) \
+                *result = entry_type##_create_empty(); \
+            return false; \
+        } \
+        \
+        entry = *entry_ptr; \
+        index = (unsigned)(entry_ptr - table->table); \
+        group_index = index & ~(PAS_SWISS_HASHTABLE_GROUP_SIZE - 1); \
+        \
+        /* If the group still has an empty entry, then no probe ever went past it, so this */ \
+        /* entry can go back to being empty. */ \
+        if (pas_swiss_hashtable_group_match_empty( \
+                pas_swiss_hashtable_group_load(table->control + group_index))) { \
+            table->control[index] = PAS_SWISS_HASHTABLE_EMPTY; \
+            *entry_ptr = entry_type##_create_empty(); \
+        } else { \
+            table->control[index] = PAS_SWISS_HASHTABLE_DELETED; \
+            *entry_ptr = entry_type##_create_deleted(); \
+            table->deleted_count++; \
+        } \
+        table->key_count--; \
+        if (table->key_count * PAS_SWISS_HASHTABLE_MIN_LOAD < table->table_size \
+            && table->table_size > PAS_SWISS_HASHTABLE_MIN_SIZE) \
+            name##_shrink(table, in_flux_stash, allocation_config); \
+        \
+        if (result) \
+            *result = entry; \
+        return true; \
+    } \
+    \
+    PAS_UNUSED static inline entry_type name##_take( \
+        name* table, key_type key, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        entry_type result; \
+        name##_take_and_return_if_taken(table, key, &result, in_flux_stash, allocation_config); \
+        return result; \
+    } \
+    \
+    PAS_UNUSED static inline bool name##_remove( \
+        name* table, key_type key, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        return name##_take_and_return_if_taken( \
+            table, key, NULL, in_flux_stash, allocation_config); \
+    } \
+    \
+    PAS_UNUSED static inline void name##_delete( \
+        name* table, key_type key, name##_in_flux_stash* in_flux_stash, \
+        const pas_allocation_config* allocation_config) \
+    { \
+        bool result; \
+        result = name##_remove(table, key, in_flux_stash, allocation_config); \
+        PAS_ASSERT(result); \
+    } \
+    \
+    typedef bool (*name##_for_each_entry_callback)(entry_type* entry, void* arg); \
+    \
+    PAS_UNUSED static inline bool name##_for_each_entry(name* table, \
+                                                        name##_for_each_entry_callback callback, \
+                                                        void* arg) \
+    { \
+        unsigned index; \
+        \
+        for (index = 0; index < table->table_size; ++index) { \
+            if (table->control[index] & PAS_SWISS_HASHTABLE_EMPTY) \
+                continue; \
+            if (!callback(table->table + index, arg)) \
+                return false; \
+        } \
+        \
+        return true; \
+    } \
+    \
+    PAS_UNUSED static inline size_t name##_size(name* table) \
+    { \
+        return table->key_count; \
+    } \
+    \
+    PAS_UNUSED static inline size_t name##_entry_index_end(name* table) \
+    { \
+        return table->table_size; \
+    } \
+    \
+    PAS_UNUSED static inline entry_type* name##_entry_at_index(name* table, \
+                                                               size_t index) \
+    { \
+        return table->table + index; \
+    } \
+    \
+    struct pas_dummy
+
+PAS_END_EXTERN_C;
+
+#endif /* PAS_SWISS_HASHTABLE_H */
+
@@ -684,7 +684,8 @@ process_deallocation_log_with_config(pas_thread_local_cache* cache,
                                      pas_segregated_page_role role,
                                      size_t* index,
                                      uintptr_t encoded_begin,
-                                     pas_lock** held_lock)
+                                     pas_lock** held_lock,
+                                     size_t* defer_index)
 {
     static const bool verbose = false;
 
@@ -714,7 +715,27 @@ process_deallocation_log_with_config(pas_thread_local_cache* cache,
 
         default:
             last_held_lock = *held_lock;
-            pas_segregated_page_deallocate(begin, held_lock, deallocation_mode, cache, page_config, role);
+            if (defer_index
+                && cache->deallocation_log_index - *defer_index < PAS_DEALLOCATION_LOG_MAX_DEFERRED) {
+                pas_segregated_page* page;
+                page = pas_segregated_page_for_address_and_page_config(begin, page_config);
+                if (!pas_segregated_page_switch_lock_with_mode(
+                        page, held_lock, pas_lock_lock_mode_try_lock, page_config)) {
+                    /* Somebody else has this page locked, most likely the thread that is
+                       allocating in it. Leave this object in the log for next time rather than
+                       waiting for the lock and taking the page's lock bias away. Deferred entries
+                       get filled in from the top of the log, which we have already read. */
+                    if (verbose)
+                        pas_log("Deferring deallocation of %p.\n", (void*)begin);
+                    pas_compiler_fence();
+                    cache->deallocation_log[*index] = 0;
+                    cache->deallocation_log[--*defer_index] = encoded_begin;
+                    break;
+                }
+                pas_segregated_page_deallocate_with_page(
+                    page, begin, deallocation_mode, cache, page_config, role);
+            } else
+                pas_segregated_page_deallocate(begin, held_lock, deallocation_mode, cache, page_config, role);
             if (verbose && *held_lock != last_held_lock && last_held_lock)
                 pas_log("Switched lock from %p to %p.\n", last_held_lock, *held_lock);
             
@@ -735,9 +756,13 @@ process_deallocation_log_with_config(pas_thread_local_cache* cache,
     }
 }
 
+/* If defer_index is not NULL, then it should point at a copy of the log index. Deallocations into
+   pages that someone else has locked may then get deferred, in which case they end up at
+   [*defer_index, deallocation_log_index) in the log. */
 static PAS_ALWAYS_INLINE void flush_deallocation_log_without_resetting(
     pas_thread_local_cache* thread_local_cache,
-    pas_segregated_deallocation_mode deallocation_mode)
+    pas_segregated_deallocation_mode deallocation_mode,
+    size_t* defer_index)
 {
     size_t index;
     pas_lock* held_lock;
@@ -758,12 +783,12 @@ static PAS_ALWAYS_INLINE void flush_deallocation_log_without_resetting(
         case pas_segregated_page_config_kind_ ## name ## _and_shared_role: \
             process_deallocation_log_with_config( \
                 thread_local_cache, deallocation_mode, value, pas_segregated_page_shared_role, &index, \
-                encoded_begin, &held_lock); \
+                encoded_begin, &held_lock, defer_index); \
             break; \
         case pas_segregated_page_config_kind_ ## name ## _and_exclusive_role: \
             process_deallocation_log_with_config( \
                 thread_local_cache, deallocation_mode, value, pas_segregated_page_exclusive_role, &index, \
-                encoded_begin, &held_lock); \
+                encoded_begin, &held_lock, defer_index); \
             break;
 #include "pas_segregated_page_config_kind.def.h"
 #undef PAS_DEFINE_SEGREGATED_PAGE_CONFIG_KIND
@@ -775,32 +800,48 @@ static PAS_ALWAYS_INLINE void flush_deallocation_log_without_resetting(
 
 static void flush_deallocation_log_for_scavenger(pas_thread_local_cache* thread_local_cache)
 {
-    flush_deallocation_log_without_resetting(thread_local_cache, pas_segregated_deallocation_direct_mode);
+    flush_deallocation_log_without_resetting(
+        thread_local_cache, pas_segregated_deallocation_direct_mode, NULL);
 }
 
 static PAS_ALWAYS_INLINE void flush_deallocation_log_with_mode(
     pas_thread_local_cache* thread_local_cache,
     pas_lock_hold_mode heap_lock_hold_mode,
-    pas_segregated_deallocation_mode deallocation_mode)
+    pas_segregated_deallocation_mode deallocation_mode,
+    bool may_defer)
 {
+    size_t defer_index;
+    size_t num_deferred;
+
     if (!thread_local_cache)
         return;
 
     pas_lock_lock(&thread_local_cache->node->scavenger_lock);
 
+    defer_index = thread_local_cache->deallocation_log_index;
+
     switch (deallocation_mode) {
     case pas_segregated_deallocation_direct_mode:
         /* If we're doing a direct flush then try to share code with flush_deallocation_log_for_scavenger,
            which does the same thing we would do. */
+        PAS_ASSERT(!may_defer);
         flush_deallocation_log_for_scavenger(thread_local_cache);
         break;
     case pas_segregated_deallocation_to_view_cache_mode:
         flush_deallocation_log_without_resetting(
-            thread_local_cache, pas_segregated_deallocation_to_view_cache_mode);
+            thread_local_cache, pas_segregated_deallocation_to_view_cache_mode,
+            may_defer ? &defer_index : NULL);
         break;
     }
+
+    num_deferred = thread_local_cache->deallocation_log_index - defer_index;
+    if (num_deferred) {
+        memmove(thread_local_cache->deallocation_log,
+                thread_local_cache->deallocation_log + defer_index,
+                num_deferred * sizeof(uintptr_t));
+    }
     
-    thread_local_cache->deallocation_log_index = 0;
+    thread_local_cache->deallocation_log_index = (unsigned)num_deferred;
     thread_local_cache->num_logged_bytes = 0;
 
     /* Dirtying the deallocation log is a signal to the scavenger that we are actively operating on
@@ -816,15 +857,18 @@ static PAS_ALWAYS_INLINE void flush_deallocation_log_with_mode(
 void pas_thread_local_cache_flush_deallocation_log(pas_thread_local_cache* thread_local_cache,
                                                    pas_lock_hold_mode heap_lock_hold_mode)
 {
+    static const bool may_defer = false;
     flush_deallocation_log_with_mode(
-        thread_local_cache, heap_lock_hold_mode, pas_segregated_deallocation_to_view_cache_mode);
+        thread_local_cache, heap_lock_hold_mode, pas_segregated_deallocation_to_view_cache_mode,
+        may_defer);
 }
 
 void pas_thread_local_cache_flush_deallocation_log_direct(pas_thread_local_cache* thread_local_cache,
                                                           pas_lock_hold_mode heap_lock_hold_mode)
 {
+    static const bool may_defer = false;
     flush_deallocation_log_with_mode(
-        thread_local_cache, heap_lock_hold_mode, pas_segregated_deallocation_direct_mode);
+        thread_local_cache, heap_lock_hold_mode, pas_segregated_deallocation_direct_mode, may_defer);
 }
 
 typedef struct scavenger_thread_suspend_data {
@@ -1268,7 +1312,11 @@ PAS_NEVER_INLINE void pas_thread_local_cache_append_deallocation_slow(
     thread_local_cache->deallocation_log[index++] = pas_thread_local_cache_encode_object(begin, kind_and_role);
     thread_local_cache->deallocation_log_index = index;
 
-    pas_thread_local_cache_flush_deallocation_log(thread_local_cache, pas_lock_is_not_held);
+    /* This is the flush that keeps happening in programs that free on other threads, so let it skip
+       over pages that are busy. Those objects will get freed by some later flush. */
+    flush_deallocation_log_with_mode(
+        thread_local_cache, pas_lock_is_not_held, pas_segregated_deallocation_to_view_cache_mode,
+        true);
 }
 
 void pas_thread_local_cache_shrink(pas_thread_local_cache* thread_local_cache,
@@ -40,10 +40,19 @@ typedef struct verse_heap_page_header verse_heap_page_header;
 
 PAS_API extern verse_heap_object_set verse_heap_all_objects;
 
-/* This is meant to be queried directly by the Verse VM. */
+/* This is meant to be queried directly by the Verse VM. If verse_heap_live_bytes_slack is set, then
+   this lags behind by up to that many bytes (see verse_heap.h). */
 PAS_API extern size_t verse_heap_live_bytes;
 PAS_API extern size_t verse_heap_swept_bytes; /* Num bytes swept by the last sweep. */
 
+/* How full the small segregated pages were at the end of the last sweep. Objects never move, so
+   live bytes well below capacity means fragmentation. The deferred pages were so sparse that the
+   sweep held off on allocating in them for a cycle, to give them a chance to become empty. */
+PAS_API extern size_t verse_heap_swept_small_pages;
+PAS_API extern size_t verse_heap_swept_small_page_live_bytes;
+PAS_API extern size_t verse_heap_swept_small_page_capacity_bytes;
+PAS_API extern size_t verse_heap_deferred_small_pages;
+
 /* This is meant to be set directly by the Verse VM. Anytime live bytes is found to be greater than or equal
    the threshold, the trigger callback is called. It's expected that the callback will do its own locking
    and it will use that lock to protect its changes to the threshold. */
@@ -73,6 +82,12 @@ PAS_API void verse_heap_did_become_ready_for_allocation(void);
 PAS_API void* verse_heap_get_base(pas_heap* heap);
 PAS_API void verse_heap_add_to_set(pas_heap* heap, verse_heap_object_set* set);
 
+/* Makes this heap's large objects not count toward verse_heap_live_bytes, so allocating them never
+   triggers a collection. This is for heaps whose large objects stand in for memory that the client
+   manages itself, like mappings that get mapped over the object. Small objects still count. Must be
+   called before verse_heap_did_become_ready_for_allocation(). */
+PAS_API void verse_heap_set_large_objects_are_uncounted(pas_heap* heap);
+
 /* This is meant to be called as the casual case of the Verse VM allocator. It can handle any size. Note that
    this is a different algorithm from pas_try_allocate_common.
 
@@ -89,6 +104,11 @@ PAS_API void* verse_heap_allocate_with_alignment(pas_heap* heap, size_t size, si
 PAS_API void verse_heap_start_allocating_black_before_handshake(void);
 PAS_API void verse_heap_start_sweep_before_handshake(void);
 PAS_API size_t verse_heap_start_sweep_after_handshake(void);
+/* Use this instead of verse_heap_start_sweep_before_handshake() to have the sweep leave the mark bits of
+   surviving objects set. This is for sticky mark bit generational collection: the next cycle only has to
+   mark the objects allocated since this sweep. The mark bit pages must stay committed until the next
+   non-sticky sweep. */
+PAS_API void verse_heap_start_sticky_sweep_before_handshake(void);
 /* Use this to sweep in parallel (each thread calls this with a different range). */
 PAS_API void verse_heap_sweep_range(size_t begin, size_t end);
 /* Call this from one thread to end the sweep. */
@@ -43,6 +43,13 @@ typedef struct pas_heap pas_heap;
 
 PAS_API void verse_local_allocator_construct(pas_local_allocator* allocator, pas_heap* heap, size_t object_size, size_t allocator_size);
 PAS_API void verse_local_allocator_stop(pas_local_allocator* allocator);
+
+/* Call this instead of stopping the allocator once black allocation has started (between
+   verse_heap_start_allocating_black_before_handshake() and the sweep), during a handshake that
+   the allocator's owner is in. If the allocator is bump allocating, then it keeps its page, and
+   the rest of its bump region gets marked, which is what a black refill would have done.
+   Otherwise, it gets stopped, so that its next allocation refills black. */
+PAS_API void verse_local_allocator_start_allocating_black(pas_local_allocator* allocator);
 PAS_API void* verse_local_allocator_allocate(pas_local_allocator* allocator);
 PAS_API void* verse_local_allocator_try_allocate(pas_local_allocator* allocator);
     
@@ -32,6 +32,7 @@
 #include "filc_runtime.h"
 #include "pas_all_heaps.h"
 #include "pas_bootstrap_free_heap.h"
+#include "pas_epoch.h"
 #include "pas_heap_inlines.h"
 #include "pas_large_sharing_pool.h"
 #include "pas_local_allocator_inlines.h"
@@ -51,10 +52,18 @@
 #include <inttypes.h>
 #include "ue_include/verse_local_allocator_ue.h"
 
+#if PAS_X86_64
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 #if PAS_ENABLE_VERSE
 
 bool verse_heap_is_ready_for_allocation = false;
 
+/* Set before the first allocation, so it's stable by the time anything gets swept. */
+static bool sweep_can_use_avx2 = false;
+
 verse_heap_object_set verse_heap_all_objects = VERSE_HEAP_OBJECT_SET_INITIALIZER;
 verse_heap_object_set_set verse_heap_all_sets = VERSE_HEAP_OBJECT_SET_SET_INITIALIZER;
 
@@ -67,6 +76,7 @@ verse_heap_page_header verse_heap_large_objects_header = VERSE_HEAP_PAGE_HEADER_
 
 uint64_t verse_heap_allocating_black_version = (uint64_t)verse_heap_do_not_allocate_black;
 bool verse_heap_is_sweeping = false;
+bool verse_heap_sweep_is_sticky = false;
 
 verse_heap_iteration_state verse_heap_current_iteration_state = {
     .version = 0,
@@ -77,8 +87,14 @@ size_t verse_heap_num_large_entries_for_iteration = SIZE_MAX;
 
 size_t verse_heap_live_bytes = 0;
 size_t verse_heap_swept_bytes = 0;
+size_t verse_heap_swept_small_pages = 0;
+size_t verse_heap_swept_small_page_live_bytes = 0;
+size_t verse_heap_swept_small_page_capacity_bytes = 0;
+size_t verse_heap_deferred_small_pages = 0;
 
 size_t verse_heap_live_bytes_trigger_threshold = SIZE_MAX;
+verse_heap_live_bytes_shard verse_heap_live_bytes_shards[VERSE_HEAP_NUM_LIVE_BYTES_SHARDS];
+size_t verse_heap_live_bytes_slack = 0;
 void (*verse_heap_live_bytes_trigger_callback)(void) = NULL;
 
 pas_allocator_counts verse_heap_allocator_counts;
@@ -168,6 +184,7 @@ pas_heap* verse_heap_create(size_t min_align, size_t size, size_t alignment)
 
     pas_large_heap_physical_page_sharing_cache_construct(&config->large_cache, verse_heap_runtime_config_chunks_provider, config);
     pas_reserve_commit_cache_large_free_heap_construct(&config->small_cache);
+    verse_heap_reserve_construct(&config->reserve);
 
     verse_heap_object_set_set_construct(&config->object_sets);
     verse_heap_object_set_set_add_set(&config->object_sets, &verse_heap_all_objects);
@@ -223,17 +240,59 @@ void verse_heap_add_to_set(pas_heap* heap, verse_heap_object_set* set)
     pas_heap_lock_unlock();
 }
 
+void verse_heap_set_large_objects_are_uncounted(pas_heap* heap)
+{
+    verse_heap_runtime_config* config;
+
+    pas_heap_lock_lock();
+
+    PAS_ASSERT(!verse_heap_is_ready_for_allocation);
+    PAS_ASSERT(heap->config_kind == pas_heap_config_kind_verse);
+
+    config = (verse_heap_runtime_config*)heap->segregated_heap.runtime_config;
+    config->large_objects_are_uncounted = true;
+    
+    pas_heap_lock_unlock();
+}
+
 void verse_heap_did_become_ready_for_allocation(void)
 {
     pas_heap_lock_lock();
 
     PAS_ASSERT(!verse_heap_is_ready_for_allocation);
 
+#if PAS_X86_64
+    {
+        unsigned eax;
+        unsigned ebx;
+        unsigned ecx;
+        unsigned edx;
+        /* AVX2 needs the OS to save the ymm state, which XCR0 bits 1 and 2 tell us about. */
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_OSXSAVE)
+            && (__builtin_ia32_xgetbv(0) & 6) == 6
+            && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2))
+            sweep_can_use_avx2 = true;
+    }
+#endif /* PAS_X86_64 */
+
     verse_heap_is_ready_for_allocation = true;
 
     pas_heap_lock_unlock();
 }
 
+void verse_heap_fold_live_bytes(void)
+{
+    unsigned index;
+
+    for (index = 0; index < VERSE_HEAP_NUM_LIVE_BYTES_SHARDS; ++index) {
+        uintptr_t pending_bytes;
+
+        pending_bytes = verse_heap_live_bytes_shard_take(verse_heap_live_bytes_shards + index);
+        if (pending_bytes)
+            pas_atomic_exchange_add_uintptr(&verse_heap_live_bytes, pending_bytes);
+    }
+}
+
 static pas_aligned_allocation_result large_heap_aligned_allocator(size_t size, pas_alignment alignment, void* arg)
 {
     pas_heap* heap;
@@ -284,58 +343,18 @@ static void initialize_large_heap_config(pas_heap* heap, pas_large_free_heap_con
     config->deallocator_arg = NULL;
 }
 
-static pas_allocation_result try_allocate_large_in_transaction(
-    pas_heap* heap, size_t size, size_t alignment, pas_physical_memory_transaction* transaction)
+static pas_allocation_result finish_allocating_large(
+    pas_heap* heap, pas_allocation_result chunk_result, size_t chunked_size, size_t size, size_t alignment)
 {
     static const bool verbose = false;
     
-    pas_large_free_heap_config config;
     verse_heap_large_entry* large_entry;
     verse_heap_chunk_map_entry_header entry_header;
-    pas_allocation_result chunk_result;
     pas_allocation_result result;
     uintptr_t address;
-    size_t chunked_size;
 
     pas_heap_lock_assert_held();
 
-    /* The segregated path is more forgiving of size/alignment than we are. */
-    if (!size)
-        size = VERSE_HEAP_CHUNK_SIZE;
-
-    alignment = pas_max_uintptr(alignment, verse_heap_type_get_size(heap->type));
-
-    PAS_ASSERT(alignment < VERSE_HEAP_CHUNK_SIZE);
-
-    size = pas_round_up_to_power_of_2(size, alignment);
-    chunked_size = pas_round_up_to_power_of_2(
-        pas_round_up_to_power_of_2(VERSE_HEAP_PAGE_SIZE, alignment) + size,
-        VERSE_HEAP_CHUNK_SIZE);
-
-    initialize_large_heap_config(heap, &config);
-    chunk_result = pas_fast_large_free_heap_try_allocate(
-        &heap->large_heap.u.free_heap, chunked_size, pas_alignment_create_traditional(VERSE_HEAP_CHUNK_SIZE),
-        &config);
-
-    if (verbose)
-        pas_log("allocated chunk = %p...%p\n", (void*)chunk_result.begin, (void*)(chunk_result.begin + chunked_size));
-
-    if (!chunk_result.did_succeed)
-        return pas_allocation_result_create_failure();
-
-    PAS_ASSERT(pas_is_aligned(chunk_result.begin, alignment));
-    PAS_ASSERT(pas_is_aligned(chunk_result.begin, VERSE_HEAP_CHUNK_SIZE));
-
-    if (!pas_large_sharing_pool_allocate_and_commit(
-            pas_range_create(chunk_result.begin, chunk_result.begin + chunked_size),
-            transaction, pas_physical_memory_is_locked_by_virtual_range_common_lock,
-            heap->segregated_heap.runtime_config->mmap_capability)) {
-        pas_fast_large_free_heap_deallocate(
-            &heap->large_heap.u.free_heap, chunk_result.begin, chunk_result.begin + chunked_size,
-            chunk_result.zero_mode, &config);
-        return pas_allocation_result_create_failure();
-    }
-
     result = chunk_result;
     result.begin += VERSE_HEAP_PAGE_SIZE;
     result.begin = pas_round_up_to_power_of_2(result.begin, alignment);
@@ -343,7 +362,8 @@ static pas_allocation_result try_allocate_large_in_transaction(
 
     if (verbose)
         pas_log("size = %zu, chunked_size = %zu\n", size, chunked_size);
-    large_entry = verse_heap_large_entry_create(result.begin, result.begin + size, heap);
+    large_entry = verse_heap_large_entry_create(
+        result.begin, result.begin + size, heap, chunk_result.zero_mode);
     entry_header = verse_heap_chunk_map_entry_header_create_large(large_entry);
 
     verse_heap_set_is_marked(
@@ -369,7 +389,9 @@ static pas_allocation_result try_allocate_large_in_transaction(
     verse_heap_object_set_set_add_large_entry(
         &((verse_heap_runtime_config*)heap->segregated_heap.runtime_config)->object_sets, large_entry);
 
-    verse_heap_notify_allocation(size);
+    if (!((verse_heap_runtime_config*)heap->segregated_heap.runtime_config)
+        ->large_objects_are_uncounted)
+        verse_heap_notify_allocation(size);
 
     if (verbose)
         pas_log("allocated large object at %p\n", (void*)result.begin);
@@ -377,14 +399,86 @@ static pas_allocation_result try_allocate_large_in_transaction(
     return result;
 }
 
+static pas_allocation_result try_allocate_large_in_transaction(
+    pas_heap* heap, size_t size, size_t alignment, size_t chunked_size,
+    pas_physical_memory_transaction* transaction)
+{
+    static const bool verbose = false;
+    
+    pas_large_free_heap_config config;
+    pas_allocation_result chunk_result;
+
+    pas_heap_lock_assert_held();
+
+    initialize_large_heap_config(heap, &config);
+    chunk_result = pas_fast_large_free_heap_try_allocate(
+        &heap->large_heap.u.free_heap, chunked_size, pas_alignment_create_traditional(VERSE_HEAP_CHUNK_SIZE),
+        &config);
+
+    if (verbose)
+        pas_log("allocated chunk = %p...%p\n", (void*)chunk_result.begin, (void*)(chunk_result.begin + chunked_size));
+
+    if (!chunk_result.did_succeed)
+        return pas_allocation_result_create_failure();
+
+    PAS_ASSERT(pas_is_aligned(chunk_result.begin, alignment));
+    PAS_ASSERT(pas_is_aligned(chunk_result.begin, VERSE_HEAP_CHUNK_SIZE));
+
+    if (!pas_large_sharing_pool_allocate_and_commit(
+            pas_range_create(chunk_result.begin, chunk_result.begin + chunked_size),
+            transaction, pas_physical_memory_is_locked_by_virtual_range_common_lock,
+            heap->segregated_heap.runtime_config->mmap_capability)) {
+        pas_fast_large_free_heap_deallocate(
+            &heap->large_heap.u.free_heap, chunk_result.begin, chunk_result.begin + chunked_size,
+            chunk_result.zero_mode, &config);
+        return pas_allocation_result_create_failure();
+    }
+
+    return finish_allocating_large(heap, chunk_result, chunked_size, size, alignment);
+}
+
 static void* try_allocate_large(
     pas_heap* heap, size_t size, size_t alignment, pas_allocation_result_filter result_filter)
 {
     pas_physical_memory_transaction transaction;
     pas_allocation_result result;
+    size_t chunked_size;
+    uintptr_t cached_begin;
+    pas_zero_mode cached_zero_mode;
 
     PAS_ASSERT(heap->config_kind == pas_heap_config_kind_verse);
 
+    /* The segregated path is more forgiving of size/alignment than we are. */
+    if (!size)
+        size = VERSE_HEAP_CHUNK_SIZE;
+
+    alignment = pas_max_uintptr(alignment, verse_heap_type_get_size(heap->type));
+
+    PAS_ASSERT(alignment < VERSE_HEAP_CHUNK_SIZE);
+
+    size = pas_round_up_to_power_of_2(size, alignment);
+    chunked_size = pas_round_up_to_power_of_2(
+        pas_round_up_to_power_of_2(VERSE_HEAP_PAGE_SIZE, alignment) + size,
+        VERSE_HEAP_CHUNK_SIZE);
+
+    /* A cached range is still committed and still allocated as far as the large sharing pool is
+       concerned, so we only need the heap lock for the bookkeeping. */
+    cached_begin = verse_heap_large_cache_try_take(
+        &((verse_heap_runtime_config*)heap->segregated_heap.runtime_config)->large_object_cache,
+        chunked_size, &cached_zero_mode);
+    if (cached_begin) {
+        pas_allocation_result chunk_result;
+
+        chunk_result = pas_allocation_result_create_success_with_zero_mode(
+            cached_begin, cached_zero_mode);
+        
+        pas_heap_lock_lock();
+        result = finish_allocating_large(heap, chunk_result, chunked_size, size, alignment);
+        pas_heap_lock_unlock();
+
+        return (void*)result_filter(result).begin;
+    }
+
     result = pas_allocation_result_create_failure();
 
     pas_physical_memory_transaction_construct(&transaction);
@@ -393,7 +487,7 @@ static void* try_allocate_large(
         pas_physical_memory_transaction_begin(&transaction);
         pas_heap_lock_lock();
 
-        result = try_allocate_large_in_transaction(heap, size, alignment, &transaction);
+        result = try_allocate_large_in_transaction(heap, size, alignment, chunked_size, &transaction);
 
         pas_heap_lock_unlock();
     } while (!pas_physical_memory_transaction_end(&transaction));
@@ -490,7 +584,7 @@ void verse_heap_start_allocating_black_before_handshake(void)
     verse_heap_allocating_black_version = (uint64_t)verse_heap_allocate_black;
 }
 
-void verse_heap_start_sweep_before_handshake(void)
+static void start_sweep_before_handshake(bool is_sticky)
 {
     static const bool verbose = false;
     
@@ -500,11 +594,28 @@ void verse_heap_start_sweep_before_handshake(void)
 	PAS_ASSERT(verse_heap_mark_bits_page_commit_controller_is_locked);
     verse_heap_allocating_black_version = ++verse_heap_latest_version;
     verse_heap_is_sweeping = true;
+    verse_heap_sweep_is_sticky = is_sticky;
 	verse_heap_swept_bytes = 0;
+    verse_heap_swept_small_pages = 0;
+    verse_heap_swept_small_page_live_bytes = 0;
+    verse_heap_swept_small_page_capacity_bytes = 0;
+    verse_heap_deferred_small_pages = 0;
     PAS_ASSERT(verse_heap_allocating_black_version >= VERSE_HEAP_FIRST_VERSION);
 
-    if (verbose)
-        pas_log("Sweeping with version %" PRIu64 "\n", verse_heap_allocating_black_version);
+    if (verbose) {
+        pas_log("Sweeping with version %" PRIu64 "%s\n", verse_heap_allocating_black_version,
+                is_sticky ? " (sticky)" : "");
+    }
+}
+
+void verse_heap_start_sweep_before_handshake(void)
+{
+    start_sweep_before_handshake(false);
+}
+
+void verse_heap_start_sticky_sweep_before_handshake(void)
+{
+    start_sweep_before_handshake(true);
 }
 
 size_t verse_heap_start_sweep_after_handshake(void)
@@ -525,6 +636,7 @@ void verse_heap_end_sweep(void)
 	PAS_ASSERT(verse_heap_mark_bits_page_commit_controller_is_locked);
     verse_heap_allocating_black_version = (uint64_t)verse_heap_do_not_allocate_black;
     verse_heap_is_sweeping = false;
+    verse_heap_sweep_is_sticky = false;
 	pas_scavenger_notify_eligibility_if_needed();
 }
 
@@ -560,6 +672,10 @@ static PAS_ALWAYS_INLINE bool sweep_handle_header(verse_heap_page_header* header
 typedef struct {
     size_t view_end;
 	size_t bytes_swept;
+    size_t num_small_pages;
+    size_t small_page_live_bytes;
+    size_t small_page_capacity_bytes;
+    size_t num_deferred_small_pages;
 } sweep_data;
 
 static void did_sweep_bytes(sweep_data* data, size_t bytes)
@@ -572,6 +688,79 @@ static void did_sweep_bytes(sweep_data* data, size_t bytes)
 	PAS_ASSERT(!did_overflow);
 }
 
+/* Clears the alloc bits of the objects whose mark bits are clear, resets the mark bits (or, for
+   sticky sweeps, leaves just the live objects' bits set), and returns how many objects are live. */
+static PAS_ALWAYS_INLINE size_t sweep_small_bits_portable(unsigned* alloc_bits, unsigned* mark_bits,
+                                                          size_t begin, size_t end)
+{
+    size_t num_objects;
+    size_t index;
+
+    num_objects = 0;
+    for (index = end; index-- > begin;) {
+        unsigned word;
+        word = alloc_bits[index];
+        word &= mark_bits[index];
+        alloc_bits[index] = word;
+        mark_bits[index] = verse_heap_sweep_is_sticky ? word : 0;
+        num_objects += pas_popcount_uint32(word);
+    }
+
+    return num_objects;
+}
+
+#if PAS_X86_64
+/* Does the same as sweep_small_bits_portable(), 256 bits at a time, counting the live objects with
+   the nibble lookup popcount. Runs of bits where every allocated object is live, or where the mark
+   bits are already what they should end up as, are common (fully live and fully dead pages), so we
+   only store the words that change. That keeps the sweep from dirtying those cache lines. */
+static __attribute__((target("avx2"))) size_t sweep_small_bits_avx2(
+    unsigned* alloc_bits, unsigned* mark_bits, size_t num_words)
+{
+    const __m256i nibble_counts = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i counts;
+    size_t index;
+    size_t num_objects;
+
+    counts = zero;
+    for (index = 0; index + 8 <= num_words; index += 8) {
+        __m256i alloc;
+        __m256i mark;
+        __m256i live;
+        __m256i bytes;
+
+        alloc = _mm256_loadu_si256((const __m256i*)(alloc_bits + index));
+        mark = _mm256_loadu_si256((const __m256i*)(mark_bits + index));
+        live = _mm256_and_si256(alloc, mark);
+
+        /* testc is true if every allocated object is marked, so the alloc bits don't change. */
+        if (!_mm256_testc_si256(mark, alloc))
+            _mm256_storeu_si256((__m256i*)(alloc_bits + index), live);
+        if (verse_heap_sweep_is_sticky) {
+            /* Same thing the other way around: the mark bits only change if something that isn't
+               allocated is marked. */
+            if (!_mm256_testc_si256(alloc, mark))
+                _mm256_storeu_si256((__m256i*)(mark_bits + index), live);
+        } else if (!_mm256_testz_si256(mark, mark))
+            _mm256_storeu_si256((__m256i*)(mark_bits + index), zero);
+
+        bytes = _mm256_add_epi8(
+            _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(live, low_nibbles)),
+            _mm256_shuffle_epi8(nibble_counts,
+                                _mm256_and_si256(_mm256_srli_epi16(live, 4), low_nibbles)));
+        counts = _mm256_add_epi64(counts, _mm256_sad_epu8(bytes, zero));
+    }
+
+    num_objects = (size_t)_mm256_extract_epi64(counts, 0) + (size_t)_mm256_extract_epi64(counts, 1)
+        + (size_t)_mm256_extract_epi64(counts, 2) + (size_t)_mm256_extract_epi64(counts, 3);
+    return num_objects + sweep_small_bits_portable(alloc_bits, mark_bits, index, num_words);
+}
+#endif /* PAS_X86_64 */
+
 static PAS_ALWAYS_INLINE void sweep_segregated_exclusive_view_impl_small(sweep_data* my_sweep_data,
 																		 pas_segregated_exclusive_view* view,
                                                                          pas_segregated_page* page,
@@ -580,23 +769,26 @@ static PAS_ALWAYS_INLINE void sweep_segregated_exclusive_view_impl_small(sweep_d
     const pas_segregated_page_config config = VERSE_HEAP_CONFIG.small_segregated_config;
 
     unsigned* mark_bits_base;
-    size_t index;
     size_t num_objects;
     size_t new_live_bytes;
     size_t max_live_bytes;
+    double occupancy;
+    verse_heap_page_header* header;
 
     PAS_ASSERT(config.base.page_size == config.base.granule_size);
 
     mark_bits_base = verse_heap_mark_bits_base_for_boundary(page_boundary);
 
-    num_objects = 0;
-    for (index = pas_segregated_page_config_num_alloc_words(config); index--;) {
-        unsigned word;
-        word = page->alloc_bits[index];
-        word &= mark_bits_base[index];
-        page->alloc_bits[index] = word;
-        mark_bits_base[index] = 0;
-        num_objects += pas_popcount_uint32(word);
+#if PAS_X86_64
+    if (sweep_can_use_avx2) {
+        num_objects = sweep_small_bits_avx2(
+            page->alloc_bits, mark_bits_base, pas_segregated_page_config_num_alloc_words(config));
+    } else
+#endif /* PAS_X86_64 */
+    {
+        num_objects = sweep_small_bits_portable(
+            page->alloc_bits, mark_bits_base,
+            0, pas_segregated_page_config_num_alloc_words(config));
     }
 
     new_live_bytes = num_objects * page->object_size;
@@ -606,18 +798,36 @@ static PAS_ALWAYS_INLINE void sweep_segregated_exclusive_view_impl_small(sweep_d
 
     did_sweep_bytes(my_sweep_data, page->emptiness.num_non_empty_words_or_live_bytes - new_live_bytes);
 
-    if ((double)new_live_bytes / (double)max_live_bytes <= VERSE_HEAP_SMALL_PAGE_MAX_ELIGIBLE_OCCUPANCY
-        && pas_segregated_view_get_kind(page->owner) != pas_segregated_exclusive_view_kind) {
-        pas_segregated_exclusive_view_note_eligibility(
-            view, page, pas_segregated_deallocation_direct_mode, NULL, config);
+    header = verse_heap_page_header_for_segregated_page(page);
+    occupancy = (double)new_live_bytes / (double)max_live_bytes;
+
+    if (new_live_bytes) {
+        my_sweep_data->num_small_pages++;
+        my_sweep_data->small_page_live_bytes += new_live_bytes;
+        my_sweep_data->small_page_capacity_bytes += max_live_bytes;
     }
+
+    if (occupancy <= VERSE_HEAP_SMALL_PAGE_MAX_ELIGIBLE_OCCUPANCY
+        && pas_segregated_view_get_kind(page->owner) != pas_segregated_exclusive_view_kind) {
+        if (new_live_bytes
+            && occupancy < VERSE_HEAP_SMALL_PAGE_DEFER_ELIGIBILITY_OCCUPANCY
+            && !header->deferred_eligibility) {
+            header->deferred_eligibility = true;
+            my_sweep_data->num_deferred_small_pages++;
+        } else {
+            header->deferred_eligibility = false;
+            pas_segregated_exclusive_view_note_eligibility(
+                view, page, pas_segregated_deallocation_direct_mode, NULL, config);
+        }
+    } else
+        header->deferred_eligibility = false;
     
     if (new_live_bytes)
         page->emptiness.num_non_empty_words_or_live_bytes = new_live_bytes;
     else
         pas_segregated_page_note_full_emptiness(page, config);
 
-    verse_heap_page_header_for_segregated_page(page)->may_have_set_mark_bits_for_dead_objects = false;
+    header->may_have_set_mark_bits_for_dead_objects = false;
 }
 
 typedef struct {
@@ -653,7 +863,8 @@ static PAS_ALWAYS_INLINE bool sweep_segregated_exclusive_view_with_page_bit_call
     mark_bit_index = index.index << (data->config.base.min_align_shift - VERSE_HEAP_MIN_ALIGN_SHIFT);
 
     if (pas_bitvector_get(data->mark_bits_base, mark_bit_index)) {
-        pas_bitvector_set(data->mark_bits_base, mark_bit_index, false);
+        if (!verse_heap_sweep_is_sticky)
+            pas_bitvector_set(data->mark_bits_base, mark_bit_index, false);
         return true;
     }
 
@@ -810,28 +1021,50 @@ static bool sweep_large_filter_without_deallocating_callback(verse_heap_large_en
     return verse_heap_is_marked((void*)entry->begin);
 }
 
-static bool sweep_large_filter_and_deallocate_callback(verse_heap_large_entry* entry, void* arg)
+static void deallocate_large_chunks(pas_heap* heap, uintptr_t chunk_begin, uintptr_t chunk_end)
 {
     static const bool verbose = false;
 
+    pas_large_free_heap_config config;
+
+    pas_heap_lock_assert_held();
+
+    pas_large_sharing_pool_free(
+        pas_range_create(chunk_begin, chunk_end),
+        pas_physical_memory_is_locked_by_virtual_range_common_lock,
+        heap->segregated_heap.runtime_config->mmap_capability);
+
+    initialize_large_heap_config(heap, &config);
+
+    if (verbose)
+        pas_log("deallocating chunk = %p...%p\n", (void*)chunk_begin, (void*)chunk_end);
+
+    pas_fast_large_free_heap_deallocate(
+        &heap->large_heap.u.free_heap, chunk_begin, chunk_end, pas_zero_mode_may_have_non_zero, &config);
+}
+
+static bool sweep_large_filter_and_deallocate_callback(verse_heap_large_entry* entry, void* arg)
+{
 	sweep_data* data;
     size_t chunk_begin;
     size_t chunk_end;
     uintptr_t address;
     verse_heap_chunk_map_entry_header empty_entry_header;
-    pas_large_free_heap_config config;
     
     data = (sweep_data*)arg;
     
     if (verse_heap_is_marked((void*)entry->begin)) {
-        verse_heap_set_is_marked((void*)entry->begin, false);
+        if (!verse_heap_sweep_is_sticky)
+            verse_heap_set_is_marked((void*)entry->begin, false);
         return true;
     }
 
     chunk_begin = pas_round_down_to_power_of_2(entry->begin, VERSE_HEAP_CHUNK_SIZE);
     chunk_end = pas_round_up_to_power_of_2(entry->end, VERSE_HEAP_CHUNK_SIZE);
 
-    did_sweep_bytes(data, entry->end - entry->begin);
+    if (!((verse_heap_runtime_config*)entry->heap->segregated_heap.runtime_config)
+        ->large_objects_are_uncounted)
+        did_sweep_bytes(data, entry->end - entry->begin);
     
     PAS_ASSERT(chunk_end > chunk_begin);
 
@@ -841,18 +1074,10 @@ static bool sweep_large_filter_and_deallocate_callback(verse_heap_large_entry* e
             verse_heap_get_chunk_map_entry_ptr(address), empty_entry_header);
     }
 
-    pas_large_sharing_pool_free(
-        pas_range_create(chunk_begin, chunk_end),
-        pas_physical_memory_is_locked_by_virtual_range_common_lock,
-        entry->heap->segregated_heap.runtime_config->mmap_capability);
-
-    initialize_large_heap_config(entry->heap, &config);
-
-    if (verbose)
-        pas_log("deallocating chunk = %p...%p\n", (void*)chunk_begin, (void*)chunk_end);
-
-    pas_fast_large_free_heap_deallocate(
-        &entry->heap->large_heap.u.free_heap, chunk_begin, chunk_end, pas_zero_mode_may_have_non_zero, &config);
+    if (!verse_heap_large_cache_try_put(
+            &((verse_heap_runtime_config*)entry->heap->segregated_heap.runtime_config)->large_object_cache,
+            chunk_begin, chunk_end - chunk_begin, pas_zero_mode_may_have_non_zero))
+        deallocate_large_chunks(entry->heap, chunk_begin, chunk_end);
 
     verse_heap_large_entry_destroy(entry);
 
@@ -939,6 +1164,10 @@ void verse_heap_sweep_range(size_t begin, size_t end)
 
 	data.view_end = 0;
 	data.bytes_swept = 0;
+    data.num_small_pages = 0;
+    data.small_page_live_bytes = 0;
+    data.small_page_capacity_bytes = 0;
+    data.num_deferred_small_pages = 0;
     
     PAS_ASSERT(verse_heap_is_sweeping);
     PAS_ASSERT(!verse_heap_current_iteration_state.version);
@@ -963,6 +1192,214 @@ void verse_heap_sweep_range(size_t begin, size_t end)
     verse_heap_view_vector_iterate(&verse_heap_all_objects.views, begin, sweep_view_callback, &data);
 
 	verse_heap_notify_sweep(data.bytes_swept);
+    pas_atomic_exchange_add_uintptr(&verse_heap_swept_small_pages, data.num_small_pages);
+    pas_atomic_exchange_add_uintptr(
+        &verse_heap_swept_small_page_live_bytes, data.small_page_live_bytes);
+    pas_atomic_exchange_add_uintptr(
+        &verse_heap_swept_small_page_capacity_bytes, data.small_page_capacity_bytes);
+    pas_atomic_exchange_add_uintptr(
+        &verse_heap_deferred_small_pages, data.num_deferred_small_pages);
+}
+
+static void large_cache_drain_callback(uintptr_t begin, size_t size, void* arg)
+{
+    deallocate_large_chunks((pas_heap*)arg, begin, begin + size);
+}
+
+typedef struct {
+    uint64_t max_epoch;
+    bool result;
+} large_cache_scavenge_data;
+
+static bool large_cache_scavenge_heap_callback(pas_heap* heap, void* arg)
+{
+    large_cache_scavenge_data* data;
+
+    data = (large_cache_scavenge_data*)arg;
+
+    if (heap->config_kind != pas_heap_config_kind_verse)
+        return true;
+
+    data->result |= verse_heap_large_cache_drain(
+        &((verse_heap_runtime_config*)heap->segregated_heap.runtime_config)->large_object_cache,
+        data->max_epoch, large_cache_drain_callback, heap);
+    return true;
+}
+
+bool verse_heap_large_cache_scavenge_periodic(uint64_t max_epoch)
+{
+    large_cache_scavenge_data data;
+
+    data.max_epoch = max_epoch;
+    data.result = false;
+
+    pas_heap_lock_lock();
+    pas_all_heaps_for_each_heap(large_cache_scavenge_heap_callback, &data);
+    pas_heap_lock_unlock();
+
+    return data.result;
+}
+
+void verse_heap_large_cache_flush(void)
+{
+    PAS_ASSERT(!verse_heap_large_cache_scavenge_periodic(PAS_EPOCH_MAX));
+}
+
+void verse_heap_large_cache_zero(pas_heap* heap, void (*zero)(void* begin, size_t size))
+{
+    verse_heap_large_cache* cache;
+
+    PAS_ASSERT(heap->config_kind == pas_heap_config_kind_verse);
+
+    cache = &((verse_heap_runtime_config*)heap->segregated_heap.runtime_config)->large_object_cache;
+
+    for (;;) {
+        uintptr_t begin;
+        size_t size;
+
+        /* Taking the range out of the cache means that nobody can allocate in it while we zero it,
+           and we don't need the heap lock for that. */
+        begin = verse_heap_large_cache_try_take_non_zero(cache, &size);
+        if (!begin)
+            return;
+
+        zero((void*)(begin + VERSE_HEAP_PAGE_SIZE), size - VERSE_HEAP_PAGE_SIZE);
+
+        pas_heap_lock_lock();
+        if (!verse_heap_large_cache_try_put(cache, begin, size, pas_zero_mode_is_all_zero))
+            deallocate_large_chunks(heap, begin, begin + size);
+        pas_heap_lock_unlock();
+    }
+}
+
+static pas_allocation_result try_allocate_reserve_in_transaction(
+    pas_heap* heap, size_t size, pas_physical_memory_transaction* transaction)
+{
+    pas_large_free_heap_config config;
+    pas_allocation_result result;
+
+    pas_heap_lock_assert_held();
+
+    initialize_large_heap_config(heap, &config);
+    result = pas_fast_large_free_heap_try_allocate(
+        &heap->large_heap.u.free_heap, size, pas_alignment_create_traditional(VERSE_HEAP_CHUNK_SIZE),
+        &config);
+    if (!result.did_succeed)
+        return result;
+
+    if (!pas_large_sharing_pool_allocate_and_commit(
+            pas_range_create(result.begin, result.begin + size),
+            transaction, pas_physical_memory_is_locked_by_virtual_range_common_lock,
+            heap->segregated_heap.runtime_config->mmap_capability)) {
+        pas_fast_large_free_heap_deallocate(
+            &heap->large_heap.u.free_heap, result.begin, result.begin + size, result.zero_mode, &config);
+        return pas_allocation_result_create_failure();
+    }
+
+    return result;
+}
+
+bool verse_heap_reserve_memory(pas_heap* heap, size_t bytes, bool should_populate)
+{
+    pas_physical_memory_transaction transaction;
+    pas_allocation_result result;
+    size_t size;
+
+    PAS_ASSERT(heap->config_kind == pas_heap_config_kind_verse);
+
+    size = pas_round_up_to_power_of_2(bytes, VERSE_HEAP_CHUNK_SIZE);
+    if (size < bytes)
+        return false;
+    if (!size)
+        return true;
+
+    result = pas_allocation_result_create_failure();
+
+    /* This is just like allocating a large object, except that nobody gets to use it yet. */
+    pas_physical_memory_transaction_construct(&transaction);
+    do {
+        PAS_ASSERT(!result.did_succeed);
+        pas_physical_memory_transaction_begin(&transaction);
+        pas_heap_lock_lock();
+
+        result = try_allocate_reserve_in_transaction(heap, size, &transaction);
+
+        pas_heap_lock_unlock();
+    } while (!pas_physical_memory_transaction_end(&transaction));
+
+    if (!result.did_succeed)
+        return false;
+
+    /* Nobody else knows about this memory yet, so it's safe to touch it without holding locks. Zeroing
+       it populates it, too. */
+    if (result.zero_mode != pas_zero_mode_is_all_zero)
+        pas_zero_memory((void*)result.begin, size);
+    else if (should_populate)
+        verse_heap_reserve_populate(result.begin, size);
+
+    pas_heap_lock_lock();
+    verse_heap_reserve_put(
+        &((verse_heap_runtime_config*)heap->segregated_heap.runtime_config)->reserve, result.begin, size);
+    verse_heap_reserve_target_bytes += size;
+    pas_heap_lock_unlock();
+
+    pas_scavenger_did_create_eligible();
+    pas_scavenger_notify_eligibility_if_needed();
+
+    return true;
+}
+
+static bool reserve_trim_heap_callback(pas_heap* heap, void* arg)
+{
+    size_t* excess;
+    verse_heap_runtime_config* runtime_config;
+
+    excess = (size_t*)arg;
+
+    if (heap->config_kind != pas_heap_config_kind_verse)
+        return true;
+
+    runtime_config = (verse_heap_runtime_config*)heap->segregated_heap.runtime_config;
+
+    /* Going one chunk at a time means that fragmentation of the reserve can't get in our way. The
+       large free heap coalesces the chunks again. */
+    while (*excess >= VERSE_HEAP_CHUNK_SIZE && runtime_config->reserve.num_bytes) {
+        pas_allocation_result result;
+
+        result = verse_heap_reserve_try_take(
+            &runtime_config->reserve, VERSE_HEAP_CHUNK_SIZE, pas_primordial_page_is_committed,
+            runtime_config->base.mmap_capability);
+        PAS_ASSERT(result.did_succeed);
+
+        deallocate_large_chunks(heap, result.begin, result.begin + VERSE_HEAP_CHUNK_SIZE);
+        *excess -= VERSE_HEAP_CHUNK_SIZE;
+    }
+
+    return *excess >= VERSE_HEAP_CHUNK_SIZE;
+}
+
+void verse_heap_reserve_trim(void)
+{
+    size_t excess;
+
+    pas_heap_lock_lock();
+
+    if (pas_scavenger_current_memory_pressure == pas_scavenger_high_memory_pressure) {
+        /* Holding on to memory that nobody is using is the last thing we should do right now. */
+        excess = verse_heap_reserve_num_bytes;
+        verse_heap_reserve_target_bytes = 0;
+    } else {
+        excess = verse_heap_reserve_get_spare_bytes();
+        if (excess > verse_heap_reserve_slack_bytes)
+            excess -= verse_heap_reserve_slack_bytes;
+        else
+            excess = 0;
+    }
+
+    if (excess)
+        pas_all_heaps_for_each_heap(reserve_trim_heap_callback, &excess);
+
+    pas_heap_lock_unlock();
 }
 
 pas_thread_local_cache_node* verse_heap_get_thread_local_cache_node(void)
@@ -27,6 +27,7 @@
 #define VERSE_HEAP_H
 
 #include "pas_bitvector.h"
+#include "pas_fast_tls.h"
 #include "pas_immutable_vector.h"
 #include "pas_simple_large_free_heap.h"
 #include "pas_thread_local_cache_layout_node.h"
@@ -59,16 +60,65 @@ PAS_API extern pas_simple_large_free_heap verse_heap_page_cache;
 
 PAS_API extern uint64_t verse_heap_latest_version;
 
+/* Returns the large object ranges that every heap's large cache has been holding since before
+   max_epoch to the large free heap. Returns true if any ranges are still cached. */
+PAS_API bool verse_heap_large_cache_scavenge_periodic(uint64_t max_epoch);
+
+/* Returns all cached large object ranges to the large free heap. */
+PAS_API void verse_heap_large_cache_flush(void);
+
+/* Zeroes the ranges in this heap's large cache that aren't known to be zero yet, so that large
+   allocations that reuse them can skip zeroing. The zero callback does the actual zeroing, which
+   lets the caller skip pages that it knows are still zero instead of committing them. Call without
+   any locks, from a thread that doesn't mind spending the time. */
+PAS_API void verse_heap_large_cache_zero(pas_heap* heap, void (*zero)(void* begin, size_t size));
+
+/* Commits at least bytes worth of chunks and puts them in the heap's reserve (see
+   verse_heap_reserve.h), which includes the mark bits pages of those chunks. If should_populate is
+   true, this also faults them in. Returns false if the memory couldn't be had. */
+PAS_API bool verse_heap_reserve_memory(pas_heap* heap, size_t bytes, bool should_populate);
+
+/* Gives the spare reserve memory beyond verse_heap_reserve_slack_bytes back to the large free heap,
+   where the scavenger can decommit it. Under high memory pressure, the whole reserve is given back
+   and the target is forgotten. */
+PAS_API void verse_heap_reserve_trim(void);
+
 PAS_API extern verse_heap_page_header verse_heap_large_objects_header;
 
 PAS_API extern uint64_t verse_heap_allocating_black_version;
 PAS_API extern bool verse_heap_is_sweeping;
+PAS_API extern bool verse_heap_sweep_is_sticky;
 
 PAS_API extern verse_heap_iteration_state verse_heap_current_iteration_state;
 PAS_API extern size_t verse_heap_num_large_entries_for_iteration;
 
 PAS_API extern pas_allocator_counts verse_heap_allocator_counts;
 
+/* Allocations can be counted in shards first, so that allocating threads don't all CAS the same
+   cache line. A shard's bytes get folded into verse_heap_live_bytes once there are more than
+   verse_heap_live_bytes_slack / VERSE_HEAP_NUM_LIVE_BYTES_SHARDS of them, and that's also when the
+   trigger threshold is checked. So, verse_heap_live_bytes and the trigger can lag behind the truth
+   by up to the slack. With a slack of zero, which is the default, nothing is ever sharded.
+
+   Deallocations always go straight to verse_heap_live_bytes. */
+#define VERSE_HEAP_LIVE_BYTES_SHARD_SHIFT 5
+#define VERSE_HEAP_NUM_LIVE_BYTES_SHARDS (1u << VERSE_HEAP_LIVE_BYTES_SHARD_SHIFT)
+
+struct verse_heap_live_bytes_shard;
+typedef struct verse_heap_live_bytes_shard verse_heap_live_bytes_shard;
+
+struct PAS_ALIGNED(64) verse_heap_live_bytes_shard {
+    uintptr_t pending_bytes;
+};
+
+PAS_API extern verse_heap_live_bytes_shard
+    verse_heap_live_bytes_shards[VERSE_HEAP_NUM_LIVE_BYTES_SHARDS];
+PAS_API extern size_t verse_heap_live_bytes_slack;
+
+/* Folds all of the shards into verse_heap_live_bytes, so that it counts every allocation that
+   happened before this call. Doesn't call the trigger callback. */
+PAS_API void verse_heap_fold_live_bytes(void);
+
 PAS_DECLARE_IMMUTABLE_VECTOR(verse_heap_thread_local_cache_layout_node_vector,
 							 pas_thread_local_cache_layout_node);
 
@@ -170,14 +220,51 @@ static PAS_ALWAYS_INLINE verse_heap_iteration_state verse_heap_get_iteration_sta
     return result;
 }
 
+static PAS_ALWAYS_INLINE uintptr_t
+verse_heap_live_bytes_shard_take(verse_heap_live_bytes_shard* shard)
+{
+    for (;;) {
+        uintptr_t pending_bytes;
+
+        pending_bytes = shard->pending_bytes;
+        if (!pending_bytes)
+            return 0;
+        if (pas_compare_and_swap_uintptr_weak(&shard->pending_bytes, pending_bytes, 0))
+            return pending_bytes;
+    }
+}
+
+/* Any thread can use any shard. We just want threads to spread out, and the thread's fast TLS value
+   (its thread local cache, if it has one) is a cheap thing to hash. */
+static PAS_ALWAYS_INLINE verse_heap_live_bytes_shard* verse_heap_get_live_bytes_shard(void)
+{
+    uint64_t hash;
+    hash = (uint64_t)(uintptr_t)pas_fast_tls_get() * 0x9e3779b97f4a7c15llu;
+    return verse_heap_live_bytes_shards + (hash >> (64 - VERSE_HEAP_LIVE_BYTES_SHARD_SHIFT));
+}
+
 static PAS_ALWAYS_INLINE void verse_heap_notify_allocation(uintptr_t bytes_allocated)
 {
 	uintptr_t new_live_bytes;
+    uintptr_t shard_budget;
 	
     PAS_ASSERT((intptr_t)bytes_allocated >= 0);
 
     if (!bytes_allocated)
         return;
+
+    shard_budget = verse_heap_live_bytes_slack / VERSE_HEAP_NUM_LIVE_BYTES_SHARDS;
+    if (shard_budget) {
+        verse_heap_live_bytes_shard* shard;
+
+        shard = verse_heap_get_live_bytes_shard();
+        if (pas_atomic_exchange_add_uintptr(&shard->pending_bytes, bytes_allocated)
+            + bytes_allocated < shard_budget)
+            return;
+        bytes_allocated = verse_heap_live_bytes_shard_take(shard);
+        if (!bytes_allocated)
+            return; /* Someone else folded this shard for us. */
+    }
     
     for (;;) {
         uintptr_t old_live_bytes;
@@ -206,6 +293,11 @@ static PAS_ALWAYS_INLINE void verse_heap_notify_deallocation(uintptr_t bytes_dea
 		uintptr_t new_live_bytes;
         
         old_live_bytes = verse_heap_live_bytes;
+        if (bytes_deallocated > old_live_bytes && verse_heap_live_bytes_slack) {
+            /* The bytes we're deallocating were counted in a shard that hasn't been folded yet. */
+            verse_heap_fold_live_bytes();
+            old_live_bytes = verse_heap_live_bytes;
+        }
         new_live_bytes = old_live_bytes - bytes_deallocated;
         PAS_ASSERT(new_live_bytes < old_live_bytes);
 
@@ -38,6 +38,13 @@ PAS_BEGIN_EXTERN_C;
 
 #define VERSE_HEAP_SMALL_PAGE_MAX_ELIGIBLE_OCCUPANCY ((double)0.7)
 
+/* Small pages that are less full than this after a sweep sit out the next cycle before they become
+   eligible for allocation again. Otherwise, allocators would keep refilling the sparsest pages, and
+   they'd never get empty enough to be decommitted. If a page is still that sparse after the next
+   sweep, then it becomes eligible anyway, so a page can't get stuck holding a few immortal
+   objects. */
+#define VERSE_HEAP_SMALL_PAGE_DEFER_ELIGIBILITY_OCCUPANCY ((double)0.1)
+
 #define VERSE_HEAP_SMALL_SEGREGATED_GRANULE_SIZE VERSE_HEAP_SMALL_SEGREGATED_PAGE_SIZE
 #define VERSE_HEAP_SMALL_SEGREGATED_HEADER_SIZE \
     (sizeof(verse_heap_page_header) + \
@@ -219,6 +219,22 @@ static PAS_ALWAYS_INLINE size_t verse_heap_get_allocation_size_inline(uintptr_t
     return page->object_size;
 }
 
+/* Tells if the object that inner_ptr points into is a large object whose memory was known to be all
+   zero when it was allocated. Only meaningful for an object that was just allocated and that nobody
+   has written to yet. */
+static PAS_ALWAYS_INLINE bool verse_heap_is_known_zero_large_object(uintptr_t inner_ptr)
+{
+    verse_heap_chunk_map_entry_header entry_header;
+
+    entry_header = verse_heap_get_chunk_map_entry_header(inner_ptr);
+
+    if (!verse_heap_chunk_map_entry_header_is_large(entry_header))
+        return false;
+
+    return verse_heap_chunk_map_entry_header_large_entry(entry_header)->zero_mode
+        == pas_zero_mode_is_all_zero;
+}
+
 static PAS_ALWAYS_INLINE pas_segregated_page* verse_heap_get_segregated_page(uintptr_t inner_ptr)
 {
     verse_heap_chunk_map_entry_header entry_header;
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "verse_heap_large_cache.h"
+
+#include "pas_epoch.h"
+#include "pas_heap_lock.h"
+#include "pas_scavenger.h"
+
+#if PAS_ENABLE_VERSE
+
+size_t verse_heap_large_cache_max_bytes = 32 * 1024 * 1024;
+
+bool verse_heap_large_cache_try_put(verse_heap_large_cache* cache,
+                                    uintptr_t begin,
+                                    size_t size,
+                                    pas_zero_mode zero_mode)
+{
+    size_t index;
+
+    pas_heap_lock_assert_held();
+
+    if (size > verse_heap_large_cache_max_bytes / 4
+        || cache->num_bytes + size > verse_heap_large_cache_max_bytes)
+        return false;
+
+    /* Under pressure, the memory is better off back in the sharing pool where the scavenger can get
+       at it. */
+    if (pas_scavenger_current_memory_pressure == pas_scavenger_high_memory_pressure)
+        return false;
+
+    for (index = 0; index < VERSE_HEAP_LARGE_CACHE_NUM_SLOTS; ++index) {
+        if (cache->slots[index])
+            continue;
+        cache->epochs[index] = pas_get_epoch();
+        pas_atomic_exchange_add_uintptr(&cache->num_bytes, size);
+        pas_store_store_fence();
+        /* Nobody but us can fill an empty slot, so this can't fail. */
+        PAS_ASSERT(!pas_compare_and_swap_uintptr_strong(
+                       cache->slots + index, 0,
+                       verse_heap_large_cache_encode(begin, size, zero_mode)));
+        return true;
+    }
+
+    return false;
+}
+
+uintptr_t verse_heap_large_cache_try_take(verse_heap_large_cache* cache,
+                                          size_t size,
+                                          pas_zero_mode* zero_mode)
+{
+    size_t index;
+
+    if (!cache->num_bytes)
+        return 0;
+
+    for (index = 0; index < VERSE_HEAP_LARGE_CACHE_NUM_SLOTS; ++index) {
+        uintptr_t slot;
+
+        slot = cache->slots[index];
+        if (!slot || verse_heap_large_cache_decode_size(slot) != size)
+            continue;
+        if (pas_compare_and_swap_uintptr_strong(cache->slots + index, slot, 0) != slot)
+            continue;
+        pas_atomic_exchange_add_uintptr(&cache->num_bytes, -size);
+        *zero_mode = verse_heap_large_cache_decode_zero_mode(slot);
+        return verse_heap_large_cache_decode_begin(slot);
+    }
+
+    return 0;
+}
+
+uintptr_t verse_heap_large_cache_try_take_non_zero(verse_heap_large_cache* cache, size_t* size)
+{
+    size_t index;
+
+    if (!cache->num_bytes)
+        return 0;
+
+    for (index = 0; index < VERSE_HEAP_LARGE_CACHE_NUM_SLOTS; ++index) {
+        uintptr_t slot;
+
+        slot = cache->slots[index];
+        if (!slot || verse_heap_large_cache_decode_zero_mode(slot) == pas_zero_mode_is_all_zero)
+            continue;
+        if (pas_compare_and_swap_uintptr_strong(cache->slots + index, slot, 0) != slot)
+            continue;
+        *size = verse_heap_large_cache_decode_size(slot);
+        pas_atomic_exchange_add_uintptr(&cache->num_bytes, -*size);
+        return verse_heap_large_cache_decode_begin(slot);
+    }
+
+    return 0;
+}
+
+bool verse_heap_large_cache_drain(verse_heap_large_cache* cache,
+                                  uint64_t max_epoch,
+                                  void (*callback)(uintptr_t begin, size_t size, void* arg),
+                                  void* arg)
+{
+    size_t index;
+    bool result;
+
+    pas_heap_lock_assert_held();
+
+    result = false;
+
+    for (index = 0; index < VERSE_HEAP_LARGE_CACHE_NUM_SLOTS; ++index) {
+        uintptr_t slot;
+        size_t size;
+
+        slot = cache->slots[index];
+        if (!slot)
+            continue;
+        if (cache->epochs[index] > max_epoch) {
+            result = true;
+            continue;
+        }
+        if (pas_compare_and_swap_uintptr_strong(cache->slots + index, slot, 0) != slot)
+            continue;
+        size = verse_heap_large_cache_decode_size(slot);
+        pas_atomic_exchange_add_uintptr(&cache->num_bytes, -size);
+        callback(verse_heap_large_cache_decode_begin(slot), size, arg);
+    }
+
+    return result;
+}
+
+#endif /* PAS_ENABLE_VERSE */
+
+#endif /* LIBPAS_ENABLED */
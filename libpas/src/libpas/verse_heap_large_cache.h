@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+#ifndef VERSE_HEAP_LARGE_CACHE_H
+#define VERSE_HEAP_LARGE_CACHE_H
+
+#include "pas_utils.h"
+#include "pas_zero_mode.h"
+#include "ue_include/verse_heap_config_ue.h"
+
+#if PAS_ENABLE_VERSE
+
+PAS_BEGIN_EXTERN_C;
+
+/* Each verse heap keeps a handful of the chunk ranges that the sweep freed from large objects, so
+   that the next large allocation of the same chunk count can have one without going through the
+   large free heap and the large sharing pool. Cached ranges stay committed and, as far as the large
+   sharing pool can tell, allocated. The scavenger returns ranges that have sat around for longer
+   than its max epoch delta.
+
+   Slots get filled only by the sweep and drained only by the scavenger, both holding the heap lock,
+   but they are taken by allocation without any lock. A slot holds the range's chunk-aligned begin
+   with the number of chunks in the low bits, or 0 if it's empty. The IS_ZERO bit says that
+   everything past the range's first page, which is the part that large objects go in, is known to
+   be zero. The collector sets it by zeroing cached ranges in between cycles (see
+   verse_heap_large_cache_zero()), so that allocation doesn't have to. */
+
+#define VERSE_HEAP_LARGE_CACHE_NUM_SLOTS 16u
+#define VERSE_HEAP_LARGE_CACHE_IS_ZERO ((uintptr_t)VERSE_HEAP_CHUNK_SIZE >> 1)
+
+struct verse_heap_large_cache;
+typedef struct verse_heap_large_cache verse_heap_large_cache;
+
+struct verse_heap_large_cache {
+    uintptr_t slots[VERSE_HEAP_LARGE_CACHE_NUM_SLOTS];
+    uint64_t epochs[VERSE_HEAP_LARGE_CACHE_NUM_SLOTS];
+    uintptr_t num_bytes;
+};
+
+/* This is per heap. Ranges bigger than a quarter of this don't get cached. Setting it to zero
+   turns off caching. */
+PAS_API extern size_t verse_heap_large_cache_max_bytes;
+
+static inline uintptr_t verse_heap_large_cache_encode(
+    uintptr_t begin, size_t size, pas_zero_mode zero_mode)
+{
+    uintptr_t num_chunks;
+    PAS_ASSERT(pas_is_aligned(begin, VERSE_HEAP_CHUNK_SIZE));
+    PAS_ASSERT(pas_is_aligned(size, VERSE_HEAP_CHUNK_SIZE));
+    num_chunks = size >> VERSE_HEAP_CHUNK_SIZE_SHIFT;
+    PAS_ASSERT(num_chunks);
+    PAS_ASSERT(num_chunks < VERSE_HEAP_LARGE_CACHE_IS_ZERO);
+    return begin | num_chunks
+        | (zero_mode == pas_zero_mode_is_all_zero ? VERSE_HEAP_LARGE_CACHE_IS_ZERO : 0);
+}
+
+static inline uintptr_t verse_heap_large_cache_decode_begin(uintptr_t slot)
+{
+    return pas_round_down_to_power_of_2(slot, VERSE_HEAP_CHUNK_SIZE);
+}
+
+static inline size_t verse_heap_large_cache_decode_size(uintptr_t slot)
+{
+    return pas_modulo_power_of_2(slot, VERSE_HEAP_LARGE_CACHE_IS_ZERO)
+        << VERSE_HEAP_CHUNK_SIZE_SHIFT;
+}
+
+static inline pas_zero_mode verse_heap_large_cache_decode_zero_mode(uintptr_t slot)
+{
+    return (slot & VERSE_HEAP_LARGE_CACHE_IS_ZERO)
+        ? pas_zero_mode_is_all_zero : pas_zero_mode_may_have_non_zero;
+}
+
+/* Call with the heap lock held. Returns false if the range should be freed the normal way. */
+PAS_API bool verse_heap_large_cache_try_put(verse_heap_large_cache* cache,
+                                            uintptr_t begin,
+                                            size_t size,
+                                            pas_zero_mode zero_mode);
+
+/* Call without any locks. Returns the begin of a cached range of exactly this size, or 0. Tells
+   whether the range is known zero via zero_mode. */
+PAS_API uintptr_t verse_heap_large_cache_try_take(verse_heap_large_cache* cache,
+                                                  size_t size,
+                                                  pas_zero_mode* zero_mode);
+
+/* Call without any locks. Returns the begin of any cached range that isn't known zero, or 0, and
+   sets size to its size. */
+PAS_API uintptr_t verse_heap_large_cache_try_take_non_zero(verse_heap_large_cache* cache,
+                                                           size_t* size);
+
+/* Call with the heap lock held. Empties every slot whose range was cached before max_epoch, passing
+   the range to the callback. Returns true if any ranges are still cached afterwards. */
+PAS_API bool verse_heap_large_cache_drain(verse_heap_large_cache* cache,
+                                          uint64_t max_epoch,
+                                          void (*callback)(uintptr_t begin, size_t size, void* arg),
+                                          void* arg);
+
+PAS_END_EXTERN_C;
+
+#endif /* PAS_ENABLE_VERSE */
+
+#endif /* VERSE_HEAP_LARGE_CACHE_H */
+
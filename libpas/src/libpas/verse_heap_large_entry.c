@@ -34,7 +34,8 @@
 
 #if PAS_ENABLE_VERSE
 
-verse_heap_large_entry* verse_heap_large_entry_create(uintptr_t begin, uintptr_t end, pas_heap* heap)
+verse_heap_large_entry* verse_heap_large_entry_create(
+    uintptr_t begin, uintptr_t end, pas_heap* heap, pas_zero_mode zero_mode)
 {
     verse_heap_large_entry* result;
 
@@ -44,6 +45,7 @@ verse_heap_large_entry* verse_heap_large_entry_create(uintptr_t begin, uintptr_t
     result->begin = begin;
     result->end = end;
     result->heap = heap;
+    result->zero_mode = zero_mode;
 
 	verse_heap_mark_bits_page_commit_controller_construct_large(
 		&result->mark_bits_page_commit_controller, pas_round_down_to_power_of_2(begin, VERSE_HEAP_CHUNK_SIZE));
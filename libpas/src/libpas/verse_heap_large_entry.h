@@ -26,6 +26,7 @@
 #ifndef VERSE_HEAP_LARGE_ENTRY_H
 #define VERSE_HEAP_LARGE_ENTRY_H
 
+#include "pas_zero_mode.h"
 #include "verse_heap_mark_bits_page_commit_controller.h"
 
 #if PAS_ENABLE_VERSE
@@ -41,11 +42,13 @@ struct verse_heap_large_entry {
     uintptr_t begin;
     uintptr_t end;
     pas_heap* heap;
+    pas_zero_mode zero_mode; /* Whether the object was known to be zero when it was allocated. */
 	verse_heap_mark_bits_page_commit_controller mark_bits_page_commit_controller;
 };
 
 /* These must be called with the heap lock held. */
-PAS_API verse_heap_large_entry* verse_heap_large_entry_create(uintptr_t begin, uintptr_t end, pas_heap* heap);
+PAS_API verse_heap_large_entry* verse_heap_large_entry_create(
+    uintptr_t begin, uintptr_t end, pas_heap* heap, pas_zero_mode zero_mode);
 PAS_API void verse_heap_large_entry_destroy(verse_heap_large_entry* entry);
 
 PAS_END_EXTERN_C;
@@ -31,9 +31,11 @@
 
 #include "pas_heap_lock.h"
 #include "pas_immortal_heap.h"
+#include "pas_page_malloc.h"
 #include "pas_scavenger.h"
 #include "verse_heap.h"
 #include "verse_heap_large_entry.h"
+#include "verse_heap_reserve.h"
 
 #if PAS_ENABLE_VERSE
 
@@ -82,28 +84,39 @@ void verse_heap_mark_bits_page_commit_controller_destruct_large(verse_heap_mark_
 	pas_atomic_exchange_add_uintptr(&verse_heap_mark_bits_page_commit_controller_num_committed, -1);
 }
 
+typedef void (*for_each_callback)(verse_heap_mark_bits_page_commit_controller* controller, void* arg);
+
+typedef struct {
+	for_each_callback callback;
+	void* arg;
+} for_each_data;
+
 static bool for_each_mark_bits_page_commit_controller_vector_callback(verse_heap_compact_mark_bits_page_commit_controller_ptr* ptr, size_t index, void *arg)
 {
 	verse_heap_mark_bits_page_commit_controller* controller;
-	void (*callback)(verse_heap_mark_bits_page_commit_controller* controller);
+	for_each_data* data;
 	
 	PAS_UNUSED_PARAM(index);
 
 	controller = verse_heap_compact_mark_bits_page_commit_controller_ptr_load_non_null(ptr);
-	callback = (void (*)(verse_heap_mark_bits_page_commit_controller* controller))arg;
+	data = (for_each_data*)arg;
 
-	callback(controller);
+	data->callback(controller, data->arg);
 
 	return true;
 }
 
-static void for_each_mark_bits_page_commit_controller(void (*callback)(verse_heap_mark_bits_page_commit_controller* controller))
+static void for_each_mark_bits_page_commit_controller(for_each_callback callback, void* arg)
 {
 	size_t index;
+	for_each_data data;
+
+	data.callback = callback;
+	data.arg = arg;
 	
 	verse_heap_mark_bits_page_commit_controller_vector_iterate(
 		&verse_heap_mark_bits_page_commit_controller_not_large_vector,
-		0, for_each_mark_bits_page_commit_controller_vector_callback, callback);
+		0, for_each_mark_bits_page_commit_controller_vector_callback, &data);
 
 	pas_heap_lock_lock();
 	for (index = 0; index < verse_heap_all_objects.num_large_entries; ++index) {
@@ -112,14 +125,15 @@ static void for_each_mark_bits_page_commit_controller(void (*callback)(verse_hea
 		entry = verse_heap_compact_large_entry_ptr_load_non_null(verse_heap_all_objects.large_entries + index);
 
 		pas_heap_lock_unlock();
-		callback(&entry->mark_bits_page_commit_controller);
+		callback(&entry->mark_bits_page_commit_controller, arg);
 		pas_heap_lock_lock();
 	}
 	pas_heap_lock_unlock();
 }
 
-static void lock_callback(verse_heap_mark_bits_page_commit_controller* controller)
+static void lock_callback(verse_heap_mark_bits_page_commit_controller* controller, void* arg)
 {
+	PAS_ASSERT(!arg);
 	pas_lock_assert_held(&verse_heap_mark_bits_page_commit_controller_commit_lock);
 
 	if (controller->is_committed)
@@ -139,7 +153,7 @@ void verse_heap_mark_bits_page_commit_controller_lock(void)
 	PAS_ASSERT(!verse_heap_mark_bits_page_commit_controller_is_locked);
 	verse_heap_mark_bits_page_commit_controller_is_locked = true;
 	if (verse_heap_mark_bits_page_commit_controller_num_decommitted)
-		for_each_mark_bits_page_commit_controller(lock_callback);
+		for_each_mark_bits_page_commit_controller(lock_callback, NULL);
 	PAS_ASSERT(!verse_heap_mark_bits_page_commit_controller_num_decommitted);
 	pas_lock_unlock(&verse_heap_mark_bits_page_commit_controller_commit_lock);
 	PAS_ASSERT(!verse_heap_mark_bits_page_commit_controller_num_decommitted);
@@ -160,9 +174,22 @@ void verse_heap_mark_bits_page_commit_controller_unlock(void)
 	pas_scavenger_notify_eligibility_if_needed();
 }
 
-static void decommit_callback(verse_heap_mark_bits_page_commit_controller* controller)
+typedef struct {
+	pas_page_malloc_decommit_batch batch;
+	size_t num_since_unlock;
+	bool did_abort;
+} decommit_data;
+
+static void decommit_callback(verse_heap_mark_bits_page_commit_controller* controller, void* arg)
 {
     static const bool verbose = false;
+
+	decommit_data* data;
+
+	data = (decommit_data*)arg;
+
+	if (data->did_abort)
+		return;
     
 	PAS_TESTING_ASSERT(!verse_heap_mark_bits_page_commit_controller_is_locked);
 	pas_lock_testing_assert_held(&verse_heap_mark_bits_page_commit_controller_commit_lock);
@@ -184,25 +211,40 @@ static void decommit_callback(verse_heap_mark_bits_page_commit_controller* contr
         pas_log("Decommitting %p with size %zu\n",
                 (void*)controller->chunk_base, (size_t)VERSE_HEAP_PAGE_SIZE);
     }
-	pas_page_malloc_decommit((void*)controller->chunk_base, VERSE_HEAP_PAGE_SIZE, pas_may_mmap);
+	pas_page_malloc_decommit_batch_add(
+		&data->batch, (void*)controller->chunk_base, VERSE_HEAP_PAGE_SIZE, pas_may_mmap);
 	PAS_ASSERT(!controller->is_committed);
+
+	if (++data->num_since_unlock < PAS_PAGE_MALLOC_DECOMMIT_BATCH_CAPACITY)
+		return;
+
+	/* A cycle that wants to start has to wait for the commit lock, so don't make it wait for more than
+	   one batch. Everything that we said is decommitted really is by the time we let go of the lock,
+	   so lock() can recommit it. If lock() got in, then we stop, since the mark bits are in use. */
+	pas_page_malloc_decommit_batch_flush(&data->batch);
+	data->num_since_unlock = 0;
+	pas_lock_unlock(&verse_heap_mark_bits_page_commit_controller_commit_lock);
+	pas_lock_lock(&verse_heap_mark_bits_page_commit_controller_commit_lock);
+	if (verse_heap_mark_bits_page_commit_controller_is_locked)
+		data->did_abort = true;
 }
 
 static bool try_decommit(void)
 {
+	decommit_data data;
+
 	pas_lock_assert_held(&verse_heap_mark_bits_page_commit_controller_commit_lock);
 	if (verse_heap_mark_bits_page_commit_controller_is_locked)
 		return false;
-	if (verse_heap_mark_bits_page_commit_controller_num_committed)
-		for_each_mark_bits_page_commit_controller(decommit_callback);
-	return true;
-}
-
-static void decommit(void)
-{
-	bool result;
-	result = try_decommit();
-	PAS_ASSERT(result);
+	if (!verse_heap_mark_bits_page_commit_controller_num_committed)
+		return true;
+
+	pas_page_malloc_decommit_batch_construct(&data.batch);
+	data.num_since_unlock = 0;
+	data.did_abort = false;
+	for_each_mark_bits_page_commit_controller(decommit_callback, &data);
+	pas_page_malloc_decommit_batch_flush(&data.batch);
+	return !data.did_abort;
 }
 
 bool verse_heap_mark_bits_page_commit_controller_decommit_if_possible(void)
@@ -220,8 +262,13 @@ static bool scavenge_periodic_impl(void)
 		return false;
 	if (!verse_heap_mark_bits_page_commit_controller_num_committed)
 		return false;
+	/* Somebody reserved memory for the heap to grow into, and committed mark bits are part of that. */
+	if (verse_heap_reserve_is_holding())
+		return false;
 	if (verse_heap_mark_bits_page_commit_controller_clean_count >= VERSE_HEAP_MARK_BITS_PAGE_COMMIT_CONTROLLER_MAX_CLEAN_COUNT) {
-		decommit();
+		/* If a cycle started while we were at it, then the scavenger will hear from unlock(). */
+		if (!try_decommit())
+			return false;
 		return !!verse_heap_mark_bits_page_commit_controller_num_committed;
 	}
 	verse_heap_mark_bits_page_commit_controller_clean_count++;
@@ -60,7 +60,8 @@ extern PAS_API verse_heap_mark_bits_page_commit_controller_vector verse_heap_mar
 
 /* Creates a new commit controller for a chunk. Asserts that there definitely wasn't one already. Need to hold the heap lock to use this.
  
-   The initial state is always committed. */
+   The initial state is always committed, since chunks are born committed. So, this never needs the commit lock,
+   and chunks created during a cycle don't have to wait on the collector. */
 PAS_API verse_heap_mark_bits_page_commit_controller* verse_heap_mark_bits_page_commit_controller_create_not_large(uintptr_t chunk_base);
 
 PAS_API void verse_heap_mark_bits_page_commit_controller_construct_large(verse_heap_mark_bits_page_commit_controller* controller, uintptr_t chunk_base);
@@ -68,7 +69,8 @@ PAS_API void verse_heap_mark_bits_page_commit_controller_construct_large(verse_h
 PAS_API void verse_heap_mark_bits_page_commit_controller_destruct_large(verse_heap_mark_bits_page_commit_controller* controller);
 
 /* Decommits mark bit pages if possible. It's impossible to decommit them if the GC is running. Returns true if decommit
-   happened. */
+   happened. This lets go of the commit lock between batches of decommits, so if a cycle starts in the middle, then
+   this stops and returns false. */
 PAS_API bool verse_heap_mark_bits_page_commit_controller_decommit_if_possible(void);
 
 /* To be called periodically from the scavenger. */
@@ -40,6 +40,7 @@ void verse_heap_page_header_construct(verse_heap_page_header* header)
     header->version = verse_heap_latest_version;
 	header->is_stashing_alloc_bits = false;
     header->may_have_set_mark_bits_for_dead_objects = false;
+    header->deferred_eligibility = false;
 	header->stashed_alloc_bits = NULL;
 	header->client_data = NULL;
 	pas_lock_construct(&header->client_data_lock);
@@ -43,6 +43,7 @@ struct PAS_ALIGNED(PAS_PAIR_SIZE) verse_heap_page_header {
 	unsigned* stashed_alloc_bits;
     bool may_have_set_mark_bits_for_dead_objects;
 	bool is_stashing_alloc_bits;
+    bool deferred_eligibility;
 	void* client_data;
 	pas_lock client_data_lock;
 };
@@ -52,6 +53,7 @@ struct PAS_ALIGNED(PAS_PAIR_SIZE) verse_heap_page_header {
 		.stashed_alloc_bits = NULL, \
         .may_have_set_mark_bits_for_dead_objects = false, \
 		.is_stashing_alloc_bits = false, \
+        .deferred_eligibility = false, \
 		.client_data = NULL, \
 		.client_data_lock = PAS_LOCK_INITIALIZER \
     })
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "verse_heap_reserve.h"
+
+#include "pas_heap_lock.h"
+#include "pas_large_free_heap_config.h"
+#include "pas_large_sharing_pool.h"
+#include "pas_page_malloc.h"
+#include "ue_include/verse_heap_config_ue.h"
+#if PAS_OS(LINUX)
+#include <sys/mman.h>
+#endif
+
+#if PAS_ENABLE_VERSE
+
+size_t verse_heap_reserve_target_bytes = 0;
+size_t verse_heap_reserve_num_bytes = 0;
+size_t verse_heap_reserve_slack_bytes = 16 * 1024 * 1024;
+
+static pas_aligned_allocation_result no_aligned_allocator(size_t size,
+                                                          pas_alignment alignment,
+                                                          void* arg)
+{
+    PAS_UNUSED_PARAM(size);
+    PAS_UNUSED_PARAM(alignment);
+    PAS_UNUSED_PARAM(arg);
+    return pas_aligned_allocation_result_create_empty();
+}
+
+static void initialize_config(pas_large_free_heap_config* config)
+{
+    config->type_size = 1;
+    config->min_alignment = 1;
+    config->aligned_allocator = no_aligned_allocator;
+    config->aligned_allocator_arg = NULL;
+    config->deallocator = NULL;
+    config->deallocator_arg = NULL;
+}
+
+void verse_heap_reserve_construct(verse_heap_reserve* reserve)
+{
+    pas_simple_large_free_heap_construct(&reserve->free_heap);
+    reserve->num_bytes = 0;
+}
+
+void verse_heap_reserve_put(verse_heap_reserve* reserve, uintptr_t begin, size_t size)
+{
+    pas_large_free_heap_config config;
+
+    pas_heap_lock_assert_held();
+    PAS_ASSERT(pas_is_aligned(begin, VERSE_HEAP_CHUNK_SIZE));
+    PAS_ASSERT(pas_is_aligned(size, VERSE_HEAP_CHUNK_SIZE));
+
+    initialize_config(&config);
+    pas_simple_large_free_heap_deallocate(
+        &reserve->free_heap, begin, begin + size, pas_zero_mode_is_all_zero, &config);
+
+    reserve->num_bytes += size;
+    verse_heap_reserve_num_bytes += size;
+}
+
+pas_allocation_result verse_heap_reserve_try_take(verse_heap_reserve* reserve,
+                                                  size_t size,
+                                                  pas_primordial_page_state desired_state,
+                                                  pas_mmap_capability mmap_capability)
+{
+    pas_large_free_heap_config config;
+    pas_allocation_result result;
+
+    pas_heap_lock_assert_held();
+    PAS_ASSERT(pas_is_aligned(size, VERSE_HEAP_CHUNK_SIZE));
+
+    if (size > reserve->num_bytes || desired_state == pas_primordial_page_is_decommitted)
+        return pas_allocation_result_create_failure();
+
+    initialize_config(&config);
+    result = pas_simple_large_free_heap_try_allocate(
+        &reserve->free_heap, size, pas_alignment_create_traditional(VERSE_HEAP_CHUNK_SIZE),
+        &config);
+    if (!result.did_succeed)
+        return result;
+
+    PAS_ASSERT(result.zero_mode == pas_zero_mode_is_all_zero);
+
+    reserve->num_bytes -= size;
+    verse_heap_reserve_num_bytes -= size;
+
+    switch (desired_state) {
+    case pas_primordial_page_is_committed:
+        break;
+    case pas_primordial_page_is_shared:
+        /* Shared pages are supposed to be free as far as the large sharing pool can tell. They stay
+           committed until somebody allocates them, unless the scavenger gets to them first. */
+        pas_large_sharing_pool_free(
+            pas_range_create(result.begin, result.begin + size),
+            pas_physical_memory_is_locked_by_virtual_range_common_lock,
+            mmap_capability);
+        break;
+    default:
+        PAS_ASSERT(!"Should not be reached");
+        break;
+    }
+
+    return result;
+}
+
+size_t verse_heap_reserve_get_spare_bytes(void)
+{
+    size_t headroom;
+
+    pas_heap_lock_assert_held();
+
+    if (verse_heap_reserve_target_bytes > verse_heap_live_bytes)
+        headroom = verse_heap_reserve_target_bytes - verse_heap_live_bytes;
+    else
+        headroom = 0;
+
+    if (verse_heap_reserve_num_bytes > headroom)
+        return verse_heap_reserve_num_bytes - headroom;
+    return 0;
+}
+
+void verse_heap_reserve_populate(uintptr_t begin, size_t size)
+{
+    uintptr_t address;
+
+    PAS_ASSERT(pas_is_aligned(begin, pas_page_malloc_alignment()));
+    PAS_ASSERT(pas_is_aligned(size, pas_page_malloc_alignment()));
+
+#if PAS_OS(LINUX) && defined(MADV_POPULATE_WRITE)
+    if (!madvise((void*)begin, size, MADV_POPULATE_WRITE))
+        return;
+#endif
+
+    /* Writing zeroes is as good as populating, since the memory is all zero already. */
+    for (address = begin; address < begin + size; address += pas_page_malloc_alignment())
+        *(volatile char*)address = 0;
+}
+
+#endif /* PAS_ENABLE_VERSE */
+
+#endif /* LIBPAS_ENABLED */
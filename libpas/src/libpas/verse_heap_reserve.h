@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#ifndef VERSE_HEAP_RESERVE_H
+#define VERSE_HEAP_RESERVE_H
+
+#include "pas_allocation_result.h"
+#include "pas_mmap_capability.h"
+#include "pas_primordial_page_state.h"
+#include "pas_simple_large_free_heap.h"
+#include "ue_include/verse_heap_ue.h"
+
+#if PAS_ENABLE_VERSE
+
+PAS_BEGIN_EXTERN_C;
+
+/* A heap's reserve holds chunks that verse_heap_reserve_memory() committed (and maybe prefaulted)
+   ahead of time, so that the heap can grow into them without taking page faults. The large
+   sharing pool thinks that reserved chunks are allocated, so the scavenger leaves them alone. The
+   heap takes chunks from its reserve before asking its page provider.
+
+   Reserved chunks are always all zero. All of these functions have to be called with the heap lock
+   held. */
+
+struct verse_heap_reserve;
+typedef struct verse_heap_reserve verse_heap_reserve;
+
+struct verse_heap_reserve {
+    pas_simple_large_free_heap free_heap;
+    size_t num_bytes;
+};
+
+/* The total that was ever asked to be reserved, and the total that is still in some heap's
+   reserve. */
+PAS_API extern size_t verse_heap_reserve_target_bytes;
+PAS_API extern size_t verse_heap_reserve_num_bytes;
+
+/* Reserved memory counts as spare once the heap could no longer grow into it without exceeding the
+   target. The scavenger gives back spare memory beyond this much. */
+PAS_API extern size_t verse_heap_reserve_slack_bytes;
+
+PAS_API void verse_heap_reserve_construct(verse_heap_reserve* reserve);
+
+/* Adds chunks that the large sharing pool thinks are allocated and that are all zero. */
+PAS_API void verse_heap_reserve_put(verse_heap_reserve* reserve, uintptr_t begin, size_t size);
+
+/* Takes chunks out of the reserve and puts them in the desired state. Fails if the reserve doesn't
+   have them or if the desired state is decommitted. */
+PAS_API pas_allocation_result verse_heap_reserve_try_take(verse_heap_reserve* reserve,
+                                                          size_t size,
+                                                          pas_primordial_page_state desired_state,
+                                                          pas_mmap_capability mmap_capability);
+
+PAS_API size_t verse_heap_reserve_get_spare_bytes(void);
+
+/* Faults in memory that is all zero, keeping it all zero. Doesn't need the heap lock, but nobody
+   else may be using the memory. */
+PAS_API void verse_heap_reserve_populate(uintptr_t begin, size_t size);
+
+/* While this is true, the mark bits of chunks aren't decommitted by the periodic scavenger. Doesn't
+   need the heap lock. */
+static inline bool verse_heap_reserve_is_holding(void)
+{
+    return verse_heap_reserve_target_bytes > verse_heap_live_bytes;
+}
+
+PAS_END_EXTERN_C;
+
+#endif /* PAS_ENABLE_VERSE */
+
+#endif /* VERSE_HEAP_RESERVE_H */
+
@@ -42,9 +42,13 @@ pas_allocation_result verse_heap_runtime_config_allocate_chunks(verse_heap_runti
 
     PAS_ASSERT(pas_is_aligned(size, VERSE_HEAP_CHUNK_SIZE));
 
-    result = config->page_provider(
-		size, pas_alignment_create_traditional(VERSE_HEAP_CHUNK_SIZE), "verse_heap_chunk", NULL, transaction, desired_state,
-		config->page_provider_arg);
+    result = verse_heap_reserve_try_take(
+        &config->reserve, size, desired_state, config->base.mmap_capability);
+    if (!result.did_succeed) {
+        result = config->page_provider(
+            size, pas_alignment_create_traditional(VERSE_HEAP_CHUNK_SIZE), "verse_heap_chunk", NULL, transaction,
+            desired_state, config->page_provider_arg);
+    }
     
     if (result.did_succeed) {
         uintptr_t address;
@@ -31,7 +31,9 @@
 #include "pas_heap_page_provider.h"
 #include "pas_large_heap_physical_page_sharing_cache.h"
 #include "pas_reserve_commit_cache_large_free_heap.h"
+#include "verse_heap_large_cache.h"
 #include "verse_heap_object_set_set.h"
+#include "verse_heap_reserve.h"
 
 #if PAS_ENABLE_VERSE
 
@@ -63,6 +65,13 @@ struct verse_heap_runtime_config {
     /* FIXME: Should this be here, or in the type? Could be either, I guess. Maybe that's true of all of the
        fields here. */
     verse_heap_object_set_set object_sets;
+
+    verse_heap_large_cache large_object_cache;
+
+    verse_heap_reserve reserve;
+
+    /* See verse_heap_set_large_objects_are_uncounted(). */
+    bool large_objects_are_uncounted;
 };
 
 /* Allocate pages either from the config's own page cache (if it has one) or out of the global page cache
@@ -67,6 +67,28 @@ void verse_local_allocator_stop(pas_local_allocator* allocator)
     pas_local_allocator_stop(allocator, pas_lock_lock_mode_lock);
 }
 
+void verse_local_allocator_start_allocating_black(pas_local_allocator* allocator)
+{
+    uintptr_t begin;
+    uintptr_t end;
+    uintptr_t object;
+
+    PAS_ASSERT(verse_heap_allocating_black_version == (uint64_t)verse_heap_allocate_black);
+
+    if (allocator->current_word || allocator->current_offset != allocator->end_offset) {
+        verse_local_allocator_stop(allocator);
+        return;
+    }
+
+    /* Some of these objects may never get allocated. That's fine, since returning them to the page
+       when we stop sets may_have_set_mark_bits_for_dead_objects, just like it does for the unused
+       part of a bump region that was refilled black. */
+    end = allocator->payload_end;
+    begin = end - allocator->remaining;
+    for (object = begin; object < end; object += allocator->object_size)
+        verse_heap_set_is_marked((void*)object, true);
+}
+
 PAS_NEVER_INLINE static void* allocate_slow(pas_local_allocator* allocator)
 {
     return (void*)pas_local_allocator_try_allocate(
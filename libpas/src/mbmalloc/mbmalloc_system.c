@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+/* This lets the mbmalloc benchmarks run against the system malloc. To measure some other malloc,
+   like jemalloc or mimalloc, LD_PRELOAD it. */
+
+#include <malloc.h>
+#include <stdlib.h>
+
+void* mbmalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* mbmemalign(size_t alignment, size_t size)
+{
+    void* result;
+    if (posix_memalign(&result, alignment, size))
+        return NULL;
+    return result;
+}
+
+void* mbrealloc(void* p, size_t ignored_old_size, size_t new_size)
+{
+    (void)ignored_old_size;
+    return realloc(p, new_size);
+}
+
+void mbfree(void* p, size_t ignored_size)
+{
+    (void)ignored_size;
+    free(p);
+}
+
+void mbscavenge(void)
+{
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
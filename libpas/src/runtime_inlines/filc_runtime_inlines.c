@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+
+
+#include "pas_config.h"
+
+#if LIBPAS_ENABLED
+
+#include "filc_allocate_inlines.h"
+
+#if PAS_ENABLE_FILC
+
+/* This is compiled to LLVM bitcode (pizfix/lib/filc_runtime_inlines.bc) instead of being linked
+   into libpizlo. The pizlonator links the definitions in here into each module that calls them, as
+   available_externally, so the inliner can see the fast paths while the real definitions and all
+   of the slow paths stay in libpizlo. Every function in here has to be defined the same way as the
+   one in libpizlo, which is why they just call the same inline functions. */
+
+filc_object* filc_allocate(filc_thread* my_thread, size_t size)
+{
+    return filc_allocate_inline(my_thread, size);
+}
+
+filc_object* filc_allocate_with_aux(filc_thread* my_thread, size_t size)
+{
+    return filc_allocate_with_aux_inline(my_thread, size);
+}
+
+filc_object* filc_allocate_uninitialized(filc_thread* my_thread, size_t size)
+{
+    return filc_allocate_uninitialized_inline(my_thread, size);
+}
+
+#endif /* PAS_ENABLE_FILC */
+
+#endif /* LIBPAS_ENABLED */
@@ -25,10 +25,14 @@
  */
 
 #include "TestHarness.h"
+#include "HeapLocker.h"
 #include "bmalloc_heap.h"
+#include "pas_large_map.h"
 #include "pas_scavenger.h"
 
 #include <cstdlib>
+#include <set>
+#include <vector>
 
 using namespace std;
 
@@ -78,6 +82,96 @@ void testReallocateFrees(size_t size)
 	CHECK_EQUAL(ptr3, ptr);
 }
 
+void testAllocateBatch(size_t size, size_t count)
+{
+    vector<void*> ptrs(count);
+    bmalloc_allocate_batch(size, count, ptrs.data());
+    set<void*> seen;
+    for (void* ptr : ptrs) {
+        CHECK(ptr);
+        CHECK_GREATER_EQUAL(bmalloc_get_allocation_size(ptr), size);
+        CHECK(seen.insert(ptr).second);
+        memset(ptr, 42, size);
+    }
+    ptrs.push_back(nullptr);
+    bmalloc_deallocate_batch(ptrs.data(), ptrs.size());
+}
+
+void testTryAllocateBatch(size_t size, size_t count)
+{
+    vector<void*> ptrs(count);
+    CHECK_EQUAL(bmalloc_try_allocate_batch(size, count, ptrs.data()), count);
+    for (void* ptr : ptrs)
+        CHECK(ptr);
+    bmalloc_deallocate_batch(ptrs.data(), count);
+}
+
+void testDeallocateWithSize(size_t size)
+{
+    void* ptr = bmalloc_allocate(size);
+    CHECK(ptr);
+    bmalloc_deallocate_with_size(ptr, size);
+    pas_scavenger_clear_local_tlcs();
+    void* ptr2 = bmalloc_allocate(size);
+    CHECK_EQUAL(ptr2, ptr);
+    bmalloc_deallocate_with_size(ptr2, size);
+    bmalloc_deallocate_with_size(nullptr, size);
+}
+
+void testLargeMapFindLockFree(size_t size)
+{
+    void* ptr = bmalloc_allocate(size);
+    CHECK(ptr);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+    pas_large_map_entry entry = pas_large_map_find_lock_free(begin);
+    CHECK_EQUAL(entry.begin, begin);
+    CHECK_GREATER_EQUAL(entry.end - begin, size);
+    CHECK(entry.heap);
+    CHECK_EQUAL(bmalloc_get_allocation_size(ptr), entry.end - begin);
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(begin + 16)));
+    bmalloc_deallocate(ptr);
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(begin)));
+}
+
+void testLargeMapCollidedGranule()
+{
+    // This is above where any real allocation goes, and the heap is never dereferenced.
+    uintptr_t granule = static_cast<uintptr_t>(1) << PAS_LARGE_MAP_GRANULE_SHIFT;
+    uintptr_t base = static_cast<uintptr_t>(1) << (PAS_ADDRESS_BITS - 1);
+    pas_large_heap* heap = reinterpret_cast<pas_large_heap*>(&base);
+    pas_large_map_entry first = { base, base + 256, heap };
+    pas_large_map_entry second = { base + 256, base + 3 * granule, heap };
+
+    {
+        HeapLocker locker;
+        pas_large_map_add(first);
+    }
+    CHECK_EQUAL(pas_large_map_find_lock_free(base).end, first.end);
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(base + 256)));
+
+    {
+        HeapLocker locker;
+        pas_large_map_add(second);
+    }
+    CHECK_EQUAL(pas_large_map_find_lock_free(base).end, first.end);
+    CHECK_EQUAL(pas_large_map_find_lock_free(base + 256).end, second.end);
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(base + 16)));
+
+    {
+        HeapLocker locker;
+        CHECK_EQUAL(pas_large_map_take(base).end, first.end);
+    }
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(base)));
+    CHECK_EQUAL(pas_large_map_find_lock_free(base + 256).end, second.end);
+
+    {
+        HeapLocker locker;
+        CHECK_EQUAL(pas_large_map_take(base + 256).end, second.end);
+    }
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(base)));
+    CHECK(pas_large_map_entry_is_empty(pas_large_map_find_lock_free(base + 256)));
+}
+
 } // anonymous namespace
 
 void addBmallocTests()
@@ -117,4 +211,17 @@ void addBmallocTests()
 	ADD_TEST(testReallocateFrees(1000));
 	ADD_TEST(testReallocateFrees(10000));
 	ADD_TEST(testReallocateFrees(10000000));
+    ADD_TEST(testAllocateBatch(16, 1));
+    ADD_TEST(testAllocateBatch(16, 10000));
+    ADD_TEST(testAllocateBatch(1000, 1000));
+    ADD_TEST(testAllocateBatch(100000, 100));
+    ADD_TEST(testTryAllocateBatch(48, 10000));
+    ADD_TEST(testTryAllocateBatch(10000000, 3));
+    ADD_TEST(testDeallocateWithSize(16));
+    ADD_TEST(testDeallocateWithSize(1000));
+    ADD_TEST(testDeallocateWithSize(10000));
+    ADD_TEST(testDeallocateWithSize(10000000));
+    ADD_TEST(testLargeMapFindLockFree(10000000));
+    ADD_TEST(testLargeMapFindLockFree(100000000));
+    ADD_TEST(testLargeMapCollidedGranule());
 }
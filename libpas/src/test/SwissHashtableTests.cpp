@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2024 Epic Games, Inc. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY EPIC GAMES, INC. ``AS IS AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL EPIC GAMES, INC. OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#include "TestHarness.h"
+#include <functional>
+#include <map>
+#include "pas_swiss_hashtable.h"
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+template<typename EntryType>
+bool hashtableForEachEntryCallback(EntryType* entry, void* arg)
+{
+    function<bool(EntryType*)>* callback = reinterpret_cast<function<bool(EntryType*)>*>(arg);
+    return (*callback)(entry);
+}
+
+template<typename EntryType, typename HashtableType, typename ForEachEntryFunc, typename Func>
+bool hashtableForEachEntry(HashtableType* hashtable, const ForEachEntryFunc& forEachEntryFunc,
+                           const Func& func)
+{
+    function<bool(EntryType*)> callback = func;
+    return forEachEntryFunc(hashtable, hashtableForEachEntryCallback<EntryType>, &callback);
+}
+
+struct Key {
+    Key() = default;
+    
+    Key(unsigned key)
+        : key(key)
+    {
+    }
+    
+    unsigned key { 0 };
+};
+
+typedef Key CollidingKey;
+typedef Key CollidingEntry;
+
+inline CollidingEntry CollidingEntry_create_empty()
+{
+    return { };
+}
+
+inline CollidingEntry CollidingEntry_create_deleted()
+{
+    return UINT_MAX;
+}
+
+inline bool CollidingEntry_is_empty_or_deleted(CollidingEntry entry)
+{
+    return entry.key == 0 || entry.key == UINT_MAX;
+}
+
+inline CollidingKey CollidingEntry_get_key(CollidingEntry entry)
+{
+    return entry;
+}
+
+inline unsigned CollidingKey_get_hash(CollidingKey key)
+{
+    return 0;
+}
+
+inline bool CollidingKey_is_equal(CollidingKey a, CollidingKey b)
+{
+    return a.key == b.key;
+}
+
+PAS_CREATE_SWISS_HASHTABLE(CollidingSwissHashtable,
+                           CollidingEntry,
+                           CollidingKey);
+
+void testEmptyCollidingSwissHashtable()
+{
+    CollidingSwissHashtable hashtable;
+    CollidingSwissHashtable_construct(&hashtable);
+    CHECK(!CollidingSwissHashtable_find(&hashtable, 1));
+    CollidingSwissHashtable_destruct(&hashtable, &allocationConfig);
+}
+
+void testCollidingSwissHashtableAddFindTake(unsigned numElements)
+{
+    CollidingSwissHashtable hashtable;
+    CollidingSwissHashtable_construct(&hashtable);
+    
+    for (unsigned i = 1; i <= numElements; ++i)
+        CollidingSwissHashtable_add_new(&hashtable, i, nullptr, &allocationConfig);
+
+    CHECK_EQUAL(hashtable.key_count, numElements);
+    CHECK_EQUAL(hashtable.deleted_count, 0);
+    
+    for (unsigned i = 1; i <= numElements; ++i) {
+        CollidingEntry* foundEntry = CollidingSwissHashtable_find(&hashtable, i);
+        CHECK(foundEntry);
+        CHECK_EQUAL(foundEntry->key, i);
+    }
+    CHECK(!CollidingSwissHashtable_find(&hashtable, numElements + 1));
+    
+    for (unsigned i = 1; i <= numElements; ++i) {
+        CollidingEntry takenEntry = CollidingSwissHashtable_take(
+            &hashtable, i, nullptr, &allocationConfig);
+        CHECK_EQUAL(takenEntry.key, i);
+        CHECK(!CollidingSwissHashtable_find(&hashtable, i));
+    }
+    
+    CHECK_EQUAL(hashtable.key_count, 0);
+    
+    CollidingSwissHashtable_destruct(&hashtable, &allocationConfig);
+}
+
+void testCollidingSwissHashtableAddAddAddTakeTakeAddSet()
+{
+    CollidingSwissHashtable hashtable;
+    
+    CollidingSwissHashtable_construct(&hashtable);
+    CollidingSwissHashtable_add_new(&hashtable, 1, nullptr, &allocationConfig);
+    CollidingSwissHashtable_add_new(&hashtable, 2, nullptr, &allocationConfig);
+    CollidingSwissHashtable_add_new(&hashtable, 3, nullptr, &allocationConfig);
+    CHECK_EQUAL(CollidingSwissHashtable_take(&hashtable, 1, nullptr, &allocationConfig).key, 1);
+    CHECK_EQUAL(CollidingSwissHashtable_take(&hashtable, 2, nullptr, &allocationConfig).key, 2);
+    CollidingSwissHashtable_add_new(&hashtable, 4, nullptr, &allocationConfig);
+    CHECK(!CollidingSwissHashtable_set(&hashtable, 3, nullptr, &allocationConfig));
+    
+    bool foundThree = false;
+    bool foundFour = false;
+    hashtableForEachEntry<CollidingEntry>(
+        &hashtable, CollidingSwissHashtable_for_each_entry,
+        [&] (CollidingEntry* entry) -> bool {
+            if (entry->key == 3) {
+                CHECK(!foundThree);
+                foundThree = true;
+            } else if (entry->key == 4) {
+                CHECK(!foundFour);
+                foundFour = true;
+            } else
+                CHECK(!"Found wrong key");
+            return true;
+        });
+    CHECK(foundThree);
+    CHECK(foundFour);
+    
+    CHECK_EQUAL(hashtable.key_count, 2);
+    
+    CollidingSwissHashtable_destruct(&hashtable, &allocationConfig);
+}
+
+// Fills whole groups with colliding keys, so that deleting from them has to leave tombstones, and
+// then checks that keys that probed past those groups can still be found.
+void testCollidingSwissHashtableTombstones()
+{
+    CollidingSwissHashtable hashtable;
+    CollidingSwissHashtable_construct(&hashtable);
+
+    for (unsigned i = 1; i <= 12; ++i)
+        CollidingSwissHashtable_add_new(&hashtable, i, nullptr, &allocationConfig);
+    CHECK_EQUAL(hashtable.table_size, PAS_SWISS_HASHTABLE_MIN_SIZE);
+
+    for (unsigned i = 1; i <= 8; ++i)
+        CollidingSwissHashtable_delete(&hashtable, i, nullptr, &allocationConfig);
+    CHECK_EQUAL(hashtable.key_count, 4);
+    CHECK_EQUAL(hashtable.deleted_count, 8);
+
+    for (unsigned i = 9; i <= 12; ++i)
+        CHECK(CollidingSwissHashtable_find(&hashtable, i));
+    for (unsigned i = 1; i <= 8; ++i)
+        CHECK(!CollidingSwissHashtable_find(&hashtable, i));
+
+    CollidingSwissHashtable_add_new(&hashtable, 13, nullptr, &allocationConfig);
+    CHECK_EQUAL(hashtable.deleted_count, 7);
+    CHECK(CollidingSwissHashtable_find(&hashtable, 13));
+
+    size_t numFound = 0;
+    for (size_t index = CollidingSwissHashtable_entry_index_end(&hashtable); index--;) {
+        if (!CollidingEntry_is_empty_or_deleted(
+                *CollidingSwissHashtable_entry_at_index(&hashtable, index)))
+            numFound++;
+    }
+    CHECK_EQUAL(numFound, 5);
+
+    CollidingSwissHashtable_destruct(&hashtable, &allocationConfig);
+}
+
+typedef Key OutOfLineKey;
+typedef Key* OutOfLineEntry;
+
+inline OutOfLineEntry OutOfLineEntry_create_empty()
+{
+    return nullptr;
+}
+
+inline OutOfLineEntry OutOfLineEntry_create_deleted()
+{
+    return reinterpret_cast<OutOfLineEntry>(static_cast<uintptr_t>(1));
+}
+
+inline bool OutOfLineEntry_is_empty_or_deleted(OutOfLineEntry entry)
+{
+    return reinterpret_cast<uintptr_t>(entry) <= static_cast<uintptr_t>(1);
+}
+
+inline OutOfLineKey OutOfLineEntry_get_key(OutOfLineEntry entry)
+{
+    return *entry;
+}
+
+inline unsigned OutOfLineKey_get_hash(OutOfLineKey key)
+{
+    return pas_hash32(key.key);
+}
+
+inline bool OutOfLineKey_is_equal(OutOfLineKey a, OutOfLineKey b)
+{
+    return a.key == b.key;
+}
+
+PAS_CREATE_SWISS_HASHTABLE(OutOfLineSwissHashtable,
+                           OutOfLineEntry,
+                           OutOfLineKey);
+
+void testOutOfLineSwissHashtable(unsigned numElements)
+{
+    OutOfLineSwissHashtable hashtable;
+    
+    OutOfLineSwissHashtable_construct(&hashtable);
+
+    for (unsigned i = numElements; i--;)
+        CHECK(!OutOfLineSwissHashtable_find(&hashtable, i));
+    
+    for (unsigned i = numElements; i--;)
+        OutOfLineSwissHashtable_add_new(&hashtable, new Key(i), nullptr, &allocationConfig);
+    
+    for (unsigned i = numElements; i--;) {
+        OutOfLineEntry* entry = OutOfLineSwissHashtable_find(&hashtable, i);
+        CHECK(entry);
+        CHECK(*entry);
+        CHECK_EQUAL((*entry)->key, i);
+    }
+    CHECK(!OutOfLineSwissHashtable_find(&hashtable, numElements));
+    
+    for (unsigned i = numElements; i--;) {
+        OutOfLineEntry entry = OutOfLineSwissHashtable_take(
+            &hashtable, i, nullptr, &allocationConfig);
+        CHECK(entry);
+        CHECK_EQUAL(entry->key, i);
+        delete entry;
+    }
+    
+    hashtableForEachEntry<OutOfLineEntry>(
+        &hashtable, OutOfLineSwissHashtable_for_each_entry,
+        [&] (OutOfLineEntry* entry) -> bool {
+            CHECK(!"Should not have found anything.");
+            return true;
+        });
+    
+    for (unsigned i = numElements; i--;)
+        CHECK(!OutOfLineSwissHashtable_find(&hashtable, i));
+    
+    CHECK_EQUAL(hashtable.key_count, 0);
+    
+    OutOfLineSwissHashtable_destruct(&hashtable, &allocationConfig);
+}
+
+// Does random adds, sets, and removes, and checks the table against a std::map after each one.
+void testRandomSwissHashtable(unsigned numOperations, unsigned keyRange)
+{
+    OutOfLineSwissHashtable hashtable;
+    map<unsigned, Key*> ourMap;
+
+    OutOfLineSwissHashtable_construct(&hashtable);
+
+    for (unsigned count = numOperations; count--;) {
+        unsigned key = deterministicRandomNumber(keyRange);
+        switch (deterministicRandomNumber(3)) {
+        case 0: {
+            OutOfLineSwissHashtable_add_result result = OutOfLineSwissHashtable_add(
+                &hashtable, key, nullptr, &allocationConfig);
+            CHECK_EQUAL(result.is_new_entry, !ourMap.count(key));
+            if (result.is_new_entry) {
+                *result.entry = new Key(key);
+                ourMap[key] = *result.entry;
+            } else
+                CHECK_EQUAL(*result.entry, ourMap[key]);
+            break;
+        }
+        case 1: {
+            OutOfLineEntry entry = OutOfLineSwissHashtable_take(
+                &hashtable, key, nullptr, &allocationConfig);
+            if (ourMap.count(key)) {
+                CHECK_EQUAL(entry, ourMap[key]);
+                ourMap.erase(key);
+                delete entry;
+            } else
+                CHECK(!entry);
+            break;
+        }
+        default: {
+            OutOfLineEntry* entry = OutOfLineSwissHashtable_find(&hashtable, key);
+            if (ourMap.count(key)) {
+                CHECK(entry);
+                CHECK_EQUAL(*entry, ourMap[key]);
+            } else
+                CHECK(!entry);
+            break;
+        }
+        }
+        CHECK_EQUAL(OutOfLineSwissHashtable_size(&hashtable), ourMap.size());
+    }
+
+    size_t numFound = 0;
+    hashtableForEachEntry<OutOfLineEntry>(
+        &hashtable, OutOfLineSwissHashtable_for_each_entry,
+        [&] (OutOfLineEntry* entry) -> bool {
+            CHECK_EQUAL(*entry, ourMap[(*entry)->key]);
+            numFound++;
+            return true;
+        });
+    CHECK_EQUAL(numFound, ourMap.size());
+
+    for (auto& pair : ourMap)
+        delete pair.second;
+    OutOfLineSwissHashtable_destruct(&hashtable, &allocationConfig);
+}
+
+} // anonymous namespace
+
+void addSwissHashtableTests()
+{
+    ADD_TEST(testEmptyCollidingSwissHashtable());
+    ADD_TEST(testCollidingSwissHashtableAddFindTake(1));
+    ADD_TEST(testCollidingSwissHashtableAddFindTake(10));
+    ADD_TEST(testCollidingSwissHashtableAddFindTake(100));
+    ADD_TEST(testCollidingSwissHashtableAddAddAddTakeTakeAddSet());
+    ADD_TEST(testCollidingSwissHashtableTombstones());
+    ADD_TEST(testOutOfLineSwissHashtable(0));
+    ADD_TEST(testOutOfLineSwissHashtable(1));
+    ADD_TEST(testOutOfLineSwissHashtable(10));
+    ADD_TEST(testOutOfLineSwissHashtable(100));
+    ADD_TEST(testOutOfLineSwissHashtable(1000));
+    ADD_TEST(testOutOfLineSwissHashtable(10000));
+    ADD_TEST(testOutOfLineSwissHashtable(100000));
+    ADD_TEST(testRandomSwissHashtable(100000, 100));
+    ADD_TEST(testRandomSwissHashtable(1000000, 10000));
+}
@@ -391,6 +391,7 @@ void addMemalignTests();
 void addMinHeapTests();
 void addOddMediumPageHeaderTests();
 void addRedBlackTreeTests();
+void addSwissHashtableTests();
 void addTLCDecommitTests();
 void addTSDTests();
 void addThingyAndUtilityHeapAllocationTests();
@@ -869,6 +870,7 @@ int main(int argc, char** argv)
     ADD_SUITE(MinHeap);
 	ADD_SUITE(OddMediumPageHeader);
     ADD_SUITE(RedBlackTree);
+    ADD_SUITE(SwissHashtable);
     ADD_SUITE(TLCDecommit);
     ADD_SUITE(TSD);
     ADD_SUITE(TryFindAllocatedObjectStart);
@@ -1890,6 +1890,38 @@ void testDecommitMarkBits()
 	CHECK(!verse_heap_object_is_allocated(largeObject));
 }
 
+void testShardedLiveBytes()
+{
+    verse_heap_live_bytes_slack = 64 * 1024 * 1024;
+    initializeOnlyDefaultHeap();
+
+    size_t liveBytesBefore = verse_heap_live_bytes;
+
+    // Small refills fit in the shard's budget, so they don't show up until we fold.
+    void* smallObject = verse_heap_allocate(defaultHeap, 16);
+    CHECK(smallObject);
+    CHECK_EQUAL(verse_heap_live_bytes, liveBytesBefore);
+    verse_heap_fold_live_bytes();
+    CHECK_GREATER(verse_heap_live_bytes, liveBytesBefore);
+
+    size_t liveBytesAfterFold = verse_heap_live_bytes;
+    verse_heap_fold_live_bytes();
+    CHECK_EQUAL(verse_heap_live_bytes, liveBytesAfterFold);
+
+    // Allocations bigger than the budget get folded right away.
+    void* largeObject = verse_heap_allocate(defaultHeap, 10000000);
+    CHECK(largeObject);
+    CHECK_GREATER_EQUAL(verse_heap_live_bytes, liveBytesAfterFold + 10000000);
+
+    // Stopping the allocators returns the unused part of the refill. That must not underflow the
+    // global count even if some of the refill is still sitting in a shard.
+    void* otherSmallObject = verse_heap_allocate(defaultHeap, 32);
+    CHECK(otherSmallObject);
+    handshakeOnOneThread();
+    verse_heap_fold_live_bytes();
+    CHECK_GREATER_EQUAL(verse_heap_live_bytes, liveBytesBefore + 10000000);
+}
+
 void doOneSizeWorkflowTests(size_t size)
 {
     ADD_TEST(testWorkflow({ Op(Allocate, 0, Default, size),
@@ -2537,5 +2569,6 @@ void addVerseHeapTests()
 	ADD_TEST(testRepeatedIteration(16, 1000000, false));
 	ADD_TEST(testRepeatedIteration(16, 1000000, true));
 	ADD_TEST(testDecommitMarkBits());
+    ADD_TEST(testShardedLiveBytes());
 #endif // PAS_ENABLE_VERSE && PAS_ENABLE_BMALLOC
 }
@@ -229,6 +229,7 @@ struct Config {
   bool enableNewDtags;
   bool executeOnly;
   bool exportDynamic;
+  bool filcDirectBind;
   bool fixCortexA53Errata843419;
   bool fixCortexA8;
   bool formatBinary = false;
@@ -11,6 +11,7 @@
 #include "InputFiles.h"
 #include "InputSection.h"
 #include "OutputSections.h"
+#include "SymbolTable.h"
 #include "SyntheticSections.h"
 #include "Target.h"
 #include "Writer.h"
@@ -342,6 +343,24 @@ void elf::maybeWarnUnorderableSymbol(const Symbol *sym) {
     report(": unable to order discarded symbol: ");
 }
 
+// Fil-C emits every global and function as a pair of symbols:
+// pizlonated_<name>, the getter that references call, and filc_gptr_<name>,
+// the global ptr that other modules load directly once the global has been
+// initialized.
+static bool isFilcPairSymbol(StringRef name) {
+  return name.starts_with("pizlonated_") || name.starts_with("filc_gptr_");
+}
+
+// Returns the other half of a Fil-C pair, or null if it is not in the symbol
+// table.
+static Symbol *getFilcPartner(StringRef name) {
+  if (name.consume_front("pizlonated_"))
+    return symtab.find(("filc_gptr_" + name).str());
+  if (name.consume_front("filc_gptr_"))
+    return symtab.find(("pizlonated_" + name).str());
+  return nullptr;
+}
+
 // Returns true if a symbol can be replaced at load-time by a symbol
 // with the same name defined in other ELF executable or DSO.
 bool elf::computeIsPreemptible(const Symbol &sym) {
@@ -360,6 +379,18 @@ bool elf::computeIsPreemptible(const Symbol &sym) {
   if (!config->shared)
     return false;
 
+  // With --filc-direct-bind, both halves of a Fil-C pair bind locally unless
+  // either of them is in the dynamic list. Calls to the getter then skip the
+  // PLT and global ptr loads skip the GOT. Either both halves are preemptible
+  // or neither is, so a global ptr load never sees a different definition
+  // than a getter call would.
+  if (config->filcDirectBind && isFilcPairSymbol(sym.getName())) {
+    if (sym.inDynamicList)
+      return true;
+    Symbol *partner = getFilcPartner(sym.getName());
+    return partner && partner->inDynamicList;
+  }
+
   // If -Bsymbolic or --dynamic-list is specified, or -Bsymbolic-functions is
   // specified and the symbol is STT_FUNC, the symbol is preemptible iff it is
   // in the dynamic list. -Bsymbolic-non-weak-functions is a non-weak subset of
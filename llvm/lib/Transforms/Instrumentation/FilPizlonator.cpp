@@ -14,15 +14,29 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Instrumentation/FilPizlonator.h"
+#include <llvm/ADT/DenseMap.h>
 
+#include <llvm/Analysis/BlockFrequencyInfo.h>
+#include <llvm/Analysis/BranchProbabilityInfo.h>
 #include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
 #include <llvm/Demangle/Demangle.h>
 #include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/IntrinsicsX86.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Operator.h>
 #include <llvm/IR/TypedPointerType.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TimeProfiler.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/CallPromotionUtils.h>
 #include <llvm/Transforms/Utils/ModuleUtils.h>
 #include <llvm/Transforms/Utils/PromoteMemToReg.h>
 #include <llvm/TargetParser/Triple.h>
@@ -50,12 +64,145 @@ static cl::opt<bool> optimizeChecks(
 static cl::opt<bool> propagateChecksBackward(
   "filc-propagate-checks-backward", cl::desc("Perform backward propagation of checks"),
   cl::Hidden, cl::init(true));
+static cl::opt<unsigned> checkOptimizationBlockLimit(
+  "filc-check-optimization-block-limit",
+  cl::desc("Don't optimize the check schedule of functions with more basic blocks than this"),
+  cl::Hidden, cl::init(10000));
+static cl::opt<bool> checkCalleePreconditionsAtCallSites(
+  "filc-callee-preconditions",
+  cl::desc("Have direct callers do the checks that the callee would do on its args on entry"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> widenChecksInLoops(
+  "filc-widen-checks-in-loops",
+  cl::desc("Prove the range checks of counted loops once in the preheader"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> optimizePollchecks(
+  "filc-optimize-pollchecks",
+  cl::desc("Remove or strip-mine the back edge pollchecks of small loops that don't call"),
+  cl::Hidden, cl::init(true));
+// This is in the same spirit as FILC_MAX_BYTES_BETWEEN_POLLCHECKS in the runtime, but counts IR
+// instructions in the loop body before pizlonation.
+static cl::opt<unsigned> pollcheckBudget(
+  "filc-pollcheck-budget",
+  cl::desc("Number of instructions that a loop that doesn't call may run between pollchecks"),
+  cl::Hidden, cl::init(10000));
+static cl::opt<bool> elideRedundantStoreBarriers(
+  "filc-elide-redundant-store-barriers",
+  cl::desc("Skip store barriers for values already barriered since the last pollcheck"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> stackAllocateAllocas(
+  "filc-stack-allocate-allocas",
+  cl::desc("Put allocas that provably don't escape in the native frame instead of the GC heap"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> elideAllocationZeroing(
+  "filc-elide-allocation-zeroing",
+  cl::desc("Don't zero a malloc result that is immediately and fully overwritten by a memcpy, "
+           "memmove, or memset"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> forwardLocalLoadsInOptNone(
+  "filc-forward-local-loads-in-optnone",
+  cl::desc("In optnone functions, reuse the last value stored to or loaded from a local that "
+           "doesn't escape instead of loading it again within the same block"),
+  cl::Hidden, cl::init(true));
+static cl::opt<unsigned> maxStackAllocaSize(
+  "filc-max-stack-alloca-size",
+  cl::desc("Largest alloca, in bytes, that may be put in the native frame"),
+  cl::Hidden, cl::init(256));
+static cl::opt<unsigned> leafStackCheckMaxFrameSize(
+  "filc-leaf-stack-check-max-frame-size",
+  cl::desc("Largest native frame, in bytes, for which a function that doesn't call skips its stack "
+           "overflow check; 0 means always check"),
+  cl::Hidden, cl::init(1024));
+static cl::opt<bool> recordLowersOnlyAcrossSafepoints(
+  "filc-record-lowers-only-across-safepoints",
+  cl::desc("Only give frame slots to ptrs that are live across a call, pollcheck, or exit"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> useDirectCalls(
+  "filc-direct-calls",
+  cl::desc("Pass arguments and return values in registers for direct calls within a module"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> directSyscalls(
+  "filc-direct-syscalls",
+  cl::desc("Call the runtime's zsys_* functions through their register-based entrypoints when it "
+           "has one with the right signature"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> inlineGlobalGetters(
+  "filc-inline-global-getters",
+  cl::desc("Load the flight ptrs of initialized globals directly instead of calling their getters"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> bulkInitializeGlobals(
+  "filc-bulk-initialize-globals",
+  cl::desc("Initialize all of a module's globals under one initialization context when the first "
+           "one is touched"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> lazyGlobalCtors(
+  "filc-lazy-global-ctors",
+  cl::desc("Run a module's global constructors when the first of its globals is initialized, "
+           "instead of at startup. Only safe for modules whose constructors just set up the "
+           "module's own state"),
+  cl::Hidden, cl::init(false));
+static cl::opt<bool> useProfileForChecks(
+  "filc-profile-guided-checks",
+  cl::desc("Use profile data to keep cold code compact when lowering checks and getters"),
+  cl::Hidden, cl::init(true));
+static cl::opt<unsigned> coldBlockRatio(
+  "filc-cold-block-ratio",
+  cl::desc("With profile data, blocks that run this many times less often than the entry are cold"),
+  cl::Hidden, cl::init(64));
+static cl::opt<unsigned> inlineMemOpMaxSize(
+  "filc-inline-mem-op-max-size",
+  cl::desc("Do memsets, memcpys, and memmoves of up to this many bytes inline when there is no aux "
+           "to deal with (zero means never)"),
+  cl::Hidden, cl::init(256));
+static cl::opt<bool> speculativeDevirtualization(
+  "filc-speculative-devirtualization",
+  cl::desc("Turn indirect calls that probably go to a function in this module into a capability "
+           "check and a direct call, with the indirect call as the fallback"),
+  cl::Hidden, cl::init(true));
+static cl::opt<unsigned> speculativeDevirtualizationPercent(
+  "filc-speculative-devirtualization-percent",
+  cl::desc("Share of an indirect call's profiled calls that must go to one target to speculate it"),
+  cl::Hidden, cl::init(50));
+static cl::opt<bool> useSizeBoundsChecks(
+  "filc-size-bounds-checks",
+  cl::desc("Check both bounds of an access with one compare of its offset against the size"),
+  cl::Hidden, cl::init(false));
+static cl::opt<bool> useFusedWriteChecks(
+  "filc-fused-write-checks",
+  cl::desc("Check that a write's object is writable as part of its bounds check, by comparing "
+           "signed against the tagged upper of readonly objects"),
+  cl::Hidden, cl::init(true));
+static cl::opt<bool> useIsoHeaps(
+  "filc-iso-heaps",
+  cl::desc("Give each named struct type that gets heap allocated its own heap, so that objects of "
+           "one type share pages"),
+  cl::Hidden, cl::init(false));
+static cl::opt<bool> countChecks(
+  "filc-count-checks",
+  cl::desc("Give every access check, pollcheck, and store barrier a counter that the runtime dumps "
+           "at exit with FILC_DUMP_CHECK_COUNTS=1"),
+  cl::Hidden, cl::init(false));
+static cl::opt<std::string> runtimeInlines(
+  "filc-runtime-inlines",
+  cl::desc("Bitcode file with runtime fast paths to link into the module as available_externally "
+           "after pizlonating it, so that they can be inlined"),
+  cl::Hidden, cl::init(""));
 static cl::opt<bool> useAsmForOffsets(
   "filc-use-asm-for-offset", cl::desc("Use inline assembly to compute offsets"),
   cl::Hidden, cl::init(false));
 
+// Set on modules that we've pizlonated, so that we never pizlonate them again.
+static constexpr const char* PizlonatedModuleFlag = "filc-pizlonated";
+
 // This has to match the FilC runtime.
 
+// Matches filc_check_count_kind.
+enum class CheckCountKind : unsigned {
+  Access,
+  Pollcheck,
+  StoreBarrier
+};
+
 static constexpr size_t GCMinAlign = 16;
 static constexpr size_t FlightPtrAlign = 16;
 static constexpr size_t WordSize = 8;
@@ -75,17 +222,30 @@ static constexpr uint16_t ObjectFlagFree = 4;
 static constexpr uint16_t ObjectFlagGlobalAux = 16;
 static constexpr uint16_t ObjectFlagsSpecialShift = 5;
 static constexpr uint16_t ObjectFlagsAlignShift = 9;
+static constexpr uint16_t ObjectFlagStack = 16384;
+
+// Readonly objects with a payload have this set in their upper. See FILC_OBJECT_UPPER_READONLY_TAG.
+static constexpr uintptr_t ObjectUpperReadonlyTag = static_cast<uintptr_t>(1) << 63;
+
+// Fused write checks subtract up to this much from the tagged upper, which must not borrow from the
+// tag. No object lives in the first page, so every upper is at least this big.
+static constexpr int64_t MaxFusedWriteCheckRange = 4096;
 
 static constexpr uintptr_t AtomicBoxBit = 1;
 
 static constexpr unsigned NumUnwindRegisters = 2;
 
+// Our optimization remarks can be seen with -Rpass=filc, -Rpass-missed=filc, and
+// -Rpass-analysis=filc.
+static constexpr const char* RemarkPassName = "filc";
+
 static constexpr size_t CCAlignment = 64;
 static constexpr size_t CCInlineSize = 256;
 
 static constexpr uint8_t ThreadStateCheckRequested = 2;
 static constexpr uint8_t ThreadStateStopRequested = 4;
 static constexpr uint8_t ThreadStateDeferredSignal = 8;
+static constexpr uint8_t ThreadStateAssistRequested = 32;
 
 enum class AccessKind {
   Read,
@@ -355,8 +515,10 @@ struct MAToken {
   std::string Str;
 };
 
+// Module asm in Fil-C is only ever our own .filc_* directives, so this just has to know about
+// identifiers, directives, commas, and newlines. It scans the module's asm in place.
 class MATokenizer {
-  std::string MA;
+  StringRef MA;
   size_t Idx { 0 };
 
   void skipWhitespace() {
@@ -374,7 +536,7 @@ class MATokenizer {
   }
   
 public:
-  MATokenizer(const std::string& MA): MA(MA) {}
+  MATokenizer(StringRef MA): MA(MA) {}
 
   bool isAtEnd() const { return Idx >= MA.size(); }
 
@@ -393,14 +555,14 @@ public:
     if (MA[Idx] == '.') {
       size_t Start = Idx;
       skipID();
-      return MAToken(MATokenKind::Directive, MA.substr(Start, Idx - Start));
+      return MAToken(MATokenKind::Directive, MA.substr(Start, Idx - Start).str());
     }
     if (isalpha(MA[Idx]) || MA[Idx] == '_') {
       size_t Start = Idx;
       skipID();
-      return MAToken(MATokenKind::Identifier, MA.substr(Start, Idx - Start));
+      return MAToken(MATokenKind::Identifier, MA.substr(Start, Idx - Start).str());
     }
-    return MAToken(MATokenKind::Error, MA.substr(Idx, MA.size() - Idx));
+    return MAToken(MATokenKind::Error, MA.substr(Idx).str());
   }
 
   MAToken getNextSpecific(MATokenKind Kind) {
@@ -787,6 +949,13 @@ struct ChecksWithDIOrBottom {
   ChecksWithDIOrBottom(): Bottom(true) {}
 };
 
+struct BarrieredValuesOrBottom {
+  bool Bottom;
+  std::unordered_set<Value*> Values;
+
+  BarrieredValuesOrBottom(): Bottom(true) {}
+};
+
 struct PtrAndOffset {
   Value* HighP { nullptr };
   int64_t Offset { 0 };
@@ -941,6 +1110,43 @@ struct AuxBaseAndPtr {
   AuxBaseAndPtr(Value* BaseP, Value* P): BaseP(BaseP), P(P) {}
 };
 
+struct CountedLoop {
+  PHINode* IV { nullptr };
+  Value* Start { nullptr };
+  Value* Limit { nullptr };
+  bool LimitIsExclusive { false };
+};
+
+struct PollcheckPlan {
+  BasicBlock* Header { nullptr };
+  Instruction* PreheaderTerm { nullptr };
+  unsigned Period { 0 }; // Zero means that the loop does not need a pollcheck.
+  bool IsCounted { false };
+  CountedLoop Counted;
+  Value* RunsShort { nullptr };
+};
+
+// Describes a canonical ptr of the form Base + IV * Scale + ConstantOffset, where IV is the
+// canonical induction variable of some counted loop and Base is loop-invariant. All of the range
+// checks that the loop does on that ptr are summarized by LowerOffset, UpperOffset, Alignments, and
+// NeedsWritable, so that we can prove them all at once in the preheader.
+struct WidenedLoopCheck {
+  Instruction* PreheaderTerm { nullptr };
+  CountedLoop Counted;
+  PollcheckPlan* Plan { nullptr };
+  Value* Base { nullptr };
+  int64_t Scale { 0 };
+  int64_t ConstantOffset { 0 };
+  int64_t LowerOffset { 0 };
+  int64_t UpperOffset { 0 };
+  bool HasLowerBound { false };
+  bool HasUpperBound { false };
+  std::vector<AlignmentAndOffset> Alignments;
+  bool NeedsWritable { false };
+  Value* Flag { nullptr };
+  Value* FastFlag { nullptr };
+};
+
 class Pizlonator {
   static constexpr unsigned TargetAS = 0;
   
@@ -974,6 +1180,8 @@ class Pizlonator {
   StructType* AlignmentAndOffsetTy;
   StructType* PizlonatedReturnValueTy;
   StructType* PtrPairTy;
+  StructType* CheckCounterTy;
+  StructType* CheckCounterTableTy;
   FunctionType* PizlonatedFuncTy;
   FunctionType* GlobalGetterTy;
   FunctionType* CtorDtorTy;
@@ -983,6 +1191,15 @@ class Pizlonator {
   Constant* FlightNull;
   BitCastInst* Dummy;
 
+  // Scope lists that say that aux accesses, payload accesses, and object header loads never alias
+  // each other.
+  MDNode* AuxScopeList;
+  MDNode* PayloadScopeList;
+  MDNode* HeaderScopeList;
+  MDNode* NotAuxScopeList;
+  MDNode* NotPayloadScopeList;
+  MDNode* NotHeaderScopeList;
+
   // Low-level functions used by codegen.
   FunctionCallee PollcheckSlow;
   FunctionCallee StoreBarrierForLowerSlow;
@@ -991,23 +1208,40 @@ class Pizlonator {
   FunctionCallee ThreadEnsureCCOutlineBufferSlow;
   FunctionCallee StrongCasPtr;
   FunctionCallee XchgPtr;
+  FunctionCallee GetNextBytesForVAArg;
   FunctionCallee GetNextPtrBytesForVAArg;
   FunctionCallee Allocate;
   FunctionCallee AllocateWithAlignment;
+  FunctionCallee AllocateWithAux;
+  FunctionCallee AllocateUninitialized;
+  FunctionCallee AllocateIso;
+  FunctionCallee AllocateIsoWithAux;
   FunctionCallee OptimizedAlignmentContradiction;
   FunctionCallee OptimizedAccessCheckFail;
   FunctionCallee CheckFunctionCallFail;
   FunctionCallee Memset;
   FunctionCallee Memmove;
+  FunctionCallee Memcmp;
+  FunctionCallee Memchr;
+  FunctionCallee Memrchr;
+  FunctionCallee Memmem;
+  FunctionCallee CheckMaskedAccess;
+  FunctionCallee Calloc;
+  FunctionCallee Realloc;
+  FunctionCallee FreePtr;
   FunctionCallee GlobalInitializationContextCreate;
   FunctionCallee GlobalInitializationContextAdd;
   FunctionCallee GlobalInitializationContextDestroy;
   FunctionCallee ExecuteConstantRelocations;
+  FunctionCallee InitializeModuleGlobals;
+  FunctionCallee GlobalInitializationContextAddLazyCtors;
   FunctionCallee DeferOrRunGlobalCtor;
+  FunctionCallee RegisterCheckCounters;
   FunctionCallee RunGlobalDtor;
   FunctionCallee Error;
   FunctionCallee RealMemset;
   FunctionCallee RealMemcpy;
+  FunctionCallee RealMemmove;
   FunctionCallee LandingPad;
   FunctionCallee ResumeUnwind;
   FunctionCallee JmpBufCreate;
@@ -1017,11 +1251,12 @@ class Pizlonator {
   FunctionCallee CCRetsCheckFailure;
   FunctionCallee _Setjmp;
   FunctionCallee ExpectI1;
+  FunctionCallee PtrMask;
   FunctionCallee LifetimeStart;
   FunctionCallee LifetimeEnd;
   FunctionCallee StackCheckAsm;
 
-  Constant* IsMarking;
+  Constant* StoreBarrierIsOn;
 
   std::unordered_set<CombinedDI> CombinedDIs;
   std::unordered_map<std::pair<const CombinedDI*, const CombinedDI*>,
@@ -1029,6 +1264,9 @@ class Pizlonator {
   std::unordered_map<DILocation*, const CombinedDI*> BasicDIs;
   
   std::unordered_map<std::string, GlobalVariable*> Strings;
+  std::unordered_map<StructType*, GlobalVariable*> IsoHeaps;
+  DenseMap<std::pair<Constant*, unsigned>, GlobalVariable*> CheckCounters;
+  std::vector<Constant*> CheckCounterList;
   std::unordered_map<FunctionOriginKey, GlobalVariable*> FunctionOrigins;
   std::unordered_map<OriginKey, GlobalVariable*> Origins;
   std::unordered_map<InlineFrameKey, GlobalVariable*> InlineFrames;
@@ -1041,8 +1279,32 @@ class Pizlonator {
   std::unordered_map<OptimizedAccessCheckOriginKey, GlobalVariable*> OptimizedAccessCheckOrigins;
   std::unordered_map<OptimizedAlignmentContradictionOriginKey,
                      GlobalVariable*> OptimizedAlignmentContradictionOrigins;
+  DenseMap<Constant*, unsigned> CheckFailOriginIndices;
+  std::vector<Constant*> CheckFailOrigins;
+  Function* AccessCheckFailThunk;
+  Function* AlignmentContradictionThunk;
+  BasicBlock* CallFailB;
+  PHINode* CallFailPhi;
   std::unordered_map<Value*, AllocaInst*> CanonicalPtrAuxBaseVars;
   std::unordered_map<Instruction*, std::vector<AllocaInst*>> AuxBaseVarOperands;
+  std::vector<WidenedLoopCheck> WidenedLoopChecks;
+  std::unordered_map<Instruction*, std::unordered_map<Value*, size_t>> WidenedLoopChecksForInst;
+  std::unordered_map<const BasicBlock*, PollcheckPlan> PollcheckPlans;
+  std::unordered_set<StoreInst*> StoresWithRedundantBarrier;
+  std::unordered_set<ICmpInst*> SpeculativeCalleeChecks;
+  std::unordered_set<Function*> DirectSyscalls;
+  std::unordered_set<ICmpInst*> DirectSyscallChecks;
+  std::unordered_map<Function*, std::vector<AccessCheckWithDI>> CalleePreconditions;
+  size_t NumBuiltChecks;
+  const char* CheckScheduleNotOptimizedReason;
+  std::unordered_map<const BasicBlock*, const char*> UnplannedPollcheckReasons;
+
+  // The per-block abstract states of the function's dataflow analyses are vectors indexed by the
+  // block's position in Blocks.
+  DenseMap<const BasicBlock*, unsigned> BlockNumbers;
+  std::unordered_set<AllocaInst*> StackAllocas;
+  std::unordered_set<CallBase*> FullyInitializedAllocations;
+  std::unordered_map<BasicBlock*, bool> BlockIsCold;
 
   std::vector<GlobalVariable*> Globals;
   std::vector<Function*> Functions;
@@ -1051,9 +1313,13 @@ class Pizlonator {
   std::unordered_map<Type*, Type*> FlightedTypes;
 
   std::unordered_map<GlobalValue*, Function*> GlobalToGetter;
+  std::unordered_map<Function*, GlobalVariable*> GetterToGlobalPtr;
+  std::unordered_map<Function*, std::string> GetterToDeclaredGlobalName;
   std::unordered_map<GlobalValue*, GlobalVariable*> GlobalToGlobal;
   std::unordered_set<Value*> Getters;
+  std::unordered_set<BasicBlock*> BadComputedGotoTargetBlocks;
   std::unordered_map<Function*, Function*> FunctionToHiddenFunction;
+  std::unordered_map<Function*, Function*> FunctionToDirectFunction;
 
   std::string FunctionName;
   Function* OldF;
@@ -1084,6 +1350,7 @@ class Pizlonator {
   Value* Frame;
 
   std::vector<Instruction*> ToErase;
+  std::vector<StoreInst*> OriginStores;
 
   BitCastInst* makeDummy(Type* T) {
     return new BitCastInst(UndefValue::get(T), T, "dummy");
@@ -1112,7 +1379,7 @@ class Pizlonator {
   }
 
   // What does "CanCatch" mean in this context? CanCatch=true means we're at an origin that is either:
-  // - a CallInst in a function that is !doesNotThrow, or
+  // - a CallInst that is !doesNotThrow in a function that is !doesNotThrow, or
   // - an InvokeInst.
   //
   // Lots of origins don't meet this definition!
@@ -1474,10 +1741,33 @@ class Pizlonator {
     return AuxPtr;
   }
 
-  Value* upperForLower(Value* Lower, Instruction* InsertBefore) {
+  // Only the runtime writes object headers, and no aux or heap payload access can reach a header,
+  // since the checks keep them within [lower, upper) or within the aux. Saying so lets GVN and LICM
+  // reuse and hoist header loads across payload and aux stores. They still get reloaded after
+  // calls, since a call might free the object or grow it in place, so the header is not
+  // invariant.
+  void tagHeaderAccess(Instruction* I) {
+    I->setMetadata(LLVMContext::MD_alias_scope, HeaderScopeList);
+    I->setMetadata(LLVMContext::MD_noalias, NotHeaderScopeList);
+  }
+
+  // This is the raw upper, which is negative for readonly objects. Only write checks that compare
+  // signed should use it.
+  Value* writeUpperForLower(Value* Lower, Instruction* InsertBefore) {
     Instruction* Upper = new LoadInst(
       RawPtrTy, ptrToUpperForLower(Lower, InsertBefore), "filc_object_upper_load", InsertBefore);
     Upper->setDebugLoc(InsertBefore->getDebugLoc());
+    tagHeaderAccess(Upper);
+    return Upper;
+  }
+
+  Value* upperForLower(Value* Lower, Instruction* InsertBefore) {
+    Instruction* Upper = CallInst::Create(
+      PtrMask,
+      { writeUpperForLower(Lower, InsertBefore),
+        ConstantInt::get(IntPtrTy, ~ObjectUpperReadonlyTag) },
+      "filc_object_upper", InsertBefore);
+    Upper->setDebugLoc(InsertBefore->getDebugLoc());
     return Upper;
   }
 
@@ -1485,6 +1775,7 @@ class Pizlonator {
     Instruction* Aux = new LoadInst(
       IntPtrTy, ptrToAuxForLower(Lower, InsertBefore), "filc_object_aux_load", InsertBefore);
     Aux->setDebugLoc(InsertBefore->getDebugLoc());
+    tagHeaderAccess(Aux);
     return Aux;
   }
 
@@ -1581,9 +1872,31 @@ class Pizlonator {
     return createFlightPtr(Lower, RawPtr, InsertBefore);
   }
 
+  // Heap aux and heap payload never overlap, since the aux is its own allocation (or sits after the
+  // payload) and no capability ever points into it. Saying so with scoped alias metadata lets GVN
+  // and LICM move payload accesses across lower loads and stores, and the other way around.
+  void tagAuxAccess(Instruction* I, MemoryKind MK) {
+    if (MK != MemoryKind::Heap)
+      return;
+    I->setMetadata(LLVMContext::MD_alias_scope, AuxScopeList);
+    I->setMetadata(LLVMContext::MD_noalias, NotAuxScopeList);
+  }
+
+  // Payload accesses also keep the TBAA tag of the access they were lowered from. We don't carry
+  // over the original alias.scope and noalias (which come from the inlining we do before
+  // pizlonation), since those only stay sound alongside their noalias_scope_decls, which we remove.
+  void tagPayloadAccess(Instruction* I, MDNode* TBAA, MemoryKind MK) {
+    if (MK != MemoryKind::Heap)
+      return;
+    if (TBAA)
+      I->setMetadata(LLVMContext::MD_tbaa, TBAA);
+    I->setMetadata(LLVMContext::MD_alias_scope, PayloadScopeList);
+    I->setMetadata(LLVMContext::MD_noalias, NotPayloadScopeList);
+  }
+
   Value* loadPtr(
     Value* P, Value* BaseAuxP, Value* AuxP, bool isVolatile, Align A, AtomicOrdering AO,
-    MemoryKind MK, Instruction* InsertBefore) {
+    MemoryKind MK, Instruction* InsertBefore, MDNode* TBAA = nullptr) {
     if (MK != MemoryKind::Heap) {
       assert(!isVolatile);
       assert(AO == AtomicOrdering::NotAtomic);
@@ -1603,6 +1916,7 @@ class Pizlonator {
       MK == MemoryKind::Heap ? getMergedAtomicOrdering(AtomicOrdering::Monotonic, AO) : AO,
       SyncScope::System, NotNullCase);
     LowerAsIntLoad->setDebugLoc(InsertBefore->getDebugLoc());
+    tagAuxAccess(LowerAsIntLoad, MK);
     PHINode* LowerAsInt = PHINode::Create(IntPtrTy, 2, "filc_lower_as_int_phi", InsertBefore);
     LowerAsInt->setDebugLoc(InsertBefore->getDebugLoc());
     LowerAsInt->addIncoming(ConstantInt::get(IntPtrTy, 0), OriginalB);
@@ -1616,6 +1930,7 @@ class Pizlonator {
         RawPtrTy, P, "filc_atomic_case_load_raw_ptr", isVolatile, std::max(A, Align(WordSize)), AO,
         SyncScope::System, Where);
       RawPtrLoad->setDebugLoc(InsertBefore->getDebugLoc());
+      tagPayloadAccess(RawPtrLoad, TBAA, MK);
       return createFlightPtr(LowerToPtr, RawPtrLoad, Where);
     };
     
@@ -1684,6 +1999,51 @@ class Pizlonator {
     return loadPtr(P, Aux.BaseP, Aux.P, InsertBefore);
   }
 
+  // With -filc-count-checks, bumps the counter of the check of the given kind at the given site.
+  // Sites are keyed by origin, so the checks of one instruction share a counter.
+  void emitCheckCount(CheckCountKind Kind, DebugLoc Loc, Instruction* InsertBefore) {
+    if (!countChecks || !OldF)
+      return;
+    Constant* Origin = getOrigin(Loc);
+    GlobalVariable*& Counter = CheckCounters[std::make_pair(Origin, static_cast<unsigned>(Kind))];
+    if (!Counter) {
+      Counter = new GlobalVariable(
+        M, CheckCounterTy, false, GlobalVariable::PrivateLinkage,
+        ConstantStruct::get(
+          CheckCounterTy,
+          { ConstantInt::get(IntPtrTy, 0), Origin,
+            ConstantInt::get(Int32Ty, static_cast<unsigned>(Kind)) }),
+        "filc_check_counter");
+      CheckCounterList.push_back(Counter);
+    }
+    (new AtomicRMWInst(
+      AtomicRMWInst::Add, Counter, ConstantInt::get(IntPtrTy, 1), Align(WordSize),
+      AtomicOrdering::Monotonic, SyncScope::System, InsertBefore))->setDebugLoc(Loc);
+  }
+
+  // Registers this module's check counters with the runtime from a global constructor. This runs
+  // after we've forwarded the module's own constructors, since it's native code.
+  void emitCheckCounterTable() {
+    if (CheckCounterList.empty())
+      return;
+    ArrayType* CountersTy = ArrayType::get(RawPtrTy, CheckCounterList.size());
+    GlobalVariable* Counters = new GlobalVariable(
+      M, CountersTy, true, GlobalVariable::PrivateLinkage,
+      ConstantArray::get(CountersTy, CheckCounterList), "filc_check_counters");
+    GlobalVariable* Table = new GlobalVariable(
+      M, CheckCounterTableTy, false, GlobalVariable::PrivateLinkage,
+      ConstantStruct::get(
+        CheckCounterTableTy,
+        { RawNull, ConstantInt::get(IntPtrTy, CheckCounterList.size()), Counters }),
+      "filc_check_counter_table");
+    Function* Ctor = Function::Create(
+      CtorDtorTy, GlobalValue::InternalLinkage, 0, "filc_check_counter_ctor", &M);
+    BasicBlock* RootBB = BasicBlock::Create(C, "filc_check_counter_ctor_root", Ctor);
+    CallInst::Create(RegisterCheckCounters, { Table }, "", RootBB);
+    ReturnInst::Create(C, RootBB);
+    appendToGlobalCtors(M, Ctor, 0, RawNull);
+  }
+
   void storeBarrierForLower(Value* Lower, Instruction* InsertBefore) {
     assert(MyThread);
     DebugLoc DL = InsertBefore->getDebugLoc();
@@ -1691,15 +2051,17 @@ class Pizlonator {
       InsertBefore, ICmpInst::ICMP_EQ, Lower, RawNull, "filc_barrier_null_object");
     NullObject->setDebugLoc(DL);
     Instruction* NotNullTerm = SplitBlockAndInsertIfElse(NullObject, InsertBefore, false);
-    LoadInst* IsMarkingByte = new LoadInst(Int8Ty, IsMarking, "filc_is_marking_byte", NotNullTerm);
-    IsMarkingByte->setDebugLoc(DL);
-    ICmpInst* IsNotMarking = new ICmpInst(
-      NotNullTerm, ICmpInst::ICMP_EQ, IsMarkingByte, ConstantInt::get(Int8Ty, 0),
-      "filc_is_not_marking");
-    IsNotMarking->setDebugLoc(DL);
-    Instruction* IsMarkingTerm = SplitBlockAndInsertIfElse(
-      expectTrue(IsNotMarking, NotNullTerm), NotNullTerm, false);
-    CallInst::Create(StoreBarrierForLowerSlow, { MyThread, Lower }, "", IsMarkingTerm)
+    emitCheckCount(CheckCountKind::StoreBarrier, DL, NotNullTerm);
+    LoadInst* BarrierIsOnByte = new LoadInst(
+      Int8Ty, StoreBarrierIsOn, "filc_store_barrier_is_on_byte", NotNullTerm);
+    BarrierIsOnByte->setDebugLoc(DL);
+    ICmpInst* BarrierIsOff = new ICmpInst(
+      NotNullTerm, ICmpInst::ICMP_EQ, BarrierIsOnByte, ConstantInt::get(Int8Ty, 0),
+      "filc_store_barrier_is_off");
+    BarrierIsOff->setDebugLoc(DL);
+    Instruction* BarrierIsOnTerm = SplitBlockAndInsertIfElse(
+      expectTrue(BarrierIsOff, NotNullTerm), NotNullTerm, false);
+    CallInst::Create(StoreBarrierForLowerSlow, { MyThread, Lower }, "", BarrierIsOnTerm)
       ->setDebugLoc(DL);
   }
   
@@ -1707,9 +2069,26 @@ class Pizlonator {
     storeBarrierForLower(flightPtrLower(V, InsertBefore), InsertBefore);
   }
   
+  // The caller must have already dealt with atomic stores and with the store barrier.
+  void storePtrUnbarriered(
+    Value* V, Value* P, Value* AuxP, bool isVolatile, Align A, AtomicOrdering AO, MemoryKind MK,
+    Instruction* InsertBefore, MDNode* TBAA = nullptr) {
+    Instruction* AuxStore = new StoreInst(
+      flightPtrLower(V, InsertBefore), AuxP, isVolatile, std::max(A, Align(WordSize)),
+      MK == MemoryKind::Heap ? getMergedAtomicOrdering(AtomicOrdering::Monotonic, AO) : AO,
+      SyncScope::System, InsertBefore);
+    AuxStore->setDebugLoc(InsertBefore->getDebugLoc());
+    tagAuxAccess(AuxStore, MK);
+    Instruction* PayloadStore = new StoreInst(
+      flightPtrPtr(V, InsertBefore), P, isVolatile, std::max(A, Align(WordSize)), AO,
+      SyncScope::System, InsertBefore);
+    PayloadStore->setDebugLoc(InsertBefore->getDebugLoc());
+    tagPayloadAccess(PayloadStore, TBAA, MK);
+  }
+
   void storePtr(
     Value* V, Value* P, Value* AuxP, bool isVolatile, Align A, AtomicOrdering AO, MemoryKind MK,
-    Instruction* InsertBefore) {
+    Instruction* InsertBefore, MDNode* TBAA = nullptr) {
     if (MK != MemoryKind::Heap) {
       assert(!isVolatile);
       assert(AO == AtomicOrdering::NotAtomic);
@@ -1724,13 +2103,7 @@ class Pizlonator {
     if (MK == MemoryKind::Heap)
       storeBarrierForValue(V, InsertBefore);
 
-    (new StoreInst(
-      flightPtrLower(V, InsertBefore), AuxP, isVolatile, std::max(A, Align(WordSize)),
-      MK == MemoryKind::Heap ? getMergedAtomicOrdering(AtomicOrdering::Monotonic, AO) : AO,
-      SyncScope::System, InsertBefore))->setDebugLoc(InsertBefore->getDebugLoc());
-    (new StoreInst(
-      flightPtrPtr(V, InsertBefore), P, isVolatile, std::max(A, Align(WordSize)), AO,
-      SyncScope::System, InsertBefore))->setDebugLoc(InsertBefore->getDebugLoc());
+    storePtrUnbarriered(V, P, AuxP, isVolatile, A, AO, MK, InsertBefore, TBAA);
   }
 
   void storePtr(Value* V, Value* P, Value* AuxP, Instruction* InsertBefore) {
@@ -1781,14 +2154,19 @@ class Pizlonator {
     return false;
   }
 
+  // TBAA is the tag of the access being lowered. It only applies to scalar accesses, so we drop it
+  // when we recurse into aggregates.
   Value* loadValueRecurseAfterCheck(
     Type* T, Value* P, Value* BaseAuxP, Value* AuxP,
     bool isVolatile, Align A, AtomicOrdering AO, SyncScope::ID SS, MemoryKind MK,
-    Instruction* InsertBefore) {
+    Instruction* InsertBefore, MDNode* TBAA = nullptr) {
     A = std::min(DL.getABITypeAlign(T), A);
     
-    if (!hasPtrs(T))
-      return new LoadInst(T, P, "filc_load", isVolatile, A, AO, SS, InsertBefore);
+    if (!hasPtrs(T)) {
+      Instruction* Result = new LoadInst(T, P, "filc_load", isVolatile, A, AO, SS, InsertBefore);
+      tagPayloadAccess(Result, TBAA, MK);
+      return Result;
+    }
     
     if (isa<FunctionType>(T)) {
       llvm_unreachable("shouldn't see function types in loadValueRecurseAfterCheck");
@@ -1803,7 +2181,7 @@ class Pizlonator {
     assert(T != FlightPtrTy);
 
     if (T == RawPtrTy)
-      return loadPtr(P, BaseAuxP, AuxP, isVolatile, A, AO, MK, InsertBefore);
+      return loadPtr(P, BaseAuxP, AuxP, isVolatile, A, AO, MK, InsertBefore, TBAA);
 
     assert(!isa<PointerType>(T));
 
@@ -1870,19 +2248,19 @@ class Pizlonator {
   Value* loadValueRecurseAfterCheck(
     Type* T, Value* P, AuxBaseAndPtr Aux,
     bool isVolatile, Align A, AtomicOrdering AO, SyncScope::ID SS, MemoryKind MK,
-    Instruction* InsertBefore) {
+    Instruction* InsertBefore, MDNode* TBAA = nullptr) {
     return loadValueRecurseAfterCheck(
-      T, P, Aux.BaseP, Aux.P, isVolatile, A, AO, SS, MK, InsertBefore);
+      T, P, Aux.BaseP, Aux.P, isVolatile, A, AO, SS, MK, InsertBefore, TBAA);
   }
   
   void storeValueRecurseAfterCheck(
     Type* T, Value* V, Value* P, Value* AuxP,
     bool isVolatile, Align A, AtomicOrdering AO, SyncScope::ID SS, MemoryKind MK,
-    Instruction* InsertBefore) {
+    Instruction* InsertBefore, MDNode* TBAA = nullptr) {
     A = std::min(DL.getABITypeAlign(T), A);
     
     if (!hasPtrs(T)) {
-      new StoreInst(V, P, isVolatile, A, AO, SS, InsertBefore);
+      tagPayloadAccess(new StoreInst(V, P, isVolatile, A, AO, SS, InsertBefore), TBAA, MK);
       return;
     }
     
@@ -1899,7 +2277,7 @@ class Pizlonator {
     assert(T != FlightPtrTy);
 
     if (T == RawPtrTy) {
-      storePtr(V, P, AuxP, isVolatile, A, AO, MK, InsertBefore);
+      storePtr(V, P, AuxP, isVolatile, A, AO, MK, InsertBefore, TBAA);
       return;
     }
 
@@ -1963,11 +2341,13 @@ class Pizlonator {
     llvm_unreachable("Should not get here.");
   }
 
-  Value* allocateObject(Value* Size, size_t Alignment, Instruction* InsertBefore) {
+  // If the object's type has ptrs, then we ask for the aux to be allocated along with the payload,
+  // since we know that we'll need it.
+  Value* allocateObject(Value* Size, size_t Alignment, bool HasPtrs, Instruction* InsertBefore) {
     Instruction* Result;
     if (Alignment <= GCMinAlign) {
       Result = CallInst::Create(
-        Allocate, { MyThread, Size }, "filc_allocate", InsertBefore);
+        HasPtrs ? AllocateWithAux : Allocate, { MyThread, Size }, "filc_allocate", InsertBefore);
     } else {
       Result = CallInst::Create(
         AllocateWithAlignment,
@@ -1978,8 +2358,99 @@ class Pizlonator {
     return Result;
   }
 
-  Value* allocate(Value* Size, size_t Alignment, Instruction* InsertBefore) {
-    return flightPtrForObject(allocateObject(Size, Alignment, InsertBefore), InsertBefore);
+  Value* allocate(Value* Size, size_t Alignment, bool HasPtrs, Instruction* InsertBefore) {
+    return flightPtrForObject(allocateObject(Size, Alignment, HasPtrs, InsertBefore), InsertBefore);
+  }
+
+  // Returns the runtime's filc_iso_heap for the given type, or null if the type doesn't get one.
+  // Only named structs do, since those are the types that homogeneous structures are made of. The
+  // iso heap is linkonce_odr and named after the type, so every module that allocates the type
+  // gets the same one.
+  GlobalVariable* isoHeapForType(Type* T) {
+    StructType* ST = dyn_cast<StructType>(T);
+    if (!ST || ST->isLiteral() || !ST->hasName())
+      return nullptr;
+    auto Iter = IsoHeaps.find(ST);
+    if (Iter != IsoHeaps.end())
+      return Iter->second;
+    GlobalVariable* Result = new GlobalVariable(
+      M, RawPtrTy, false, GlobalVariable::LinkOnceODRLinkage, RawNull,
+      "filc_iso_heap." + ST->getName());
+    Result->setVisibility(GlobalValue::HiddenVisibility);
+    IsoHeaps[ST] = Result;
+    return Result;
+  }
+
+  // Allocates a single object of the given type, in the type's iso heap if it has one.
+  Value* allocateTyped(Type* T, Instruction* InsertBefore) {
+    size_t Alignment = DL.getABITypeAlign(T).value();
+    Value* Size = ConstantInt::get(IntPtrTy, DL.getTypeAllocSize(T));
+    GlobalVariable* IsoHeap = nullptr;
+    if (useIsoHeaps && Alignment <= GCMinAlign)
+      IsoHeap = isoHeapForType(T);
+    if (!IsoHeap)
+      return allocate(Size, Alignment, hasPtrs(T), InsertBefore);
+    Instruction* Result = CallInst::Create(
+      hasPtrs(T) ? AllocateIsoWithAux : AllocateIso, { MyThread, IsoHeap, Size },
+      "filc_allocate_iso", InsertBefore);
+    Result->setDebugLoc(InsertBefore->getDebugLoc());
+    return flightPtrForObject(Result, InsertBefore);
+  }
+
+  // Allocates the object for an alloca that findStackAllocas() proved doesn't escape. The object
+  // header, payload, and aux all live in the native frame. The object is flagged global so that
+  // nobody tries to mark or free it, and stack so that the GC scans its outgoing ptrs when it scans
+  // our frame's lowers. The payload and aux get zeroed on every execution of the alloca, just like
+  // a heap allocation would.
+  Value* allocateOnStack(AllocaInst* AI) {
+    Type* T = AI->getAllocatedType();
+    size_t Size =
+      DL.getTypeAllocSize(T) * cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+    size_t StorageSize = (Size + WordSize - 1) & ~(WordSize - 1);
+    DebugLoc DI = AI->getDebugLoc();
+
+    AllocaInst* ObjectAlloca = new AllocaInst(
+      Int8Ty, 0, ConstantInt::get(IntPtrTy, ObjectSize + StorageSize), Align(GCMinAlign),
+      "filc_stack_object_alloca", &NewF->getEntryBlock().front());
+    ObjectAlloca->setDebugLoc(DI);
+    Value* AuxPtr = RawNull;
+    uint16_t ObjectFlags = ObjectFlagGlobal | ObjectFlagStack;
+    if (hasPtrs(T)) {
+      AllocaInst* AuxAlloca = new AllocaInst(
+        Int8Ty, 0, ConstantInt::get(IntPtrTy, StorageSize), Align(WordSize),
+        "filc_stack_object_aux_alloca", &NewF->getEntryBlock().front());
+      AuxAlloca->setDebugLoc(DI);
+      AuxPtr = AuxAlloca;
+      ObjectFlags |= ObjectFlagGlobalAux;
+      CallInst* Call = CallInst::Create(
+        RealMemset,
+        { AuxAlloca, ConstantInt::get(Int8Ty, 0), ConstantInt::get(IntPtrTy, StorageSize),
+          ConstantInt::getBool(Int1Ty, false) }, "", AI);
+      Call->addParamAttr(0, Attribute::getWithAlignment(C, Align(WordSize)));
+      Call->setDebugLoc(DI);
+    }
+
+    Value* Lower = lowerForObject(ObjectAlloca, AI);
+    CallInst* Call = CallInst::Create(
+      RealMemset,
+      { Lower, ConstantInt::get(Int8Ty, 0), ConstantInt::get(IntPtrTy, StorageSize),
+        ConstantInt::getBool(Int1Ty, false) }, "", AI);
+    Call->addParamAttr(0, Attribute::getWithAlignment(C, Align(GCMinAlign)));
+    Call->setDebugLoc(DI);
+    Instruction* Upper = GetElementPtrInst::Create(
+      Int8Ty, Lower, { ConstantInt::get(IntPtrTy, Size) }, "filc_stack_object_upper", AI);
+    Upper->setDebugLoc(DI);
+    (new StoreInst(Upper, ObjectAlloca, AI))->setDebugLoc(DI);
+    Instruction* Aux = GetElementPtrInst::Create(
+      Int8Ty, AuxPtr,
+      { ConstantInt::get(IntPtrTy, static_cast<uintptr_t>(ObjectFlags) << ObjectAuxFlagsShift) },
+      "filc_stack_object_aux", AI);
+    Aux->setDebugLoc(DI);
+    Instruction* AuxWordPtr = GetElementPtrInst::Create(
+      RawPtrTy, ObjectAlloca, { ConstantInt::get(IntPtrTy, 1) }, "filc_stack_object_aux_ptr", AI);
+    AuxWordPtr->setDebugLoc(DI);
+    (new StoreInst(Aux, AuxWordPtr, AI))->setDebugLoc(DI);
+    return flightPtrForPayload(Lower, AI);
   }
 
   size_t countPtrs(Type* T) {
@@ -2008,7 +2479,27 @@ class Pizlonator {
     return 0;
   }
 
-  void computeFrameIndexMap(const std::vector<BasicBlock*>& Blocks) {
+  unsigned blockNumber(const BasicBlock* BB) {
+    auto Iter = BlockNumbers.find(BB);
+    assert(Iter != BlockNumbers.end());
+    return Iter->second;
+  }
+
+  // The GC only looks at our frame's lowers when we pollcheck or exit, and we can only do that in a
+  // call, in a back edge pollcheck, or in a check that ensures an aux ptr. A ptr that doesn't live
+  // across any of those can't be looked at, so we don't have to store its lower in the frame. Note
+  // that the operands of the safepoint itself count as living across it, since native callees rely
+  // on the caller's frame to keep their arguments alive, and arguments are never recorded.
+  bool isFrameLowersSafepoint(
+    Instruction* I, const std::unordered_set<const BasicBlock*>& BackEdgePreds) {
+    if (I == I->getParent()->getTerminator() && BackEdgePreds.count(I->getParent()))
+      return true;
+    return !cannotPollcheckForBarrier(I);
+  }
+
+  void computeFrameIndexMap(
+    const std::vector<BasicBlock*>& Blocks,
+    const std::unordered_set<const BasicBlock*>& BackEdgePreds) {
     FrameIndexMap.clear();
     FrameSize = NumSpecialFrameObjects;
     Setjmps.clear();
@@ -2074,6 +2565,32 @@ class Pizlonator {
       }
     }
 
+    std::unordered_set<Value*> LiveAcrossSafepoint;
+    auto NeedsSlot = [&] (Value* V) -> bool {
+      return !recordLowersOnlyAcrossSafepoints || LiveAcrossSafepoint.count(V);
+    };
+    if (recordLowersOnlyAcrossSafepoints) {
+      for (BasicBlock* BB : Blocks) {
+        std::unordered_set<Value*> Live = LiveAtTail[BB];
+        for (auto It = BB->rbegin(); It != BB->rend(); ++It) {
+          Instruction* I = &*It;
+          Live.erase(I);
+          if (isa<PHINode>(I))
+            continue;
+          for (Value* V : I->operand_values()) {
+            if (Value* LV = LiveCast(V))
+              Live.insert(LV);
+          }
+          if (isFrameLowersSafepoint(I, BackEdgePreds)) {
+            for (Value* LV : Live) {
+              if (isa<Instruction>(LV) && hasPtrs(LV->getType()))
+                LiveAcrossSafepoint.insert(LV);
+            }
+          }
+        }
+      }
+    }
+
     std::unordered_map<ValuePtr, std::unordered_set<ValuePtr>> Interference;
 
     for (size_t BlockIndex = Blocks.size(); BlockIndex--;) {
@@ -2086,8 +2603,10 @@ class Pizlonator {
         Live.erase(I);
 
         size_t NumIPtrs = countPtrs(I->getType());
-        if (NumIPtrs) {
+        if (NumIPtrs && NeedsSlot(I)) {
           for (Value* LV : Live) {
+            if (!NeedsSlot(LV))
+              continue;
             size_t NumVIPtrs = countPtrs(LV->getType());
             for (size_t LVPtrIndex = NumVIPtrs; LVPtrIndex--;) {
               for (size_t IPtrIndex = NumIPtrs; IPtrIndex--;) {
@@ -2105,8 +2624,11 @@ class Pizlonator {
       }
     }
 
-    // The arguments interfere with one another.
+    // The arguments interfere with one another. They never get recorded, so they only need slots if
+    // we're not being picky about who gets one.
     for (Argument& A1 : OldF->args()) {
+      if (recordLowersOnlyAcrossSafepoints)
+        break;
       size_t NumA1Ptrs = countPtrs(A1.getType());
       if (!NumA1Ptrs)
         continue;
@@ -2122,11 +2644,15 @@ class Pizlonator {
     // Make this deterministic by having a known order in which we process stuff.
     std::vector<ValuePtr> Order;
     for (Argument& A : OldF->args()) {
+      if (!NeedsSlot(&A))
+        continue;
       for (size_t PtrIndex = countPtrs(A.getType()); PtrIndex--;)
         Order.push_back(ValuePtr(&A, PtrIndex));
     }
     for (BasicBlock* BB : Blocks) {
       for (Instruction& I : *BB) {
+        if (!NeedsSlot(&I))
+          continue;
         for (size_t PtrIndex = countPtrs(I.getType()); PtrIndex--;)
           Order.push_back(ValuePtr(&I, PtrIndex));
       }
@@ -2191,7 +2717,7 @@ class Pizlonator {
   void recordLowerAtIndex(Value* Lower, size_t FrameIndex, Instruction* InsertBefore) {
     assert(FrameIndex < FrameSize);
     Instruction* LowersPtr = GetElementPtrInst::Create(
-      FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 2) },
+      FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 3) },
       "filc_frame_lowers", InsertBefore);
     LowersPtr->setDebugLoc(InsertBefore->getDebugLoc());
     Instruction* LowerPtr = GetElementPtrInst::Create(
@@ -2254,6 +2780,8 @@ class Pizlonator {
       errs() << "Recording objects for " << *ValueKey << ", T = " << *T << ", V = " << *V
              << "\n";
     }
+    if (recordLowersOnlyAcrossSafepoints && !FrameIndexMap.count(ValuePtr(ValueKey, 0)))
+      return;
     size_t PtrIndex = 0;
     recordLowersRecurse(ValueKey, T, V, PtrIndex, InsertBefore);
     assert(PtrIndex == countPtrs(ValueKey->getType()));
@@ -2348,6 +2876,84 @@ class Pizlonator {
     return Result;
   }
 
+  // Check failures don't call into the runtime directly. They call a cold thunk that lives in
+  // .text.unlikely and that gets the origin as an index into filc_check_fail_origins. That way,
+  // the failure path in the function is just a 32-bit immediate and a direct call.
+  Constant* checkFailOriginIndex(Constant* Origin) {
+    auto Iter = CheckFailOriginIndices.find(Origin);
+    if (Iter != CheckFailOriginIndices.end())
+      return ConstantInt::get(Int32Ty, Iter->second);
+    unsigned Index = CheckFailOrigins.size();
+    CheckFailOrigins.push_back(Origin);
+    CheckFailOriginIndices[Origin] = Index;
+    return ConstantInt::get(Int32Ty, Index);
+  }
+
+  Function* checkFailThunk(Function*& Thunk, const char* Name) {
+    if (Thunk)
+      return Thunk;
+    Thunk = Function::Create(
+      FunctionType::get(VoidTy, { FlightPtrTy, Int32Ty }, false), GlobalValue::InternalLinkage, 0,
+      Name, &M);
+    Thunk->addFnAttr(Attribute::NoReturn);
+    Thunk->addFnAttr(Attribute::Cold);
+    Thunk->addFnAttr(Attribute::NoInline);
+    Thunk->setSectionPrefix("unlikely");
+    return Thunk;
+  }
+
+  void emitCheckFailThunkBody(Function* Thunk, FunctionCallee Fail, GlobalVariable* Table) {
+    if (!Thunk)
+      return;
+    BasicBlock* RootBB = BasicBlock::Create(C, "filc_check_fail_thunk_root", Thunk);
+    Instruction* Index = new ZExtInst(Thunk->getArg(1), IntPtrTy, "filc_origin_index", RootBB);
+    Instruction* OriginPtr = GetElementPtrInst::Create(
+      Table->getValueType(), Table, { ConstantInt::get(IntPtrTy, 0), Index }, "filc_origin_ptr",
+      RootBB);
+    Instruction* Origin = new LoadInst(RawPtrTy, OriginPtr, "filc_origin", RootBB);
+    CallInst::Create(Fail, { Thunk->getArg(0), Origin }, "", RootBB);
+    new UnreachableInst(C, RootBB);
+  }
+
+  // Gives the check failure thunks their bodies, now that we know all of the module's origins.
+  // This is native code, just like the check counter constructor.
+  void emitCheckFailThunks() {
+    if (CheckFailOrigins.empty()) {
+      assert(!AccessCheckFailThunk);
+      assert(!AlignmentContradictionThunk);
+      return;
+    }
+    ArrayType* TableTy = ArrayType::get(RawPtrTy, CheckFailOrigins.size());
+    GlobalVariable* Table = new GlobalVariable(
+      M, TableTy, true, GlobalVariable::PrivateLinkage,
+      ConstantArray::get(TableTy, CheckFailOrigins), "filc_check_fail_origins");
+    emitCheckFailThunkBody(AccessCheckFailThunk, OptimizedAccessCheckFail, Table);
+    emitCheckFailThunkBody(AlignmentContradictionThunk, OptimizedAlignmentContradiction, Table);
+  }
+
+  // All of a function's indirect call checks fail into one shared block, which gets the called
+  // pointer through a phi. The runtime finds the origin in the frame.
+  void branchToCallFail(Value* Cond, bool FailIfTrue, Value* Called, Instruction* InsertBefore) {
+    if (!CallFailB) {
+      CallFailB = BasicBlock::Create(C, "filc_call_fail_block", NewF);
+      CallFailPhi = PHINode::Create(Called->getType(), 0, "filc_call_fail_callee", CallFailB);
+      CallInst::Create(CheckFunctionCallFail, { CallFailPhi }, "", CallFailB)
+        ->setDebugLoc(InsertBefore->getDebugLoc());
+      new UnreachableInst(C, CallFailB);
+    }
+    BasicBlock* Pred = InsertBefore->getParent();
+    if (FailIfTrue) {
+      SplitBlockAndInsertIfThen(
+        expectFalse(Cond, InsertBefore), InsertBefore, false, nullptr, nullptr, nullptr,
+        CallFailB);
+    } else {
+      SplitBlockAndInsertIfElse(
+        expectTrue(Cond, InsertBefore), InsertBefore, false, nullptr, nullptr, nullptr,
+        CallFailB);
+    }
+    CallFailPhi->addIncoming(Called, Pred);
+  }
+
   template<typename CheckT>
   void checkCanonicalizedAccessChecks(const std::vector<CheckT>& Checks) {
     for (size_t Index = 0; Index < Checks.size();) {
@@ -2425,7 +3031,100 @@ class Pizlonator {
       FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 1) },
       "filc_frame_origin_ptr", InsertBefore);
     OriginPtr->setDebugLoc(InsertBefore->getDebugLoc());
-    (new StoreInst(Origin, OriginPtr, InsertBefore))->setDebugLoc(InsertBefore->getDebugLoc());
+    StoreInst* SI = new StoreInst(Origin, OriginPtr, InsertBefore);
+    SI->setDebugLoc(InsertBefore->getDebugLoc());
+    OriginStores.push_back(SI);
+  }
+
+  // The only code that writes our frame's origin, other than our own origin stores, is the runtime
+  // functions that we pass an origin to (like the pollcheck slow path, or unwinding). Calls to
+  // other Fil-C functions can't, since they push their own frame. Those don't get passed any
+  // globals, so anything that does is assumed to clobber the origin.
+  bool mayClobberOrigin(Instruction* I) {
+    CallBase* CB = dyn_cast<CallBase>(I);
+    if (!CB || isa<IntrinsicInst>(CB))
+      return false;
+    for (Value* Arg : CB->args()) {
+      if (isa<GlobalValue>(Arg) || isa<ConstantExpr>(Arg))
+        return true;
+    }
+    return false;
+  }
+
+  // Figures out which origin the frame must already have at the start of each block, and then
+  // removes the origin stores that would store that same origin again. Lots of calls share a
+  // DebugLoc (nested calls, or several calls after inlining), and nothing else would remove these
+  // stores, since the frame escapes into the thread.
+  //
+  // This doesn't work if we setjmp, since then a longjmp can bring us back with whatever origin the
+  // frame had at the call that longjmped.
+  void removeRedundantOriginStores() {
+    if (Setjmps.size())
+      return;
+
+    std::unordered_set<StoreInst*> Stores(OriginStores.begin(), OriginStores.end());
+
+    // A block that's missing from OriginAtHead hasn't been reached yet. A null origin means that we
+    // don't know.
+    std::unordered_map<BasicBlock*, Value*> OriginAtHead;
+    std::unordered_map<BasicBlock*, Value*> OriginAtTail;
+    auto Transfer = [&] (BasicBlock* BB, Value* Origin, bool ShouldRemove) -> Value* {
+      for (Instruction* I = &BB->front(); I;) {
+        Instruction* Next = I->getNextNode();
+        StoreInst* SI = dyn_cast<StoreInst>(I);
+        if (SI && Stores.count(SI)) {
+          if (ShouldRemove && SI->getValueOperand() == Origin) {
+            Instruction* OriginPtr = cast<Instruction>(SI->getPointerOperand());
+            SI->eraseFromParent();
+            if (OriginPtr->use_empty())
+              OriginPtr->eraseFromParent();
+          } else
+            Origin = SI->getValueOperand();
+        } else if (mayClobberOrigin(I))
+          Origin = nullptr;
+        I = Next;
+      }
+      return Origin;
+    };
+
+    BasicBlock* EntryBB = &NewF->getEntryBlock();
+    OriginAtHead[EntryBB] = nullptr;
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock& BB : *NewF) {
+        if (&BB != EntryBB) {
+          bool Reached = false;
+          Value* Origin = nullptr;
+          for (BasicBlock* Pred : predecessors(&BB)) {
+            auto Iter = OriginAtTail.find(Pred);
+            if (Iter == OriginAtTail.end())
+              continue;
+            if (!Reached)
+              Origin = Iter->second;
+            else if (Origin != Iter->second)
+              Origin = nullptr;
+            Reached = true;
+          }
+          if (!Reached)
+            continue;
+          auto Iter = OriginAtHead.find(&BB);
+          if (Iter != OriginAtHead.end() && Iter->second == Origin)
+            continue;
+          OriginAtHead[&BB] = Origin;
+        } else if (OriginAtTail.count(EntryBB))
+          continue;
+        Value* Tail = Transfer(&BB, OriginAtHead[&BB], false);
+        auto Iter = OriginAtTail.find(&BB);
+        if (Iter == OriginAtTail.end() || Iter->second != Tail) {
+          OriginAtTail[&BB] = Tail;
+          Changed = true;
+        }
+      }
+    }
+
+    for (auto& Pair : OriginAtHead)
+      Transfer(Pair.first, Pair.second, true);
   }
 
   AuxBaseAndPtr auxPtrForOperand(Value* P, Instruction* I, unsigned OperandIdx,
@@ -2446,6 +3145,215 @@ class Pizlonator {
     return AuxBaseAndPtr(AuxBaseP, AuxP);
   }
 
+  // Computes the first and last values that the induction variable of a counted loop can take in
+  // the header, as IntPtrTy.
+  void countedLoopRange(const CountedLoop& CL, Instruction* InsertBefore, Value*& Start,
+                        Value*& Last) {
+    auto toIntPtr = [&] (Value* V) -> Value* {
+      V = lowerConstantValue(V, InsertBefore, RawNull);
+      if (V->getType() == IntPtrTy)
+        return V;
+      Instruction* Result = new SExtInst(V, IntPtrTy, "filc_counted_loop_sext", InsertBefore);
+      Result->setDebugLoc(InsertBefore->getDebugLoc());
+      return Result;
+    };
+
+    Start = toIntPtr(CL.Start);
+    Last = toIntPtr(CL.Limit);
+    if (CL.LimitIsExclusive) {
+      Instruction* LastMinusOne = BinaryOperator::Create(
+        Instruction::Sub, Last, ConstantInt::get(IntPtrTy, 1), "filc_counted_loop_last",
+        InsertBefore);
+      LastMinusOne->setDebugLoc(InsertBefore->getDebugLoc());
+      Last = LastMinusOne;
+    }
+  }
+
+  // Keeping the induction variable within [0, INT32_MAX) means that it cannot wrap, that sign and
+  // zero extension agree on it, and that the math we do on it in the preheader cannot overflow. So,
+  // if this is true, then the induction variable only takes values in [Start, Last].
+  Value* countedLoopRangeIsSafe(Value* Start, Value* Last, Instruction* InsertBefore) {
+    DebugLoc Loc = InsertBefore->getDebugLoc();
+    Instruction* StartNotNegative = new ICmpInst(
+      InsertBefore, ICmpInst::ICMP_SGE, Start, ConstantInt::get(IntPtrTy, 0),
+      "filc_counted_loop_start_not_negative");
+    StartNotNegative->setDebugLoc(Loc);
+    Instruction* StartNotAfterLast = new ICmpInst(
+      InsertBefore, ICmpInst::ICMP_SLE, Start, Last, "filc_counted_loop_start_not_after_last");
+    StartNotAfterLast->setDebugLoc(Loc);
+    Instruction* LastIsSmall = new ICmpInst(
+      InsertBefore, ICmpInst::ICMP_SLT, Last, ConstantInt::get(IntPtrTy, INT32_MAX),
+      "filc_counted_loop_last_is_small");
+    LastIsSmall->setDebugLoc(Loc);
+    Instruction* Result = BinaryOperator::Create(
+      Instruction::And, StartNotNegative, StartNotAfterLast, "filc_counted_loop_and",
+      InsertBefore);
+    Result->setDebugLoc(Loc);
+    Result = BinaryOperator::Create(
+      Instruction::And, Result, LastIsSmall, "filc_counted_loop_range_is_safe", InsertBefore);
+    Result->setDebugLoc(Loc);
+    return Result;
+  }
+
+  // Emits a check into the preheader, the first time that someone asks for it, that is true if
+  // the loop will run no more than the period of its strip-mined pollcheck, and so will not
+  // pollcheck at all.
+  Value* loopRunsShortFlag(PollcheckPlan& Plan) {
+    if (Plan.RunsShort)
+      return Plan.RunsShort;
+
+    if (!Plan.Period)
+      Plan.RunsShort = ConstantInt::getTrue(Int1Ty);
+    else if (!Plan.IsCounted)
+      Plan.RunsShort = ConstantInt::getFalse(Int1Ty);
+    else {
+      Instruction* InsertBefore = Plan.PreheaderTerm;
+      Value* Start;
+      Value* Last;
+      countedLoopRange(Plan.Counted, InsertBefore, Start, Last);
+      Instruction* Distance = BinaryOperator::Create(
+        Instruction::Sub, Last, Start, "filc_counted_loop_distance", InsertBefore);
+      Distance->setDebugLoc(InsertBefore->getDebugLoc());
+      Instruction* IsShort = new ICmpInst(
+        InsertBefore, ICmpInst::ICMP_SLT, Distance, ConstantInt::get(IntPtrTy, Plan.Period),
+        "filc_loop_is_short");
+      IsShort->setDebugLoc(InsertBefore->getDebugLoc());
+      Instruction* Result = BinaryOperator::Create(
+        Instruction::And, countedLoopRangeIsSafe(Start, Last, InsertBefore), IsShort,
+        "filc_loop_runs_short", InsertBefore);
+      Result->setDebugLoc(InsertBefore->getDebugLoc());
+      Plan.RunsShort = Result;
+    }
+    return Plan.RunsShort;
+  }
+
+  // Emits the widened check into the preheader the first time that someone asks for it. The result
+  // is true if every range check that the loop does on the widened ptr would pass for every value
+  // that the induction variable can take while we are in the loop. The loop may exit early, which
+  // is fine, since then it only does a subset of those accesses.
+  //
+  // If the loop cannot call, allocate, or pollcheck, then nothing inside it can free the object
+  // (same reasoning as when we let NotFree facts flow through straight-line code). So, for loops
+  // that have a pollcheck plan, we also compute W.FastFlag, which additionally proves that the
+  // object is not free and that the loop runs short enough to skip its pollchecks. With that, the
+  // fast path has no checks in it at all, which is what lets the loop vectorizer have a go at it
+  // once the loop is unswitched.
+  Value* widenedLoopCheckFlag(WidenedLoopCheck& W) {
+    if (W.Flag)
+      return W.Flag;
+
+    Instruction* InsertBefore = W.PreheaderTerm;
+    DebugLoc Loc = InsertBefore->getDebugLoc();
+
+    Value* FlightBase = lowerConstantValue(W.Base, InsertBefore, RawNull);
+    Value* Lower = flightPtrLower(FlightBase, InsertBefore);
+    ICmpInst* HasObject = new ICmpInst(
+      InsertBefore, ICmpInst::ICMP_NE, Lower, RawNull, "filc_widened_has_object");
+    HasObject->setDebugLoc(Loc);
+    BasicBlock* NoObjectB = HasObject->getParent();
+    Instruction* ThenTerm = SplitBlockAndInsertIfThen(HasObject, InsertBefore, false);
+
+    Value* Start;
+    Value* Last;
+    countedLoopRange(W.Counted, ThenTerm, Start, Last);
+
+    Value* Result = countedLoopRangeIsSafe(Start, Last, ThenTerm);
+    auto addCondition = [&] (ICmpInst::Predicate Predicate, Value* Left, Value* Right,
+                             const char* Name) {
+      Instruction* Condition = new ICmpInst(ThenTerm, Predicate, Left, Right, Name);
+      Condition->setDebugLoc(Loc);
+      Condition = BinaryOperator::Create(
+        Instruction::And, Result, Condition, "filc_widened_and", ThenTerm);
+      Condition->setDebugLoc(Loc);
+      Result = Condition;
+    };
+
+    Value* Ptr = flightPtrPtr(FlightBase, ThenTerm);
+    auto ptrAtIndex = [&] (Value* Index, int64_t Offset) -> Value* {
+      Instruction* Scaled = BinaryOperator::Create(
+        Instruction::Mul, Index, ConstantInt::get(IntPtrTy, W.Scale), "filc_widened_scaled",
+        ThenTerm);
+      Scaled->setDebugLoc(Loc);
+      Instruction* Total = BinaryOperator::Create(
+        Instruction::Add, Scaled, ConstantInt::get(IntPtrTy, W.ConstantOffset + Offset),
+        "filc_widened_offset", ThenTerm);
+      Total->setDebugLoc(Loc);
+      Instruction* GEP = GetElementPtrInst::Create(
+        Int8Ty, Ptr, { Total }, "filc_widened_ptr", ThenTerm);
+      GEP->setDebugLoc(Loc);
+      return GEP;
+    };
+
+    // Both ends being within [lower, upper] implies that the ptr did not wrap in between, since
+    // the distance between them is less than 2^63. For writes, comparing signed against the write
+    // upper also checks that the object is writable.
+    bool FusedWrite = W.NeedsWritable && useFusedWriteChecks;
+    addCondition(FusedWrite ? ICmpInst::ICMP_SGE : ICmpInst::ICMP_UGE,
+                 ptrAtIndex(Start, W.LowerOffset), Lower, "filc_widened_above_lower");
+    addCondition(FusedWrite ? ICmpInst::ICMP_SLE : ICmpInst::ICMP_ULE,
+                 ptrAtIndex(Last, W.UpperOffset),
+                 FusedWrite ? writeUpperForLower(Lower, ThenTerm) : upperForLower(Lower, ThenTerm),
+                 "filc_widened_below_upper");
+
+    // The scale is a multiple of every alignment, so it's enough to check the first iteration.
+    for (AlignmentAndOffset A : W.Alignments) {
+      if (A.Alignment == 1)
+        continue;
+      Instruction* PtrInt = new PtrToIntInst(
+        ptrAtIndex(Start, A.AlignmentOffset), IntPtrTy, "filc_widened_ptr_as_int", ThenTerm);
+      PtrInt->setDebugLoc(Loc);
+      Instruction* Masked = BinaryOperator::Create(
+        Instruction::And, PtrInt, ConstantInt::get(IntPtrTy, A.Alignment - 1),
+        "filc_widened_alignment_masked", ThenTerm);
+      Masked->setDebugLoc(Loc);
+      addCondition(ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
+                   "filc_widened_is_aligned");
+    }
+
+    // Objects never become readonly after allocation, so this is loop-invariant.
+    if (W.NeedsWritable && !FusedWrite) {
+      Instruction* Masked = BinaryOperator::Create(
+        Instruction::And, flagsForLower(Lower, ThenTerm),
+        ConstantInt::get(IntPtrTy, ObjectFlagReadonly), "filc_widened_flags_masked", ThenTerm);
+      Masked->setDebugLoc(Loc);
+      addCondition(ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
+                   "filc_widened_is_writable");
+    }
+
+    Value* RangeResult = Result;
+    if (W.Plan) {
+      Instruction* Masked = BinaryOperator::Create(
+        Instruction::And, flagsForLower(Lower, ThenTerm),
+        ConstantInt::get(IntPtrTy, ObjectFlagFree), "filc_widened_flags_masked", ThenTerm);
+      Masked->setDebugLoc(Loc);
+      addCondition(ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
+                   "filc_widened_is_not_free");
+    }
+
+    PHINode* Flag = PHINode::Create(Int1Ty, 2, "filc_widened_check", InsertBefore);
+    Flag->addIncoming(ConstantInt::getFalse(Int1Ty), NoObjectB);
+    Flag->addIncoming(RangeResult, ThenTerm->getParent());
+    W.Flag = Flag;
+
+    if (W.Plan) {
+      PHINode* NotFreeFlag = PHINode::Create(
+        Int1Ty, 2, "filc_widened_check_not_free", InsertBefore);
+      NotFreeFlag->addIncoming(ConstantInt::getFalse(Int1Ty), NoObjectB);
+      NotFreeFlag->addIncoming(Result, ThenTerm->getParent());
+      Value* RunsShort = loopRunsShortFlag(*W.Plan);
+      if (ConstantInt* RunsShortC = dyn_cast<ConstantInt>(RunsShort)) {
+        if (RunsShortC->isOne())
+          W.FastFlag = NotFreeFlag;
+      } else {
+        Instruction* FastFlag = BinaryOperator::Create(
+          Instruction::And, NotFreeFlag, RunsShort, "filc_widened_check_fast", InsertBefore);
+        FastFlag->setDebugLoc(Loc);
+        W.FastFlag = FastFlag;
+      }
+    }
+    return Flag;
+  }
+
   void emitChecks(std::vector<AccessCheckWithDI> Checks, Instruction* Inst) {
     if (verbose)
       errs() << "Raw checks: " << Checks << "\n";
@@ -2482,6 +3390,7 @@ class Pizlonator {
       bool NeedsWritable = false;
       int64_t LowerBoundOffset = 0;
       bool HasLowerBound = false;
+      bool NeedsLowerBoundCheck = false;
       int64_t UpperBoundOffset = 0;
       bool HasUpperBound = false;
       bool HasRangeCheck = false;
@@ -2517,6 +3426,7 @@ class Pizlonator {
         case CheckKind::LowerBound:
           LowerBoundOffset = AC.Offset;
           HasLowerBound = true;
+          NeedsLowerBoundCheck = AC.CK == CheckKind::LowerBound;
           HasRangeCheck = true;
           RangeDI = combineDI(RangeDI, AC.DI);
           break;
@@ -2559,10 +3469,11 @@ class Pizlonator {
         }
 
         CallInst::Create(
-          OptimizedAlignmentContradiction, {
+          checkFailThunk(AlignmentContradictionThunk, "filc_alignment_contradiction_thunk"), {
             FlightPtr,
-            optimizedAlignmentContradictionOrigin(Alignments, Inst->getDebugLoc(), RangeDI) }, "",
-          Inst)->setDebugLoc(Inst->getDebugLoc());
+            checkFailOriginIndex(
+              optimizedAlignmentContradictionOrigin(Alignments, Inst->getDebugLoc(), RangeDI)) },
+          "", Inst)->setDebugLoc(Inst->getDebugLoc());
         continue;
       }
 
@@ -2587,30 +3498,81 @@ class Pizlonator {
         assert(UpperBoundOffset > LowerBoundOffset);
       }
 
+      bool IsOneAlignedRange =
+        HasUpperBound
+        && UpperBoundOffset - LowerBoundOffset == Alignment
+        && !AlignmentContradiction
+        // It's possible for the distance between upper bound and lower bound to be 16, but the
+        // KnownAlignment to be 16, but we're actually checking a 16-sized range of bytes not
+        // aligned to 16 (that straddle two 16 byte words).
+        && PositiveModulo(UpperBoundOffset, Alignment) == AlignmentOffset;
+
+      // This is the check we would do if filc_object had a size instead of an upper: one branch on
+      // (ptr - lower) < size. Below lower, the subtraction wraps around, so the upper bound check
+      // also does the lower bound check, at the cost of a longer data dependency.
+      bool UseSizeBoundsCheck = useSizeBoundsChecks && IsOneAlignedRange && NeedsLowerBoundCheck;
+
+      // If we check both bounds of a write here, then doing it with signed compares against the
+      // write upper also checks that the object is writable, so we don't have to load the flags.
+      // Free objects fail it too, since their upper is their lower. The signed lower bound check
+      // is what stops a ptr with the top bit set from getting under a readonly object's upper.
+      bool UseFusedWriteCheck =
+        useFusedWriteChecks && NeedsWritable && HasUpperBound && NeedsLowerBoundCheck
+        && !UseSizeBoundsCheck && !AlignmentContradiction
+        && UpperBoundOffset - LowerBoundOffset <= MaxFusedWriteCheckRange;
+
       BasicBlock* RangeFailB = nullptr;
       if (HasRangeCheck) {
         RangeFailB = BasicBlock::Create(C, "filc_range_fail_block", NewF);
         Instruction* RangeFailTerm = new UnreachableInst(C, RangeFailB);
         CallInst::Create(
-          OptimizedAccessCheckFail,
+          checkFailThunk(AccessCheckFailThunk, "filc_access_check_fail_thunk"),
           { ptrWithOffset(LowerBoundOffset, RangeFailTerm),
-            optimizedAccessCheckOrigin(
-              HasUpperBound ? UpperBoundOffset - LowerBoundOffset : 0, Alignment,
-              PositiveModulo(AlignmentOffset - LowerBoundOffset, Alignment),
-              NeedsWritable, Inst->getDebugLoc(), RangeDI) },
+            checkFailOriginIndex(
+              optimizedAccessCheckOrigin(
+                HasUpperBound ? UpperBoundOffset - LowerBoundOffset : 0, Alignment,
+                PositiveModulo(AlignmentOffset - LowerBoundOffset, Alignment),
+                NeedsWritable, Inst->getDebugLoc(), RangeDI)) },
           "", RangeFailTerm)->setDebugLoc(Inst->getDebugLoc());
       }
 
+      // If this is a counted loop access whose range was proved in the preheader, then the range
+      // checks only run when that proof failed. They still fail with the precise origin of this
+      // access.
+      WidenedLoopCheck* Widened = nullptr;
+      if (HasRangeCheck) {
+        auto WidenedIter = WidenedLoopChecksForInst.find(Inst);
+        if (WidenedIter != WidenedLoopChecksForInst.end()) {
+          auto Iter = WidenedIter->second.find(CanonicalPtr);
+          if (Iter != WidenedIter->second.end())
+            Widened = &WidenedLoopChecks[Iter->second];
+        }
+      }
+      Instruction* RangeInsertBefore = Inst;
+      Instruction* FreeInsertBefore = Inst;
+      if (Widened) {
+        Value* Flag = widenedLoopCheckFlag(*Widened);
+        if (Widened->FastFlag) {
+          FreeInsertBefore = SplitBlockAndInsertIfElse(
+            expectTrue(Widened->FastFlag, Inst), Inst, false);
+        }
+        RangeInsertBefore = SplitBlockAndInsertIfElse(
+          expectTrue(Flag, FreeInsertBefore), FreeInsertBefore, false);
+      }
+      if (HasRangeCheck)
+        emitCheckCount(CheckCountKind::Access, Inst->getDebugLoc(), RangeInsertBefore);
+
       for (size_t SubIndex = BeginIndex; SubIndex < EndIndex; ++SubIndex) {
         AccessCheckWithDI AC = Checks[SubIndex];
         switch (AC.CK) {
         case CheckKind::ValidObject: {
           ICmpInst* NullObject = new ICmpInst(
-            Inst, ICmpInst::ICMP_EQ, flightPtrLower(FlightPtr, Inst), RawNull,
-            "filc_null_access_object");
+            RangeInsertBefore, ICmpInst::ICMP_EQ, flightPtrLower(FlightPtr, RangeInsertBefore),
+            RawNull, "filc_null_access_object");
           NullObject->setDebugLoc(Inst->getDebugLoc());
           SplitBlockAndInsertIfThen(
-            expectFalse(NullObject, Inst), Inst, false, nullptr, nullptr, nullptr, RangeFailB);
+            expectFalse(NullObject, RangeInsertBefore), RangeInsertBefore, false, nullptr, nullptr,
+            nullptr, RangeFailB);
           break;
         }
 
@@ -2622,51 +3584,62 @@ class Pizlonator {
           if (AC.Size == 1)
             break;
           Instruction* PtrInt = new PtrToIntInst(
-            flightPtrPtr(ptrWithOffset(AC.Offset, Inst), Inst), IntPtrTy, "filc_ptr_as_int", Inst);
+            flightPtrPtr(ptrWithOffset(AC.Offset, RangeInsertBefore), RangeInsertBefore), IntPtrTy,
+            "filc_ptr_as_int", RangeInsertBefore);
           PtrInt->setDebugLoc(Inst->getDebugLoc());
           Instruction* Masked = BinaryOperator::Create(
             Instruction::And, PtrInt, ConstantInt::get(IntPtrTy, AC.Size - 1),
-            "filc_ptr_alignment_masked", Inst);
+            "filc_ptr_alignment_masked", RangeInsertBefore);
           Masked->setDebugLoc(Inst->getDebugLoc());
           ICmpInst* IsAligned = new ICmpInst(
-            Inst, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
+            RangeInsertBefore, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
             "filc_ptr_is_aligned");
           IsAligned->setDebugLoc(Inst->getDebugLoc());
           SplitBlockAndInsertIfElse(
-            expectTrue(IsAligned, Inst), Inst, false, nullptr, nullptr, nullptr, RangeFailB);
+            expectTrue(IsAligned, RangeInsertBefore), RangeInsertBefore, false, nullptr, nullptr,
+            nullptr, RangeFailB);
           break;
         }
 
         case CheckKind::CanWrite: {
           assert(NeedsWritable);
+          if (UseFusedWriteCheck)
+            break;
           BinaryOperator* Masked = BinaryOperator::Create(
-            Instruction::And, flagsForLower(flightPtrLower(FlightPtr, Inst), Inst),
+            Instruction::And,
+            flagsForLower(flightPtrLower(FlightPtr, RangeInsertBefore), RangeInsertBefore),
             ConstantInt::get(IntPtrTy, ObjectFlagReadonly | (HasFreeCheck ? ObjectFlagFree : 0)),
-            "filc_flags_masked", Inst);
+            "filc_flags_masked", RangeInsertBefore);
           Masked->setDebugLoc(Inst->getDebugLoc());
           ICmpInst* IsNotReadOnly = new ICmpInst(
-            Inst, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
+            RangeInsertBefore, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
             "filc_object_is_not_read_only");
           IsNotReadOnly->setDebugLoc(Inst->getDebugLoc());
           SplitBlockAndInsertIfElse(
-            expectTrue(IsNotReadOnly, Inst), Inst, false, nullptr, nullptr, nullptr, RangeFailB);
+            expectTrue(IsNotReadOnly, RangeInsertBefore), RangeInsertBefore, false, nullptr,
+            nullptr, nullptr, RangeFailB);
           break;
         }
 
         case CheckKind::NotFree: {
           assert(HasFreeCheck);
-          if ((HasLowerBound && HasUpperBound) || NeedsWritable)
+          // The widened check only proves things that cannot change while the loop runs. The
+          // object might still get freed by the loop, so unless we're on the fast path, we need a
+          // free check that covers both the slow path and the widened path.
+          if (!Widened && ((HasLowerBound && HasUpperBound) || NeedsWritable))
             break;
           BinaryOperator* Masked = BinaryOperator::Create(
-            Instruction::And, flagsForLower(flightPtrLower(FlightPtr, Inst), Inst),
-            ConstantInt::get(IntPtrTy, ObjectFlagFree), "filc_flags_masked", Inst);
+            Instruction::And,
+            flagsForLower(flightPtrLower(FlightPtr, FreeInsertBefore), FreeInsertBefore),
+            ConstantInt::get(IntPtrTy, ObjectFlagFree), "filc_flags_masked", FreeInsertBefore);
           Masked->setDebugLoc(Inst->getDebugLoc());
           ICmpInst* IsNotFree = new ICmpInst(
-            Inst, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
+            FreeInsertBefore, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(IntPtrTy, 0),
             "filc_object_is_not_free");
           IsNotFree->setDebugLoc(Inst->getDebugLoc());
           SplitBlockAndInsertIfElse(
-            expectTrue(IsNotFree, Inst), Inst, false, nullptr, nullptr, nullptr, RangeFailB);
+            expectTrue(IsNotFree, FreeInsertBefore), FreeInsertBefore, false, nullptr, nullptr,
+            nullptr, RangeFailB);
           break;
         }
           
@@ -2674,29 +3647,50 @@ class Pizlonator {
           assert(HasLowerBound);
           assert(HasUpperBound);
           assert(UpperBoundOffset > LowerBoundOffset);
-          Value* Upper = upperForLower(flightPtrLower(FlightPtr, Inst), Inst);
-          Value* Ptr = flightPtrPtr(ptrWithOffset(LowerBoundOffset, Inst), Inst);
+          Value* Lower = flightPtrLower(FlightPtr, RangeInsertBefore);
+          Value* Upper = UseFusedWriteCheck
+            ? writeUpperForLower(Lower, RangeInsertBefore)
+            : upperForLower(Lower, RangeInsertBefore);
+          Value* Ptr = flightPtrPtr(
+            ptrWithOffset(LowerBoundOffset, RangeInsertBefore), RangeInsertBefore);
           Instruction* IsBelowUpper;
-          if (UpperBoundOffset - LowerBoundOffset == Alignment
-              && !AlignmentContradiction
-              // It's possible for the distance between upper bound and lower bound to be 16, but
-              // the KnownAlignment to be 16, but we're actually checking a 16-sized range of bytes
-              // not aligned to 16 (that straddle two 16 byte words).
-              && PositiveModulo(UpperBoundOffset, Alignment) == AlignmentOffset) {
+          if (UseSizeBoundsCheck) {
             assert(PositiveModulo(LowerBoundOffset, Alignment) == AlignmentOffset);
+            Instruction* LowerInt = new PtrToIntInst(
+              Lower, IntPtrTy, "filc_lower_as_int", RangeInsertBefore);
+            LowerInt->setDebugLoc(Inst->getDebugLoc());
+            Instruction* PtrInt = new PtrToIntInst(
+              Ptr, IntPtrTy, "filc_ptr_as_int", RangeInsertBefore);
+            PtrInt->setDebugLoc(Inst->getDebugLoc());
+            Instruction* UpperInt = new PtrToIntInst(
+              Upper, IntPtrTy, "filc_upper_as_int", RangeInsertBefore);
+            UpperInt->setDebugLoc(Inst->getDebugLoc());
+            Instruction* Offset = BinaryOperator::Create(
+              Instruction::Sub, PtrInt, LowerInt, "filc_ptr_offset", RangeInsertBefore);
+            Offset->setDebugLoc(Inst->getDebugLoc());
+            Instruction* Size = BinaryOperator::Create(
+              Instruction::Sub, UpperInt, LowerInt, "filc_object_size", RangeInsertBefore);
+            Size->setDebugLoc(Inst->getDebugLoc());
             IsBelowUpper = new ICmpInst(
-              Inst, ICmpInst::ICMP_ULT, Ptr, Upper, "filc_ptr_below_upper");
+              RangeInsertBefore, ICmpInst::ICMP_ULT, Offset, Size, "filc_ptr_in_bounds");
+          } else if (IsOneAlignedRange) {
+            assert(PositiveModulo(LowerBoundOffset, Alignment) == AlignmentOffset);
+            IsBelowUpper = new ICmpInst(
+              RangeInsertBefore, UseFusedWriteCheck ? ICmpInst::ICMP_SLT : ICmpInst::ICMP_ULT, Ptr,
+              Upper, "filc_ptr_below_upper");
           } else {
             Instruction* UpperMinus = GetElementPtrInst::Create(
               Int8Ty, Upper, { ConstantInt::get(IntPtrTy, LowerBoundOffset - UpperBoundOffset) },
-              "filc_upper_minus", Inst);
+              "filc_upper_minus", RangeInsertBefore);
             UpperMinus->setDebugLoc(Inst->getDebugLoc());
             IsBelowUpper = new ICmpInst(
-              Inst, ICmpInst::ICMP_ULE, Ptr, UpperMinus, "filc_ptr_below_equal_upper");
+              RangeInsertBefore, UseFusedWriteCheck ? ICmpInst::ICMP_SLE : ICmpInst::ICMP_ULE, Ptr,
+              UpperMinus, "filc_ptr_below_equal_upper");
           }
           IsBelowUpper->setDebugLoc(Inst->getDebugLoc());
           SplitBlockAndInsertIfElse(
-            expectTrue(IsBelowUpper, Inst), Inst, false, nullptr, nullptr, nullptr, RangeFailB);
+            expectTrue(IsBelowUpper, RangeInsertBefore), RangeInsertBefore, false, nullptr,
+            nullptr, nullptr, RangeFailB);
           break;
         }
 
@@ -2706,12 +3700,16 @@ class Pizlonator {
 
         case CheckKind::LowerBound: {
           assert(HasLowerBound);
+          if (UseSizeBoundsCheck)
+            break;
           Instruction* IsBelowLower = new ICmpInst(
-            Inst, ICmpInst::ICMP_ULT, flightPtrPtr(ptrWithOffset(LowerBoundOffset, Inst), Inst),
-            flightPtrLower(FlightPtr, Inst), "filc_ptr_below_lower");
+            RangeInsertBefore, UseFusedWriteCheck ? ICmpInst::ICMP_SLT : ICmpInst::ICMP_ULT,
+            flightPtrPtr(ptrWithOffset(LowerBoundOffset, RangeInsertBefore), RangeInsertBefore),
+            flightPtrLower(FlightPtr, RangeInsertBefore), "filc_ptr_below_lower");
           IsBelowLower->setDebugLoc(Inst->getDebugLoc());
           SplitBlockAndInsertIfThen(
-            expectFalse(IsBelowLower, Inst), Inst, false, nullptr, nullptr, nullptr, RangeFailB);
+            expectFalse(IsBelowLower, RangeInsertBefore), RangeInsertBefore, false, nullptr,
+            nullptr, nullptr, RangeFailB);
           break;
         }
 
@@ -2899,6 +3897,115 @@ class Pizlonator {
     canonicalizeAccessChecks(Checks);
   }
 
+  // Returns the length of a memset, memcpy, or memmove that has its checks scheduled like any other
+  // access, so that it can set or copy the payload inline when there is no aux involved. Returns
+  // zero if it should just call into the runtime.
+  uint64_t inlineMemOpSize(IntrinsicInst* II) {
+    MemIntrinsic* MI = cast<MemIntrinsic>(II);
+    ConstantInt* Length = dyn_cast<ConstantInt>(MI->getLength());
+    if (!Length || MI->isVolatile() || Length->getValue().getActiveBits() > 32)
+      return 0;
+    uint64_t Size = Length->getZExtValue();
+    if (Size > inlineMemOpMaxSize)
+      return 0;
+    return Size;
+  }
+
+  struct MaskedAccess {
+    FixedVectorType* VT { nullptr };
+    unsigned PtrIndex { 0 };
+    unsigned MaskIndex { 0 };
+    Align Alignment;
+    AccessKind AK { AccessKind::Read };
+
+    // The x86 maskload and maskstore intrinsics take a vector of ints and use the sign bit of each
+    // lane, while the generic ones take a vector of i1.
+    bool MaskUsesSignBits { false };
+
+    uint64_t allLaneBits() const {
+      unsigned NumLanes = VT->getNumElements();
+      if (NumLanes == 64)
+        return ~static_cast<uint64_t>(0);
+      return (static_cast<uint64_t>(1) << NumLanes) - 1;
+    }
+  };
+
+  // Recognizes llvm.masked.load and llvm.masked.store, and the x86 AVX maskload and maskstore
+  // intrinsics that they're the generic form of. Only vectors without ptrs qualify, since the ptr
+  // lanes would each need their own aux access. Everything else falls back to being an unhandled
+  // intrinsic.
+  bool getMaskedAccess(IntrinsicInst* II, MaskedAccess& Result) {
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::masked_load:
+      Result.VT = dyn_cast<FixedVectorType>(II->getType());
+      Result.PtrIndex = 0;
+      Result.Alignment = cast<ConstantInt>(II->getArgOperand(1))->getAlignValue();
+      Result.MaskIndex = 2;
+      Result.AK = AccessKind::Read;
+      break;
+    case Intrinsic::masked_store:
+      Result.VT = dyn_cast<FixedVectorType>(II->getArgOperand(0)->getType());
+      Result.PtrIndex = 1;
+      Result.Alignment = cast<ConstantInt>(II->getArgOperand(2))->getAlignValue();
+      Result.MaskIndex = 3;
+      Result.AK = AccessKind::Write;
+      break;
+    case Intrinsic::x86_avx_maskload_pd:
+    case Intrinsic::x86_avx_maskload_ps:
+    case Intrinsic::x86_avx_maskload_pd_256:
+    case Intrinsic::x86_avx_maskload_ps_256:
+    case Intrinsic::x86_avx2_maskload_d:
+    case Intrinsic::x86_avx2_maskload_q:
+    case Intrinsic::x86_avx2_maskload_d_256:
+    case Intrinsic::x86_avx2_maskload_q_256:
+      Result.VT = cast<FixedVectorType>(II->getType());
+      Result.PtrIndex = 0;
+      Result.Alignment = Align(1);
+      Result.MaskIndex = 1;
+      Result.AK = AccessKind::Read;
+      Result.MaskUsesSignBits = true;
+      break;
+    case Intrinsic::x86_avx_maskstore_pd:
+    case Intrinsic::x86_avx_maskstore_ps:
+    case Intrinsic::x86_avx_maskstore_pd_256:
+    case Intrinsic::x86_avx_maskstore_ps_256:
+    case Intrinsic::x86_avx2_maskstore_d:
+    case Intrinsic::x86_avx2_maskstore_q:
+    case Intrinsic::x86_avx2_maskstore_d_256:
+    case Intrinsic::x86_avx2_maskstore_q_256:
+      Result.VT = cast<FixedVectorType>(II->getArgOperand(2)->getType());
+      Result.PtrIndex = 0;
+      Result.Alignment = Align(1);
+      Result.MaskIndex = 1;
+      Result.AK = AccessKind::Write;
+      Result.MaskUsesSignBits = true;
+      break;
+    default:
+      return false;
+    }
+    if (!Result.VT || hasPtrs(Result.VT) || Result.VT->getNumElements() > 64)
+      return false;
+    Type* ET = Result.VT->getElementType();
+    return DL.getTypeSizeInBits(ET) == DL.getTypeAllocSizeInBits(ET);
+  }
+
+  // Returns the enabled lanes of a masked access whose mask is a constant, as a bitmask. Returns
+  // std::nullopt if the mask isn't a constant, or has undef lanes.
+  std::optional<uint64_t> constantLaneBits(IntrinsicInst* II, const MaskedAccess& MA) {
+    Constant* Mask = dyn_cast<Constant>(II->getArgOperand(MA.MaskIndex));
+    if (!Mask)
+      return std::nullopt;
+    uint64_t Bits = 0;
+    for (unsigned Index = MA.VT->getNumElements(); Index--;) {
+      ConstantInt* Lane = dyn_cast_or_null<ConstantInt>(Mask->getAggregateElement(Index));
+      if (!Lane)
+        return std::nullopt;
+      if (MA.MaskUsesSignBits ? Lane->isNegative() : Lane->isOne())
+        Bits |= static_cast<uint64_t>(1) << Index;
+    }
+    return Bits;
+  }
+
   template<typename FuncT>
   void forEachCheck(Instruction* I, const FuncT& Func) {
     if (LoadInst* LI = dyn_cast<LoadInst>(I)) {
@@ -2938,9 +4045,33 @@ class Pizlonator {
         Func(II, RawPtrTy, II->getArgOperand(0), Align(WordSize), AccessKind::Write);
         Func(II, RawPtrTy, II->getArgOperand(1), Align(WordSize), AccessKind::Read);
         return;
-      default:
+      case Intrinsic::memset:
+      case Intrinsic::memset_inline:
+        if (uint64_t Size = inlineMemOpSize(II)) {
+          Func(II, ArrayType::get(Int8Ty, Size), II->getArgOperand(0), Align(1),
+               AccessKind::Write);
+        }
+        return;
+      case Intrinsic::memcpy:
+      case Intrinsic::memcpy_inline:
+      case Intrinsic::memmove:
+        if (uint64_t Size = inlineMemOpSize(II)) {
+          Func(II, ArrayType::get(Int8Ty, Size), II->getArgOperand(0), Align(1),
+               AccessKind::Write);
+          Func(II, ArrayType::get(Int8Ty, Size), II->getArgOperand(1), Align(1),
+               AccessKind::Read);
+        }
+        return;
+      default: {
+        // A masked access with all lanes enabled is just a vector access, so it gets the one check
+        // for the whole width like any other. Other masks get checked by the runtime when we lower
+        // them, since only the enabled lanes have to be in bounds.
+        MaskedAccess MA;
+        if (getMaskedAccess(II, MA) && constantLaneBits(II, MA) == MA.allLaneBits())
+          Func(II, MA.VT, II->getArgOperand(MA.PtrIndex), MA.Alignment, MA.AK);
         return;
       }
+      }
     }
 
     if (CallBase* CI = dyn_cast<CallBase>(I)) {
@@ -3427,26 +4558,122 @@ class Pizlonator {
     subtractChecks(ToChecks, FromChecks, /*CreateKnowns=*/true);
   }
   
-  void removeRedundantChecksUsingForwardAI(
-    const std::vector<BasicBlock*>& Blocks,
-    const std::unordered_set<const BasicBlock*>& BackEdgePreds,
-    const std::unordered_map<BasicBlock*, std::unordered_set<Value*>> CanonicalPtrLiveAtTail,
-    std::unordered_map<BasicBlock*, ChecksOrBottom>& ForwardChecksAtHead,
-    std::unordered_map<BasicBlock*, std::vector<AccessCheck>>& ForwardChecksAtTail) {
+  // Returns the size of the object that I allocates, if I allocates a fresh object whose lower is
+  // the ptr that I returns and whose upper is at least that many bytes above it. Returns zero
+  // otherwise. Such objects are always at least 16-byte aligned and writable.
+  //
+  // We only trust our own allocations: allocas and the zgc allocation API. A program can bring its
+  // own malloc, and we don't want a buggy allocator to turn into missing bounds checks.
+  int64_t allocationSize(Instruction* I) {
+    uint64_t Size = 0;
+    if (AllocaInst* AI = dyn_cast<AllocaInst>(I)) {
+      ConstantInt* Length = dyn_cast<ConstantInt>(AI->getArraySize());
+      if (!Length || Length->getValue().getActiveBits() > 32)
+        return 0;
+      Size = DL.getTypeAllocSize(AI->getAllocatedType()) * Length->getZExtValue();
+    } else if (CallBase* CI = dyn_cast<CallBase>(I)) {
+      Function* F = dyn_cast<Function>(CI->getCalledOperand());
+      if (!F || !F->isDeclaration() || CI->getFunctionType() != F->getFunctionType() ||
+          !F->getReturnType()->isPointerTy())
+        return 0;
+      Value* SizeV = nullptr;
+      if (F->getName() == "zgc_alloc" && CI->arg_size() == 1)
+        SizeV = CI->getArgOperand(0);
+      else if (F->getName() == "zgc_aligned_alloc" && CI->arg_size() == 2)
+        SizeV = CI->getArgOperand(1);
+      ConstantInt* SizeC = dyn_cast_or_null<ConstantInt>(SizeV);
+      if (!SizeC || SizeC->getValue().getActiveBits() > 32)
+        return 0;
+      Size = SizeC->getZExtValue();
+    }
+    if (Size > static_cast<uint64_t>(INT32_MAX))
+      return 0;
+    return Size;
+  }
 
-    ForwardChecksAtHead.clear();
-    ForwardChecksAtTail.clear();
+  // Fresh allocations pass all of the checks for accesses within their size, at least until the
+  // next effect, so forward propagation can treat them as if those checks were already done.
+  bool addAllocationFacts(Instruction* I, std::vector<AccessCheck>& Checks) {
+    int64_t Size = allocationSize(I);
+    if (!Size)
+      return false;
+    Checks.push_back(AccessCheck(I, 0, 0, CheckKind::ValidObject));
+    Checks.push_back(AccessCheck(I, 0, WordSize, CheckKind::Alignment));
+    Checks.push_back(AccessCheck(I, 0, 0, CheckKind::CanWrite));
+    Checks.push_back(AccessCheck(I, 0, 0, CheckKind::LowerBound));
+    Checks.push_back(AccessCheck(I, Size, 0, CheckKind::UpperBound));
+    Checks.push_back(AccessCheck(I, 0, 0, CheckKind::NotFree));
+    return true;
+  }
 
-    ForwardChecksAtHead[&NewF->getEntryBlock()].Bottom = false;
+  // Returns the size of P's object, if P is a constant global whose capability we know at compile
+  // time. Returns zero otherwise. The getter of a global we define always returns a ptr to the
+  // start of the global's payload, which is word aligned, at least as big as the initializer, and
+  // never free. Constant globals are also readonly, so the only check that accesses into them still
+  // need is CanWrite, and only stores have that, and it always fails.
+  //
+  // Interposable and externally initialized globals don't count, since the object we get at runtime
+  // might not be the one we see here.
+  int64_t constantGlobalSize(Value* P) {
+    GlobalVariable* G = dyn_cast<GlobalVariable>(P);
+    if (!G || !G->isConstant() || !G->hasDefinitiveInitializer() || G->isThreadLocal())
+      return 0;
+    uint64_t Size = DLBefore.getTypeStoreSize(G->getValueType());
+    if (Size > static_cast<uint64_t>(INT32_MAX))
+      return 0;
+    return Size;
+  }
 
-    bool Changed = true;
-    while (Changed) {
-      Changed = false;
-      for (BasicBlock* BB : Blocks) {
-        if (verbose)
+  // Constant globals pass all of the checks, other than CanWrite, for accesses within their size,
+  // and unlike fresh allocations, they keep passing them across effects.
+  void addConstantGlobalFacts(std::vector<AccessCheck>& Checks) {
+    std::unordered_set<Value*> Seen;
+    for (BasicBlock& BB : *NewF) {
+      for (Instruction& I : BB) {
+        auto Iter = ChecksForInst.find(&I);
+        if (Iter == ChecksForInst.end())
+          continue;
+        for (const AccessCheck& AC : Iter->second) {
+          int64_t Size = constantGlobalSize(AC.CanonicalPtr);
+          if (!Size || !Seen.insert(AC.CanonicalPtr).second)
+            continue;
+          Checks.push_back(AccessCheck(AC.CanonicalPtr, 0, 0, CheckKind::ValidObject));
+          Checks.push_back(AccessCheck(AC.CanonicalPtr, 0, WordSize, CheckKind::Alignment));
+          Checks.push_back(AccessCheck(AC.CanonicalPtr, 0, 0, CheckKind::LowerBound));
+          Checks.push_back(AccessCheck(AC.CanonicalPtr, Size, 0, CheckKind::UpperBound));
+          Checks.push_back(AccessCheck(AC.CanonicalPtr, 0, 0, CheckKind::NotFree));
+        }
+      }
+    }
+  }
+
+  void removeRedundantChecksUsingForwardAI(
+    const std::vector<BasicBlock*>& Blocks,
+    const std::unordered_set<const BasicBlock*>& BackEdgePreds,
+    const std::vector<std::unordered_set<Value*>>& CanonicalPtrLiveAtTail,
+    std::vector<ChecksOrBottom>& ForwardChecksAtHead,
+    std::vector<std::vector<AccessCheck>>& ForwardChecksAtTail) {
+
+    ForwardChecksAtHead.assign(Blocks.size(), ChecksOrBottom());
+    ForwardChecksAtTail.assign(Blocks.size(), std::vector<AccessCheck>());
+
+    assert(Blocks[0] == &NewF->getEntryBlock());
+    ChecksOrBottom& EntryCOB = ForwardChecksAtHead[0];
+    EntryCOB.Bottom = false;
+    auto PreconditionsIter = CalleePreconditions.find(OldF);
+    if (PreconditionsIter != CalleePreconditions.end())
+      EntryCOB.Checks.assign(PreconditionsIter->second.begin(), PreconditionsIter->second.end());
+    addConstantGlobalFacts(EntryCOB.Checks);
+    canonicalizeAccessChecks(EntryCOB.Checks);
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock* BB : Blocks) {
+        if (verbose)
           errs() << "Forward propagating in " << BB->getName() << "\n";
         
-        const ChecksOrBottom& COB = ForwardChecksAtHead[BB];
+        const ChecksOrBottom& COB = ForwardChecksAtHead[blockNumber(BB)];
         if (COB.Bottom)
           continue;
 
@@ -3457,7 +4684,8 @@ class Pizlonator {
         for (Instruction& I : *BB) {
           auto HandleEffects = [&] () {
             EraseIf(Checks, [&] (const AccessCheck& AC) -> bool {
-              return AC.CK == CheckKind::NotFree || AC.CK == CheckKind::GetAuxPtr;
+              return (AC.CK == CheckKind::NotFree && !constantGlobalSize(AC.CanonicalPtr))
+                || AC.CK == CheckKind::GetAuxPtr;
             });
           };
 
@@ -3479,13 +4707,13 @@ class Pizlonator {
             });
           }
 
+          addAllocationFacts(&I, Checks);
+
           if (verbose)
             errs() << "Checks after " << I << ":\n    " << Checks << "\n";
         }
 
-        auto Iter = CanonicalPtrLiveAtTail.find(BB);
-        assert(Iter != CanonicalPtrLiveAtTail.end());
-        const std::unordered_set<Value*>& Live = Iter->second;
+        const std::unordered_set<Value*>& Live = CanonicalPtrLiveAtTail[blockNumber(BB)];
         EraseIf(Checks, [&] (const AccessCheck& AC) -> bool {
           assert(AC.CanonicalPtr);
           return !Live.count(AC.CanonicalPtr);
@@ -3493,10 +4721,10 @@ class Pizlonator {
         canonicalizeAccessChecks(Checks);
         if (verbose)
           errs() << "Liveness-pruned and canonicalized checks at tail: " << Checks << "\n";
-        ForwardChecksAtTail[BB] = Checks;
+        ForwardChecksAtTail[blockNumber(BB)] = Checks;
 
         for (BasicBlock* SBB : successors(BB)) {
-          ChecksOrBottom& SCOB = ForwardChecksAtHead[SBB];
+          ChecksOrBottom& SCOB = ForwardChecksAtHead[blockNumber(SBB)];
           if (SCOB.Bottom) {
             SCOB.Bottom = false;
             SCOB.Checks = Checks;
@@ -3515,7 +4743,7 @@ class Pizlonator {
     for (BasicBlock* BB : Blocks) {
       if (verbose)
         errs() << "Optimizing " << BB->getName() << " using forward propagation results.\n";
-      const ChecksOrBottom& StateWithBottom = ForwardChecksAtHead[BB];
+      const ChecksOrBottom& StateWithBottom = ForwardChecksAtHead[blockNumber(BB)];
       
       // It's weird, but possible, that we have an unreachable block.
       if (StateWithBottom.Bottom)
@@ -3530,7 +4758,8 @@ class Pizlonator {
       for (Instruction& I : *BB) {
         auto HandleEffects = [&] () {
           EraseIf(Checks, [&] (const AccessCheck& AC) -> bool {
-            return AC.CK == CheckKind::NotFree || AC.CK == CheckKind::GetAuxPtr;
+            return (AC.CK == CheckKind::NotFree && !constantGlobalSize(AC.CanonicalPtr))
+              || AC.CK == CheckKind::GetAuxPtr;
           });
         };
         
@@ -3574,6 +4803,9 @@ class Pizlonator {
             return AC.CK == CheckKind::GetAuxPtr;
           });
         }
+
+        if (addAllocationFacts(&I, Checks))
+          NeedToCanonicalize = true;
         
         if (verbose)
           errs() << "Checks after " << I << ":\n    " << Checks << "\n";
@@ -3583,19 +4815,107 @@ class Pizlonator {
     ChecksForInst = std::move(NewChecksForInst);
   }
   
+  // Finds the checks on args that a function with a direct entrypoint does before it does anything
+  // else. Direct callers do these checks at the call site, where they can often be proven
+  // redundant, and the direct entrypoint gets to assume them. The entrypoint used by everyone else
+  // does them before forwarding to the direct one.
+  //
+  // We only look at the part of the entry block that comes before the first call. That's the same
+  // motion that backward propagation would do within the function, and it's enough to cover the
+  // small accessors that don't get inlined.
+  void computeCalleePreconditions() {
+    CalleePreconditions.clear();
+    if (!checkCalleePreconditionsAtCallSites || !optimizeChecks)
+      return;
+    
+    for (auto& Pair : FunctionToDirectFunction) {
+      Function* F = Pair.first;
+      std::vector<AccessCheckWithDI> Preconditions;
+      for (Instruction& I : F->getEntryBlock()) {
+        if (isa<CallBase>(&I))
+          break;
+        std::vector<AccessCheckWithDI> Checks;
+        buildChecks(&I, Checks);
+        for (const AccessCheckWithDI& AC : Checks) {
+          if (isa<Argument>(AC.CanonicalPtr) &&
+              AC.CK != CheckKind::GetAuxPtr && AC.CK != CheckKind::EnsureAuxPtr)
+            Preconditions.push_back(AC);
+        }
+      }
+      if (Preconditions.empty())
+        continue;
+      canonicalizeAccessChecks(Preconditions);
+      if (verbose)
+        errs() << "Preconditions for " << F->getName() << ": " << Preconditions << "\n";
+      CalleePreconditions[F] = std::move(Preconditions);
+    }
+  }
+
+  // Calls Func with each of the callee's preconditions, rewritten in terms of the call's operands.
+  template<typename FuncT>
+  void forEachCalleePreconditionCheck(Instruction* I, const FuncT& Func) {
+    CallBase* CI = dyn_cast<CallBase>(I);
+    if (!CI || !directCallee(CI))
+      return;
+    auto Iter = CalleePreconditions.find(cast<Function>(CI->getCalledOperand()));
+    if (Iter == CalleePreconditions.end())
+      return;
+
+    // We can't skip any of these, since the callee assumes all of them. If folding an operand's
+    // GEP would make an offset too big, then we check the operand as its own canonical ptr.
+    std::unordered_map<unsigned, PtrAndOffset> Operands;
+    for (const AccessCheckWithDI& AC : Iter->second) {
+      unsigned ArgNo = cast<Argument>(AC.CanonicalPtr)->getArgNo();
+      auto OperandIter = Operands.find(ArgNo);
+      if (OperandIter == Operands.end()) {
+        OperandIter = Operands.emplace(
+          ArgNo, canonicalizePtr(CI->getArgOperand(ArgNo))).first;
+      }
+      int64_t Offset = AC.Offset + OperandIter->second.Offset;
+      if ((int32_t)Offset != Offset)
+        OperandIter->second = PtrAndOffset(CI->getArgOperand(ArgNo), 0);
+    }
+    
+    for (const AccessCheckWithDI& AC : Iter->second) {
+      PtrAndOffset PAO = Operands[cast<Argument>(AC.CanonicalPtr)->getArgNo()];
+      AccessCheckWithDI NewAC = AC;
+      NewAC.CanonicalPtr = PAO.HighP;
+      switch (AC.CK) {
+      case CheckKind::Alignment:
+        NewAC.Offset = PositiveModulo(AC.Offset + PAO.Offset, AC.Size);
+        break;
+      case CheckKind::LowerBound:
+      case CheckKind::UpperBound:
+        NewAC.Offset = AC.Offset + PAO.Offset;
+        break;
+      default:
+        break;
+      }
+      Func(NewAC);
+    }
+  }
+
   void scheduleChecks(
     const std::vector<BasicBlock*>& Blocks,
     const std::unordered_set<const BasicBlock*>& BackEdgePreds) {
 
+    TimeTraceScope TimeScope("FilPizlonator schedule checks");
     if (verbose)
       errs() << "Scheduling checks for " << OldF->getName() << "\n";
 
     ChecksForInst.clear();
+    NumBuiltChecks = 0;
+    CheckScheduleNotOptimizedReason = nullptr;
     
     for (BasicBlock* BB : Blocks) {
       for (Instruction& I : *BB) {
         std::vector<AccessCheckWithDI> Checks;
         buildChecks(&I, Checks);
+        forEachCalleePreconditionCheck(&I, [&] (const AccessCheckWithDI& AC) {
+          Checks.push_back(AC);
+        });
+        canonicalizeAccessChecks(Checks);
+        NumBuiltChecks += Checks.size();
         if (!Checks.empty()) {
           assert(!ChecksForInst.count(&I));
           if (verbose)
@@ -3608,6 +4928,18 @@ class Pizlonator {
     if (!optimizeChecks) {
       if (verbose)
         errs() << "Not optimizing the check schedule.\n";
+      CheckScheduleNotOptimizedReason = "check optimization is disabled";
+      return;
+    }
+
+    // The analyses below iterate to a fixpoint over every block, and their states can hold a check
+    // for every canonical ptr that's live. That's fine for normal code, but generated code and
+    // interpreter loops can have tens of thousands of blocks. We'd rather emit the checks where the
+    // accesses are than spend minutes scheduling them.
+    if (Blocks.size() > checkOptimizationBlockLimit) {
+      if (verbose)
+        errs() << "Not optimizing the check schedule, since there are too many blocks.\n";
+      CheckScheduleNotOptimizedReason = "the function has too many basic blocks";
       return;
     }
     
@@ -3618,13 +4950,13 @@ class Pizlonator {
     // We need this so that we can GC the abstract state. Without this, the abstract state is likely
     // to get very large, causing memory usage issues and long running times.
     
-    std::unordered_map<BasicBlock*, std::unordered_set<Value*>> CanonicalPtrLiveAtTail;
+    std::vector<std::unordered_set<Value*>> CanonicalPtrLiveAtTail(Blocks.size());
     Changed = true;
     while (Changed) {
       Changed = false;
       for (size_t BlockIndex = Blocks.size(); BlockIndex--;) {
         BasicBlock* BB = Blocks[BlockIndex];
-        std::unordered_set<Value*> Live = CanonicalPtrLiveAtTail[BB];
+        std::unordered_set<Value*> Live = CanonicalPtrLiveAtTail[blockNumber(BB)];
 
         for (auto It = BB->rbegin(); It != BB->rend(); ++It) {
           Instruction* I = &*It;
@@ -3634,6 +4966,9 @@ class Pizlonator {
             assert(isa<Instruction>(P) || isa<Argument>(P) || isa<Constant>(P));
             Live.insert(P);
           });
+          forEachCalleePreconditionCheck(I, [&] (const AccessCheckWithDI& AC) {
+            Live.insert(AC.CanonicalPtr);
+          });
         }
 
         if (!BlockIndex) {
@@ -3643,7 +4978,7 @@ class Pizlonator {
 
         for (BasicBlock* PBB : predecessors(BB)) {
           for (Value* P : Live)
-            Changed |= CanonicalPtrLiveAtTail[PBB].insert(P).second;
+            Changed |= CanonicalPtrLiveAtTail[blockNumber(PBB)].insert(P).second;
         }
       }
     }
@@ -3656,8 +4991,8 @@ class Pizlonator {
     // This eliminates redundant checks and also shows us which checks are definitely performed along
     // which paths, which aids in making good choices during backward propagation.
     
-    std::unordered_map<BasicBlock*, ChecksOrBottom> ForwardChecksAtHead;
-    std::unordered_map<BasicBlock*, std::vector<AccessCheck>> ForwardChecksAtTail;
+    std::vector<ChecksOrBottom> ForwardChecksAtHead;
+    std::vector<std::vector<AccessCheck>> ForwardChecksAtTail;
 
     removeRedundantChecksUsingForwardAI(
       Blocks, BackEdgePreds, CanonicalPtrLiveAtTail, ForwardChecksAtHead, ForwardChecksAtTail);
@@ -3677,8 +5012,8 @@ class Pizlonator {
         AC.CK = FundamentalCheckKind(AC.CK);
     }
     
-    std::unordered_map<BasicBlock*, ChecksWithDIOrBottom> BackwardChecksAtTail;
-    std::unordered_map<BasicBlock*, std::vector<AccessCheckWithDI>> BackwardChecksAtHead;
+    std::vector<ChecksWithDIOrBottom> BackwardChecksAtTail(Blocks.size());
+    std::vector<std::vector<AccessCheckWithDI>> BackwardChecksAtHead(Blocks.size());
 
     if (verbose) {
       for (const BasicBlock* BB : BackEdgePreds)
@@ -3700,7 +5035,7 @@ class Pizlonator {
           isa<CallBase>(BB->getTerminator())) {
         if (verbose)
           errs() << "Labeling " << BB->getName() << " as being a non-bottom.\n";
-        BackwardChecksAtTail[BB].Bottom = false;
+        BackwardChecksAtTail[blockNumber(BB)].Bottom = false;
       }
     }
 
@@ -3713,7 +5048,7 @@ class Pizlonator {
         if (verbose)
           errs() << "Backwards propagation at " << BB->getName() << "\n";
         
-        ChecksWithDIOrBottom& COB = BackwardChecksAtTail[BB];
+        ChecksWithDIOrBottom& COB = BackwardChecksAtTail[blockNumber(BB)];
         if (COB.Bottom)
           continue;
 
@@ -3722,7 +5057,7 @@ class Pizlonator {
         if (verbose)
           errs() << "Starting with checks: " << Checks << "\n";
         
-        subtractChecks(Checks, ForwardChecksAtTail[BB]);
+        subtractChecks(Checks, ForwardChecksAtTail[blockNumber(BB)]);
 
         if (verbose)
           errs() << "Checks after forward-pruning and removing unprofitable: " << Checks << "\n";
@@ -3763,7 +5098,7 @@ class Pizlonator {
         else {
           canonicalizeAccessChecks(Checks);
           for (BasicBlock* PBB : predecessors(BB)) {
-            ChecksWithDIOrBottom& PCOB = BackwardChecksAtTail[PBB];
+            ChecksWithDIOrBottom& PCOB = BackwardChecksAtTail[blockNumber(PBB)];
             if (PCOB.Bottom)
               continue;
             if (verbose)
@@ -3776,8 +5111,9 @@ class Pizlonator {
             for (AccessCheckWithDI& AC : ChecksAtTail)
               AC.DI = nullptr;
             if (verbose)
-              errs() << "    Forward checks at tail: " << ForwardChecksAtTail[PBB] << "\n";
-            addAccessChecks(ChecksAtTail, ForwardChecksAtTail[PBB]);
+              errs() << "    Forward checks at tail: " << ForwardChecksAtTail[blockNumber(PBB)]
+                     << "\n";
+            addAccessChecks(ChecksAtTail, ForwardChecksAtTail[blockNumber(PBB)]);
             if (verbose)
               errs() << "    Combined checks at tail: " << ChecksAtTail << "\n";
             mergeAccessChecks(Checks, ChecksAtTail, AIDirection::Forward);
@@ -3787,9 +5123,9 @@ class Pizlonator {
         }
         if (verbose)
           errs() << "Checks at head after merging with predecessors: " << Checks << "\n";
-        BackwardChecksAtHead[BB] = Checks;
+        BackwardChecksAtHead[blockNumber(BB)] = Checks;
         for (BasicBlock* PBB : predecessors(BB)) {
-          ChecksWithDIOrBottom& PCOB = BackwardChecksAtTail[PBB];
+          ChecksWithDIOrBottom& PCOB = BackwardChecksAtTail[blockNumber(PBB)];
           if (PCOB.Bottom) {
             PCOB.Bottom = false;
             PCOB.Checks = Checks;
@@ -3807,10 +5143,10 @@ class Pizlonator {
         errs() << "Scheduling checks in " << BB->getName()
                << " using results of backward propagation\n";
       }
-      std::vector<AccessCheckWithDI> Checks = BackwardChecksAtTail[BB].Checks;
+      std::vector<AccessCheckWithDI> Checks = BackwardChecksAtTail[blockNumber(BB)].Checks;
       if (verbose)
         errs() << "Starting with checks: " << Checks << "\n";
-      subtractChecks(Checks, ForwardChecksAtTail[BB]);
+      subtractChecks(Checks, ForwardChecksAtTail[blockNumber(BB)]);
       if (verbose)
         errs() << "Checks after forward-pruning and removing unprofitable: " << Checks << "\n";
 
@@ -3881,7 +5217,7 @@ class Pizlonator {
         assert(Checks.empty());
       }
       canonicalizeAccessChecks(Checks);
-      subtractChecks(Checks, BackwardChecksAtHead[BB]);
+      subtractChecks(Checks, BackwardChecksAtHead[blockNumber(BB)]);
       ChecksToEmit.insert(ChecksToEmit.end(), Checks.begin(), Checks.end());
       assert(!NewChecksForInst.count(LastI));
       canonicalizeAccessChecks(ChecksToEmit);
@@ -3916,6 +5252,698 @@ class Pizlonator {
       Blocks, BackEdgePreds, CanonicalPtrLiveAtTail, ForwardChecksAtHead, ForwardChecksAtTail);
   }
 
+  bool matchWidenedLoopPtr(Loop* L, DominatorTree& DT, PHINode* IV, Value* P,
+                           WidenedLoopCheck& W) {
+    GetElementPtrInst* GEP = dyn_cast<GetElementPtrInst>(P);
+    if (!GEP || !GEP->getType()->isPointerTy() || !L->contains(GEP))
+      return false;
+
+    Value* Base = GEP->getPointerOperand();
+    if (!L->isLoopInvariant(Base))
+      return false;
+    if (Instruction* BaseI = dyn_cast<Instruction>(Base)) {
+      if (!DT.dominates(BaseI, W.PreheaderTerm))
+        return false;
+    }
+
+    unsigned BitWidth = DLBefore.getIndexTypeSizeInBits(GEP->getType());
+    MapVector<Value*, APInt> VariableOffsets;
+    APInt ConstantOffset(BitWidth, 0);
+    if (!GEP->collectOffset(DLBefore, BitWidth, VariableOffsets, ConstantOffset))
+      return false;
+    if (VariableOffsets.size() != 1)
+      return false;
+
+    Value* Index = VariableOffsets.front().first;
+    const APInt& Scale = VariableOffsets.front().second;
+    if (isa<SExtInst>(Index) || isa<ZExtInst>(Index))
+      Index = cast<CastInst>(Index)->getOperand(0);
+    if (Index != IV)
+      return false;
+    if (!Scale.isStrictlyPositive() || Scale.getSExtValue() > INT32_MAX)
+      return false;
+    if ((int32_t)ConstantOffset.getSExtValue() != ConstantOffset.getSExtValue())
+      return false;
+
+    W.Base = Base;
+    W.Scale = Scale.getSExtValue();
+    W.ConstantOffset = ConstantOffset.getSExtValue();
+    return true;
+  }
+
+  // Matches loops whose latch does "iv + 1 < limit" or "iv < limit", or the equivalent with != or
+  // with the branch flipped around, where iv is a header phi that goes up by one on each iteration
+  // and limit is loop-invariant. Note that this does not prove anything about the trip count, since
+  // the start could be after the limit, and the loop could have other exits.
+  bool matchCountedLoop(Loop* L, DominatorTree& DT, CountedLoop& Result) {
+    BasicBlock* Preheader = L->getLoopPreheader();
+    BasicBlock* Latch = L->getLoopLatch();
+    if (!Preheader || !Latch)
+      return false;
+
+    BranchInst* LatchBranch = dyn_cast<BranchInst>(Latch->getTerminator());
+    if (!LatchBranch || !LatchBranch->isConditional())
+      return false;
+    if ((LatchBranch->getSuccessor(0) == L->getHeader())
+        == (LatchBranch->getSuccessor(1) == L->getHeader()))
+      return false;
+    ICmpInst* Compare = dyn_cast<ICmpInst>(LatchBranch->getCondition());
+    if (!Compare)
+      return false;
+    ICmpInst::Predicate Predicate = Compare->getPredicate();
+    if (LatchBranch->getSuccessor(1) == L->getHeader())
+      Predicate = ICmpInst::getInversePredicate(Predicate);
+    Value* Left = Compare->getOperand(0);
+    Value* Limit = Compare->getOperand(1);
+    if (L->isLoopInvariant(Left)) {
+      std::swap(Left, Limit);
+      Predicate = ICmpInst::getSwappedPredicate(Predicate);
+    }
+    if (Predicate != ICmpInst::ICMP_NE
+        && Predicate != ICmpInst::ICMP_ULT
+        && Predicate != ICmpInst::ICMP_SLT)
+      return false;
+    if (!L->isLoopInvariant(Limit))
+      return false;
+    if (Instruction* LimitI = dyn_cast<Instruction>(Limit)) {
+      if (!DT.dominates(LimitI, Preheader->getTerminator()))
+        return false;
+    }
+
+    auto isIncrement = [&] (Value* V, Value* Of) -> bool {
+      BinaryOperator* Add = dyn_cast<BinaryOperator>(V);
+      if (!Add || Add->getOpcode() != Instruction::Add)
+        return false;
+      ConstantInt* One = nullptr;
+      if (Add->getOperand(0) == Of)
+        One = dyn_cast<ConstantInt>(Add->getOperand(1));
+      else if (Add->getOperand(1) == Of)
+        One = dyn_cast<ConstantInt>(Add->getOperand(0));
+      return One && One->isOne();
+    };
+
+    PHINode* IV = nullptr;
+    bool LimitIsExclusive = false;
+    for (PHINode& Phi : L->getHeader()->phis()) {
+      if (Phi.getNumIncomingValues() != 2)
+        continue;
+      Value* Next = Phi.getIncomingValueForBlock(Latch);
+      if (!isIncrement(Next, &Phi))
+        continue;
+      if (Left == &Phi) {
+        IV = &Phi;
+        LimitIsExclusive = false;
+        break;
+      }
+      if (Left == Next) {
+        IV = &Phi;
+        LimitIsExclusive = true;
+        break;
+      }
+    }
+    if (!IV)
+      return false;
+    IntegerType* IVTy = dyn_cast<IntegerType>(IV->getType());
+    if (!IVTy || (IVTy->getBitWidth() != 32 && IVTy->getBitWidth() != 64))
+      return false;
+
+    Result.IV = IV;
+    Result.Start = IV->getIncomingValueForBlock(Preheader);
+    Result.Limit = Limit;
+    Result.LimitIsExclusive = LimitIsExclusive;
+    return true;
+  }
+
+  // Finds the canonical ptrs that counted loops index by their induction variable, so that all of
+  // the range checks on them can be proved once in the preheader. This has to run after scheduling
+  // but before we start splitting blocks, since it uses LoopInfo.
+  void findWidenedLoopChecks(DominatorTree& DT, LoopInfo& LI) {
+    WidenedLoopChecks.clear();
+    WidenedLoopChecksForInst.clear();
+
+    if (!widenChecksInLoops)
+      return;
+
+    for (Loop* L : LI.getLoopsInPreorder()) {
+      // The widened fast path duplicates the loop's checks, which isn't worth it in cold loops.
+      if (isColdBlock(L->getHeader()))
+        continue;
+      CountedLoop CL;
+      if (!matchCountedLoop(L, DT, CL))
+        continue;
+      BasicBlock* Preheader = L->getLoopPreheader();
+      PHINode* IV = CL.IV;
+      auto PlanIter = PollcheckPlans.find(L->getLoopLatch());
+      PollcheckPlan* Plan = PlanIter == PollcheckPlans.end() ? nullptr : &PlanIter->second;
+
+      std::unordered_map<Value*, WidenedLoopCheck> Candidates;
+      std::unordered_map<Value*, std::vector<Instruction*>> CandidateInsts;
+      std::unordered_set<Value*> Rejected;
+      for (BasicBlock* BB : L->blocks()) {
+        for (Instruction& I : *BB) {
+          auto ChecksIter = ChecksForInst.find(&I);
+          if (ChecksIter == ChecksForInst.end())
+            continue;
+          for (const AccessCheckWithDI& AC : ChecksIter->second) {
+            Value* P = AC.CanonicalPtr;
+            if (Rejected.count(P))
+              continue;
+            auto CandidateIter = Candidates.find(P);
+            if (CandidateIter == Candidates.end()) {
+              WidenedLoopCheck W;
+              W.PreheaderTerm = Preheader->getTerminator();
+              W.Counted = CL;
+              W.Plan = Plan;
+              if (!matchWidenedLoopPtr(L, DT, IV, P, W)) {
+                Rejected.insert(P);
+                continue;
+              }
+              CandidateIter = Candidates.emplace(P, W).first;
+            }
+            WidenedLoopCheck& W = CandidateIter->second;
+            std::vector<Instruction*>& Insts = CandidateInsts[P];
+            if (Insts.empty() || Insts.back() != &I)
+              Insts.push_back(&I);
+            switch (AC.CK) {
+            case CheckKind::Alignment: {
+              if (W.Scale % AC.Size) {
+                Rejected.insert(P);
+                break;
+              }
+              AlignmentAndOffset A(AC.Size, AC.Offset);
+              if (std::find(W.Alignments.begin(), W.Alignments.end(), A) == W.Alignments.end())
+                W.Alignments.push_back(A);
+              break;
+            }
+            case CheckKind::CanWrite:
+              W.NeedsWritable = true;
+              break;
+            case CheckKind::KnownLowerBound:
+            case CheckKind::LowerBound:
+              W.LowerOffset = W.HasLowerBound ? std::min(W.LowerOffset, AC.Offset) : AC.Offset;
+              W.HasLowerBound = true;
+              break;
+            case CheckKind::UpperBound:
+              W.UpperOffset = W.HasUpperBound ? std::max(W.UpperOffset, AC.Offset) : AC.Offset;
+              W.HasUpperBound = true;
+              break;
+            default:
+              break;
+            }
+          }
+        }
+      }
+
+      for (auto& Pair : Candidates) {
+        if (Rejected.count(Pair.first) || !Pair.second.HasLowerBound
+            || !Pair.second.HasUpperBound)
+          continue;
+        if (verbose)
+          errs() << "Widening checks on " << *Pair.first << " in loop " << *L << "\n";
+        size_t Index = WidenedLoopChecks.size();
+        WidenedLoopChecks.push_back(Pair.second);
+        for (Instruction* I : CandidateInsts[Pair.first])
+          WidenedLoopChecksForInst[I][Pair.first] = Index;
+      }
+    }
+  }
+
+  // FIXME: Back edges could carry no pollcheck at all if we had asynchronous safepoints, like Go
+  // does: the runtime would signal a thread that is slow to respond, and the handler would roll it
+  // forward to the next back edge and run the handshake callback there. That needs two things we
+  // don't have. First, a map from each back edge's machine PC to where its live ptrs are, which
+  // only the backend can produce, since we run on IR and the GC finds ptrs through the frame
+  // slots that we write before pollchecks and calls. Second, a way for the runtime to resume a
+  // thread at a mapped PC from inside a signal handler. Until then, strip mining (see
+  // planPollchecks) is how we keep pollchecks off the hot path.
+  void emitPollcheck(Instruction* InsertBefore, DebugLoc Loc) {
+    emitCheckCount(CheckCountKind::Pollcheck, Loc, InsertBefore);
+    Value* StatePtr = threadStatePtr(MyThread, InsertBefore);
+    LoadInst* StateLoad = new LoadInst(
+      Int8Ty, StatePtr, "filc_thread_state_load", InsertBefore);
+    StateLoad->setDebugLoc(Loc);
+    BinaryOperator* Masked = BinaryOperator::Create(
+      Instruction::And, StateLoad,
+      ConstantInt::get(
+        Int8Ty,
+        ThreadStateCheckRequested | ThreadStateStopRequested | ThreadStateDeferredSignal
+        | ThreadStateAssistRequested),
+      "filc_thread_state_masked", InsertBefore);
+    Masked->setDebugLoc(Loc);
+    ICmpInst* PollcheckNotNeeded = new ICmpInst(
+      InsertBefore, ICmpInst::ICMP_EQ, Masked, ConstantInt::get(Int8Ty, 0),
+      "filc_pollcheck_not_needed");
+    PollcheckNotNeeded->setDebugLoc(Loc);
+    Instruction* NewTerm =
+      SplitBlockAndInsertIfElse(
+        expectTrue(PollcheckNotNeeded, InsertBefore), InsertBefore, false);
+    CallInst::Create(
+      PollcheckSlow, { MyThread, getOrigin(Loc) }, "", NewTerm)->setDebugLoc(Loc);
+  }
+
+  // Counts down from the period in a header phi, and only does the pollcheck when the count hits
+  // zero. Loops that are known to run shorter than the period skip the pollcheck entirely, which
+  // leaves them with a loop-invariant branch that unswitching can get rid of.
+  void emitStripMinedPollcheck(BasicBlock* Latch, PollcheckPlan& Plan) {
+    Instruction* Term = Latch->getTerminator();
+    DebugLoc Loc = Term->getDebugLoc();
+    Value* RunsShort = loopRunsShortFlag(Plan);
+    PHINode* Countdown = PHINode::Create(
+      Int32Ty, 2, "filc_pollcheck_countdown", &Plan.Header->front());
+    Countdown->addIncoming(
+      ConstantInt::get(Int32Ty, Plan.Period), Plan.PreheaderTerm->getParent());
+    Countdown->addIncoming(UndefValue::get(Int32Ty), Latch);
+    Instruction* Next = BinaryOperator::Create(
+      Instruction::Sub, Countdown, ConstantInt::get(Int32Ty, 1), "filc_pollcheck_countdown_next",
+      Term);
+    Next->setDebugLoc(Loc);
+    ICmpInst* IsDone = new ICmpInst(
+      Term, ICmpInst::ICMP_EQ, Next, ConstantInt::get(Int32Ty, 0), "filc_pollcheck_countdown_done");
+    IsDone->setDebugLoc(Loc);
+    Instruction* ShouldPollcheck = IsDone;
+    if (!isa<ConstantInt>(RunsShort)) {
+      Instruction* RunsLong = BinaryOperator::CreateNot(RunsShort, "filc_loop_runs_long", Term);
+      RunsLong->setDebugLoc(Loc);
+      ShouldPollcheck = BinaryOperator::Create(
+        Instruction::And, RunsLong, IsDone, "filc_pollcheck_countdown_should_pollcheck", Term);
+      ShouldPollcheck->setDebugLoc(Loc);
+    }
+    BasicBlock* CountingB = IsDone->getParent();
+    Instruction* ThenTerm = SplitBlockAndInsertIfThen(
+      expectFalse(ShouldPollcheck, Term), Term, false);
+    emitPollcheck(ThenTerm, Loc);
+    PHINode* Reset = PHINode::Create(Int32Ty, 2, "filc_pollcheck_countdown_reset", Term);
+    Reset->addIncoming(Next, CountingB);
+    Reset->addIncoming(ConstantInt::get(Int32Ty, Plan.Period), ThenTerm->getParent());
+    Countdown->setIncomingValueForBlock(Term->getParent(), Reset);
+  }
+
+  static bool isCallThatCannotTakeLong(CallBase* CB) {
+    IntrinsicInst* II = dyn_cast<IntrinsicInst>(CB);
+    if (!II)
+      return false;
+    if (isa<DbgInfoIntrinsic>(II))
+      return true;
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::lifetime_start:
+    case Intrinsic::lifetime_end:
+    case Intrinsic::assume:
+    case Intrinsic::expect:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // Pollchecks on back edges are what keeps handshake latency bounded, so we can only remove or
+  // space out the ones that guard a bounded amount of work. That means that we only consider
+  // innermost loops that don't call or allocate. If such a loop provably runs no more than
+  // pollcheckBudget instructions in total, then it doesn't need a pollcheck at all. Otherwise we
+  // pollcheck once per pollcheckBudget instructions' worth of iterations.
+  // Finds the blocks that the profile says are cold. We don't know anything without profile data,
+  // so then nothing is cold unless the whole function is.
+  void findColdBlocks(LoopInfo& LI) {
+    BlockIsCold.clear();
+
+    if (!useProfileForChecks)
+      return;
+
+    std::optional<Function::ProfileCount> EntryCount = OldF->getEntryCount();
+    if (OldF->hasFnAttribute(Attribute::Cold) || (EntryCount && !EntryCount->getCount())) {
+      for (BasicBlock& BB : *NewF)
+        BlockIsCold[&BB] = true;
+      return;
+    }
+
+    bool HasBranchWeights = false;
+    for (BasicBlock& BB : *NewF) {
+      if (BB.getTerminator()->getMetadata(LLVMContext::MD_prof))
+        HasBranchWeights = true;
+    }
+    if (!HasBranchWeights)
+      return;
+
+    BranchProbabilityInfo BPI(*NewF, LI);
+    BlockFrequencyInfo BFI(*NewF, BPI, LI);
+    uint64_t EntryFreq = BFI.getEntryFreq();
+    for (BasicBlock& BB : *NewF) {
+      uint64_t Freq = BFI.getBlockFreq(&BB).getFrequency();
+      BlockIsCold[&BB] = Freq < EntryFreq / std::max(coldBlockRatio.getValue(), 1u);
+    }
+  }
+
+  // Tells if the block is cold. Lowering splits blocks, so for blocks that didn't exist when we
+  // looked at the profile, we walk up unique predecessors. A block never runs more often than its
+  // unique predecessor.
+  bool isColdBlock(BasicBlock* BB) {
+    for (size_t Steps = NewF->size(); Steps--;) {
+      auto Iter = BlockIsCold.find(BB);
+      if (Iter != BlockIsCold.end())
+        return Iter->second;
+      BB = BB->getUniquePredecessor();
+      if (!BB)
+        return false;
+    }
+    return false;
+  }
+
+  void planPollchecks(DominatorTree& DT, LoopInfo& LI) {
+    PollcheckPlans.clear();
+    UnplannedPollcheckReasons.clear();
+
+    if (!optimizePollchecks)
+      return;
+
+    for (Loop* L : LI.getLoopsInPreorder()) {
+      auto Unplanned = [&] (const char* Reason) {
+        UnplannedPollcheckReasons[L->getHeader()] = Reason;
+      };
+      if (!L->isInnermost()) {
+        Unplanned("it is not an innermost loop");
+        continue;
+      }
+      BasicBlock* Preheader = L->getLoopPreheader();
+      BasicBlock* Latch = L->getLoopLatch();
+      if (!Preheader || !Latch) {
+        Unplanned("it has no unique preheader and latch");
+        continue;
+      }
+
+      // The latch's pollcheck might also be the pollcheck for the back edge of some other loop.
+      bool OnlyBacksUpToHeader = true;
+      for (BasicBlock* Succ : successors(Latch)) {
+        if (Succ != L->getHeader() && DT.dominates(Succ, Latch))
+          OnlyBacksUpToHeader = false;
+      }
+      if (!OnlyBacksUpToHeader) {
+        Unplanned("its latch is also the back edge of another loop");
+        continue;
+      }
+
+      size_t Size = 0;
+      bool CanTakeLong = false;
+      for (BasicBlock* BB : L->blocks()) {
+        for (Instruction& I : *BB) {
+          if (isa<DbgInfoIntrinsic>(I))
+            continue;
+          Size++;
+          if (isa<AllocaInst>(I))
+            CanTakeLong = true;
+          else if (CallBase* CB = dyn_cast<CallBase>(&I)) {
+            if (!isCallThatCannotTakeLong(CB))
+              CanTakeLong = true;
+          }
+        }
+      }
+      if (CanTakeLong) {
+        Unplanned("it contains a call or alloca");
+        continue;
+      }
+      if (Size >= pollcheckBudget) {
+        Unplanned("its body is too big");
+        continue;
+      }
+
+      unsigned Period = pollcheckBudget / Size;
+
+      PollcheckPlan Plan;
+      CountedLoop& CL = Plan.Counted;
+      Plan.IsCounted = matchCountedLoop(L, DT, CL);
+      if (Plan.IsCounted) {
+        ConstantInt* Start = dyn_cast<ConstantInt>(CL.Start);
+        ConstantInt* Limit = dyn_cast<ConstantInt>(CL.Limit);
+        if (Start && Limit) {
+          // Same reasoning as in widenedLoopCheckFlag(): keeping the iv within [0, INT32_MAX)
+          // means that it can only take the values between Start and Last.
+          int64_t First = Start->getSExtValue();
+          int64_t Last = Limit->getSExtValue() - (CL.LimitIsExclusive ? 1 : 0);
+          if (First >= 0 && First <= Last && Last < INT32_MAX
+              && static_cast<uint64_t>(Last - First + 1) <= Period)
+            Period = 0;
+        }
+      }
+
+      if (verbose) {
+        errs() << "Pollcheck period for " << *L << ": "
+               << (Period ? std::to_string(Period) : std::string("never")) << "\n";
+      }
+
+      Plan.Header = L->getHeader();
+      Plan.PreheaderTerm = Preheader->getTerminator();
+      Plan.Period = Period;
+      PollcheckPlans[Latch] = Plan;
+    }
+  }
+
+  // Stores with the same lower are barriered the same way.
+  Value* barrierCanonicalValue(Value* V) {
+    while (GetElementPtrInst* GEP = dyn_cast<GetElementPtrInst>(V))
+      V = GEP->getPointerOperand();
+    return V;
+  }
+
+  // Returns true if lowering this instruction cannot pollcheck, so it cannot let the GC start
+  // marking or move on to the next cycle behind our back. The checks get emitted in front of the
+  // instruction, and if any of them might ensure an aux ptr, then they might exit.
+  bool cannotPollcheckForBarrier(Instruction* I) {
+    auto Iter = ChecksForInst.find(I);
+    if (Iter != ChecksForInst.end()) {
+      for (const AccessCheckWithDI& AC : Iter->second) {
+        if (AC.CK == CheckKind::EnsureAuxPtr)
+          return false;
+      }
+    }
+    if (LoadInst* LI = dyn_cast<LoadInst>(I))
+      return LI->isSimple();
+    if (StoreInst* SI = dyn_cast<StoreInst>(I))
+      return SI->isSimple();
+    return isa<BinaryOperator>(I) || isa<UnaryOperator>(I) || isa<CastInst>(I)
+      || isa<CmpInst>(I) || isa<GetElementPtrInst>(I) || isa<SelectInst>(I) || isa<PHINode>(I)
+      || isa<ExtractValueInst>(I) || isa<InsertValueInst>(I) || isa<ExtractElementInst>(I)
+      || isa<InsertElementInst>(I) || isa<ShuffleVectorInst>(I) || isa<FreezeInst>(I)
+      || isa<DbgInfoIntrinsic>(I) || isa<BranchInst>(I) || isa<SwitchInst>(I)
+      || isa<ReturnInst>(I) || isa<UnreachableInst>(I);
+  }
+
+  // The store barrier marks the value being stored if the GC is marking. If we barriered the same
+  // value before, and there was no pollcheck in between, then the second barrier has nothing to
+  // do. Either the first one saw that we weren't marking, in which case we haven't acknowledged the
+  // handshake that starts marking and so nobody could have been scanned yet, or it saw that we
+  // were marking and marked the value, in which case the value stays marked until a handshake that
+  // we haven't acknowledged yet.
+  //
+  // Note that the fact that an object was allocated since the last pollcheck doesn't tell us much.
+  // It might have been allocated black, in which case the GC will never scan it, so anything that
+  // we store into it still needs to be barriered. And the first ptr store into a fresh object
+  // ensures its aux ptr, which exits.
+  // Explains why the checks of an access in a loop get done on every iteration.
+  const char* checkInLoopReason(Loop* L, Value* CanonicalPtr) {
+    for (BasicBlock* BB : L->blocks()) {
+      for (Instruction& I : *BB) {
+        if (isa<CallBase>(I) && !isa<IntrinsicInst>(I))
+          return "the loop contains a call, which might free anything";
+      }
+    }
+    if (L->isLoopInvariant(CanonicalPtr))
+      return "the ptr is loop-invariant, but isn't checked before the loop";
+    return "the ptr's bounds are unknown, since it isn't the loop's induction variable times a "
+      "constant plus a loop-invariant base";
+  }
+
+  void emitCheckAndPollcheckRemarks(
+    LoopInfo& LI, const std::unordered_set<const BasicBlock*>& BackEdgePreds) {
+    OptimizationRemarkEmitter ORE(OldF);
+    if (!ORE.enabled())
+      return;
+
+    size_t NumScheduledChecks = 0;
+    for (auto& Pair : ChecksForInst) {
+      for (const AccessCheckWithDI& AC : Pair.second) {
+        if (!IsKnownCheckKind(AC.CK))
+          NumScheduledChecks++;
+      }
+    }
+    if (CheckScheduleNotOptimizedReason) {
+      ORE.emit([&] () {
+        return OptimizationRemarkMissed(RemarkPassName, "ChecksNotOptimized", OldF)
+          << "did not optimize the " << ore::NV("NumChecks", NumBuiltChecks)
+          << " safety checks, since " << CheckScheduleNotOptimizedReason;
+      });
+    } else {
+      ORE.emit([&] () {
+        return OptimizationRemark(RemarkPassName, "ChecksScheduled", OldF)
+          << "scheduled " << ore::NV("NumScheduledChecks", NumScheduledChecks) << " of "
+          << ore::NV("NumChecks", NumBuiltChecks) << " safety checks";
+      });
+    }
+
+    for (auto& Pair : ChecksForInst) {
+      Instruction* I = Pair.first;
+      Loop* L = LI.getLoopFor(I->getParent());
+      if (!L)
+        continue;
+      auto WidenedIter = WidenedLoopChecksForInst.find(I);
+      std::unordered_set<Value*> Seen;
+      for (const AccessCheckWithDI& AC : Pair.second) {
+        if (IsKnownCheckKind(AC.CK) || AC.CK == CheckKind::GetAuxPtr ||
+            AC.CK == CheckKind::EnsureAuxPtr || !Seen.insert(AC.CanonicalPtr).second)
+          continue;
+        if (WidenedIter != WidenedLoopChecksForInst.end() &&
+            WidenedIter->second.count(AC.CanonicalPtr)) {
+          ORE.emit([&] () {
+            return OptimizationRemark(RemarkPassName, "ChecksWidened", I)
+              << "range checks are done once before the loop";
+          });
+          continue;
+        }
+        ORE.emit([&] () {
+          return OptimizationRemarkMissed(RemarkPassName, "CheckInLoop", I)
+            << "safety checks are done on every iteration, since "
+            << (CheckScheduleNotOptimizedReason
+                ? CheckScheduleNotOptimizedReason
+                : checkInLoopReason(L, AC.CanonicalPtr));
+        });
+      }
+    }
+
+    for (const BasicBlock* BB : BackEdgePreds) {
+      const Instruction* Term = BB->getTerminator();
+      auto Iter = PollcheckPlans.find(BB);
+      if (Iter != PollcheckPlans.end()) {
+        unsigned Period = Iter->second.Period;
+        ORE.emit([&] () {
+          if (!Period) {
+            return OptimizationRemark(RemarkPassName, "PollcheckRemoved", Term)
+              << "loop doesn't run long enough to need a pollcheck";
+          }
+          return OptimizationRemark(RemarkPassName, "PollcheckStripMined", Term)
+            << "pollcheck runs every " << ore::NV("Period", Period) << " iterations";
+        });
+        continue;
+      }
+      const char* Reason = "pollcheck optimization is disabled";
+      if (optimizePollchecks) {
+        Reason = "this back edge isn't a loop latch";
+        if (Loop* L = LI.getLoopFor(BB)) {
+          auto ReasonIter = UnplannedPollcheckReasons.find(L->getHeader());
+          if (ReasonIter != UnplannedPollcheckReasons.end())
+            Reason = ReasonIter->second;
+        }
+      }
+      ORE.emit([&] () {
+        return OptimizationRemarkMissed(RemarkPassName, "Pollcheck", Term)
+          << "pollcheck runs on every iteration, since " << Reason;
+      });
+    }
+  }
+
+  void emitStoreBarrierRemarks(const std::vector<BasicBlock*>& Blocks) {
+    OptimizationRemarkEmitter ORE(OldF);
+    if (!ORE.enabled())
+      return;
+
+    size_t NumBarriers = 0;
+    for (BasicBlock* BB : Blocks) {
+      for (Instruction& I : *BB) {
+        StoreInst* SI = dyn_cast<StoreInst>(&I);
+        if (SI && isa<PointerType>(SI->getValueOperand()->getType()))
+          NumBarriers++;
+      }
+    }
+    if (!NumBarriers)
+      return;
+    ORE.emit([&] () {
+      return OptimizationRemark(RemarkPassName, "StoreBarriersElided", OldF)
+        << "elided " << ore::NV("NumElided", StoresWithRedundantBarrier.size()) << " of "
+        << ore::NV("NumBarriers", NumBarriers) << " ptr store barriers";
+    });
+  }
+
+  void findRedundantStoreBarriers(
+    const std::vector<BasicBlock*>& Blocks,
+    const std::unordered_set<const BasicBlock*>& BackEdgePreds) {
+    StoresWithRedundantBarrier.clear();
+
+    if (!elideRedundantStoreBarriers)
+      return;
+
+    TimeTraceScope TimeScope("FilPizlonator find redundant store barriers");
+
+    auto candidateStore = [&] (Instruction* I) -> StoreInst* {
+      StoreInst* SI = dyn_cast<StoreInst>(I);
+      if (!SI || !SI->isSimple() || !isa<PointerType>(SI->getValueOperand()->getType()))
+        return nullptr;
+      return SI;
+    };
+
+    std::vector<BarrieredValuesOrBottom> AtHead(Blocks.size());
+    assert(Blocks[0] == &NewF->getEntryBlock());
+    AtHead[0].Bottom = false;
+
+    auto propagate = [&] (BasicBlock* BB, std::unordered_set<Value*>& Values, bool Record) {
+      for (Instruction& I : *BB) {
+        if (&I == BB->getTerminator() && BackEdgePreds.count(BB)) {
+          // Execute the pollcheck.
+          Values.clear();
+        }
+        if (!cannotPollcheckForBarrier(&I)) {
+          Values.clear();
+          continue;
+        }
+        StoreInst* SI = candidateStore(&I);
+        if (!SI)
+          continue;
+        Value* V = barrierCanonicalValue(SI->getValueOperand());
+        if (isa<ConstantPointerNull>(V) || !Values.insert(V).second) {
+          if (Record)
+            StoresWithRedundantBarrier.insert(SI);
+        }
+      }
+    };
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock* BB : Blocks) {
+        const BarrieredValuesOrBottom& VOB = AtHead[blockNumber(BB)];
+        if (VOB.Bottom)
+          continue;
+        std::unordered_set<Value*> Values = VOB.Values;
+        propagate(BB, Values, false);
+        for (BasicBlock* SBB : successors(BB)) {
+          BarrieredValuesOrBottom& SVOB = AtHead[blockNumber(SBB)];
+          if (SVOB.Bottom) {
+            SVOB.Bottom = false;
+            SVOB.Values = Values;
+            Changed = true;
+            continue;
+          }
+          for (auto Iter = SVOB.Values.begin(); Iter != SVOB.Values.end();) {
+            if (Values.count(*Iter)) {
+              ++Iter;
+              continue;
+            }
+            Iter = SVOB.Values.erase(Iter);
+            Changed = true;
+          }
+        }
+      }
+    }
+
+    for (BasicBlock* BB : Blocks) {
+      const BarrieredValuesOrBottom& VOB = AtHead[blockNumber(BB)];
+      if (VOB.Bottom)
+        continue;
+      std::unordered_set<Value*> Values = VOB.Values;
+      propagate(BB, Values, true);
+    }
+
+    if (verbose) {
+      for (StoreInst* SI : StoresWithRedundantBarrier)
+        errs() << "Store barrier is redundant for " << *SI << "\n";
+    }
+  }
+
   Type* argType(Type* T) {
     if (IntegerType* IT = dyn_cast<IntegerType>(T)) {
       if (IT->getBitWidth() < IntPtrTy->getBitWidth())
@@ -4571,6 +6599,43 @@ class Pizlonator {
       errs() << "After arg lowering: " << *I << "\n";
   }
 
+  // Keeps the masked access as it is, but with a raw pointer. If the mask wasn't all ones, then
+  // forEachCheck didn't check it, so we ask the runtime to check the span of enabled lanes. An
+  // all-zero mask doesn't access anything, so it needs no check.
+  void lowerMaskedAccess(IntrinsicInst* II, const MaskedAccess& MA) {
+    for (Use& U : II->data_ops())
+      lowerConstantOperand(U, II, RawNull);
+    std::optional<uint64_t> Bits = constantLaneBits(II, MA);
+    if (!Bits || (*Bits && *Bits != MA.allLaneBits())) {
+      Value* LaneBits;
+      if (Bits)
+        LaneBits = ConstantInt::get(IntPtrTy, *Bits);
+      else {
+        Value* Mask = II->getArgOperand(MA.MaskIndex);
+        if (MA.MaskUsesSignBits) {
+          Instruction* Lanes = new ICmpInst(
+            II, ICmpInst::ICMP_SLT, Mask, Constant::getNullValue(Mask->getType()),
+            "filc_mask_lanes");
+          Lanes->setDebugLoc(II->getDebugLoc());
+          Mask = Lanes;
+        }
+        Instruction* MaskBits = new BitCastInst(
+          Mask, IntegerType::get(C, MA.VT->getNumElements()), "filc_mask_bits", II);
+        MaskBits->setDebugLoc(II->getDebugLoc());
+        LaneBits = castInt(MaskBits, IntPtrTy, II);
+      }
+      CallInst::Create(
+        CheckMaskedAccess,
+        { II->getArgOperand(MA.PtrIndex), LaneBits,
+          ConstantInt::get(IntPtrTy, DL.getTypeAllocSize(MA.VT->getElementType())),
+          ConstantInt::get(Int32Ty, MA.AK == AccessKind::Write ? 1 : 0),
+          getOrigin(II->getDebugLoc()) }, "", II)
+        ->setDebugLoc(II->getDebugLoc());
+    }
+    Use& PtrUse = II->getArgOperandUse(MA.PtrIndex);
+    PtrUse = flightPtrPtr(PtrUse, II);
+  }
+
   bool earlyLowerInstruction(Instruction* I) {
     if (verbose)
       errs() << "Early lowering: " << *I << "\n";
@@ -4578,9 +6643,15 @@ class Pizlonator {
     if (IntrinsicInst* II = dyn_cast<IntrinsicInst>(I)) {
       if (verbose)
         errs() << "It's an intrinsic.\n";
+      MaskedAccess MA;
+      if (getMaskedAccess(II, MA)) {
+        lowerMaskedAccess(II, MA);
+        return true;
+      }
       switch (II->getIntrinsicID()) {
       case Intrinsic::memset:
       case Intrinsic::memset_inline: {
+        bool Inline = inlineMemOpSize(II);
         lowerConstantOperand(II->getArgOperandUse(0), I, RawNull);
         lowerConstantOperand(II->getArgOperandUse(1), I, RawNull);
         lowerConstantOperand(II->getArgOperandUse(2), I, RawNull);
@@ -4588,12 +6659,36 @@ class Pizlonator {
           Memset,
           { MyThread, II->getArgOperand(0), castInt(II->getArgOperand(1), Int32Ty, II),
             makeIntPtr(II->getArgOperand(2), II), getOrigin(II->getDebugLoc()) });
-        ReplaceInstWithInst(II, CI);
+        if (!Inline) {
+          ReplaceInstWithInst(II, CI);
+          return true;
+        }
+        // Our checks already ran. If the object has no aux, then there are no ptrs to clear, so
+        // setting the payload is all that the runtime would have done.
+        Value* Dst = II->getArgOperand(0);
+        Instruction* NoAux = new ICmpInst(
+          II, ICmpInst::ICMP_EQ, auxPtrForLower(flightPtrLower(Dst, II), II), RawNull,
+          "filc_memset_no_aux");
+        NoAux->setDebugLoc(II->getDebugLoc());
+        Instruction* ThenTerm;
+        Instruction* ElseTerm;
+        SplitBlockAndInsertIfThenElse(expectTrue(NoAux, II), II, &ThenTerm, &ElseTerm);
+        CallInst* Set = CallInst::Create(
+          RealMemset,
+          { flightPtrPtr(Dst, ThenTerm), II->getArgOperand(1), II->getArgOperand(2),
+            ConstantInt::getFalse(Int1Ty) }, "", ThenTerm);
+        Set->setDebugLoc(II->getDebugLoc());
+        if (MaybeAlign DstAlign = cast<MemIntrinsic>(II)->getDestAlign())
+          Set->addParamAttr(0, Attribute::getWithAlignment(C, *DstAlign));
+        CI->insertBefore(ElseTerm);
+        CI->setDebugLoc(II->getDebugLoc());
+        II->eraseFromParent();
         return true;
       }
       case Intrinsic::memcpy:
       case Intrinsic::memcpy_inline:
       case Intrinsic::memmove: {
+        bool Inline = inlineMemOpSize(II);
         lowerConstantOperand(II->getArgOperandUse(0), I, RawNull);
         lowerConstantOperand(II->getArgOperandUse(1), I, RawNull);
         lowerConstantOperand(II->getArgOperandUse(2), I, RawNull);
@@ -4601,7 +6696,40 @@ class Pizlonator {
           Memmove,
           { MyThread, II->getArgOperand(0), II->getArgOperand(1),
             makeIntPtr(II->getArgOperand(2), II), getOrigin(II->getDebugLoc()) });
-        ReplaceInstWithInst(II, CI);
+        if (!Inline) {
+          ReplaceInstWithInst(II, CI);
+          return true;
+        }
+        // Our checks already ran. If neither object has an aux, then no ptrs are being copied or
+        // overwritten, so copying the payload is all that the runtime would have done.
+        Value* Dst = II->getArgOperand(0);
+        Value* Src = II->getArgOperand(1);
+        Instruction* DstNoAux = new ICmpInst(
+          II, ICmpInst::ICMP_EQ, auxPtrForLower(flightPtrLower(Dst, II), II), RawNull,
+          "filc_memmove_dst_no_aux");
+        DstNoAux->setDebugLoc(II->getDebugLoc());
+        Instruction* SrcNoAux = new ICmpInst(
+          II, ICmpInst::ICMP_EQ, auxPtrForLower(flightPtrLower(Src, II), II), RawNull,
+          "filc_memmove_src_no_aux");
+        SrcNoAux->setDebugLoc(II->getDebugLoc());
+        Instruction* NoAux = BinaryOperator::Create(
+          Instruction::And, DstNoAux, SrcNoAux, "filc_memmove_no_aux", II);
+        NoAux->setDebugLoc(II->getDebugLoc());
+        Instruction* ThenTerm;
+        Instruction* ElseTerm;
+        SplitBlockAndInsertIfThenElse(expectTrue(NoAux, II), II, &ThenTerm, &ElseTerm);
+        CallInst* Copy = CallInst::Create(
+          II->getIntrinsicID() == Intrinsic::memmove ? RealMemmove : RealMemcpy,
+          { flightPtrPtr(Dst, ThenTerm), flightPtrPtr(Src, ThenTerm), II->getArgOperand(2),
+            ConstantInt::getFalse(Int1Ty) }, "", ThenTerm);
+        Copy->setDebugLoc(II->getDebugLoc());
+        if (MaybeAlign DstAlign = cast<MemTransferInst>(II)->getDestAlign())
+          Copy->addParamAttr(0, Attribute::getWithAlignment(C, *DstAlign));
+        if (MaybeAlign SrcAlign = cast<MemTransferInst>(II)->getSourceAlign())
+          Copy->addParamAttr(1, Attribute::getWithAlignment(C, *SrcAlign));
+        CI->insertBefore(ElseTerm);
+        CI->setDebugLoc(II->getDebugLoc());
+        II->eraseFromParent();
         return true;
       }
 
@@ -4824,6 +6952,70 @@ class Pizlonator {
           return true;
         }
 
+        if (FunctionCallee Callee = memScanRuntimeFunction(F, CI)) {
+          for (Use& Arg : CI->args())
+            lowerConstantOperand(Arg, CI, RawNull);
+          std::vector<Value*> Args;
+          Args.push_back(MyThread);
+          for (unsigned Index = 0; Index < CI->arg_size(); ++Index) {
+            Value* Arg = CI->getArgOperand(Index);
+            if (FT->getParamType(Index) == IntPtrTy)
+              Arg = makeIntPtr(Arg, CI);
+            Args.push_back(Arg);
+          }
+          Args.push_back(getOrigin(CI->getDebugLoc()));
+          CallInst* NewCI = CallInst::Create(Callee, Args, "filc_memscan", CI);
+          NewCI->setDebugLoc(CI->getDebugLoc());
+          CI->replaceAllUsesWith(NewCI);
+          Erasify();
+          return true;
+        }
+
+        if (AllocationLibcall Kind = allocationLibcall(F, CI); Kind != AllocationLibcall::None) {
+          for (Use& Arg : CI->args())
+            lowerConstantOperand(Arg, CI, RawNull);
+          if (Kind == AllocationLibcall::Malloc) {
+            Value* Size = makeIntPtr(CI->getArgOperand(0), CI);
+            if (FullyInitializedAllocations.count(CI)) {
+              Instruction* Result = CallInst::Create(
+                AllocateUninitialized, { MyThread, Size }, "filc_allocate_uninitialized", CI);
+              Result->setDebugLoc(CI->getDebugLoc());
+              CI->replaceAllUsesWith(flightPtrForObject(Result, CI));
+            } else
+              CI->replaceAllUsesWith(allocate(Size, GCMinAlign, false, CI));
+            Erasify();
+            return true;
+          }
+          CallInst* NewCI;
+          switch (Kind) {
+          case AllocationLibcall::Calloc:
+            NewCI = CallInst::Create(
+              Calloc,
+              { MyThread, makeIntPtr(CI->getArgOperand(0), CI),
+                makeIntPtr(CI->getArgOperand(1), CI) },
+              "filc_calloc", CI);
+            break;
+          case AllocationLibcall::Realloc:
+            NewCI = CallInst::Create(
+              Realloc,
+              { MyThread, CI->getArgOperand(0), makeIntPtr(CI->getArgOperand(1), CI),
+                getOrigin(CI->getDebugLoc()) },
+              "filc_realloc", CI);
+            break;
+          case AllocationLibcall::Free:
+            NewCI = CallInst::Create(
+              FreePtr, { MyThread, CI->getArgOperand(0), getOrigin(CI->getDebugLoc()) }, "", CI);
+            break;
+          default:
+            llvm_unreachable("Bad allocation libcall");
+          }
+          NewCI->setDebugLoc(CI->getDebugLoc());
+          if (Kind != AllocationLibcall::Free)
+            CI->replaceAllUsesWith(NewCI);
+          Erasify();
+          return true;
+        }
+
         if (shouldPassThrough(F)) {
           for (Use& Arg : CI->args())
             lowerConstantOperand(Arg, CI, RawNull);
@@ -4870,6 +7062,412 @@ class Pizlonator {
     return false;
   }
   
+  // Tells if we may replace a call to the libc function F with our own lowering. The caller has to
+  // let us treat it as a builtin, and if the module defines the function itself, then we call that
+  // instead.
+  bool canLowerLibcall(Function* F, CallBase* CI) {
+    if (!F->isDeclaration() || F->isIntrinsic() || CI->isNoBuiltin() ||
+        CI->hasOperandBundles() || OldF->hasFnAttribute("no-builtins") ||
+        OldF->hasFnAttribute(("no-builtin-" + F->getName()).str()))
+      return false;
+
+    FunctionType* FT = CI->getFunctionType();
+    return FT == F->getFunctionType() && !FT->isVarArg();
+  }
+
+  // Calls to memcmp, bcmp, memchr, memrchr, and memmem go straight to the runtime, which checks the
+  // bounds once and then uses the host's vectorized routines. We only do it when the call has the
+  // libc signature and canLowerLibcall says so.
+  FunctionCallee memScanRuntimeFunction(Function* F, CallBase* CI) {
+    if (!canLowerLibcall(F, CI))
+      return FunctionCallee();
+
+    FunctionType* FT = CI->getFunctionType();
+
+    if (F->getName() == "memcmp" || F->getName() == "bcmp") {
+      if (FT->getReturnType() == Int32Ty && FT->getNumParams() == 3 &&
+          FT->getParamType(0) == RawPtrTy && FT->getParamType(1) == RawPtrTy &&
+          FT->getParamType(2) == IntPtrTy)
+        return Memcmp;
+      return FunctionCallee();
+    }
+
+    if (F->getName() == "memchr" || F->getName() == "memrchr") {
+      if (FT->getReturnType() == RawPtrTy && FT->getNumParams() == 3 &&
+          FT->getParamType(0) == RawPtrTy && FT->getParamType(1) == Int32Ty &&
+          FT->getParamType(2) == IntPtrTy)
+        return F->getName() == "memchr" ? Memchr : Memrchr;
+      return FunctionCallee();
+    }
+
+    if (F->getName() == "memmem") {
+      if (FT->getReturnType() == RawPtrTy && FT->getNumParams() == 4 &&
+          FT->getParamType(0) == RawPtrTy && FT->getParamType(1) == IntPtrTy &&
+          FT->getParamType(2) == RawPtrTy && FT->getParamType(3) == IntPtrTy)
+        return Memmem;
+      return FunctionCallee();
+    }
+
+    return FunctionCallee();
+  }
+
+  enum class AllocationLibcall {
+    None,
+    Malloc,
+    Calloc,
+    Realloc,
+    Free
+  };
+
+  // C code allocates with malloc, which goes through libc and then the zgc_alloc native before it
+  // gets to filc_allocate. We skip those layers: malloc becomes filc_allocate, and calloc, realloc,
+  // and free become the runtime functions that do what the natives would have done. libc itself is
+  // built freestanding, so its own calls don't get this treatment.
+  AllocationLibcall allocationLibcall(Function* F, CallBase* CI) {
+    if (!canLowerLibcall(F, CI))
+      return AllocationLibcall::None;
+
+    FunctionType* FT = CI->getFunctionType();
+    if (F->getName() == "malloc") {
+      if (FT->getReturnType() == RawPtrTy && FT->getNumParams() == 1 &&
+          FT->getParamType(0) == IntPtrTy)
+        return AllocationLibcall::Malloc;
+      return AllocationLibcall::None;
+    }
+
+    if (F->getName() == "calloc") {
+      if (FT->getReturnType() == RawPtrTy && FT->getNumParams() == 2 &&
+          FT->getParamType(0) == IntPtrTy && FT->getParamType(1) == IntPtrTy)
+        return AllocationLibcall::Calloc;
+      return AllocationLibcall::None;
+    }
+
+    if (F->getName() == "realloc") {
+      if (FT->getReturnType() == RawPtrTy && FT->getNumParams() == 2 &&
+          FT->getParamType(0) == RawPtrTy && FT->getParamType(1) == IntPtrTy)
+        return AllocationLibcall::Realloc;
+      return AllocationLibcall::None;
+    }
+
+    if (F->getName() == "free") {
+      if (FT->getReturnType() == VoidTy && FT->getNumParams() == 1 &&
+          FT->getParamType(0) == RawPtrTy)
+        return AllocationLibcall::Free;
+      return AllocationLibcall::None;
+    }
+
+    return AllocationLibcall::None;
+  }
+
+  // Finds the mallocs whose whole payload gets written by a memcpy, memmove, or memset right after
+  // the allocation, so that the runtime doesn't have to zero it first. Nothing between the two may
+  // touch memory, call anything (so no pollchecks either), or use the allocation, and the mem op
+  // must start at the allocation and cover at least as many bytes as were asked for. Then
+  // nobody can see the payload before the mem op overwrites it. The runtime still zeroes the
+  // padding up to the next word, since that's readable too.
+  //
+  // The fence after the mem op makes it as good as the allocator's own fence after zeroing: a
+  // racy reader that gets the ptr after it's published sees what we wrote rather than the
+  // previous occupant's bytes.
+  void findFullyInitializedAllocations(const std::vector<BasicBlock*>& Blocks) {
+    FullyInitializedAllocations.clear();
+    if (!elideAllocationZeroing)
+      return;
+
+    static constexpr unsigned MaxInstructionsBetween = 16;
+
+    for (BasicBlock* BB : Blocks) {
+      for (Instruction& I : *BB) {
+        CallBase* CI = dyn_cast<CallBase>(&I);
+        if (!CI)
+          continue;
+        Function* F = CI->getCalledFunction();
+        if (!F || allocationLibcall(F, CI) != AllocationLibcall::Malloc)
+          continue;
+
+        MemIntrinsic* MI = nullptr;
+        unsigned Count = 0;
+        for (Instruction* Next = CI->getNextNode(); Next && Count < MaxInstructionsBetween;
+             Next = Next->getNextNode(), Count++) {
+          if (isa<DbgInfoIntrinsic>(Next))
+            continue;
+          MI = dyn_cast<MemIntrinsic>(Next);
+          if (MI)
+            break;
+          if (Next->mayReadOrWriteMemory() || isa<CallBase>(Next) || Next->isTerminator() ||
+              is_contained(Next->operands(), CI))
+            break;
+        }
+        if (!MI || MI->getRawDest() != CI)
+          continue;
+        if (MemTransferInst* MTI = dyn_cast<MemTransferInst>(MI)) {
+          if (MTI->getRawSource() == CI)
+            continue;
+        }
+
+        Value* Size = CI->getArgOperand(0);
+        Value* Length = MI->getLength();
+        if (Length != Size) {
+          ConstantInt* SizeC = dyn_cast<ConstantInt>(Size);
+          ConstantInt* LengthC = dyn_cast<ConstantInt>(Length);
+          if (!SizeC || !LengthC || LengthC->getValue().ult(SizeC->getZExtValue()))
+            continue;
+        }
+
+        FullyInitializedAllocations.insert(CI);
+        new FenceInst(C, AtomicOrdering::Release, SyncScope::System, MI->getNextNode());
+      }
+    }
+  }
+
+  bool isDirectCCType(Type* T) {
+    return T->isIntegerTy() || T->isFloatingPointTy() || T->isPointerTy();
+  }
+
+  // Returns the type of the direct entrypoint for the given function, or null if it shouldn't get
+  // one. The direct entrypoint takes the thread and then the flight args, so that ptrs are passed
+  // as lower/ptr pairs in registers rather than through the CC buffers. It returns the
+  // has-exception bit, paired with the flight return value if there is one.
+  //
+  // Only functions that someone in this module calls directly with the right signature get one.
+  // The buffer-based entrypoint stays around for everyone else (indirect calls, zcall, other
+  // modules), and becomes a forwarder to the direct one.
+  FunctionType* directFunctionType(Function* F, bool RequireDirectCaller = true) {
+    if (!useDirectCalls || F->isDeclaration() || F->isVarArg() || F->isInterposable())
+      return nullptr;
+
+    FunctionType* FT = F->getFunctionType();
+    if (FT->getReturnType() != VoidTy && !isDirectCCType(FT->getReturnType()))
+      return nullptr;
+    std::vector<Type*> ParamTypes;
+    ParamTypes.push_back(RawPtrTy);
+    for (Type* T : FT->params()) {
+      if (!isDirectCCType(T))
+        return nullptr;
+      ParamTypes.push_back(toFlightType(T));
+    }
+
+    bool HasDirectCaller = !RequireDirectCaller;
+    for (User* U : F->users()) {
+      if (HasDirectCaller)
+        break;
+      CallBase* CI = dyn_cast<CallBase>(U);
+      if (CI && !isa<CallBrInst>(CI) && CI->getCalledOperand() == F &&
+          CI->getFunctionType() == FT)
+        HasDirectCaller = true;
+    }
+    if (!HasDirectCaller)
+      return nullptr;
+
+    // These want to see the CC buffers.
+    for (BasicBlock& BB : *F) {
+      for (Instruction& I : BB) {
+        CallBase* CI = dyn_cast<CallBase>(&I);
+        if (!CI)
+          continue;
+        Function* Callee = CI->getCalledFunction();
+        if (!Callee)
+          continue;
+        if (Callee->getName() == "zargs" || Callee->getName() == "zreturn" ||
+            Callee->getIntrinsicID() == Intrinsic::vastart)
+          return nullptr;
+      }
+    }
+
+    Type* ReturnT;
+    if (FT->getReturnType() == VoidTy)
+      ReturnT = Int1Ty;
+    else
+      ReturnT = StructType::get(C, { Int1Ty, toFlightType(FT->getReturnType()) });
+    return FunctionType::get(ReturnT, ParamTypes, false);
+  }
+
+  Function* directCallee(CallBase* CI) {
+    Function* F = dyn_cast<Function>(CI->getCalledOperand());
+    if (!F || CI->getFunctionType() != F->getFunctionType() || CI->hasOperandBundles())
+      return nullptr;
+    auto Iter = FunctionToDirectFunction.find(F);
+    if (Iter == FunctionToDirectFunction.end())
+      return nullptr;
+    return Iter->second;
+  }
+
+  // A CallInst only needs to check for an exception on return if an exception can propagate through
+  // it. If the call is nounwind, then we give it an origin that cannot catch. Phase 1 of the unwinder
+  // refuses to go past such an origin, so the callee can never return with the exception flag set,
+  // and we can skip the check entirely. That's what makes calls to noexcept functions (including
+  // destructors) and to C functions declared nothrow free on the normal return path.
+  bool callCanCatch(CallBase* CI) {
+    assert(isa<CallInst>(CI));
+    return !OldF->doesNotThrow() && !CI->doesNotThrow();
+  }
+
+  // Since we know exactly who we're calling and the signature matches, there's no need to check the
+  // callee or to check the types of what was passed or returned.
+  void lowerDirectCall(CallBase* CI, Function* DirectF, Value* InitializationContext) {
+    assert(isa<CallInst>(CI) || isa<InvokeInst>(CI));
+
+    std::vector<Value*> CallArgs;
+    CallArgs.push_back(MyThread);
+    for (Use& Arg : CI->args()) {
+      lowerConstantOperand(Arg, CI, InitializationContext);
+      CallArgs.push_back(Arg);
+    }
+
+    bool CanCatch;
+    LandingPadInst* LPI;
+    if (isa<CallInst>(CI)) {
+      CanCatch = callCanCatch(CI);
+      LPI = nullptr;
+    } else {
+      CanCatch = true;
+      assert(LPIs.count(cast<InvokeInst>(CI)));
+      LPI = LPIs[cast<InvokeInst>(CI)];
+    }
+
+    storeOrigin(getOrigin(CI->getDebugLoc(), CanCatch, LPI), CI);
+
+    CallInst* TheCall = CallInst::Create(DirectF, CallArgs, "filc_direct_call", CI);
+    TheCall->setDebugLoc(CI->getDebugLoc());
+    FunctionType* FT = CI->getFunctionType();
+    Value* HasException = TheCall;
+    if (FT->getReturnType() != VoidTy) {
+      Instruction* Extract = ExtractValueInst::Create(
+        Int1Ty, TheCall, { 0 }, "filc_has_exception", CI);
+      Extract->setDebugLoc(CI->getDebugLoc());
+      HasException = Extract;
+    }
+
+    if (isa<CallInst>(CI) && CanCatch) {
+      SplitBlockAndInsertIfThen(
+        expectFalse(HasException, CI), CI, false, nullptr, nullptr, nullptr, ResumeB);
+    } else if (InvokeInst* II = dyn_cast<InvokeInst>(CI)) {
+      BranchInst::Create(
+        II->getUnwindDest(), II->getNormalDest(), expectFalse(HasException, II), II)
+        ->setDebugLoc(II->getDebugLoc());
+    }
+
+    Instruction* PostInsertionPt;
+    if (isa<CallInst>(CI))
+      PostInsertionPt = CI;
+    else
+      PostInsertionPt = &*cast<InvokeInst>(CI)->getNormalDest()->getFirstInsertionPt();
+
+    if (FT->getReturnType() != VoidTy) {
+      Instruction* Result = ExtractValueInst::Create(
+        toFlightType(FT->getReturnType()), TheCall, { 1 }, "filc_direct_call_result",
+        PostInsertionPt);
+      Result->setDebugLoc(CI->getDebugLoc());
+      CI->replaceAllUsesWith(Result);
+    }
+
+    CI->eraseFromParent();
+  }
+
+  // Syscalls never throw, so unlike lowerDirectCall(), there's no exception to check for. The
+  // runtime's entrypoint tracks the ptrs it's passed, since they're not in the CC buffers.
+  void lowerDirectSyscall(CallInst* CI, Function* DirectF, Value* InitializationContext) {
+    std::vector<Value*> CallArgs;
+    CallArgs.push_back(MyThread);
+    for (Use& Arg : CI->args()) {
+      lowerConstantOperand(Arg, CI, InitializationContext);
+      if (Arg->getType() == FlightPtrTy) {
+        CallArgs.push_back(flightPtrLower(Arg, CI));
+        CallArgs.push_back(flightPtrPtr(Arg, CI));
+      } else
+        CallArgs.push_back(Arg);
+    }
+
+    storeOrigin(getOrigin(CI->getDebugLoc()), CI);
+
+    CallInst* TheCall = CallInst::Create(DirectF, CallArgs, "filc_direct_syscall", CI);
+    TheCall->setDebugLoc(CI->getDebugLoc());
+    FunctionType* DirectFT = DirectF->getFunctionType();
+    for (unsigned Index = DirectFT->getNumParams(); Index--;) {
+      if (DirectFT->getParamType(Index) == Int1Ty)
+        TheCall->addParamAttr(Index, Attribute::ZExt);
+    }
+    if (DirectFT->getReturnType() == Int1Ty)
+      TheCall->addRetAttr(Attribute::ZExt);
+
+    Type* ReturnT = CI->getFunctionType()->getReturnType();
+    if (ReturnT != VoidTy) {
+      Value* Result = TheCall;
+      if (ReturnT->isPointerTy()) {
+        Instruction* Ptr = ExtractValueInst::Create(
+          RawPtrTy, TheCall, { 0 }, "filc_direct_syscall_ptr", CI);
+        Ptr->setDebugLoc(CI->getDebugLoc());
+        Instruction* Lower = ExtractValueInst::Create(
+          RawPtrTy, TheCall, { 1 }, "filc_direct_syscall_lower", CI);
+        Lower->setDebugLoc(CI->getDebugLoc());
+        Result = createFlightPtr(Lower, Ptr, CI);
+      }
+      CI->replaceAllUsesWith(Result);
+    }
+
+    CI->eraseFromParent();
+  }
+
+  // Fills in the buffer-based entrypoint of a function that has a direct entrypoint. It just moves
+  // the args out of the CC buffers and the return value back into them. It doesn't need a frame,
+  // since it has nothing to keep alive and can't pollcheck before the direct entrypoint records the
+  // args in its frame.
+  void emitDirectForwarder(Function* EntryF, Function* DirectF) {
+    NewF = EntryF;
+    MyThread = EntryF->getArg(0);
+    FunctionType* FT = OldF->getFunctionType();
+
+    BasicBlock* RootBB = BasicBlock::Create(C, "filc_direct_forwarder_root", EntryF);
+    BasicBlock* ReturnBB = BasicBlock::Create(C, "filc_direct_forwarder_return", EntryF);
+    BasicBlock* ResumeBB = BasicBlock::Create(C, "filc_direct_forwarder_resume", EntryF);
+    BranchInst* Branch = BranchInst::Create(ReturnBB, RootBB);
+    ReturnInst* Return = ReturnInst::Create(
+      C, UndefValue::get(PizlonatedReturnValueTy), ReturnBB);
+    ReturnInst::Create(
+      C, ConstantStruct::get(
+        PizlonatedReturnValueTy, { ConstantInt::getTrue(Int1Ty), ConstantInt::get(IntPtrTy, 0) }),
+      ResumeBB);
+
+    std::vector<Value*> CallArgs;
+    CallArgs.push_back(MyThread);
+    if (FT->getNumParams()) {
+      StructType* ArgsTy = argsType(FT);
+      Value* ArgsV = loadCC(ArgsTy, EntryF->getArg(1), CCArgsCheckFailure, Branch, DebugLoc());
+      for (unsigned Index = 0; Index < FT->getNumParams(); ++Index) {
+        Instruction* Extract = ExtractValueInst::Create(
+          toFlightType(ArgsTy->getElementType(Index)), ArgsV, Index, "filc_extract_arg", Branch);
+        CallArgs.push_back(castFromArg(Extract, toFlightType(FT->getParamType(Index)), Branch));
+      }
+    }
+    CallInst* Call = CallInst::Create(DirectF, CallArgs, "filc_direct_call", Branch);
+    auto PreconditionsIter = CalleePreconditions.find(OldF);
+    if (PreconditionsIter != CalleePreconditions.end()) {
+      // Our callers haven't done the checks that the direct entrypoint assumes, so we do them.
+      Args.assign(CallArgs.begin() + 1, CallArgs.end());
+      emitChecks(PreconditionsIter->second, Call);
+    }
+    Value* HasException = Call;
+    Value* ReturnValue = nullptr;
+    if (FT->getReturnType() != VoidTy) {
+      HasException = ExtractValueInst::Create(Int1Ty, Call, { 0 }, "filc_has_exception", Branch);
+      ReturnValue = ExtractValueInst::Create(
+        toFlightType(FT->getReturnType()), Call, { 1 }, "filc_direct_call_result", Branch);
+    }
+    BranchInst::Create(ResumeBB, ReturnBB, HasException, Branch);
+    Branch->eraseFromParent();
+
+    Value* RetSize;
+    if (ReturnValue)
+      RetSize = storeCC(FT->getReturnType(), ReturnValue, Return, DebugLoc());
+    else
+      RetSize = storeCC(IntPtrTy, ConstantInt::get(IntPtrTy, 0), Return, DebugLoc());
+    Instruction* Result = InsertValueInst::Create(
+      UndefValue::get(PizlonatedReturnValueTy), ConstantInt::getFalse(Int1Ty), { 0 },
+      "filc_insert_has_exception", Return);
+    Result = InsertValueInst::Create(Result, RetSize, { 1 }, "filc_insert_ret_size", Return);
+    Return->getOperandUse(0) = Result;
+  }
+
   // This lowers the instruction "in place", so all references to it are fixed up after this runs.
   void lowerInstruction(Instruction *I, Value* InitializationContext) {
     if (verbose)
@@ -4885,6 +7483,22 @@ class Pizlonator {
       return;
     }
 
+    if (CallBase* CI = dyn_cast<CallBase>(I)) {
+      if (Function* DirectF = directCallee(CI)) {
+        lowerDirectCall(CI, DirectF, InitializationContext);
+        return;
+      }
+      Function* Callee = dyn_cast<Function>(CI->getCalledOperand());
+      if (Callee && DirectSyscalls.count(Callee)) {
+        lowerDirectSyscall(cast<CallInst>(CI), Callee, InitializationContext);
+        return;
+      }
+    }
+
+    // This compares the raw address of the weak entrypoint against null, so it's already lowered.
+    if (ICmpInst* CI = dyn_cast<ICmpInst>(I); CI && DirectSyscallChecks.count(CI))
+      return;
+
     lowerConstantOperands(I, InitializationContext);
     
     if (AllocaInst* AI = dyn_cast<AllocaInst>(I)) {
@@ -4894,8 +7508,22 @@ class Pizlonator {
         return;
       }
       
+      if (StackAllocas.count(AI)) {
+        StackAllocas.erase(AI);
+        AI->replaceAllUsesWith(allocateOnStack(AI));
+        AI->eraseFromParent();
+        return;
+      }
+      
       Type* T = AI->getAllocatedType();
       Value* Length = AI->getArraySize();
+      if (ConstantInt* LengthC = dyn_cast<ConstantInt>(Length)) {
+        if (LengthC->isOne()) {
+          AI->replaceAllUsesWith(allocateTyped(T, AI));
+          AI->eraseFromParent();
+          return;
+        }
+      }
       if (Length->getType() != IntPtrTy) {
         Instruction* ZExt = new ZExtInst(Length, IntPtrTy, "filc_alloca_length_zext", AI);
         ZExt->setDebugLoc(AI->getDebugLoc());
@@ -4905,7 +7533,7 @@ class Pizlonator {
         Instruction::Mul, Length, ConstantInt::get(IntPtrTy, DL.getTypeAllocSize(T)),
         "filc_alloca_size", AI);
       Size->setDebugLoc(AI->getDebugLoc());
-      AI->replaceAllUsesWith(allocate(Size, DL.getABITypeAlign(T).value(), AI));
+      AI->replaceAllUsesWith(allocate(Size, DL.getABITypeAlign(T).value(), hasPtrs(T), AI));
       AI->eraseFromParent();
       return;
     }
@@ -4915,7 +7543,8 @@ class Pizlonator {
       Value* HighP = LI->getPointerOperand();
       Value* Result = loadValueRecurseAfterCheck(
         T, flightPtrPtr(HighP, LI), auxPtrForOperand(HighP, LI, 0, LI), LI->isVolatile(),
-        LI->getAlign(), LI->getOrdering(), LI->getSyncScopeID(), MemoryKind::Heap, LI);
+        LI->getAlign(), LI->getOrdering(), LI->getSyncScopeID(), MemoryKind::Heap, LI,
+        LI->getMetadata(LLVMContext::MD_tbaa));
       LI->replaceAllUsesWith(Result);
       LI->eraseFromParent();
       return;
@@ -4923,10 +7552,20 @@ class Pizlonator {
 
     if (StoreInst* SI = dyn_cast<StoreInst>(I)) {
       Value* HighP = SI->getPointerOperand();
+      if (StoresWithRedundantBarrier.count(SI)) {
+        assert(InstTypes[SI] == RawPtrTy);
+        storePtrUnbarriered(
+          SI->getValueOperand(), flightPtrPtr(HighP, SI), auxPtrForOperand(HighP, SI, 0, SI).P,
+          false, std::min(DL.getABITypeAlign(RawPtrTy), SI->getAlign()),
+          AtomicOrdering::NotAtomic, MemoryKind::Heap, SI, SI->getMetadata(LLVMContext::MD_tbaa));
+        SI->eraseFromParent();
+        return;
+      }
       storeValueRecurseAfterCheck(
         InstTypes[SI], SI->getValueOperand(), flightPtrPtr(HighP, SI),
         auxPtrForOperand(HighP, SI, 0, SI).P, SI->isVolatile(), SI->getAlign(),
-        SI->getOrdering(), SI->getSyncScopeID(), MemoryKind::Heap, SI);
+        SI->getOrdering(), SI->getSyncScopeID(), MemoryKind::Heap, SI,
+        SI->getMetadata(LLVMContext::MD_tbaa));
       SI->eraseFromParent();
       return;
     }
@@ -4990,6 +7629,25 @@ class Pizlonator {
     }
 
     if (ICmpInst* CI = dyn_cast<ICmpInst>(I)) {
+      if (SpeculativeCalleeChecks.count(CI)) {
+        // Comparing the raw ptrs isn't enough here, since any capability can be made to point at
+        // the function. Only the function's own capability passes the checks that the indirect
+        // call would have done, so that's what we compare against.
+        assert(CI->getPredicate() == ICmpInst::ICMP_EQ);
+        Instruction* SameLower = new ICmpInst(
+          CI, ICmpInst::ICMP_EQ, flightPtrLower(CI->getOperand(0), CI),
+          flightPtrLower(CI->getOperand(1), CI), "filc_speculative_callee_same_lower");
+        SameLower->setDebugLoc(CI->getDebugLoc());
+        CI->getOperandUse(0) = flightPtrPtr(CI->getOperand(0), CI);
+        CI->getOperandUse(1) = flightPtrPtr(CI->getOperand(1), CI);
+        hackRAUW(CI, [&] () {
+          Instruction* Result = BinaryOperator::Create(
+            Instruction::And, SameLower, CI, "filc_speculative_callee_check", CI->getNextNode());
+          Result->setDebugLoc(CI->getDebugLoc());
+          return Result;
+        });
+        return;
+      }
       if (hasPtrs(CI->getOperand(0)->getType())) {
         CI->getOperandUse(0) = flightPtrPtr(CI->getOperand(0), CI);
         CI->getOperandUse(1) = flightPtrPtr(CI->getOperand(1), CI);
@@ -5108,7 +7766,7 @@ class Pizlonator {
       bool CanCatch;
       LandingPadInst* LPI;
       if (isa<CallInst>(CI)) {
-        CanCatch = !OldF->doesNotThrow();
+        CanCatch = callCanCatch(CI);
         LPI = nullptr;
       } else {
         CanCatch = true;
@@ -5122,17 +7780,12 @@ class Pizlonator {
       ICmpInst* NullLower = new ICmpInst(
         CI, ICmpInst::ICMP_EQ, CalledLower, RawNull, "filc_null_called_lower");
       NullLower->setDebugLoc(CI->getDebugLoc());
-      Instruction* NewBlockTerm = SplitBlockAndInsertIfThen(expectFalse(NullLower, CI), CI, true);
-      BasicBlock* NewBlock = NewBlockTerm->getParent();
-      CallInst::Create(
-        CheckFunctionCallFail, { CI->getCalledOperand() }, "", NewBlockTerm)
-        ->setDebugLoc(CI->getDebugLoc());
+      branchToCallFail(NullLower, true, CI->getCalledOperand(), CI);
       ICmpInst* AtAuxPtr = new ICmpInst(
         CI, ICmpInst::ICMP_EQ, flightPtrPtr(CI->getCalledOperand(), CI),
         auxPtrForLower(CalledLower, CI), "filc_call_at_lower");
       AtAuxPtr->setDebugLoc(CI->getDebugLoc());
-      SplitBlockAndInsertIfElse(
-        expectTrue(AtAuxPtr, CI), CI, false, nullptr, nullptr, nullptr, NewBlock);
+      branchToCallFail(AtAuxPtr, false, CI->getCalledOperand(), CI);
       BinaryOperator* Masked = BinaryOperator::Create(
         Instruction::And, flagsForLower(CalledLower, CI),
         ConstantInt::get(IntPtrTy, SpecialTypeMask << ObjectFlagsSpecialShift),
@@ -5143,8 +7796,7 @@ class Pizlonator {
         ConstantInt::get(IntPtrTy, SpecialTypeFunction << ObjectFlagsSpecialShift),
         "filc_call_is_function");
       IsFunction->setDebugLoc(CI->getDebugLoc());
-      SplitBlockAndInsertIfElse(
-        expectTrue(IsFunction, CI), CI, false, nullptr, nullptr, nullptr, NewBlock);
+      branchToCallFail(IsFunction, false, CI->getCalledOperand(), CI);
 
       assert(!CI->hasOperandBundles());
       CallInst* TheCall = CallInst::Create(
@@ -5189,8 +7841,22 @@ class Pizlonator {
       size_t Size = DL.getTypeAllocSize(CanonicalT);
       size_t Alignment = DL.getABITypeAlign(CanonicalT).value();
       storeOrigin(getOrigin(VI->getDebugLoc()), VI);
-      // FIXME: We could optimize this by calling GetNextBytesForVAArg (sans the Ptr part) in cases
-      // where we're loading a non-ptr type.
+      if (!hasPtrs(CanonicalT)) {
+        // Most va_args (all of printf's numbers) don't need the aux, so they don't need the Ptr
+        // flavor, which has to find the aux for the arg.
+        CallInst* Call = CallInst::Create(
+          GetNextBytesForVAArg,
+          { VI->getPointerOperand(), ConstantInt::get(IntPtrTy, Size),
+            ConstantInt::get(IntPtrTy, Alignment) },
+          "filc_va_arg", VI);
+        Call->setDebugLoc(VI->getDebugLoc());
+        Instruction* Load = new LoadInst(
+          CanonicalT, Call, "filc_load", false, DL.getABITypeAlign(CanonicalT), VI);
+        Load->setDebugLoc(VI->getDebugLoc());
+        VI->replaceAllUsesWith(castFromArg(Load, toFlightType(T), VI));
+        VI->eraseFromParent();
+        return;
+      }
       CallInst* Call = CallInst::Create(
         GetNextPtrBytesForVAArg,
         { VI->getPointerOperand(), ConstantInt::get(IntPtrTy, Size),
@@ -5238,7 +7904,8 @@ class Pizlonator {
     }
 
     if (isa<IndirectBrInst>(I)) {
-      llvm_unreachable("Don't support IndirectBr yet (and maybe never will)");
+      llvm_unreachable("Shouldn't see IndirectBr because it should have been handled by "
+                       "lowerComputedGotos.");
       return;
     }
 
@@ -5268,8 +7935,10 @@ class Pizlonator {
     }
 
     if (isa<UnreachableInst>(I)) {
-      CallInst::Create(
-        Error, { getString("llvm unreachable instruction"), getOrigin(I->getDebugLoc()) }, "", I)
+      const char* Reason = "llvm unreachable instruction";
+      if (BadComputedGotoTargetBlocks.count(I->getParent()))
+        Reason = "computed goto to a label that is not one of its targets";
+      CallInst::Create(Error, { getString(Reason), getOrigin(I->getDebugLoc()) }, "", I)
         ->setDebugLoc(I->getDebugLoc());
       return;
     }
@@ -5354,6 +8023,31 @@ class Pizlonator {
     return false;
   }
 
+  // The runtime sets the stack limit 32KB above the real end of the stack. A function that doesn't
+  // call can get at most its own frame deeper than its caller, which already checked the limit, so
+  // if that frame is small it lands in the slack and doesn't need its own check. That's the same
+  // slack that runtime calls already rely on. Calls include inline asm and anything else that isn't
+  // an intrinsic, since we can't bound how deep those go.
+  bool needsStackOverflowCheck(const std::vector<Instruction*>& Instructions) {
+    if (!leafStackCheckMaxFrameSize)
+      return true;
+    uint64_t FrameBytes = (FrameSize + 3) * WordSize;
+    for (Instruction* I : Instructions) {
+      if (isa<CallBase>(I) && !isa<IntrinsicInst>(I))
+        return true;
+      AllocaInst* AI = dyn_cast<AllocaInst>(I);
+      if (!AI || !StackAllocas.count(AI))
+        continue;
+      uint64_t Size = DL.getTypeAllocSize(AI->getAllocatedType()) *
+        cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+      uint64_t StorageSize = (Size + WordSize - 1) & ~(WordSize - 1);
+      FrameBytes += ObjectSize + StorageSize;
+      if (hasPtrs(AI->getAllocatedType()))
+        FrameBytes += StorageSize;
+    }
+    return FrameBytes > leafStackCheckMaxFrameSize;
+  }
+
   void stackOverflowCheck(Instruction* InsertBefore) {
     assert(MyThread);
     Value* GEP = threadStackLimitPtr(MyThread, InsertBefore);
@@ -5361,6 +8055,197 @@ class Pizlonator {
     CI->addParamAttr(0, Attribute::get(C, Attribute::ElementType, RawPtrTy));
   }
 
+  // The lowered form of a thread local access is an opaque call, so nothing downstream will CSE or
+  // hoist it. Do that here while the accesses are still llvm.threadlocal.address, which is readnone
+  // and speculatable. We only ever remove calls from paths that already had one:
+  //
+  // - An access that is dominated by an access to the same thread local reuses the dominating one.
+  // - An access in a loop moves to the preheader if its block dominates every exiting block, since
+  //   then every trip through the loop would have done that access at least once anyway.
+  //
+  // Pre-split coroutines are skipped, since they can resume on a different thread.
+  void optimizeThreadLocalAccessesInFunction(Function& F) {
+    if (F.isDeclaration() || F.isPresplitCoroutine())
+      return;
+
+    std::unordered_map<GlobalVariable*, std::vector<Instruction*>> AccessMap;
+    for (BasicBlock& BB : F) {
+      for (Instruction& I : BB) {
+        IntrinsicInst* II = dyn_cast<IntrinsicInst>(&I);
+        if (!II || II->getIntrinsicID() != Intrinsic::threadlocal_address)
+          continue;
+        AccessMap[cast<GlobalVariable>(II->getArgOperand(0))].push_back(II);
+      }
+    }
+
+    if (AccessMap.empty())
+      return;
+
+    DominatorTree DT(F);
+    LoopInfo LI(DT);
+    for (auto& Pair : AccessMap) {
+      for (Instruction* I : Pair.second) {
+        for (Loop* L = LI.getLoopFor(I->getParent()); L; L = L->getParentLoop()) {
+          BasicBlock* Preheader = L->getLoopPreheader();
+          if (!Preheader)
+            break;
+          SmallVector<BasicBlock*, 4> ExitingBlocks;
+          L->getExitingBlocks(ExitingBlocks);
+          bool DominatesExits = true;
+          for (BasicBlock* ExitingBB : ExitingBlocks) {
+            if (!DT.dominates(I->getParent(), ExitingBB)) {
+              DominatesExits = false;
+              break;
+            }
+          }
+          if (!DominatesExits)
+            break;
+          I->moveBefore(Preheader->getTerminator());
+        }
+      }
+    }
+
+    simpleCSE(F, AccessMap);
+  }
+
+  // Collects the functions that a resolver might return, looking through selects and phis. These
+  // are only hints, so anything we don't understand is just skipped.
+  static void collectIFuncCandidates(Value* V, FunctionType* FT,
+                                     std::unordered_set<Value*>& Seen,
+                                     std::vector<Function*>& Candidates) {
+    V = V->stripPointerCasts();
+    if (!Seen.insert(V).second)
+      return;
+    if (Function* F = dyn_cast<Function>(V)) {
+      if (F->getFunctionType() == FT)
+        Candidates.push_back(F);
+      return;
+    }
+    if (SelectInst* SI = dyn_cast<SelectInst>(V)) {
+      collectIFuncCandidates(SI->getTrueValue(), FT, Seen, Candidates);
+      collectIFuncCandidates(SI->getFalseValue(), FT, Seen, Candidates);
+      return;
+    }
+    if (PHINode* Phi = dyn_cast<PHINode>(V)) {
+      for (Value* Incoming : Phi->incoming_values())
+        collectIFuncCandidates(Incoming, FT, Seen, Candidates);
+    }
+  }
+
+  // Each ifunc becomes a function with the ifunc's name (the dispatcher) and a cache of what the
+  // resolver returned. The first call runs the resolver, and every call after that compares the
+  // cached pointer against the functions that the resolver can return and makes a direct call
+  // to the one that matches. That's how target_clones and cpu_dispatch resolvers work, so calls to
+  // those never go through a function pointer check. If the resolver returns something that we
+  // couldn't see, then we call it indirectly, like any other function pointer.
+  //
+  // Resolvers might run more than once if threads race on the first call, which is fine, since
+  // they're meant to be idempotent anyway.
+  void lowerIFuncs() {
+    std::vector<GlobalIFunc*> IFuncs;
+    for (GlobalIFunc& G : M.ifuncs())
+      IFuncs.push_back(&G);
+
+    for (GlobalIFunc* G : IFuncs) {
+      FunctionType* FT = dyn_cast<FunctionType>(G->getValueType());
+      if (!FT)
+        report_fatal_error("ifunc " + G->getName() + " does not have a function type");
+      if (FT->isVarArg())
+        report_fatal_error("Fil-C does not support variadic ifuncs (" + G->getName() + ")");
+      Function* Resolver = G->getResolverFunction();
+      if (!Resolver)
+        report_fatal_error("ifunc " + G->getName() + " does not have a resolver function");
+
+      std::vector<Function*> Candidates;
+      if (!Resolver->isDeclaration()) {
+        std::unordered_set<Value*> Seen;
+        for (BasicBlock& BB : *Resolver) {
+          if (ReturnInst* RI = dyn_cast<ReturnInst>(BB.getTerminator())) {
+            if (RI->getReturnValue())
+              collectIFuncCandidates(RI->getReturnValue(), FT, Seen, Candidates);
+          }
+        }
+      }
+
+      GlobalVariable* Cache = new GlobalVariable(
+        M, RawPtrTy, false, GlobalValue::InternalLinkage, RawNull,
+        "filc_ifunc_cache_" + G->getName());
+      Function* Dispatcher = Function::Create(FT, G->getLinkage(), G->getAddressSpace(), "", &M);
+      Dispatcher->takeName(G);
+      Dispatcher->setVisibility(G->getVisibility());
+      Dispatcher->setDSOLocal(G->isDSOLocal());
+      if (G->hasComdat())
+        Dispatcher->setComdat(G->getComdat());
+
+      // The candidates have target features that the dispatcher must not inherit, so only their
+      // return and parameter attributes carry over.
+      AttributeList Attrs;
+      if (!Candidates.empty()) {
+        AttributeList CandidateAttrs = Candidates[0]->getAttributes();
+        SmallVector<AttributeSet, 8> ParamAttrs;
+        for (unsigned Index = 0; Index < FT->getNumParams(); ++Index)
+          ParamAttrs.push_back(CandidateAttrs.getParamAttrs(Index));
+        Attrs = AttributeList::get(C, AttributeSet(), CandidateAttrs.getRetAttrs(), ParamAttrs);
+      }
+      Dispatcher->setAttributes(Attrs);
+
+      BasicBlock* EntryB = BasicBlock::Create(C, "filc_ifunc_entry", Dispatcher);
+      BasicBlock* ResolveB = BasicBlock::Create(C, "filc_ifunc_resolve", Dispatcher);
+      BasicBlock* DispatchB = BasicBlock::Create(C, "filc_ifunc_dispatch", Dispatcher);
+
+      LoadInst* Cached = new LoadInst(
+        RawPtrTy, Cache, "filc_ifunc_cached", false, Align(8), AtomicOrdering::Monotonic,
+        SyncScope::System, EntryB);
+      BranchInst::Create(
+        ResolveB, DispatchB,
+        new ICmpInst(*EntryB, ICmpInst::ICMP_EQ, Cached, RawNull, "filc_ifunc_is_unresolved"),
+        EntryB);
+
+      std::vector<Value*> ResolverArgs;
+      for (Type* ParamTy : Resolver->getFunctionType()->params())
+        ResolverArgs.push_back(Constant::getNullValue(ParamTy));
+      Value* Resolved = CallInst::Create(
+        Resolver->getFunctionType(), Resolver, ResolverArgs, "filc_ifunc_resolved", ResolveB);
+      if (Resolved->getType() != RawPtrTy)
+        report_fatal_error("ifunc resolver " + Resolver->getName() + " does not return a pointer");
+      new StoreInst(Resolved, Cache, false, Align(8), AtomicOrdering::Monotonic,
+                    SyncScope::System, ResolveB);
+      BranchInst::Create(DispatchB, ResolveB);
+
+      PHINode* Target = PHINode::Create(RawPtrTy, 2, "filc_ifunc_target", DispatchB);
+      Target->addIncoming(Cached, EntryB);
+      Target->addIncoming(Resolved, ResolveB);
+
+      std::vector<Value*> Args;
+      for (Argument& Arg : Dispatcher->args())
+        Args.push_back(&Arg);
+      auto EmitCallAndReturn = [&] (Value* Callee, BasicBlock* BB) {
+        CallInst* Call = CallInst::Create(FT, Callee, Args, "", BB);
+        Call->setAttributes(Attrs);
+        if (FT->getReturnType() == VoidTy)
+          ReturnInst::Create(C, BB);
+        else
+          ReturnInst::Create(C, Call, BB);
+      };
+
+      BasicBlock* CurB = DispatchB;
+      for (Function* Candidate : Candidates) {
+        BasicBlock* CallB = BasicBlock::Create(C, "filc_ifunc_call", Dispatcher);
+        BasicBlock* NextB = BasicBlock::Create(C, "filc_ifunc_next", Dispatcher);
+        BranchInst::Create(
+          CallB, NextB,
+          new ICmpInst(*CurB, ICmpInst::ICMP_EQ, Target, Candidate, "filc_ifunc_is_candidate"),
+          CurB);
+        EmitCallAndReturn(Candidate, CallB);
+        CurB = NextB;
+      }
+      EmitCallAndReturn(Target, CurB);
+
+      G->replaceAllUsesWith(Dispatcher);
+      G->eraseFromParent();
+    }
+  }
+
   void lowerThreadLocals() {
     // - Lower all threadlocal variables to pthread_key_t, which is an i32, and a function that allocates
     //   the initial "value" (i.e. object containing the initial value). I guess that function can call
@@ -5437,6 +8322,9 @@ class Pizlonator {
 
     // FIXME: We aren't currently registering anything to clean up the threadlocals. Oh well?
 
+    for (Function& F : M.functions())
+      optimizeThreadLocalAccessesInFunction(F);
+
     for (Function& F : M.functions()) {
       for (BasicBlock& BB : F) {
         std::vector<Instruction*> Insts;
@@ -5586,6 +8474,10 @@ class Pizlonator {
   }
 
   void compileModuleAsm() {
+    // Almost every module has no module asm at all.
+    if (M.getModuleInlineAsm().empty())
+      return;
+
     MATokenizer MAT(M.getModuleInlineAsm());
 
     for (;;) {
@@ -5659,14 +8551,226 @@ class Pizlonator {
             Dummy->replaceAllUsesWith(NewGA);
           continue;
         }
-        errs() << "Invalid directive: " << Tok.Str << "\n";
-        llvm_unreachable("Error parsing module asm");
+        errs() << "Invalid directive: " << Tok.Str << "\n";
+        llvm_unreachable("Error parsing module asm");
+      }
+      errs() << "Unexpected token: " << Tok.Str << "\n";
+      llvm_unreachable("Error parsing module asm");
+    }
+
+    M.setModuleInlineAsm("");
+  }
+
+  // Picks the function that an indirect call most likely goes to, if we have a good guess. Value
+  // profiles come first, then !callees, and finally the only address-taken function in the module
+  // with the call's exact type. That last one is a guess about the whole program: the call could go
+  // to a function in another module, but then the check fails and we take the indirect path.
+  Function* speculativeCallee(
+    CallBase* CI, const std::unordered_map<uint64_t, Function*>& GUIDToFunction,
+    const std::unordered_map<FunctionType*, Function*>& OnlyAddressTakenFunction,
+    uint64_t& Count, uint64_t& TotalCount) {
+    Count = 0;
+    TotalCount = 0;
+
+    InstrProfValueData ValueData[1];
+    uint32_t NumValueData;
+    if (getValueProfDataFromInst(*CI, IPVK_IndirectCallTarget, 1, ValueData, NumValueData,
+                                 TotalCount)) {
+      if (!NumValueData ||
+          ValueData[0].Count * 100 < TotalCount * speculativeDevirtualizationPercent)
+        return nullptr;
+      auto Iter = GUIDToFunction.find(ValueData[0].Value);
+      if (Iter == GUIDToFunction.end())
+        return nullptr;
+      Count = ValueData[0].Count;
+      return Iter->second;
+    }
+
+    if (MDNode* Callees = CI->getMetadata(LLVMContext::MD_callees)) {
+      if (Callees->getNumOperands() != 1)
+        return nullptr;
+      return mdconst::dyn_extract_or_null<Function>(Callees->getOperand(0));
+    }
+
+    auto Iter = OnlyAddressTakenFunction.find(CI->getFunctionType());
+    if (Iter == OnlyAddressTakenFunction.end())
+      return nullptr;
+    return Iter->second;
+  }
+
+  // Indirect calls go through the CC buffers and have to check the callee's capability, while
+  // direct calls to functions with a direct entrypoint pass everything in registers and check
+  // nothing.
+  // So, when we can guess the callee, we turn the indirect call into a check that the callee is
+  // exactly that function's capability, a direct call if so, and the original indirect call
+  // otherwise. The check gets lowered specially; see SpeculativeCalleeChecks.
+  void speculativelyDevirtualize() {
+    if (!speculativeDevirtualization || !useDirectCalls)
+      return;
+
+    std::unordered_map<uint64_t, Function*> GUIDToFunction;
+    std::unordered_map<FunctionType*, Function*> OnlyAddressTakenFunction;
+    for (Function& F : M) {
+      if (F.isIntrinsic() || !directFunctionType(&F, false))
+        continue;
+      GUIDToFunction[F.getGUID()] = &F;
+      if (!F.hasAddressTaken())
+        continue;
+      auto Result = OnlyAddressTakenFunction.emplace(F.getFunctionType(), &F);
+      if (!Result.second)
+        Result.first->second = nullptr;
+    }
+    for (auto Iter = OnlyAddressTakenFunction.begin(); Iter != OnlyAddressTakenFunction.end();) {
+      if (Iter->second)
+        ++Iter;
+      else
+        Iter = OnlyAddressTakenFunction.erase(Iter);
+    }
+
+    std::vector<CallBase*> Calls;
+    for (Function& F : M) {
+      if (F.isDeclaration())
+        continue;
+      for (BasicBlock& BB : F) {
+        for (Instruction& I : BB) {
+          CallBase* CI = dyn_cast<CallBase>(&I);
+          if (!CI || isa<CallBrInst>(CI) || CI->hasOperandBundles() || CI->isInlineAsm() ||
+              isa<Function>(CI->getCalledOperand()->stripPointerCasts()))
+            continue;
+          if (CallInst* Call = dyn_cast<CallInst>(CI); Call && Call->isMustTailCall())
+            continue;
+          Calls.push_back(CI);
+        }
       }
-      errs() << "Unexpected token: " << Tok.Str << "\n";
-      llvm_unreachable("Error parsing module asm");
     }
 
-    M.setModuleInlineAsm("");
+    for (CallBase* CI : Calls) {
+      uint64_t Count;
+      uint64_t TotalCount;
+      Function* Callee = speculativeCallee(
+        CI, GUIDToFunction, OnlyAddressTakenFunction, Count, TotalCount);
+      if (!Callee || Callee->getFunctionType() != CI->getFunctionType() ||
+          !directFunctionType(Callee, false) || !isLegalToPromote(*CI, Callee))
+        continue;
+      MDNode* BranchWeights = nullptr;
+      if (TotalCount) {
+        BranchWeights = MDBuilder(C).createBranchWeights(
+          static_cast<uint32_t>(std::min<uint64_t>(Count, UINT32_MAX)),
+          static_cast<uint32_t>(std::min<uint64_t>(TotalCount - Count, UINT32_MAX)));
+      }
+      CallBase& DirectCall = promoteCallWithIfThenElse(*CI, Callee, BranchWeights);
+      BranchInst* Branch = cast<BranchInst>(
+        DirectCall.getParent()->getSinglePredecessor()->getTerminator());
+      SpeculativeCalleeChecks.insert(cast<ICmpInst>(Branch->getCondition()));
+    }
+  }
+
+  // Returns the letter that generate_pizlonated_forwarders.rb uses for this type when naming the
+  // register-based syscall entrypoints, or 0 if they can't take or return it.
+  char directSyscallTypeCode(Type* T) {
+    if (T == VoidTy)
+      return 'v';
+    if (T == Int1Ty)
+      return 'b';
+    if (T == Int32Ty)
+      return 'i';
+    if (T == IntPtrTy)
+      return 'l';
+    if (T == DoubleTy)
+      return 'd';
+    if (T->isPointerTy())
+      return 'p';
+    return 0;
+  }
+
+  // The runtime gives each zsys_* function a register-based entrypoint whose name spells out its
+  // signature, so calls to them don't need the getter, the callee checks, or the CC buffers. We
+  // refer to the entrypoint weakly and fall back to the normal call if it's not there, which is
+  // what happens if the caller's prototype doesn't match the runtime's.
+  //
+  // The check gets lowered specially; see DirectSyscallChecks. Ptrs are passed as separate lower
+  // and ptr args, so that the runtime's C signature doesn't depend on how aggregates get split
+  // between registers and the stack.
+  void directlyCallSyscalls() {
+    if (!directSyscalls)
+      return;
+
+    std::vector<CallInst*> Calls;
+    for (Function& F : M) {
+      if (F.isDeclaration())
+        continue;
+      for (BasicBlock& BB : F) {
+        for (Instruction& I : BB) {
+          CallInst* CI = dyn_cast<CallInst>(&I);
+          if (!CI || CI->hasOperandBundles() || CI->isMustTailCall())
+            continue;
+          Function* Callee = dyn_cast<Function>(CI->getCalledOperand());
+          if (!Callee || !Callee->isDeclaration() || Callee->isVarArg() ||
+              Callee->getFunctionType() != CI->getFunctionType() ||
+              !Callee->getName().starts_with("zsys_"))
+            continue;
+          Calls.push_back(CI);
+        }
+      }
+    }
+
+    for (CallInst* CI : Calls) {
+      FunctionType* FT = CI->getFunctionType();
+      std::string Name = ("filc_direct_" + CI->getCalledOperand()->getName() + "__").str();
+      char ReturnCode = directSyscallTypeCode(FT->getReturnType());
+      if (!ReturnCode)
+        continue;
+      Name += ReturnCode;
+      std::vector<Type*> ParamTypes;
+      ParamTypes.push_back(RawPtrTy);
+      bool Eligible = true;
+      for (Type* T : FT->params()) {
+        char Code = directSyscallTypeCode(T);
+        if (!Code) {
+          Eligible = false;
+          break;
+        }
+        Name += Code;
+        ParamTypes.push_back(T);
+        if (T->isPointerTy())
+          ParamTypes.push_back(RawPtrTy);
+      }
+      if (!Eligible)
+        continue;
+      Type* ReturnT = FT->getReturnType();
+      if (ReturnT->isPointerTy())
+        ReturnT = StructType::get(C, { RawPtrTy, RawPtrTy });
+
+      Function* DirectF = M.getFunction(Name);
+      if (!DirectF) {
+        DirectF = Function::Create(
+          FunctionType::get(ReturnT, ParamTypes, false), GlobalValue::ExternalWeakLinkage, Name,
+          &M);
+        DirectSyscalls.insert(DirectF);
+      }
+      assert(DirectSyscalls.count(DirectF));
+
+      ICmpInst* HasDirectF = new ICmpInst(
+        CI, ICmpInst::ICMP_NE, DirectF, ConstantPointerNull::get(RawPtrTy),
+        "filc_has_direct_syscall");
+      HasDirectF->setDebugLoc(CI->getDebugLoc());
+      DirectSyscallChecks.insert(HasDirectF);
+      Instruction* ThenTerm;
+      Instruction* ElseTerm;
+      SplitBlockAndInsertIfThenElse(HasDirectF, CI, &ThenTerm, &ElseTerm);
+      CallInst* DirectCall = cast<CallInst>(CI->clone());
+      DirectCall->setCalledOperand(DirectF);
+      DirectCall->insertBefore(ThenTerm);
+      BasicBlock* TailBB = CI->getParent();
+      CI->moveBefore(ElseTerm);
+      if (CI->getType() != VoidTy) {
+        PHINode* Phi = PHINode::Create(
+          CI->getType(), 2, "filc_syscall_result", &*TailBB->begin());
+        CI->replaceAllUsesWith(Phi);
+        Phi->addIncoming(DirectCall, DirectCall->getParent());
+        Phi->addIncoming(CI, CI->getParent());
+      }
+    }
   }
 
   void removeIrrelevantIntrinsics() {
@@ -5719,6 +8823,247 @@ class Pizlonator {
     }
   }
 
+  // Returns true if the pointer returned by the alloca may be seen by anything other than this
+  // function's own loads, stores, compares, and memory intrinsics. Following GEPs, selects, and
+  // phis is enough, since we run before canonicalizeGEPs() and everything else that might derive
+  // new pointers.
+  bool allocaMayEscape(AllocaInst* AI) {
+    std::vector<Value*> Worklist;
+    std::unordered_set<Value*> Seen;
+    Worklist.push_back(AI);
+    Seen.insert(AI);
+    while (!Worklist.empty()) {
+      Value* V = Worklist.back();
+      Worklist.pop_back();
+      for (Use& U : V->uses()) {
+        User* Usr = U.getUser();
+        if (isa<GetElementPtrInst>(Usr) || isa<SelectInst>(Usr) || isa<PHINode>(Usr)) {
+          if (!Usr->getType()->isPointerTy())
+            return true;
+          if (Seen.insert(Usr).second)
+            Worklist.push_back(Usr);
+          continue;
+        }
+        if (LoadInst* LI = dyn_cast<LoadInst>(Usr)) {
+          if (!LI->isSimple())
+            return true;
+          continue;
+        }
+        if (StoreInst* SI = dyn_cast<StoreInst>(Usr)) {
+          if (!SI->isSimple() || U.getOperandNo() != SI->getPointerOperandIndex())
+            return true;
+          continue;
+        }
+        if (isa<ICmpInst>(Usr) || isa<PtrToIntInst>(Usr) || isa<MemIntrinsic>(Usr))
+          continue;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Finds the allocas that can live in the native frame. The GC finds these objects by scanning
+  // frame lowers, so it's fine for pointers to them to be live across pollchecks and calls, so long
+  // as those pointers never leave the function. We don't do this in functions that call setjmp,
+  // since the runtime copies the frame lowers into the jmp_buf, which can outlive the frame.
+  void findStackAllocasInFunction(Function& F) {
+    if (F.isDeclaration())
+      return;
+
+    for (BasicBlock& BB : F) {
+      for (Instruction& I : BB) {
+        if (CallBase* CI = dyn_cast<CallBase>(&I)) {
+          Function* Callee = CI->getCalledFunction();
+          if (Callee && isSetjmp(Callee))
+            return;
+        }
+      }
+    }
+
+    for (Instruction& I : F.getEntryBlock()) {
+      AllocaInst* AI = dyn_cast<AllocaInst>(&I);
+      if (!AI || !AI->isStaticAlloca())
+        continue;
+      Type* T = AI->getAllocatedType();
+      if (isa<ScalableVectorType>(T))
+        continue;
+      uint64_t Size =
+        DL.getTypeAllocSize(T) * cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+      if (!Size || Size > maxStackAllocaSize)
+        continue;
+      if (AI->getAlign().value() > GCMinAlign || DL.getABITypeAlign(T).value() > GCMinAlign)
+        continue;
+      if (allocaMayEscape(AI))
+        continue;
+      StackAllocas.insert(AI);
+    }
+  }
+
+  // Is this alloca nothing but a private temporary for this byval argument? That's the case if
+  // everything else that uses it just writes to it, so nobody could observe what the callee does
+  // to it. This is what clang's agg.tmp looks like once lifetime markers are gone.
+  bool isPrivateByValTemporary(Value* V, CallBase* CI, unsigned ArgNo) {
+    if (!isa<AllocaInst>(V))
+      return false;
+    std::vector<Value*> Worklist;
+    std::unordered_set<Value*> Seen;
+    Worklist.push_back(V);
+    Seen.insert(V);
+    while (!Worklist.empty()) {
+      Value* P = Worklist.back();
+      Worklist.pop_back();
+      for (Use& U : P->uses()) {
+        User* Usr = U.getUser();
+        if (Usr == CI && U.getOperandNo() == ArgNo && P == V)
+          continue;
+        if (StoreInst* SI = dyn_cast<StoreInst>(Usr)) {
+          if (U.getOperandNo() == SI->getPointerOperandIndex() && !SI->isVolatile())
+            continue;
+          return false;
+        }
+        if (MemIntrinsic* MI = dyn_cast<MemIntrinsic>(Usr)) {
+          if (U.getOperandNo() == 0 && !MI->isVolatile())
+            continue;
+          return false;
+        }
+        if (isa<GetElementPtrInst>(Usr)) {
+          if (Seen.insert(Usr).second)
+            Worklist.push_back(Usr);
+          continue;
+        }
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // LLVM IR leaves it to the backend to make the callee's copy of a byval argument, and clang
+  // relies on that: when a large aggregate is passed by value from an lvalue, clang passes a
+  // pointer to the lvalue itself. We lower calls to Fil-C calls before the backend ever sees them,
+  // so we have to make the copy ourselves, or else a callee that writes to its parameter would
+  // write to the caller's object. Doing this before findStackAllocas means that the copies get the
+  // same escape analysis as any other alloca. Once this is done, a large aggregate gets to the
+  // callee as a single capability, and its contents never have to go through the CC buffers.
+  void copyByValArgs() {
+    for (Function& F : M) {
+      if (F.isDeclaration())
+        continue;
+      std::vector<std::pair<CallBase*, unsigned>> ByValArgs;
+      for (BasicBlock& BB : F) {
+        for (Instruction& I : BB) {
+          CallBase* CI = dyn_cast<CallBase>(&I);
+          if (!CI || CI->isInlineAsm() || CI->isMustTailCall())
+            continue;
+          for (unsigned ArgNo = CI->arg_size(); ArgNo--;) {
+            if (CI->isByValArgument(ArgNo)
+                && !isPrivateByValTemporary(CI->getArgOperand(ArgNo), CI, ArgNo))
+              ByValArgs.push_back(std::make_pair(CI, ArgNo));
+          }
+        }
+      }
+      for (std::pair<CallBase*, unsigned> ByValArg : ByValArgs) {
+        CallBase* CI = ByValArg.first;
+        unsigned ArgNo = ByValArg.second;
+        Type* T = CI->getParamByValType(ArgNo);
+        Align A = CI->getParamAlign(ArgNo).value_or(DLBefore.getABITypeAlign(T));
+        AllocaInst* Copy = new AllocaInst(
+          T, DLBefore.getAllocaAddrSpace(), nullptr, A, "filc_byval_copy",
+          &*F.getEntryBlock().getFirstInsertionPt());
+        IRBuilder<> B(CI);
+        Instruction* Memcpy = B.CreateMemCpy(
+          Copy, A, CI->getArgOperand(ArgNo), A, DLBefore.getTypeAllocSize(T));
+        Memcpy->setDebugLoc(CI->getDebugLoc());
+        CI->setArgOperand(ArgNo, Copy);
+      }
+    }
+  }
+
+  // Returns true if all that AI's users do is load from it and store to it.
+  bool isOnlyLoadedAndStored(AllocaInst* AI) {
+    for (Use& U : AI->uses()) {
+      User* Usr = U.getUser();
+      if (LoadInst* LI = dyn_cast<LoadInst>(Usr)) {
+        if (LI->isSimple())
+          continue;
+        return false;
+      }
+      if (StoreInst* SI = dyn_cast<StoreInst>(Usr)) {
+        if (U.getOperandNo() == SI->getPointerOperandIndex() && SI->isSimple())
+          continue;
+        return false;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  // At -O0, clang keeps every local in an alloca and loads it again at every use, and none of the
+  // early pipeline runs. So, p->x and p->y check two different ptrs, and neither the check
+  // scheduler nor GEP CSE can tell that they are the same. This does the cheapest thing that fixes
+  // that: within a block, a load from a local whose address never escapes gets the value that was
+  // last stored to it or loaded from it. The allocas and their dbg.declares stay as they are, so
+  // the debugger still sees every variable. The only thing that gets lost is that writing to a
+  // variable from the debugger may not affect the rest of the block.
+  void forwardLocalLoadsInFunction(Function& F) {
+    if (F.isDeclaration() || !F.hasOptNone() || F.callsFunctionThatReturnsTwice())
+      return;
+
+    std::unordered_set<AllocaInst*> Locals;
+    for (Instruction& I : F.getEntryBlock()) {
+      if (AllocaInst* AI = dyn_cast<AllocaInst>(&I)) {
+        if (AI->isStaticAlloca() && isOnlyLoadedAndStored(AI))
+          Locals.insert(AI);
+      }
+    }
+    if (Locals.empty())
+      return;
+
+    std::vector<LoadInst*> DeadLoads;
+    for (BasicBlock& BB : F) {
+      std::unordered_map<AllocaInst*, Value*> KnownValue;
+      for (Instruction& I : BB) {
+        if (StoreInst* SI = dyn_cast<StoreInst>(&I)) {
+          AllocaInst* AI = dyn_cast<AllocaInst>(SI->getPointerOperand());
+          if (AI && Locals.count(AI))
+            KnownValue[AI] = SI->getValueOperand();
+          continue;
+        }
+        LoadInst* LI = dyn_cast<LoadInst>(&I);
+        if (!LI)
+          continue;
+        AllocaInst* AI = dyn_cast<AllocaInst>(LI->getPointerOperand());
+        if (!AI || !Locals.count(AI))
+          continue;
+        auto Iter = KnownValue.find(AI);
+        if (Iter != KnownValue.end() && Iter->second->getType() == LI->getType()) {
+          LI->replaceAllUsesWith(Iter->second);
+          DeadLoads.push_back(LI);
+          continue;
+        }
+        KnownValue[AI] = LI;
+      }
+    }
+
+    if (verbose && !DeadLoads.empty())
+      errs() << "Forwarded " << DeadLoads.size() << " local loads in " << F.getName() << "\n";
+    for (LoadInst* LI : DeadLoads)
+      LI->eraseFromParent();
+  }
+
+  void forwardLocalLoads() {
+    if (!forwardLocalLoadsInOptNone)
+      return;
+    for (Function& F : M.functions())
+      forwardLocalLoadsInFunction(F);
+  }
+
+  void findStackAllocas() {
+    if (!stackAllocateAllocas)
+      return;
+    for (Function& F : M.functions())
+      findStackAllocasInFunction(F);
+  }
+
   void lazifyAllocasInFunction(Function& F) {
     if (F.isDeclaration())
       return;
@@ -5727,6 +9072,10 @@ class Pizlonator {
 
     for (Instruction& I : F.getEntryBlock()) {
       if (AllocaInst* AI = dyn_cast<AllocaInst>(&I)) {
+        // Allocas that go in the native frame are cheap to allocate eagerly.
+        if (StackAllocas.count(AI))
+          continue;
+        
         // For now, don't bother with AllocaInsts that flow into PHINodes. Pretty sure that doesn't
         // happen and it would be annoying to deal with.
         bool FoundPhi = false;
@@ -5947,12 +9296,64 @@ class Pizlonator {
     }
   }
 
+  // Label values can't be code pointers, since then they could be jumped to from anywhere. So, each
+  // blockaddress becomes a label number that is unique within the module, cast to a pointer so
+  // that it has no capability and can't be dereferenced. Label arithmetic (like the tables of label
+  // differences that threaded interpreters use) still works, since it's just integer math. Each
+  // indirectbr becomes a switch from the labels of its destinations to those destinations, and
+  // anything else (including labels of other functions) goes to an unreachable that lowers to a
+  // Fil-C safety error.
+  void lowerComputedGotos() {
+    DenseMap<BasicBlock*, ConstantInt*> Labels;
+    uint64_t NextLabel = 1;
+    for (Function& F : M.functions()) {
+      for (BasicBlock& BB : F) {
+        BlockAddress* BA = BlockAddress::lookup(&BB);
+        if (!BA)
+          continue;
+        ConstantInt* Label = ConstantInt::get(IntPtrTy, NextLabel++);
+        Labels[&BB] = Label;
+        BA->replaceAllUsesWith(ConstantExpr::getIntToPtr(Label, BA->getType()));
+        BA->destroyConstant();
+      }
+    }
+
+    for (Function& F : M.functions()) {
+      std::vector<IndirectBrInst*> IndirectBrs;
+      for (BasicBlock& BB : F) {
+        if (IndirectBrInst* IBI = dyn_cast<IndirectBrInst>(BB.getTerminator()))
+          IndirectBrs.push_back(IBI);
+      }
+      for (IndirectBrInst* IBI : IndirectBrs) {
+        BasicBlock* BB = IBI->getParent();
+        BasicBlock* BadB = BasicBlock::Create(C, "filc_bad_computed_goto", &F);
+        new UnreachableInst(C, BadB)->setDebugLoc(IBI->getDebugLoc());
+        BadComputedGotoTargetBlocks.insert(BadB);
+        Instruction* Cond = new PtrToIntInst(
+          IBI->getAddress(), IntPtrTy, "filc_computed_goto_label", IBI);
+        Cond->setDebugLoc(IBI->getDebugLoc());
+        SwitchInst* SI = SwitchInst::Create(Cond, BadB, IBI->getNumDestinations(), IBI);
+        SI->setDebugLoc(IBI->getDebugLoc());
+        std::unordered_set<BasicBlock*> SeenDestinations;
+        for (BasicBlock* Dest : IBI->successors()) {
+          // Only one edge per destination survives, and none survive to destinations that never had
+          // their address taken, since no label can get there.
+          if (!SeenDestinations.insert(Dest).second || !Labels.count(Dest)) {
+            Dest->removePredecessor(BB, /*KeepOneInputPHIs=*/true);
+            continue;
+          }
+          SI->addCase(Labels[Dest], Dest);
+        }
+        IBI->eraseFromParent();
+      }
+    }
+  }
+
   void prepare() {
+    lowerComputedGotos();
     for (Function& F : M.functions()) {
       for (BasicBlock& BB : F) {
         for (Instruction& I : BB) {
-          if (isa<IndirectBrInst>(&I))
-            llvm_unreachable("Don't support IndirectBr yet (and maybe never will)");
           if (LoadInst* LI = dyn_cast<LoadInst>(&I))
             assert(!LI->getPointerAddressSpace());
           if (StoreInst* SI = dyn_cast<StoreInst>(&I))
@@ -6031,6 +9432,87 @@ class Pizlonator {
     simpleCSE(F, GEPMap);
   }
 
+  // Returns the global ptr that the getter caches the global's flight ptr in, or null if we can't
+  // see it. For globals defined elsewhere, we refer to the global ptr weakly, since only strong
+  // definitions export one.
+  GlobalVariable* globalPtrForGetter(Function* Getter) {
+    auto Iter = GetterToGlobalPtr.find(Getter);
+    if (Iter != GetterToGlobalPtr.end())
+      return Iter->second;
+    auto DeclIter = GetterToDeclaredGlobalName.find(Getter);
+    if (DeclIter == GetterToDeclaredGlobalName.end())
+      return nullptr;
+    GlobalVariable* Result = new GlobalVariable(
+      M, FlightPtrTy, false, GlobalValue::ExternalWeakLinkage, nullptr,
+      "filc_gptr_" + DeclIter->second);
+    Result->setAlignment(Align(FlightPtrAlign));
+    GetterToGlobalPtr[Getter] = Result;
+    return Result;
+  }
+
+  // Once a global is initialized, its getter just returns what's in the global ptr. So, do that
+  // check inline and only call the getter if the global ptr is not there or not initialized yet.
+  // This does the same tearing check as the getter itself.
+  void inlineGlobalGetterFastPaths() {
+    if (!inlineGlobalGetters)
+      return;
+
+    std::vector<CallInst*> Calls;
+    for (BasicBlock& BB : *NewF) {
+      for (Instruction& I : BB) {
+        CallInst* CI = dyn_cast<CallInst>(&I);
+        if (!CI)
+          continue;
+        Function* Getter = CI->getCalledFunction();
+        if (!Getter || !Getters.count(Getter) || CI->getArgOperand(0) != RawNull)
+          continue;
+        // Cold code is better off with just the call.
+        if (isColdBlock(&BB))
+          continue;
+        Calls.push_back(CI);
+      }
+    }
+
+    for (CallInst* CI : Calls) {
+      GlobalVariable* PtrG = globalPtrForGetter(CI->getCalledFunction());
+      if (!PtrG)
+        continue;
+
+      BasicBlock* HeadBB = CI->getParent();
+      BasicBlock* ContBB = HeadBB->splitBasicBlock(CI->getIterator(), "filc_global_getter_cont");
+      BasicBlock* SlowBB = BasicBlock::Create(C, "filc_global_getter_slow", NewF, ContBB);
+      HeadBB->getTerminator()->eraseFromParent();
+      BasicBlock* LoadBB = HeadBB;
+      if (PtrG->hasExternalWeakLinkage()) {
+        LoadBB = BasicBlock::Create(C, "filc_global_getter_load", NewF, SlowBB);
+        ICmpInst* NoPtrG = new ICmpInst(
+          *HeadBB, ICmpInst::ICMP_EQ, PtrG, RawNull, "filc_no_global_ptr");
+        NoPtrG->setDebugLoc(CI->getDebugLoc());
+        BranchInst::Create(SlowBB, LoadBB, NoPtrG, HeadBB)->setDebugLoc(CI->getDebugLoc());
+      }
+      BranchInst* Branch = BranchInst::Create(
+        SlowBB, ContBB, UndefValue::get(Int1Ty), LoadBB);
+      Branch->setDebugLoc(CI->getDebugLoc());
+      Value* LoadPtr = loadFlightPtr(PtrG, Branch);
+      ICmpInst* NullPtr = new ICmpInst(
+        Branch, ICmpInst::ICMP_EQ, flightPtrPtr(LoadPtr, Branch), RawNull, "filc_check_global");
+      NullPtr->setDebugLoc(CI->getDebugLoc());
+      ICmpInst* NullLower = new ICmpInst(
+        Branch, ICmpInst::ICMP_EQ, flightPtrLower(LoadPtr, Branch), RawNull, "filc_check_global");
+      NullLower->setDebugLoc(CI->getDebugLoc());
+      Instruction* NotInitialized = BinaryOperator::Create(
+        Instruction::Or, NullPtr, NullLower, "filc_global_not_initialized", Branch);
+      NotInitialized->setDebugLoc(CI->getDebugLoc());
+      Branch->setCondition(expectFalse(NotInitialized, Branch));
+
+      PHINode* Phi = PHINode::Create(FlightPtrTy, 2, "filc_global_ptr", &ContBB->front());
+      CI->replaceAllUsesWith(Phi);
+      CI->moveBefore(BranchInst::Create(ContBB, SlowBB));
+      Phi->addIncoming(LoadPtr, LoadBB);
+      Phi->addIncoming(CI, SlowBB);
+    }
+  }
+
   void optimizeGetters() {
     std::unordered_map<Value*, std::vector<Instruction*>> GetterCallsForGetter;
 
@@ -6090,17 +9572,35 @@ public:
     RawNull = ConstantPointerNull::get(RawPtrTy);
 
     Dummy = makeDummy(Int32Ty);
+
+    MDBuilder MDB(C);
+    MDNode* AliasDomain = MDB.createAnonymousAliasScopeDomain("filc");
+    MDNode* AuxScope = MDB.createAnonymousAliasScope(AliasDomain, "filc_aux");
+    MDNode* PayloadScope = MDB.createAnonymousAliasScope(AliasDomain, "filc_payload");
+    MDNode* HeaderScope = MDB.createAnonymousAliasScope(AliasDomain, "filc_header");
+    AuxScopeList = MDNode::get(C, AuxScope);
+    PayloadScopeList = MDNode::get(C, PayloadScope);
+    HeaderScopeList = MDNode::get(C, HeaderScope);
+    NotAuxScopeList = MDNode::get(C, { PayloadScope, HeaderScope });
+    NotPayloadScopeList = MDNode::get(C, { AuxScope, HeaderScope });
+    NotHeaderScopeList = MDNode::get(C, { AuxScope, PayloadScope });
     
+    lowerIFuncs();
     lowerThreadLocals();
     makeEHDatas();
     compileModuleAsm();
     removeIrrelevantIntrinsics();
+    speculativelyDevirtualize();
+    directlyCallSyscalls();
+    copyByValArgs();
+    forwardLocalLoads();
+    findStackAllocas();
     lazifyAllocas();
     canonicalizeGEPs();
     
     if (verbose) {
       errs() << "Module with lowered thread locals, EH data, module asm, removing irrelevant "
-             << "intrinsics, and lazifying allocas:\n" << M << "\n";
+             << "intrinsics, finding stack allocas, and lazifying allocas:\n" << M << "\n";
     }
 
     prepare();
@@ -6123,7 +9623,7 @@ public:
     OriginWithEHTy = StructType::create(
       { RawPtrTy, Int32Ty, Int32Ty, RawPtrTy }, "filc_origin_with_eh");
     ObjectTy = StructType::create({ RawPtrTy, RawPtrTy }, "filc_object");
-    FrameTy = StructType::create({ RawPtrTy, RawPtrTy, RawPtrTy }, "filc_frame");
+    FrameTy = StructType::create({ RawPtrTy, RawPtrTy, IntPtrTy, RawPtrTy }, "filc_frame");
 
     std::vector<Type*> ThreadMembers;
     ThreadMembers.push_back(IntPtrTy); // stack_limit, index 0
@@ -6159,6 +9659,9 @@ public:
     AlignmentAndOffsetTy = StructType::create({ Int8Ty, Int8Ty }, "filc_alignment_and_offset");
     PizlonatedReturnValueTy = StructType::create({ Int1Ty, IntPtrTy }, "pizlonated_return_value");
     PtrPairTy = StructType::create({ RawPtrTy, RawPtrTy }, "filc_ptr_pair");
+    CheckCounterTy = StructType::create({ IntPtrTy, RawPtrTy, Int32Ty }, "filc_check_counter");
+    CheckCounterTableTy = StructType::create(
+      { RawPtrTy, IntPtrTy, RawPtrTy }, "filc_check_counter_table");
     PizlonatedFuncTy = FunctionType::get(
       PizlonatedReturnValueTy, { RawPtrTy, IntPtrTy }, false);
     GlobalGetterTy = FunctionType::get(FlightPtrTy, { RawPtrTy }, false);
@@ -6201,12 +9704,13 @@ public:
         }
         continue;
       }
+      if (DirectSyscalls.count(&F))
+        continue;
       Functions.push_back(&F);
     }
     for (GlobalAlias &G : M.aliases())
       Aliases.push_back(&G);
-    if (!M.ifunc_empty())
-      llvm_unreachable("Don't handle ifuncs yet.");
+    assert(M.ifunc_empty()); // lowerIFuncs() got rid of them.
 
     FlightNull = ConstantAggregateZero::get(FlightPtrTy);
     if (verbose)
@@ -6229,12 +9733,22 @@ public:
     XchgPtr = M.getOrInsertFunction(
       "filc_xchg_ptr_with_manual_tracking",
       FlightPtrTy, RawPtrTy, FlightPtrTy, IntPtrTy, FlightPtrTy);
+    GetNextBytesForVAArg = M.getOrInsertFunction(
+      "filc_get_next_bytes_for_va_arg", RawPtrTy, FlightPtrTy, IntPtrTy, IntPtrTy);
     GetNextPtrBytesForVAArg = M.getOrInsertFunction(
       "filc_get_next_ptr_bytes_for_va_arg", PtrPairTy, FlightPtrTy, IntPtrTy, IntPtrTy);
     Allocate = M.getOrInsertFunction(
       "filc_allocate", RawPtrTy, RawPtrTy, IntPtrTy);
     AllocateWithAlignment = M.getOrInsertFunction(
       "filc_allocate_with_alignment", RawPtrTy, RawPtrTy, IntPtrTy, IntPtrTy);
+    AllocateWithAux = M.getOrInsertFunction(
+      "filc_allocate_with_aux", RawPtrTy, RawPtrTy, IntPtrTy);
+    AllocateUninitialized = M.getOrInsertFunction(
+      "filc_allocate_uninitialized", RawPtrTy, RawPtrTy, IntPtrTy);
+    AllocateIso = M.getOrInsertFunction(
+      "filc_allocate_iso", RawPtrTy, RawPtrTy, RawPtrTy, IntPtrTy);
+    AllocateIsoWithAux = M.getOrInsertFunction(
+      "filc_allocate_iso_with_aux", RawPtrTy, RawPtrTy, RawPtrTy, IntPtrTy);
     CheckFunctionCallFail = M.getOrInsertFunction(
       "filc_check_function_call_fail", VoidTy, FlightPtrTy);
     OptimizedAlignmentContradiction = M.getOrInsertFunction(
@@ -6245,6 +9759,21 @@ public:
       "filc_memset", VoidTy, RawPtrTy, FlightPtrTy, Int32Ty, IntPtrTy, RawPtrTy);
     Memmove = M.getOrInsertFunction(
       "filc_memmove", VoidTy, RawPtrTy, FlightPtrTy, FlightPtrTy, IntPtrTy, RawPtrTy);
+    Memcmp = M.getOrInsertFunction(
+      "filc_memcmp", Int32Ty, RawPtrTy, FlightPtrTy, FlightPtrTy, IntPtrTy, RawPtrTy);
+    Memchr = M.getOrInsertFunction(
+      "filc_memchr", FlightPtrTy, RawPtrTy, FlightPtrTy, Int32Ty, IntPtrTy, RawPtrTy);
+    Memrchr = M.getOrInsertFunction(
+      "filc_memrchr", FlightPtrTy, RawPtrTy, FlightPtrTy, Int32Ty, IntPtrTy, RawPtrTy);
+    Memmem = M.getOrInsertFunction(
+      "filc_memmem", FlightPtrTy, RawPtrTy, FlightPtrTy, IntPtrTy, FlightPtrTy, IntPtrTy,
+      RawPtrTy);
+    CheckMaskedAccess = M.getOrInsertFunction(
+      "filc_check_masked_access", VoidTy, FlightPtrTy, IntPtrTy, IntPtrTy, Int32Ty, RawPtrTy);
+    Calloc = M.getOrInsertFunction("filc_calloc", FlightPtrTy, RawPtrTy, IntPtrTy, IntPtrTy);
+    Realloc = M.getOrInsertFunction(
+      "filc_realloc", FlightPtrTy, RawPtrTy, FlightPtrTy, IntPtrTy, RawPtrTy);
+    FreePtr = M.getOrInsertFunction("filc_free_ptr", VoidTy, RawPtrTy, FlightPtrTy, RawPtrTy);
     GlobalInitializationContextCreate = M.getOrInsertFunction(
       "filc_global_initialization_context_create", RawPtrTy, RawPtrTy);
     GlobalInitializationContextAdd = M.getOrInsertFunction(
@@ -6253,8 +9782,14 @@ public:
       "filc_global_initialization_context_destroy", VoidTy, RawPtrTy);
     ExecuteConstantRelocations = M.getOrInsertFunction(
       "filc_execute_constant_relocations", VoidTy, RawPtrTy, RawPtrTy, IntPtrTy, RawPtrTy);
+    InitializeModuleGlobals = M.getOrInsertFunction(
+      "filc_initialize_module_globals", VoidTy, RawPtrTy, RawPtrTy, IntPtrTy);
+    GlobalInitializationContextAddLazyCtors = M.getOrInsertFunction(
+      "filc_global_initialization_context_add_lazy_ctors", VoidTy, RawPtrTy, RawPtrTy);
     DeferOrRunGlobalCtor = M.getOrInsertFunction(
       "filc_defer_or_run_global_ctor", VoidTy, RawPtrTy);
+    RegisterCheckCounters = M.getOrInsertFunction(
+      "filc_register_check_counters", VoidTy, RawPtrTy);
     RunGlobalDtor = M.getOrInsertFunction(
       "filc_run_global_dtor", VoidTy, RawPtrTy);
     Error = M.getOrInsertFunction(
@@ -6263,6 +9798,8 @@ public:
       "llvm.memset.p0.i64", VoidTy, RawPtrTy, Int8Ty, IntPtrTy, Int1Ty);
     RealMemcpy = M.getOrInsertFunction(
       "llvm.memcpy.p0.p0.i64", VoidTy, RawPtrTy, RawPtrTy, IntPtrTy, Int1Ty);
+    RealMemmove = M.getOrInsertFunction(
+      "llvm.memmove.p0.p0.i64", VoidTy, RawPtrTy, RawPtrTy, IntPtrTy, Int1Ty);
     LandingPad = M.getOrInsertFunction(
       "filc_landing_pad", Int1Ty, RawPtrTy);
     ResumeUnwind = M.getOrInsertFunction(
@@ -6281,6 +9818,7 @@ public:
       "_setjmp", Int32Ty, RawPtrTy);
     cast<Function>(_Setjmp.getCallee())->addFnAttr(Attribute::ReturnsTwice);
     ExpectI1 = Intrinsic::getDeclaration(&M, Intrinsic::expect, Int1Ty);
+    PtrMask = Intrinsic::getDeclaration(&M, Intrinsic::ptrmask, { RawPtrTy, IntPtrTy });
     LifetimeStart = Intrinsic::getDeclaration(&M, Intrinsic::lifetime_start, { RawPtrTy });
     LifetimeEnd = Intrinsic::getDeclaration(&M, Intrinsic::lifetime_end, { RawPtrTy });
     StackCheckAsm = InlineAsm::get(
@@ -6292,8 +9830,14 @@ public:
 
     cast<Function>(OptimizedAlignmentContradiction.getCallee())->addFnAttr(Attribute::NoReturn);
     cast<Function>(OptimizedAccessCheckFail.getCallee())->addFnAttr(Attribute::NoReturn);
+    cast<Function>(CheckFunctionCallFail.getCallee())->addFnAttr(Attribute::NoReturn);
+    cast<Function>(OptimizedAlignmentContradiction.getCallee())->addFnAttr(Attribute::Cold);
+    cast<Function>(OptimizedAccessCheckFail.getCallee())->addFnAttr(Attribute::Cold);
+    cast<Function>(CheckFunctionCallFail.getCallee())->addFnAttr(Attribute::Cold);
+    AccessCheckFailThunk = nullptr;
+    AlignmentContradictionThunk = nullptr;
 
-    IsMarking = M.getOrInsertGlobal("filc_is_marking", Int8Ty);
+    StoreBarrierIsOn = M.getOrInsertGlobal("filc_store_barrier_is_on", Int8Ty);
 
     std::vector<GlobalValue*> ToDelete;
     auto HandleGlobal = [&] (GlobalValue* G) {
@@ -6319,6 +9863,11 @@ public:
           PizlonatedFuncTy,
           GlobalValue::InternalLinkage, F->getAddressSpace(),
           "Jf_" + F->getName(), &M);
+        if (FunctionType* DirectFT = directFunctionType(F)) {
+          FunctionToDirectFunction[F] = Function::Create(
+            DirectFT, GlobalValue::InternalLinkage, F->getAddressSpace(), "Jfd_" + F->getName(),
+            &M);
+        }
       }
     }
     if (verbose) {
@@ -6328,7 +9877,40 @@ public:
       errs() << "\n";
     }
     
-    if (GlobalVariable* GlobalCtors = M.getGlobalVariable("llvm.global_ctors")) {
+    // In lazy mode, the ctors go into a filc_lazy_global_ctors that every global getter in the
+    // module hands to its initialization context, so they run once the first of the module's
+    // globals has been initialized. Modules without globals of their own have nothing to trigger
+    // that, so they still run their ctors at startup.
+    GlobalVariable* LazyCtorsG = nullptr;
+    bool HasDefinedGlobals = llvm::any_of(
+      Globals, [] (GlobalVariable* G) { return !G->isDeclaration(); });
+    GlobalVariable* GlobalCtors = M.getGlobalVariable("llvm.global_ctors");
+    if (GlobalCtors && lazyGlobalCtors && HasDefinedGlobals) {
+      ConstantArray* Array = cast<ConstantArray>(GlobalCtors->getInitializer());
+      std::vector<std::pair<uint64_t, Constant*>> Ctors;
+      for (size_t Index = 0; Index < Array->getNumOperands(); ++Index) {
+        ConstantStruct* Struct = cast<ConstantStruct>(Array->getOperand(Index));
+        assert(Struct->getOperand(2) == RawNull);
+        Function* HiddenCtor = FunctionToHiddenFunction[cast<Function>(Struct->getOperand(1))];
+        assert(HiddenCtor);
+        Ctors.push_back(
+          std::make_pair(cast<ConstantInt>(Struct->getOperand(0))->getZExtValue(), HiddenCtor));
+      }
+      llvm::stable_sort(Ctors, [] (const auto& A, const auto& B) { return A.first < B.first; });
+      std::vector<Constant*> CtorCs;
+      for (auto& Pair : Ctors)
+        CtorCs.push_back(Pair.second);
+      ArrayType* CtorsTy = ArrayType::get(RawPtrTy, CtorCs.size());
+      StructType* LazyCtorsTy = StructType::get(C, { RawPtrTy, IntPtrTy, IntPtrTy, CtorsTy });
+      LazyCtorsG = new GlobalVariable(
+        M, LazyCtorsTy, false, GlobalValue::PrivateLinkage,
+        ConstantStruct::get(
+          LazyCtorsTy,
+          { RawNull, ConstantInt::get(IntPtrTy, 0), ConstantInt::get(IntPtrTy, CtorCs.size()),
+            ConstantArray::get(CtorsTy, CtorCs) }),
+        "filc_lazy_global_ctors");
+      GlobalCtors->eraseFromParent();
+    } else if (GlobalCtors) {
       ConstantArray* Array = cast<ConstantArray>(GlobalCtors->getInitializer());
       std::vector<Constant*> Args;
       for (size_t Index = 0; Index < Array->getNumOperands(); ++Index) {
@@ -6383,6 +9965,22 @@ public:
     if (GlobalVariable* Used = M.getGlobalVariable("llvm.compiler.used"))
       HandleUsed(Used);
 
+    // Starting up a big program touches a lot of globals, and initializing each one separately
+    // means taking the initialization lock and creating and committing a context each time. So, the
+    // first global in a module to be initialized pulls all of the others into its context.
+    std::vector<Constant*> ModuleGetters;
+    GlobalVariable* ModuleGettersG = nullptr;
+    if (bulkInitializeGlobals) {
+      for (GlobalVariable* G : Globals) {
+        if (!G->isDeclaration())
+          ModuleGetters.push_back(GlobalToGetter[G]);
+      }
+      if (ModuleGetters.size() > 1) {
+        ModuleGettersG = new GlobalVariable(
+          M, ArrayType::get(RawPtrTy, ModuleGetters.size()), true, GlobalVariable::PrivateLinkage,
+          nullptr, "filc_module_global_getters");
+      }
+    }
     for (GlobalVariable* G : Globals) {
       // We've already lowered thread locals by the time we get here.
       assert(G->getThreadLocalMode() == GlobalValue::NotThreadLocal);
@@ -6394,8 +9992,10 @@ public:
       if (verbose)
         errs() << "Dealing with global: " << *G << "\n";
 
-      if (G->isDeclaration())
+      if (G->isDeclaration()) {
+        GetterToDeclaredGlobalName[NewF] = G->getName().str();
         continue;
+      }
 
       Function* SlowF = Function::Create(GlobalGetterTy, GlobalValue::PrivateLinkage,
                                          G->getAddressSpace(), "filc_getter_slow", &M);
@@ -6449,8 +10049,13 @@ public:
       std::vector<Constant*> NewObjCFields;
       if (AlignmentTy)
         NewObjCFields.push_back(ConstantAggregateZero::get(AlignmentTy));
-      NewObjCFields.push_back(
-        ConstantExpr::getGetElementPtr(ObjectGTy, NewDataG, ConstantInt::get(IntPtrTy, 1)));
+      Constant* UpperC =
+        ConstantExpr::getGetElementPtr(ObjectGTy, NewDataG, ConstantInt::get(IntPtrTy, 1));
+      if (G->isConstant()) {
+        UpperC = ConstantExpr::getGetElementPtr(
+          Int8Ty, UpperC, ConstantInt::get(IntPtrTy, ObjectUpperReadonlyTag));
+      }
+      NewObjCFields.push_back(UpperC);
       NewObjCFields.push_back(
         ConstantExpr::getGetElementPtr(
           Int8Ty, AuxPtr,
@@ -6469,10 +10074,17 @@ public:
       Constant* NewDataObjectC = ConstantExpr::getGetElementPtr(
         Int8Ty, NewDataG, ConstantInt::get(IntPtrTy, AlignmentOffset));
       
+      // Strong definitions export their global ptr, so that other modules can load it directly once
+      // it's initialized. See inlineGlobalGetterFastPaths().
+      GlobalValue::LinkageTypes PtrLinkage = GlobalValue::PrivateLinkage;
+      if (inlineGlobalGetters && G->hasExternalLinkage())
+        PtrLinkage = GlobalValue::ExternalLinkage;
       GlobalVariable* NewPtrG = new GlobalVariable(
-        M, FlightPtrTy, false, GlobalValue::PrivateLinkage, FlightNull,
-        "filc_gptr_" + G->getName());
+        M, FlightPtrTy, false, PtrLinkage, FlightNull, "filc_gptr_" + G->getName());
       NewPtrG->setAlignment(Align(FlightPtrAlign));
+      if (PtrLinkage != GlobalValue::PrivateLinkage)
+        NewPtrG->setVisibility(G->getVisibility());
+      GetterToGlobalPtr[NewF] = NewPtrG;
       
       BasicBlock* RootBB = BasicBlock::Create(C, "filc_global_getter_root", NewF);
       BasicBlock* OtherCheckBB = BasicBlock::Create(C, "filc_global_getter_other_check", NewF);
@@ -6552,9 +10164,28 @@ public:
           G->getInitializer()->getType(), C, NewDataPayloadC, AuxPtr, false, Align(G->getAlignment()),
           AtomicOrdering::NotAtomic, SyncScope::System, MemoryKind::GlobalInit, Return);
       }
+
+      if (LazyCtorsG) {
+        CallInst::Create(
+          GlobalInitializationContextAddLazyCtors, { MyInitializationContext, LazyCtorsG }, "",
+          Return);
+      }
+
+      if (ModuleGettersG) {
+        CallInst::Create(
+          InitializeModuleGlobals,
+          { MyInitializationContext, ModuleGettersG,
+            ConstantInt::get(IntPtrTy, ModuleGetters.size()) },
+          "", Return);
+      }
       
       CallInst::Create(GlobalInitializationContextDestroy, { MyInitializationContext }, "", Return);
     }
+    if (ModuleGettersG) {
+      ModuleGettersG->setInitializer(
+        ConstantArray::get(cast<ArrayType>(ModuleGettersG->getValueType()), ModuleGetters));
+    }
+    computeCalleePreconditions();
     for (Function* F : Functions) {
       if (F->isIntrinsic())
         continue;
@@ -6563,9 +10194,14 @@ public:
         errs() << "Function before lowering: " << *F << "\n";
 
       if (!F->isDeclaration()) {
+        TimeTraceScope TimeScope("FilPizlonator lower function", F->getName());
         FunctionName = getFunctionName(F);
         OldF = F;
-        NewF = FunctionToHiddenFunction[F];
+        Function* EntryF = FunctionToHiddenFunction[F];
+        Function* DirectF = nullptr;
+        if (FunctionToDirectFunction.count(F))
+          DirectF = FunctionToDirectFunction[F];
+        NewF = DirectF ? DirectF : EntryF;
         AttrBuilder AB(C, OldF->getAttributes().getFnAttrs());
         AB.removeAttribute(Attribute::AllocKind);
         AB.removeAttribute(Attribute::AllocSize);
@@ -6595,9 +10231,14 @@ public:
         AB.removeAttribute(Attribute::WillReturn);
         AB.removeAttribute(Attribute::MustProgress);
         AB.removeAttribute(Attribute::PresplitCoroutine);
-        NewF->addFnAttrs(AB);
         assert(NewF);
+        EntryF->addFnAttrs(AB);
+        if (DirectF)
+          DirectF->addFnAttrs(AB);
         OptimizedAccessCheckOrigins.clear();
+        CallFailB = nullptr;
+        CallFailPhi = nullptr;
+        OriginStores.clear();
         InstTypes.clear();
         InstTypeVectors.clear();
         CanonicalPtrAuxBaseVars.clear();
@@ -6614,13 +10255,29 @@ public:
         for (BasicBlock& BB : *F)
           Blocks.push_back(&BB);
         assert(!Blocks.empty());
+        BlockNumbers.clear();
+        for (size_t Index = 0; Index < Blocks.size(); ++Index)
+          BlockNumbers[Blocks[Index]] = Index;
         Args.clear();
         for (BasicBlock* BB : Blocks) {
           BB->removeFromParent();
           BB->insertInto(NewF);
         }
-        computeFrameIndexMap(Blocks);
+        findFullyInitializedAllocations(Blocks);
         scheduleChecks(Blocks, BackEdgePreds);
+        {
+          TimeTraceScope TimeScope("FilPizlonator plan pollchecks and loop checks");
+          DominatorTree DT(*NewF);
+          LoopInfo LI(DT);
+          findColdBlocks(LI);
+          planPollchecks(DT, LI);
+          findWidenedLoopChecks(DT, LI);
+          emitCheckAndPollcheckRemarks(LI, BackEdgePreds);
+        }
+        findRedundantStoreBarriers(Blocks, BackEdgePreds);
+        emitStoreBarrierRemarks(Blocks);
+        // This goes after check scheduling, since checks that ensure aux ptrs are safepoints.
+        computeFrameIndexMap(Blocks, BackEdgePreds);
         // Snapshot the instructions before we do crazy stuff.
         std::vector<Instruction*> Instructions;
         for (BasicBlock* BB : Blocks) {
@@ -6628,30 +10285,6 @@ public:
             Instructions.push_back(&I);
             captureTypesIfNecessary(&I);
           }
-
-          if (BackEdgePreds.count(BB)) {
-            DebugLoc DL = BB->getTerminator()->getDebugLoc();
-            Value* StatePtr = threadStatePtr(MyThread, BB->getTerminator());
-            LoadInst* StateLoad = new LoadInst(
-              Int8Ty, StatePtr, "filc_thread_state_load", BB->getTerminator());
-            StateLoad->setDebugLoc(DL);
-            BinaryOperator* Masked = BinaryOperator::Create(
-              Instruction::And, StateLoad,
-              ConstantInt::get(
-                Int8Ty,
-                ThreadStateCheckRequested | ThreadStateStopRequested | ThreadStateDeferredSignal),
-              "filc_thread_state_masked", BB->getTerminator());
-            Masked->setDebugLoc(DL);
-            ICmpInst* PollcheckNotNeeded = new ICmpInst(
-              BB->getTerminator(), ICmpInst::ICMP_EQ, Masked, ConstantInt::get(Int8Ty, 0),
-              "filc_pollcheck_not_needed");
-            Masked->setDebugLoc(DL);
-            Instruction* NewTerm =
-              SplitBlockAndInsertIfElse(
-                expectTrue(PollcheckNotNeeded, BB->getTerminator()), BB->getTerminator(), false);
-            CallInst::Create(
-              PollcheckSlow, { MyThread, getOrigin(DL) }, "", NewTerm)->setDebugLoc(DL);
-          }
         }
 
         // Make sure that when folks want to add allocas to the root block, they get a pristine block.
@@ -6668,34 +10301,60 @@ public:
 
         ReallyReturnB = BasicBlock::Create(C, "filc_really_return_block", NewF);
         BranchInst* ReturnBranch = BranchInst::Create(ReallyReturnB, ReturnB);
-        RetSizePhi = PHINode::Create(IntPtrTy, 1, "filc_ret_size", ReallyReturnB);
-        Instruction* ReturnValue = InsertValueInst::Create(
-          UndefValue::get(PizlonatedReturnValueTy), ConstantInt::getFalse(Int1Ty), { 0 },
-          "filc_insert_has_exception", ReallyReturnB);
-        ReturnValue = InsertValueInst::Create(
-          ReturnValue, RetSizePhi, { 1 }, "filc_insert_ret_size", ReallyReturnB);
-        ReturnInst* Return = ReturnInst::Create(C, ReturnValue, ReallyReturnB);
-
-        if (F->getReturnType() != VoidTy) {
-          Type* T = F->getReturnType();
-          RetSizePhi->addIncoming(storeCC(T, ReturnPhi, ReturnBranch, DebugLoc()), ReturnB);
+        ReturnInst* Return;
+        ReturnInst* ResumeReturn;
+        ResumeB = BasicBlock::Create(C, "filc_resume_block", NewF);
+        if (DirectF) {
+          // The direct entrypoint returns the value itself. We never get here from zreturn, since
+          // functions that use it don't get a direct entrypoint.
+          RetSizePhi = nullptr;
+          if (F->getReturnType() != VoidTy) {
+            Type* ReturnT = DirectF->getReturnType();
+            Instruction* ReturnValue = InsertValueInst::Create(
+              UndefValue::get(ReturnT), ConstantInt::getFalse(Int1Ty), { 0 },
+              "filc_insert_has_exception", ReallyReturnB);
+            ReturnValue = InsertValueInst::Create(
+              ReturnValue, ReturnPhi, { 1 }, "filc_insert_return_value", ReallyReturnB);
+            Return = ReturnInst::Create(C, ReturnValue, ReallyReturnB);
+            ReturnValue = InsertValueInst::Create(
+              UndefValue::get(ReturnT), ConstantInt::getTrue(Int1Ty), { 0 },
+              "filc_insert_has_exception", ResumeB);
+            ResumeReturn = ReturnInst::Create(C, ReturnValue, ResumeB);
+          } else {
+            Return = ReturnInst::Create(C, ConstantInt::getFalse(Int1Ty), ReallyReturnB);
+            ResumeReturn = ReturnInst::Create(C, ConstantInt::getTrue(Int1Ty), ResumeB);
+          }
         } else {
-          RetSizePhi->addIncoming(
-              storeCC(IntPtrTy, ConstantInt::get(IntPtrTy, 0), ReturnBranch, DebugLoc()), ReturnB);
-        }
+          RetSizePhi = PHINode::Create(IntPtrTy, 1, "filc_ret_size", ReallyReturnB);
+          Instruction* ReturnValue = InsertValueInst::Create(
+            UndefValue::get(PizlonatedReturnValueTy), ConstantInt::getFalse(Int1Ty), { 0 },
+            "filc_insert_has_exception", ReallyReturnB);
+          ReturnValue = InsertValueInst::Create(
+            ReturnValue, RetSizePhi, { 1 }, "filc_insert_ret_size", ReallyReturnB);
+          Return = ReturnInst::Create(C, ReturnValue, ReallyReturnB);
+
+          if (F->getReturnType() != VoidTy) {
+            Type* T = F->getReturnType();
+            RetSizePhi->addIncoming(storeCC(T, ReturnPhi, ReturnBranch, DebugLoc()), ReturnB);
+          } else {
+            RetSizePhi->addIncoming(
+                storeCC(IntPtrTy, ConstantInt::get(IntPtrTy, 0), ReturnBranch, DebugLoc()),
+                ReturnB);
+          }
 
-        ResumeB = BasicBlock::Create(C, "filc_resume_block", NewF);
-        ReturnValue = InsertValueInst::Create(
-          UndefValue::get(PizlonatedReturnValueTy), ConstantInt::getTrue(Int1Ty), { 0 },
-          "filc_insert_has_exception", ResumeB);
-        ReturnValue = InsertValueInst::Create(
-          ReturnValue, ConstantInt::get(IntPtrTy, 0), { 1 }, "filc_insert_ret_size", ResumeB);
-        ReturnInst* ResumeReturn = ReturnInst::Create(C, ReturnValue, ResumeB);
+          ReturnValue = InsertValueInst::Create(
+            UndefValue::get(PizlonatedReturnValueTy), ConstantInt::getTrue(Int1Ty), { 0 },
+            "filc_insert_has_exception", ResumeB);
+          ReturnValue = InsertValueInst::Create(
+            ReturnValue, ConstantInt::get(IntPtrTy, 0), { 1 }, "filc_insert_ret_size", ResumeB);
+          ResumeReturn = ReturnInst::Create(C, ReturnValue, ResumeB);
+        }
 
         StructType* MyFrameTy = StructType::get(
-          C, { RawPtrTy, RawPtrTy, ArrayType::get(RawPtrTy, FrameSize) });
+          C, { RawPtrTy, RawPtrTy, IntPtrTy, ArrayType::get(RawPtrTy, FrameSize) });
         Frame = new AllocaInst(MyFrameTy, 0, "filc_my_frame", AllocaInsertionPoint);
-        stackOverflowCheck(InsertionPoint);
+        if (needsStackOverflowCheck(Instructions))
+          stackOverflowCheck(InsertionPoint);
         Value* ThreadTopFramePtr = threadTopFramePtr(MyThread, InsertionPoint);
         new StoreInst(
           new LoadInst(RawPtrTy, ThreadTopFramePtr, "filc_thread_top_frame", InsertionPoint),
@@ -6704,31 +10363,49 @@ public:
             "filc_frame_parent_ptr", InsertionPoint),
           InsertionPoint);
         new StoreInst(Frame, ThreadTopFramePtr, InsertionPoint);
+        OriginStores.push_back(
+          new StoreInst(
+            getOrigin(DebugLoc()),
+            GetElementPtrInst::Create(
+              FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 1) },
+              "filc_frame_parent_ptr", InsertionPoint),
+            InsertionPoint));
         new StoreInst(
-          getOrigin(DebugLoc()),
+          ConstantInt::get(IntPtrTy, 0),
           GetElementPtrInst::Create(
-            FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 1) },
-            "filc_frame_parent_ptr", InsertionPoint),
+            FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 2) },
+            "filc_frame_scan_epoch_ptr", InsertionPoint),
           InsertionPoint);
         for (size_t FrameIndex = FrameSize; FrameIndex--;)
           recordLowerAtIndex(RawNull, FrameIndex, InsertionPoint);
 
+        // Popping makes the parent the top frame again, so the parent can change its lowers.
+        // Clearing its scan epoch tells the GC that it has to rescan it. Pizlonated code always
+        // runs with some frame below it, so the parent is never null.
         auto PopFrame = [&] (Instruction* Return) {
+          Instruction* Parent = new LoadInst(
+            RawPtrTy,
+            GetElementPtrInst::Create(
+              FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 0) },
+              "filc_frame_parent_ptr", Return),
+            "filc_frame_parent", Return);
           new StoreInst(
-            new LoadInst(
-              RawPtrTy,
-              GetElementPtrInst::Create(
-                FrameTy, Frame, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 0) },
-                "filc_frame_parent_ptr", Return),
-              "filc_frame_parent", Return),
-            threadTopFramePtr(MyThread, Return),
+            ConstantInt::get(IntPtrTy, 0),
+            GetElementPtrInst::Create(
+              FrameTy, Parent, { ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 2) },
+              "filc_frame_parent_scan_epoch_ptr", Return),
             Return);
+          new StoreInst(Parent, threadTopFramePtr(MyThread, Return), Return);
         };
         PopFrame(Return);
         PopFrame(ResumeReturn);
 
         size_t LastOffset = 0;
-        if (F->getFunctionType()->getNumParams()) {
+        if (DirectF) {
+          assert(!UsesVastartOrZargs);
+          for (unsigned Index = 0; Index < F->getFunctionType()->getNumParams(); ++Index)
+            Args.push_back(DirectF->getArg(Index + 1));
+        } else if (F->getFunctionType()->getNumParams()) {
           StructType* ArgsTy = argsType(F->getFunctionType());
           const StructLayout* SL = DL.getStructLayout(ArgsTy);
           Value* ArgsV = loadCC(ArgsTy, NewF->getArg(1), CCArgsCheckFailure, InsertionPoint, DebugLoc());
@@ -6753,6 +10430,20 @@ public:
           SnapshottedArgsPtrForZargs = SnapshottedArgsPtr;
         }
 
+        // Do this after we have the args, since the strip-mined pollchecks may need to compute trip
+        // counts from them.
+        for (BasicBlock* BB : Blocks) {
+          if (!BackEdgePreds.count(BB))
+            continue;
+          auto Iter = PollcheckPlans.find(BB);
+          if (Iter == PollcheckPlans.end()) {
+            emitPollcheck(BB->getTerminator(), BB->getTerminator()->getDebugLoc());
+            continue;
+          }
+          if (Iter->second.Period)
+            emitStripMinedPollcheck(BB, Iter->second);
+        }
+
         FirstRealBlock = InsertionPoint->getParent();
 
         std::vector<PHINode*> Phis;
@@ -6780,6 +10471,7 @@ public:
         erase_if(Instructions, [&] (Instruction* I) { return earlyLowerInstruction(I); });
         for (Instruction* I : Instructions)
           lowerInstruction(I, RawNull);
+        removeRedundantOriginStores();
 
         GlobalVariable* NewObjectG = new GlobalVariable(
           M, ObjectTy, true, GlobalValue::InternalLinkage, nullptr, "Jfo_" + OldF->getName());
@@ -6793,7 +10485,7 @@ public:
           ObjectTy,
           { LowerAndUpper,
             ConstantExpr::getGetElementPtr(
-              Int8Ty, NewF,
+              Int8Ty, EntryF,
               ConstantInt::get(
                 IntPtrTy, static_cast<uintptr_t>(ObjectFlags) << ObjectAuxFlagsShift)) });
         NewObjectG->setInitializer(NewObjC);
@@ -6803,7 +10495,7 @@ public:
         assert(GetterF->isDeclaration());
         BasicBlock* RootBB = BasicBlock::Create(C, "filc_function_getter_root", GetterF);
         Return = ReturnInst::Create(C, UndefValue::get(FlightPtrTy), RootBB);
-        Return->getOperandUse(0) = createFlightPtr(LowerAndUpper, NewF, Return);
+        Return->getOperandUse(0) = createFlightPtr(LowerAndUpper, EntryF, Return);
 
         if (Setjmps.size())
           assert(NewF->callsFunctionThatReturnsTwice());
@@ -6812,9 +10504,16 @@ public:
           errs() << "New function: " << *NewF << "\n";
 
         optimizeGetters();
+        inlineGlobalGetterFastPaths();
 
         if (verbose)
           errs() << "New function after getter optimization: " << *NewF << "\n";
+
+        if (DirectF) {
+          emitDirectForwarder(EntryF, DirectF);
+          if (verbose)
+            errs() << "Direct forwarder: " << *EntryF << "\n";
+        }
       }
       
       FunctionName = "<internal>";
@@ -6835,6 +10534,9 @@ public:
         BB);
     }
 
+    emitCheckCounterTable();
+    emitCheckFailThunks();
+
     Dummy->deleteValue();
 
     if (verbose)
@@ -6859,11 +10561,51 @@ public:
   }
 };
 
+// The runtime inlines are plain C compiled to bitcode (see filc_runtime_inlines.c in libpas). Their
+// definitions become available_externally, so libpizlo still provides the real ones, and only
+// the ones that this module calls get linked in. They're compiled for the baseline target, and we
+// drop their target attributes so that they're always inline-compatible with the caller.
+static void linkRuntimeInlines(Module& M) {
+  if (runtimeInlines.empty())
+    return;
+
+  SMDiagnostic Err;
+  std::unique_ptr<Module> Inlines = parseIRFile(runtimeInlines, Err, M.getContext());
+  if (!Inlines) {
+    Err.print("filc", errs());
+    report_fatal_error("Could not load the FilC runtime inlines");
+  }
+
+  for (Function& F : *Inlines) {
+    if (F.isDeclaration())
+      continue;
+    F.removeFnAttr("target-cpu");
+    F.removeFnAttr("target-features");
+    F.removeFnAttr("tune-cpu");
+    if (F.hasExternalLinkage())
+      F.setLinkage(GlobalValue::AvailableExternallyLinkage);
+  }
+  if (NamedMDNode* Flags = Inlines->getModuleFlagsMetadata())
+    Inlines->eraseNamedMetadata(Flags);
+  Inlines->setDataLayout(M.getDataLayout());
+  Inlines->setTargetTriple(M.getTargetTriple());
+
+  if (Linker::linkModules(M, std::move(Inlines), Linker::LinkOnlyNeeded))
+    report_fatal_error("Could not link the FilC runtime inlines");
+}
+
 } // anonymous namespace
 
 PreservedAnalyses FilPizlonatorPass::run(Module &M, ModuleAnalysisManager&) {
+  // With LTO, we get to see modules that we already pizlonated when they were compiled to bitcode,
+  // for example in ThinLTO backends or when feeding LTO bitcode back to clang. Cross-module
+  // optimization of those modules happens on the pizlonated IR, so leave them alone.
+  if (M.getModuleFlag(PizlonatedModuleFlag))
+    return PreservedAnalyses::all();
   Pizlonator P(M);
   P.run();
+  linkRuntimeInlines(M);
+  M.addModuleFlag(Module::Error, PizlonatedModuleFlag, 1);
   return PreservedAnalyses::none();
 }
 